@@ -0,0 +1,2360 @@
+//--------------------------------------------------------------------------------------
+// File: CascadeFittingBench.cpp
+//
+// Replays recorded viewer/light poses through CascadeFitting::FitCascades for every
+// FIT_LIGHT_VIEW_FRUSTRUM x FIT_NEAR_FAR combination and reports ns/frame per cascade count,then
+// compares the texel density of manual and practical splits,with and without fitting them to the depth
+// bounds of ray cast depth images,compares the near/far range of the scene AABB with the per box hierarchy
+// and how many boxes each cascade draws after caster culling,and reports how many cascades each
+// CASCADE_UPDATE_SCHEDULE renders per frame and how much of them is left to rasterize when the tiles scroll.
+// Last it times the simplification of a dense sphere into the LOD chain the far cascades draw and compares
+// the atlas of equal cascade tiles with the packed atlas of halving tile lengths,shares an atlas between
+// the spot lights of the scene and picks the shadow maps of a few memory budgets.
+// No D3D11 or DXUT is needed,so this also builds outside of Windows wherever DirectXMath is available:
+//
+//   g++ -O2 -std=c++14 -I<DirectXMath>/Inc CascadeFittingBench.cpp ../CascadedShadowMaps11/CascadeFitting.cpp ../CascadedShadowMaps11/MeshSimplification.cpp
+//       ../CascadedShadowMaps11/AtlasPacking.cpp
+//
+// Usage: CascadeFittingBench [--poses file] [--frames count] [--passes count] [--clipper] [--verify cases]
+//
+// --clipper times the triangle clipper instead of ComputeNearAndFarAnalytic.
+// --verify runs the analytic near/far solver against the clipper on random boxes and ortho bounds,replays
+// the poses through the cascade cache,checks ReduceDepthBounds against a plain loop and the scene bounds
+// hierarchy and the caster and sub-texel caster culling against every box on its own,scrolls cascade tiles by
+// whole and partial texels,
+// simplifies a square and a sphere,packs random cascade lengths into the atlas,allocates the shadow tiles of
+// random lights,weighs the shadow maps of random budgets once more,hands the cascades the schedules render the slots
+// of the constant ring and returns non-zero if anything disagrees.The constant buffer layouts of ShadowConstants.h
+// are checked against the packoffsets of the shaders when this compiles.
+//
+// A pose file has one recorded frame per line,'#' starts a comment:
+//   viewerEyeX viewerEyeY viewerEyeZ viewerLookAtX viewerLookAtY viewerLookAtZ lightEyeX lightEyeY lightEyeZ lightLookAtX lightLookAtY lightLookAtZ
+// Without a pose file a deterministic fly-through of a power plant sized scene is generated.
+//--------------------------------------------------------------------------------------
+#include "../CascadedShadowMaps11/AtlasPacking.h"
+#include "../CascadedShadowMaps11/CascadeFitting.h"
+#include "../CascadedShadowMaps11/MeshSimplification.h"
+#include "../CascadedShadowMaps11/ShadowConstants.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace DirectX;
+
+struct RecordedPose
+{
+	XMFLOAT3 m_vViewerEye;
+	XMFLOAT3 m_vViewerLookAt;
+	XMFLOAT3 m_vLightEye;
+	XMFLOAT3 m_vLightLookAt;
+};
+
+static const XMFLOAT3 g_vSceneAABBMin(-280.0f, -20.0f, -280.0f);
+static const XMFLOAT3 g_vSceneAABBMax(280.0f, 160.0f, 280.0f);
+
+static const char* g_szFitModeNames[] = { "CascadeIntervals", "Scene" };
+static const char* g_szNearFarModeNames[] = { "ZeroOne", "SceneAABB", "AABB+Ortho", "Pancaking" };
+
+//--------------------------------------------------------------------------------------
+// A walk through the scene at head height with the camera looking around,while the light slowly
+// circles the scene.Consecutive frames are close to each other like in a real recording.
+//--------------------------------------------------------------------------------------
+static void GenerateFlyThrough(int iFrameCount, std::vector<RecordedPose>& poses)
+{
+	poses.resize(iFrameCount);
+	for (int i = 0;i < iFrameCount;++i)
+	{
+		float t = (float)i / (float)iFrameCount;
+		float fPathAngle = t * XM_2PI;
+		float fYaw = fPathAngle * 3.0f + 0.7f * sinf(fPathAngle * 11.0f);
+		float fPitch = -0.15f + 0.25f * sinf(fPathAngle * 5.0f);
+
+		RecordedPose& pose = poses[i];
+		pose.m_vViewerEye = XMFLOAT3(180.0f * cosf(fPathAngle), 5.0f + 30.0f * (0.5f + 0.5f * sinf(fPathAngle * 2.0f)), 180.0f * sinf(fPathAngle));
+		pose.m_vViewerLookAt = XMFLOAT3(pose.m_vViewerEye.x + cosf(fYaw) * cosf(fPitch),
+			pose.m_vViewerEye.y + sinf(fPitch),
+			pose.m_vViewerEye.z + sinf(fYaw) * cosf(fPitch));
+
+		float fLightAngle = 3.9f + 0.5f * t;
+		pose.m_vLightEye = XMFLOAT3(390.0f * cosf(fLightAngle), 300.0f, 390.0f * sinf(fLightAngle));
+		pose.m_vLightLookAt = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	}
+}
+
+static bool LoadPoses(const char* szFileName, std::vector<RecordedPose>& poses)
+{
+	FILE* pFile = fopen(szFileName, "r");
+	if (!pFile)
+	{
+		return false;
+	}
+
+	char line[512];
+	while (fgets(line, sizeof(line), pFile))
+	{
+		if (line[0] == '#')
+		{
+			continue;
+		}
+
+		RecordedPose pose;
+		int iRead = sscanf(line, "%f %f %f %f %f %f %f %f %f %f %f %f",
+			&pose.m_vViewerEye.x, &pose.m_vViewerEye.y, &pose.m_vViewerEye.z,
+			&pose.m_vViewerLookAt.x, &pose.m_vViewerLookAt.y, &pose.m_vViewerLookAt.z,
+			&pose.m_vLightEye.x, &pose.m_vLightEye.y, &pose.m_vLightEye.z,
+			&pose.m_vLightLookAt.x, &pose.m_vLightLookAt.y, &pose.m_vLightLookAt.z);
+		if (iRead == 12)
+		{
+			poses.push_back(pose);
+		}
+	}
+
+	fclose(pFile);
+	return !poses.empty();
+}
+
+//--------------------------------------------------------------------------------------
+// The sample's default partitions are 5/15/60/100 for 4 cascades,the other counts use the same
+// quadratic distribution.
+//--------------------------------------------------------------------------------------
+static void SetDefaultPartitions(CascadeFitParams& params, int iCascadeCount)
+{
+	params.m_nUsingCascadeLevelsCount = iCascadeCount;
+	params.m_iCascadePartitionMax = 100;
+	for (int i = 0;i < MAX_CASCADES;++i)
+	{
+		float fRatio = (float)(i + 1) / (float)iCascadeCount;
+		int iPartition = (i + 1 >= iCascadeCount) ? 100 : (int)(100.0f * fRatio * fRatio + 0.5f);
+		int iPrevious = (i == 0) ? 0 : params.m_iCascadePartitionsZeroToOne[i - 1];
+		params.m_iCascadePartitionsZeroToOne[i] = (iPartition > iPrevious) ? iPartition : iPrevious + 1;
+		if (params.m_iCascadePartitionsZeroToOne[i] > 100)
+		{
+			params.m_iCascadePartitionsZeroToOne[i] = 100;
+		}
+	}
+}
+
+// Same setup as the sample:1024 texel cascades,3x3 PCF and a viewer far plane covering the scene diagonal.
+static void InitSampleParams(CascadeFitParams& params)
+{
+	params.m_vSceneAABBMin = XMLoadFloat3(&g_vSceneAABBMin);
+	params.m_vSceneAABBMax = XMLoadFloat3(&g_vSceneAABBMax);
+	params.m_fViewerCameraNearClip = 0.05f;
+	params.m_fViewerCameraFarClip = XMVectorGetX(XMVector3Length(params.m_vSceneAABBMax - params.m_vSceneAABBMin));
+	params.m_matViewerCameraProj = XMMatrixPerspectiveFovLH(XM_PI / 4, 16.0f / 9.0f, params.m_fViewerCameraNearClip, params.m_fViewerCameraFarClip);
+	params.m_iLengthOfShadowBufferSquare = 1024;
+	memset(params.m_iCascadeLengthOfShadowBuffer, 0, sizeof(params.m_iCascadeLengthOfShadowBuffer));
+	params.m_eSplitMode = CASCADE_SPLIT_MANUAL;
+	params.m_fSplitLambda = 0.5f;
+	params.m_bUseDepthBounds = false;
+	params.m_fDepthBoundsMin = 0.0f;
+	params.m_fDepthBoundsMax = 0.0f;
+	params.m_iPCFBlurSize = 3;
+	params.m_iFarCascadeGuardTexels = 0;
+	params.m_bMoveLightTexelSize = true;
+	params.m_bAnalyticNearFar = true;
+	params.m_pSceneBounds = nullptr;
+	params.m_eLightViewFrustumFitMode = FIT_LIGHT_VIEW_FRUSTRUM_TO_SCENE;
+	params.m_eSelectedNearFarFit = FIT_NEAR_FAR_SCENE_AABB_AND_ORTHO_BOUND;
+	SetDefaultPartitions(params, 4);
+}
+
+//--------------------------------------------------------------------------------------
+// Replays the fly-through with every pose shown twice.The cached fit has to match a fresh fit,and the
+// repeated frame must neither refit nor leave a cascade to render.
+//--------------------------------------------------------------------------------------
+static int VerifyCascadeCache(const std::vector<XMMATRIX>& viewerViews, const std::vector<XMMATRIX>& lightViews)
+{
+	CascadeFitParams params;
+	InitSampleParams(params);
+
+	CascadeCache cache;
+	CascadeFitting::InvalidateCascadeCache(&cache);
+	CascadeFitResult result;
+
+	int iErrorCount = 0;
+	int iRenderedCount = 0;
+	for (size_t iPose = 0;iPose < viewerViews.size();++iPose)
+	{
+		params.m_matViewerCameraView = viewerViews[iPose];
+		params.m_matLightCameraView = lightViews[iPose];
+		CascadeFitting::FitCascades(params, &result);
+
+		for (int iRepeat = 0;iRepeat < 2;++iRepeat)
+		{
+			bool bRefitted = CascadeFitting::FitCascadesCached(params, &cache);
+			unsigned int uDirtyMask = CascadeFitting::GetDirtyCascadeMask(params, cache);
+			CascadeFitting::MarkCascadesRendered(params, uDirtyMask, &cache);
+
+			for (int i = 0;i < params.m_nUsingCascadeLevelsCount;++i)
+			{
+				iRenderedCount += (uDirtyMask >> i) & 1;
+				if (memcmp(&result.m_matOrthoProjForCascades[i], &cache.m_LastResult.m_matOrthoProjForCascades[i], sizeof(XMMATRIX)) != 0)
+				{
+					++iErrorCount;
+				}
+			}
+			if (iRepeat == 1 && (bRefitted || uDirtyMask != 0))
+			{
+				++iErrorCount;
+			}
+		}
+	}
+
+	printf("cache:%d frames,%d of %d cascade renders needed,%d errors\n", (int)viewerViews.size() * 2, iRenderedCount,
+		(int)viewerViews.size() * 2 * params.m_nUsingCascadeLevelsCount, iErrorCount);
+	return iErrorCount == 0 ? 0 : 1;
+}
+
+//--------------------------------------------------------------------------------------
+// Replays the poses through every CASCADE_UPDATE_SCHEDULE and counts the cascades rendered per frame.
+// A cascade that was not rendered must still cover its frustum interval with the tile it has,and stay within the
+// guard band of CASCADE_FAR_GUARD_TEXELS.
+//--------------------------------------------------------------------------------------
+static const char* g_szScheduleNames[] = { "EveryFrame", "RoundRobin", "ByError" };
+
+static int ReplayCascadeSchedules(const std::vector<XMMATRIX>& viewerViews, const std::vector<XMMATRIX>& lightViews, int iCascadeCount)
+{
+	CascadeFitParams params;
+	InitSampleParams(params);
+	SetDefaultPartitions(params, iCascadeCount);
+
+	int iErrorCount = 0;
+	for (int iSchedule = CASCADE_UPDATE_EVERY_FRAME;iSchedule <= CASCADE_UPDATE_BY_ERROR;++iSchedule)
+	{
+		// The amortized schedules fit the far cascades with a guard band,as the manager does.
+		params.m_iFarCascadeGuardTexels = iSchedule == CASCADE_UPDATE_EVERY_FRAME ? 0 : CASCADE_FAR_GUARD_TEXELS;
+		CascadeCache cache;
+		CascadeFitting::InvalidateCascadeCache(&cache);
+
+		int iUpdateCount = 0;
+		float fWorstError = 0.0f;
+		for (size_t iPose = 0;iPose < viewerViews.size();++iPose)
+		{
+			params.m_matViewerCameraView = viewerViews[iPose];
+			params.m_matLightCameraView = lightViews[iPose];
+			CascadeFitting::FitCascadesCached(params, &cache);
+			unsigned int uDirtyMask = CascadeFitting::GetDirtyCascadeMask(params, cache);
+			unsigned int uUpdateMask = CascadeFitting::ScheduleCascadeUpdates(params, (CASCADE_UPDATE_SCHEDULE)iSchedule, 1, &cache);
+
+			CascadeLightSpaceBounds bounds;
+			CascadeFitting::ComputeLightSpaceCascadeBounds(params, cache.m_LastResult.m_FrustumSlices, &bounds);
+			for (int i = 0;i < iCascadeCount;++i)
+			{
+				if (uUpdateMask & (1u << i))
+				{
+					++iUpdateCount;
+					continue;
+				}
+				// A clean tile is the fresh fit,whose diagonal padding need not cover the whole interval either.
+				if ((uDirtyMask & (1u << i)) == 0)
+				{
+					continue;
+				}
+
+				// Same view,and the deferred tile's rect has to contain the interval.
+				XMMATRIX matOld = cache.m_matRenderedShadowView[i] * cache.m_matRenderedOrthoProj[i];
+				XMVECTOR vMin = XMVector3Transform(XMVector3Transform(bounds.m_vMin[i], XMMatrixInverse(nullptr, cache.m_LastResult.m_matShadowView)), matOld);
+				XMVECTOR vMax = XMVector3Transform(XMVector3Transform(bounds.m_vMax[i], XMMatrixInverse(nullptr, cache.m_LastResult.m_matShadowView)), matOld);
+				if (!cache.m_bTileValid[i] || XMVectorGetX(vMin) < -1.0001f || XMVectorGetY(vMin) < -1.0001f
+					|| XMVectorGetX(vMax) > 1.0001f || XMVectorGetY(vMax) > 1.0001f)
+				{
+					++iErrorCount;
+				}
+
+				float fError = CascadeFitting::ComputeTileError(cache.m_LastResult.m_matOrthoProjForCascades[i], cache.m_matRenderedOrthoProj[i],
+					params.m_iLengthOfShadowBufferSquare);
+				fWorstError = fError > fWorstError ? fError : fWorstError;
+				if (fError > (float)CASCADE_FAR_GUARD_TEXELS)
+				{
+					++iErrorCount;
+				}
+			}
+			CascadeFitting::MarkCascadesRendered(params, uUpdateMask, &cache);
+		}
+
+		printf("%-12s %d cascades:%5.2f updates/frame,worst deferred tile error %.1f texels,%d guard texels\n", g_szScheduleNames[iSchedule], iCascadeCount,
+			(float)iUpdateCount / (float)viewerViews.size(), fWorstError, params.m_iFarCascadeGuardTexels);
+	}
+	return iErrorCount;
+}
+
+//--------------------------------------------------------------------------------------
+// Renders every changed cascade like CASCADE_UPDATE_EVERY_FRAME,but scrolls the tiles that can be scrolled,and
+// counts how much of the tiles still has to be rasterized per frame.
+//--------------------------------------------------------------------------------------
+static void ReportCascadeScrolling(const std::vector<XMMATRIX>& viewerViews, const std::vector<XMMATRIX>& lightViews, int iCascadeCount)
+{
+	CascadeFitParams params;
+	InitSampleParams(params);
+	SetDefaultPartitions(params, iCascadeCount);
+	double fTileTexels = (double)params.m_iLengthOfShadowBufferSquare * (double)params.m_iLengthOfShadowBufferSquare;
+
+	CascadeCache cache;
+	CascadeFitting::InvalidateCascadeCache(&cache);
+
+	int iUpdateCount = 0;
+	int iScrollCount = 0;
+	double fRasterizedTiles = 0.0;
+	for (size_t iPose = 0;iPose < viewerViews.size();++iPose)
+	{
+		params.m_matViewerCameraView = viewerViews[iPose];
+		params.m_matLightCameraView = lightViews[iPose];
+		CascadeFitting::FitCascadesCached(params, &cache);
+		unsigned int uUpdateMask = CascadeFitting::ScheduleCascadeUpdates(params, CASCADE_UPDATE_EVERY_FRAME, 0, &cache);
+		CascadeScroll scrolls[MAX_CASCADES];
+		unsigned int uScrollMask = CascadeFitting::ScheduleCascadeScrolls(params, uUpdateMask, &cache, scrolls);
+
+		for (int i = 0;i < iCascadeCount;++i)
+		{
+			if (uScrollMask & (1u << i))
+			{
+				CascadeTexelRect strips[2];
+				int nStripCount = CascadeFitting::GetScrollStrips(scrolls[i], params.m_iLengthOfShadowBufferSquare, strips);
+				for (int iStrip = 0;iStrip < nStripCount;++iStrip)
+				{
+					fRasterizedTiles += (double)(strips[iStrip].m_iRight - strips[iStrip].m_iLeft)
+						* (double)(strips[iStrip].m_iBottom - strips[iStrip].m_iTop) / fTileTexels;
+				}
+				++iScrollCount;
+			}
+			else if (uUpdateMask & (1u << i))
+			{
+				fRasterizedTiles += 1.0;
+			}
+			iUpdateCount += (uUpdateMask >> i) & 1;
+		}
+		CascadeFitting::MarkCascadesRendered(params, uUpdateMask & ~uScrollMask, &cache);
+		CascadeFitting::MarkCascadesScrolled(params, uScrollMask, scrolls, &cache);
+	}
+
+	printf("%-12s %d cascades:%5.2f updates/frame,%5.2f of them scrolled,%5.2f tiles rasterized/frame\n", "Scrolling", iCascadeCount,
+		(float)iUpdateCount / (float)viewerViews.size(), (float)iScrollCount / (float)viewerViews.size(),
+		(float)(fRasterizedTiles / (double)viewerViews.size()));
+}
+
+//--------------------------------------------------------------------------------------
+// Texel density of the manual splits against practical splits,averaged over the poses for a 1080 line screen.
+// The worst cascade decides how blocky the shadows look,so that is what is compared.
+//--------------------------------------------------------------------------------------
+static void ReportTexelDensity(const std::vector<XMMATRIX>& viewerViews, const std::vector<XMMATRIX>& lightViews, int iCascadeCount,
+	FIT_LIGHT_VIEW_FRUSTRUM eFitMode)
+{
+	static const float fLambdas[] = { 0.5f, 0.8f, 0.95f };
+	static const int iBufferSizes[] = { 2048, 1024, 512 };
+
+	printf("%-24s", g_szFitModeNames[eFitMode]);
+	for (int iSize = 0;iSize < 3;++iSize)
+	{
+		printf(" %7d", iBufferSizes[iSize]);
+	}
+	printf("\n");
+
+	for (int iSplit = -1;iSplit < 3;++iSplit)
+	{
+		CascadeFitParams params;
+		InitSampleParams(params);
+		SetDefaultPartitions(params, iCascadeCount);
+		params.m_eLightViewFrustumFitMode = eFitMode;
+
+		char label[64];
+		if (iSplit < 0)
+		{
+			snprintf(label, sizeof(label), "manual %d cascades", iCascadeCount);
+		}
+		else
+		{
+			params.m_eSplitMode = CASCADE_SPLIT_PRACTICAL;
+			params.m_fSplitLambda = fLambdas[iSplit];
+			snprintf(label, sizeof(label), "practical %.2f", fLambdas[iSplit]);
+		}
+		printf("%-24s", label);
+
+		for (int iSize = 0;iSize < 3;++iSize)
+		{
+			params.m_iLengthOfShadowBufferSquare = iBufferSizes[iSize];
+			CascadeFitResult result;
+			CascadeTexelDensity density;
+			double fSum = 0.0;
+			for (size_t iPose = 0;iPose < viewerViews.size();++iPose)
+			{
+				params.m_matViewerCameraView = viewerViews[iPose];
+				params.m_matLightCameraView = lightViews[iPose];
+				CascadeFitting::FitCascades(params, &result);
+				CascadeFitting::ComputeTexelDensity(params, result.m_matOrthoProjForCascades, result.m_FrustumSlices, 1080, &density);
+				fSum += density.m_fMinTexelsPerPixel;
+			}
+			printf(" %7.3f", fSum / (double)viewerViews.size());
+		}
+		printf("\n");
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Depth images for the depth bounds reduction are ray cast from a synthetic scene:the ground and a few
+// blocks inside the scene AABB.Pixels that hit nothing keep the cleared depth of 1.
+//--------------------------------------------------------------------------------------
+static const float g_fSyntheticBoxes[][6] =
+{
+	{ -280.0f, -20.0f, -280.0f, 280.0f, 0.0f, 280.0f },
+	{ -60.0f, 0.0f, -40.0f, 20.0f, 120.0f, 30.0f },
+	{ 80.0f, 0.0f, 60.0f, 140.0f, 70.0f, 150.0f },
+	{ -200.0f, 0.0f, 100.0f, -150.0f, 160.0f, 160.0f },
+	{ 120.0f, 0.0f, -200.0f, 200.0f, 40.0f, -120.0f },
+	{ -180.0f, 0.0f, -220.0f, -100.0f, 90.0f, -150.0f },
+};
+
+// Returns the true view depth range of the visible pixels in pMinDepthInView/pMaxDepthInView,or false for an empty image.
+static bool RenderSyntheticDepth(const CascadeFitParams& params, int iWidth, int iHeight, int iRowPitchInFloats, std::vector<float>& depth,
+	float* pMinDepthInView, float* pMaxDepthInView)
+{
+	depth.assign((size_t)iRowPitchInFloats * iHeight, 1.0f);
+
+	XMMATRIX matInverseView = XMMatrixInverse(nullptr, params.m_matViewerCameraView);
+	XMFLOAT3 vEye, vRight, vUp, vForward;
+	XMStoreFloat3(&vEye, matInverseView.r[3]);
+	XMStoreFloat3(&vRight, matInverseView.r[0]);
+	XMStoreFloat3(&vUp, matInverseView.r[1]);
+	XMStoreFloat3(&vForward, matInverseView.r[2]);
+	float f11 = XMVectorGetX(params.m_matViewerCameraProj.r[0]);
+	float f22 = XMVectorGetY(params.m_matViewerCameraProj.r[1]);
+	float f33 = XMVectorGetZ(params.m_matViewerCameraProj.r[2]);
+	float f43 = XMVectorGetZ(params.m_matViewerCameraProj.r[3]);
+
+	*pMinDepthInView = FLT_MAX;
+	*pMaxDepthInView = 0.0f;
+	for (int y = 0;y < iHeight;++y)
+	{
+		for (int x = 0;x < iWidth;++x)
+		{
+			// The ray has a view space z of 1,so the hit distance along it is the view depth.
+			float fViewX = (2.0f * ((float)x + 0.5f) / (float)iWidth - 1.0f) / f11;
+			float fViewY = (1.0f - 2.0f * ((float)y + 0.5f) / (float)iHeight) / f22;
+			float fDirection[3] =
+			{
+				vRight.x * fViewX + vUp.x * fViewY + vForward.x,
+				vRight.y * fViewX + vUp.y * fViewY + vForward.y,
+				vRight.z * fViewX + vUp.z * fViewY + vForward.z,
+			};
+			float fOrigin[3] = { vEye.x, vEye.y, vEye.z };
+
+			float fNearestHit = FLT_MAX;
+			for (size_t iBox = 0;iBox < sizeof(g_fSyntheticBoxes) / sizeof(g_fSyntheticBoxes[0]);++iBox)
+			{
+				float fEnter = 0.0f;
+				float fExit = FLT_MAX;
+				for (int iAxis = 0;iAxis < 3;++iAxis)
+				{
+					float fInverse = 1.0f / fDirection[iAxis];
+					float fT0 = (g_fSyntheticBoxes[iBox][iAxis] - fOrigin[iAxis]) * fInverse;
+					float fT1 = (g_fSyntheticBoxes[iBox][iAxis + 3] - fOrigin[iAxis]) * fInverse;
+					fEnter = fmaxf(fEnter, fminf(fT0, fT1));
+					fExit = fminf(fExit, fmaxf(fT0, fT1));
+				}
+				if (fEnter <= fExit && fEnter > 0.0f)
+				{
+					fNearestHit = fminf(fNearestHit, fEnter);
+				}
+			}
+
+			if (fNearestHit >= params.m_fViewerCameraNearClip && fNearestHit <= params.m_fViewerCameraFarClip)
+			{
+				depth[(size_t)y * iRowPitchInFloats + x] = f33 + f43 / fNearestHit;
+				*pMinDepthInView = fminf(*pMinDepthInView, fNearestHit);
+				*pMaxDepthInView = fmaxf(*pMaxDepthInView, fNearestHit);
+			}
+		}
+	}
+	return *pMinDepthInView <= *pMaxDepthInView;
+}
+
+// The plain loop ReduceDepthBounds has to agree with.
+static bool ReduceDepthBoundsReference(const float* pDepth, int iWidth, int iHeight, int iRowPitchInFloats, CXMMATRIX matViewerCameraProj,
+	float* pMinDepthInView, float* pMaxDepthInView)
+{
+	float fMin = FLT_MAX;
+	float fMax = 0.0f;
+	for (int y = 0;y < iHeight;++y)
+	{
+		for (int x = 0;x < iWidth;++x)
+		{
+			float fDepth = pDepth[y * iRowPitchInFloats + x];
+			if (fDepth < 1.0f)
+			{
+				fMin = fminf(fMin, fDepth);
+				fMax = fmaxf(fMax, fDepth);
+			}
+		}
+	}
+	if (fMin > fMax)
+	{
+		return false;
+	}
+	*pMinDepthInView = CascadeFitting::DepthBufferToViewDepth(matViewerCameraProj, fMin);
+	*pMaxDepthInView = CascadeFitting::DepthBufferToViewDepth(matViewerCameraProj, fMax);
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+// Splits over the camera range against splits over the visible depth range,for the worst cascade on a
+// 1080 line screen.The depth images are a quarter of 1080p,one every 16 poses.
+//--------------------------------------------------------------------------------------
+static void ReportDepthBounds(const std::vector<XMMATRIX>& viewerViews, const std::vector<XMMATRIX>& lightViews)
+{
+	CascadeFitParams params;
+	InitSampleParams(params);
+	std::vector<float> depth;
+	float fMinDepth, fMaxDepth;
+
+	// The reduction on a full 1080p image.
+	params.m_matViewerCameraView = viewerViews[0];
+	RenderSyntheticDepth(params, 1920, 1080, 1920, depth, &fMinDepth, &fMaxDepth);
+	double fBestSeconds = 1e30;
+	for (int iPass = 0;iPass < 5;++iPass)
+	{
+		auto begin = std::chrono::steady_clock::now();
+		CascadeFitting::ReduceDepthBounds(depth.data(), 1920, 1080, 1920, params.m_matViewerCameraProj, &fMinDepth, &fMaxDepth);
+		auto end = std::chrono::steady_clock::now();
+		double fSeconds = std::chrono::duration<double>(end - begin).count();
+		fBestSeconds = fSeconds < fBestSeconds ? fSeconds : fBestSeconds;
+	}
+	printf("depth bounds reduction:%.2f ms for 1920x1080 on the CPU\n", fBestSeconds * 1000.0);
+
+	printf("%-24s %9s %9s\n", "min texels/pixel", "camera", "visible");
+	double fVisibleRange = 0.0;
+	int iImageCount = 0;
+	for (int iSplit = 0;iSplit < 2;++iSplit)
+	{
+		params.m_eSplitMode = iSplit == 0 ? CASCADE_SPLIT_MANUAL : CASCADE_SPLIT_PRACTICAL;
+		params.m_fSplitLambda = 0.95f;
+
+		double fSum[2] = { 0.0, 0.0 };
+		iImageCount = 0;
+		fVisibleRange = 0.0;
+		for (size_t iPose = 0;iPose < viewerViews.size();iPose += 16)
+		{
+			params.m_matViewerCameraView = viewerViews[iPose];
+			params.m_matLightCameraView = lightViews[iPose];
+			RenderSyntheticDepth(params, 480, 270, 480, depth, &fMinDepth, &fMaxDepth);
+			params.m_bUseDepthBounds = CascadeFitting::ReduceDepthBounds(depth.data(), 480, 270, 480, params.m_matViewerCameraProj,
+				&params.m_fDepthBoundsMin, &params.m_fDepthBoundsMax);
+			fVisibleRange += params.m_bUseDepthBounds ? (params.m_fDepthBoundsMax - params.m_fDepthBoundsMin) / params.m_fViewerCameraFarClip : 1.0;
+			++iImageCount;
+
+			for (int iBounds = 0;iBounds < 2;++iBounds)
+			{
+				CascadeFitParams fitParams = params;
+				fitParams.m_bUseDepthBounds = params.m_bUseDepthBounds && iBounds == 1;
+
+				CascadeFitResult result;
+				CascadeTexelDensity density;
+				CascadeFitting::FitCascades(fitParams, &result);
+				CascadeFitting::ComputeTexelDensity(fitParams, result.m_matOrthoProjForCascades, result.m_FrustumSlices, 1080, &density);
+				fSum[iBounds] += density.m_fMinTexelsPerPixel;
+			}
+		}
+		printf("%-24s %9.3f %9.3f\n", iSplit == 0 ? "manual" : "practical 0.95", fSum[0] / iImageCount, fSum[1] / iImageCount);
+	}
+	printf("visible depth range:%.0f%% of the camera range on average\n", fVisibleRange / iImageCount * 100.0);
+}
+
+//--------------------------------------------------------------------------------------
+// ReduceDepthBounds against the plain loop on random images with odd sizes,row padding and sky,then on the
+// synthetic scene against the depths the rays hit.
+//--------------------------------------------------------------------------------------
+static float RandomFloat(unsigned int& uSeed, float fMin, float fMax);
+
+static int VerifyDepthReduction(const std::vector<XMMATRIX>& viewerViews, int iCaseCount)
+{
+	CascadeFitParams params;
+	InitSampleParams(params);
+
+	unsigned int uSeed = 777u;
+	int iMismatchCount = 0;
+	std::vector<float> depth;
+	for (int iCase = 0;iCase < iCaseCount;++iCase)
+	{
+		int iWidth = 1 + (int)RandomFloat(uSeed, 0.0f, 70.0f);
+		int iHeight = 1 + (int)RandomFloat(uSeed, 0.0f, 40.0f);
+		int iRowPitch = iWidth + (int)RandomFloat(uSeed, 0.0f, 6.0f);
+		float fSkyRatio = (iCase % 8 == 0) ? 1.0f : RandomFloat(uSeed, 0.0f, 1.0f);
+
+		// The row padding holds 0,which would win the min if it was read.
+		depth.assign((size_t)iRowPitch * iHeight, 0.0f);
+		for (int y = 0;y < iHeight;++y)
+		{
+			for (int x = 0;x < iWidth;++x)
+			{
+				depth[(size_t)y * iRowPitch + x] = RandomFloat(uSeed, 0.0f, 1.0f) < fSkyRatio ? 1.0f : RandomFloat(uSeed, 0.0f, 1.0f);
+			}
+		}
+
+		float fMin = 0.0f, fMax = 0.0f, fReferenceMin = 0.0f, fReferenceMax = 0.0f;
+		bool bFound = CascadeFitting::ReduceDepthBounds(depth.data(), iWidth, iHeight, iRowPitch, params.m_matViewerCameraProj, &fMin, &fMax);
+		bool bReferenceFound = ReduceDepthBoundsReference(depth.data(), iWidth, iHeight, iRowPitch, params.m_matViewerCameraProj,
+			&fReferenceMin, &fReferenceMax);
+		if (bFound != bReferenceFound || (bFound && (fMin != fReferenceMin || fMax != fReferenceMax)))
+		{
+			++iMismatchCount;
+		}
+	}
+
+	float fMaxError = 0.0f;
+	int iImageCount = 0;
+	for (size_t iPose = 0;iPose < viewerViews.size();iPose += 64)
+	{
+		params.m_matViewerCameraView = viewerViews[iPose];
+		float fTrueMin, fTrueMax, fMin, fMax;
+		bool bVisible = RenderSyntheticDepth(params, 256, 144, 259, depth, &fTrueMin, &fTrueMax);
+		bool bFound = CascadeFitting::ReduceDepthBounds(depth.data(), 256, 144, 259, params.m_matViewerCameraProj, &fMin, &fMax);
+		++iImageCount;
+		if (bVisible != bFound)
+		{
+			++iMismatchCount;
+			continue;
+		}
+		if (bFound)
+		{
+			// The depth buffer keeps less precision far away,so the error is relative.
+			float fError = fmaxf(fabsf(fMin - fTrueMin) / fTrueMin, fabsf(fMax - fTrueMax) / fTrueMax);
+			fMaxError = fmaxf(fMaxError, fError);
+			if (fError > 1e-2f)
+			{
+				++iMismatchCount;
+			}
+		}
+	}
+
+	printf("depth reduction:%d random images,%d synthetic images,%d mismatches,max relative depth error %g\n",
+		iCaseCount, iImageCount, iMismatchCount, fMaxError);
+	return iMismatchCount == 0 ? 0 : 1;
+}
+
+//--------------------------------------------------------------------------------------
+// A scene made of mesh subsets like the power plant:the ground in 4x4 tiles and blocks of random size
+// standing on it.
+//--------------------------------------------------------------------------------------
+static void BuildSyntheticSceneBounds(SceneBoundsHierarchy* pHierarchy)
+{
+	std::vector<XMFLOAT3> boxMin, boxMax;
+	for (int iTile = 0;iTile < 16;++iTile)
+	{
+		float fX = -280.0f + 140.0f * (float)(iTile % 4);
+		float fZ = -280.0f + 140.0f * (float)(iTile / 4);
+		boxMin.push_back(XMFLOAT3(fX, -20.0f, fZ));
+		boxMax.push_back(XMFLOAT3(fX + 140.0f, 0.0f, fZ + 140.0f));
+	}
+
+	unsigned int uSeed = 4242u;
+	for (int iBlock = 0;iBlock < 300;++iBlock)
+	{
+		float fX = RandomFloat(uSeed, -260.0f, 240.0f);
+		float fZ = RandomFloat(uSeed, -260.0f, 240.0f);
+		float fHeight = RandomFloat(uSeed, 0.0f, 1.0f);
+		fHeight = 5.0f + 155.0f * fHeight * fHeight * fHeight;
+		boxMin.push_back(XMFLOAT3(fX, 0.0f, fZ));
+		boxMax.push_back(XMFLOAT3(fX + RandomFloat(uSeed, 4.0f, 20.0f), fHeight, fZ + RandomFloat(uSeed, 4.0f, 20.0f)));
+	}
+
+	CascadeFitting::BuildSceneBoundsHierarchy(boxMin.data(), boxMax.data(), (int)boxMin.size(), pHierarchy);
+}
+
+//--------------------------------------------------------------------------------------
+// ComputeNearAndFarFromSceneBounds against every box intersected on its own,and against the scene AABB
+// it has to stay inside of.The ortho bounds are random rectangles in the light space of the poses.
+//--------------------------------------------------------------------------------------
+static int VerifySceneBounds(const std::vector<XMMATRIX>& lightViews, int iCaseCount)
+{
+	SceneBoundsHierarchy hierarchy;
+	BuildSyntheticSceneBounds(&hierarchy);
+	int nBoxCount = (int)hierarchy.m_vBoxMin.size();
+
+	unsigned int uSeed = 99u;
+	int iMismatchCount = 0;
+	float fMaxError = 0.0f;
+	for (int iCase = 0;iCase < iCaseCount;++iCase)
+	{
+		XMMATRIX matLightView = lightViews[iCase % lightViews.size()];
+		FIT_NEAR_FAR eNearFarFit = (iCase & 1) ? FIT_NEAR_FAR_SCENE_AABB_AND_ORTHO_BOUND : FIT_NEAR_FAR_ONLY_SCENE_AABB;
+		bool bAnalyticNearFar = (iCase & 2) != 0;
+
+		XMVECTOR vOrthographicMin[MAX_CASCADES], vOrthographicMax[MAX_CASCADES];
+		int nCascadeCount = 1 + iCase % MAX_CASCADES;
+		for (int i = 0;i < nCascadeCount;++i)
+		{
+			float fX = RandomFloat(uSeed, -450.0f, 450.0f);
+			float fY = RandomFloat(uSeed, -450.0f, 450.0f);
+			float fSize = RandomFloat(uSeed, 1.0f, 400.0f);
+			vOrthographicMin[i] = XMVectorSet(fX - fSize, fY - fSize, 0.0f, 0.0f);
+			vOrthographicMax[i] = XMVectorSet(fX + fSize, fY + fSize, 0.0f, 0.0f);
+		}
+
+		float fNear[MAX_CASCADES], fFar[MAX_CASCADES];
+		CascadeFitting::ComputeNearAndFarFromSceneBounds(hierarchy, matLightView, eNearFarFit, bAnalyticNearFar, nCascadeCount,
+			vOrthographicMin, vOrthographicMax, fNear, fFar);
+
+		// Every box on its own with the clipper,and the light space z range of the boxes that overlap.
+		float fBruteNear[MAX_CASCADES], fBruteFar[MAX_CASCADES];
+		for (int i = 0;i < nCascadeCount;++i)
+		{
+			fBruteNear[i] = FLT_MAX;
+			fBruteFar[i] = -FLT_MAX;
+		}
+		for (int iBox = 0;iBox < nBoxCount;++iBox)
+		{
+			XMVECTOR vBoxMin = XMLoadFloat3(&hierarchy.m_vBoxMin[iBox]);
+			XMVECTOR vBoxMax = XMLoadFloat3(&hierarchy.m_vBoxMax[iBox]);
+			XMVECTOR vPoints[8];
+			CascadeFitting::CreateAABBPoints(vPoints, XMVectorSetW((vBoxMin + vBoxMax) * 0.5f, 1.0f), (vBoxMax - vBoxMin) * 0.5f);
+			XMVECTOR vLightMin = g_XMFltMax;
+			XMVECTOR vLightMax = -g_XMFltMax;
+			for (int i = 0;i < 8;++i)
+			{
+				vPoints[i] = XMVector4Transform(vPoints[i], matLightView);
+				vLightMin = XMVectorMin(vLightMin, vPoints[i]);
+				vLightMax = XMVectorMax(vLightMax, vPoints[i]);
+			}
+
+			for (int i = 0;i < nCascadeCount;++i)
+			{
+				float fBoxNear, fBoxFar;
+				if (eNearFarFit == FIT_NEAR_FAR_ONLY_SCENE_AABB)
+				{
+					bool bOverlap = XMVectorGetX(vLightMin) <= XMVectorGetX(vOrthographicMax[i]) && XMVectorGetX(vLightMax) >= XMVectorGetX(vOrthographicMin[i])
+						&& XMVectorGetY(vLightMin) <= XMVectorGetY(vOrthographicMax[i]) && XMVectorGetY(vLightMax) >= XMVectorGetY(vOrthographicMin[i]);
+					fBoxNear = bOverlap ? XMVectorGetZ(vLightMin) : FLT_MAX;
+					fBoxFar = bOverlap ? XMVectorGetZ(vLightMax) : -FLT_MAX;
+				}
+				else
+				{
+					CascadeFitting::ComputeNearAndFarInViewSpace(fBoxNear, fBoxFar, vOrthographicMin[i], vOrthographicMax[i], vPoints);
+				}
+				fBruteNear[i] = fminf(fBruteNear[i], fBoxNear);
+				fBruteFar[i] = fmaxf(fBruteFar[i], fBoxFar);
+			}
+		}
+
+		for (int i = 0;i < nCascadeCount;++i)
+		{
+			bool bHit = fNear[i] <= fFar[i];
+			bool bBruteHit = fBruteNear[i] <= fBruteFar[i];
+			if (bHit != bBruteHit)
+			{
+				++iMismatchCount;
+				continue;
+			}
+			if (bHit)
+			{
+				float fError = fmaxf(fabsf(fNear[i] - fBruteNear[i]), fabsf(fFar[i] - fBruteFar[i]));
+				fMaxError = fmaxf(fMaxError, fError);
+				if (fError > 1e-2f)
+				{
+					++iMismatchCount;
+				}
+			}
+		}
+	}
+
+	printf("scene bounds:%d cases over %d boxes,%d mismatches,max error %g\n", iCaseCount, nBoxCount, iMismatchCount, fMaxError);
+	return iMismatchCount == 0 ? 0 : 1;
+}
+
+//--------------------------------------------------------------------------------------
+// Depth range of the cascades fitted to the scene AABB against the range fitted to the boxes under each
+// cascade,and what one step of a 16 bit shadow map is in world units.
+//--------------------------------------------------------------------------------------
+static void ReportSceneBounds(const std::vector<XMMATRIX>& viewerViews, const std::vector<XMMATRIX>& lightViews)
+{
+	SceneBoundsHierarchy hierarchy;
+	BuildSyntheticSceneBounds(&hierarchy);
+
+	printf("%-24s %9s %9s %9s %9s %9s\n", "mean depth range", "AABB", "boxes", "16 bit", "AABB ns", "boxes ns");
+	for (int iNearFarMode = FIT_NEAR_FAR_ONLY_SCENE_AABB;iNearFarMode <= FIT_NEAR_FAR_SCENE_AABB_AND_ORTHO_BOUND;++iNearFarMode)
+	{
+		CascadeFitParams params;
+		InitSampleParams(params);
+		params.m_eSelectedNearFarFit = (FIT_NEAR_FAR)iNearFarMode;
+
+		double fRange[2] = { 0.0, 0.0 };
+		double fNsPerFrame[2] = { 0.0, 0.0 };
+		for (int iBounds = 0;iBounds < 2;++iBounds)
+		{
+			params.m_pSceneBounds = iBounds == 1 ? &hierarchy : nullptr;
+			CascadeFitResult result;
+			auto begin = std::chrono::steady_clock::now();
+			for (size_t iPose = 0;iPose < viewerViews.size();++iPose)
+			{
+				params.m_matViewerCameraView = viewerViews[iPose];
+				params.m_matLightCameraView = lightViews[iPose];
+				CascadeFitting::FitCascades(params, &result);
+				for (int i = 0;i < params.m_nUsingCascadeLevelsCount;++i)
+				{
+					// An off center ortho projection has _33 = 1/(far - near).
+					fRange[iBounds] += 1.0 / XMVectorGetZ(result.m_matOrthoProjForCascades[i].r[2]);
+				}
+			}
+			auto end = std::chrono::steady_clock::now();
+			fNsPerFrame[iBounds] = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count() / (double)viewerViews.size();
+			fRange[iBounds] /= (double)(viewerViews.size() * params.m_nUsingCascadeLevelsCount);
+		}
+		printf("%-24s %9.1f %9.1f %9.4f %9.0f %9.0f\n", g_szNearFarModeNames[iNearFarMode], fRange[0], fRange[1], fRange[1] / 65535.0,
+			fNsPerFrame[0], fNsPerFrame[1]);
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// CullCasters against every box tested on its own.The ortho projections are random rectangles and depth
+// ranges in the light space of the poses.Every other case moves a few blocks and refits the hierarchy,as the
+// manager does for its dynamic casters.
+//--------------------------------------------------------------------------------------
+static int VerifyCasterCulling(const std::vector<XMMATRIX>& lightViews, int iCaseCount)
+{
+	SceneBoundsHierarchy hierarchy;
+	BuildSyntheticSceneBounds(&hierarchy);
+	int nBoxCount = (int)hierarchy.m_vBoxMin.size();
+	std::vector<unsigned int> boxCascadeMasks(nBoxCount);
+
+	std::vector<XMFLOAT3> movedBoxMin(nBoxCount), movedBoxMax(nBoxCount);
+	for (int iBox = 0;iBox < nBoxCount;++iBox)
+	{
+		movedBoxMin[hierarchy.m_iBoxIndex[iBox]] = hierarchy.m_vBoxMin[iBox];
+		movedBoxMax[hierarchy.m_iBoxIndex[iBox]] = hierarchy.m_vBoxMax[iBox];
+	}
+
+	unsigned int uSeed = 7u;
+	int iMismatchCount = 0;
+	for (int iCase = 0;iCase < iCaseCount;++iCase)
+	{
+		if (iCase & 1)
+		{
+			for (int iBox = iCase % 16;iBox < nBoxCount;iBox += 16)
+			{
+				XMVECTOR vMove = XMVectorSet(RandomFloat(uSeed, -60.0f, 60.0f), RandomFloat(uSeed, -10.0f, 30.0f), RandomFloat(uSeed, -60.0f, 60.0f), 0.0f);
+				XMStoreFloat3(&movedBoxMin[iBox], XMLoadFloat3(&movedBoxMin[iBox]) + vMove);
+				XMStoreFloat3(&movedBoxMax[iBox], XMLoadFloat3(&movedBoxMax[iBox]) + vMove);
+			}
+			CascadeFitting::RefitSceneBoundsHierarchy(movedBoxMin.data(), movedBoxMax.data(), &hierarchy);
+		}
+
+		XMMATRIX matLightView = lightViews[iCase % lightViews.size()];
+		XMMATRIX matOrthoProj[MAX_CASCADES];
+		int nCascadeCount = 1 + iCase % MAX_CASCADES;
+		for (int i = 0;i < nCascadeCount;++i)
+		{
+			float fX = RandomFloat(uSeed, -450.0f, 450.0f);
+			float fY = RandomFloat(uSeed, -450.0f, 450.0f);
+			float fSize = RandomFloat(uSeed, 1.0f, 400.0f);
+			float fNear = RandomFloat(uSeed, 0.0f, 600.0f);
+			float fFar = fNear + RandomFloat(uSeed, 1.0f, 600.0f);
+			matOrthoProj[i] = XMMatrixOrthographicOffCenterLH(fX - fSize, fX + fSize, fY - fSize, fY + fSize, fNear, fFar);
+		}
+
+		CascadeFitting::CullCasters(hierarchy, matLightView, nCascadeCount, matOrthoProj, boxCascadeMasks.data());
+
+		// A box is drawn into a cascade when its light space bounds project into the tile in x,y and before
+		// the far plane in z.
+		for (int iBox = 0;iBox < nBoxCount;++iBox)
+		{
+			XMVECTOR vBoxMin = XMLoadFloat3(&hierarchy.m_vBoxMin[iBox]);
+			XMVECTOR vBoxMax = XMLoadFloat3(&hierarchy.m_vBoxMax[iBox]);
+			XMVECTOR vPoints[8];
+			CascadeFitting::CreateAABBPoints(vPoints, XMVectorSetW((vBoxMin + vBoxMax) * 0.5f, 1.0f), (vBoxMax - vBoxMin) * 0.5f);
+
+			// The two tests round differently,so only boxes clearly inside or outside of a tile have to agree.
+			unsigned int uInsideMask = 0;
+			unsigned int uOverlapMask = 0;
+			for (int i = 0;i < nCascadeCount;++i)
+			{
+				XMVECTOR vProjMin = g_XMFltMax;
+				XMVECTOR vProjMax = -g_XMFltMax;
+				for (int iPoint = 0;iPoint < 8;++iPoint)
+				{
+					XMVECTOR vProj = XMVector4Transform(vPoints[iPoint], matLightView * matOrthoProj[i]);
+					vProjMin = XMVectorMin(vProjMin, vProj);
+					vProjMax = XMVectorMax(vProjMax, vProj);
+				}
+				for (int iMargin = -1;iMargin <= 1;iMargin += 2)
+				{
+					float fBorder = 1.0f + (float)iMargin * 1e-4f;
+					if (XMVectorGetX(vProjMin) <= fBorder && XMVectorGetX(vProjMax) >= -fBorder
+						&& XMVectorGetY(vProjMin) <= fBorder && XMVectorGetY(vProjMax) >= -fBorder
+						&& XMVectorGetZ(vProjMin) <= fBorder)
+					{
+						(iMargin < 0 ? uInsideMask : uOverlapMask) |= 1u << i;
+					}
+				}
+			}
+
+			unsigned int uMask = boxCascadeMasks[hierarchy.m_iBoxIndex[iBox]];
+			if ((uMask & uInsideMask) != uInsideMask || (uMask & ~uOverlapMask) != 0)
+			{
+				++iMismatchCount;
+			}
+		}
+	}
+
+	printf("caster culling:%d cases over %d boxes,%d mismatches\n", iCaseCount, nBoxCount, iMismatchCount);
+	return iMismatchCount == 0 ? 0 : 1;
+}
+
+//--------------------------------------------------------------------------------------
+// CullSmallCasters against the texel footprint of every box's projected corners.The maps are small and the
+// thresholds large,so that the boxes of the synthetic scene fall on both sides.
+//--------------------------------------------------------------------------------------
+static int VerifySmallCasterCulling(const std::vector<XMMATRIX>& lightViews, int iCaseCount)
+{
+	SceneBoundsHierarchy hierarchy;
+	BuildSyntheticSceneBounds(&hierarchy);
+	int nBoxCount = (int)hierarchy.m_vBoxMin.size();
+	std::vector<unsigned int> boxCascadeMasks(nBoxCount);
+
+	unsigned int uSeed = 11u;
+	int iMismatchCount = 0;
+	int nCulledCount = 0;
+	for (int iCase = 0;iCase < iCaseCount;++iCase)
+	{
+		XMMATRIX matLightView = lightViews[iCase % lightViews.size()];
+		XMMATRIX matOrthoProj[MAX_CASCADES];
+		int nCascadeCount = 1 + iCase % MAX_CASCADES;
+		int iLengthOfShadowBuffer[MAX_CASCADES];
+		float fMinTexels = RandomFloat(uSeed, 0.0f, 32.0f);
+		for (int i = 0;i < nCascadeCount;++i)
+		{
+			iLengthOfShadowBuffer[i] = 64 << ((iCase + i) % 4);
+			float fSize = RandomFloat(uSeed, 10.0f, 400.0f);
+			matOrthoProj[i] = XMMatrixOrthographicOffCenterLH(-fSize, fSize, -fSize, fSize, 0.0f, 600.0f);
+		}
+
+		// Every bit starts set,some of the boxes keep bits above the cascade count like the unculled masks do.
+		for (int iBox = 0;iBox < nBoxCount;++iBox)
+		{
+			boxCascadeMasks[iBox] = (iBox & 1) ? ~0u : (1u << nCascadeCount) - 1;
+		}
+		int nCulledPerCascade[MAX_CASCADES] = {};
+		int nCaseCulledCount = CascadeFitting::CullSmallCasters(hierarchy, matLightView, nCascadeCount, matOrthoProj,
+			iLengthOfShadowBuffer, fMinTexels, boxCascadeMasks.data(), nCulledPerCascade);
+		nCulledCount += nCaseCulledCount;
+
+		int nExpectedPerCascade[MAX_CASCADES] = {};
+		for (int iBox = 0;iBox < nBoxCount;++iBox)
+		{
+			XMVECTOR vBoxMin = XMLoadFloat3(&hierarchy.m_vBoxMin[iBox]);
+			XMVECTOR vBoxMax = XMLoadFloat3(&hierarchy.m_vBoxMax[iBox]);
+			XMVECTOR vPoints[8];
+			CascadeFitting::CreateAABBPoints(vPoints, XMVectorSetW((vBoxMin + vBoxMax) * 0.5f, 1.0f), (vBoxMax - vBoxMin) * 0.5f);
+
+			unsigned int uMask = boxCascadeMasks[hierarchy.m_iBoxIndex[iBox]];
+			unsigned int uUnculledMask = (hierarchy.m_iBoxIndex[iBox] & 1) ? ~0u : (1u << nCascadeCount) - 1;
+			iMismatchCount += (uMask >> nCascadeCount) != (uUnculledMask >> nCascadeCount) ? 1 : 0;
+			for (int i = 0;i < nCascadeCount;++i)
+			{
+				XMVECTOR vProjMin = g_XMFltMax;
+				XMVECTOR vProjMax = -g_XMFltMax;
+				for (int iPoint = 0;iPoint < 8;++iPoint)
+				{
+					XMVECTOR vProj = XMVector4Transform(vPoints[iPoint], matLightView * matOrthoProj[i]);
+					vProjMin = XMVectorMin(vProjMin, vProj);
+					vProjMax = XMVectorMax(vProjMax, vProj);
+				}
+				XMVECTOR vTexels = (vProjMax - vProjMin) * (0.5f * (float)iLengthOfShadowBuffer[i]);
+				float fTexels = std::max(XMVectorGetX(vTexels), XMVectorGetY(vTexels));
+
+				// Only boxes clearly above or below the threshold have to agree.
+				bool bCulled = (uMask & (1u << i)) == 0;
+				if (fabsf(fTexels - fMinTexels) > 1e-3f * std::max(fMinTexels, 1.0f) && bCulled != (fTexels < fMinTexels))
+				{
+					++iMismatchCount;
+				}
+				nExpectedPerCascade[i] += bCulled ? 1 : 0;
+			}
+		}
+
+		int nSum = 0;
+		for (int i = 0;i < nCascadeCount;++i)
+		{
+			iMismatchCount += nCulledPerCascade[i] != nExpectedPerCascade[i] ? 1 : 0;
+			nSum += nCulledPerCascade[i];
+		}
+		iMismatchCount += nSum != nCaseCulledCount ? 1 : 0;
+	}
+
+	printf("sub-texel caster culling:%d cases over %d boxes,%d culled,%d mismatches\n", iCaseCount, nBoxCount, nCulledCount, iMismatchCount);
+	return iMismatchCount == 0 ? 0 : 1;
+}
+
+//--------------------------------------------------------------------------------------
+// Moves a rendered tile's projection by whole texels,by a fraction of a texel,to another texel size and to a
+// depth range outside of the rendered one.Only the first may scroll,with the expected shift and origin,its
+// strips and kept texels have to cover the tile once and every kept texel has to stay where it was stored.
+//--------------------------------------------------------------------------------------
+static int VerifyCascadeScrolling(int iCaseCount)
+{
+	CascadeFitParams params;
+	InitSampleParams(params);
+	int iTileSize = params.m_iLengthOfShadowBufferSquare;
+
+	unsigned int uSeed = 4242u;
+	int iErrorCount = 0;
+	int iScrollCount = 0;
+	for (int iCase = 0;iCase < iCaseCount;++iCase)
+	{
+		CascadeCache cache;
+		CascadeFitting::InvalidateCascadeCache(&cache);
+
+		float fLeft = RandomFloat(uSeed, -500.0f, 500.0f);
+		float fBottom = RandomFloat(uSeed, -500.0f, 500.0f);
+		float fSize = RandomFloat(uSeed, 10.0f, 800.0f);
+		float fNear = RandomFloat(uSeed, -200.0f, 200.0f);
+		float fFar = fNear + RandomFloat(uSeed, 10.0f, 600.0f);
+		float fTexelSize = fSize / (float)iTileSize;
+
+		cache.m_bTileValid[0] = true;
+		cache.m_eRenderedNearFarFit[0] = params.m_eSelectedNearFarFit;
+		cache.m_matRenderedShadowView[0] = XMMatrixIdentity();
+		cache.m_matRenderedOrthoProj[0] = XMMatrixOrthographicOffCenterLH(fLeft, fLeft + fSize, fBottom, fBottom + fSize, fNear, fFar);
+		cache.m_iTileOriginX[0] = (int)RandomFloat(uSeed, 0.0f, (float)iTileSize);
+		cache.m_iTileOriginY[0] = (int)RandomFloat(uSeed, 0.0f, (float)iTileSize);
+		cache.m_LastResult.m_matShadowView = XMMatrixIdentity();
+
+		int iMoveX = (int)RandomFloat(uSeed, -0.75f * (float)iTileSize, 0.75f * (float)iTileSize);
+		int iMoveY = (int)RandomFloat(uSeed, -0.75f * (float)iTileSize, 0.75f * (float)iTileSize);
+		float fNewLeft = fLeft + (float)iMoveX * fTexelSize;
+		float fNewBottom = fBottom + (float)iMoveY * fTexelSize;
+		float fNewSize = fSize;
+		float fNewNear = fNear + RandomFloat(uSeed, 0.0f, 0.4f) * (fFar - fNear);
+		float fNewFar = fFar - RandomFloat(uSeed, 0.0f, 0.4f) * (fFar - fNear);
+		int iVariant = iCase % 4;
+		if (iVariant == 1)
+		{
+			fNewLeft += 0.5f * fTexelSize;
+		}
+		else if (iVariant == 2)
+		{
+			fNewSize *= 1.01f;
+		}
+		else if (iVariant == 3)
+		{
+			fNewNear = fNear - 1.0f;
+		}
+		cache.m_LastResult.m_matOrthoProjForCascades[0] = XMMatrixOrthographicOffCenterLH(fNewLeft, fNewLeft + fNewSize,
+			fNewBottom, fNewBottom + fNewSize, fNewNear, fNewFar);
+
+		CascadeScroll scrolls[MAX_CASCADES];
+		unsigned int uScrollMask = CascadeFitting::ScheduleCascadeScrolls(params, 1u, &cache, scrolls);
+		if (uScrollMask != (iVariant == 0 ? 1u : 0u))
+		{
+			++iErrorCount;
+			continue;
+		}
+		if (uScrollMask == 0)
+		{
+			continue;
+		}
+		++iScrollCount;
+
+		// Moving the window right moves the depth left,moving it up moves the depth down the tile.
+		const CascadeScroll& scroll = scrolls[0];
+		XMMATRIX matProj = cache.m_LastResult.m_matOrthoProjForCascades[0];
+		if (scroll.m_iShiftX != -iMoveX || scroll.m_iShiftY != iMoveY
+			|| XMVectorGetZ(matProj.r[2]) != XMVectorGetZ(cache.m_matRenderedOrthoProj[0].r[2])
+			|| XMVectorGetZ(matProj.r[3]) != XMVectorGetZ(cache.m_matRenderedOrthoProj[0].r[3]))
+		{
+			++iErrorCount;
+		}
+
+		CascadeTexelRect strips[2];
+		int nStripCount = CascadeFitting::GetScrollStrips(scroll, iTileSize, strips);
+		long long nCoveredTexels = (long long)(iTileSize - abs(scroll.m_iShiftX)) * (long long)(iTileSize - abs(scroll.m_iShiftY));
+		for (int iStrip = 0;iStrip < nStripCount;++iStrip)
+		{
+			const CascadeTexelRect& strip = strips[iStrip];
+			if (strip.m_iLeft < 0 || strip.m_iTop < 0 || strip.m_iRight > iTileSize || strip.m_iBottom > iTileSize)
+			{
+				++iErrorCount;
+			}
+			nCoveredTexels += (long long)(strip.m_iRight - strip.m_iLeft) * (long long)(strip.m_iBottom - strip.m_iTop);
+
+			// The strip's projection is the same window as its texels of the cascade's projection.
+			XMMATRIX matStripProj = CascadeFitting::GetTexelRectOrthoProj(matProj, strip, iTileSize);
+			XMVECTOR vCorner = XMVectorSet(-1.0f, 1.0f, 0.5f, 1.0f);
+			XMVECTOR vCornerInCascade = XMVector3Transform(XMVector3Transform(vCorner, XMMatrixInverse(nullptr, matStripProj)), matProj);
+			float fTexelX = (XMVectorGetX(vCornerInCascade) * 0.5f + 0.5f) * (float)iTileSize;
+			float fTexelY = (-XMVectorGetY(vCornerInCascade) * 0.5f + 0.5f) * (float)iTileSize;
+			if (fabsf(fTexelX - (float)strip.m_iLeft) > 0.05f || fabsf(fTexelY - (float)strip.m_iTop) > 0.05f
+				|| fabsf(XMVectorGetZ(vCornerInCascade) - 0.5f) > 1e-3f)
+			{
+				++iErrorCount;
+			}
+		}
+		if (nCoveredTexels != (long long)iTileSize * (long long)iTileSize)
+		{
+			++iErrorCount;
+		}
+
+		// A kept texel is stored where the rendered projection put it.
+		int iKeptX = scroll.m_iShiftX > 0 ? iTileSize - 1 : 0;
+		int iKeptY = scroll.m_iShiftY > 0 ? iTileSize - 1 : 0;
+		int iRenderedX = iKeptX - scroll.m_iShiftX;
+		int iRenderedY = iKeptY - scroll.m_iShiftY;
+		if ((iKeptX + scroll.m_iOriginX) % iTileSize != (iRenderedX + cache.m_iTileOriginX[0]) % iTileSize
+			|| (iKeptY + scroll.m_iOriginY) % iTileSize != (iRenderedY + cache.m_iTileOriginY[0]) % iTileSize)
+		{
+			++iErrorCount;
+		}
+
+		CascadeFitting::MarkCascadesScrolled(params, uScrollMask, scrolls, &cache);
+		if (cache.m_iTileOriginX[0] != scroll.m_iOriginX || cache.m_iTileOriginY[0] != scroll.m_iOriginY
+			|| CascadeFitting::GetDirtyCascadeMask(params, cache) & 1u)
+		{
+			++iErrorCount;
+		}
+	}
+
+	printf("scrolling:%d cases,%d scrolled,%d errors\n", iCaseCount, iScrollCount, iErrorCount);
+	return iErrorCount == 0 ? 0 : 1;
+}
+
+// The vertex layout of the sample's meshes,the simplifier only reads the position.
+struct BenchVertex
+{
+	XMFLOAT3 m_vPosition;
+	XMFLOAT3 m_vNormal;
+	XMFLOAT2 m_vTexcoord;
+};
+
+// A latitude/longitude sphere like an exporter writes it:the seam and the poles have a vertex per slice.
+static void BuildSphere(int nSlices, int nStacks, float fRadius, std::vector<BenchVertex>& vertices, std::vector<unsigned int>& indices)
+{
+	vertices.clear();
+	indices.clear();
+	for (int iStack = 0;iStack <= nStacks;++iStack)
+	{
+		for (int iSlice = 0;iSlice <= nSlices;++iSlice)
+		{
+			float fTheta = XM_PI * (float)iStack / (float)nStacks;
+			float fPhi = XM_2PI * (float)(iSlice % nSlices) / (float)nSlices;
+			BenchVertex vertex;
+			vertex.m_vNormal = XMFLOAT3(sinf(fTheta) * cosf(fPhi), cosf(fTheta), sinf(fTheta) * sinf(fPhi));
+			if (iStack == 0 || iStack == nStacks)
+			{
+				vertex.m_vNormal = XMFLOAT3(0.0f, iStack == 0 ? 1.0f : -1.0f, 0.0f);
+			}
+			vertex.m_vPosition = XMFLOAT3(vertex.m_vNormal.x * fRadius, vertex.m_vNormal.y * fRadius, vertex.m_vNormal.z * fRadius);
+			vertex.m_vTexcoord = XMFLOAT2((float)iSlice / (float)nSlices, (float)iStack / (float)nStacks);
+			vertices.push_back(vertex);
+		}
+	}
+	for (int iStack = 0;iStack < nStacks;++iStack)
+	{
+		for (int iSlice = 0;iSlice < nSlices;++iSlice)
+		{
+			unsigned int i0 = iStack * (nSlices + 1) + iSlice;
+			unsigned int i1 = i0 + nSlices + 1;
+			unsigned int quad[6] = { i0,i0 + 1,i1,i1,i0 + 1,i1 + 1 };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+}
+
+// Checks a simplified level:its index values are vertices of the full list,it has no degenerate triangle and,
+// for a closed mesh,every edge is shared by exactly two triangles.Returns the problems found,pfArea gets the
+// summed triangle area and pfMinNormalY the lowest y of the triangle normals.
+static int CheckMeshLod(const std::vector<BenchVertex>& vertices, const std::vector<unsigned int>& fullIndices, const unsigned int* pIndices,
+	int nIndexCount, bool bClosed, float* pfArea, float* pfMinNormalY)
+{
+	int nErrorCount = 0;
+	std::vector<unsigned int> fullValues(fullIndices);
+	std::sort(fullValues.begin(), fullValues.end());
+	std::vector<std::pair<unsigned int, unsigned int>> edges;
+	*pfArea = 0.0f;
+	*pfMinNormalY = FLT_MAX;
+	for (int i = 0;i < nIndexCount;i += 3)
+	{
+		for (int k = 0;k < 3;++k)
+		{
+			if (!std::binary_search(fullValues.begin(), fullValues.end(), pIndices[i + k]))
+			{
+				++nErrorCount;
+			}
+			edges.push_back(std::make_pair(std::min(pIndices[i + k], pIndices[i + (k + 1) % 3]), std::max(pIndices[i + k], pIndices[i + (k + 1) % 3])));
+		}
+		XMVECTOR v0 = XMLoadFloat3(&vertices[pIndices[i]].m_vPosition);
+		XMVECTOR vCross = XMVector3Cross(XMLoadFloat3(&vertices[pIndices[i + 1]].m_vPosition) - v0, XMLoadFloat3(&vertices[pIndices[i + 2]].m_vPosition) - v0);
+		float fDoubleArea = XMVectorGetX(XMVector3Length(vCross));
+		if (fDoubleArea <= 0.0f)
+		{
+			++nErrorCount;
+			continue;
+		}
+		*pfArea += 0.5f * fDoubleArea;
+		*pfMinNormalY = std::min(*pfMinNormalY, XMVectorGetY(vCross) / fDoubleArea);
+	}
+
+	if (bClosed)
+	{
+		std::sort(edges.begin(), edges.end());
+		for (size_t i = 0;i < edges.size();)
+		{
+			size_t iEnd = i;
+			while (iEnd < edges.size() && edges[iEnd] == edges[i])
+			{
+				++iEnd;
+			}
+			nErrorCount += (iEnd - i == 2) ? 0 : 1;
+			i = iEnd;
+		}
+	}
+	return nErrorCount;
+}
+
+//--------------------------------------------------------------------------------------
+// Simplifies a tessellated square and a sphere with split seams.The square has to keep its outline,area
+// and facing at every level without any error,the sphere has to stay closed.Every level has to drop to the
+// requested part of the triangles with an error that does not shrink.
+//--------------------------------------------------------------------------------------
+static int VerifyMeshSimplification()
+{
+	int nErrorCount = 0;
+
+	// A 32x32 quad square in the xz plane facing up,the two halves have vertices of their own along x = 16.
+	const int nQuads = 32;
+	std::vector<BenchVertex> vertices;
+	std::vector<unsigned int> indices;
+	for (int iHalf = 0;iHalf < 2;++iHalf)
+	{
+		unsigned int uFirstVertex = (unsigned int)vertices.size();
+		int iFirstColumn = iHalf * nQuads / 2;
+		for (int z = 0;z <= nQuads;++z)
+		{
+			for (int x = iFirstColumn;x <= iFirstColumn + nQuads / 2;++x)
+			{
+				BenchVertex vertex = { XMFLOAT3((float)x, 0.0f, (float)z), XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT2(0.0f, 0.0f) };
+				vertices.push_back(vertex);
+			}
+		}
+		for (int z = 0;z < nQuads;++z)
+		{
+			for (int x = 0;x < nQuads / 2;++x)
+			{
+				unsigned int i0 = uFirstVertex + z * (nQuads / 2 + 1) + x;
+				unsigned int i1 = i0 + nQuads / 2 + 1;
+				unsigned int quad[6] = { i0,i1,i0 + 1,i0 + 1,i1,i1 + 1 };
+				indices.insert(indices.end(), quad, quad + 6);
+			}
+		}
+	}
+
+	MeshLodChain chain;
+	MeshSimplification::BuildLodChain(&vertices[0].m_vPosition, sizeof(BenchVertex), indices.data(), (int)indices.size(), 16, 0.5f, 0.01f, &chain);
+	int nLastTriangles = (int)indices.size() / 3;
+	for (size_t iLod = 0;iLod < chain.m_Lods.size();++iLod)
+	{
+		const MeshLod& lod = chain.m_Lods[iLod];
+		float fArea, fMinNormalY;
+		nErrorCount += CheckMeshLod(vertices, indices, &chain.m_Indices[lod.m_iFirstIndex], lod.m_nIndexCount, false, &fArea, &fMinNormalY);
+		nErrorCount += fabsf(fArea - (float)(nQuads * nQuads)) > 1e-3f * (float)(nQuads * nQuads) ? 1 : 0;
+		nErrorCount += fMinNormalY < 0.9999f ? 1 : 0;
+		nErrorCount += lod.m_fError > 1e-3f ? 1 : 0;
+		nErrorCount += lod.m_nIndexCount / 3 > nLastTriangles / 2 && iLod + 1 < chain.m_Lods.size() ? 1 : 0;
+		nLastTriangles = lod.m_nIndexCount / 3;
+	}
+	int nSquareTriangles = nLastTriangles;
+	nErrorCount += nSquareTriangles > 8 ? 1 : 0;
+
+	// The sphere's error has to grow with every level and may not pass the limit.
+	BuildSphere(32, 16, 10.0f, vertices, indices);
+	MeshSimplification::BuildLodChain(&vertices[0].m_vPosition, sizeof(BenchVertex), indices.data(), (int)indices.size(), 6, 0.5f, 2.0f, &chain);
+	nErrorCount += chain.m_Lods.size() < 3 ? 1 : 0;
+	nLastTriangles = 32 * 14 * 2 + 2 * 32;
+	float fLastError = 0.0f;
+	for (size_t iLod = 0;iLod < chain.m_Lods.size();++iLod)
+	{
+		const MeshLod& lod = chain.m_Lods[iLod];
+		float fArea, fMinNormalY;
+		nErrorCount += CheckMeshLod(vertices, indices, &chain.m_Indices[lod.m_iFirstIndex], lod.m_nIndexCount, true, &fArea, &fMinNormalY);
+		nErrorCount += lod.m_fError < fLastError || lod.m_fError > 2.0f ? 1 : 0;
+		nErrorCount += lod.m_nIndexCount / 3 > nLastTriangles / 2 && iLod + 1 < chain.m_Lods.size() ? 1 : 0;
+		nLastTriangles = lod.m_nIndexCount / 3;
+		fLastError = lod.m_fError;
+	}
+
+	int nLodCount = (int)chain.m_Lods.size();
+	nErrorCount += MeshSimplification::SelectLod(chain.m_Lods.data(), nLodCount, -1.0f) != 0 ? 1 : 0;
+	nErrorCount += MeshSimplification::SelectLod(chain.m_Lods.data(), nLodCount, FLT_MAX) != nLodCount ? 1 : 0;
+	nErrorCount += MeshSimplification::SelectLod(chain.m_Lods.data(), nLodCount, chain.m_Lods[0].m_fError) < 1 ? 1 : 0;
+
+	printf("simplification:square %d->%d triangles,sphere %d->%d triangles in %d levels,%d errors\n", nQuads * nQuads * 2, nSquareTriangles,
+		32 * 14 * 2 + 2 * 32, nLastTriangles, nLodCount, nErrorCount);
+	return nErrorCount == 0 ? 0 : 1;
+}
+
+//--------------------------------------------------------------------------------------
+// How long a dense sphere takes to simplify and how fast its error grows,in radii.
+//--------------------------------------------------------------------------------------
+static void ReportMeshSimplification()
+{
+	std::vector<BenchVertex> vertices;
+	std::vector<unsigned int> indices;
+	BuildSphere(256, 128, 1.0f, vertices, indices);
+
+	MeshLodChain chain;
+	auto begin = std::chrono::steady_clock::now();
+	MeshSimplification::BuildLodChain(&vertices[0].m_vPosition, sizeof(BenchVertex), indices.data(), (int)indices.size(), 8, 0.5f, 0.1f, &chain);
+	auto end = std::chrono::steady_clock::now();
+
+	printf("simplified a %d triangle sphere in %.1f ms:", (int)indices.size() / 3, std::chrono::duration<double>(end - begin).count() * 1e3);
+	for (size_t iLod = 0;iLod < chain.m_Lods.size();++iLod)
+	{
+		printf(" %d (%.4f)", chain.m_Lods[iLod].m_nIndexCount / 3, chain.m_Lods[iLod].m_fError);
+	}
+	printf("\n");
+}
+
+//--------------------------------------------------------------------------------------
+// Packs random cascade lengths into an atlas as tall as the largest one.No two tiles may overlap or leave the
+// atlas.Equal lengths have to keep the layout of the equal tiles,cascade i at i lengths.A fit whose per
+// cascade lengths all equal m_iLengthOfShadowBufferSquare has to match the fit that leaves them 0,and a
+// cascade of half the length fitted to the scene has to get texels twice as large.
+//--------------------------------------------------------------------------------------
+static int VerifyAtlasPacking(const std::vector<XMMATRIX>& viewerViews, const std::vector<XMMATRIX>& lightViews, int iCaseCount)
+{
+	unsigned int uSeed = 4242u;
+	int iMismatchCount = 0;
+	for (int iCase = 0;iCase < iCaseCount;++iCase)
+	{
+		// Powers of two like the halving lengths,every fourth case any multiple of 32.
+		int nCascadeCount = 1 + iCase % MAX_CASCADES;
+		int iLengths[MAX_CASCADES];
+		int iAtlasHeight = 0;
+		for (int i = 0;i < nCascadeCount;++i)
+		{
+			iLengths[i] = (iCase % 4 == 3) ? 32 * (1 + (int)RandomFloat(uSeed, 0.0f, 64.0f)) : 128 << (int)RandomFloat(uSeed, 0.0f, 5.0f);
+			iAtlasHeight = std::max(iAtlasHeight, iLengths[i]);
+		}
+
+		AtlasRect rects[MAX_CASCADES];
+		int iAtlasWidth = AtlasPacking::PackSquaresSkyline(iLengths, nCascadeCount, iAtlasHeight, rects);
+		if (iAtlasWidth <= 0 || !AtlasPacking::AreRectsDisjointInAtlas(rects, nCascadeCount, iAtlasWidth, iAtlasHeight))
+		{
+			++iMismatchCount;
+			continue;
+		}
+		for (int i = 0;i < nCascadeCount;++i)
+		{
+			iMismatchCount += (rects[i].m_iWidth != iLengths[i] || rects[i].m_iHeight != iLengths[i]) ? 1 : 0;
+		}
+	}
+
+	for (int nCascadeCount = 1;nCascadeCount <= MAX_CASCADES;++nCascadeCount)
+	{
+		int iLengths[MAX_CASCADES];
+		for (int i = 0;i < nCascadeCount;++i)
+		{
+			iLengths[i] = 1024;
+		}
+		AtlasRect rects[MAX_CASCADES];
+		int iAtlasWidth = AtlasPacking::PackSquaresSkyline(iLengths, nCascadeCount, 1024, rects);
+		iMismatchCount += iAtlasWidth != 1024 * nCascadeCount ? 1 : 0;
+		for (int i = 0;i < nCascadeCount;++i)
+		{
+			iMismatchCount += (rects[i].m_iX != 1024 * i || rects[i].m_iY != 0) ? 1 : 0;
+		}
+	}
+
+	// A tile taller than the atlas does not fit.
+	int iTooTall[2] = { 512, 2048 };
+	AtlasRect tooTallRects[2];
+	iMismatchCount += AtlasPacking::PackSquaresSkyline(iTooTall, 2, 1024, tooTallRects) != -1 ? 1 : 0;
+
+	for (int iFitMode = FIT_LIGHT_VIEW_FRUSTRUM_TO_CASCADE_INTERVALS;iFitMode <= FIT_LIGHT_VIEW_FRUSTRUM_TO_SCENE;++iFitMode)
+	{
+		CascadeFitParams params;
+		InitSampleParams(params);
+		params.m_eLightViewFrustumFitMode = (FIT_LIGHT_VIEW_FRUSTRUM)iFitMode;
+		CascadeFitParams explicitParams = params;
+		CascadeFitParams halvingParams = params;
+		for (int i = 0;i < params.m_nUsingCascadeLevelsCount;++i)
+		{
+			explicitParams.m_iCascadeLengthOfShadowBuffer[i] = params.m_iLengthOfShadowBufferSquare;
+		}
+		AtlasPacking::GetHalvingCascadeLengths(params.m_iLengthOfShadowBufferSquare, params.m_nUsingCascadeLevelsCount, 128,
+			halvingParams.m_iCascadeLengthOfShadowBuffer);
+
+		for (size_t iPose = 0;iPose < viewerViews.size();++iPose)
+		{
+			params.m_matViewerCameraView = explicitParams.m_matViewerCameraView = halvingParams.m_matViewerCameraView = viewerViews[iPose];
+			params.m_matLightCameraView = explicitParams.m_matLightCameraView = halvingParams.m_matLightCameraView = lightViews[iPose];
+			CascadeFitResult result, explicitResult, halvingResult;
+			CascadeFitting::FitCascades(params, &result);
+			CascadeFitting::FitCascades(explicitParams, &explicitResult);
+			CascadeFitting::FitCascades(halvingParams, &halvingResult);
+			if (memcmp(result.m_matOrthoProjForCascades, explicitResult.m_matOrthoProjForCascades,
+				sizeof(XMMATRIX) * params.m_nUsingCascadeLevelsCount) != 0)
+			{
+				++iMismatchCount;
+			}
+
+			if (iFitMode == FIT_LIGHT_VIEW_FRUSTRUM_TO_SCENE)
+			{
+				for (int i = 0;i < params.m_nUsingCascadeLevelsCount;++i)
+				{
+					float fRatio = XMVectorGetX(halvingResult.m_vViewSpaceUnitsPerTexel[i]) / XMVectorGetX(result.m_vViewSpaceUnitsPerTexel[i]);
+					float fExpected = (float)params.m_iLengthOfShadowBufferSquare / (float)halvingParams.m_iCascadeLengthOfShadowBuffer[i];
+					iMismatchCount += fabsf(fRatio - fExpected) > 1e-4f * fExpected ? 1 : 0;
+				}
+			}
+		}
+	}
+
+	printf("atlas packing:%d cases,%d mismatches\n", iCaseCount, iMismatchCount);
+	return iMismatchCount == 0 ? 0 : 1;
+}
+
+//--------------------------------------------------------------------------------------
+// Atlas size and texel density of equal cascade tiles against packed tiles of halving length.The near cascade
+// keeps its texels,the far ones give up half of theirs every second cascade.
+//--------------------------------------------------------------------------------------
+static void ReportAtlasPacking(const std::vector<XMMATRIX>& viewerViews, const std::vector<XMMATRIX>& lightViews)
+{
+	printf("%-24s %11s %9s %13s %13s\n", "atlas,2048 near tile", "texels", "32 bit MB", "cascade0 t/px", "worst t/px");
+	for (int nCascadeCount = 2;nCascadeCount <= MAX_CASCADES;nCascadeCount *= 2)
+	{
+		for (int iHalving = 0;iHalving < 2;++iHalving)
+		{
+			CascadeFitParams params;
+			InitSampleParams(params);
+			SetDefaultPartitions(params, nCascadeCount);
+			params.m_iLengthOfShadowBufferSquare = 2048;
+
+			int iLengths[MAX_CASCADES];
+			for (int i = 0;i < nCascadeCount;++i)
+			{
+				iLengths[i] = params.m_iLengthOfShadowBufferSquare;
+			}
+			if (iHalving)
+			{
+				AtlasPacking::GetHalvingCascadeLengths(params.m_iLengthOfShadowBufferSquare, nCascadeCount, 128, iLengths);
+			}
+			memcpy(params.m_iCascadeLengthOfShadowBuffer, iLengths, sizeof(int) * nCascadeCount);
+
+			AtlasRect rects[MAX_CASCADES];
+			int iAtlasWidth = AtlasPacking::PackSquaresSkyline(iLengths, nCascadeCount, params.m_iLengthOfShadowBufferSquare, rects);
+			double fTexels = (double)iAtlasWidth * (double)params.m_iLengthOfShadowBufferSquare;
+
+			double fNearSum = 0.0;
+			double fWorstSum = 0.0;
+			CascadeFitResult result;
+			CascadeTexelDensity density;
+			for (size_t iPose = 0;iPose < viewerViews.size();++iPose)
+			{
+				params.m_matViewerCameraView = viewerViews[iPose];
+				params.m_matLightCameraView = lightViews[iPose];
+				CascadeFitting::FitCascades(params, &result);
+				CascadeFitting::ComputeTexelDensity(params, result.m_matOrthoProjForCascades, result.m_FrustumSlices, 1080, &density);
+				fNearSum += density.m_fTexelsPerPixel[0];
+				fWorstSum += density.m_fMinTexelsPerPixel;
+			}
+
+			char label[64];
+			snprintf(label, sizeof(label), "%d cascades %s", nCascadeCount, iHalving ? "halving" : "equal");
+			printf("%-24s %5dx%-5d %9.1f %13.3f %13.3f\n", label, iAtlasWidth, params.m_iLengthOfShadowBufferSquare,
+				fTexels * 4.0 / (1024.0 * 1024.0), fNearSum / (double)viewerViews.size(), fWorstSum / (double)viewerViews.size());
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Runs random sets of lights through the quadtree shadow atlas for a few frames,with the coverage drifting and
+// lights going on and off.No two tiles may overlap or leave the atlas,every tile is a power of two no smaller
+// than the minimum and no larger than asked for,a light covering more never gets a smaller tile than one
+// covering less that asked for at most as much,lights only go without a tile once all tiles are the smallest
+// and the stats have to add up.Allocating the same requests again has to keep every tile where it is.
+//--------------------------------------------------------------------------------------
+static int VerifyShadowAtlas(int iCaseCount)
+{
+	unsigned int uSeed = 777u;
+	int iMismatchCount = 0;
+	int iRejectedCount = 0;
+	int iRepackCount = 0;
+	QuadtreeShadowAtlas atlas;
+	for (int iCase = 0;iCase < iCaseCount;++iCase)
+	{
+		// Every fourth atlas is too small for all lights.
+		if (iCase % 4 == 3)
+		{
+			atlas.Reset(512, 64);
+		}
+		else
+		{
+			atlas.Reset(1024 << (iCase % 3), 32 << (iCase % 2));
+		}
+		int nLightCount = 1 + (int)RandomFloat(uSeed, 0.0f, 96.0f);
+		std::vector<ShadowAtlasRequest> requests(nLightCount);
+		std::vector<ShadowAtlasRequest> frameRequests;
+		std::vector<AtlasRect> rects, allocatedRects;
+		for (int i = 0;i < nLightCount;++i)
+		{
+			requests[i].m_uLightId = 1000u + (unsigned int)(nLightCount - i);
+			requests[i].m_fScreenCoverage = RandomFloat(uSeed, 0.0f, 1.0f) * RandomFloat(uSeed, 0.0f, 1.0f);
+			requests[i].m_iTileLength = 0;
+		}
+
+		for (int iFrame = 0;iFrame < 6;++iFrame)
+		{
+			frameRequests.clear();
+			for (int i = 0;i < nLightCount;++i)
+			{
+				ShadowAtlasRequest& request = requests[i];
+				request.m_fScreenCoverage = std::min(1.0f, std::max(0.0f, request.m_fScreenCoverage * RandomFloat(uSeed, 0.8f, 1.25f)));
+				request.m_iTileLength = AtlasPacking::SelectShadowTileLength(request.m_fScreenCoverage, 1024, 32, request.m_iTileLength);
+				if (RandomFloat(uSeed, 0.0f, 1.0f) < 0.9f)
+				{
+					frameRequests.push_back(request);
+				}
+			}
+			int nRequestCount = (int)frameRequests.size();
+			rects.resize(nRequestCount + 1);
+
+			ShadowAtlasFrameStats stats;
+			atlas.AllocateFrame(frameRequests.data(), nRequestCount, rects.data(), &stats);
+
+			allocatedRects.clear();
+			long long iUsedTexels = 0;
+			int nWantedCount = 0;
+			bool bAllSmallest = true;
+			for (int i = 0;i < nRequestCount;++i)
+			{
+				const AtlasRect& rect = rects[i];
+				nWantedCount += frameRequests[i].m_iTileLength > 0 ? 1 : 0;
+				if (rect.m_iWidth == 0)
+				{
+					continue;
+				}
+				allocatedRects.push_back(rect);
+				iUsedTexels += (long long)rect.m_iWidth * rect.m_iHeight;
+				bAllSmallest &= rect.m_iWidth == atlas.GetMinTileLength();
+				bool bPowerOfTwo = (rect.m_iWidth & (rect.m_iWidth - 1)) == 0;
+				if (!bPowerOfTwo || rect.m_iWidth != rect.m_iHeight || rect.m_iWidth < atlas.GetMinTileLength()
+					|| rect.m_iWidth > std::max(frameRequests[i].m_iTileLength, atlas.GetMinTileLength()))
+				{
+					++iMismatchCount;
+				}
+				for (int j = 0;j < nRequestCount;++j)
+				{
+					if (frameRequests[i].m_fScreenCoverage > frameRequests[j].m_fScreenCoverage
+						&& frameRequests[i].m_iTileLength >= frameRequests[j].m_iTileLength && rects[j].m_iWidth > rect.m_iWidth)
+					{
+						++iMismatchCount;
+					}
+				}
+			}
+
+			int nAllocatedCount = (int)allocatedRects.size();
+			if (!AtlasPacking::AreRectsDisjointInAtlas(allocatedRects.data(), nAllocatedCount, atlas.GetAtlasLength(), atlas.GetAtlasLength())
+				|| stats.m_nAllocatedCount != nAllocatedCount || stats.m_nRejectedCount != nWantedCount - nAllocatedCount
+				|| stats.m_iUsedTexels != iUsedTexels || (stats.m_nRejectedCount > 0 && !bAllSmallest)
+				|| stats.m_nKeptCount + stats.m_nMovedCount > nAllocatedCount)
+			{
+				++iMismatchCount;
+			}
+			iRejectedCount += stats.m_nRejectedCount;
+			iRepackCount += stats.m_nRepackCount;
+
+			// Nothing changed,nothing may move.
+			std::vector<AtlasRect> againRects(nRequestCount + 1);
+			ShadowAtlasFrameStats againStats;
+			atlas.AllocateFrame(frameRequests.data(), nRequestCount, againRects.data(), &againStats);
+			if (againStats.m_nKeptCount != nAllocatedCount || againStats.m_nMovedCount != 0 || againStats.m_nRepackCount != 0
+				|| memcmp(againRects.data(), rects.data(), sizeof(AtlasRect) * nRequestCount) != 0)
+			{
+				++iMismatchCount;
+			}
+		}
+	}
+
+	// A light between two lengths keeps the one it has.
+	for (int iLength = 64;iLength <= 1024;iLength *= 2)
+	{
+		float fCoverage = powf((float)iLength / 1024.0f, 2.0f);
+		iMismatchCount += AtlasPacking::SelectShadowTileLength(fCoverage, 1024, 32, 0) != iLength ? 1 : 0;
+		iMismatchCount += AtlasPacking::SelectShadowTileLength(fCoverage * 1.9f, 1024, 32, iLength) != iLength ? 1 : 0;
+		iMismatchCount += AtlasPacking::SelectShadowTileLength(fCoverage * 0.55f, 1024, 32, iLength) != iLength ? 1 : 0;
+	}
+	iMismatchCount += AtlasPacking::SelectShadowTileLength(0.0f, 1024, 32, 256) != 0 ? 1 : 0;
+
+	printf("shadow atlas:%d cases,%d rejected lights,%d repacks,%d mismatches\n", iCaseCount, iRejectedCount, iRepackCount, iMismatchCount);
+	return iMismatchCount == 0 ? 0 : 1;
+}
+
+//--------------------------------------------------------------------------------------
+// Shadows spot lights scattered over the scene from the poses of the fly-through with a shared atlas.A light
+// asks for the tile length SelectShadowTileLength gives its screen coverage,the stats tell how many lights are
+// shadowed at what resolution,how many tiles have to be rendered anew because they moved and how fragmented the
+// free space is,with and without the hysteresis of the tile lengths.
+//--------------------------------------------------------------------------------------
+static void ReportShadowAtlas(const std::vector<XMMATRIX>& viewerViews)
+{
+	const int nLightCount = 48;
+	unsigned int uSeed = 99u;
+	std::vector<XMFLOAT4> lights(nLightCount); // xyz position,w radius
+	for (int i = 0;i < nLightCount;++i)
+	{
+		lights[i] = XMFLOAT4(RandomFloat(uSeed, g_vSceneAABBMin.x, g_vSceneAABBMax.x), RandomFloat(uSeed, 0.0f, 40.0f),
+			RandomFloat(uSeed, g_vSceneAABBMin.z, g_vSceneAABBMax.z), RandomFloat(uSeed, 10.0f, 40.0f));
+	}
+
+	const float fTanHalfFov = tanf(XM_PI / 8.0f);
+	const float fAspect = 16.0f / 9.0f;
+	printf("%-26s %8s %8s %8s %8s %8s %8s %8s %8s\n", "atlas,48 spot lights", "lights", "shadowed", "smaller", "none",
+		"moved", "repacks", "frag", "ns");
+	for (int iAtlasLength = 4096;iAtlasLength <= 8192;iAtlasLength *= 2)
+	{
+		for (int iHysteresis = 1;iHysteresis >= 0;--iHysteresis)
+		{
+			QuadtreeShadowAtlas atlas;
+			atlas.Reset(iAtlasLength, 64);
+			std::vector<int> previousLengths(nLightCount, 0);
+			std::vector<ShadowAtlasRequest> requests;
+			std::vector<int> requestLights;
+			std::vector<AtlasRect> rects(nLightCount);
+			double fLights = 0.0, fShadowed = 0.0, fDowngraded = 0.0, fRejected = 0.0, fMoved = 0.0, fFragmentation = 0.0;
+			int iRepackCount = 0;
+			long long iNs = 0;
+			for (size_t iPose = 0;iPose < viewerViews.size();++iPose)
+			{
+				// The share of the screen the bounding sphere of a light covers.
+				requests.clear();
+				requestLights.clear();
+				for (int i = 0;i < nLightCount;++i)
+				{
+					XMVECTOR vCenter = XMVector3TransformCoord(XMVectorSet(lights[i].x, lights[i].y, lights[i].z, 1.0f), viewerViews[iPose]);
+					float fRadius = lights[i].w;
+					float fDepth = XMVectorGetZ(vCenter);
+					if (fDepth + fRadius < 0.1f || fabsf(XMVectorGetX(vCenter)) - fRadius > fDepth * fTanHalfFov * fAspect
+						|| fabsf(XMVectorGetY(vCenter)) - fRadius > fDepth * fTanHalfFov)
+					{
+						previousLengths[i] = 0;
+						continue;
+					}
+					float fRadiusOnScreen = fRadius / (std::max(fDepth, fRadius) * fTanHalfFov);
+					ShadowAtlasRequest request;
+					request.m_uLightId = (unsigned int)i;
+					request.m_fScreenCoverage = std::min(1.0f, XM_PI * fRadiusOnScreen * fRadiusOnScreen / (4.0f * fAspect));
+					request.m_iTileLength = AtlasPacking::SelectShadowTileLength(request.m_fScreenCoverage, 2048, 64,
+						iHysteresis ? previousLengths[i] : 0);
+					previousLengths[i] = request.m_iTileLength;
+					requests.push_back(request);
+					requestLights.push_back(i);
+				}
+
+				ShadowAtlasFrameStats stats;
+				auto begin = std::chrono::steady_clock::now();
+				atlas.AllocateFrame(requests.data(), (int)requests.size(), rects.data(), &stats);
+				auto end = std::chrono::steady_clock::now();
+				iNs += std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+
+				// A light that got a smaller tile asks from there next frame.
+				for (size_t i = 0;i < requests.size();++i)
+				{
+					previousLengths[requestLights[i]] = rects[i].m_iWidth;
+				}
+
+				fLights += stats.m_nRequestCount;
+				fShadowed += stats.m_nAllocatedCount;
+				fDowngraded += stats.m_nDowngradedCount;
+				fRejected += stats.m_nRejectedCount;
+				fMoved += stats.m_nMovedCount;
+				fFragmentation += stats.m_fFragmentation;
+				iRepackCount += stats.m_nRepackCount;
+			}
+
+			double fPoseCount = (double)viewerViews.size();
+			char label[64];
+			snprintf(label, sizeof(label), "%d %s", iAtlasLength, iHysteresis ? "hysteresis" : "no hysteresis");
+			printf("%-26s %8.1f %8.1f %8.1f %8.1f %8.2f %8d %8.3f %8.0f\n", label, fLights / fPoseCount, fShadowed / fPoseCount,
+				fDowngraded / fPoseCount, fRejected / fPoseCount, fMoved / fPoseCount, iRepackCount, fFragmentation / fPoseCount,
+				(double)iNs / fPoseCount);
+		}
+	}
+}
+
+// The sample's limits:tiles of 128 to 4096 texels,up to 8 cascades side by side in an 8192 texel wide texture.
+static void InitBudgetParams(ShadowBudgetParams& budget, long long iBudgetBytes, float fTargetTexelsPerPixel)
+{
+	budget.m_iBudgetBytes = iBudgetBytes;
+	budget.m_fTargetTexelsPerPixel = fTargetTexelsPerPixel;
+	budget.m_iScreenHeight = 1080;
+	budget.m_nMaxCascadeCount = MAX_CASCADES;
+	budget.m_iMinLength = 128;
+	budget.m_iMaxLength = 4096;
+	budget.m_iMaxTextureLength = 8192;
+	budget.m_bHalvingLengths = false;
+	budget.m_bStaticLayer = false;
+}
+
+//--------------------------------------------------------------------------------------
+// Weighs every shadow map SelectShadowBudgetConfig could have chosen once more.The choice has to be inside the
+// budget whenever anything is,no 32 bit map inside the budget may reach the target with fewer bytes,a 16 bit
+// choice means no 32 bit map inside the budget reaches it,and a choice short of the target has to be the densest
+// map inside the budget.A larger budget may never get further from the target.
+//--------------------------------------------------------------------------------------
+static int VerifyShadowBudget(const std::vector<XMMATRIX>& viewerViews, const std::vector<XMMATRIX>& lightViews, int iCaseCount)
+{
+	unsigned int uSeed = 2323u;
+	int iMismatchCount = 0;
+	int iMetCount = 0;
+	for (int iCase = 0;iCase < iCaseCount;++iCase)
+	{
+		CascadeFitParams params;
+		InitSampleParams(params);
+		size_t iPose = (size_t)iCase * 37 % viewerViews.size();
+		params.m_matViewerCameraView = viewerViews[iPose];
+		params.m_matLightCameraView = lightViews[iPose];
+
+		ShadowBudgetParams budget;
+		InitBudgetParams(budget, (long long)(RandomFloat(uSeed, 0.0f, 160.0f) * 1024.0f * 1024.0f), RandomFloat(uSeed, 0.005f, 0.1f));
+		budget.m_nMaxCascadeCount = 1 + iCase % MAX_CASCADES;
+		budget.m_bHalvingLengths = (iCase % 3) == 1;
+		budget.m_bStaticLayer = (iCase % 5) == 2;
+		budget.m_iMaxTextureLength = (iCase % 7) == 3 ? 0 : 8192;
+		ShadowBudgetChoice choice;
+		CascadeFitting::SelectShadowBudgetConfig(params, budget, &choice);
+		iMetCount += choice.m_bMeetsTarget ? 1 : 0;
+
+		CascadeFitParams practicalParams = params;
+		practicalParams.m_eSplitMode = CASCADE_SPLIT_PRACTICAL;
+		bool bAnyFits = false;
+		for (int nCascadeCount = 1;nCascadeCount <= budget.m_nMaxCascadeCount;++nCascadeCount)
+		{
+			for (int iLength = budget.m_iMinLength;iLength <= budget.m_iMaxLength;iLength *= 2)
+			{
+				int iLengths[MAX_CASCADES];
+				for (int i = 0;i < nCascadeCount;++i)
+				{
+					iLengths[i] = budget.m_bHalvingLengths ? std::max(iLength >> ((i + 1) / 2), budget.m_iMinLength) : iLength;
+				}
+				practicalParams.m_nUsingCascadeLevelsCount = nCascadeCount;
+				practicalParams.m_iLengthOfShadowBufferSquare = iLength;
+				memcpy(practicalParams.m_iCascadeLengthOfShadowBuffer, iLengths, sizeof(int) * nCascadeCount);
+				CascadeFitResult result;
+				CascadeTexelDensity density;
+				CascadeFitting::FitCascades(practicalParams, &result);
+				CascadeFitting::ComputeTexelDensity(practicalParams, result.m_matOrthoProjForCascades, result.m_FrustumSlices, budget.m_iScreenHeight, &density);
+				bool bMeetsTarget = density.m_fMinTexelsPerPixel >= budget.m_fTargetTexelsPerPixel;
+
+				for (int iBytesPerTexel = 4;iBytesPerTexel >= 2;iBytesPerTexel /= 2)
+				{
+					long long iBytes = CascadeFitting::GetShadowMapBytes(iLengths, nCascadeCount, iBytesPerTexel, budget.m_iMaxTextureLength)
+						* (budget.m_bStaticLayer ? 2 : 1);
+					if (iBytes > budget.m_iBudgetBytes)
+					{
+						continue;
+					}
+					bAnyFits = true;
+					if (choice.m_bMeetsTarget && bMeetsTarget && iBytesPerTexel == 4
+						&& (choice.m_iBytesPerTexel == 2 || iBytes < choice.m_iBytes))
+					{
+						++iMismatchCount;
+					}
+					if (!choice.m_bMeetsTarget && (bMeetsTarget || density.m_fMinTexelsPerPixel > choice.m_fMinTexelsPerPixel))
+					{
+						++iMismatchCount;
+					}
+				}
+			}
+		}
+
+		// The choice has to allocate what it says.
+		int iChoiceLengths[MAX_CASCADES];
+		for (int i = 0;i < choice.m_nCascadeCount;++i)
+		{
+			iChoiceLengths[i] = choice.m_iCascadeLengthOfShadowBuffer[i] > 0 ? choice.m_iCascadeLengthOfShadowBuffer[i] : choice.m_iLengthOfShadowBufferSquare;
+		}
+		long long iChoiceBytes = CascadeFitting::GetShadowMapBytes(iChoiceLengths, choice.m_nCascadeCount, choice.m_iBytesPerTexel,
+			budget.m_iMaxTextureLength) * (budget.m_bStaticLayer ? 2 : 1);
+		if (choice.m_bFitsBudget != bAnyFits || (bAnyFits && choice.m_iBytes > budget.m_iBudgetBytes) || iChoiceBytes != choice.m_iBytes
+			|| choice.m_nCascadeCount < 1 || choice.m_nCascadeCount > budget.m_nMaxCascadeCount)
+		{
+			++iMismatchCount;
+		}
+
+		// Twice the budget gets at least as close to the target.
+		ShadowBudgetParams largerBudget = budget;
+		largerBudget.m_iBudgetBytes = budget.m_iBudgetBytes * 2;
+		ShadowBudgetChoice largerChoice;
+		CascadeFitting::SelectShadowBudgetConfig(params, largerBudget, &largerChoice);
+		if (std::min(largerChoice.m_fMinTexelsPerPixel, budget.m_fTargetTexelsPerPixel) < std::min(choice.m_fMinTexelsPerPixel, budget.m_fTargetTexelsPerPixel)
+			&& choice.m_bFitsBudget)
+		{
+			++iMismatchCount;
+		}
+	}
+
+	// A budget without a length range or a cascade chooses nothing,and lengths up to INT_MAX don't overflow.
+	{
+		CascadeFitParams params;
+		InitSampleParams(params);
+		params.m_matViewerCameraView = viewerViews[0];
+		params.m_matLightCameraView = lightViews[0];
+		ShadowBudgetParams budget;
+		InitBudgetParams(budget, 64LL * 1024 * 1024, 0.05f);
+		ShadowBudgetChoice choice;
+		for (int iInvalid = 0;iInvalid < 4;++iInvalid)
+		{
+			ShadowBudgetParams invalidBudget = budget;
+			invalidBudget.m_iMinLength = iInvalid == 0 ? 0 : (iInvalid == 1 ? -128 : invalidBudget.m_iMinLength);
+			invalidBudget.m_iMaxLength = iInvalid == 2 ? invalidBudget.m_iMinLength / 2 : invalidBudget.m_iMaxLength;
+			invalidBudget.m_nMaxCascadeCount = iInvalid == 3 ? 0 : invalidBudget.m_nMaxCascadeCount;
+			CascadeFitting::SelectShadowBudgetConfig(params, invalidBudget, &choice);
+			iMismatchCount += choice.m_nCascadeCount != 0 || choice.m_nCandidateCount != 0 || choice.m_bFitsBudget ? 1 : 0;
+		}
+
+		budget.m_iMinLength = 1 << 29;
+		budget.m_iMaxLength = INT_MAX;
+		budget.m_nMaxCascadeCount = 1;
+		CascadeFitting::SelectShadowBudgetConfig(params, budget, &choice);
+		iMismatchCount += choice.m_nCandidateCount != 4 || choice.m_iLengthOfShadowBufferSquare != 1 << 29 ? 1 : 0;
+	}
+
+	printf("shadow budget:%d cases,%d reach the target,%d mismatches\n", iCaseCount, iMetCount, iMismatchCount);
+	return iMismatchCount == 0 ? 0 : 1;
+}
+
+//--------------------------------------------------------------------------------------
+// The shadow maps SelectShadowBudgetConfig picks for a few budgets and density targets,at the first pose of the
+// fly-through,and how often the choice would change if it was made again at every pose.
+//--------------------------------------------------------------------------------------
+static void ReportShadowBudget(const std::vector<XMMATRIX>& viewerViews, const std::vector<XMMATRIX>& lightViews)
+{
+	if (viewerViews.empty())
+	{
+		return;
+	}
+
+	printf("%-22s %8s %8s %6s %9s %9s %8s %10s\n", "budget,1080 lines", "cascades", "length", "depth", "MB", "t/px", "ns", "changes");
+	static const float s_fTargets[] = { 0.01f, 0.03f, 0.06f };
+	for (int iTarget = 0;iTarget < 3;++iTarget)
+	{
+		for (int iBudgetMB = 8;iBudgetMB <= 128;iBudgetMB *= 4)
+		{
+			CascadeFitParams params;
+			InitSampleParams(params);
+			ShadowBudgetParams budget;
+			InitBudgetParams(budget, (long long)iBudgetMB * 1024 * 1024, s_fTargets[iTarget]);
+
+			ShadowBudgetChoice firstChoice = {}, previousChoice = {}, choice = {};
+			int nChangeCount = 0;
+			long long iNs = 0;
+			for (size_t iPose = 0;iPose < viewerViews.size();++iPose)
+			{
+				params.m_matViewerCameraView = viewerViews[iPose];
+				params.m_matLightCameraView = lightViews[iPose];
+				auto begin = std::chrono::steady_clock::now();
+				CascadeFitting::SelectShadowBudgetConfig(params, budget, &choice);
+				auto end = std::chrono::steady_clock::now();
+				iNs += std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+				if (iPose == 0)
+				{
+					firstChoice = choice;
+				}
+				else
+				{
+					nChangeCount += (choice.m_nCascadeCount != previousChoice.m_nCascadeCount
+						|| choice.m_iLengthOfShadowBufferSquare != previousChoice.m_iLengthOfShadowBufferSquare
+						|| choice.m_iBytesPerTexel != previousChoice.m_iBytesPerTexel) ? 1 : 0;
+				}
+				previousChoice = choice;
+			}
+
+			char label[64];
+			snprintf(label, sizeof(label), "%d MB,%0.2f t/px", iBudgetMB, s_fTargets[iTarget]);
+			printf("%-22s %8d %8d %3dbit %9.1f %9.3f %8.0f %9.1f%%\n", label, firstChoice.m_nCascadeCount, firstChoice.m_iLengthOfShadowBufferSquare,
+				firstChoice.m_iBytesPerTexel * 8, (double)firstChoice.m_iBytes / (1024.0 * 1024.0), firstChoice.m_fMinTexelsPerPixel,
+				(double)iNs / (double)viewerViews.size(), 100.0 * nChangeCount / (double)viewerViews.size());
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// How many of the synthetic boxes each cascade draws when casters are culled against its ortho box,and
+// what the culling costs per frame.The draws per frame compare one submission per cascade with the single
+// pass that instances every box into all of its cascades.
+//--------------------------------------------------------------------------------------
+static void ReportCasterCulling(const std::vector<XMMATRIX>& viewerViews, const std::vector<XMMATRIX>& lightViews)
+{
+	SceneBoundsHierarchy hierarchy;
+	BuildSyntheticSceneBounds(&hierarchy);
+	int nBoxCount = (int)hierarchy.m_vBoxMin.size();
+	std::vector<unsigned int> boxCascadeMasks(nBoxCount);
+
+	printf("%-24s", "casters drawn");
+	for (int i = 0;i < 4;++i)
+	{
+		printf(" %8s%d", "cascade", i);
+	}
+	printf(" %9s %9s %9s\n", "cull ns", "draws", "1 pass");
+
+	for (int iFitMode = FIT_LIGHT_VIEW_FRUSTRUM_TO_CASCADE_INTERVALS;iFitMode <= FIT_LIGHT_VIEW_FRUSTRUM_TO_SCENE;++iFitMode)
+	{
+		CascadeFitParams params;
+		InitSampleParams(params);
+		params.m_eLightViewFrustumFitMode = (FIT_LIGHT_VIEW_FRUSTRUM)iFitMode;
+		params.m_pSceneBounds = &hierarchy;
+
+		double fDrawn[MAX_CASCADES] = {};
+		double fSinglePassDraws = 0.0;
+		long long iCullNs = 0;
+		CascadeFitResult result;
+		for (size_t iPose = 0;iPose < viewerViews.size();++iPose)
+		{
+			params.m_matViewerCameraView = viewerViews[iPose];
+			params.m_matLightCameraView = lightViews[iPose];
+			CascadeFitting::FitCascades(params, &result);
+
+			auto begin = std::chrono::steady_clock::now();
+			CascadeFitting::CullCasters(hierarchy, params.m_matLightCameraView, params.m_nUsingCascadeLevelsCount,
+				result.m_matOrthoProjForCascades, boxCascadeMasks.data());
+			auto end = std::chrono::steady_clock::now();
+			iCullNs += std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+
+			for (int iBox = 0;iBox < nBoxCount;++iBox)
+			{
+				for (int i = 0;i < params.m_nUsingCascadeLevelsCount;++i)
+				{
+					fDrawn[i] += (boxCascadeMasks[iBox] >> i) & 1u;
+				}
+				// A single pass submits a box once for all the cascades it casts into.
+				fSinglePassDraws += boxCascadeMasks[iBox] != 0 ? 1.0 : 0.0;
+			}
+		}
+
+		printf("%-24s", g_szFitModeNames[iFitMode]);
+		for (int i = 0;i < params.m_nUsingCascadeLevelsCount;++i)
+		{
+			printf(" %5.1f%%   ", 100.0 * fDrawn[i] / (double)(viewerViews.size() * nBoxCount));
+		}
+		double fDraws = 0.0;
+		for (int i = 0;i < params.m_nUsingCascadeLevelsCount;++i)
+		{
+			fDraws += fDrawn[i];
+		}
+		printf(" %9.0f %9.1f %9.1f\n", (double)iCullNs / (double)viewerViews.size(), fDraws / (double)viewerViews.size(),
+			fSinglePassDraws / (double)viewerViews.size());
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Randomized differential test of ComputeNearAndFarAnalytic against ComputeNearAndFarInViewSpace.
+// The boxes are rotated,stretched and moved like a scene AABB seen from a light,the ortho bounds
+// cover the box fully,partly or miss it.
+//--------------------------------------------------------------------------------------
+static float RandomFloat(unsigned int& uSeed, float fMin, float fMax)
+{
+	uSeed = uSeed * 1664525u + 1013904223u;
+	return fMin + (fMax - fMin) * (float)(uSeed >> 8) / (float)(1 << 24);
+}
+
+static int VerifyAnalyticNearFar(int iCaseCount)
+{
+	unsigned int uSeed = 12345u;
+	int iMismatchCount = 0;
+	int iEmptyCount = 0;
+	int iDegenerateCount = 0;
+	float fMaxError = 0.0f;
+	double fAnalyticSeconds = 0.0;
+	double fClipperSeconds = 0.0;
+
+	for (int iCase = 0;iCase < iCaseCount;++iCase)
+	{
+		XMVECTOR vCenter = XMVectorSet(RandomFloat(uSeed, -300.0f, 300.0f), RandomFloat(uSeed, -300.0f, 300.0f), RandomFloat(uSeed, -300.0f, 300.0f), 1.0f);
+		XMVECTOR vExtends = XMVectorSet(RandomFloat(uSeed, 0.5f, 300.0f), RandomFloat(uSeed, 0.5f, 300.0f), RandomFloat(uSeed, 0.5f, 300.0f), 0.0f);
+		XMVECTOR vEye = XMVectorSet(RandomFloat(uSeed, -500.0f, 500.0f), RandomFloat(uSeed, 10.0f, 500.0f), RandomFloat(uSeed, -500.0f, 500.0f), 1.0f);
+		XMVECTOR vLookAt = XMVectorSet(RandomFloat(uSeed, -50.0f, 50.0f), RandomFloat(uSeed, -50.0f, 50.0f), RandomFloat(uSeed, -50.0f, 50.0f), 1.0f);
+		XMMATRIX matLightView = XMMatrixLookAtLH(vEye, vLookAt, g_XMIdentityR1);
+
+		XMVECTOR vPoints[8];
+		CascadeFitting::CreateAABBPoints(vPoints, vCenter, vExtends);
+		XMVECTOR vBoxMin = g_XMFltMax;
+		XMVECTOR vBoxMax = XMVectorNegate(g_XMFltMax);
+		for (int i = 0;i < 8;++i)
+		{
+			vPoints[i] = XMVector4Transform(vPoints[i], matLightView);
+			vBoxMin = XMVectorMin(vBoxMin, vPoints[i]);
+			vBoxMax = XMVectorMax(vBoxMax, vPoints[i]);
+		}
+		float fBoxSize = XMVectorGetX(XMVector3Length(vBoxMax - vBoxMin));
+
+		// Bounds are drawn from the light space AABB of the box grown by half its size,so some miss it.
+		XMVECTOR vOrthoMin[MAX_CASCADES];
+		XMVECTOR vOrthoMax[MAX_CASCADES];
+		XMVECTOR vRange = (vBoxMax - vBoxMin) * 0.5f;
+		for (int i = 0;i < MAX_CASCADES;++i)
+		{
+			float fX0 = RandomFloat(uSeed, XMVectorGetX(vBoxMin - vRange), XMVectorGetX(vBoxMax + vRange));
+			float fX1 = RandomFloat(uSeed, XMVectorGetX(vBoxMin - vRange), XMVectorGetX(vBoxMax + vRange));
+			float fY0 = RandomFloat(uSeed, XMVectorGetY(vBoxMin - vRange), XMVectorGetY(vBoxMax + vRange));
+			float fY1 = RandomFloat(uSeed, XMVectorGetY(vBoxMin - vRange), XMVectorGetY(vBoxMax + vRange));
+			vOrthoMin[i] = XMVectorSet(fX0 < fX1 ? fX0 : fX1, fY0 < fY1 ? fY0 : fY1, 0.0f, 1.0f);
+			vOrthoMax[i] = XMVectorSet(fX0 < fX1 ? fX1 : fX0, fY0 < fY1 ? fY1 : fY0, 0.0f, 1.0f);
+		}
+
+		float fAnalyticNear[MAX_CASCADES], fAnalyticFar[MAX_CASCADES];
+		auto begin = std::chrono::steady_clock::now();
+		bool bSolved = CascadeFitting::ComputeNearAndFarAnalytic(MAX_CASCADES, vOrthoMin, vOrthoMax, vPoints, fAnalyticNear, fAnalyticFar);
+		auto middle = std::chrono::steady_clock::now();
+		float fClipperNear[MAX_CASCADES], fClipperFar[MAX_CASCADES];
+		for (int i = 0;i < MAX_CASCADES;++i)
+		{
+			CascadeFitting::ComputeNearAndFarInViewSpace(fClipperNear[i], fClipperFar[i], vOrthoMin[i], vOrthoMax[i], vPoints);
+		}
+		auto end = std::chrono::steady_clock::now();
+		fAnalyticSeconds += std::chrono::duration<double>(middle - begin).count();
+		fClipperSeconds += std::chrono::duration<double>(end - middle).count();
+
+		if (!bSolved)
+		{
+			++iDegenerateCount;
+			continue;
+		}
+
+		for (int i = 0;i < MAX_CASCADES;++i)
+		{
+			bool bClipperEmpty = fClipperNear[i] > fClipperFar[i];
+			bool bAnalyticEmpty = fAnalyticNear[i] > fAnalyticFar[i];
+			if (bClipperEmpty)
+			{
+				++iEmptyCount;
+			}
+
+			// A bound that only grazes the box may be empty for one solver and a single point for the other.
+			float fTolerance = fBoxSize * 1e-4f;
+			float fError = 0.0f;
+			if (bClipperEmpty != bAnalyticEmpty)
+			{
+				fError = bClipperEmpty ? fAnalyticFar[i] - fAnalyticNear[i] : fClipperFar[i] - fClipperNear[i];
+			}
+			else if (!bClipperEmpty)
+			{
+				fError = fabsf(fAnalyticNear[i] - fClipperNear[i]);
+				fError = fabsf(fAnalyticFar[i] - fClipperFar[i]) > fError ? fabsf(fAnalyticFar[i] - fClipperFar[i]) : fError;
+			}
+
+			if (fError / fBoxSize > fMaxError)
+			{
+				fMaxError = fError / fBoxSize;
+			}
+			if (fError > fTolerance)
+			{
+				if (iMismatchCount < 10)
+				{
+					printf("case %d cascade %d:clipper %g..%g analytic %g..%g\n", iCase, i,
+						fClipperNear[i], fClipperFar[i], fAnalyticNear[i], fAnalyticFar[i]);
+				}
+				++iMismatchCount;
+			}
+		}
+	}
+
+	printf("%d cases x %d bounds,%d empty,%d degenerate boxes\n", iCaseCount, MAX_CASCADES, iEmptyCount, iDegenerateCount);
+	printf("max error %g of the box size,%d mismatches\n", fMaxError, iMismatchCount);
+	printf("analytic %.0f ns/bound,clipper %.0f ns/bound\n",
+		fAnalyticSeconds * 1e9 / ((double)iCaseCount * MAX_CASCADES), fClipperSeconds * 1e9 / ((double)iCaseCount * MAX_CASCADES));
+	return iMismatchCount == 0 ? 0 : 1;
+}
+
+//--------------------------------------------------------------------------------------
+// Hands the cascades every CASCADE_UPDATE_SCHEDULE renders over the poses the slots of the constant ring,as
+// WriteCascadeConstants does,and then random masks of random cascade counts.The slots of a frame have to follow the
+// last frame's in cascade order,no slot may be handed out twice before the ring is discarded and every slot is bound
+// as whole constants inside the ring.Also counts the maps and the bytes uploaded by the ring and by a buffer per
+// cascade:a DISCARD map uploads the whole ring,a NO_OVERWRITE map the view projections it writes.
+//--------------------------------------------------------------------------------------
+static int VerifyConstantRing(const std::vector<XMMATRIX>& viewerViews, const std::vector<XMMATRIX>& lightViews, int iCaseCount)
+{
+	CascadeFitParams params;
+	InitSampleParams(params);
+
+	int iErrorCount = 0;
+	unsigned int uSeed = 11;
+	for (int iSchedule = CASCADE_UPDATE_EVERY_FRAME;iSchedule <= CASCADE_UPDATE_BY_ERROR + 1;++iSchedule)
+	{
+		bool bRandomMasks = iSchedule > CASCADE_UPDATE_BY_ERROR;
+		params.m_iFarCascadeGuardTexels = iSchedule == CASCADE_UPDATE_EVERY_FRAME ? 0 : CASCADE_FAR_GUARD_TEXELS;
+		CascadeCache cache;
+		CascadeFitting::InvalidateCascadeCache(&cache);
+
+		unsigned int uNextSlot = CASCADE_CONSTANT_RING_SLOTS;
+		bool bSlotWritten[CASCADE_CONSTANT_RING_SLOTS] = {};
+		int nFrameCount = bRandomMasks ? iCaseCount : (int)viewerViews.size();
+		int nDiscards = 0;
+		int nRingMaps = 0;
+		int nBufferMaps = 0;
+		long long iRingBytes = 0;
+		long long iBufferBytes = 0;
+		for (int iFrame = 0;iFrame < nFrameCount;++iFrame)
+		{
+			int nCascadeCount = params.m_nUsingCascadeLevelsCount;
+			unsigned int uCascadeMask;
+			if (bRandomMasks)
+			{
+				nCascadeCount = 1 + (int)RandomFloat(uSeed, 0.0f, (float)MAX_CASCADES);
+				uCascadeMask = (unsigned int)RandomFloat(uSeed, 0.0f, (float)(1 << nCascadeCount));
+			}
+			else
+			{
+				params.m_matViewerCameraView = viewerViews[iFrame];
+				params.m_matLightCameraView = lightViews[iFrame];
+				CascadeFitting::FitCascadesCached(params, &cache);
+				uCascadeMask = CascadeFitting::ScheduleCascadeUpdates(params, (CASCADE_UPDATE_SCHEDULE)iSchedule, 1, &cache);
+				CascadeFitting::MarkCascadesRendered(params, uCascadeMask, &cache);
+			}
+
+			unsigned int nSlotCount = 0;
+			for (int i = 0;i < nCascadeCount;++i)
+			{
+				nSlotCount += (uCascadeMask >> i) & 1;
+			}
+
+			unsigned int uFirstSlot = uNextSlot;
+			unsigned int uSlots[MAX_CASCADES];
+			bool bDiscard = CascadeFitting::AllocateCascadeRingSlots(uCascadeMask, nCascadeCount, CASCADE_CONSTANT_RING_SLOTS, &uNextSlot, uSlots);
+			if (bDiscard != (uFirstSlot + nSlotCount > CASCADE_CONSTANT_RING_SLOTS))
+			{
+				++iErrorCount;
+			}
+			if (bDiscard)
+			{
+				memset(bSlotWritten, 0, sizeof(bSlotWritten));
+				uFirstSlot = 0;
+				++nDiscards;
+			}
+
+			unsigned int uExpectedSlot = uFirstSlot;
+			for (int i = 0;i < nCascadeCount;++i)
+			{
+				if ((uCascadeMask & (1u << i)) == 0)
+				{
+					continue;
+				}
+				unsigned int uFirstConstant = uSlots[i] * CB_PER_CASCADE_SLOT_CONSTANTS;
+				if (uSlots[i] != uExpectedSlot++ || uSlots[i] >= CASCADE_CONSTANT_RING_SLOTS || bSlotWritten[uSlots[i]]
+					|| uFirstConstant % 16 != 0 || uFirstConstant + CB_PER_CASCADE_SLOT_CONSTANTS > CASCADE_CONSTANT_RING_SLOTS * CB_PER_CASCADE_SLOT_CONSTANTS)
+				{
+					++iErrorCount;
+					continue;
+				}
+				bSlotWritten[uSlots[i]] = true;
+			}
+			if (uNextSlot != uExpectedSlot)
+			{
+				++iErrorCount;
+			}
+
+			++nRingMaps;
+			iRingBytes += bDiscard ? CB_PER_CASCADE_SLOT_SIZE * CASCADE_CONSTANT_RING_SLOTS : sizeof(CB_PER_CASCADE) * nSlotCount;
+			nBufferMaps += (int)nSlotCount;
+			iBufferBytes += sizeof(CB_PER_CASCADE) * nSlotCount;
+		}
+
+		printf("ring %-12s %d frames:%d discards,%d maps %lld bytes,a buffer per cascade %d maps %lld bytes\n",
+			bRandomMasks ? "RandomMasks" : g_szScheduleNames[iSchedule], nFrameCount, nDiscards, nRingMaps, iRingBytes, nBufferMaps, iBufferBytes);
+	}
+
+	printf("constant ring / %d slots:%d errors\n", CASCADE_CONSTANT_RING_SLOTS, iErrorCount);
+	return iErrorCount == 0 ? 0 : 1;
+}
+
+// The camera matrices are built up front so that only the cascade fit is timed.
+static void BuildPoseMatrices(const std::vector<RecordedPose>& poses, std::vector<XMMATRIX>& viewerViews, std::vector<XMMATRIX>& lightViews)
+{
+	viewerViews.resize(poses.size());
+	lightViews.resize(poses.size());
+	for (size_t i = 0;i < poses.size();++i)
+	{
+		viewerViews[i] = XMMatrixLookAtLH(XMLoadFloat3(&poses[i].m_vViewerEye), XMLoadFloat3(&poses[i].m_vViewerLookAt), g_XMIdentityR1);
+		lightViews[i] = XMMatrixLookAtLH(XMLoadFloat3(&poses[i].m_vLightEye), XMLoadFloat3(&poses[i].m_vLightLookAt), g_XMIdentityR1);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const char* szPoseFile = nullptr;
+	int iFrameCount = 4096;
+	int iPassCount = 5;
+	int iVerifyCaseCount = 0;
+	bool bAnalyticNearFar = true;
+
+	for (int i = 1;i < argc;++i)
+	{
+		if (strcmp(argv[i], "--poses") == 0 && i + 1 < argc)
+		{
+			szPoseFile = argv[++i];
+		}
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+		{
+			iFrameCount = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--passes") == 0 && i + 1 < argc)
+		{
+			iPassCount = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--clipper") == 0)
+		{
+			bAnalyticNearFar = false;
+		}
+		else if (strcmp(argv[i], "--verify") == 0 && i + 1 < argc)
+		{
+			iVerifyCaseCount = atoi(argv[++i]);
+		}
+		else
+		{
+			printf("Usage: %s [--poses file] [--frames count] [--passes count] [--clipper] [--verify cases]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	std::vector<RecordedPose> poses;
+	if (szPoseFile)
+	{
+		if (!LoadPoses(szPoseFile, poses))
+		{
+			printf("Could not read any pose from %s\n", szPoseFile);
+			return 1;
+		}
+	}
+	else
+	{
+		GenerateFlyThrough(iFrameCount > 0 ? iFrameCount : 1, poses);
+	}
+
+	if (iPassCount < 1)
+	{
+		iPassCount = 1;
+	}
+
+	std::vector<XMMATRIX> viewerViews, lightViews;
+	BuildPoseMatrices(poses, viewerViews, lightViews);
+
+	if (iVerifyCaseCount > 0)
+	{
+		int iResult = VerifyAnalyticNearFar(iVerifyCaseCount);
+		iResult |= VerifyCascadeCache(viewerViews, lightViews);
+		iResult |= VerifyDepthReduction(viewerViews, iVerifyCaseCount);
+		iResult |= VerifySceneBounds(lightViews, iVerifyCaseCount);
+		iResult |= VerifyCasterCulling(lightViews, iVerifyCaseCount);
+		iResult |= VerifySmallCasterCulling(lightViews, iVerifyCaseCount);
+		iResult |= VerifyCascadeScrolling(iVerifyCaseCount);
+		iResult |= VerifyMeshSimplification();
+		iResult |= VerifyAtlasPacking(viewerViews, lightViews, iVerifyCaseCount);
+		iResult |= VerifyShadowAtlas(iVerifyCaseCount);
+		iResult |= VerifyShadowBudget(viewerViews, lightViews, iVerifyCaseCount);
+		// With a fixed light the far cascades are deferred,and their guard band has to keep covering the interval.
+		std::vector<XMMATRIX> fixedLightViews(lightViews.size(), lightViews[0]);
+		int iUncoveredCount = ReplayCascadeSchedules(viewerViews, lightViews, 4);
+		iUncoveredCount += ReplayCascadeSchedules(viewerViews, fixedLightViews, 4);
+		iUncoveredCount += ReplayCascadeSchedules(viewerViews, fixedLightViews, MAX_CASCADES);
+		iResult |= VerifyConstantRing(viewerViews, fixedLightViews, iVerifyCaseCount);
+		printf("schedules:%d deferred cascades did not cover their interval or left the guard band\n", iUncoveredCount);
+		return (iUncoveredCount == 0 ? 0 : 1) | iResult;
+	}
+
+	CascadeFitParams params;
+	InitSampleParams(params);
+	params.m_bAnalyticNearFar = bAnalyticNearFar;
+
+	printf("%d poses,best of %d passes,ns/frame,%s near/far\n\n", (int)poses.size(), iPassCount, bAnalyticNearFar ? "analytic" : "clipper");
+	printf("%-34s", "fit / near-far");
+	for (int iCascadeCount = 1;iCascadeCount <= MAX_CASCADES;++iCascadeCount)
+	{
+		printf(" %7d", iCascadeCount);
+	}
+	printf("\n");
+
+	// Keeps the optimizer from throwing the fit away.
+	float fCheckSum = 0.0f;
+	CascadeFitResult result;
+
+	for (int iFitMode = FIT_LIGHT_VIEW_FRUSTRUM_TO_CASCADE_INTERVALS;iFitMode <= FIT_LIGHT_VIEW_FRUSTRUM_TO_SCENE;++iFitMode)
+	{
+		for (int iNearFarMode = FIT_NEAR_FAR_DEFAULT_ZERO_ONE;iNearFarMode <= FIT_NEAR_FAR_PANCAKING;++iNearFarMode)
+		{
+			char label[64];
+			snprintf(label, sizeof(label), "%s / %s", g_szFitModeNames[iFitMode], g_szNearFarModeNames[iNearFarMode]);
+			printf("%-34s", label);
+
+			params.m_eLightViewFrustumFitMode = (FIT_LIGHT_VIEW_FRUSTRUM)iFitMode;
+			params.m_eSelectedNearFarFit = (FIT_NEAR_FAR)iNearFarMode;
+
+			for (int iCascadeCount = 1;iCascadeCount <= MAX_CASCADES;++iCascadeCount)
+			{
+				SetDefaultPartitions(params, iCascadeCount);
+
+				double fBestNsPerFrame = 1e30;
+				for (int iPass = 0;iPass < iPassCount;++iPass)
+				{
+					auto begin = std::chrono::steady_clock::now();
+					for (size_t iPose = 0;iPose < poses.size();++iPose)
+					{
+						params.m_matViewerCameraView = viewerViews[iPose];
+						params.m_matLightCameraView = lightViews[iPose];
+						CascadeFitting::FitCascades(params, &result);
+						fCheckSum += XMVectorGetX(result.m_matOrthoProjForCascades[iCascadeCount - 1].r[3]);
+					}
+					auto end = std::chrono::steady_clock::now();
+
+					double fNsPerFrame = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count() / (double)poses.size();
+					if (fNsPerFrame < fBestNsPerFrame)
+					{
+						fBestNsPerFrame = fNsPerFrame;
+					}
+				}
+				printf(" %7.0f", fBestNsPerFrame);
+			}
+			printf("\n");
+		}
+	}
+
+	printf("\nchecksum %g\n\n", fCheckSum);
+
+	printf("min texels/pixel of the worst cascade on a 1080 line screen\n");
+	ReportTexelDensity(viewerViews, lightViews, 4, FIT_LIGHT_VIEW_FRUSTRUM_TO_CASCADE_INTERVALS);
+	ReportTexelDensity(viewerViews, lightViews, 4, FIT_LIGHT_VIEW_FRUSTRUM_TO_SCENE);
+	printf("\n");
+
+	ReportDepthBounds(viewerViews, lightViews);
+	printf("\n");
+
+	ReportSceneBounds(viewerViews, lightViews);
+	printf("\n");
+
+	ReportCasterCulling(viewerViews, lightViews);
+	printf("\n");
+
+	// The light circles the scene in the generated fly-through,so use a fixed light to see what the schedules save.
+	std::vector<XMMATRIX> fixedLightViews(lightViews.size(), lightViews[0]);
+	for (int iCascadeCount = 2;iCascadeCount <= MAX_CASCADES;iCascadeCount *= 2)
+	{
+		ReplayCascadeSchedules(viewerViews, fixedLightViews, iCascadeCount);
+		ReportCascadeScrolling(viewerViews, fixedLightViews, iCascadeCount);
+	}
+	printf("\n");
+
+	ReportMeshSimplification();
+	printf("\n");
+
+	ReportAtlasPacking(viewerViews, lightViews);
+	printf("\n");
+
+	ReportShadowAtlas(viewerViews);
+	printf("\n");
+
+	ReportShadowBudget(viewerViews, lightViews);
+	return 0;
+}
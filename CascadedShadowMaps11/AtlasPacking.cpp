@@ -0,0 +1,489 @@
+#include "AtlasPacking.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+
+// A run of atlas rows that are all filled up to the same column.The runs of a skyline are ordered by m_iY
+// and cover the atlas height once.
+struct SkylineSegment
+{
+	int m_iY;
+	int m_iHeight;
+	int m_iRight; // First free column
+};
+
+enum QUADTREE_NODE_STATE
+{
+	NODE_UNREACHED, // Below a free or used node,not part of the tree
+	NODE_FREE,
+	NODE_SPLIT,
+	NODE_USED,
+};
+
+}
+
+// Returns the left edge a square of iSize texels gets at the top of segment iSegment,or -1 if it does not fit.
+static int GetSkylineLeft(const std::vector<SkylineSegment>& skyline, size_t iSegment, int iSize, int iAtlasHeight)
+{
+	int iTop = skyline[iSegment].m_iY;
+	if (iTop + iSize > iAtlasHeight)
+	{
+		return -1;
+	}
+
+	int iLeft = 0;
+	for (size_t i = iSegment;i < skyline.size() && skyline[i].m_iY < iTop + iSize;++i)
+	{
+		iLeft = std::max(iLeft, skyline[i].m_iRight);
+	}
+	return iLeft;
+}
+
+// Fills rows iTop..iTop + iSize up to iRight.
+static void RaiseSkyline(std::vector<SkylineSegment>* pSkyline, int iTop, int iSize, int iRight)
+{
+	int iBottom = iTop + iSize;
+	std::vector<SkylineSegment> raised;
+	raised.reserve(pSkyline->size() + 2);
+	for (size_t i = 0;i < pSkyline->size();++i)
+	{
+		const SkylineSegment& segment = (*pSkyline)[i];
+		int iSegmentBottom = segment.m_iY + segment.m_iHeight;
+		if (segment.m_iY < iTop)
+		{
+			SkylineSegment above = { segment.m_iY, std::min(iSegmentBottom, iTop) - segment.m_iY, segment.m_iRight };
+			raised.push_back(above);
+		}
+		if (segment.m_iY <= iTop && iSegmentBottom > iTop)
+		{
+			SkylineSegment filled = { iTop, iSize, iRight };
+			raised.push_back(filled);
+		}
+		if (iSegmentBottom > iBottom)
+		{
+			int iY = std::max(segment.m_iY, iBottom);
+			SkylineSegment below = { iY, iSegmentBottom - iY, segment.m_iRight };
+			raised.push_back(below);
+		}
+	}
+
+	// Neighbours filled up to the same column are one segment.
+	pSkyline->clear();
+	for (size_t i = 0;i < raised.size();++i)
+	{
+		if (!pSkyline->empty() && pSkyline->back().m_iRight == raised[i].m_iRight)
+		{
+			pSkyline->back().m_iHeight += raised[i].m_iHeight;
+		}
+		else
+		{
+			pSkyline->push_back(raised[i]);
+		}
+	}
+}
+
+namespace AtlasPacking
+{
+
+int PackSquaresSkyline(const int* pSizes, int nRectCount, int iAtlasHeight, AtlasRect* pRects)
+{
+	std::vector<int> order(nRectCount);
+	for (int i = 0;i < nRectCount;++i)
+	{
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [pSizes](int a, int b) { return pSizes[a] > pSizes[b]; });
+
+	std::vector<SkylineSegment> skyline;
+	SkylineSegment empty = { 0, iAtlasHeight, 0 };
+	skyline.push_back(empty);
+
+	int iAtlasWidth = 0;
+	for (int i = 0;i < nRectCount;++i)
+	{
+		int iSize = pSizes[order[i]];
+		int iBestLeft = -1;
+		int iBestTop = 0;
+		for (size_t iSegment = 0;iSegment < skyline.size();++iSegment)
+		{
+			int iLeft = GetSkylineLeft(skyline, iSegment, iSize, iAtlasHeight);
+			if (iLeft >= 0 && (iBestLeft < 0 || iLeft < iBestLeft))
+			{
+				iBestLeft = iLeft;
+				iBestTop = skyline[iSegment].m_iY;
+			}
+		}
+		if (iBestLeft < 0)
+		{
+			return -1;
+		}
+
+		AtlasRect& rect = pRects[order[i]];
+		rect.m_iX = iBestLeft;
+		rect.m_iY = iBestTop;
+		rect.m_iWidth = iSize;
+		rect.m_iHeight = iSize;
+		RaiseSkyline(&skyline, iBestTop, iSize, iBestLeft + iSize);
+		iAtlasWidth = std::max(iAtlasWidth, iBestLeft + iSize);
+	}
+	return iAtlasWidth;
+}
+
+void GetHalvingCascadeLengths(int iNearLength, int nCascadeCount, int iMinLength, int* pLengths)
+{
+	for (int i = 0;i < nCascadeCount;++i)
+	{
+		pLengths[i] = std::max(iNearLength >> ((i + 1) / 2), std::min(iMinLength, iNearLength));
+	}
+}
+
+bool AreRectsDisjointInAtlas(const AtlasRect* pRects, int nRectCount, int iAtlasWidth, int iAtlasHeight)
+{
+	for (int i = 0;i < nRectCount;++i)
+	{
+		const AtlasRect& a = pRects[i];
+		if (a.m_iX < 0 || a.m_iY < 0 || a.m_iX + a.m_iWidth > iAtlasWidth || a.m_iY + a.m_iHeight > iAtlasHeight)
+		{
+			return false;
+		}
+		for (int j = i + 1;j < nRectCount;++j)
+		{
+			const AtlasRect& b = pRects[j];
+			if (a.m_iX < b.m_iX + b.m_iWidth && b.m_iX < a.m_iX + a.m_iWidth
+				&& a.m_iY < b.m_iY + b.m_iHeight && b.m_iY < a.m_iY + a.m_iHeight)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+
+int SelectShadowTileLength(float fScreenCoverage, int iMaxLength, int iMinLength, int iPreviousLength)
+{
+	if (fScreenCoverage <= 0.0f)
+	{
+		return 0;
+	}
+
+	// The tile length follows the length of the lit screen area.Lengths are rounded at the geometric middle.
+	float fIdealLength = sqrtf(std::min(fScreenCoverage, 1.0f)) * (float)iMaxLength;
+	if (iPreviousLength >= iMinLength && iPreviousLength <= iMaxLength
+		&& fIdealLength < (float)iPreviousLength * 1.41421356f * 1.1f
+		&& fIdealLength > (float)iPreviousLength * 0.70710678f * 0.9f)
+	{
+		return iPreviousLength;
+	}
+
+	int iLength = iMinLength;
+	while (iLength < iMaxLength && fIdealLength >= (float)iLength * 1.41421356f)
+	{
+		iLength *= 2;
+	}
+	return iLength;
+}
+
+}
+
+QuadtreeShadowAtlas::QuadtreeShadowAtlas()
+	: m_iAtlasLength(0),
+	m_iMinTileLength(0),
+	m_nLevelCount(0)
+{
+}
+
+void QuadtreeShadowAtlas::Reset(int iAtlasLength, int iMinTileLength)
+{
+	m_iAtlasLength = iAtlasLength;
+	m_iMinTileLength = std::min(iMinTileLength, iAtlasLength);
+	m_nLevelCount = 1;
+	size_t nNodeCount = 1;
+	while ((m_iAtlasLength >> (m_nLevelCount - 1)) > m_iMinTileLength)
+	{
+		nNodeCount += (size_t)1 << (2 * m_nLevelCount);
+		++m_nLevelCount;
+	}
+	m_NodeStates.assign(nNodeCount, NODE_UNREACHED);
+	m_FreeNodes.assign(m_nLevelCount, std::vector<int>());
+	m_LightTiles.clear();
+	ClearNodes();
+}
+
+void QuadtreeShadowAtlas::ClearNodes()
+{
+	std::fill(m_NodeStates.begin(), m_NodeStates.end(), (unsigned char)NODE_UNREACHED);
+	for (int i = 0;i < m_nLevelCount;++i)
+	{
+		m_FreeNodes[i].clear();
+	}
+	if (m_nLevelCount > 0)
+	{
+		m_NodeStates[0] = NODE_FREE;
+		m_FreeNodes[0].push_back(0);
+	}
+}
+
+int QuadtreeShadowAtlas::GetLevelOfLength(int iLength) const
+{
+	int iLevel = 0;
+	while ((m_iAtlasLength >> iLevel) > iLength)
+	{
+		++iLevel;
+	}
+	return iLevel;
+}
+
+unsigned char& QuadtreeShadowAtlas::NodeState(int iLevel, int iNode)
+{
+	size_t iLevelStart = (((size_t)1 << (2 * iLevel)) - 1) / 3;
+	return m_NodeStates[iLevelStart + iNode];
+}
+
+// Splits a free node that is already off its free list into four free children.
+void QuadtreeShadowAtlas::SplitNode(int iLevel, int iNode)
+{
+	NodeState(iLevel, iNode) = NODE_SPLIT;
+	int iRowLength = 1 << iLevel;
+	int iChild = (iNode / iRowLength) * 2 * (2 * iRowLength) + (iNode % iRowLength) * 2;
+	int iChildren[4] = { iChild, iChild + 1, iChild + 2 * iRowLength, iChild + 2 * iRowLength + 1 };
+
+	// Pushed backwards so that the top left child is taken first.
+	for (int i = 3;i >= 0;--i)
+	{
+		NodeState(iLevel + 1, iChildren[i]) = NODE_FREE;
+		m_FreeNodes[iLevel + 1].push_back(iChildren[i]);
+	}
+}
+
+// Takes a free node of the level off its free list,splitting the smallest larger free node if there is none.
+int QuadtreeShadowAtlas::TakeFreeNode(int iLevel)
+{
+	if (m_FreeNodes[iLevel].empty())
+	{
+		if (iLevel == 0)
+		{
+			return -1;
+		}
+		int iParent = TakeFreeNode(iLevel - 1);
+		if (iParent < 0)
+		{
+			return -1;
+		}
+		SplitNode(iLevel - 1, iParent);
+	}
+
+	int iNode = m_FreeNodes[iLevel].back();
+	m_FreeNodes[iLevel].pop_back();
+	return iNode;
+}
+
+// Uses the given node if neither it nor a node above it is taken,splitting the free node above it down to it.
+bool QuadtreeShadowAtlas::ClaimNode(int iLevel, int iNode)
+{
+	int iX = iNode % (1 << iLevel);
+	int iY = iNode / (1 << iLevel);
+	int iFreeLevel = -1;
+	for (int i = 0;i <= iLevel && iFreeLevel < 0;++i)
+	{
+		int iShift = iLevel - i;
+		unsigned char state = NodeState(i, (iY >> iShift) * (1 << i) + (iX >> iShift));
+		if (state == NODE_FREE)
+		{
+			iFreeLevel = i;
+		}
+		else if (state != NODE_SPLIT || i == iLevel)
+		{
+			return false;
+		}
+	}
+
+	for (int i = iFreeLevel;i <= iLevel;++i)
+	{
+		int iShift = iLevel - i;
+		int iAncestor = (iY >> iShift) * (1 << i) + (iX >> iShift);
+		std::vector<int>& freeNodes = m_FreeNodes[i];
+		freeNodes.erase(std::find(freeNodes.begin(), freeNodes.end(), iAncestor));
+		if (i < iLevel)
+		{
+			SplitNode(i, iAncestor);
+		}
+	}
+	NodeState(iLevel, iNode) = NODE_USED;
+	return true;
+}
+
+AtlasRect QuadtreeShadowAtlas::GetNodeRect(int iLevel, int iNode) const
+{
+	int iLength = m_iAtlasLength >> iLevel;
+	AtlasRect rect = { (iNode % (1 << iLevel)) * iLength, (iNode / (1 << iLevel)) * iLength, iLength, iLength };
+	return rect;
+}
+
+void QuadtreeShadowAtlas::AllocateFrame(const ShadowAtlasRequest* pRequests, int nRequestCount, AtlasRect* pRects, ShadowAtlasFrameStats* pStats)
+{
+	ShadowAtlasFrameStats stats = {};
+	stats.m_nRequestCount = nRequestCount;
+
+	// Highest coverage first,the light id breaks ties so that the order does not depend on the request order.
+	std::vector<int> order(nRequestCount);
+	for (int i = 0;i < nRequestCount;++i)
+	{
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [pRequests](int a, int b)
+	{
+		if (pRequests[a].m_fScreenCoverage != pRequests[b].m_fScreenCoverage)
+		{
+			return pRequests[a].m_fScreenCoverage > pRequests[b].m_fScreenCoverage;
+		}
+		return pRequests[a].m_uLightId < pRequests[b].m_uLightId;
+	});
+
+	std::vector<int> wantedLengths(nRequestCount);
+	std::vector<int> lengths(nRequestCount);
+	long long iAtlasTexels = (long long)m_iAtlasLength * m_iAtlasLength;
+	long long iWantedTexels = 0;
+	for (int i = 0;i < nRequestCount;++i)
+	{
+		int iLength = 0;
+		if (pRequests[i].m_iTileLength > 0)
+		{
+			iLength = m_iMinTileLength;
+			while (iLength * 2 <= std::min(pRequests[i].m_iTileLength, m_iAtlasLength))
+			{
+				iLength *= 2;
+			}
+		}
+		wantedLengths[i] = lengths[i] = iLength;
+		iWantedTexels += (long long)iLength * iLength;
+	}
+
+	// Halve the tile of the least covering light that can still be halved,drop tiles once all are the smallest.
+	while (iWantedTexels > iAtlasTexels)
+	{
+		int iShrunk = -1;
+		for (int i = nRequestCount - 1;i >= 0 && iShrunk < 0;--i)
+		{
+			iShrunk = lengths[order[i]] > m_iMinTileLength ? order[i] : -1;
+		}
+		if (iShrunk >= 0)
+		{
+			iWantedTexels -= (long long)lengths[iShrunk] * lengths[iShrunk] * 3 / 4;
+			lengths[iShrunk] /= 2;
+			continue;
+		}
+		for (int i = nRequestCount - 1;i >= 0 && iShrunk < 0;--i)
+		{
+			iShrunk = lengths[order[i]] > 0 ? order[i] : -1;
+		}
+		iWantedTexels -= (long long)lengths[iShrunk] * lengths[iShrunk];
+		lengths[iShrunk] = 0;
+	}
+
+	// Keep last frame's tiles where the length did not change.
+	ClearNodes();
+	std::vector<const LightTile*> previousTiles(nRequestCount);
+	std::vector<int> nodes(nRequestCount, -1);
+	for (int i = 0;i < nRequestCount;++i)
+	{
+		int iRequest = order[i];
+		LightTile key = { pRequests[iRequest].m_uLightId, 0, 0 };
+		auto it = std::lower_bound(m_LightTiles.begin(), m_LightTiles.end(), key,
+			[](const LightTile& a, const LightTile& b) { return a.m_uLightId < b.m_uLightId; });
+		previousTiles[iRequest] = (it != m_LightTiles.end() && it->m_uLightId == key.m_uLightId) ? &*it : nullptr;
+
+		const LightTile* pPrevious = previousTiles[iRequest];
+		if (lengths[iRequest] > 0 && pPrevious && pPrevious->m_iLevel == GetLevelOfLength(lengths[iRequest])
+			&& ClaimNode(pPrevious->m_iLevel, pPrevious->m_iNode))
+		{
+			nodes[iRequest] = pPrevious->m_iNode;
+		}
+	}
+
+	// Place the others largest first,in order of coverage within a length.
+	std::vector<int> placeOrder(order);
+	std::stable_sort(placeOrder.begin(), placeOrder.end(), [&lengths](int a, int b) { return lengths[a] > lengths[b]; });
+	for (int i = 0;i < nRequestCount && lengths[placeOrder[i]] > 0;++i)
+	{
+		int iRequest = placeOrder[i];
+		if (nodes[iRequest] < 0)
+		{
+			nodes[iRequest] = TakeFreeNode(GetLevelOfLength(lengths[iRequest]));
+			if (nodes[iRequest] < 0)
+			{
+				stats.m_nRepackCount = 1;
+				break;
+			}
+			NodeState(GetLevelOfLength(lengths[iRequest]), nodes[iRequest]) = NODE_USED;
+		}
+	}
+
+	if (stats.m_nRepackCount)
+	{
+		ClearNodes();
+		for (int i = 0;i < nRequestCount && lengths[placeOrder[i]] > 0;++i)
+		{
+			int iRequest = placeOrder[i];
+			int iLevel = GetLevelOfLength(lengths[iRequest]);
+			nodes[iRequest] = TakeFreeNode(iLevel);
+			NodeState(iLevel, nodes[iRequest]) = NODE_USED;
+		}
+	}
+
+	std::vector<LightTile> lightTiles;
+	lightTiles.reserve(nRequestCount);
+	for (int i = 0;i < nRequestCount;++i)
+	{
+		AtlasRect empty = { 0, 0, 0, 0 };
+		pRects[i] = empty;
+		const LightTile* pPrevious = previousTiles[i];
+		if (lengths[i] == 0)
+		{
+			stats.m_nRejectedCount += wantedLengths[i] > 0 ? 1 : 0;
+			continue;
+		}
+
+		int iLevel = GetLevelOfLength(lengths[i]);
+		pRects[i] = GetNodeRect(iLevel, nodes[i]);
+		++stats.m_nAllocatedCount;
+		stats.m_nDowngradedCount += lengths[i] < wantedLengths[i] ? 1 : 0;
+		stats.m_iUsedTexels += (long long)lengths[i] * lengths[i];
+		if (pPrevious && pPrevious->m_iLevel == iLevel && pPrevious->m_iNode == nodes[i])
+		{
+			++stats.m_nKeptCount;
+		}
+		else if (pPrevious)
+		{
+			++stats.m_nMovedCount;
+		}
+
+		LightTile tile = { pRequests[i].m_uLightId, iLevel, nodes[i] };
+		lightTiles.push_back(tile);
+	}
+	std::sort(lightTiles.begin(), lightTiles.end(), [](const LightTile& a, const LightTile& b) { return a.m_uLightId < b.m_uLightId; });
+	m_LightTiles.swap(lightTiles);
+
+	for (int i = 0;i < m_nLevelCount;++i)
+	{
+		if (!m_FreeNodes[i].empty())
+		{
+			stats.m_iLargestFreeTileLength = m_iAtlasLength >> i;
+			break;
+		}
+	}
+	long long iFreeTexels = iAtlasTexels - stats.m_iUsedTexels;
+	if (iFreeTexels > 0)
+	{
+		stats.m_fFragmentation = 1.0f - (float)((double)stats.m_iLargestFreeTileLength * stats.m_iLargestFreeTileLength / (double)iFreeTexels);
+	}
+
+	if (pStats)
+	{
+		*pStats = stats;
+	}
+}
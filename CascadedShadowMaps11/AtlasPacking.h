@@ -0,0 +1,113 @@
+//--------------------------------------------------------------------------------------
+// File: AtlasPacking.h
+//
+// Places the cascade tiles in the shadow atlas when the cascades have different resolutions,and
+// hands out the tiles of a shadow atlas shared by many lights (QuadtreeShadowAtlas).
+// Like CascadeFitting it only depends on the standard library,so the packing can be checked
+// without a D3D11 device (see CascadeFittingBench).
+//--------------------------------------------------------------------------------------
+#pragma once
+
+#include <vector>
+
+// A rectangle of atlas texels,m_iX and m_iY are its top left corner.
+struct AtlasRect
+{
+	int m_iX;
+	int m_iY;
+	int m_iWidth;
+	int m_iHeight;
+};
+
+// A shadowed light asking the shadow atlas for a tile this frame.
+struct ShadowAtlasRequest
+{
+	unsigned int m_uLightId; // Stays the same from frame to frame,a light keeps its tile by it
+	float m_fScreenCoverage; // Share of the screen the light reaches,lights covering more get their tile first
+	int m_iTileLength; // Wanted tile length,rounded down to a power of two.0 asks for no tile
+};
+
+// What one QuadtreeShadowAtlas::AllocateFrame did.
+struct ShadowAtlasFrameStats
+{
+	int m_nRequestCount;
+	int m_nAllocatedCount;
+	int m_nDowngradedCount; // Allocated a smaller tile than asked for
+	int m_nRejectedCount; // Asked for a tile and got none,the light is not shadowed this frame
+	int m_nKeptCount; // Same tile as last frame,its shadow map can be kept if nothing moved
+	int m_nMovedCount; // Had a tile last frame and got another one,its shadow map is rendered anew
+	int m_nRepackCount; // 1 if the kept tiles left no room and every tile was placed anew
+	long long m_iUsedTexels;
+	int m_iLargestFreeTileLength;
+	float m_fFragmentation; // 1 - texels of the largest free tile / free texels,0 while the free space is one tile
+};
+
+// Hands out power of two tiles of a square shadow atlas to any number of shadowed lights.The atlas is a quadtree
+// whose nodes are free,split into four or used by a tile,and it is rebuilt from the requests of every frame:
+// the tile lengths are halved from the least covering light up until all tiles fit in the atlas,then every light
+// keeps last frame's tile if its length did not change and the others are placed largest first,each in the
+// smallest free node that holds it.Placing power of two squares largest first into an empty quadtree never fails
+// once their texels fit,so if the kept tiles leave no room every tile is placed anew.
+class QuadtreeShadowAtlas
+{
+public:
+	QuadtreeShadowAtlas();
+
+	// Empties the atlas and forgets the tiles of last frame.Both lengths are powers of two.
+	void Reset(int iAtlasLength, int iMinTileLength);
+
+	// Places the tiles of nRequestCount lights.pRects[i] is the tile of pRequests[i],0 wide if it got none.
+	void AllocateFrame(const ShadowAtlasRequest* pRequests, int nRequestCount, AtlasRect* pRects, ShadowAtlasFrameStats* pStats);
+
+	int GetAtlasLength() const { return m_iAtlasLength; }
+	int GetMinTileLength() const { return m_iMinTileLength; }
+
+private:
+	// The tile a light got last frame.
+	struct LightTile
+	{
+		unsigned int m_uLightId;
+		int m_iLevel;
+		int m_iNode;
+	};
+
+	void ClearNodes();
+	int GetLevelOfLength(int iLength) const;
+	unsigned char& NodeState(int iLevel, int iNode);
+	void SplitNode(int iLevel, int iNode);
+	int TakeFreeNode(int iLevel);
+	bool ClaimNode(int iLevel, int iNode);
+	AtlasRect GetNodeRect(int iLevel, int iNode) const;
+
+	int m_iAtlasLength;
+	int m_iMinTileLength;
+	int m_nLevelCount; // Level 0 is the whole atlas,level l has 4^l nodes of m_iAtlasLength >> l texels in rows
+	std::vector<unsigned char> m_NodeStates; // Level l starts at (4^l - 1) / 3
+	std::vector<std::vector<int> > m_FreeNodes; // Free nodes of every level,the last one is taken first
+	std::vector<LightTile> m_LightTiles; // Sorted by light id
+};
+
+namespace AtlasPacking
+{
+	// Packs nRectCount squares of pSizes[i] texels into an atlas iAtlasHeight texels tall that grows to the right.
+	// The squares are placed largest first with a skyline:every square goes to the height where its left edge
+	// is furthest to the left,the lowest such height on a tie.Squares of one size end up side by side in order.
+	// Writes the square of pSizes[i] to pRects[i] and returns the atlas width,or -1 if a square is taller than
+	// the atlas.
+	int PackSquaresSkyline(const int* pSizes, int nRectCount, int iAtlasHeight, AtlasRect* pRects);
+
+	// Fills pLengths with tile lengths that halve every second cascade:iNearLength for cascade 0,half of it for
+	// cascades 1 and 2,a quarter for 3 and 4 and so on,but never below iMinLength or above iNearLength.The far
+	// cascades cover more of the view per texel anyway,so the near field keeps its resolution at about half
+	// the atlas size of iNearLength tiles for 4 cascades.
+	void GetHalvingCascadeLengths(int iNearLength, int nCascadeCount, int iMinLength, int* pLengths);
+
+	// Returns true if none of the nRectCount rectangles overlap and all of them lie inside the atlas.
+	bool AreRectsDisjointInAtlas(const AtlasRect* pRects, int nRectCount, int iAtlasWidth, int iAtlasHeight);
+
+	// Returns the power of two tile length of a light that covers fScreenCoverage of the screen,iMaxLength for
+	// the whole screen and never below iMinLength,or 0 for a light off screen.iPreviousLength is the length the
+	// light had last frame or 0:it is kept until the coverage is 10% past the middle to the next length,so a light
+	// close to the middle does not get a new tile every frame.
+	int SelectShadowTileLength(float fScreenCoverage, int iMaxLength, int iMinLength, int iPreviousLength);
+}
@@ -0,0 +1,1949 @@
+#include "CascadeFitting.h"
+#include "AtlasPacking.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+using namespace DirectX;
+
+static const XMVECTORF32 g_vFLTMAX = { FLT_MAX,FLT_MAX, FLT_MAX, FLT_MAX };
+static const XMVECTORF32 g_vFLTMIN = { -FLT_MAX,-FLT_MAX, -FLT_MAX, -FLT_MAX };
+static const XMVECTORF32 g_vHalfVector = { 0.5f,0.5f,0.5f,0.5f };
+static const XMVECTORF32 g_vMultiplySetzwZero = { 1.0f,1.0f,0.0f,0.0f };
+static const XMVECTORF32 g_vZero = { 0.0f,0.0f,0.0f,0.0f };
+
+// Part of the depth bounds range added on both sides,the bounds are from the previous frame.
+#define DEPTH_BOUNDS_PADDING 0.05f
+
+namespace CascadeFitting
+{
+
+int GetCascadeLengthOfShadowBuffer(const CascadeFitParams& params, int iCascadeIndex)
+{
+	int iLength = params.m_iCascadeLengthOfShadowBuffer[iCascadeIndex];
+	return iLength > 0 ? iLength : params.m_iLengthOfShadowBufferSquare;
+}
+
+void FitCascades(const CascadeFitParams& params, CascadeFitResult* pResult)
+{
+	XMVECTOR det;
+	XMMATRIX InverseViewCamera = XMMatrixInverse(&det, params.m_matViewerCameraView);
+
+	// Convert from min max representation to center extents representation
+	// This will make it easier to pull the points out of the transformation.
+	XMVECTOR vSceneCenter = params.m_vSceneAABBMin + params.m_vSceneAABBMax;
+	vSceneCenter *= g_vHalfVector;
+	XMVECTOR vSceneExtends = params.m_vSceneAABBMax - params.m_vSceneAABBMin;
+	vSceneExtends *= g_vHalfVector;
+
+	XMVECTOR vSceneAABBPointsInLightView[8];
+	//This function simply converts the center and extends of an AABB into 8 points
+	CreateAABBPoints(vSceneAABBPointsInLightView, vSceneCenter, vSceneExtends);
+	//Transform the scene AABB to Light space.
+	for (int index = 0;index<8;++index)
+	{
+		vSceneAABBPointsInLightView[index] = XMVector4Transform(vSceneAABBPointsInLightView[index], params.m_matLightCameraView);
+	}
+
+	// The cascade corners go from camera view space to light space with a single matrix.
+	XMMATRIX matViewToLight = XMMatrixMultiply(InverseViewCamera, params.m_matLightCameraView);
+
+	XMVECTOR vLightSpaceSceneAABBminValue = g_vFLTMAX; //World space scene aabb
+	XMVECTOR vLightSpaceSceneAABBmaxValue = g_vFLTMIN;
+
+	// We calculate the min and max vectors of the scene in the light space.The min and max "Z" values of the light space AABB
+	// can be used for the near and far plane.This is easier than intersecting the scene with the AABB
+	// and in some cases provides similar results
+	for (int index = 0;index<8;++index)
+	{
+		vLightSpaceSceneAABBminValue = XMVectorMin(vSceneAABBPointsInLightView[index], vLightSpaceSceneAABBminValue);
+		vLightSpaceSceneAABBmaxValue = XMVectorMax(vSceneAABBPointsInLightView[index], vLightSpaceSceneAABBmaxValue);
+	}
+
+	// The partition planes are shared by neighbouring cascades,so their corners are built once.
+	BuildFrustumSlices(params, matViewToLight, &pResult->m_FrustumSlices);
+
+	//This calculates the min and max values for the orthographic projection of every cascade.
+	CascadeLightSpaceBounds lightSpaceBounds;
+	ComputeLightSpaceCascadeBounds(params, pResult->m_FrustumSlices, &lightSpaceBounds);
+
+	XMVECTOR vOrthographicMinInLightView[MAX_CASCADES] = {}; //light space frustum aabb
+	XMVECTOR vOrthographicMaxInLightView[MAX_CASCADES] = {};
+	float fOrthographicMinZInLightView[MAX_CASCADES];
+
+	XMVECTOR vViewSpaceUnitsPerTexel = g_vZero;
+
+	// we loop over the cascade to calculate the orthographic bound for each cascade.
+	for (int iCascadeIndex = 0;iCascadeIndex<params.m_nUsingCascadeLevelsCount;++iCascadeIndex)
+	{
+		XMVECTOR vOrthographicMin = lightSpaceBounds.m_vMin[iCascadeIndex];
+		XMVECTOR vOrthographicMax = lightSpaceBounds.m_vMax[iCascadeIndex];
+
+		//This code removes the shimmering effect along the edges of shadow due to
+		// the light changing to fit the camera.
+		if (params.m_eLightViewFrustumFitMode == FIT_LIGHT_VIEW_FRUSTRUM_TO_SCENE)
+		{
+			// Fit the ortho projection to the cascades far plane and a near plane of zero.
+			// Pad the projection to be the size of the diagonal of the Frustum partition.
+
+			// To do this, we pad the ortho transform so that it is always big enough to cover
+			// the entire camera view frustum.
+			// The bound is the length of the diagonal of the frustum interval.
+			float fCascadeBound = lightSpaceBounds.m_fFrustumDiagonal[iCascadeIndex];
+			XMVECTOR vDiagonal = XMVectorReplicate(fCascadeBound);
+
+			//The offset calculated will pad the ortho projection so that it is always the same size
+			// and big enough to cover the entire cascade interval
+			XMVECTOR vBoarderoffset = (vDiagonal - (vOrthographicMax - vOrthographicMin))* g_vHalfVector;
+
+			//Set the Z and W component to zero
+			vBoarderoffset *= g_vMultiplySetzwZero;
+
+			//Add the offsets to the projection.
+			vOrthographicMax += vBoarderoffset;
+			vOrthographicMin -= vBoarderoffset;
+
+			//The world units per texel are used to snap the shadow the orthographic projection
+			// to texel sized increments.This keeps the edges of the shadows from shimmering.
+			float fViewSpaceUnitsPerTexel = fCascadeBound / (float)GetCascadeLengthOfShadowBuffer(params, iCascadeIndex);
+			vViewSpaceUnitsPerTexel = XMVectorSet(fViewSpaceUnitsPerTexel, fViewSpaceUnitsPerTexel, 0.0f, 0.0f);
+		}
+		else if (params.m_eLightViewFrustumFitMode == FIT_LIGHT_VIEW_FRUSTRUM_TO_CASCADE_INTERVALS)
+		{
+			// We calculate a looser bound based on the size of the PCF blur. This ensures us that we're
+			// Sampling within the correct map.
+			float fScaleDuetoBluredAMT = ((float)(params.m_iPCFBlurSize * 2 + 1) / (float)GetCascadeLengthOfShadowBuffer(params, iCascadeIndex));
+			XMVECTORF32 vScaleDueToBluredAMT = { fScaleDuetoBluredAMT, fScaleDuetoBluredAMT, 0.0f, 0.0f };
+
+			float fTexelStepeByBufferSize = ((1.0f) / (float)GetCascadeLengthOfShadowBuffer(params, iCascadeIndex));
+			XMVECTOR vTexelStepByBufferSize = XMVectorSet(fTexelStepeByBufferSize, fTexelStepeByBufferSize, 0.0f, 0.0f);
+
+			//We calculate the offsets as a percentage of the bound.
+			XMVECTOR vBoarderOffset = vOrthographicMax - vOrthographicMin;
+			vBoarderOffset *= g_vHalfVector;
+			vBoarderOffset *= vScaleDueToBluredAMT;
+			vOrthographicMax += vBoarderOffset;
+			vOrthographicMin -= vBoarderOffset;
+
+			// The world units per texel are used to snap the orthographic projection
+			// to texel sized increments
+			// Because we're fitting tightly to the cascade,the shimmering shadow edges will still be present when
+			// the camera rotates.However when zooming in or strafing the shadow edge will not shimmer.
+			vViewSpaceUnitsPerTexel = vOrthographicMax - vOrthographicMin;
+			vViewSpaceUnitsPerTexel *= vTexelStepByBufferSize;
+		}
+
+		// The guard band lets the frustum interval move inside a far cascade's projection for a few frames before its
+		// deferred tile stops covering it.The texel grows so the tile keeps its length.
+		int iCascadeLength = GetCascadeLengthOfShadowBuffer(params, iCascadeIndex);
+		if (iCascadeIndex > 0 && params.m_iFarCascadeGuardTexels > 0 && params.m_iFarCascadeGuardTexels * 4 < iCascadeLength)
+		{
+			float fGuardScale = (float)iCascadeLength / (float)(iCascadeLength - 2 * params.m_iFarCascadeGuardTexels);
+			vViewSpaceUnitsPerTexel = XMVectorScale(vViewSpaceUnitsPerTexel, fGuardScale);
+			XMVECTOR vGuard = XMVectorScale(vViewSpaceUnitsPerTexel, (float)params.m_iFarCascadeGuardTexels);
+			vOrthographicMax += vGuard;
+			vOrthographicMin -= vGuard;
+		}
+
+		fOrthographicMinZInLightView[iCascadeIndex] = XMVectorGetZ(vOrthographicMin);
+
+		if (params.m_bMoveLightTexelSize)
+		{
+			SnapOrthoBoundsToTexels(vOrthographicMin, vOrthographicMax, vViewSpaceUnitsPerTexel);
+		}
+
+		vOrthographicMinInLightView[iCascadeIndex] = vOrthographicMin;
+		vOrthographicMaxInLightView[iCascadeIndex] = vOrthographicMax;
+		pResult->m_vViewSpaceUnitsPerTexel[iCascadeIndex] = vViewSpaceUnitsPerTexel;
+	}
+
+	// These are the unconfigured near and far plane values. They are purposely awful to show
+	// how important calculating accurate near and far plane is.
+	float fNearPlaneInLightView[MAX_CASCADES];
+	float fFarPlaneInLightView[MAX_CASCADES];
+	for (int iCascadeIndex = 0;iCascadeIndex<params.m_nUsingCascadeLevelsCount;++iCascadeIndex)
+	{
+		fNearPlaneInLightView[iCascadeIndex] = 0.0f;
+		fFarPlaneInLightView[iCascadeIndex] = 10000.0f;
+	}
+
+	if (params.m_pSceneBounds != nullptr && params.m_eSelectedNearFarFit != FIT_NEAR_FAR_DEFAULT_ZERO_ONE)
+	{
+		// Only the meshes under each cascade count.A cascade over empty space casts no shadow,any range does.
+		ComputeNearAndFarFromSceneBounds(*params.m_pSceneBounds, params.m_matLightCameraView, params.m_eSelectedNearFarFit,
+			params.m_bAnalyticNearFar, params.m_nUsingCascadeLevelsCount, vOrthographicMinInLightView, vOrthographicMaxInLightView,
+			fNearPlaneInLightView, fFarPlaneInLightView);
+
+		for (int iCascadeIndex = 0;iCascadeIndex<params.m_nUsingCascadeLevelsCount;++iCascadeIndex)
+		{
+			if (fNearPlaneInLightView[iCascadeIndex] > fFarPlaneInLightView[iCascadeIndex])
+			{
+				fNearPlaneInLightView[iCascadeIndex] = XMVectorGetZ(vLightSpaceSceneAABBminValue);
+				fFarPlaneInLightView[iCascadeIndex] = XMVectorGetZ(vLightSpaceSceneAABBmaxValue);
+			}
+		}
+	}
+	else if (params.m_eSelectedNearFarFit == FIT_NEAR_FAR_ONLY_SCENE_AABB)
+	{
+		//The min and max z values are the near and far planes.
+		for (int iCascadeIndex = 0;iCascadeIndex<params.m_nUsingCascadeLevelsCount;++iCascadeIndex)
+		{
+			fNearPlaneInLightView[iCascadeIndex] = XMVectorGetZ(vLightSpaceSceneAABBminValue);
+			fFarPlaneInLightView[iCascadeIndex] = XMVectorGetZ(vLightSpaceSceneAABBmaxValue);
+		}
+	}
+	else if (params.m_eSelectedNearFarFit == FIT_NEAR_FAR_SCENE_AABB_AND_ORTHO_BOUND || params.m_eSelectedNearFarFit == FIT_NEAR_FAR_PANCAKING)
+	{
+		//By intersecting the light frustum with the scene AABB we can get a tighter bound on the near and far plane.
+		bool bSolved = params.m_bAnalyticNearFar && ComputeNearAndFarAnalytic(params.m_nUsingCascadeLevelsCount,
+			vOrthographicMinInLightView, vOrthographicMaxInLightView, vSceneAABBPointsInLightView, fNearPlaneInLightView, fFarPlaneInLightView);
+
+		for (int iCascadeIndex = 0;iCascadeIndex<params.m_nUsingCascadeLevelsCount && !bSolved;++iCascadeIndex)
+		{
+			ComputeNearAndFarInViewSpace(fNearPlaneInLightView[iCascadeIndex], fFarPlaneInLightView[iCascadeIndex],
+				vOrthographicMinInLightView[iCascadeIndex], vOrthographicMaxInLightView[iCascadeIndex], vSceneAABBPointsInLightView);
+		}
+	}
+
+	if (params.m_eSelectedNearFarFit == FIT_NEAR_FAR_PANCAKING)
+	{
+		for (int iCascadeIndex = 0;iCascadeIndex<params.m_nUsingCascadeLevelsCount;++iCascadeIndex)
+		{
+			if (fOrthographicMinZInLightView[iCascadeIndex] > fNearPlaneInLightView[iCascadeIndex])
+			{
+				fNearPlaneInLightView[iCascadeIndex] = fOrthographicMinZInLightView[iCascadeIndex];
+			}
+		}
+	}
+
+	for (int iCascadeIndex = 0;iCascadeIndex<params.m_nUsingCascadeLevelsCount;++iCascadeIndex)
+	{
+		//Create the orthographic projection for this cacscade.
+		pResult->m_matOrthoProjForCascades[iCascadeIndex] = XMMatrixOrthographicOffCenterLH(
+			XMVectorGetX(vOrthographicMinInLightView[iCascadeIndex]), XMVectorGetX(vOrthographicMaxInLightView[iCascadeIndex]),
+			XMVectorGetY(vOrthographicMinInLightView[iCascadeIndex]), XMVectorGetY(vOrthographicMaxInLightView[iCascadeIndex]),
+			fNearPlaneInLightView[iCascadeIndex], fFarPlaneInLightView[iCascadeIndex]);
+
+		pResult->m_fCascadePartitionDepthsInEyeSpace[iCascadeIndex] = pResult->m_FrustumSlices.m_fDepthInView[iCascadeIndex + 1];
+	}
+
+	pResult->m_matShadowView = params.m_matLightCameraView;
+}
+
+
+void ComputeSplitDepths(const CascadeFitParams& params, float* pSplitDepths)
+{
+	// The cascades start at the eye and end at the far plane,unless the depth bounds of the visible pixels say
+	// that the geometry only covers part of that range.The bounds are a frame old,so they are padded.
+	float fBegin = 0.0f;
+	float fNear = params.m_fViewerCameraNearClip;
+	float fFar = params.m_fViewerCameraFarClip;
+	if (params.m_bUseDepthBounds)
+	{
+		float fPadding = (params.m_fDepthBoundsMax - params.m_fDepthBoundsMin) * DEPTH_BOUNDS_PADDING + params.m_fViewerCameraNearClip;
+		fNear = fminf(fmaxf(params.m_fDepthBoundsMin - fPadding, params.m_fViewerCameraNearClip), params.m_fViewerCameraFarClip);
+		fFar = fminf(fmaxf(params.m_fDepthBoundsMax + fPadding, fNear + fPadding), params.m_fViewerCameraFarClip);
+		fBegin = fNear;
+	}
+	pSplitDepths[0] = fBegin;
+
+	if (params.m_eSplitMode == CASCADE_SPLIT_PRACTICAL)
+	{
+		// The practical split scheme:the logarithmic split gives every cascade the same texel to pixel ratio,
+		// the uniform split keeps the first cascades from getting too small.
+		for (int i = 0;i < params.m_nUsingCascadeLevelsCount;++i)
+		{
+			float fRatio = (float)(i + 1) / (float)params.m_nUsingCascadeLevelsCount;
+			float fLogSplit = fNear * powf(fFar / fNear, fRatio);
+			float fUniformSplit = fNear + (fFar - fNear) * fRatio;
+			pSplitDepths[i + 1] = params.m_fSplitLambda * fLogSplit + (1.0f - params.m_fSplitLambda) * fUniformSplit;
+		}
+		return;
+	}
+
+	// Scale the intervals between 0 and 1,They are now percentages that we can scale with.
+	float fCameraNearFarRange = params.m_bUseDepthBounds ? fFar - fBegin : fFar - fNear;
+	for (int i = 0;i < params.m_nUsingCascadeLevelsCount;++i)
+	{
+		pSplitDepths[i + 1] = fBegin + (float)params.m_iCascadePartitionsZeroToOne[i] / (float)params.m_iCascadePartitionMax*fCameraNearFarRange;
+	}
+}
+
+
+bool ReduceDepthBounds(const float* pDepth, int iWidth, int iHeight, int iRowPitchInFloats, CXMMATRIX matViewerCameraProj,
+	float* pMinDepthInView, float* pMaxDepthInView)
+{
+	// The depth buffer is monotonic in view depth,so the raw values are reduced and only the two results converted.
+	// Cleared pixels are replaced by FLT_MAX for the min and by 0 for the max.
+	XMVECTOR vMin = g_vFLTMAX;
+	XMVECTOR vMax = g_vZero;
+	float fMin = FLT_MAX;
+	float fMax = 0.0f;
+	for (int y = 0;y < iHeight;++y)
+	{
+		const float* pRow = pDepth + y * iRowPitchInFloats;
+		int x = 0;
+		for (;x + 4 <= iWidth;x += 4)
+		{
+			XMVECTOR vDepth = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(pRow + x));
+			XMVECTOR vWritten = XMVectorLess(vDepth, g_XMOne);
+			vMin = XMVectorMin(vMin, XMVectorSelect(g_vFLTMAX, vDepth, vWritten));
+			vMax = XMVectorMax(vMax, XMVectorSelect(g_vZero, vDepth, vWritten));
+		}
+		for (;x < iWidth;++x)
+		{
+			if (pRow[x] < 1.0f)
+			{
+				fMin = fminf(fMin, pRow[x]);
+				fMax = fmaxf(fMax, pRow[x]);
+			}
+		}
+	}
+
+	XMFLOAT4 vLaneMin, vLaneMax;
+	XMStoreFloat4(&vLaneMin, vMin);
+	XMStoreFloat4(&vLaneMax, vMax);
+	fMin = fminf(fminf(fMin, vLaneMin.x), fminf(vLaneMin.y, fminf(vLaneMin.z, vLaneMin.w)));
+	fMax = fmaxf(fmaxf(fMax, vLaneMax.x), fmaxf(vLaneMax.y, fmaxf(vLaneMax.z, vLaneMax.w)));
+	if (fMin > fMax)
+	{
+		return false;
+	}
+
+	*pMinDepthInView = DepthBufferToViewDepth(matViewerCameraProj, fMin);
+	*pMaxDepthInView = DepthBufferToViewDepth(matViewerCameraProj, fMax);
+	return true;
+}
+
+
+float DepthBufferToViewDepth(CXMMATRIX matViewerCameraProj, float fDepth)
+{
+	// A perspective projection writes depth = _33 + _43/z.
+	float f33 = XMVectorGetZ(matViewerCameraProj.r[2]);
+	float f43 = XMVectorGetZ(matViewerCameraProj.r[3]);
+	return f43 / (fDepth - f33);
+}
+
+
+void ComputeTexelDensity(const CascadeFitParams& params, const XMMATRIX* pOrthoProj, const CascadeFrustumSlices& slices,
+	int iScreenHeight, CascadeTexelDensity* pDensity)
+{
+	// A pixel at view depth d is 2*d/(proj._22*height) units tall.
+	float fPixelSizePerDepth = 2.0f / (XMVectorGetY(params.m_matViewerCameraProj.r[1]) * (float)iScreenHeight);
+
+	pDensity->m_fMinTexelsPerPixel = FLT_MAX;
+	for (int iCascadeIndex = 0;iCascadeIndex < params.m_nUsingCascadeLevelsCount;++iCascadeIndex)
+	{
+		// The ortho projection maps 2/_11 by 2/_22 light space units onto the tile.
+		float fTexelSizeX = 2.0f / (XMVectorGetX(pOrthoProj[iCascadeIndex].r[0]) * (float)GetCascadeLengthOfShadowBuffer(params, iCascadeIndex));
+		float fTexelSizeY = 2.0f / (XMVectorGetY(pOrthoProj[iCascadeIndex].r[1]) * (float)GetCascadeLengthOfShadowBuffer(params, iCascadeIndex));
+		float fTexelSize = fmaxf(fTexelSizeX, fTexelSizeY);
+
+		// Pixels grow linearly with depth,so the geometric middle of the interval is where the cascade is
+		// as far above its worst (nearest) pixels as below its best ones.
+		float fDepth = sqrtf(fmaxf(slices.m_fDepthInView[iCascadeIndex], params.m_fViewerCameraNearClip) * slices.m_fDepthInView[iCascadeIndex + 1]);
+		float fTexelsPerPixel = fDepth * fPixelSizePerDepth / fTexelSize;
+
+		pDensity->m_fWorldUnitsPerTexel[iCascadeIndex] = fTexelSize;
+		pDensity->m_fTexelsPerPixel[iCascadeIndex] = fTexelsPerPixel;
+		pDensity->m_fMinTexelsPerPixel = fminf(pDensity->m_fMinTexelsPerPixel, fTexelsPerPixel);
+	}
+}
+
+
+void GetCascadeSliceRange(const CascadeFitParams& params, int iCascadeIndex, int& iBeginSlice, int& iEndSlice)
+{
+	// Calculate the interval to the View Frustum that this cascade covers.We measure the interval
+	// the cascade covers as a Min and Max Distance along the Z Axis
+	if (params.m_eLightViewFrustumFitMode == FIT_LIGHT_VIEW_FRUSTRUM_TO_CASCADE_INTERVALS)
+	{
+		// Because we want to fit the orthograpic projection tightly around the Cascade,we set the Minimum cascade
+		// value to the previous Frustum and Interval
+		iBeginSlice = iCascadeIndex;
+	}
+	else
+	{
+		// In the FIT_TO_SCENE technique the Cascade overlap each other.
+		//In other words,interval 1 is covered by cascades 1 to 8,interval 2 is covered by cascade 2 to 8 and so forth.
+		iBeginSlice = 0;
+	}
+	iEndSlice = iCascadeIndex + 1;
+}
+
+
+static const XMVECTORU32 g_vGrabY = { 0x00000000,0xFFFFFFFF,0x00000000,0x00000000 };
+static const XMVECTORU32 g_vGrabX = { 0xFFFFFFFF,0x00000000,0x00000000,0x00000000 };
+
+#define SLICE_LANE_GROUPS ((MAX_CASCADES + 1 + 3) / 4)
+
+void BuildFrustumSlices(const CascadeFitParams& params, CXMMATRIX matViewToLight, CascadeFrustumSlices* pSlices)
+{
+	int nSliceCount = params.m_nUsingCascadeLevelsCount + 1;
+	pSlices->m_nSliceCount = nSliceCount;
+
+	float fSliceDepth[SLICE_LANE_GROUPS * 4] = { 0.0f };
+	ComputeSplitDepths(params, fSliceDepth);
+
+	XMVECTOR vRightTopSlope, vLeftBottomSlope;
+	ComputeFrustumSlopes(params.m_matViewerCameraProj, &vRightTopSlope, &vLeftBottomSlope);
+
+	// The corner directions at depth 1:right top,right bottom,left bottom,left top.
+	XMVECTOR vCornerDirection[4];
+	vCornerDirection[0] = vRightTopSlope;
+	vCornerDirection[1] = XMVectorSelect(vRightTopSlope, vLeftBottomSlope, g_vGrabX);
+	vCornerDirection[2] = vLeftBottomSlope;
+	vCornerDirection[3] = XMVectorSelect(vRightTopSlope, vLeftBottomSlope, g_vGrabY);
+
+	// Setting w to 0 leaves only the rotation part of the matrix,the translation is added once per corner.
+	XMVECTOR vDirectionInLight[4];
+	for (int iCorner = 0;iCorner < 4;++iCorner)
+	{
+		vDirectionInLight[iCorner] = XMVector4Transform(XMVectorSetW(vCornerDirection[iCorner], 0.0f), matViewToLight);
+	}
+	XMVECTOR vTranslation = matViewToLight.r[3];
+
+	for (int iSlice = 0;iSlice < nSliceCount;++iSlice)
+	{
+		XMVECTOR vDepth = XMVectorReplicate(fSliceDepth[iSlice]);
+		pSlices->m_fDepthInView[iSlice] = fSliceDepth[iSlice];
+		for (int iCorner = 0;iCorner < 4;++iCorner)
+		{
+			pSlices->m_vCornersInView[iSlice][iCorner] = XMVectorSetW(XMVectorMultiply(vCornerDirection[iCorner], vDepth), 1.0f);
+			pSlices->m_vCornersInLight[iSlice][iCorner] = XMVectorMultiplyAdd(vDirectionInLight[iCorner], vDepth, vTranslation);
+		}
+	}
+
+	// The quad bounds,4 slices per vector.Lane i of group g holds slice g*4+i.
+	int nGroupCount = (nSliceCount + 3) / 4;
+	XMVECTOR vLaneMin[3][SLICE_LANE_GROUPS];
+	XMVECTOR vLaneMax[3][SLICE_LANE_GROUPS];
+	for (int iGroup = 0;iGroup < nGroupCount;++iGroup)
+	{
+		const float* pGroupDepth = fSliceDepth + iGroup * 4;
+		XMVECTOR vDepth = XMVectorSet(pGroupDepth[0], pGroupDepth[1], pGroupDepth[2], pGroupDepth[3]);
+
+		for (int iComponent = 0;iComponent < 3;++iComponent)
+		{
+			XMVECTOR vMin = g_vFLTMAX;
+			XMVECTOR vMax = g_vFLTMIN;
+			for (int iCorner = 0;iCorner < 4;++iCorner)
+			{
+				XMVECTOR vCorner = XMVectorMultiply(vDepth, XMVectorReplicate(XMVectorGetByIndex(vDirectionInLight[iCorner], iComponent)));
+				vMin = XMVectorMin(vMin, vCorner);
+				vMax = XMVectorMax(vMax, vCorner);
+			}
+			XMVECTOR vOffset = XMVectorReplicate(XMVectorGetByIndex(vTranslation, iComponent));
+			vLaneMin[iComponent][iGroup] = XMVectorAdd(vMin, vOffset);
+			vLaneMax[iComponent][iGroup] = XMVectorAdd(vMax, vOffset);
+		}
+	}
+
+	// Back from lanes to one vector per slice.
+	for (int iSlice = 0;iSlice < nSliceCount;++iSlice)
+	{
+		int iGroup = iSlice / 4;
+		int iLane = iSlice % 4;
+		pSlices->m_vLightSpaceMin[iSlice] = XMVectorSet(XMVectorGetByIndex(vLaneMin[0][iGroup], iLane),
+			XMVectorGetByIndex(vLaneMin[1][iGroup], iLane), XMVectorGetByIndex(vLaneMin[2][iGroup], iLane), 1.0f);
+		pSlices->m_vLightSpaceMax[iSlice] = XMVectorSet(XMVectorGetByIndex(vLaneMax[0][iGroup], iLane),
+			XMVectorGetByIndex(vLaneMax[1][iGroup], iLane), XMVectorGetByIndex(vLaneMax[2][iGroup], iLane), 1.0f);
+	}
+}
+
+
+void ComputeLightSpaceCascadeBounds(const CascadeFitParams& params, const CascadeFrustumSlices& slices, CascadeLightSpaceBounds* pBounds)
+{
+	for (int iCascadeIndex = 0;iCascadeIndex < params.m_nUsingCascadeLevelsCount;++iCascadeIndex)
+	{
+		int iBeginSlice, iEndSlice;
+		GetCascadeSliceRange(params, iCascadeIndex, iBeginSlice, iEndSlice);
+
+		pBounds->m_vMin[iCascadeIndex] = XMVectorMin(slices.m_vLightSpaceMin[iBeginSlice], slices.m_vLightSpaceMin[iEndSlice]);
+		pBounds->m_vMax[iCascadeIndex] = XMVectorMax(slices.m_vLightSpaceMax[iBeginSlice], slices.m_vLightSpaceMax[iEndSlice]);
+
+		// Diagonal from the right top corner of the begin slice to the left bottom corner of the end slice.
+		// The view to light matrix is rigid,so the length can be taken in camera view space.
+		XMVECTOR vDiagonal = slices.m_vCornersInView[iBeginSlice][0] - slices.m_vCornersInView[iEndSlice][2];
+		pBounds->m_fFrustumDiagonal[iCascadeIndex] = XMVectorGetX(XMVector3Length(vDiagonal));
+	}
+}
+
+
+void GetCascadeCornersInView(const CascadeFrustumSlices& slices, int iBeginSlice, int iEndSlice, XMVECTOR* pCornerPointsInView)
+{
+	for (int iCorner = 0;iCorner < 4;++iCorner)
+	{
+		pCornerPointsInView[iCorner] = slices.m_vCornersInView[iBeginSlice][iCorner];
+		pCornerPointsInView[iCorner + 4] = slices.m_vCornersInView[iEndSlice][iCorner];
+	}
+}
+
+
+void ComputeFrustumSlopes(CXMMATRIX matProjection, XMVECTOR* pRightTopSlope, XMVECTOR* pLeftBottomSlope)
+{
+	// Corners of the projection frustum in homogenous space(right,left,top,bottom at far plane).
+	// This is the slope part of XNA::ComputeFrustumFromProjection.
+	static const XMVECTORF32 HomogenousPoints[4] =
+	{
+		{ 1.0f,0.0f,1.0f,1.0f },
+		{ -1.0f,0.0f,1.0f,1.0f },
+		{ 0.0f,1.0f,1.0f,1.0f },
+		{ 0.0f,-1.0f,1.0f,1.0f },
+	};
+
+	XMVECTOR det;
+	XMMATRIX matInverse = XMMatrixInverse(&det, matProjection);
+
+	XMVECTOR vSlopes[4];
+	for (int i = 0;i < 4;++i)
+	{
+		vSlopes[i] = XMVector4Transform(HomogenousPoints[i], matInverse);
+		vSlopes[i] = vSlopes[i] * XMVectorReciprocal(XMVectorSplatZ(vSlopes[i]));
+	}
+
+	*pRightTopSlope = XMVectorSet(XMVectorGetX(vSlopes[0]), XMVectorGetY(vSlopes[2]), 1.0f, 1.0f);
+	*pLeftBottomSlope = XMVectorSet(XMVectorGetX(vSlopes[1]), XMVectorGetY(vSlopes[3]), 1.0f, 1.0f);
+}
+
+
+void CreateAABBPoints(XMVECTOR* pAABBPoints, FXMVECTOR vCenter, FXMVECTOR vExtends)
+{
+	//This map enables us to use a for loop and do vector math.
+	static const XMVECTORF32 vExtentsMap[] =
+	{
+		{ 1.0f,1.0f,-1.0f,1.0f },
+		{ -1.0f,1.0f,-1.0f,1.0f },
+		{ 1.0f,-1.0f,-1.0f,1.0f },
+		{ -1.0f,-1.0f,-1.0f,1.0f },
+		{ 1.0f,1.0f,1.0f,1.0f },
+		{ -1.0f,1.0f,1.0f,1.0f },
+		{ 1.0f,-1.0f,1.0f,1.0f },
+		{ -1.0f,-1.0f,1.0f,1.0f }
+	};
+
+	for (int i = 0;i <8;++i)
+	{
+		pAABBPoints[i] = XMVectorMultiplyAdd(vExtentsMap[i], vExtends, vCenter);
+	}
+}
+
+
+void SnapOrthoBoundsToTexels(XMVECTOR& vOrthographicMin, XMVECTOR& vOrthographicMax, FXMVECTOR vViewSpaceUnitsPerTexel)
+{
+	// we snape the camera to 1 pixel increments so that moving the camera does not cause the shadow to jitter
+	// This is a matter of integer dividing by the world space size of texel
+	vOrthographicMin /= vViewSpaceUnitsPerTexel;
+	vOrthographicMin = XMVectorFloor(vOrthographicMin);
+	vOrthographicMin *= vViewSpaceUnitsPerTexel;
+
+	vOrthographicMax /= vViewSpaceUnitsPerTexel;
+	vOrthographicMax = XMVectorFloor(vOrthographicMax);
+	vOrthographicMax *= vViewSpaceUnitsPerTexel;
+}
+
+
+struct Triangle
+{
+	XMVECTOR points[3];
+	bool culled;
+};
+
+enum FRUSTUM_PLANE_FLAG
+{
+	FRUSTUM_PLANE_LEFT = 0,
+	FRUSTUM_PLANE_RIGHT,
+	FRUSTUM_PLANE_BOTTOM,
+	FRUSTUM_PLANE_UP,
+	FRUSTUM_PLANE_COUNT,
+};
+
+
+// Computing an accurate near and far plane will decrease surface ance and Peter-panning
+// Surface acne is the term for erroneous self shadowing.Peter-panning is the effect where
+// shadows disappear near the base of an object.
+// As offsets are generally used with PCF filtering due self shadowing issues,computing the
+// This concept is not complicated,but the intersection code is
+void ComputeNearAndFarInViewSpace(float& fNearPlane, float& fFarPlane,
+	FXMVECTOR vOrthographicMin, FXMVECTOR vOrthographicMax, const XMVECTOR* pPointInView)
+{
+	// Initialize the near and far plane
+	fNearPlane = FLT_MAX;
+	fFarPlane = -FLT_MAX;
+
+	Triangle triangleList[16];
+	int iTriangleCount = 1;
+
+	// These are the indices uesed to tesselate an AABB into a list of triangles.
+	static const int iPointIndices[] =
+	{
+		0,1,2,1,2,3,
+		4,5,6,5,6,7,
+		0,2,4,2,4,6,
+		1,3,5,3,5,7,
+		0,1,4,1,4,5,
+		2,3,6,3,6,7
+	};
+
+	bool bPointPassesCollision[3];
+
+	// At a high level
+	// 1. Iterate over all 6*2 triangles of the AABB
+	// 2. Clip the triangles against each plane,Create new triangle as needed
+	// 3. Find the min and max z values as the near and far plane.
+
+	//This is easier because the triangles are in camera spacing making the collisions tests sample comparisions.
+
+	float fLightCameraOrthographicMinX = XMVectorGetX(vOrthographicMin);
+	float fLightCameraOrthographicMaxX = XMVectorGetX(vOrthographicMax);
+	float fLightCameraOrthographicMinY = XMVectorGetY(vOrthographicMin);
+	float fLightCameraOrthographicMaxY = XMVectorGetY(vOrthographicMax);
+
+	for (int iTriangleIndex = 0;iTriangleIndex<12;++iTriangleIndex)
+	{
+		triangleList[0].points[0] = pPointInView[iPointIndices[iTriangleIndex * 3 + 0]];
+		triangleList[0].points[1] = pPointInView[iPointIndices[iTriangleIndex * 3 + 1]];
+		triangleList[0].points[2] = pPointInView[iPointIndices[iTriangleIndex * 3 + 2]];
+
+		iTriangleCount = 1;
+		triangleList[0].culled = false;
+
+		//Clip each individual triangle against the 4 frustums.When ever a triangle is clipped into new triangles,
+		// add them to the list.
+		for (int frustumPlaneFlag = FRUSTUM_PLANE_LEFT;frustumPlaneFlag<FRUSTUM_PLANE_COUNT;++frustumPlaneFlag)
+		{
+			float fEdge;
+			int iComponent;
+			bool bKeepGreater;
+			if (frustumPlaneFlag == FRUSTUM_PLANE_LEFT)
+			{
+				fEdge = fLightCameraOrthographicMinX;//Left
+				iComponent = 0;
+				bKeepGreater = true;
+			}
+			else if (frustumPlaneFlag == FRUSTUM_PLANE_RIGHT)
+			{
+				fEdge = fLightCameraOrthographicMaxX;//Right
+				iComponent = 0;
+				bKeepGreater = false;
+			}
+			else if (frustumPlaneFlag == FRUSTUM_PLANE_BOTTOM)
+			{
+				fEdge = fLightCameraOrthographicMinY;//Bottom
+				iComponent = 1;
+				bKeepGreater = true;
+			}
+			else//FRUSTUM_PLANE_UP
+			{
+				fEdge = fLightCameraOrthographicMaxY;//Top
+				iComponent = 1;
+				bKeepGreater = false;
+			}
+
+			for (int triIter = 0;triIter < iTriangleCount;++triIter)
+			{
+				// we don't delete triangles,so we skip those that have been culled.
+				if (!triangleList[triIter].culled)
+				{
+					int iInsideVertCount = 0;
+					XMVECTOR tempPoint;
+
+					//Test against the correct frustum plane.
+					for (int i = 0;i<3;++i)
+					{
+						float fValue = XMVectorGetByIndex(triangleList[triIter].points[i], iComponent);
+						bPointPassesCollision[i] = bKeepGreater ? (fValue > fEdge) : (fValue < fEdge);
+						iInsideVertCount += bPointPassesCollision[i] ? 1 : 0;
+					}
+
+					//move the points that pass the frustum test to the beginning of the array.
+					if (bPointPassesCollision[1] && !bPointPassesCollision[0])
+					{
+						tempPoint = triangleList[triIter].points[0];
+						triangleList[triIter].points[0] = triangleList[triIter].points[1];
+						triangleList[triIter].points[1] = tempPoint;
+
+						bPointPassesCollision[0] = true;
+						bPointPassesCollision[1] = false;
+					}
+					if (bPointPassesCollision[2] && !bPointPassesCollision[1])
+					{
+						tempPoint = triangleList[triIter].points[1];
+						triangleList[triIter].points[1] = triangleList[triIter].points[2];
+						triangleList[triIter].points[2] = tempPoint;
+						bPointPassesCollision[1] = true;
+						bPointPassesCollision[2] = false;
+					}
+					if (bPointPassesCollision[1] && !bPointPassesCollision[0])
+					{
+						tempPoint = triangleList[triIter].points[0];
+						triangleList[triIter].points[0] = triangleList[triIter].points[1];
+						triangleList[triIter].points[1] = tempPoint;
+
+						bPointPassesCollision[0] = true;
+						bPointPassesCollision[1] = false;
+					}
+
+					if (iInsideVertCount == 0)
+					{
+						//All points failed.We're done
+						triangleList[triIter].culled = true;
+					}
+					else if (iInsideVertCount == 1)
+					{//One point passed.Clip the triangle against the frustum plane
+						triangleList[triIter].culled = false;
+
+						XMVECTOR vVert0ToVert1 = triangleList[triIter].points[1] - triangleList[triIter].points[0];
+						XMVECTOR vVert0ToVert2 = triangleList[triIter].points[2] - triangleList[triIter].points[0];
+
+						// Find the collision ratio
+						float fHitPointDiff = fEdge - XMVectorGetByIndex(triangleList[triIter].points[0], iComponent);
+
+						//Calculate the distance along the vector as ratio of the hit ratio to the component
+						float fRatioAlongVert01 = fHitPointDiff / XMVectorGetByIndex(vVert0ToVert1, iComponent);
+						float fRatioAlongVert02 = fHitPointDiff / XMVectorGetByIndex(vVert0ToVert2, iComponent);
+
+						//Add the point plus a percentage of the vector
+						triangleList[triIter].points[1] = triangleList[triIter].points[0] + vVert0ToVert2 * fRatioAlongVert02;
+						triangleList[triIter].points[2] = triangleList[triIter].points[0] + vVert0ToVert1 * fRatioAlongVert01;
+					}
+					else if (iInsideVertCount == 2)
+					{
+						// 2 in
+						// tessellate into 2 triangles
+
+						//Copy the triangle(if is exists) after the current triangle out of
+						// the way so we can override it with the new triangle we're inserting.
+						triangleList[iTriangleCount] = triangleList[triIter + 1];
+
+						triangleList[triIter].culled = false;
+						triangleList[triIter + 1].culled = false;
+
+						// Get the vector from the outside point into 2 inside points
+						XMVECTOR vVert2ToVert0 = triangleList[triIter].points[0] - triangleList[triIter].points[2];
+						XMVECTOR vVert2ToVert1 = triangleList[triIter].points[1] - triangleList[triIter].points[2];
+
+						// Get the hit point ratio
+						float fHitPointDiff = fEdge - XMVectorGetByIndex(triangleList[triIter].points[2], iComponent);
+						float fRatioAlongVector_2_0 = fHitPointDiff / XMVectorGetByIndex(vVert2ToVert0, iComponent);
+						//Calculate the new vertex by adding the percentage of the vector plus point 2
+						vVert2ToVert0 *= fRatioAlongVector_2_0;
+						vVert2ToVert0 += triangleList[triIter].points[2];
+
+						// Add new triangle.
+						triangleList[triIter + 1].points[0] = triangleList[triIter].points[0];
+						triangleList[triIter + 1].points[1] = triangleList[triIter].points[1];
+						triangleList[triIter + 1].points[2] = vVert2ToVert0;
+
+						// Get the hit point ratio
+						float fRatioAlongVector_2_1 = fHitPointDiff / XMVectorGetByIndex(vVert2ToVert1, iComponent);
+						//Calculate the new vertex by adding the percentage of the vector plus point 2
+						vVert2ToVert1 *= fRatioAlongVector_2_1;
+						vVert2ToVert1 += triangleList[triIter].points[2];
+
+						triangleList[triIter].points[0] = triangleList[triIter + 1].points[1];
+						triangleList[triIter].points[1] = triangleList[triIter + 1].points[2];
+						triangleList[triIter].points[2] = vVert2ToVert1;
+
+						//increase triangle count and skip the triangle we just inserted.
+						++iTriangleCount;
+						++triIter;
+					}
+					else
+					{
+						//all in
+						triangleList[triIter].culled = false;
+					}
+				}//if triangle not culled
+			}//for_triangle
+		}//for_frustumPlane
+
+		for (int i = 0;i<iTriangleCount;++i)
+		{
+			if (!triangleList[i].culled)
+			{
+				//Set the near and far plane and the min and max z values respectively
+				for (int j = 0;j<3;++j)
+				{
+					float fTriangleCoordZ = XMVectorGetZ(triangleList[i].points[j]);
+
+					if (fNearPlane > fTriangleCoordZ)
+					{
+						fNearPlane = fTriangleCoordZ;
+					}
+
+					if (fFarPlane < fTriangleCoordZ)
+					{
+						fFarPlane = fTriangleCoordZ;
+					}
+				}
+			}
+		}
+	}//for_AABB
+}
+
+
+// The 12 edges of the box produced by CreateAABBPoints,the two end points differ in one sign.
+static const int g_iAABBEdgeIndices[12][2] =
+{
+	{ 0,1 },{ 2,3 },{ 4,5 },{ 6,7 },
+	{ 0,2 },{ 1,3 },{ 4,6 },{ 5,7 },
+	{ 0,4 },{ 1,5 },{ 2,6 },{ 3,7 }
+};
+
+// Folds a candidate z into the near/far lanes where bValid is set.
+static inline void AccumulateNearFar(XMVECTOR& vNear, XMVECTOR& vFar, FXMVECTOR vZ, FXMVECTOR bValid)
+{
+	vNear = XMVectorSelect(vNear, XMVectorMin(vNear, vZ), bValid);
+	vFar = XMVectorSelect(vFar, XMVectorMax(vFar, vZ), bValid);
+}
+
+// Intersects an edge of the box with the plane "component == vEdge" of 4 cascades at once.The hit has to be on
+// the edge and between vOtherMin and vOtherMax in the other component.
+static inline void AccumulateEdgeHit(XMVECTOR& vNear, XMVECTOR& vFar, FXMVECTOR vEdge, FXMVECTOR vOtherMin, FXMVECTOR vOtherMax,
+	float fStart, float fDelta, float fOtherStart, float fOtherDelta, float fZStart, float fZDelta)
+{
+	XMVECTOR vRatio = XMVectorScale(XMVectorSubtract(vEdge, XMVectorReplicate(fStart)), 1.0f / fDelta);
+	XMVECTOR vOther = XMVectorMultiplyAdd(vRatio, XMVectorReplicate(fOtherDelta), XMVectorReplicate(fOtherStart));
+	XMVECTOR bValid = XMVectorAndInt(XMVectorGreaterOrEqual(vRatio, g_vZero), XMVectorLessOrEqual(vRatio, g_XMOne));
+	bValid = XMVectorAndInt(bValid, XMVectorGreaterOrEqual(vOther, vOtherMin));
+	bValid = XMVectorAndInt(bValid, XMVectorLessOrEqual(vOther, vOtherMax));
+	AccumulateNearFar(vNear, vFar, XMVectorMultiplyAdd(vRatio, XMVectorReplicate(fZDelta), XMVectorReplicate(fZStart)), bValid);
+}
+
+
+// The same near and far plane as ComputeNearAndFarInViewSpace without building triangles.The part of the box
+// inside the ortho bound is a convex polytope,so its z range is reached at one of its vertices,which are
+//  1. box vertices inside the bound,
+//  2. box edges crossing one of the 4 side planes of the bound,
+//  3. the 4 vertical edges of the bound entering and leaving the box.
+// Each cascade is a SIMD lane,so 4 cascades are solved with the same instructions.
+bool ComputeNearAndFarAnalytic(int nCascadeCount, const XMVECTOR* pOrthographicMin, const XMVECTOR* pOrthographicMax,
+	const XMVECTOR* pPointInView, float* pNearPlane, float* pFarPlane)
+{
+	// The box is a parallelepiped center + s.x*AxisX + s.y*AxisY + s.z*AxisZ with -1<=s<=1.Case 3 needs s
+	// as a function of a light space point,which is the inverse of that mapping.
+	XMMATRIX matBoxToLight;
+	matBoxToLight.r[0] = XMVectorSetW((pPointInView[0] - pPointInView[1]) * g_vHalfVector, 0.0f);
+	matBoxToLight.r[1] = XMVectorSetW((pPointInView[0] - pPointInView[2]) * g_vHalfVector, 0.0f);
+	matBoxToLight.r[2] = XMVectorSetW((pPointInView[4] - pPointInView[0]) * g_vHalfVector, 0.0f);
+	matBoxToLight.r[3] = XMVectorSetW((pPointInView[0] + pPointInView[7]) * g_vHalfVector, 1.0f);
+
+	// A flat box has no inverse.The clipper handles it.
+	float fAxisScale = XMVectorGetX(XMVector3Length(matBoxToLight.r[0])) * XMVectorGetX(XMVector3Length(matBoxToLight.r[1]))
+		* XMVectorGetX(XMVector3Length(matBoxToLight.r[2]));
+	XMVECTOR det;
+	XMMATRIX matLightToBox = XMMatrixInverse(&det, matBoxToLight);
+	if (!(fabsf(XMVectorGetX(det)) > fAxisScale * 1e-6f))
+	{
+		return false;
+	}
+
+	float fPoints[8][3];
+	for (int i = 0;i < 8;++i)
+	{
+		fPoints[i][0] = XMVectorGetX(pPointInView[i]);
+		fPoints[i][1] = XMVectorGetY(pPointInView[i]);
+		fPoints[i][2] = XMVectorGetZ(pPointInView[i]);
+	}
+
+	for (int iFirstCascade = 0;iFirstCascade < nCascadeCount;iFirstCascade += 4)
+	{
+		// Lane i holds cascade iFirstCascade+i.Missing cascades repeat the last one.
+		float fBound[4][4];
+		for (int iLane = 0;iLane < 4;++iLane)
+		{
+			int iCascade = (iFirstCascade + iLane < nCascadeCount) ? iFirstCascade + iLane : nCascadeCount - 1;
+			fBound[0][iLane] = XMVectorGetX(pOrthographicMin[iCascade]);
+			fBound[1][iLane] = XMVectorGetX(pOrthographicMax[iCascade]);
+			fBound[2][iLane] = XMVectorGetY(pOrthographicMin[iCascade]);
+			fBound[3][iLane] = XMVectorGetY(pOrthographicMax[iCascade]);
+		}
+		XMVECTOR vMinX = XMLoadFloat4((const XMFLOAT4*)fBound[0]);
+		XMVECTOR vMaxX = XMLoadFloat4((const XMFLOAT4*)fBound[1]);
+		XMVECTOR vMinY = XMLoadFloat4((const XMFLOAT4*)fBound[2]);
+		XMVECTOR vMaxY = XMLoadFloat4((const XMFLOAT4*)fBound[3]);
+
+		XMVECTOR vNear = g_vFLTMAX;
+		XMVECTOR vFar = g_vFLTMIN;
+
+		// 1. Box vertices inside the bound.
+		for (int i = 0;i < 8;++i)
+		{
+			XMVECTOR vX = XMVectorReplicate(fPoints[i][0]);
+			XMVECTOR vY = XMVectorReplicate(fPoints[i][1]);
+			XMVECTOR bInside = XMVectorAndInt(XMVectorGreater(vX, vMinX), XMVectorLess(vX, vMaxX));
+			bInside = XMVectorAndInt(bInside, XMVectorAndInt(XMVectorGreater(vY, vMinY), XMVectorLess(vY, vMaxY)));
+			AccumulateNearFar(vNear, vFar, XMVectorReplicate(fPoints[i][2]), bInside);
+		}
+
+		// 2. Box edges against the side planes.Edges parallel to a plane are covered by their end points and by 3.
+		for (int iEdge = 0;iEdge < 12;++iEdge)
+		{
+			const float* p0 = fPoints[g_iAABBEdgeIndices[iEdge][0]];
+			const float* p1 = fPoints[g_iAABBEdgeIndices[iEdge][1]];
+			float fDeltaX = p1[0] - p0[0];
+			float fDeltaY = p1[1] - p0[1];
+			float fDeltaZ = p1[2] - p0[2];
+
+			if (fDeltaX != 0.0f)
+			{
+				AccumulateEdgeHit(vNear, vFar, vMinX, vMinY, vMaxY, p0[0], fDeltaX, p0[1], fDeltaY, p0[2], fDeltaZ);
+				AccumulateEdgeHit(vNear, vFar, vMaxX, vMinY, vMaxY, p0[0], fDeltaX, p0[1], fDeltaY, p0[2], fDeltaZ);
+			}
+			if (fDeltaY != 0.0f)
+			{
+				AccumulateEdgeHit(vNear, vFar, vMinY, vMinX, vMaxX, p0[1], fDeltaY, p0[0], fDeltaX, p0[2], fDeltaZ);
+				AccumulateEdgeHit(vNear, vFar, vMaxY, vMinX, vMaxX, p0[1], fDeltaY, p0[0], fDeltaX, p0[2], fDeltaZ);
+			}
+		}
+
+		// 3. The vertical edges (x,y,z) of the bound.Along such an edge s(z) = x*Inv.r0 + y*Inv.r1 + Inv.r3 + z*Inv.r2
+		// and the edge is inside the box where all three |s| <= 1.
+		for (int iCorner = 0;iCorner < 4;++iCorner)
+		{
+			XMVECTOR vX = (iCorner & 1) ? vMaxX : vMinX;
+			XMVECTOR vY = (iCorner & 2) ? vMaxY : vMinY;
+
+			XMVECTOR vEnter = g_vFLTMIN;
+			XMVECTOR vLeave = g_vFLTMAX;
+			for (int iAxis = 0;iAxis < 3;++iAxis)
+			{
+				XMVECTOR vBase = XMVectorMultiplyAdd(vX, XMVectorReplicate(XMVectorGetByIndex(matLightToBox.r[0], iAxis)),
+					XMVectorReplicate(XMVectorGetByIndex(matLightToBox.r[3], iAxis)));
+				vBase = XMVectorMultiplyAdd(vY, XMVectorReplicate(XMVectorGetByIndex(matLightToBox.r[1], iAxis)), vBase);
+				float fSlope = XMVectorGetByIndex(matLightToBox.r[2], iAxis);
+
+				if (fabsf(fSlope) > 1e-20f)
+				{
+					float fInvSlope = 1.0f / fSlope;
+					XMVECTOR vZ0 = XMVectorScale(XMVectorSubtract(g_XMNegativeOne, vBase), fInvSlope);
+					XMVECTOR vZ1 = XMVectorScale(XMVectorSubtract(g_XMOne, vBase), fInvSlope);
+					vEnter = XMVectorMax(vEnter, XMVectorMin(vZ0, vZ1));
+					vLeave = XMVectorMin(vLeave, XMVectorMax(vZ0, vZ1));
+				}
+				else
+				{
+					// The edge runs parallel to this slab,it is either always or never inside.
+					XMVECTOR bOutside = XMVectorGreater(XMVectorAbs(vBase), g_XMOne);
+					vEnter = XMVectorSelect(vEnter, g_vFLTMAX, bOutside);
+					vLeave = XMVectorSelect(vLeave, g_vFLTMIN, bOutside);
+				}
+			}
+
+			XMVECTOR bHit = XMVectorLessOrEqual(vEnter, vLeave);
+			AccumulateNearFar(vNear, vFar, vEnter, bHit);
+			AccumulateNearFar(vNear, vFar, vLeave, bHit);
+		}
+
+		XMFLOAT4 fNear, fFar;
+		XMStoreFloat4(&fNear, vNear);
+		XMStoreFloat4(&fFar, vFar);
+		const float* pNear = &fNear.x;
+		const float* pFar = &fFar.x;
+		for (int iLane = 0;iLane < 4 && iFirstCascade + iLane < nCascadeCount;++iLane)
+		{
+			pNearPlane[iFirstCascade + iLane] = pNear[iLane];
+			pFarPlane[iFirstCascade + iLane] = pFar[iLane];
+		}
+	}
+
+	return true;
+}
+
+
+
+// Boxes per leaf.The analytic near/far costs about as much as a few box tests,so leaves stay small.
+#define SCENE_BOUNDS_LEAF_SIZE 4
+
+static void BuildSceneBoundsNode(SceneBoundsHierarchy* pHierarchy, int iNode, int* pBoxOrder, int iBegin, int iEnd,
+	const XMFLOAT3* pBoxMin, const XMFLOAT3* pBoxMax)
+{
+	XMVECTOR vMin = g_vFLTMAX;
+	XMVECTOR vMax = g_vFLTMIN;
+	XMVECTOR vCenterMin = g_vFLTMAX;
+	XMVECTOR vCenterMax = g_vFLTMIN;
+	for (int i = iBegin;i < iEnd;++i)
+	{
+		XMVECTOR vBoxMin = XMLoadFloat3(&pBoxMin[pBoxOrder[i]]);
+		XMVECTOR vBoxMax = XMLoadFloat3(&pBoxMax[pBoxOrder[i]]);
+		vMin = XMVectorMin(vMin, vBoxMin);
+		vMax = XMVectorMax(vMax, vBoxMax);
+		vCenterMin = XMVectorMin(vCenterMin, vBoxMin + vBoxMax);
+		vCenterMax = XMVectorMax(vCenterMax, vBoxMin + vBoxMax);
+	}
+
+	SceneBoundsNode& node = pHierarchy->m_Nodes[iNode];
+	XMStoreFloat3(&node.m_vMin, vMin);
+	XMStoreFloat3(&node.m_vMax, vMax);
+	node.m_iFirstBox = iBegin;
+	node.m_nBoxCount = iEnd - iBegin;
+	node.m_iFirstChild = -1;
+	if (iEnd - iBegin <= SCENE_BOUNDS_LEAF_SIZE)
+	{
+		return;
+	}
+
+	// Split the longest axis of the box centers at the median.
+	XMFLOAT3 vCenterExtents;
+	XMStoreFloat3(&vCenterExtents, vCenterMax - vCenterMin);
+	int iAxis = (vCenterExtents.x >= vCenterExtents.y && vCenterExtents.x >= vCenterExtents.z) ? 0 : (vCenterExtents.y >= vCenterExtents.z ? 1 : 2);
+	int iMiddle = (iBegin + iEnd) / 2;
+	std::nth_element(pBoxOrder + iBegin, pBoxOrder + iMiddle, pBoxOrder + iEnd, [&](int a, int b)
+	{
+		return (&pBoxMin[a].x)[iAxis] + (&pBoxMax[a].x)[iAxis] < (&pBoxMin[b].x)[iAxis] + (&pBoxMax[b].x)[iAxis];
+	});
+
+	int iFirstChild = (int)pHierarchy->m_Nodes.size();
+	pHierarchy->m_Nodes[iNode].m_iFirstChild = iFirstChild;
+	pHierarchy->m_Nodes.resize(iFirstChild + 2);
+	BuildSceneBoundsNode(pHierarchy, iFirstChild, pBoxOrder, iBegin, iMiddle, pBoxMin, pBoxMax);
+	BuildSceneBoundsNode(pHierarchy, iFirstChild + 1, pBoxOrder, iMiddle, iEnd, pBoxMin, pBoxMax);
+}
+
+
+void BuildSceneBoundsHierarchy(const XMFLOAT3* pBoxMin, const XMFLOAT3* pBoxMax, int nBoxCount, SceneBoundsHierarchy* pHierarchy)
+{
+	pHierarchy->m_Nodes.clear();
+	pHierarchy->m_vBoxMin.resize(nBoxCount);
+	pHierarchy->m_vBoxMax.resize(nBoxCount);
+	pHierarchy->m_iBoxIndex.resize(nBoxCount);
+	if (nBoxCount == 0)
+	{
+		return;
+	}
+
+	std::vector<int> boxOrder(nBoxCount);
+	for (int i = 0;i < nBoxCount;++i)
+	{
+		boxOrder[i] = i;
+	}
+
+	pHierarchy->m_Nodes.reserve(2 * nBoxCount);
+	pHierarchy->m_Nodes.resize(1);
+	BuildSceneBoundsNode(pHierarchy, 0, boxOrder.data(), 0, nBoxCount, pBoxMin, pBoxMax);
+
+	for (int i = 0;i < nBoxCount;++i)
+	{
+		pHierarchy->m_vBoxMin[i] = pBoxMin[boxOrder[i]];
+		pHierarchy->m_vBoxMax[i] = pBoxMax[boxOrder[i]];
+		pHierarchy->m_iBoxIndex[i] = boxOrder[i];
+	}
+}
+
+
+void RefitSceneBoundsHierarchy(const XMFLOAT3* pBoxMin, const XMFLOAT3* pBoxMax, SceneBoundsHierarchy* pHierarchy)
+{
+	for (size_t i = 0;i < pHierarchy->m_iBoxIndex.size();++i)
+	{
+		pHierarchy->m_vBoxMin[i] = pBoxMin[pHierarchy->m_iBoxIndex[i]];
+		pHierarchy->m_vBoxMax[i] = pBoxMax[pHierarchy->m_iBoxIndex[i]];
+	}
+
+	// Children are stored after their parent,so walking the nodes backwards refits the children first.
+	for (int iNode = (int)pHierarchy->m_Nodes.size() - 1;iNode >= 0;--iNode)
+	{
+		SceneBoundsNode& node = pHierarchy->m_Nodes[iNode];
+		XMVECTOR vMin = g_vFLTMAX;
+		XMVECTOR vMax = g_vFLTMIN;
+		if (node.m_iFirstChild < 0)
+		{
+			for (int i = node.m_iFirstBox;i < node.m_iFirstBox + node.m_nBoxCount;++i)
+			{
+				vMin = XMVectorMin(vMin, XMLoadFloat3(&pHierarchy->m_vBoxMin[i]));
+				vMax = XMVectorMax(vMax, XMLoadFloat3(&pHierarchy->m_vBoxMax[i]));
+			}
+		}
+		else
+		{
+			for (int iChild = node.m_iFirstChild;iChild < node.m_iFirstChild + 2;++iChild)
+			{
+				vMin = XMVectorMin(vMin, XMLoadFloat3(&pHierarchy->m_Nodes[iChild].m_vMin));
+				vMax = XMVectorMax(vMax, XMLoadFloat3(&pHierarchy->m_Nodes[iChild].m_vMax));
+			}
+		}
+		XMStoreFloat3(&node.m_vMin, vMin);
+		XMStoreFloat3(&node.m_vMax, vMax);
+	}
+}
+
+
+// Returns a bit per cascade whose ortho bounds overlap the light space box in x and y.pContained gets the
+// cascades whose ortho bounds contain the box in x and y.
+static unsigned int GetOverlappedCascades(FXMVECTOR vLightMin, FXMVECTOR vLightMax, unsigned int uCascadeMask,
+	const XMVECTOR* pOrthographicMin, const XMVECTOR* pOrthographicMax, unsigned int* pContained = nullptr)
+{
+	unsigned int uOverlapped = 0;
+	unsigned int uContained = 0;
+	for (unsigned int uMask = uCascadeMask;uMask != 0;uMask &= uMask - 1)
+	{
+		int iCascadeIndex = 0;
+		while (!(uMask & (1u << iCascadeIndex)))
+		{
+			++iCascadeIndex;
+		}
+
+		XMVECTOR bOutside = XMVectorOrInt(XMVectorGreater(vLightMin, pOrthographicMax[iCascadeIndex]),
+			XMVectorLess(vLightMax, pOrthographicMin[iCascadeIndex]));
+		if (!(XMVectorGetIntX(bOutside) | XMVectorGetIntY(bOutside)))
+		{
+			uOverlapped |= 1u << iCascadeIndex;
+
+			XMVECTOR bInside = XMVectorAndInt(XMVectorGreaterOrEqual(vLightMin, pOrthographicMin[iCascadeIndex]),
+				XMVectorLessOrEqual(vLightMax, pOrthographicMax[iCascadeIndex]));
+			if (XMVectorGetIntX(bInside) & XMVectorGetIntY(bInside))
+			{
+				uContained |= 1u << iCascadeIndex;
+			}
+		}
+	}
+
+	if (pContained)
+	{
+		*pContained = uContained;
+	}
+	return uOverlapped;
+}
+
+
+int ComputeNearAndFarFromSceneBounds(const SceneBoundsHierarchy& hierarchy, CXMMATRIX matLightView, FIT_NEAR_FAR eNearFarFit,
+	bool bAnalyticNearFar, int nCascadeCount, const XMVECTOR* pOrthographicMin, const XMVECTOR* pOrthographicMax,
+	float* pNearPlane, float* pFarPlane)
+{
+	for (int iCascadeIndex = 0;iCascadeIndex < nCascadeCount;++iCascadeIndex)
+	{
+		pNearPlane[iCascadeIndex] = FLT_MAX;
+		pFarPlane[iCascadeIndex] = -FLT_MAX;
+	}
+	if (hierarchy.m_Nodes.empty())
+	{
+		return 0;
+	}
+
+	// A world space box with center c and extents e covers light space center M*c and extents |M|*e.
+	XMMATRIX matAbsLightView;
+	matAbsLightView.r[0] = XMVectorAbs(matLightView.r[0]);
+	matAbsLightView.r[1] = XMVectorAbs(matLightView.r[1]);
+	matAbsLightView.r[2] = XMVectorAbs(matLightView.r[2]);
+	matAbsLightView.r[3] = g_XMIdentityR3;
+
+	// Each entry carries the cascades its parent overlapped,a child can only overlap fewer.
+	int iNodeStack[64];
+	unsigned int uMaskStack[64];
+	int nStackSize = 1;
+	iNodeStack[0] = 0;
+	uMaskStack[0] = (1u << nCascadeCount) - 1;
+
+	int nBoxesTested = 0;
+	while (nStackSize > 0)
+	{
+		--nStackSize;
+		const SceneBoundsNode& node = hierarchy.m_Nodes[iNodeStack[nStackSize]];
+		unsigned int uParentMask = uMaskStack[nStackSize];
+
+		XMVECTOR vNodeMin = XMLoadFloat3(&node.m_vMin);
+		XMVECTOR vNodeMax = XMLoadFloat3(&node.m_vMax);
+		XMVECTOR vCenter = XMVector3Transform((vNodeMin + vNodeMax) * g_vHalfVector, matLightView);
+		XMVECTOR vExtents = XMVector3TransformNormal((vNodeMax - vNodeMin) * g_vHalfVector, matAbsLightView);
+		unsigned int uMask = GetOverlappedCascades(vCenter - vExtents, vCenter + vExtents, uParentMask, pOrthographicMin, pOrthographicMax);
+		if (uMask == 0)
+		{
+			continue;
+		}
+
+		if (node.m_iFirstChild >= 0)
+		{
+			iNodeStack[nStackSize] = node.m_iFirstChild;
+			uMaskStack[nStackSize++] = uMask;
+			iNodeStack[nStackSize] = node.m_iFirstChild + 1;
+			uMaskStack[nStackSize++] = uMask;
+			continue;
+		}
+
+		for (int iBox = node.m_iFirstBox;iBox < node.m_iFirstBox + node.m_nBoxCount;++iBox)
+		{
+			XMVECTOR vBoxMin = XMLoadFloat3(&hierarchy.m_vBoxMin[iBox]);
+			XMVECTOR vBoxMax = XMLoadFloat3(&hierarchy.m_vBoxMax[iBox]);
+			XMVECTOR vBoxCenter = XMVectorSetW((vBoxMin + vBoxMax) * g_vHalfVector, 1.0f);
+			XMVECTOR vBoxExtents = (vBoxMax - vBoxMin) * g_vHalfVector;
+			XMVECTOR vLightCenter = XMVector3Transform(vBoxCenter, matLightView);
+			XMVECTOR vLightExtents = XMVector3TransformNormal(vBoxExtents, matAbsLightView);
+			unsigned int uContainedMask;
+			unsigned int uBoxMask = GetOverlappedCascades(vLightCenter - vLightExtents, vLightCenter + vLightExtents, uMask,
+				pOrthographicMin, pOrthographicMax, &uContainedMask);
+			if (uBoxMask == 0)
+			{
+				continue;
+			}
+			++nBoxesTested;
+
+			// A box inside the ortho bounds is not cut by them,its own z range is the intersection.
+			float fBoxNear[MAX_CASCADES];
+			float fBoxFar[MAX_CASCADES];
+			for (int iCascadeIndex = 0;iCascadeIndex < nCascadeCount;++iCascadeIndex)
+			{
+				fBoxNear[iCascadeIndex] = XMVectorGetZ(vLightCenter - vLightExtents);
+				fBoxFar[iCascadeIndex] = XMVectorGetZ(vLightCenter + vLightExtents);
+			}
+
+			if (eNearFarFit != FIT_NEAR_FAR_ONLY_SCENE_AABB && (uBoxMask & ~uContainedMask) != 0)
+			{
+				XMVECTOR vBoxPointsInLightView[8];
+				CreateAABBPoints(vBoxPointsInLightView, vBoxCenter, vBoxExtents);
+				for (int index = 0;index < 8;++index)
+				{
+					vBoxPointsInLightView[index] = XMVector4Transform(vBoxPointsInLightView[index], matLightView);
+				}
+
+				bool bSolved = bAnalyticNearFar && ComputeNearAndFarAnalytic(nCascadeCount, pOrthographicMin, pOrthographicMax,
+					vBoxPointsInLightView, fBoxNear, fBoxFar);
+				for (int iCascadeIndex = 0;iCascadeIndex < nCascadeCount && !bSolved;++iCascadeIndex)
+				{
+					if ((uBoxMask & ~uContainedMask) & (1u << iCascadeIndex))
+					{
+						ComputeNearAndFarInViewSpace(fBoxNear[iCascadeIndex], fBoxFar[iCascadeIndex],
+							pOrthographicMin[iCascadeIndex], pOrthographicMax[iCascadeIndex], vBoxPointsInLightView);
+					}
+				}
+			}
+
+			for (int iCascadeIndex = 0;iCascadeIndex < nCascadeCount;++iCascadeIndex)
+			{
+				if (uBoxMask & (1u << iCascadeIndex))
+				{
+					pNearPlane[iCascadeIndex] = fminf(pNearPlane[iCascadeIndex], fBoxNear[iCascadeIndex]);
+					pFarPlane[iCascadeIndex] = fmaxf(pFarPlane[iCascadeIndex], fBoxFar[iCascadeIndex]);
+				}
+			}
+		}
+	}
+
+	return nBoxesTested;
+}
+
+// Drops the cascades whose far plane is in front of the light space box.
+static unsigned int RemoveCascadesBeyondFar(unsigned int uCascadeMask, float fLightMinZ, const float* pFarPlane)
+{
+	for (unsigned int uMask = uCascadeMask;uMask != 0;uMask &= uMask - 1)
+	{
+		int iCascadeIndex = 0;
+		while (!(uMask & (1u << iCascadeIndex)))
+		{
+			++iCascadeIndex;
+		}
+
+		if (fLightMinZ > pFarPlane[iCascadeIndex])
+		{
+			uCascadeMask &= ~(1u << iCascadeIndex);
+		}
+	}
+	return uCascadeMask;
+}
+
+
+int CullCasters(const SceneBoundsHierarchy& hierarchy, CXMMATRIX matLightView, int nCascadeCount,
+	const XMMATRIX* pOrthoProj, unsigned int* pBoxCascadeMasks)
+{
+	int nBoxCount = (int)hierarchy.m_vBoxMin.size();
+	for (int iBox = 0;iBox < nBoxCount;++iBox)
+	{
+		pBoxCascadeMasks[iBox] = 0;
+	}
+	if (hierarchy.m_Nodes.empty())
+	{
+		return 0;
+	}
+
+	// Recover the light space ortho bounds from the projections,an off center ortho maps them to -1 and 1 in x,y
+	// and the far plane to 1 in z.
+	XMVECTOR vOrthographicMin[MAX_CASCADES];
+	XMVECTOR vOrthographicMax[MAX_CASCADES];
+	float fFarPlane[MAX_CASCADES];
+	for (int iCascadeIndex = 0;iCascadeIndex < nCascadeCount;++iCascadeIndex)
+	{
+		XMFLOAT4X4 matProj;
+		XMStoreFloat4x4(&matProj, pOrthoProj[iCascadeIndex]);
+		vOrthographicMin[iCascadeIndex] = XMVectorSet((-1.0f - matProj._41) / matProj._11, (-1.0f - matProj._42) / matProj._22, 0.0f, 0.0f);
+		vOrthographicMax[iCascadeIndex] = XMVectorSet((1.0f - matProj._41) / matProj._11, (1.0f - matProj._42) / matProj._22, 0.0f, 0.0f);
+		fFarPlane[iCascadeIndex] = (1.0f - matProj._43) / matProj._33;
+	}
+
+	XMMATRIX matAbsLightView;
+	matAbsLightView.r[0] = XMVectorAbs(matLightView.r[0]);
+	matAbsLightView.r[1] = XMVectorAbs(matLightView.r[1]);
+	matAbsLightView.r[2] = XMVectorAbs(matLightView.r[2]);
+	matAbsLightView.r[3] = g_XMIdentityR3;
+
+	int iNodeStack[64];
+	unsigned int uMaskStack[64];
+	int nStackSize = 1;
+	iNodeStack[0] = 0;
+	uMaskStack[0] = (1u << nCascadeCount) - 1;
+
+	int nNodesVisited = 0;
+	while (nStackSize > 0)
+	{
+		--nStackSize;
+		const SceneBoundsNode& node = hierarchy.m_Nodes[iNodeStack[nStackSize]];
+		++nNodesVisited;
+
+		XMVECTOR vNodeMin = XMLoadFloat3(&node.m_vMin);
+		XMVECTOR vNodeMax = XMLoadFloat3(&node.m_vMax);
+		XMVECTOR vCenter = XMVector3Transform((vNodeMin + vNodeMax) * g_vHalfVector, matLightView);
+		XMVECTOR vExtents = XMVector3TransformNormal((vNodeMax - vNodeMin) * g_vHalfVector, matAbsLightView);
+		unsigned int uContainedMask;
+		unsigned int uMask = GetOverlappedCascades(vCenter - vExtents, vCenter + vExtents, uMaskStack[nStackSize],
+			vOrthographicMin, vOrthographicMax, &uContainedMask);
+		uMask = RemoveCascadesBeyondFar(uMask, XMVectorGetZ(vCenter - vExtents), fFarPlane);
+		if (uMask == 0)
+		{
+			continue;
+		}
+
+		// Every box under a node that is inside the rectangle and in front of the far plane is kept as a whole.
+		unsigned int uWholeMask = RemoveCascadesBeyondFar(uContainedMask, XMVectorGetZ(vCenter + vExtents), fFarPlane) & uMask;
+		if (node.m_iFirstChild >= 0 && uWholeMask != uMask)
+		{
+			iNodeStack[nStackSize] = node.m_iFirstChild;
+			uMaskStack[nStackSize++] = uMask;
+			iNodeStack[nStackSize] = node.m_iFirstChild + 1;
+			uMaskStack[nStackSize++] = uMask;
+			continue;
+		}
+
+		for (int iBox = node.m_iFirstBox;iBox < node.m_iFirstBox + node.m_nBoxCount;++iBox)
+		{
+			unsigned int uBoxMask = uMask;
+			if (uWholeMask != uMask)
+			{
+				XMVECTOR vBoxMin = XMLoadFloat3(&hierarchy.m_vBoxMin[iBox]);
+				XMVECTOR vBoxMax = XMLoadFloat3(&hierarchy.m_vBoxMax[iBox]);
+				XMVECTOR vLightCenter = XMVector3Transform((vBoxMin + vBoxMax) * g_vHalfVector, matLightView);
+				XMVECTOR vLightExtents = XMVector3TransformNormal((vBoxMax - vBoxMin) * g_vHalfVector, matAbsLightView);
+				uBoxMask = GetOverlappedCascades(vLightCenter - vLightExtents, vLightCenter + vLightExtents, uMask,
+					vOrthographicMin, vOrthographicMax);
+				uBoxMask = RemoveCascadesBeyondFar(uBoxMask, XMVectorGetZ(vLightCenter - vLightExtents), fFarPlane);
+			}
+			pBoxCascadeMasks[hierarchy.m_iBoxIndex[iBox]] = uBoxMask;
+		}
+	}
+
+	return nNodesVisited;
+}
+
+int CullSmallCasters(const SceneBoundsHierarchy& hierarchy, CXMMATRIX matLightView, int nCascadeCount,
+	const XMMATRIX* pOrthoProj, const int* pLengthOfShadowBuffer, float fMinTexels, unsigned int* pBoxCascadeMasks,
+	int* pnCulledPerCascade)
+{
+	// A cascade's texel is 2 / (scale * size) light space units wide.
+	float fMinWidth[MAX_CASCADES];
+	float fMinHeight[MAX_CASCADES];
+	for (int iCascadeIndex = 0;iCascadeIndex < nCascadeCount;++iCascadeIndex)
+	{
+		XMFLOAT4X4 matProj;
+		XMStoreFloat4x4(&matProj, pOrthoProj[iCascadeIndex]);
+		fMinWidth[iCascadeIndex] = fMinTexels * 2.0f / (matProj._11 * (float)pLengthOfShadowBuffer[iCascadeIndex]);
+		fMinHeight[iCascadeIndex] = fMinTexels * 2.0f / (matProj._22 * (float)pLengthOfShadowBuffer[iCascadeIndex]);
+	}
+
+	XMMATRIX matAbsLightView;
+	matAbsLightView.r[0] = XMVectorAbs(matLightView.r[0]);
+	matAbsLightView.r[1] = XMVectorAbs(matLightView.r[1]);
+	matAbsLightView.r[2] = XMVectorAbs(matLightView.r[2]);
+	matAbsLightView.r[3] = g_XMIdentityR3;
+
+	unsigned int uCascadesMask = (1u << nCascadeCount) - 1;
+	int nCulledCount = 0;
+	int nBoxCount = (int)hierarchy.m_vBoxMin.size();
+	for (int iBox = 0;iBox < nBoxCount;++iBox)
+	{
+		unsigned int& uBoxMask = pBoxCascadeMasks[hierarchy.m_iBoxIndex[iBox]];
+		if ((uBoxMask & uCascadesMask) == 0)
+		{
+			continue;
+		}
+
+		XMVECTOR vSize = XMVector3TransformNormal(XMLoadFloat3(&hierarchy.m_vBoxMax[iBox]) - XMLoadFloat3(&hierarchy.m_vBoxMin[iBox]), matAbsLightView);
+		float fWidth = XMVectorGetX(vSize);
+		float fHeight = XMVectorGetY(vSize);
+		for (int iCascadeIndex = 0;iCascadeIndex < nCascadeCount;++iCascadeIndex)
+		{
+			if ((uBoxMask & (1u << iCascadeIndex)) && fWidth < fMinWidth[iCascadeIndex] && fHeight < fMinHeight[iCascadeIndex])
+			{
+				uBoxMask &= ~(1u << iCascadeIndex);
+				++pnCulledPerCascade[iCascadeIndex];
+				++nCulledCount;
+			}
+		}
+	}
+
+	return nCulledCount;
+}
+
+static bool MatrixEqual(CXMMATRIX a, CXMMATRIX b)
+{
+	return XMVector4Equal(a.r[0], b.r[0]) && XMVector4Equal(a.r[1], b.r[1])
+		&& XMVector4Equal(a.r[2], b.r[2]) && XMVector4Equal(a.r[3], b.r[3]);
+}
+
+bool FitParamsEqual(const CascadeFitParams& a, const CascadeFitParams& b)
+{
+	if (a.m_nUsingCascadeLevelsCount != b.m_nUsingCascadeLevelsCount
+		|| a.m_iCascadePartitionMax != b.m_iCascadePartitionMax
+		|| a.m_eSplitMode != b.m_eSplitMode
+		|| a.m_fSplitLambda != b.m_fSplitLambda
+		|| a.m_bUseDepthBounds != b.m_bUseDepthBounds
+		|| (a.m_bUseDepthBounds && (a.m_fDepthBoundsMin != b.m_fDepthBoundsMin || a.m_fDepthBoundsMax != b.m_fDepthBoundsMax))
+		|| a.m_iLengthOfShadowBufferSquare != b.m_iLengthOfShadowBufferSquare
+		|| memcmp(a.m_iCascadeLengthOfShadowBuffer, b.m_iCascadeLengthOfShadowBuffer, sizeof(int) * a.m_nUsingCascadeLevelsCount) != 0
+		|| a.m_iPCFBlurSize != b.m_iPCFBlurSize
+		|| a.m_iFarCascadeGuardTexels != b.m_iFarCascadeGuardTexels
+		|| a.m_bMoveLightTexelSize != b.m_bMoveLightTexelSize
+		|| a.m_bAnalyticNearFar != b.m_bAnalyticNearFar
+		|| a.m_pSceneBounds != b.m_pSceneBounds
+		|| a.m_eLightViewFrustumFitMode != b.m_eLightViewFrustumFitMode
+		|| a.m_eSelectedNearFarFit != b.m_eSelectedNearFarFit
+		|| a.m_fViewerCameraNearClip != b.m_fViewerCameraNearClip
+		|| a.m_fViewerCameraFarClip != b.m_fViewerCameraFarClip)
+	{
+		return false;
+	}
+
+	for (int i = 0;i < a.m_nUsingCascadeLevelsCount;++i)
+	{
+		if (a.m_iCascadePartitionsZeroToOne[i] != b.m_iCascadePartitionsZeroToOne[i])
+		{
+			return false;
+		}
+	}
+
+	return XMVector3Equal(a.m_vSceneAABBMin, b.m_vSceneAABBMin) && XMVector3Equal(a.m_vSceneAABBMax, b.m_vSceneAABBMax)
+		&& MatrixEqual(a.m_matViewerCameraView, b.m_matViewerCameraView)
+		&& MatrixEqual(a.m_matViewerCameraProj, b.m_matViewerCameraProj)
+		&& MatrixEqual(a.m_matLightCameraView, b.m_matLightCameraView);
+}
+
+
+void InvalidateCascadeCache(CascadeCache* pCache)
+{
+	pCache->m_bFitValid = false;
+	InvalidateCascadeTiles(pCache);
+}
+
+
+void InvalidateCascadeTiles(CascadeCache* pCache)
+{
+	for (int i = 0;i < MAX_CASCADES;++i)
+	{
+		pCache->m_bTileValid[i] = false;
+		pCache->m_iTileOriginX[i] = 0;
+		pCache->m_iTileOriginY[i] = 0;
+	}
+	pCache->m_iNextRoundRobinCascade = 1;
+}
+
+
+bool FitCascadesCached(const CascadeFitParams& params, CascadeCache* pCache)
+{
+	if (pCache->m_bFitValid && FitParamsEqual(params, pCache->m_LastParams))
+	{
+		return false;
+	}
+
+	FitCascades(params, &pCache->m_LastResult);
+	pCache->m_LastParams = params;
+	pCache->m_bFitValid = true;
+	return true;
+}
+
+
+unsigned int GetDirtyCascadeMask(const CascadeFitParams& params, const CascadeCache& cache)
+{
+	unsigned int uDirtyMask = 0;
+	for (int iCascadeIndex = 0;iCascadeIndex < params.m_nUsingCascadeLevelsCount;++iCascadeIndex)
+	{
+		// Texel snapping keeps the projection of a cascade identical while the camera moves inside a texel,
+		// so comparing the matrix catches more than comparing the inputs.
+		if (!cache.m_bTileValid[iCascadeIndex]
+			|| cache.m_eRenderedNearFarFit[iCascadeIndex] != params.m_eSelectedNearFarFit
+			|| !MatrixEqual(cache.m_LastResult.m_matOrthoProjForCascades[iCascadeIndex], cache.m_matRenderedOrthoProj[iCascadeIndex])
+			|| !MatrixEqual(cache.m_LastResult.m_matShadowView, cache.m_matRenderedShadowView[iCascadeIndex]))
+		{
+			uDirtyMask |= 1u << iCascadeIndex;
+		}
+	}
+	return uDirtyMask;
+}
+
+
+// Light space x/y range an ortho projection maps to -1..1.
+static void GetOrthoRect(CXMMATRIX matOrthoProj, float& fMinX, float& fMaxX, float& fMinY, float& fMaxY)
+{
+	float fScaleX = XMVectorGetX(matOrthoProj.r[0]);
+	float fScaleY = XMVectorGetY(matOrthoProj.r[1]);
+	float fOffsetX = XMVectorGetX(matOrthoProj.r[3]);
+	float fOffsetY = XMVectorGetY(matOrthoProj.r[3]);
+	fMinX = (-1.0f - fOffsetX) / fScaleX;
+	fMaxX = (1.0f - fOffsetX) / fScaleX;
+	fMinY = (-1.0f - fOffsetY) / fScaleY;
+	fMaxY = (1.0f - fOffsetY) / fScaleY;
+}
+
+
+float ComputeTileError(CXMMATRIX matOrthoProj, CXMMATRIX matRenderedOrthoProj, int iLengthOfShadowBufferSquare)
+{
+	float fMinX, fMaxX, fMinY, fMaxY;
+	float fRenderedMinX, fRenderedMaxX, fRenderedMinY, fRenderedMaxY;
+	GetOrthoRect(matOrthoProj, fMinX, fMaxX, fMinY, fMaxY);
+	GetOrthoRect(matRenderedOrthoProj, fRenderedMinX, fRenderedMaxX, fRenderedMinY, fRenderedMaxY);
+
+	float fTexelsPerUnitX = (float)iLengthOfShadowBufferSquare / (fMaxX - fMinX);
+	float fTexelsPerUnitY = (float)iLengthOfShadowBufferSquare / (fMaxY - fMinY);
+	float fError = fabsf(fMinX - fRenderedMinX) * fTexelsPerUnitX;
+	fError = fmaxf(fError, fabsf(fMaxX - fRenderedMaxX) * fTexelsPerUnitX);
+	fError = fmaxf(fError, fabsf(fMinY - fRenderedMinY) * fTexelsPerUnitY);
+	fError = fmaxf(fError, fabsf(fMaxY - fRenderedMaxY) * fTexelsPerUnitY);
+
+	// z' = z*_33 + _43,so the near plane is at -_43/_33 and the range is 1/_33.
+	float fDepthScale = XMVectorGetZ(matOrthoProj.r[2]);
+	float fRenderedDepthScale = XMVectorGetZ(matRenderedOrthoProj.r[2]);
+	float fNear = -XMVectorGetZ(matOrthoProj.r[3]) / fDepthScale;
+	float fRenderedNear = -XMVectorGetZ(matRenderedOrthoProj.r[3]) / fRenderedDepthScale;
+	float fDepthError = fabsf(fNear - fRenderedNear) + fabsf(1.0f / fDepthScale - 1.0f / fRenderedDepthScale);
+	fError = fmaxf(fError, fDepthError * fDepthScale * (float)iLengthOfShadowBufferSquare);
+
+	return fError;
+}
+
+
+unsigned int ScheduleCascadeUpdates(const CascadeFitParams& params, CASCADE_UPDATE_SCHEDULE eSchedule,
+	int iFarCascadeUpdatesPerFrame, CascadeCache* pCache)
+{
+	unsigned int uDirtyMask = GetDirtyCascadeMask(params, *pCache);
+	if (eSchedule == CASCADE_UPDATE_EVERY_FRAME || uDirtyMask == 0)
+	{
+		return uDirtyMask;
+	}
+
+	const CascadeFitResult& fit = pCache->m_LastResult;
+	CascadeLightSpaceBounds lightSpaceBounds;
+	ComputeLightSpaceCascadeBounds(params, fit.m_FrustumSlices, &lightSpaceBounds);
+
+	unsigned int uUpdateMask = uDirtyMask & 1u;
+	unsigned int uOptionalMask = 0;
+	for (int iCascadeIndex = 1;iCascadeIndex < params.m_nUsingCascadeLevelsCount;++iCascadeIndex)
+	{
+		unsigned int uBit = 1u << iCascadeIndex;
+		if ((uDirtyMask & uBit) == 0)
+		{
+			continue;
+		}
+
+		// The scene shader shares one shadow view between all cascades,and a new tile can't wait.
+		bool bMustUpdate = !pCache->m_bTileValid[iCascadeIndex]
+			|| pCache->m_eRenderedNearFarFit[iCascadeIndex] != params.m_eSelectedNearFarFit
+			|| !MatrixEqual(fit.m_matShadowView, pCache->m_matRenderedShadowView[iCascadeIndex]);
+
+		if (!bMustUpdate)
+		{
+			// The old tile is only usable while it still covers the cascade's part of the view frustum,with the
+			// PCF kernel of the texels at its border inside the tile as well.
+			int iLength = GetCascadeLengthOfShadowBuffer(params, iCascadeIndex);
+			float fMinX, fMaxX, fMinY, fMaxY;
+			GetOrthoRect(pCache->m_matRenderedOrthoProj[iCascadeIndex], fMinX, fMaxX, fMinY, fMaxY);
+			float fBlurX = (fMaxX - fMinX) * (float)params.m_iPCFBlurSize / (float)iLength;
+			float fBlurY = (fMaxY - fMinY) * (float)params.m_iPCFBlurSize / (float)iLength;
+			XMVECTOR vMin = lightSpaceBounds.m_vMin[iCascadeIndex];
+			XMVECTOR vMax = lightSpaceBounds.m_vMax[iCascadeIndex];
+			bMustUpdate = XMVectorGetX(vMin) < fMinX + fBlurX || XMVectorGetX(vMax) > fMaxX - fBlurX
+				|| XMVectorGetY(vMin) < fMinY + fBlurY || XMVectorGetY(vMax) > fMaxY - fBlurY;
+
+			// Nor may it drift further from the fit than the guard band the cascade was fitted with.
+			int iGuardTexels = params.m_iFarCascadeGuardTexels > 0 ? params.m_iFarCascadeGuardTexels : CASCADE_FAR_GUARD_TEXELS;
+			bMustUpdate = bMustUpdate || ComputeTileError(fit.m_matOrthoProjForCascades[iCascadeIndex],
+				pCache->m_matRenderedOrthoProj[iCascadeIndex], iLength) > (float)iGuardTexels;
+		}
+
+		if (bMustUpdate)
+		{
+			uUpdateMask |= uBit;
+		}
+		else
+		{
+			uOptionalMask |= uBit;
+		}
+	}
+
+	int nFarCascadeCount = params.m_nUsingCascadeLevelsCount - 1;
+	for (int iPick = 0;iPick < iFarCascadeUpdatesPerFrame && uOptionalMask != 0;++iPick)
+	{
+		int iPickedCascade = -1;
+		if (eSchedule == CASCADE_UPDATE_ROUND_ROBIN)
+		{
+			for (int i = 0;i < nFarCascadeCount && iPickedCascade < 0;++i)
+			{
+				int iCascadeIndex = 1 + (pCache->m_iNextRoundRobinCascade - 1 + i + nFarCascadeCount) % nFarCascadeCount;
+				if (uOptionalMask & (1u << iCascadeIndex))
+				{
+					iPickedCascade = iCascadeIndex;
+				}
+			}
+			pCache->m_iNextRoundRobinCascade = iPickedCascade % nFarCascadeCount + 1;
+		}
+		else
+		{
+			float fLargestError = -1.0f;
+			for (int iCascadeIndex = 1;iCascadeIndex < params.m_nUsingCascadeLevelsCount;++iCascadeIndex)
+			{
+				if (uOptionalMask & (1u << iCascadeIndex))
+				{
+					float fError = ComputeTileError(fit.m_matOrthoProjForCascades[iCascadeIndex], pCache->m_matRenderedOrthoProj[iCascadeIndex],
+						GetCascadeLengthOfShadowBuffer(params, iCascadeIndex));
+					if (fError > fLargestError)
+					{
+						fLargestError = fError;
+						iPickedCascade = iCascadeIndex;
+					}
+				}
+			}
+		}
+
+		uUpdateMask |= 1u << iPickedCascade;
+		uOptionalMask &= ~(1u << iPickedCascade);
+	}
+
+	return uUpdateMask;
+}
+
+
+void MarkCascadesRendered(const CascadeFitParams& params, unsigned int uCascadeMask, CascadeCache* pCache)
+{
+	for (int iCascadeIndex = 0;iCascadeIndex < params.m_nUsingCascadeLevelsCount;++iCascadeIndex)
+	{
+		if (uCascadeMask & (1u << iCascadeIndex))
+		{
+			pCache->m_matRenderedOrthoProj[iCascadeIndex] = pCache->m_LastResult.m_matOrthoProjForCascades[iCascadeIndex];
+			pCache->m_matRenderedShadowView[iCascadeIndex] = pCache->m_LastResult.m_matShadowView;
+			pCache->m_eRenderedNearFarFit[iCascadeIndex] = params.m_eSelectedNearFarFit;
+			pCache->m_bTileValid[iCascadeIndex] = true;
+			pCache->m_iTileOriginX[iCascadeIndex] = 0;
+			pCache->m_iTileOriginY[iCascadeIndex] = 0;
+		}
+	}
+}
+
+
+unsigned int ScheduleCascadeScrolls(const CascadeFitParams& params, unsigned int uUpdateMask, CascadeCache* pCache,
+	CascadeScroll* pScrolls)
+{
+	if (!params.m_bMoveLightTexelSize)
+	{
+		return 0;
+	}
+
+	CascadeFitResult& fit = pCache->m_LastResult;
+	unsigned int uScrollMask = 0;
+	for (int iCascadeIndex = 0;iCascadeIndex < params.m_nUsingCascadeLevelsCount;++iCascadeIndex)
+	{
+		int iTileSize = GetCascadeLengthOfShadowBuffer(params, iCascadeIndex);
+		if ((uUpdateMask & (1u << iCascadeIndex)) == 0 || !pCache->m_bTileValid[iCascadeIndex]
+			|| pCache->m_eRenderedNearFarFit[iCascadeIndex] != params.m_eSelectedNearFarFit
+			|| !MatrixEqual(fit.m_matShadowView, pCache->m_matRenderedShadowView[iCascadeIndex]))
+		{
+			continue;
+		}
+
+		XMFLOAT4X4 matProj, matRenderedProj;
+		XMStoreFloat4x4(&matProj, fit.m_matOrthoProjForCascades[iCascadeIndex]);
+		XMStoreFloat4x4(&matRenderedProj, pCache->m_matRenderedOrthoProj[iCascadeIndex]);
+
+		// The snapped bounds keep their size while the cascade's extent does not change.
+		if (fabsf(matProj._11 - matRenderedProj._11) > 1e-5f * fabsf(matRenderedProj._11)
+			|| fabsf(matProj._22 - matRenderedProj._22) > 1e-5f * fabsf(matRenderedProj._22))
+		{
+			continue;
+		}
+
+		// Measured in light space,the NDC offsets of a cascade far from the light's axis are too coarse.
+		// v runs against y.
+		float fMinX, fMaxX, fMinY, fMaxY;
+		float fRenderedMinX, fRenderedMaxX, fRenderedMinY, fRenderedMaxY;
+		GetOrthoRect(fit.m_matOrthoProjForCascades[iCascadeIndex], fMinX, fMaxX, fMinY, fMaxY);
+		GetOrthoRect(pCache->m_matRenderedOrthoProj[iCascadeIndex], fRenderedMinX, fRenderedMaxX, fRenderedMinY, fRenderedMaxY);
+		float fShiftX = (fRenderedMinX + fRenderedMaxX - fMinX - fMaxX) * 0.5f * (float)iTileSize / (fRenderedMaxX - fRenderedMinX);
+		float fShiftY = (fMinY + fMaxY - fRenderedMinY - fRenderedMaxY) * 0.5f * (float)iTileSize / (fRenderedMaxY - fRenderedMinY);
+		float fWholeShiftX = floorf(fShiftX + 0.5f);
+		float fWholeShiftY = floorf(fShiftY + 0.5f);
+		if (fabsf(fShiftX - fWholeShiftX) > 0.01f || fabsf(fShiftY - fWholeShiftY) > 0.01f
+			|| fabsf(fWholeShiftX) >= (float)iTileSize || fabsf(fWholeShiftY) >= (float)iTileSize)
+		{
+			continue;
+		}
+
+		// The kept texels hold depth in the rendered range,so that range has to contain the new one.
+		float fNear = -matProj._43 / matProj._33;
+		float fFar = (1.0f - matProj._43) / matProj._33;
+		float fRenderedNear = -matRenderedProj._43 / matRenderedProj._33;
+		float fRenderedFar = (1.0f - matRenderedProj._43) / matRenderedProj._33;
+		if (fNear < fRenderedNear || fFar > fRenderedFar)
+		{
+			continue;
+		}
+
+		matProj._33 = matRenderedProj._33;
+		matProj._43 = matRenderedProj._43;
+		fit.m_matOrthoProjForCascades[iCascadeIndex] = XMLoadFloat4x4(&matProj);
+
+		CascadeScroll& scroll = pScrolls[iCascadeIndex];
+		scroll.m_iShiftX = (int)fWholeShiftX;
+		scroll.m_iShiftY = (int)fWholeShiftY;
+		scroll.m_iOriginX = ((pCache->m_iTileOriginX[iCascadeIndex] - scroll.m_iShiftX) % iTileSize + iTileSize) % iTileSize;
+		scroll.m_iOriginY = ((pCache->m_iTileOriginY[iCascadeIndex] - scroll.m_iShiftY) % iTileSize + iTileSize) % iTileSize;
+		uScrollMask |= 1u << iCascadeIndex;
+	}
+	return uScrollMask;
+}
+
+
+int GetScrollStrips(const CascadeScroll& scroll, int iLengthOfShadowBufferSquare, CascadeTexelRect* pStrips)
+{
+	int iTileSize = iLengthOfShadowBufferSquare;
+	int nStripCount = 0;
+
+	// The columns that scrolled in span the whole tile.
+	int iKeptLeft = 0;
+	int iKeptRight = iTileSize;
+	if (scroll.m_iShiftX != 0)
+	{
+		CascadeTexelRect& strip = pStrips[nStripCount++];
+		strip.m_iLeft = scroll.m_iShiftX > 0 ? 0 : iTileSize + scroll.m_iShiftX;
+		strip.m_iRight = scroll.m_iShiftX > 0 ? scroll.m_iShiftX : iTileSize;
+		strip.m_iTop = 0;
+		strip.m_iBottom = iTileSize;
+		iKeptLeft = scroll.m_iShiftX > 0 ? scroll.m_iShiftX : 0;
+		iKeptRight = scroll.m_iShiftX > 0 ? iTileSize : iTileSize + scroll.m_iShiftX;
+	}
+
+	// The rows that scrolled in,without the columns above.
+	if (scroll.m_iShiftY != 0)
+	{
+		CascadeTexelRect& strip = pStrips[nStripCount++];
+		strip.m_iLeft = iKeptLeft;
+		strip.m_iRight = iKeptRight;
+		strip.m_iTop = scroll.m_iShiftY > 0 ? 0 : iTileSize + scroll.m_iShiftY;
+		strip.m_iBottom = scroll.m_iShiftY > 0 ? scroll.m_iShiftY : iTileSize;
+	}
+
+	return nStripCount;
+}
+
+
+XMMATRIX GetTexelRectOrthoProj(CXMMATRIX matOrthoProj, const CascadeTexelRect& rect, int iLengthOfShadowBufferSquare)
+{
+	float fMinX, fMaxX, fMinY, fMaxY;
+	GetOrthoRect(matOrthoProj, fMinX, fMaxX, fMinY, fMaxY);
+	float fTexelSizeX = (fMaxX - fMinX) / (float)iLengthOfShadowBufferSquare;
+	float fTexelSizeY = (fMaxY - fMinY) / (float)iLengthOfShadowBufferSquare;
+
+	float fDepthScale = XMVectorGetZ(matOrthoProj.r[2]);
+	float fNear = -XMVectorGetZ(matOrthoProj.r[3]) / fDepthScale;
+
+	// Row 0 is the top of the tile,at the largest y.
+	return XMMatrixOrthographicOffCenterLH(fMinX + (float)rect.m_iLeft * fTexelSizeX, fMinX + (float)rect.m_iRight * fTexelSizeX,
+		fMaxY - (float)rect.m_iBottom * fTexelSizeY, fMaxY - (float)rect.m_iTop * fTexelSizeY, fNear, fNear + 1.0f / fDepthScale);
+}
+
+
+void MarkCascadesScrolled(const CascadeFitParams& params, unsigned int uCascadeMask, const CascadeScroll* pScrolls, CascadeCache* pCache)
+{
+	MarkCascadesRendered(params, uCascadeMask, pCache);
+	for (int iCascadeIndex = 0;iCascadeIndex < params.m_nUsingCascadeLevelsCount;++iCascadeIndex)
+	{
+		if (uCascadeMask & (1u << iCascadeIndex))
+		{
+			pCache->m_iTileOriginX[iCascadeIndex] = pScrolls[iCascadeIndex].m_iOriginX;
+			pCache->m_iTileOriginY[iCascadeIndex] = pScrolls[iCascadeIndex].m_iOriginY;
+		}
+	}
+}
+
+
+bool AllocateCascadeRingSlots(unsigned int uCascadeMask, int nCascadeCount, unsigned int uRingSlotCount, unsigned int* puNextSlot,
+	unsigned int* puSlots)
+{
+	unsigned int nSlotCount = 0;
+	for (int iCascadeIndex = 0;iCascadeIndex < nCascadeCount;++iCascadeIndex)
+	{
+		nSlotCount += (uCascadeMask >> iCascadeIndex) & 1;
+	}
+
+	bool bDiscard = *puNextSlot + nSlotCount > uRingSlotCount;
+	if (bDiscard)
+	{
+		*puNextSlot = 0;
+	}
+	for (int iCascadeIndex = 0;iCascadeIndex < nCascadeCount;++iCascadeIndex)
+	{
+		if (uCascadeMask & (1u << iCascadeIndex))
+		{
+			puSlots[iCascadeIndex] = (*puNextSlot)++;
+		}
+	}
+	return bDiscard;
+}
+
+
+
+long long GetShadowMapBytes(const int* pLengths, int nCascadeCount, int iBytesPerTexel, int iMaxTextureLength)
+{
+	int iLongestLength = 0;
+	for (int i = 0;i < nCascadeCount;++i)
+	{
+		iLongestLength = std::max(iLongestLength, pLengths[i]);
+	}
+
+	AtlasRect rects[MAX_CASCADES];
+	long long iAtlasWidth = AtlasPacking::PackSquaresSkyline(pLengths, nCascadeCount, iLongestLength, rects);
+	if (iAtlasWidth > iMaxTextureLength)
+	{
+		iAtlasWidth = (long long)iLongestLength * nCascadeCount;
+	}
+	return iAtlasWidth * iLongestLength * iBytesPerTexel;
+}
+
+
+// Ranks a shadow map inside the budget against the best one so far:reaching the target first,then 32 bit depth
+// and fewer bytes among those that reach it,the denser one among those that don't.
+static bool IsBetterBudgetChoice(const ShadowBudgetChoice& candidate, const ShadowBudgetChoice& best)
+{
+	if (candidate.m_bMeetsTarget != best.m_bMeetsTarget)
+	{
+		return candidate.m_bMeetsTarget;
+	}
+	if (candidate.m_bMeetsTarget)
+	{
+		if (candidate.m_iBytesPerTexel != best.m_iBytesPerTexel)
+		{
+			return candidate.m_iBytesPerTexel > best.m_iBytesPerTexel;
+		}
+		if (candidate.m_iBytes != best.m_iBytes)
+		{
+			return candidate.m_iBytes < best.m_iBytes;
+		}
+		return candidate.m_fMinTexelsPerPixel > best.m_fMinTexelsPerPixel;
+	}
+	if (candidate.m_fMinTexelsPerPixel != best.m_fMinTexelsPerPixel)
+	{
+		return candidate.m_fMinTexelsPerPixel > best.m_fMinTexelsPerPixel;
+	}
+	if (candidate.m_iBytesPerTexel != best.m_iBytesPerTexel)
+	{
+		return candidate.m_iBytesPerTexel > best.m_iBytesPerTexel;
+	}
+	return candidate.m_iBytes < best.m_iBytes;
+}
+
+
+void SelectShadowBudgetConfig(const CascadeFitParams& params, const ShadowBudgetParams& budget, ShadowBudgetChoice* pChoice)
+{
+	static const int s_iBytesPerTexel[2] = { 4, 2 };
+
+	ShadowBudgetChoice best;
+	memset(&best, 0, sizeof(best));
+	bool bFound = false;
+	int nCandidateCount = 0;
+
+	// A length that isn't positive never doubles past m_iMaxLength.
+	if (budget.m_iMinLength <= 0 || budget.m_iMinLength > budget.m_iMaxLength || budget.m_nMaxCascadeCount < 1)
+	{
+		*pChoice = best;
+		return;
+	}
+
+	CascadeFitParams candidateParams = params;
+	candidateParams.m_eSplitMode = CASCADE_SPLIT_PRACTICAL;
+	CascadeFitResult result;
+	CascadeTexelDensity density;
+	for (int nCascadeCount = 1;nCascadeCount <= std::min(budget.m_nMaxCascadeCount, MAX_CASCADES);++nCascadeCount)
+	{
+		for (int iLength = budget.m_iMinLength;iLength <= budget.m_iMaxLength;iLength *= 2)
+		{
+			ShadowBudgetChoice candidate;
+			memset(&candidate, 0, sizeof(candidate));
+			candidate.m_nCascadeCount = nCascadeCount;
+			candidate.m_iLengthOfShadowBufferSquare = iLength;
+			int iLengths[MAX_CASCADES];
+			for (int i = 0;i < nCascadeCount;++i)
+			{
+				iLengths[i] = iLength;
+			}
+			if (budget.m_bHalvingLengths)
+			{
+				AtlasPacking::GetHalvingCascadeLengths(iLength, nCascadeCount, budget.m_iMinLength, iLengths);
+				memcpy(candidate.m_iCascadeLengthOfShadowBuffer, iLengths, sizeof(int) * nCascadeCount);
+			}
+
+			// The fit is the same for both formats.
+			bool bFitted = false;
+			for (int iFormat = 0;iFormat < 2;++iFormat)
+			{
+				candidate.m_iBytesPerTexel = s_iBytesPerTexel[iFormat];
+				candidate.m_iBytes = GetShadowMapBytes(iLengths, nCascadeCount, candidate.m_iBytesPerTexel, budget.m_iMaxTextureLength)
+					* (budget.m_bStaticLayer ? 2 : 1);
+				candidate.m_bFitsBudget = candidate.m_iBytes <= budget.m_iBudgetBytes;
+				++nCandidateCount;
+
+				// Until something fits the smallest shadow map is kept as the fallback.
+				if (!candidate.m_bFitsBudget)
+				{
+					if (!bFound && (best.m_nCascadeCount == 0 || candidate.m_iBytes < best.m_iBytes))
+					{
+						best = candidate;
+					}
+					continue;
+				}
+
+				if (!bFitted)
+				{
+					candidateParams.m_nUsingCascadeLevelsCount = nCascadeCount;
+					candidateParams.m_iLengthOfShadowBufferSquare = iLength;
+					memcpy(candidateParams.m_iCascadeLengthOfShadowBuffer, candidate.m_iCascadeLengthOfShadowBuffer,
+						sizeof(candidateParams.m_iCascadeLengthOfShadowBuffer));
+					FitCascades(candidateParams, &result);
+					ComputeTexelDensity(candidateParams, result.m_matOrthoProjForCascades, result.m_FrustumSlices, budget.m_iScreenHeight, &density);
+					bFitted = true;
+				}
+				candidate.m_fMinTexelsPerPixel = density.m_fMinTexelsPerPixel;
+				candidate.m_bMeetsTarget = density.m_fMinTexelsPerPixel >= budget.m_fTargetTexelsPerPixel;
+				if (!bFound || IsBetterBudgetChoice(candidate, best))
+				{
+					best = candidate;
+					bFound = true;
+				}
+			}
+
+			// The next length would be past m_iMaxLength,doubling it could overflow.
+			if (iLength > budget.m_iMaxLength / 2)
+			{
+				break;
+			}
+		}
+	}
+
+	// The fallback was not fitted.
+	if (!bFound && best.m_nCascadeCount > 0)
+	{
+		candidateParams.m_nUsingCascadeLevelsCount = best.m_nCascadeCount;
+		candidateParams.m_iLengthOfShadowBufferSquare = best.m_iLengthOfShadowBufferSquare;
+		memcpy(candidateParams.m_iCascadeLengthOfShadowBuffer, best.m_iCascadeLengthOfShadowBuffer, sizeof(candidateParams.m_iCascadeLengthOfShadowBuffer));
+		FitCascades(candidateParams, &result);
+		ComputeTexelDensity(candidateParams, result.m_matOrthoProjForCascades, result.m_FrustumSlices, budget.m_iScreenHeight, &density);
+		best.m_fMinTexelsPerPixel = density.m_fMinTexelsPerPixel;
+		best.m_bMeetsTarget = density.m_fMinTexelsPerPixel >= budget.m_fTargetTexelsPerPixel;
+	}
+	best.m_nCandidateCount = nCandidateCount;
+	*pChoice = best;
+}
+
+}
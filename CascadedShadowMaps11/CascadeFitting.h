@@ -0,0 +1,362 @@
+//--------------------------------------------------------------------------------------
+// File: CascadeFitting.h
+//
+// The per-frame cascade math of the CascadedShadowsManager: partition selection,
+// frustum corner generation, ortho fitting, texel snapping and near/far computation.
+// It only depends on DirectXMath, so it can be driven without a D3D11 device, DXUT or
+// the cameras (see CascadeFittingBench).
+//--------------------------------------------------------------------------------------
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#define MAX_CASCADES 8
+
+enum FIT_LIGHT_VIEW_FRUSTRUM
+{
+	FIT_LIGHT_VIEW_FRUSTRUM_TO_CASCADE_INTERVALS,
+	FIT_LIGHT_VIEW_FRUSTRUM_TO_SCENE
+};
+
+enum FIT_NEAR_FAR
+{
+	FIT_NEAR_FAR_DEFAULT_ZERO_ONE,
+	FIT_NEAR_FAR_ONLY_SCENE_AABB,
+	FIT_NEAR_FAR_SCENE_AABB_AND_ORTHO_BOUND,
+	FIT_NEAR_FAR_PANCAKING,
+};
+
+enum CASCADE_SPLIT_MODE
+{
+	CASCADE_SPLIT_MANUAL, // m_iCascadePartitionsZeroToOne out of m_iCascadePartitionMax
+	CASCADE_SPLIT_PRACTICAL, // m_fSplitLambda blend of logarithmic and uniform splits between the camera near and far
+};
+
+// A node of a SceneBoundsHierarchy.Inner nodes have their children at m_iFirstChild and m_iFirstChild + 1,
+// leaves own m_nBoxCount boxes starting at m_iFirstBox.
+struct SceneBoundsNode
+{
+	DirectX::XMFLOAT3 m_vMin;
+	DirectX::XMFLOAT3 m_vMax;
+	int m_iFirstChild; // -1 for a leaf
+	int m_iFirstBox;
+	int m_nBoxCount;
+};
+
+// World space bounds of the meshes and subsets of a scene,built once at load time so that each cascade's
+// near and far plane only come from the geometry under its ortho footprint.
+struct SceneBoundsHierarchy
+{
+	std::vector<SceneBoundsNode> m_Nodes; // m_Nodes[0] is the root
+	std::vector<DirectX::XMFLOAT3> m_vBoxMin; // Ordered so that the boxes of a leaf are contiguous
+	std::vector<DirectX::XMFLOAT3> m_vBoxMax;
+	std::vector<int> m_iBoxIndex; // Index of each box in the array BuildSceneBoundsHierarchy was given
+};
+
+// Everything the cascade fit reads.The manager fills this from the cameras and the GUI every frame.
+struct CascadeFitParams
+{
+	DirectX::XMMATRIX m_matViewerCameraView;
+	DirectX::XMMATRIX m_matViewerCameraProj;
+	DirectX::XMMATRIX m_matLightCameraView;
+	DirectX::XMVECTOR m_vSceneAABBMin;
+	DirectX::XMVECTOR m_vSceneAABBMax;
+	float m_fViewerCameraNearClip;
+	float m_fViewerCameraFarClip;
+
+	int m_nUsingCascadeLevelsCount;
+	int m_iCascadePartitionsZeroToOne[MAX_CASCADES]; // Values are 0 to m_iCascadePartitionMax
+	int m_iCascadePartitionMax;
+	CASCADE_SPLIT_MODE m_eSplitMode;
+	float m_fSplitLambda; // 0 is uniform,1 is logarithmic
+	bool m_bUseDepthBounds; // Split m_fDepthBoundsMin..m_fDepthBoundsMax instead of the whole camera range
+	float m_fDepthBoundsMin; // View space depth range of the visible pixels,see ReduceDepthBounds
+	float m_fDepthBoundsMax;
+	int m_iLengthOfShadowBufferSquare;
+	int m_iCascadeLengthOfShadowBuffer[MAX_CASCADES]; // Tile length of each cascade,0 uses m_iLengthOfShadowBufferSquare
+	int m_iPCFBlurSize;
+	int m_iFarCascadeGuardTexels; // Texels of slack around the far cascades so a deferred tile still covers its interval,0 fits tightly
+	bool m_bMoveLightTexelSize;
+	bool m_bAnalyticNearFar; // Use ComputeNearAndFarAnalytic instead of the triangle clipper
+	const SceneBoundsHierarchy* m_pSceneBounds; // Fit near/far to the boxes under each cascade,nullptr uses the scene AABB
+	FIT_LIGHT_VIEW_FRUSTRUM m_eLightViewFrustumFitMode;
+	FIT_NEAR_FAR m_eSelectedNearFarFit;
+};
+
+// The corner quads of the planes that separate the cascades,computed once per frame and shared by all cascades.
+// Slice 0 is the plane at depth 0 and slice i+1 is the far plane of cascade i,so cascade i spans slices i..i+1
+// in FIT_TO_CASCADE_INTERVALS and slices 0..i+1 in FIT_TO_SCENE.
+struct CascadeFrustumSlices
+{
+	int m_nSliceCount; // cascade count + 1
+	float m_fDepthInView[MAX_CASCADES + 1];
+	DirectX::XMVECTOR m_vCornersInView[MAX_CASCADES + 1][4]; // right top,right bottom,left bottom,left top
+	DirectX::XMVECTOR m_vCornersInLight[MAX_CASCADES + 1][4];
+	DirectX::XMVECTOR m_vLightSpaceMin[MAX_CASCADES + 1]; // Light space AABB of each corner quad
+	DirectX::XMVECTOR m_vLightSpaceMax[MAX_CASCADES + 1];
+};
+
+// Everything the cascade fit writes.Only the first m_nUsingCascadeLevelsCount entries are valid.
+struct CascadeFitResult
+{
+	DirectX::XMMATRIX m_matOrthoProjForCascades[MAX_CASCADES];
+	DirectX::XMMATRIX m_matShadowView;
+	DirectX::XMVECTOR m_vViewSpaceUnitsPerTexel[MAX_CASCADES];
+	float m_fCascadePartitionDepthsInEyeSpace[MAX_CASCADES]; // Values are between near and far
+	CascadeFrustumSlices m_FrustumSlices;
+};
+
+// How finely each cascade samples the screen.
+struct CascadeTexelDensity
+{
+	float m_fWorldUnitsPerTexel[MAX_CASCADES];
+	float m_fTexelsPerPixel[MAX_CASCADES]; // At the geometric middle of the cascade's interval,below 1 shows blocky shadows
+	float m_fMinTexelsPerPixel; // Worst of all cascades
+};
+
+// Light space AABB of every cascade interval before padding and snapping.
+struct CascadeLightSpaceBounds
+{
+	DirectX::XMVECTOR m_vMin[MAX_CASCADES];
+	DirectX::XMVECTOR m_vMax[MAX_CASCADES];
+	float m_fFrustumDiagonal[MAX_CASCADES]; // Length of the diagonal of the interval,used by FIT_TO_SCENE
+};
+
+// Guard band the far cascades are fitted with while they are amortized,see CascadeFitParams::m_iFarCascadeGuardTexels.
+// The tile keeps its length,so this costs 2 * 64 texels of resolution out of the tile's length.
+#define CASCADE_FAR_GUARD_TEXELS 64
+
+// How the far cascades share the shadow budget.Cascade 0 is rendered whenever it changed.
+enum CASCADE_UPDATE_SCHEDULE
+{
+	CASCADE_UPDATE_EVERY_FRAME, // every changed cascade is rendered
+	CASCADE_UPDATE_ROUND_ROBIN, // the changed far cascades take turns
+	CASCADE_UPDATE_BY_ERROR, // the far cascades whose tile is furthest from their fit go first
+};
+
+// What the cascades were last fitted and rendered with.When the cameras,the scene AABB and the settings
+// did not change the fit is skipped,and a cascade whose projection did not change keeps its atlas tile.
+struct CascadeCache
+{
+	bool m_bFitValid;
+	CascadeFitParams m_LastParams;
+	CascadeFitResult m_LastResult;
+	bool m_bTileValid[MAX_CASCADES]; // The atlas tile holds the depth rendered with the matrices below
+	DirectX::XMMATRIX m_matRenderedOrthoProj[MAX_CASCADES];
+	DirectX::XMMATRIX m_matRenderedShadowView[MAX_CASCADES];
+	FIT_NEAR_FAR m_eRenderedNearFarFit[MAX_CASCADES]; // Pancaking renders with a different rasterizer state
+	int m_iNextRoundRobinCascade; // First far cascade CASCADE_UPDATE_ROUND_ROBIN looks at
+	int m_iTileOriginX[MAX_CASCADES]; // Tile texel that texel (0,0) of m_matRenderedOrthoProj is stored at,see CascadeScroll
+	int m_iTileOriginY[MAX_CASCADES];
+};
+
+// How a cascade's tile is scrolled instead of rendered again.The tile is addressed toroidally:texel (x,y) of the
+// cascade's projection is stored at ((x + origin) mod size,(y + origin) mod size) of the tile,so moving the
+// projection by whole texels only leaves the strips that scrolled in to be rendered.
+struct CascadeScroll
+{
+	int m_iShiftX; // Texels the kept depth moved by in u,positive to the right
+	int m_iShiftY; // Texels the kept depth moved by in v,positive downwards
+	int m_iOriginX; // The tile origin after the scroll
+	int m_iOriginY;
+};
+
+// A rectangle of texels of a cascade's projection,right and bottom are exclusive.
+struct CascadeTexelRect
+{
+	int m_iLeft;
+	int m_iTop;
+	int m_iRight;
+	int m_iBottom;
+};
+
+// What SelectShadowBudgetConfig may spend and what it aims for.
+struct ShadowBudgetParams
+{
+	long long m_iBudgetBytes; // For the shadow map,and its static layer copy if m_bStaticLayer
+	float m_fTargetTexelsPerPixel; // Density the worst cascade should reach,see CascadeTexelDensity
+	int m_iScreenHeight;
+	int m_nMaxCascadeCount;
+	int m_iMinLength; // The near tile lengths tried are the powers of two from m_iMinLength to m_iMaxLength
+	int m_iMaxLength;
+	int m_iMaxTextureLength; // Cascades side by side wider than this are stored in a texture array,0 always uses one
+	bool m_bHalvingLengths; // The far cascades get the tile lengths of AtlasPacking::GetHalvingCascadeLengths
+	bool m_bStaticLayer; // The shadow map is allocated twice,see CascadedShadowsManager::SetDynamicCaster
+};
+
+// The shadow map SelectShadowBudgetConfig chose.
+struct ShadowBudgetChoice
+{
+	int m_nCascadeCount;
+	int m_iLengthOfShadowBufferSquare;
+	int m_iCascadeLengthOfShadowBuffer[MAX_CASCADES]; // 0 where the cascade takes m_iLengthOfShadowBufferSquare
+	int m_iBytesPerTexel; // 4 for 32 bit depth,2 for 16 bit depth
+	long long m_iBytes; // Everything the choice allocates,the static layer included
+	float m_fMinTexelsPerPixel;
+	bool m_bMeetsTarget;
+	bool m_bFitsBudget; // false only if not even the smallest shadow map fits,then that is the choice
+	int m_nCandidateCount; // Shadow maps that were weighed
+};
+
+namespace CascadeFitting
+{
+	// Returns the tile length of a cascade,see CascadeFitParams::m_iCascadeLengthOfShadowBuffer.
+	int GetCascadeLengthOfShadowBuffer(const CascadeFitParams& params, int iCascadeIndex);
+
+	// Computes the orthographic projection of every cascade.This is the whole of InitPerFrame minus the D3D work.
+	void FitCascades(const CascadeFitParams& params, CascadeFitResult* pResult);
+
+	// Computes the corner quads of all partition planes.The corners of a plane are its 4 corner directions
+	// scaled by its depth,so with one combined view to light matrix every light space corner is a single
+	// multiply-add.The quad bounds are reduced for 4 planes at a time in SIMD lanes.
+	void BuildFrustumSlices(const CascadeFitParams& params, DirectX::CXMMATRIX matViewToLight, CascadeFrustumSlices* pSlices);
+
+	// Returns the view space depth of the near plane of cascade 0 followed by the far plane of every cascade
+	// for the current split mode,m_nUsingCascadeLevelsCount + 1 values.
+	void ComputeSplitDepths(const CascadeFitParams& params, float* pSplitDepths);
+
+	// Reduces a depth buffer written with matViewerCameraProj to the view space depth range of its pixels.
+	// Cleared pixels (depth 1) are skipped.Returns false if no pixel was written,then nothing is written.
+	bool ReduceDepthBounds(const float* pDepth, int iWidth, int iHeight, int iRowPitchInFloats, DirectX::CXMMATRIX matViewerCameraProj,
+		float* pMinDepthInView, float* pMaxDepthInView);
+
+	// Converts a depth buffer value back to view space depth.
+	float DepthBufferToViewDepth(DirectX::CXMMATRIX matViewerCameraProj, float fDepth);
+
+	// Compares the shadow texel size of each cascade with the size of a screen pixel inside its interval.
+	// pOrthoProj are the projections the cascades are sampled with,iScreenHeight is the back buffer height.
+	void ComputeTexelDensity(const CascadeFitParams& params, const DirectX::XMMATRIX* pOrthoProj, const CascadeFrustumSlices& slices,
+		int iScreenHeight, CascadeTexelDensity* pDensity);
+
+	// Returns the slices that bound a cascade for the current fit mode.
+	void GetCascadeSliceRange(const CascadeFitParams& params, int iCascadeIndex, int& iBeginSlice, int& iEndSlice);
+
+	// Combines the slice bounds into the light space bounds of every cascade.
+	void ComputeLightSpaceCascadeBounds(const CascadeFitParams& params, const CascadeFrustumSlices& slices, CascadeLightSpaceBounds* pBounds);
+
+	// Returns the 8 corners of a cascade in camera view space,the begin quad followed by the end quad.
+	void GetCascadeCornersInView(const CascadeFrustumSlices& slices, int iBeginSlice, int iEndSlice, DirectX::XMVECTOR* pCornerPointsInView);
+
+	// Returns the right/top and left/bottom slopes of the view frustum,z and w are 1.
+	void ComputeFrustumSlopes(DirectX::CXMMATRIX matProjection, DirectX::XMVECTOR* pRightTopSlope, DirectX::XMVECTOR* pLeftBottomSlope);
+
+	// Converts the center and extends of an AABB into 8 points.
+	void CreateAABBPoints(DirectX::XMVECTOR* pAABBPoints, DirectX::FXMVECTOR vCenter, DirectX::FXMVECTOR vExtends);
+
+	// Snaps the ortho bounds to texel sized increments so that moving the camera does not make the shadow jitter.
+	void SnapOrthoBoundsToTexels(DirectX::XMVECTOR& vOrthographicMin, DirectX::XMVECTOR& vOrthographicMax,
+		DirectX::FXMVECTOR vViewSpaceUnitsPerTexel);
+
+	// Computes the near and far plane by intersecting the ortho projection with the scene AABB (given in light space).
+	void ComputeNearAndFarInViewSpace(float& fNearPlane, float& fFarPlane,
+		DirectX::FXMVECTOR vOrthographicMin, DirectX::FXMVECTOR vOrthographicMax, const DirectX::XMVECTOR* pPointInView);
+
+	// Same result as ComputeNearAndFarInViewSpace for nCascadeCount ortho bounds at once,solved from the box
+	// vertices,edges and the bound's corner lines instead of clipping triangles.pPointInView must be the
+	// CreateAABBPoints box moved to light space.Returns false for a degenerate box,then nothing is written.
+	bool ComputeNearAndFarAnalytic(int nCascadeCount, const DirectX::XMVECTOR* pOrthographicMin, const DirectX::XMVECTOR* pOrthographicMax,
+		const DirectX::XMVECTOR* pPointInView, float* pNearPlane, float* pFarPlane);
+
+	// Builds a binary hierarchy over nBoxCount world space boxes by splitting the longest axis of their centers
+	// at the median,with up to SCENE_BOUNDS_LEAF_SIZE boxes per leaf.
+	void BuildSceneBoundsHierarchy(const DirectX::XMFLOAT3* pBoxMin, const DirectX::XMFLOAT3* pBoxMax, int nBoxCount,
+		SceneBoundsHierarchy* pHierarchy);
+
+	// Gives the boxes of a hierarchy the bounds in pBoxMin and pBoxMax,indexed like the boxes it was built from,
+	// and grows or shrinks every node to its boxes again.The split is kept,so casters that move after load stay
+	// culled correctly,only less tightly the further they move.
+	void RefitSceneBoundsHierarchy(const DirectX::XMFLOAT3* pBoxMin, const DirectX::XMFLOAT3* pBoxMax, SceneBoundsHierarchy* pHierarchy);
+
+	// Computes the near and far plane of every cascade from the boxes whose light space bounds overlap its ortho
+	// bounds.FIT_NEAR_FAR_ONLY_SCENE_AABB takes the light space z range of those boxes,the other modes intersect
+	// each box with the ortho bounds.A cascade without a box gets FLT_MAX/-FLT_MAX.Returns the boxes tested.
+	int ComputeNearAndFarFromSceneBounds(const SceneBoundsHierarchy& hierarchy, DirectX::CXMMATRIX matLightView, FIT_NEAR_FAR eNearFarFit,
+		bool bAnalyticNearFar, int nCascadeCount, const DirectX::XMVECTOR* pOrthographicMin, const DirectX::XMVECTOR* pOrthographicMax,
+		float* pNearPlane, float* pFarPlane);
+
+	// Sets a bit per cascade in pBoxCascadeMasks for every box that can cast a shadow into that cascade's tile,
+	// indexed like the boxes BuildSceneBoundsHierarchy was given.A box is kept when its light space bounds overlap
+	// the ortho rectangle of pOrthoProj in x and y and start in front of its far plane.The ortho box is extended
+	// toward the light,boxes between the light and the near plane still shadow the tile when they are pancaked.
+	// Returns the nodes visited.
+	int CullCasters(const SceneBoundsHierarchy& hierarchy, DirectX::CXMMATRIX matLightView, int nCascadeCount,
+		const DirectX::XMMATRIX* pOrthoProj, unsigned int* pBoxCascadeMasks);
+
+	// Clears the cascade bits in pBoxCascadeMasks of the boxes whose light space bounds are narrower than fMinTexels
+	// texels of that cascade's pLengthOfShadowBuffer[cascade] tile in x and in y.Such a caster covers at most
+	// ceil(fMinTexels) texel centers per axis.Adds the boxes cleared from each cascade to pnCulledPerCascade and
+	// returns how many bits were cleared.
+	int CullSmallCasters(const SceneBoundsHierarchy& hierarchy, DirectX::CXMMATRIX matLightView, int nCascadeCount,
+		const DirectX::XMMATRIX* pOrthoProj, const int* pLengthOfShadowBuffer, float fMinTexels, unsigned int* pBoxCascadeMasks,
+		int* pnCulledPerCascade);
+
+	// Returns true if both would produce the same fit.
+	bool FitParamsEqual(const CascadeFitParams& a, const CascadeFitParams& b);
+
+	// Forgets the fit and all tiles,the next frame refits and renders every cascade.
+	void InvalidateCascadeCache(CascadeCache* pCache);
+
+	// Forgets the tiles only,for example when the shadow texture was recreated or the casters moved.
+	void InvalidateCascadeTiles(CascadeCache* pCache);
+
+	// Runs FitCascades into pCache->m_LastResult unless params equal the cached ones.Returns true if it refitted.
+	bool FitCascadesCached(const CascadeFitParams& params, CascadeCache* pCache);
+
+	// Returns a bit per cascade whose tile has to be rendered for the cached fit.
+	unsigned int GetDirtyCascadeMask(const CascadeFitParams& params, const CascadeCache& cache);
+
+	// Picks the cascades to render this frame out of the dirty ones.A cascade is always rendered when it is
+	// cascade 0,when its tile is invalid,when the light moved,when its tile no longer covers its frustum
+	// interval widened by m_iPCFBlurSize texels or when ComputeTileError exceeds m_iFarCascadeGuardTexels
+	// (CASCADE_FAR_GUARD_TEXELS when that is 0).Of the other dirty cascades at most iFarCascadeUpdatesPerFrame are picked by eSchedule.
+	// Skipped cascades keep sampling their tile with m_matRenderedOrthoProj.
+	unsigned int ScheduleCascadeUpdates(const CascadeFitParams& params, CASCADE_UPDATE_SCHEDULE eSchedule,
+		int iFarCascadeUpdatesPerFrame, CascadeCache* pCache);
+
+	// How far a tile rendered with matRenderedOrthoProj is from matOrthoProj,in texels of a
+	// iLengthOfShadowBufferSquare map.Depth range changes count one texel per 1/size of the range.
+	float ComputeTileError(DirectX::CXMMATRIX matOrthoProj, DirectX::CXMMATRIX matRenderedOrthoProj, int iLengthOfShadowBufferSquare);
+
+	// Records that the cascades in uCascadeMask were rendered with the cached fit.Their tiles start at origin 0 again.
+	void MarkCascadesRendered(const CascadeFitParams& params, unsigned int uCascadeMask, CascadeCache* pCache);
+
+	// Picks the cascades of uUpdateMask whose tile can be scrolled instead of rendered again and writes their scroll
+	// to pScrolls.Only texel snapped projections scroll:the shadow view,the near/far fit and the texel size must be
+	// the ones the tile was rendered with,the projection must have moved by whole texels and its near and far plane
+	// must lie inside the rendered ones.A scrolled cascade takes over the rendered depth range in
+	// pCache->m_LastResult,so that the kept texels and the new strips hold the same depth.
+	unsigned int ScheduleCascadeScrolls(const CascadeFitParams& params, unsigned int uUpdateMask, CascadeCache* pCache,
+		CascadeScroll* pScrolls);
+
+	// Writes the strips a scroll exposes,in texels of the new projection,and returns how many there are (0 to 2).
+	// Together with the kept texels they cover the tile once.
+	int GetScrollStrips(const CascadeScroll& scroll, int iLengthOfShadowBufferSquare, CascadeTexelRect* pStrips);
+
+	// Returns the off center projection of a rectangle of texels of matOrthoProj,with the same depth range,
+	// to cull the casters of a strip.
+	DirectX::XMMATRIX GetTexelRectOrthoProj(DirectX::CXMMATRIX matOrthoProj, const CascadeTexelRect& rect, int iLengthOfShadowBufferSquare);
+
+	// Records that the cascades in uCascadeMask were scrolled by pScrolls.
+	void MarkCascadesScrolled(const CascadeFitParams& params, unsigned int uCascadeMask, const CascadeScroll* pScrolls, CascadeCache* pCache);
+
+	// Hands the cascades in uCascadeMask the next slots of a constant ring of uRingSlotCount slots,in cascade order,
+	// and writes them to puSlots.*puNextSlot is the first free slot,uRingSlotCount for a ring not written yet.Returns
+	// true when the slots would run past the end,then the ring starts over at slot 0 and has to be mapped with DISCARD.
+	bool AllocateCascadeRingSlots(unsigned int uCascadeMask, int nCascadeCount, unsigned int uRingSlotCount, unsigned int* puNextSlot,
+		unsigned int* puSlots);
+
+	// Returns the bytes of the shadow map of nCascadeCount tiles of pLengths[i] texels:packed side by side into
+	// an atlas as tall as the longest tile,or slices as large as the longest tile once the atlas would be wider
+	// than iMaxTextureLength.
+	long long GetShadowMapBytes(const int* pLengths, int nCascadeCount, int iBytesPerTexel, int iMaxTextureLength);
+
+	// Picks the cascade count,near tile length and depth format of the shadow map for a memory budget.Every count
+	// and length is fitted from the cameras in params with practical splits (the manual partitions only exist for
+	// the count they were set for) and weighed by the texel density of its worst cascade on iScreenHeight lines.
+	// Of the shadow maps inside the budget that reach the target the one with 32 bit depth and the fewest bytes
+	// wins,16 bit depth only when no 32 bit map reaches it.If none reaches it the densest one inside the budget
+	// wins.The density depends on the view,so the choice is made again when the screen or the scene changes,
+	// not every frame.A budget without a positive length range or a cascade gets a zeroed choice,m_nCascadeCount 0.
+	void SelectShadowBudgetConfig(const CascadeFitParams& params, const ShadowBudgetParams& budget, ShadowBudgetChoice* pChoice);
+}
@@ -10,6 +10,8 @@
 #include "ShadowSampleMisc.h"
 #include "CascadedShadowsManager.h"
 #include "CascadedShadowMaps11.h"
+#include "JobPool.h"
+#include "GpuMemoryTracker.h"
 #include <commdlg.h>
 #include "WaitDlg.h"
 
@@ -24,7 +26,10 @@ WCHAR szWindowClass[MAX_LOADSTRING];            // the main window class name
 
 
 
+// Declared first so it outlives everything that forgets its objects in it on destruction.
+GpuMemoryTracker g_GpuMemoryTracker;
 CascadedShadowsManager g_CascadedShadow;
+JobPool g_JobPool; // Worker threads shared by everything that records in parallel
 
 CDXUTDialogResourceManager g_DialogReourceManager; // Manager for shared resources of dialogs
 CFirstPersonCamera g_ViewerCamera;
@@ -57,16 +62,26 @@ CDXUTComboBox* g_SceneSelectComboBox;
 CDXUTComboBox* g_LightViewFrustumFitComboBox;
 CDXUTComboBox* g_FitToNearFarCombo;
 CDXUTComboBox* g_PixelToCascadeSelectionModeCombo;//decided by shadow map or cascade interval
+CDXUTComboBox* g_CascadeUpdateScheduleCombo;
+CDXUTComboBox* g_CascadeSplitModeCombo;
 CD3DSettingsDlg g_D3DSettingDlg;//Device setting dialog
 CDXUTDialog g_HUD; //manages the 3D
 CDXUTTextHelper* g_pTextHelper = nullptr;
 
+// The scene depth buffer,readable so that the cascades can be fitted to the depth range of the visible pixels.
+ID3D11Texture2D* g_pSceneDepthTexture = nullptr;
+ID3D11DepthStencilView* g_pSceneDepthDSV = nullptr;
+ID3D11ShaderResourceView* g_pSceneDepthSRV = nullptr;
 
 bool g_bShowHelp = FALSE; // if true,it renders the UI control text
 bool g_bVisualizeCascades = FALSE;
 bool g_bMoveLightTexelSize = TRUE;
 FLOAT g_fApsectRatio = 1.0f;
 
+// The shadow map is picked for the memory budget after the next fit,see ApplyShadowBudget.
+bool g_bSelectShadowBudget = false;
+ShadowBudgetChoice g_ShadowBudgetChoice;
+
 //-----------
 // UI control IDs
 //-----------------
@@ -116,6 +131,33 @@ enum IDC_ID
 
 	IDC_BLEND_BETWEEN_MAPS_CHECK = 36,
 	IDC_BLEND_MAPS_SLIDER = 37,
+
+	IDC_ANALYTIC_NEAR_FAR = 38,
+	IDC_CACHE_CASCADES = 39,
+	IDC_CASCADE_UPDATE_SCHEDULE = 40,
+	IDC_CASCADE_SPLIT_MODE = 41,
+	IDC_SPLIT_LAMBDA = 42,
+	IDC_SPLIT_LAMBDA_TEXT = 43,
+	IDC_FIT_TO_DEPTH_BOUNDS = 44,
+	IDC_NEAR_FAR_FROM_MESH_BOUNDS = 45,
+	IDC_CULL_SHADOW_CASTERS = 46,
+	IDC_SINGLE_PASS_SHADOWS = 47,
+	IDC_MULTITHREADED_SHADOWS = 48,
+	IDC_SCROLL_CASCADES = 49,
+	IDC_POSITION_ONLY_CASTERS = 50,
+	IDC_CASTER_LODS = 51,
+	IDC_CASTER_LOD_TEXELS = 52,
+	IDC_CASTER_LOD_TEXELS_TEXT = 53,
+	IDC_MIN_CASTER_TEXELS = 54,
+	IDC_MIN_CASTER_TEXELS_TEXT = 55,
+	IDC_CASCADE_TEXTURE_ARRAY = 56,
+	IDC_HALVING_CASCADE_LENGTHS = 57,
+	IDC_SHADOW_BUDGET = 58,
+	IDC_SHADOW_BUDGET_MB = 59,
+	IDC_SHADOW_BUDGET_MB_TEXT = 60,
+	IDC_SHADOW_BUDGET_TARGET = 61,
+	IDC_SHADOW_BUDGET_TARGET_TEXT = 62,
+	IDC_DUMP_GPU_MEMORY = 63,
 };
 
 //--------------
@@ -126,6 +168,7 @@ void CALLBACK OnFrameMove(double fTime, FLOAT fElapsedTime, void* pUserContext);
 LRESULT CALLBACK MsgProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam, bool* pbNoFurtherProcessing, void* pUserContext);
 void CALLBACK OnKeyboard(UINT nChar, bool bKeyDown, bool AltDown, void* pUserContext);
 void CALLBACK OnGUIEvent(UINT EVENT, INT nControlID, CDXUTControl* pControl, void* pUserContext);
+void CALLBACK OnGUIResource(ID3D11Resource* pResource, bool bCreated, const char* szName, void* pUserContext);
 bool CALLBACK IsD3D11DeviceAcceptable(const CD3D11EnumAdapterInfo *AdpaterInfo, UINT Output, const CD3D11EnumDeviceInfo* DeviceInfo,
 	DXGI_FORMAT BackBufferFormat, bool bWindowed, void* pUserContext);
 HRESULT CALLBACK OnD3D11CreateDevice(ID3D11Device*pD3DDevice, const DXGI_SURFACE_DESC* pBackBufferSurfaceDesc, void* pUserContext);
@@ -140,6 +183,10 @@ void RenderText();
 HRESULT DestroyCommonModules();
 HRESULT CreateCommonModule(ID3D11Device* pD3DDevice);
 void UpdateViewerCameraNearFar();
+void ClampShadowBufferSize();
+void SetBufferSizeText(INT iLength);
+void UpdateCascadeLengths();
+void ApplyShadowBudget();
 
 
 
@@ -171,6 +218,8 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
 	DXUTSetCallbackD3D11FrameRender(OnD3D11FrameRender);
 	DXUTSetCallbackD3D11SwapChainReleasing(OnD3D11ReleasingSwapChain);
 	DXUTSetCallbackD3D11DeviceDestroyed(OnD3D11DestroyDevice);
+	DXUTSetCallbackGUIResource(OnGUIResource);
+	g_JobPool.Start(0);
 	InitApp();
 
 	DXUTInit(true, true, nullptr);//Parse the command line ,show messageBoxes on error,no extra command line params
@@ -182,6 +231,8 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
 
 	DXUTMainLoop();
 
+	g_JobPool.Stop();
+
     return DXUTGetExitCode();
 }
 
@@ -268,6 +319,9 @@ void CALLBACK OnGUIEvent(UINT EVENT, INT nControlID, CDXUTControl * pControl, vo
 	case IDC_CHANGE_DEVICE:
 		g_D3DSettingDlg.SetActive(!g_D3DSettingDlg.IsActive());
 		break;
+	case IDC_DUMP_GPU_MEMORY:
+		OutputDebugStringA(g_GpuMemoryTracker.GetReport(true).c_str());
+		break;
 	case IDC_TOGGLE_VISUALIZE_CASCADES:
 		g_bVisualizeCascades = g_HUD.GetCheckBox(IDC_TOGGLE_VISUALIZE_CASCADES)->GetChecked();
 		break;
@@ -276,24 +330,61 @@ void CALLBACK OnGUIEvent(UINT EVENT, INT nControlID, CDXUTControl * pControl, vo
 		g_CascadeConfig.m_ShadowBufferFormat = (SHADOW_TEXTURE_FORMAT)PtrToUlong(g_DepthBufferFormatComboBox->GetSelectedData());
 	}
 		break;
+	case IDC_CASCADE_TEXTURE_ARRAY:
+		g_CascadeConfig.m_bCascadeTextureArray = g_HUD.GetCheckBox(IDC_CASCADE_TEXTURE_ARRAY)->GetChecked();
+		ClampShadowBufferSize();
+		UpdateCascadeLengths();
+		break;
+	case IDC_HALVING_CASCADE_LENGTHS:
+		UpdateCascadeLengths();
+		g_bSelectShadowBudget = g_HUD.GetCheckBox(IDC_SHADOW_BUDGET)->GetChecked();
+		break;
+	case IDC_SHADOW_BUDGET:
+		g_bSelectShadowBudget = g_HUD.GetCheckBox(IDC_SHADOW_BUDGET)->GetChecked();
+		break;
+	case IDC_SHADOW_BUDGET_MB:
+	{
+		WCHAR desc[256];
+		swprintf_s(desc, L"Budget: %d MB", 4 * g_HUD.GetSlider(IDC_SHADOW_BUDGET_MB)->GetValue());
+		g_HUD.GetStatic(IDC_SHADOW_BUDGET_MB_TEXT)->SetText(desc);
+		if (EVENT == EVENT_SLIDER_VALUE_CHANGED_UP)
+		{
+			g_bSelectShadowBudget = g_HUD.GetCheckBox(IDC_SHADOW_BUDGET)->GetChecked();
+		}
+	}
+		break;
+	case IDC_SHADOW_BUDGET_MB_TEXT:
+		break;
+	case IDC_SHADOW_BUDGET_TARGET:
+	{
+		WCHAR desc[256];
+		swprintf_s(desc, L"Target: %0.3f", g_HUD.GetSlider(IDC_SHADOW_BUDGET_TARGET)->GetValue()*0.001f);
+		g_HUD.GetStatic(IDC_SHADOW_BUDGET_TARGET_TEXT)->SetText(desc);
+		if (EVENT == EVENT_SLIDER_VALUE_CHANGED_UP)
+		{
+			g_bSelectShadowBudget = g_HUD.GetCheckBox(IDC_SHADOW_BUDGET)->GetChecked();
+		}
+	}
+		break;
+	case IDC_SHADOW_BUDGET_TARGET_TEXT:
+		break;
 	case IDC_BUFFER_SIZE:
 	{
 		INT value = 32 * g_HUD.GetSlider(nControlID)->GetValue();
-		INT max = 8192 / g_CascadeConfig.m_nUsingCascadeLevelsCount;
+		INT max = g_CascadeConfig.m_bCascadeTextureArray ? 4096 : 8192 / g_CascadeConfig.m_nUsingCascadeLevelsCount;
 		if (value > max)
 		{
 			value = max;
 			g_HUD.GetSlider(nControlID)->SetValue(value / 32);
 		}
 
-		WCHAR desc[256];
-		swprintf_s(desc, L"Length of Texture square: %d", value);
-		g_HUD.GetStatic(IDC_BUFFER_SIZE_TEXT)->SetText(desc);
+		SetBufferSizeText(value);
 
 		//Only tell the app to recreate buffers once the user is through moving slider.
 		if (EVENT == EVENT_SLIDER_VALUE_CHANGED_UP)
 		{
 			g_CascadeConfig.m_iLengthOfShadowBufferSquare = value;
+			UpdateCascadeLengths();
 		}
 	}
 		break;
@@ -328,6 +419,7 @@ void CALLBACK OnGUIEvent(UINT EVENT, INT nControlID, CDXUTControl * pControl, vo
 		DestroyCommonModules();
 		CreateCommonModule(DXUTGetD3D11Device());
 		UpdateViewerCameraNearFar();
+		g_bSelectShadowBudget = g_HUD.GetCheckBox(IDC_SHADOW_BUDGET)->GetChecked();
 
 	}
 		break;
@@ -345,19 +437,8 @@ void CALLBACK OnGUIEvent(UINT EVENT, INT nControlID, CDXUTControl * pControl, vo
 			g_HUD.GetStatic(IDC_CASCADE_LEVEL1TEXT + i)->SetVisible(false);
 			g_HUD.GetSlider(IDC_CASCADE_LEVEL1 + i)->SetVisible(false);
 		}
-		INT value = 32 * g_HUD.GetSlider(IDC_BUFFER_SIZE)->GetValue();
-		INT max = 8192 / g_CascadeConfig.m_nUsingCascadeLevelsCount;
-		if (value>max)
-		{
-			value = max;
-
-			WCHAR desc[256];
-
-			swprintf_s(desc, L"Texture Size: %d", value);
-			g_HUD.GetStatic(IDC_BUFFER_SIZE_TEXT)->SetText(desc);
-			g_HUD.GetSlider(IDC_BUFFER_SIZE)->SetValue(value / 32);
-			g_CascadeConfig.m_iLengthOfShadowBufferSquare = value;
-		}
+		ClampShadowBufferSize();
+		UpdateCascadeLengths();
 
 		// update the selected camera based on these changes.
 		INT curSelectedCameraIndex = g_CameraSelectComboBox->GetSelectedIndex();
@@ -544,6 +625,16 @@ void CALLBACK OnGUIEvent(UINT EVENT, INT nControlID, CDXUTControl * pControl, vo
 		break;
 	case IDC_PCF_OFFSET_SIZE_TEXT:
 		break;
+	case IDC_MIN_CASTER_TEXELS:
+	{
+		g_CascadedShadow.m_fMinCasterTexels = g_HUD.GetSlider(IDC_MIN_CASTER_TEXELS)->GetValue()*0.1f;
+		WCHAR desc[256];
+		swprintf_s(desc, L"Min Caster: %0.1f", g_CascadedShadow.m_fMinCasterTexels);
+		g_HUD.GetStatic(IDC_MIN_CASTER_TEXELS_TEXT)->SetText(desc);
+	}
+		break;
+	case IDC_MIN_CASTER_TEXELS_TEXT:
+		break;
 	case IDC_BLEND_BETWEEN_MAPS_CHECK:
 	{
 		g_CascadedShadow.m_bIsBlurBetweenCascades = g_HUD.GetCheckBox(IDC_BLEND_BETWEEN_MAPS_CHECK)->GetChecked();
@@ -557,6 +648,62 @@ void CALLBACK OnGUIEvent(UINT EVENT, INT nControlID, CDXUTControl * pControl, vo
 		g_HUD.GetCheckBox(IDC_BLEND_BETWEEN_MAPS_CHECK)->SetText(desc);
 	}
 		break;
+	case IDC_ANALYTIC_NEAR_FAR:
+		g_CascadedShadow.m_bAnalyticNearFar = g_HUD.GetCheckBox(IDC_ANALYTIC_NEAR_FAR)->GetChecked();
+		break;
+	case IDC_NEAR_FAR_FROM_MESH_BOUNDS:
+		g_CascadedShadow.m_bNearFarFromMeshBounds = g_HUD.GetCheckBox(IDC_NEAR_FAR_FROM_MESH_BOUNDS)->GetChecked();
+		break;
+	case IDC_CULL_SHADOW_CASTERS:
+		g_CascadedShadow.m_bCullShadowCasters = g_HUD.GetCheckBox(IDC_CULL_SHADOW_CASTERS)->GetChecked();
+		break;
+	case IDC_SINGLE_PASS_SHADOWS:
+		g_CascadedShadow.m_bSinglePassShadows = g_HUD.GetCheckBox(IDC_SINGLE_PASS_SHADOWS)->GetChecked();
+		break;
+	case IDC_MULTITHREADED_SHADOWS:
+		g_CascadedShadow.m_bMultithreadedShadows = g_HUD.GetCheckBox(IDC_MULTITHREADED_SHADOWS)->GetChecked();
+		break;
+	case IDC_CACHE_CASCADES:
+		g_CascadedShadow.m_bCacheCascades = g_HUD.GetCheckBox(IDC_CACHE_CASCADES)->GetChecked();
+		break;
+	case IDC_SCROLL_CASCADES:
+		g_CascadedShadow.m_bScrollCascades = g_HUD.GetCheckBox(IDC_SCROLL_CASCADES)->GetChecked();
+		break;
+	case IDC_POSITION_ONLY_CASTERS:
+		g_CascadedShadow.m_bPositionOnlyCasters = g_HUD.GetCheckBox(IDC_POSITION_ONLY_CASTERS)->GetChecked();
+		break;
+	case IDC_CASTER_LODS:
+		g_CascadedShadow.m_bCasterLods = g_HUD.GetCheckBox(IDC_CASTER_LODS)->GetChecked();
+		break;
+	case IDC_CASTER_LOD_TEXELS:
+	{
+		g_CascadedShadow.m_fCasterLodTexels = g_HUD.GetSlider(IDC_CASTER_LOD_TEXELS)->GetValue()*0.1f;
+		WCHAR desc[256];
+		swprintf_s(desc, L"LOD Texels: %0.1f", g_CascadedShadow.m_fCasterLodTexels);
+		g_HUD.GetStatic(IDC_CASTER_LOD_TEXELS_TEXT)->SetText(desc);
+	}
+		break;
+	case IDC_CASTER_LOD_TEXELS_TEXT:
+		break;
+	case IDC_CASCADE_UPDATE_SCHEDULE:
+		g_CascadedShadow.m_eCascadeUpdateSchedule = (CASCADE_UPDATE_SCHEDULE)PtrToUlong(g_CascadeUpdateScheduleCombo->GetSelectedData());
+		break;
+	case IDC_CASCADE_SPLIT_MODE:
+		g_CascadedShadow.m_eCascadeSplitMode = (CASCADE_SPLIT_MODE)PtrToUlong(g_CascadeSplitModeCombo->GetSelectedData());
+		break;
+	case IDC_SPLIT_LAMBDA:
+	{
+		g_CascadedShadow.m_fCascadeSplitLambda = g_HUD.GetSlider(IDC_SPLIT_LAMBDA)->GetValue()*0.01f;
+		WCHAR desc[256];
+		swprintf_s(desc, L"Split Lambda: %0.2f", g_CascadedShadow.m_fCascadeSplitLambda);
+		g_HUD.GetStatic(IDC_SPLIT_LAMBDA_TEXT)->SetText(desc);
+	}
+		break;
+	case IDC_SPLIT_LAMBDA_TEXT:
+		break;
+	case IDC_FIT_TO_DEPTH_BOUNDS:
+		g_CascadedShadow.m_bFitToDepthBounds = g_HUD.GetCheckBox(IDC_FIT_TO_DEPTH_BOUNDS)->GetChecked();
+		break;
 
 	default:
 		break;
@@ -576,8 +723,13 @@ bool CALLBACK IsD3D11DeviceAcceptable(const CD3D11EnumAdapterInfo * AdpaterInfo,
 HRESULT CALLBACK OnD3D11CreateDevice(ID3D11Device * pD3DDevice, const DXGI_SURFACE_DESC * pBackBufferSurfaceDesc, void * pUserContext)
 {
 	HRESULT hr = S_OK;
+	// The shadow pass only reads the positions.
+	g_MeshPowerPlant.SetCreatePositionStreams(true);
+	g_MeshTestScene.SetCreatePositionStreams(true);
 	V_RETURN(g_MeshPowerPlant.Create(pD3DDevice, L"powerplant\\powerplant.sdkmesh"));
 	V_RETURN(g_MeshTestScene.Create(pD3DDevice, L"ShadowColumns\\testscene.sdkmesh"));
+	TrackMeshMemory(&g_GpuMemoryTracker, &g_MeshPowerPlant, true);
+	TrackMeshMemory(&g_GpuMemoryTracker, &g_MeshTestScene, true);
 
 	g_pSelectedMesh = &g_MeshPowerPlant;
 
@@ -595,19 +747,64 @@ HRESULT CALLBACK OnD3D11ResizedSwapChain(ID3D11Device * pD3DDevice, IDXGISwapCha
 
 	UpdateViewerCameraNearFar();
 
+	// The texel density the budget aims for depends on the screen height.
+	g_bSelectShadowBudget = g_HUD.GetCheckBox(IDC_SHADOW_BUDGET)->GetChecked();
+
 	g_HUD.SetLocation(pBackBufferSurfaceDesc->Width - 170, 0);
 	g_HUD.SetSize(170, 170);
 
+	// Same format as the DXUT depth buffer,but typeless so the depth bounds reduction can read it.
+	// The reduction reads single sampled depth only,with MSAA the DXUT depth buffer is used and the cascades
+	// cover the camera range.
+	if (pBackBufferSurfaceDesc->SampleDesc.Count == 1)
+	{
+		D3D11_TEXTURE2D_DESC depthDesc;
+		ZeroMemory(&depthDesc, sizeof(depthDesc));
+		depthDesc.Width = pBackBufferSurfaceDesc->Width;
+		depthDesc.Height = pBackBufferSurfaceDesc->Height;
+		depthDesc.MipLevels = 1;
+		depthDesc.ArraySize = 1;
+		depthDesc.Format = DXGI_FORMAT_R24G8_TYPELESS;
+		depthDesc.SampleDesc.Count = 1;
+		depthDesc.Usage = D3D11_USAGE_DEFAULT;
+		depthDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
+		V_RETURN(pD3DDevice->CreateTexture2D(&depthDesc, nullptr, &g_pSceneDepthTexture));
+		DXUT_SetDebugName(g_pSceneDepthTexture, "Scene Depth");
+		g_GpuMemoryTracker.TrackResource(GPU_MEMORY_SCENE_TARGETS, g_pSceneDepthTexture, "Scene Depth");
+
+		D3D11_DEPTH_STENCIL_VIEW_DESC dsvDesc;
+		ZeroMemory(&dsvDesc, sizeof(dsvDesc));
+		dsvDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
+		dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+		V_RETURN(pD3DDevice->CreateDepthStencilView(g_pSceneDepthTexture, &dsvDesc, &g_pSceneDepthDSV));
+		DXUT_SetDebugName(g_pSceneDepthDSV, "Scene Depth DSV");
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+		ZeroMemory(&srvDesc, sizeof(srvDesc));
+		srvDesc.Format = DXGI_FORMAT_R24_UNORM_X8_TYPELESS;
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+		srvDesc.Texture2D.MipLevels = 1;
+		V_RETURN(pD3DDevice->CreateShaderResourceView(g_pSceneDepthTexture, &srvDesc, &g_pSceneDepthSRV));
+		DXUT_SetDebugName(g_pSceneDepthSRV, "Scene Depth SRV");
+	}
+
 	return S_OK;
 }
 
 void CALLBACK OnD3D11ReleasingSwapChain(void * pUserContext)
 {
 	g_DialogReourceManager.OnD3D11ReleasingSwapChain();
+
+	g_GpuMemoryTracker.Untrack(g_pSceneDepthTexture);
+	SAFE_RELEASE(g_pSceneDepthTexture);
+	SAFE_RELEASE(g_pSceneDepthDSV);
+	SAFE_RELEASE(g_pSceneDepthSRV);
 }
 
 void CALLBACK OnD3D11DestroyDevice(void * pUserContext)
 {
+	TrackMeshMemory(&g_GpuMemoryTracker, &g_MeshPowerPlant, false);
+	TrackMeshMemory(&g_GpuMemoryTracker, &g_MeshTestScene, false);
 	g_MeshPowerPlant.Destroy();
 	g_MeshTestScene.Destroy();
 	DestroyCommonModules();
@@ -623,11 +820,18 @@ void CALLBACK OnD3D11FrameRender(ID3D11Device * pD3DDevice, ID3D11DeviceContext
 
 	FLOAT ClearColor[4] = { 0.0f,0.25f,0.25f,0.55f };
 	ID3D11RenderTargetView* pRTV = DXUTGetD3D11RenderTargetView();
-	ID3D11DepthStencilView* pDSV = DXUTGetD3D11DepthStencilView();
+	ID3D11DepthStencilView* pDSV = g_pSceneDepthDSV ? g_pSceneDepthDSV : DXUTGetD3D11DepthStencilView();
 	pD3DImmediateContext->ClearRenderTargetView(pRTV, ClearColor);
 	pD3DImmediateContext->ClearDepthStencilView(pDSV, D3D11_CLEAR_DEPTH| D3D11_CLEAR_STENCIL, 1.0f, 0);
 	g_CascadedShadow.InitPerFrame(pD3DDevice, g_pSelectedMesh);
 
+	// The shadow map picked from this frame's fit is allocated by the next InitPerFrame.
+	if (g_bSelectShadowBudget)
+	{
+		ApplyShadowBudget();
+		g_bSelectShadowBudget = false;
+	}
+
 	g_CascadedShadow.RenderShadowForAllCascades(pD3DDevice, pD3DImmediateContext, g_pSelectedMesh);
 
 	D3D11_VIEWPORT vp;
@@ -639,6 +843,10 @@ void CALLBACK OnD3D11FrameRender(ID3D11Device * pD3DDevice, ID3D11DeviceContext
 	vp.TopLeftY = 0;
 
 	g_CascadedShadow.RenderScene(pD3DImmediateContext, pRTV, pDSV, g_pSelectedMesh, g_pActiveCamera, &vp, g_bVisualizeCascades);
+
+	// Only the viewer camera's depth says where the visible pixels are.
+	g_CascadedShadow.ReduceDepthBounds(pD3DImmediateContext, g_pActiveCamera == &g_ViewerCamera ? g_pSceneDepthSRV : nullptr,
+		DXUTGetDXGIBackBufferSurfaceDesc()->Width, DXUTGetDXGIBackBufferSurfaceDesc()->Height);
 	
 	pD3DImmediateContext->RSSetViewports(1, &vp);
 	pD3DImmediateContext->OMSetRenderTargets(1, &pRTV, pDSV);
@@ -691,21 +899,38 @@ void InitApp()
 	g_HUD.AddButton(IDC_TOGGLE_WARP, L"Toggle WARP (F3)", 0, iY += 26, 170, 23, VK_F3);
 	g_HUD.AddButton(IDC_CHANGE_DEVICE, L"Change device(F2)", 0, iY += 26, 170, 23, VK_F2);
 
+	// Writes every object the tracker holds to the debugger output.
+	g_HUD.AddButton(IDC_DUMP_GPU_MEMORY, L"Dump GPU Memory", 0, iY += 26, 170, 23);
+
 
 	g_HUD.AddComboBox(IDC_DEPTH_BUFFER_FORMAT, 0, iY += 26, 170, 23, VK_F10, false, &g_DepthBufferFormatComboBox);
 	g_DepthBufferFormatComboBox->AddItem(L"32 bit Buffer", UlongToPtr(CASCADE_DXGI_FORMAT_R32_TYPELESS));
 	g_DepthBufferFormatComboBox->AddItem(L"16 bit Buffer", UlongToPtr(CASCADE_DXGI_FORMAT_R16_TYPELESS));
 	g_DepthBufferFormatComboBox->AddItem(L"24 bit Buffer", UlongToPtr(CASCADE_DXGI_FORMAT_R24G8_TYPELESS));
 
+	// A texture array lifts the limit the width of one texture puts on the cascades' size.
+	g_HUD.AddCheckBox(IDC_CASCADE_TEXTURE_ARRAY, L"Cascade Texture Array", 0, iY += 26, 170, 23, false);
+	g_CascadeConfig.m_bCascadeTextureArray = g_HUD.GetCheckBox(IDC_CASCADE_TEXTURE_ARRAY)->GetChecked();
+
+	// The near cascade keeps the buffer size,the far ones are packed into the atlas at less of it.
+	g_HUD.AddCheckBox(IDC_HALVING_CASCADE_LENGTHS, L"Halve Far Cascades", 0, iY += 26, 170, 23, false);
+
+	// Picks the cascade count,buffer size and format for the memory budget and the density of the worst cascade.
+	g_HUD.AddCheckBox(IDC_SHADOW_BUDGET, L"Shadow Memory Budget", 0, iY += 26, 170, 23, false);
+	g_HUD.AddStatic(IDC_SHADOW_BUDGET_MB_TEXT, L"Budget: 32 MB", 0, iY += 16, 30, 10);
+	g_HUD.AddSlider(IDC_SHADOW_BUDGET_MB, 90, iY += 20, 64, 15, 1, 64, 8);
+	g_HUD.AddStatic(IDC_SHADOW_BUDGET_TARGET_TEXT, L"Target: 0.030", 0, iY += 16, 30, 10);
+	g_HUD.AddSlider(IDC_SHADOW_BUDGET_TARGET, 90, iY += 20, 64, 15, 1, 100, 30);
+
 	g_HUD.AddCheckBox(IDC_TOGGLE_VISUALIZE_CASCADES, L"Visualize Cascades", 0, iY += 26, 170, 23, g_bVisualizeCascades, VK_F8);
 
 	SHADOW_TEXTURE_FORMAT shadowTexureFormat = (SHADOW_TEXTURE_FORMAT)PtrToUlong(g_DepthBufferFormatComboBox->GetSelectedData());
 	g_CascadeConfig.m_ShadowBufferFormat = shadowTexureFormat;
 
 	WCHAR desc[256];
-	swprintf_s(desc, L"Per Shadow Buffer Size: %d", g_CascadeConfig.m_iLengthOfShadowBufferSquare);
 
-	g_HUD.AddStatic(IDC_BUFFER_SIZE_TEXT, desc, 0, iY + 26, 30, 10);
+	g_HUD.AddStatic(IDC_BUFFER_SIZE_TEXT, L"", 0, iY + 26, 30, 10);
+	SetBufferSizeText(g_CascadeConfig.m_iLengthOfShadowBufferSquare);
 	g_HUD.AddSlider(IDC_BUFFER_SIZE, 0, iY += 46, 128, 15, 1, 128, g_CascadeConfig.m_iLengthOfShadowBufferSquare / 32);
 
 	g_HUD.AddStatic(IDC_PCF_SIZETEXT, L"PCF Blur: ", 0, iY + 16, 30, 10);
@@ -715,6 +940,11 @@ void InitApp()
 	g_HUD.AddStatic(IDC_PCF_OFFSET_SIZE_TEXT, desc, 0, iY += 16, 30, 10);
 	g_HUD.AddSlider(IDC_PCF_OFFSET_SIZE, 115, iY += 20, 50, 15, 0, 50, (INT)g_CascadedShadow.m_fPCFShadowDepthBia*1000.0f);
 
+	// Casters narrower than this many texels are left out of a cascade,0 draws all of them.
+	swprintf_s(desc, L"Min Caster: %0.1f", g_CascadedShadow.m_fMinCasterTexels);
+	g_HUD.AddStatic(IDC_MIN_CASTER_TEXELS_TEXT, desc, 0, iY += 16, 30, 10);
+	g_HUD.AddSlider(IDC_MIN_CASTER_TEXELS, 115, iY += 20, 50, 15, 0, 40, (INT)(g_CascadedShadow.m_fMinCasterTexels*10.0f + 0.5f));
+
 
 
 
@@ -762,12 +992,56 @@ void InitApp()
 	
 	g_CascadedShadow.m_eSelectedNearFarFit = FIT_NEAR_FAR_SCENE_AABB_AND_ORTHO_BOUND;
 
+	g_HUD.AddCheckBox(IDC_ANALYTIC_NEAR_FAR, L"Analytic NearFar", 0, iY += 26, 170, 23, false);
+	g_CascadedShadow.m_bAnalyticNearFar = g_HUD.GetCheckBox(IDC_ANALYTIC_NEAR_FAR)->GetChecked();
+
+	g_HUD.AddCheckBox(IDC_NEAR_FAR_FROM_MESH_BOUNDS, L"Per Mesh NearFar", 0, iY += 26, 170, 23, false);
+	g_CascadedShadow.m_bNearFarFromMeshBounds = g_HUD.GetCheckBox(IDC_NEAR_FAR_FROM_MESH_BOUNDS)->GetChecked();
+	g_HUD.AddCheckBox(IDC_CULL_SHADOW_CASTERS, L"Cull Shadow Casters", 0, iY += 26, 170, 23, false);
+	g_CascadedShadow.m_bCullShadowCasters = g_HUD.GetCheckBox(IDC_CULL_SHADOW_CASTERS)->GetChecked();
+	g_HUD.AddCheckBox(IDC_SINGLE_PASS_SHADOWS, L"Single Pass Cascades", 0, iY += 26, 170, 23, false);
+	g_CascadedShadow.m_bSinglePassShadows = g_HUD.GetCheckBox(IDC_SINGLE_PASS_SHADOWS)->GetChecked();
+	g_HUD.AddCheckBox(IDC_MULTITHREADED_SHADOWS, L"Multithreaded Cascades", 0, iY += 26, 170, 23, false);
+	g_CascadedShadow.m_bMultithreadedShadows = g_HUD.GetCheckBox(IDC_MULTITHREADED_SHADOWS)->GetChecked();
+	g_CascadedShadow.SetJobPool(&g_JobPool);
+	g_HUD.AddCheckBox(IDC_CACHE_CASCADES, L"Cache Cascades", 0, iY += 26, 170, 23, false);
+	g_CascadedShadow.m_bCacheCascades = g_HUD.GetCheckBox(IDC_CACHE_CASCADES)->GetChecked();
+	// Only texel snapped cascades scroll,see "Fit Light to Texels".
+	g_HUD.AddCheckBox(IDC_SCROLL_CASCADES, L"Scroll Cascades", 0, iY += 26, 170, 23, false);
+	g_CascadedShadow.m_bScrollCascades = g_HUD.GetCheckBox(IDC_SCROLL_CASCADES)->GetChecked();
+	g_HUD.AddCheckBox(IDC_POSITION_ONLY_CASTERS, L"Position Only Casters", 0, iY += 26, 170, 23, false);
+	g_CascadedShadow.m_bPositionOnlyCasters = g_HUD.GetCheckBox(IDC_POSITION_ONLY_CASTERS)->GetChecked();
+	g_HUD.AddCheckBox(IDC_CASTER_LODS, L"Caster LODs", 0, iY += 26, 170, 23, false);
+	g_CascadedShadow.m_bCasterLods = g_HUD.GetCheckBox(IDC_CASTER_LODS)->GetChecked();
+	swprintf_s(desc, L"LOD Texels: %0.1f", g_CascadedShadow.m_fCasterLodTexels);
+	g_HUD.AddStatic(IDC_CASTER_LOD_TEXELS_TEXT, desc, 0, iY + 26, 30, 10);
+	g_HUD.AddSlider(IDC_CASTER_LOD_TEXELS, 90, iY += 26, 64, 15, 0, 40, (INT)(g_CascadedShadow.m_fCasterLodTexels*10.0f + 0.5f));
+
+	g_HUD.AddComboBox(IDC_CASCADE_UPDATE_SCHEDULE, 0, iY += 26, 170, 23, 0, false, &g_CascadeUpdateScheduleCombo);
+	g_CascadeUpdateScheduleCombo->AddItem(L"Update Every Frame", ULongToPtr(CASCADE_UPDATE_EVERY_FRAME));
+	g_CascadeUpdateScheduleCombo->AddItem(L"Update Round Robin", ULongToPtr(CASCADE_UPDATE_ROUND_ROBIN));
+	g_CascadeUpdateScheduleCombo->AddItem(L"Update By Error", ULongToPtr(CASCADE_UPDATE_BY_ERROR));
+	g_CascadedShadow.m_eCascadeUpdateSchedule = CASCADE_UPDATE_EVERY_FRAME;
+
 	g_HUD.AddComboBox(IDC_CASCADE_SELECTION_MODE, 0, iY += 26, 170, 23, VK_F9, false, &g_PixelToCascadeSelectionModeCombo);
 	g_PixelToCascadeSelectionModeCombo->AddItem(L"Map Selection", ULongToPtr(CASCADE_SELECTION_MAP));
 	g_PixelToCascadeSelectionModeCombo->AddItem(L"Interval Selection", ULongToPtr(CASCADE_SELECTION_INTERVAL));
 
 	g_CascadedShadow.m_eSelectedCascadeMode = CASCADE_SELECTION_MAP;
 
+	// Practical splits ignore the L1..L8 sliders below.
+	g_HUD.AddComboBox(IDC_CASCADE_SPLIT_MODE, 0, iY += 26, 170, 23, 0, false, &g_CascadeSplitModeCombo);
+	g_CascadeSplitModeCombo->AddItem(L"Manual Splits", ULongToPtr(CASCADE_SPLIT_MANUAL));
+	g_CascadeSplitModeCombo->AddItem(L"Practical Splits", ULongToPtr(CASCADE_SPLIT_PRACTICAL));
+	g_CascadedShadow.m_eCascadeSplitMode = CASCADE_SPLIT_MANUAL;
+
+	swprintf_s(desc, L"Split Lambda: %0.2f", g_CascadedShadow.m_fCascadeSplitLambda);
+	g_HUD.AddStatic(IDC_SPLIT_LAMBDA_TEXT, desc, 0, iY + 26, 30, 10);
+	g_HUD.AddSlider(IDC_SPLIT_LAMBDA, 90, iY += 26, 64, 15, 0, 100, (INT)(g_CascadedShadow.m_fCascadeSplitLambda*100.0f + 0.5f));
+
+	g_HUD.AddCheckBox(IDC_FIT_TO_DEPTH_BOUNDS, L"Fit To Depth Bounds", 0, iY += 26, 170, 23, false);
+	g_CascadedShadow.m_bFitToDepthBounds = g_HUD.GetCheckBox(IDC_FIT_TO_DEPTH_BOUNDS)->GetChecked();
+
 	g_HUD.AddComboBox(IDC_CASCADE_LEVELS, 0, iY += 26, 170, 23, VK_F11, false, &g_CascadeLevelsComboBox);
 
 	for (INT index = 0;index < MAX_CASCADES;++index)
@@ -826,6 +1100,115 @@ void RenderText()
 	g_pTextHelper->DrawTextLine(DXUTGetFrameStats(DXUTIsVsyncEnabled()));
 	g_pTextHelper->DrawTextLine(DXUTGetDeviceStats());
 
+	WCHAR szCascadeStats[64];
+	swprintf_s(szCascadeStats, L"Cascade updates: %d/%d (%d scrolled)", g_CascadedShadow.GetCascadeUpdateCount(), g_CascadeConfig.m_nUsingCascadeLevelsCount,
+		g_CascadedShadow.GetScrollCascadeCount());
+	g_pTextHelper->DrawTextLine(szCascadeStats);
+
+	// Texels per screen pixel in the middle of each cascade,the lowest one decides how blocky the shadow looks.
+	CascadeTexelDensity density;
+	g_CascadedShadow.GetTexelDensity(DXUTGetDXGIBackBufferSurfaceDesc()->Height, &density);
+	WCHAR szDensity[128];
+	INT iLength = swprintf_s(szDensity, L"Texels/pixel:");
+	for (INT index = 0;index < g_CascadeConfig.m_nUsingCascadeLevelsCount;++index)
+	{
+		iLength += swprintf_s(szDensity + iLength, ARRAYSIZE(szDensity) - iLength, L" %0.3f", density.m_fTexelsPerPixel[index]);
+	}
+	g_pTextHelper->DrawTextLine(szDensity);
+
+	// Subsets drawn/culled per cascade,cascades that kept their tile this frame show 0/0.
+	WCHAR szCasters[128];
+	iLength = swprintf_s(szCasters, L"Casters drawn/culled:");
+	for (INT index = 0;index < g_CascadeConfig.m_nUsingCascadeLevelsCount;++index)
+	{
+		INT nDrawn, nCulled;
+		g_CascadedShadow.GetCasterCounts(index, &nDrawn, &nCulled);
+		iLength += swprintf_s(szCasters + iLength, ARRAYSIZE(szCasters) - iLength, L" %d/%d", nDrawn, nCulled);
+	}
+	g_pTextHelper->DrawTextLine(szCasters);
+
+	// The sub-texel casters per cascade next to the most a left out caster could have darkened a PCF sample.
+	WCHAR szSmallCasters[160];
+	iLength = swprintf_s(szSmallCasters, L"Casters under %0.1f texels (PCF %dx%d,<= %0.0f%% of a sample):", g_CascadedShadow.m_fMinCasterTexels,
+		g_CascadedShadow.m_iPCFBlurSize, g_CascadedShadow.m_iPCFBlurSize, g_CascadedShadow.GetSmallCasterPCFWeight() * 100.0f);
+	for (INT index = 0;index < g_CascadeConfig.m_nUsingCascadeLevelsCount;++index)
+	{
+		iLength += swprintf_s(szSmallCasters + iLength, ARRAYSIZE(szSmallCasters) - iLength, L" %d", g_CascadedShadow.GetSmallCasterCount(index));
+	}
+	g_pTextHelper->DrawTextLine(szSmallCasters);
+
+	// Triangles per cascade at the caster levels picked for it,for tuning LOD Texels.
+	WCHAR szTriangles[128];
+	iLength = swprintf_s(szTriangles, L"Shadow triangles (%0.2f MB of LOD indices):", (FLOAT)g_CascadedShadow.GetCasterLodBytes() / (1024.0f * 1024.0f));
+	for (INT index = 0;index < g_CascadeConfig.m_nUsingCascadeLevelsCount;++index)
+	{
+		iLength += swprintf_s(szTriangles + iLength, ARRAYSIZE(szTriangles) - iLength, L" %llu", g_CascadedShadow.GetCascadeTriangleCount(index));
+	}
+	g_pTextHelper->DrawTextLine(szTriangles);
+
+	// Per cascade rendering submits the casters once per cascade,single pass once for all of them.
+	WCHAR szDrawCalls[64];
+	swprintf_s(szDrawCalls, L"Shadow draw calls: %d (%s)", g_CascadedShadow.GetShadowDrawCallCount(),
+		g_CascadedShadow.m_bSinglePassShadows ? L"single pass" : L"per cascade");
+	g_pTextHelper->DrawTextLine(szDrawCalls);
+
+	// What the shadow pass fetches against what the position stream costs on top of the interleaved vertices.
+	WCHAR szVertexBytes[128];
+	swprintf_s(szVertexBytes, L"Shadow vertex fetch: %0.2f MB (position stream %0.2f MB over %0.2f MB of vertices)",
+		(FLOAT)g_CascadedShadow.GetShadowVertexBytes() / (1024.0f * 1024.0f),
+		(FLOAT)g_pSelectedMesh->GetPositionStreamBytes() / (1024.0f * 1024.0f),
+		(FLOAT)g_pSelectedMesh->GetVertexBufferBytes() / (1024.0f * 1024.0f));
+	g_pTextHelper->DrawTextLine(szVertexBytes);
+
+	// With equal tiles the atlas and the array take the same memory,the array just has no limit on the width.
+	// Packed tiles of halving length only save memory in the atlas.The shadow maps of earlier configs stay pooled for a while.
+	WCHAR szShadowMap[160];
+	swprintf_s(szShadowMap, L"Shadow map: %d cascades in %s %dx%d,%0.1f MB (+%0.1f MB static layer,+%0.1f MB pooled)", g_CascadeConfig.m_nUsingCascadeLevelsCount,
+		g_CascadedShadow.IsCascadeTextureArray() ? L"array slices of" : L"an atlas of",
+		g_CascadedShadow.GetShadowAtlasWidth(), g_CascadedShadow.GetShadowAtlasHeight(),
+		(FLOAT)g_CascadedShadow.GetShadowMapBytes() / (1024.0f * 1024.0f),
+		(FLOAT)g_CascadedShadow.GetStaticLayerBytes() / (1024.0f * 1024.0f),
+		(FLOAT)g_CascadedShadow.GetShadowTexturePool().GetIdleBytes() / (1024.0f * 1024.0f));
+	g_pTextHelper->DrawTextLine(szShadowMap);
+
+	// Everything the tracker holds,then what each subsystem holds of it.
+	WCHAR szGpuMemory[256];
+	INT nChars = swprintf_s(szGpuMemory, L"GPU memory: %0.1f MB (peak %0.1f MB)", (FLOAT)g_GpuMemoryTracker.GetLiveBytes() / (1024.0f * 1024.0f),
+		(FLOAT)g_GpuMemoryTracker.GetHighWaterBytes() / (1024.0f * 1024.0f));
+	for (INT iTag = 0;iTag < GPU_MEMORY_TAG_COUNT;++iTag)
+	{
+		nChars += swprintf_s(szGpuMemory + nChars, _countof(szGpuMemory) - nChars, L",%S %0.1f", GpuMemoryTracker::GetTagName((GPU_MEMORY_TAG)iTag),
+			(FLOAT)g_GpuMemoryTracker.GetLiveBytes((GPU_MEMORY_TAG)iTag) / (1024.0f * 1024.0f));
+	}
+	g_pTextHelper->DrawTextLine(szGpuMemory);
+
+	// What the budget picked,weighed against the other shadow maps at the fit it was picked from.
+	if (g_HUD.GetCheckBox(IDC_SHADOW_BUDGET)->GetChecked() && g_ShadowBudgetChoice.m_nCascadeCount > 0)
+	{
+		WCHAR szBudget[160];
+		swprintf_s(szBudget, L"Shadow budget: %llu of %llu bytes,%d cascades of %d,%d bit,worst %0.3f texels/pixel (target %0.3f%s,%d candidates)",
+			(unsigned long long)g_ShadowBudgetChoice.m_iBytes, 4ULL * g_HUD.GetSlider(IDC_SHADOW_BUDGET_MB)->GetValue() * 1024 * 1024,
+			g_ShadowBudgetChoice.m_nCascadeCount, g_ShadowBudgetChoice.m_iLengthOfShadowBufferSquare, g_ShadowBudgetChoice.m_iBytesPerTexel * 8,
+			g_ShadowBudgetChoice.m_fMinTexelsPerPixel, g_HUD.GetSlider(IDC_SHADOW_BUDGET_TARGET)->GetValue()*0.001f,
+			g_ShadowBudgetChoice.m_bMeetsTarget ? L" reached" : (g_ShadowBudgetChoice.m_bFitsBudget ? L" missed" : L" missed,over budget"),
+			g_ShadowBudgetChoice.m_nCandidateCount);
+		g_pTextHelper->DrawTextLine(szBudget);
+	}
+
+	// Multithreaded recording runs on the workers and on the render thread while it waits.
+	WCHAR szRecordTime[64];
+	swprintf_s(szRecordTime, L"Shadow recording: %0.3f ms (%u workers)", g_CascadedShadow.GetShadowRecordMilliseconds(),
+		g_CascadedShadow.m_bMultithreadedShadows ? g_JobPool.GetThreadCount() : 0);
+	g_pTextHelper->DrawTextLine(szRecordTime);
+
+	FLOAT fMinDepth, fMaxDepth;
+	if (g_CascadedShadow.GetDepthBounds(&fMinDepth, &fMaxDepth))
+	{
+		WCHAR szDepthBounds[64];
+		swprintf_s(szDepthBounds, L"Depth bounds: %0.1f - %0.1f", fMinDepth, fMaxDepth);
+		g_pTextHelper->DrawTextLine(szDepthBounds);
+	}
+
 	//Draw help
 	if (g_bShowHelp)
 	{
@@ -899,6 +1282,7 @@ HRESULT CreateCommonModule(ID3D11Device * pD3DDevice)
 	g_LightCamera.SetProjParams(DirectX::XM_PI / 4, 1.0f, 0.1f, 1000.0f);
 	g_LightCamera.FrameMove(0);
 
+	g_CascadedShadow.SetMemoryTracker(&g_GpuMemoryTracker);
 	g_CascadedShadow.Init(pD3DDevice, pD3DImmediateContext, g_pSelectedMesh, &g_ViewerCamera, &g_LightCamera, &g_CascadeConfig);
 
 	return S_OK;
@@ -913,3 +1297,92 @@ void UpdateViewerCameraNearFar()
 	FLOAT fMeshLength = XMVectorGetByIndex(vMeshLength, 0);
 	g_ViewerCamera.SetProjParams(XM_PI / 4, g_fApsectRatio, 0.05f, fMeshLength);
 }
+
+//-------
+// The slider,the clamp and the budget all label the buffer size through here.
+void SetBufferSizeText(INT iLength)
+{
+	WCHAR desc[256];
+	swprintf_s(desc, L"Length of Texture square: %d", iLength);
+	g_HUD.GetStatic(IDC_BUFFER_SIZE_TEXT)->SetText(desc);
+}
+
+//-------
+// Side by side the cascades share the 8192 texels of one texture's width,a texture array gives each a slice.
+void ClampShadowBufferSize()
+{
+	INT value = 32 * g_HUD.GetSlider(IDC_BUFFER_SIZE)->GetValue();
+	INT max = g_CascadeConfig.m_bCascadeTextureArray ? 4096 : 8192 / g_CascadeConfig.m_nUsingCascadeLevelsCount;
+	if (value>max)
+	{
+		value = max;
+
+		SetBufferSizeText(value);
+		g_HUD.GetSlider(IDC_BUFFER_SIZE)->SetValue(value / 32);
+		g_CascadeConfig.m_iLengthOfShadowBufferSquare = value;
+	}
+}
+
+//-------
+// Picks the shadow map for the budget and the target density of the sliders and sets the GUI to it.The choice
+// is weighed with practical splits,so the split mode is switched to them.
+void ApplyShadowBudget()
+{
+	ShadowBudgetParams budget;
+	budget.m_iBudgetBytes = 4LL * g_HUD.GetSlider(IDC_SHADOW_BUDGET_MB)->GetValue() * 1024 * 1024;
+	budget.m_fTargetTexelsPerPixel = g_HUD.GetSlider(IDC_SHADOW_BUDGET_TARGET)->GetValue()*0.001f;
+	budget.m_iScreenHeight = DXUTGetDXGIBackBufferSurfaceDesc()->Height;
+	budget.m_nMaxCascadeCount = MAX_CASCADES;
+	budget.m_iMinLength = 128;
+	budget.m_iMaxLength = 4096;
+	budget.m_iMaxTextureLength = g_CascadeConfig.m_bCascadeTextureArray ? 0 : D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION;
+	budget.m_bHalvingLengths = g_HUD.GetCheckBox(IDC_HALVING_CASCADE_LENGTHS)->GetChecked();
+	budget.m_bStaticLayer = g_CascadedShadow.GetStaticLayerBytes() > 0;
+	g_CascadedShadow.SelectShadowBudgetConfig(budget, &g_ShadowBudgetChoice);
+	if (g_ShadowBudgetChoice.m_nCascadeCount == 0)
+	{
+		return;
+	}
+
+	g_CascadedShadow.m_eCascadeSplitMode = CASCADE_SPLIT_PRACTICAL;
+	g_CascadeSplitModeCombo->SetSelectedByData(ULongToPtr(CASCADE_SPLIT_PRACTICAL));
+
+	// The levels handler updates the sliders and cameras and resets the lengths,so it goes first.
+	g_CascadeLevelsComboBox->SetSelectedByIndex(g_ShadowBudgetChoice.m_nCascadeCount - 1);
+	OnGUIEvent(EVENT_COMBOBOX_SELECTION_CHANGED, IDC_CASCADE_LEVELS, g_CascadeLevelsComboBox, nullptr);
+
+	g_CascadeConfig.m_iLengthOfShadowBufferSquare = g_ShadowBudgetChoice.m_iLengthOfShadowBufferSquare;
+	memcpy(g_CascadeConfig.m_iCascadeLengthOfShadowBuffer, g_ShadowBudgetChoice.m_iCascadeLengthOfShadowBuffer,
+		sizeof(g_CascadeConfig.m_iCascadeLengthOfShadowBuffer));
+	g_HUD.GetSlider(IDC_BUFFER_SIZE)->SetValue(g_CascadeConfig.m_iLengthOfShadowBufferSquare / 32);
+	SetBufferSizeText(g_CascadeConfig.m_iLengthOfShadowBufferSquare);
+
+	g_CascadeConfig.m_ShadowBufferFormat = g_ShadowBudgetChoice.m_iBytesPerTexel == 4 ? CASCADE_DXGI_FORMAT_R32_TYPELESS : CASCADE_DXGI_FORMAT_R16_TYPELESS;
+	g_DepthBufferFormatComboBox->SetSelectedByData(UlongToPtr(g_CascadeConfig.m_ShadowBufferFormat));
+}
+
+//-------
+// Gives the far cascades halving tile lengths while "Halve Far Cascades" is checked,otherwise every cascade
+// takes the buffer size.
+void UpdateCascadeLengths()
+{
+	memset(g_CascadeConfig.m_iCascadeLengthOfShadowBuffer, 0, sizeof(g_CascadeConfig.m_iCascadeLengthOfShadowBuffer));
+	if (g_HUD.GetCheckBox(IDC_HALVING_CASCADE_LENGTHS)->GetChecked())
+	{
+		AtlasPacking::GetHalvingCascadeLengths(g_CascadeConfig.m_iLengthOfShadowBufferSquare, g_CascadeConfig.m_nUsingCascadeLevelsCount, 128,
+			g_CascadeConfig.m_iCascadeLengthOfShadowBuffer);
+	}
+}
+
+// The DXUT GUI creates and grows its buffers and textures itself and reports each one it creates or releases.
+void CALLBACK OnGUIResource(ID3D11Resource* pResource, bool bCreated, const char* szName, void* pUserContext)
+{
+	if (bCreated)
+	{
+		g_GpuMemoryTracker.TrackResource(GPU_MEMORY_GUI, pResource, szName);
+	}
+	else
+	{
+		g_GpuMemoryTracker.Untrack(pResource);
+	}
+}
@@ -3,17 +3,18 @@
 #include "CascadedShadowsManager.h"
 #include "DXUTcamera.h"
 #include "SDKmesh.h"
-#include "xnacollision.h"
+#include "CascadeFitting.h"
 #include "SDKmisc.h"
 #include "Resource.h"
+#include "JobPool.h"
+#include "GpuMemoryTracker.h"
+#include <algorithm>
+#include <chrono>
 
 using namespace DirectX;
 
 static const XMVECTORF32 g_vFLTMAX = { FLT_MAX,FLT_MAX, FLT_MAX, FLT_MAX };
 static const XMVECTORF32 g_vFLTMIN = { -FLT_MAX,-FLT_MAX, -FLT_MAX, -FLT_MAX };
-static const XMVECTORF32 g_vHalfVector = { 0.5f,0.5f,0.5f,0.5f };
-static const XMVECTORF32 g_vMultiplySetzwZero = { 1.0f,1.0f,0.0f,0.0f };
-static const XMVECTORF32 g_vZero = { 0.0f,0.0f,0.0f,0.0f };
 
 //------------------------------------------------------------------------
 // Initialize the Manager. The manager performs all the work of calculating the render
@@ -22,29 +23,121 @@ static const XMVECTORF32 g_vZero = { 0.0f,0.0f,0.0f,0.0f };
 //-----------------------------------------------------------------------
 CascadedShadowsManager::CascadedShadowsManager()
 	:m_pMeshVertexLayout(nullptr),
+	m_pShadowVertexLayout(nullptr),
 	m_pSamLinear(nullptr),
 	m_pSamShadowPCF(nullptr),
 	m_pSamShadowPoint(nullptr),
+	m_pShadowMapPoolTexture(nullptr),
+	m_pStaticShadowMapPoolTexture(nullptr),
 	m_pCascadedShadowMapTexture(nullptr),
 	m_pCascadedShadowMapDSV(nullptr),
 	m_pCascadedShadowMapSRV(nullptr),
+	m_pStaticShadowMapTexture(nullptr),
+	m_pStaticShadowMapDSV(nullptr),
+	m_pStaticShadowMapSRV(nullptr),
+	m_bCascadeTextureArray(false),
+	m_uShadowMapBytes(0),
+	m_iShadowAtlasWidth(0),
+	m_iShadowAtlasHeight(0),
+	m_nDynamicCasterMeshes(0),
+	m_eCascadeSplitMode(CASCADE_SPLIT_MANUAL),
+	m_fCascadeSplitLambda(0.9f),
+	m_bFitToDepthBounds(false),
 	m_bIsBlurBetweenCascades(false),
 	m_fMaxBlendRatioBetweenCascadeLevel(10.0f),
 	m_RenderOneTileVP(m_RenderViewPort[0]),
 	m_pDepthStencilStateLess(nullptr),
-	m_pGlobalConstantBuffer(nullptr),
+	m_pDepthStencilStateAlways(nullptr),
+	m_pPerObjectConstantBuffer(nullptr),
+	m_pShadowFrameConstantBuffer(nullptr),
+	m_pCascadeConstantRing(nullptr),
+	m_uCascadeRingNextSlot(CASCADE_CONSTANT_RING_SLOTS),
 	m_pRasterizerStateScene(nullptr),
 	m_pRasterizerStateShadow(nullptr),
 	m_pRasterizerStateShadowPancake(nullptr),
+	m_pRasterizerStateShadowScissor(nullptr),
+	m_pRasterizerStateShadowPancakeScissor(nullptr),
 	m_iPCFBlurSize(3),
 	m_fPCFShadowDepthBia(0.002f),
+	m_fMinCasterTexels(0.0f),
+	m_fTileMinCasterTexels(0.0f),
 	m_bIsDerivativeBaseOffset(false),
-	m_pRenderOrthoShadowVertexShaderBlob(nullptr)
+	m_bAnalyticNearFar(false),
+	m_bNearFarFromMeshBounds(false),
+	m_bCullShadowCasters(false),
+	m_bSinglePassShadows(false),
+	m_bMultithreadedShadows(false),
+	m_nShadowDrawCalls(0),
+	m_fShadowRecordMilliseconds(0.0f),
+	m_bCacheCascades(false),
+	m_bScrollCascades(false),
+	m_bPositionOnlyCasters(false),
+	m_bCasterLods(false),
+	m_fCasterLodTexels(1.0f),
+	m_uCasterLodBytes(0),
+	m_bTileCasterLods(false),
+	m_fTileCasterLodTexels(1.0f),
+	m_eCascadeUpdateSchedule(CASCADE_UPDATE_EVERY_FRAME),
+	m_iFarCascadeUpdatesPerFrame(1),
+	m_uDirtyCascadeMask(0),
+	m_uScrollCascadeMask(0),
+	m_uDynamicCasterCascadeMask(0),
+	m_pRenderOrthoShadowVertexShaderBlob(nullptr),
+	m_pClearTileVertexShader(nullptr),
+	m_pClearTileVertexShaderBlob(nullptr),
+	m_pCopyStaticTilePixelShader(nullptr),
+	m_pCopyStaticTilePixelShaderBlob(nullptr),
+	m_pRenderShadowInstancedVertexShader(nullptr),
+	m_pRenderShadowInstancedVertexShaderBlob(nullptr),
+	m_pRouteToCascadeGeometryShader(nullptr),
+	m_pRouteToCascadeGeometryShaderBlob(nullptr),
+	m_pShadowCascadesConstantBuffer(nullptr),
+	m_pJobPool(nullptr),
+	m_pMemoryTracker(nullptr),
+	m_pDepthReductionComputeShader(nullptr),
+	m_pDepthReductionComputeShaderBlob(nullptr),
+	m_pDepthBoundsBuffer(nullptr),
+	m_pDepthBoundsUAV(nullptr),
+	m_uDepthBoundsFrame(0),
+	m_bDepthBoundsValid(false),
+	m_fDepthBoundsMin(0.0f),
+	m_fDepthBoundsMax(0.0f)
 {
 	sprintf_s(m_cVertexShaderMode, "vs_5_0");
 	sprintf_s(m_cPixelShaderMode, "ps_5_0");
 	sprintf_s(m_cGeometryShaderMode, "gs_5_0");
+	sprintf_s(m_cComputeShaderMode, "cs_5_0");
 
+	for (INT index = 0;index < DEPTH_BOUNDS_READBACK_LATENCY;++index)
+	{
+		m_pDepthBoundsStagingBuffer[index] = nullptr;
+	}
+
+	m_FrustumSlices.m_nSliceCount = 0;
+	CascadeFitting::InvalidateCascadeCache(&m_CascadeCache);
+
+	for (INT index = 0;index < MAX_CASCADES;++index)
+	{
+		m_nCastersDrawn[index] = 0;
+		m_nCastersCulled[index] = 0;
+		m_nSmallCastersCulled[index] = 0;
+		m_uShadowVertexBytes[index] = 0;
+		m_nCascadeTriangles[index] = 0;
+		m_pCascadeDeferredContexts[index] = nullptr;
+		m_pCascadeCommandLists[index] = nullptr;
+		m_nCascadeDrawCalls[index] = 0;
+		m_uCascadeRingSlot[index] = 0;
+		m_pCascadeConstantBuffers[index] = nullptr;
+		m_iTileOriginX[index] = 0;
+		m_iTileOriginY[index] = 0;
+		m_pCascadedShadowMapSliceDSVs[index] = nullptr;
+		m_pStaticShadowMapSliceDSVs[index] = nullptr;
+		m_iCascadeLengthOfShadowBuffer[index] = 0;
+		m_CascadeAtlasRects[index].m_iX = 0;
+		m_CascadeAtlasRects[index].m_iY = 0;
+		m_CascadeAtlasRects[index].m_iWidth = 0;
+		m_CascadeAtlasRects[index].m_iHeight = 0;
+	}
 
 	for (INT index = 0;index < MAX_CASCADES;++index)
 	{
@@ -74,7 +167,13 @@ CascadedShadowsManager::CascadedShadowsManager()
 CascadedShadowsManager::~CascadedShadowsManager()
 {
 	DestroyAndDeallocateShadowResources();
+	TrackShaderBlobs(false);
 	SAFE_RELEASE(m_pRenderOrthoShadowVertexShaderBlob);
+	SAFE_RELEASE(m_pClearTileVertexShaderBlob);
+	SAFE_RELEASE(m_pCopyStaticTilePixelShaderBlob);
+	SAFE_RELEASE(m_pRenderShadowInstancedVertexShaderBlob);
+	SAFE_RELEASE(m_pRouteToCascadeGeometryShaderBlob);
+	SAFE_RELEASE(m_pDepthReductionComputeShaderBlob);
 
 	for (int i = 0;i<MAX_CASCADES;++i)
 	{
@@ -130,6 +229,28 @@ HRESULT CascadedShadowsManager::Init(ID3D11Device * pD3DDevice, ID3D11DeviceCont
 		m_vSceneAABBMax = XMVectorMax(vMeshMax, m_vSceneAABBMax);
 	}
 
+	m_uMeshFirstSubsetBox.resize(pMesh->GetNumMeshes());
+	UINT nSubsetCount = 0;
+	for (UINT i = 0;i<pMesh->GetNumMeshes();++i)
+	{
+		m_uMeshFirstSubsetBox[i] = nSubsetCount;
+		nSubsetCount += pMesh->GetNumSubsets(i);
+	}
+	m_vSubsetBoxMin.resize(nSubsetCount);
+	m_vSubsetBoxMax.resize(nSubsetCount);
+	for (UINT i = 0;i<pMesh->GetNumMeshes();++i)
+	{
+		ComputeSubsetBounds(pMesh, i);
+	}
+	CascadeFitting::BuildSceneBoundsHierarchy(m_vSubsetBoxMin.data(), m_vSubsetBoxMax.data(), (INT)nSubsetCount, &m_SceneBounds);
+	m_uCasterCascadeMasks.resize(nSubsetCount);
+	m_uStripCasterMasks.resize(nSubsetCount * 2);
+	m_bMeshDynamicCaster.assign(pMesh->GetNumMeshes(), false);
+	m_nDynamicCasterMeshes = 0;
+	m_uDynamicCasterCascadeMask = 0;
+
+	V_RETURN(BuildCasterLods(pD3DDevice, pMesh));
+
 	m_pViewerCamera = pViewerCamera;
 	m_pLightCamera = pLightCamera;
 
@@ -142,10 +263,92 @@ HRESULT CascadedShadowsManager::Init(ID3D11Device * pD3DDevice, ID3D11DeviceCont
 		nullptr, &m_pRenderOrthoShadowVertexShader));
 	DXUT_SetDebugName(m_pRenderOrthoShadowVertexShader, "RenderCascadeShadow");
 
+	if (m_pClearTileVertexShaderBlob == nullptr)
+	{
+		V_RETURN(CompileShaderFromFile(L"RenderCascadeShadow.hlsl", nullptr, "VSClearTile", m_cVertexShaderMode, &m_pClearTileVertexShaderBlob));
+	}
+
+	V_RETURN(pD3DDevice->CreateVertexShader(m_pClearTileVertexShaderBlob->GetBufferPointer(), m_pClearTileVertexShaderBlob->GetBufferSize(),
+		nullptr, &m_pClearTileVertexShader));
+	DXUT_SetDebugName(m_pClearTileVertexShader, "RenderCascadeShadow ClearTile");
+
+	if (m_pCopyStaticTilePixelShaderBlob == nullptr)
+	{
+		V_RETURN(CompileShaderFromFile(L"RenderCascadeShadow.hlsl", nullptr, "PSCopyStaticTile", m_cPixelShaderMode, &m_pCopyStaticTilePixelShaderBlob));
+	}
+
+	V_RETURN(pD3DDevice->CreatePixelShader(m_pCopyStaticTilePixelShaderBlob->GetBufferPointer(), m_pCopyStaticTilePixelShaderBlob->GetBufferSize(),
+		nullptr, &m_pCopyStaticTilePixelShader));
+	DXUT_SetDebugName(m_pCopyStaticTilePixelShader, "RenderCascadeShadow CopyStaticTile");
+
+	if (m_pRenderShadowInstancedVertexShaderBlob == nullptr)
+	{
+		V_RETURN(CompileShaderFromFile(L"RenderCascadeShadow.hlsl", nullptr, "VSMainInstanced", m_cVertexShaderMode, &m_pRenderShadowInstancedVertexShaderBlob));
+	}
+
+	V_RETURN(pD3DDevice->CreateVertexShader(m_pRenderShadowInstancedVertexShaderBlob->GetBufferPointer(), m_pRenderShadowInstancedVertexShaderBlob->GetBufferSize(),
+		nullptr, &m_pRenderShadowInstancedVertexShader));
+	DXUT_SetDebugName(m_pRenderShadowInstancedVertexShader, "RenderCascadeShadow Instanced");
+
+	if (m_pRouteToCascadeGeometryShaderBlob == nullptr)
+	{
+		V_RETURN(CompileShaderFromFile(L"RenderCascadeShadow.hlsl", nullptr, "GSRouteToCascade", m_cGeometryShaderMode, &m_pRouteToCascadeGeometryShaderBlob));
+	}
+
+	V_RETURN(pD3DDevice->CreateGeometryShader(m_pRouteToCascadeGeometryShaderBlob->GetBufferPointer(), m_pRouteToCascadeGeometryShaderBlob->GetBufferSize(),
+		nullptr, &m_pRouteToCascadeGeometryShader));
+	DXUT_SetDebugName(m_pRouteToCascadeGeometryShader, "RenderCascadeShadow RouteToCascade");
+
+	if (m_pDepthReductionComputeShaderBlob == nullptr)
+	{
+		V_RETURN(CompileShaderFromFile(L"DepthReduction.hlsl", nullptr, "CSReduceDepthBounds", m_cComputeShaderMode, &m_pDepthReductionComputeShaderBlob));
+	}
+
+	V_RETURN(pD3DDevice->CreateComputeShader(m_pDepthReductionComputeShaderBlob->GetBufferPointer(), m_pDepthReductionComputeShaderBlob->GetBufferSize(),
+		nullptr, &m_pDepthReductionComputeShader));
+	DXUT_SetDebugName(m_pDepthReductionComputeShader, "DepthReduction");
+
+	// Two uints the compute shader reduces into,and the staging copies they are read back from.
+	D3D11_BUFFER_DESC depthBoundsDesc;
+	ZeroMemory(&depthBoundsDesc, sizeof(depthBoundsDesc));
+	depthBoundsDesc.ByteWidth = 2 * sizeof(UINT);
+	depthBoundsDesc.Usage = D3D11_USAGE_DEFAULT;
+	depthBoundsDesc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+	depthBoundsDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+	V_RETURN(pD3DDevice->CreateBuffer(&depthBoundsDesc, nullptr, &m_pDepthBoundsBuffer));
+	DXUT_SetDebugName(m_pDepthBoundsBuffer, "Depth Bounds");
+
+	D3D11_UNORDERED_ACCESS_VIEW_DESC depthBoundsUAVDesc;
+	ZeroMemory(&depthBoundsUAVDesc, sizeof(depthBoundsUAVDesc));
+	depthBoundsUAVDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+	depthBoundsUAVDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+	depthBoundsUAVDesc.Buffer.NumElements = 2;
+	depthBoundsUAVDesc.Buffer.Flags = D3D11_BUFFER_UAV_FLAG_RAW;
+	V_RETURN(pD3DDevice->CreateUnorderedAccessView(m_pDepthBoundsBuffer, &depthBoundsUAVDesc, &m_pDepthBoundsUAV));
+	DXUT_SetDebugName(m_pDepthBoundsUAV, "Depth Bounds UAV");
+
+	depthBoundsDesc.Usage = D3D11_USAGE_STAGING;
+	depthBoundsDesc.BindFlags = 0;
+	depthBoundsDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	depthBoundsDesc.MiscFlags = 0;
+	for (INT index = 0;index < DEPTH_BOUNDS_READBACK_LATENCY;++index)
+	{
+		V_RETURN(pD3DDevice->CreateBuffer(&depthBoundsDesc, nullptr, &m_pDepthBoundsStagingBuffer[index]));
+		DXUT_SetDebugName(m_pDepthBoundsStagingBuffer[index], "Depth Bounds Staging");
+	}
+
+	// The bounds belong to the previous scene.
+	m_uDepthBoundsFrame = 0;
+	m_bDepthBoundsValid = false;
+
+	// The device is new,so none of the tiles survived.
+	CascadeFitting::InvalidateCascadeCache(&m_CascadeCache);
+
 	//In order to compile optimal versions of each shaders,compile out of 64 versions of the same file/
 	// the if statements are dependent upon these macros.This enables the compiler to optimize out code
 	// that can never be reached.
 	//D3D11 Dynamic shader linkage would have this same effect without the need to compile 64 versions of the shader.
+	// Whether the cascades are stored in a texture array is a constant,see CB_SHADOW_FRAME::m_iIsCascadeTextureArray.
 	D3D_SHADER_MACRO defines[]
 	{
 		"CASCADE_COUNT_FLAG","1",
@@ -233,6 +436,14 @@ HRESULT CascadedShadowsManager::Init(ID3D11Device * pD3DDevice, ID3D11DeviceCont
 		&m_pMeshVertexLayout));
 	DXUT_SetDebugName(m_pMeshVertexLayout, "CascadeShadowsManagerInputLayout");
 
+	// The shadow vertex shaders only read the position,which is the first element of layout_mesh too.
+	V_RETURN(pD3DDevice->CreateInputLayout(
+		layout_mesh, 1,
+		m_pRenderOrthoShadowVertexShaderBlob->GetBufferPointer(),
+		m_pRenderOrthoShadowVertexShaderBlob->GetBufferSize(),
+		&m_pShadowVertexLayout));
+	DXUT_SetDebugName(m_pShadowVertexLayout, "CascadeShadowsManagerShadowInputLayout");
+
 
 	D3D11_DEPTH_STENCIL_DESC depthStencilDesc;
 	ZeroMemory(&depthStencilDesc, sizeof(depthStencilDesc));
@@ -244,6 +455,10 @@ HRESULT CascadedShadowsManager::Init(ID3D11Device * pD3DDevice, ID3D11DeviceCont
 	V_RETURN(pD3DDevice->CreateDepthStencilState(&depthStencilDesc, &m_pDepthStencilStateLess));
 	DXUT_SetDebugName(m_pDepthStencilStateLess, "DepthStencil LESS");
 
+	depthStencilDesc.DepthFunc = D3D11_COMPARISON_ALWAYS;
+	V_RETURN(pD3DDevice->CreateDepthStencilState(&depthStencilDesc, &m_pDepthStencilStateAlways));
+	DXUT_SetDebugName(m_pDepthStencilStateAlways, "DepthStencil ALWAYS");
+
 	D3D11_RASTERIZER_DESC drd;
 	drd.FillMode = D3D11_FILL_SOLID;
 	drd.CullMode = D3D11_CULL_NONE;
@@ -281,36 +496,145 @@ HRESULT CascadedShadowsManager::Init(ID3D11Device * pD3DDevice, ID3D11DeviceCont
 	pD3DDevice->CreateRasterizerState(&drd, &m_pRasterizerStateShadowPancake);
 	DXUT_SetDebugName(m_pRasterizerStateShadowPancake, "CSM Pancake");
 
+	drd.ScissorEnable = TRUE;
+	pD3DDevice->CreateRasterizerState(&drd, &m_pRasterizerStateShadowPancakeScissor);
+	DXUT_SetDebugName(m_pRasterizerStateShadowPancakeScissor, "CSM Pancake Scissor");
+	drd.DepthClipEnable = TRUE;
+	pD3DDevice->CreateRasterizerState(&drd, &m_pRasterizerStateShadowScissor);
+	DXUT_SetDebugName(m_pRasterizerStateShadowScissor, "CSM Shadow Scissor");
+
+	// The samplers don't depend on the cascade config,a reconfig keeps them.
+	D3D11_SAMPLER_DESC SamDesc;
+	SamDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+	SamDesc.AddressU = SamDesc.AddressV  = SamDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
+	SamDesc.MipLODBias = 0.0f;
+	SamDesc.MaxAnisotropy = 1;
+	SamDesc.ComparisonFunc = D3D11_COMPARISON_ALWAYS;
+	SamDesc.BorderColor[0] = SamDesc.BorderColor[1] = SamDesc.BorderColor[2] = SamDesc.BorderColor[3] = 0;
+	SamDesc.MinLOD = 0;
+	SamDesc.MaxLOD = D3D11_FLOAT32_MAX;
+	V_RETURN(pD3DDevice->CreateSamplerState(&SamDesc, &m_pSamLinear));
+	DXUT_SetDebugName(m_pSamLinear, "CSM Linear");
+
+	D3D11_SAMPLER_DESC SamDescShadow;
+	SamDescShadow.Filter = D3D11_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT;
+	SamDescShadow.AddressU = SamDescShadow.AddressV = SamDescShadow.AddressW = D3D11_TEXTURE_ADDRESS_BORDER;
+	SamDescShadow.MipLODBias = 0.0f;
+	SamDescShadow.MaxAnisotropy = 0;
+	SamDescShadow.ComparisonFunc = D3D11_COMPARISON_LESS;
+	SamDescShadow.BorderColor[0] = SamDescShadow.BorderColor[1] = SamDescShadow.BorderColor[2] = SamDescShadow.BorderColor[3] = 0.0f;
+	SamDescShadow.MinLOD = 0;
+	SamDescShadow.MaxLOD = 0;
+	
+	V_RETURN(pD3DDevice->CreateSamplerState(&SamDescShadow, &m_pSamShadowPCF));
+	DXUT_SetDebugName(m_pSamShadowPCF, "CSM Shader PCF");
+
+	SamDescShadow.MaxAnisotropy = 15;
+	SamDescShadow.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+	SamDescShadow.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+	SamDescShadow.Filter = D3D11_FILTER_ANISOTROPIC;
+	SamDescShadow.ComparisonFunc = D3D11_COMPARISON_NEVER;
+	V_RETURN(pD3DDevice->CreateSamplerState(&SamDescShadow, &m_pSamShadowPoint));
+	DXUT_SetDebugName(m_pSamShadowPoint, "CSM Shadow Point");
+
 	D3D11_BUFFER_DESC Desc;
 	Desc.Usage = D3D11_USAGE_DYNAMIC;
 	Desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
 	Desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
 	Desc.MiscFlags = 0;
 
-	Desc.ByteWidth = sizeof(CB_ALL_SHADOW_DATA);
-	V_RETURN(pD3DDevice->CreateBuffer(&Desc, NULL, &m_pGlobalConstantBuffer));
-	DXUT_SetDebugName(m_pGlobalConstantBuffer, "CB_ALL_SHADOW_DATACB_ALL_SHADOW_DATA");
+	Desc.ByteWidth = sizeof(CB_PER_OBJECT);
+	V_RETURN(pD3DDevice->CreateBuffer(&Desc, NULL, &m_pPerObjectConstantBuffer));
+	DXUT_SetDebugName(m_pPerObjectConstantBuffer, "CB_PER_OBJECT");
+
+	Desc.ByteWidth = sizeof(CB_SHADOW_FRAME);
+	V_RETURN(pD3DDevice->CreateBuffer(&Desc, NULL, &m_pShadowFrameConstantBuffer));
+	DXUT_SetDebugName(m_pShadowFrameConstantBuffer, "CB_SHADOW_FRAME");
+
+	Desc.ByteWidth = sizeof(CB_SHADOW_CASCADES);
+	V_RETURN(pD3DDevice->CreateBuffer(&Desc, NULL, &m_pShadowCascadesConstantBuffer));
+	DXUT_SetDebugName(m_pShadowCascadesConstantBuffer, "CB_SHADOW_CASCADES");
+
+#ifdef USE_DIRECT3D11_1
+	// Appending to the ring needs NO_OVERWRITE maps of a constant buffer,binding a slot needs VSSetConstantBuffers1.
+	D3D11_FEATURE_DATA_D3D11_OPTIONS Options;
+	ID3D11DeviceContext1* pD3DImmediateContext1 = nullptr;
+	if (SUCCEEDED(pD3DDevice->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &Options, sizeof(Options)))
+		&& Options.ConstantBufferOffsetting && Options.MapNoOverwriteOnDynamicConstantBuffer
+		&& SUCCEEDED(pD3DImmediateContext->QueryInterface(__uuidof(ID3D11DeviceContext1), (void**)&pD3DImmediateContext1)))
+	{
+		SAFE_RELEASE(pD3DImmediateContext1);
+
+		Desc.ByteWidth = CB_PER_CASCADE_SLOT_SIZE * CASCADE_CONSTANT_RING_SLOTS;
+		V_RETURN(pD3DDevice->CreateBuffer(&Desc, NULL, &m_pCascadeConstantRing));
+		DXUT_SetDebugName(m_pCascadeConstantRing, "CB_PER_CASCADE Ring");
+		m_uCascadeRingNextSlot = CASCADE_CONSTANT_RING_SLOTS;
+	}
+#endif
+
+	if (m_pCascadeConstantRing == nullptr)
+	{
+		Desc.ByteWidth = sizeof(CB_PER_CASCADE);
+		for (INT index = 0;index < MAX_CASCADES;++index)
+		{
+			V_RETURN(pD3DDevice->CreateBuffer(&Desc, NULL, &m_pCascadeConstantBuffers[index]));
+			DXUT_SetDebugName(m_pCascadeConstantBuffers[index], "CB_PER_CASCADE");
+		}
+	}
+
+	TrackDeviceBuffers(true);
+	TrackShaderBlobs(true);
 
 	return hr;
 }
 
 HRESULT CascadedShadowsManager::DestroyAndDeallocateShadowResources()
 {
+	TrackDeviceBuffers(false);
+
 	SAFE_RELEASE(m_pMeshVertexLayout);
+	SAFE_RELEASE(m_pShadowVertexLayout);
 	SAFE_RELEASE(m_pRenderOrthoShadowVertexShader);
+	SAFE_RELEASE(m_pClearTileVertexShader);
+	SAFE_RELEASE(m_pCopyStaticTilePixelShader);
+	SAFE_RELEASE(m_pRenderShadowInstancedVertexShader);
+	SAFE_RELEASE(m_pRouteToCascadeGeometryShader);
+	SAFE_RELEASE(m_pDepthReductionComputeShader);
+
+	SAFE_RELEASE(m_pDepthBoundsBuffer);
+	SAFE_RELEASE(m_pDepthBoundsUAV);
+	for (INT index = 0;index < DEPTH_BOUNDS_READBACK_LATENCY;++index)
+	{
+		SAFE_RELEASE(m_pDepthBoundsStagingBuffer[index]);
+	}
 
+	m_pShadowMapPoolTexture = nullptr;
+	m_pStaticShadowMapPoolTexture = nullptr;
+	UsePooledShadowTextures();
+	m_ShadowTexturePool.ReleaseAll();
 
-	SAFE_RELEASE(m_pCascadedShadowMapTexture);
-	SAFE_RELEASE(m_pCascadedShadowMapDSV);
-	SAFE_RELEASE(m_pCascadedShadowMapSRV);
+	SAFE_RELEASE(m_pPerObjectConstantBuffer);
+	SAFE_RELEASE(m_pShadowFrameConstantBuffer);
+	SAFE_RELEASE(m_pShadowCascadesConstantBuffer);
+	SAFE_RELEASE(m_pCascadeConstantRing);
+
+	for (INT index = 0;index < MAX_CASCADES;++index)
+	{
+		SAFE_RELEASE(m_pCascadeConstantBuffers[index]);
+		SAFE_RELEASE(m_pCascadeCommandLists[index]);
+		SAFE_RELEASE(m_pCascadeDeferredContexts[index]);
+	}
 
-	SAFE_RELEASE(m_pGlobalConstantBuffer);
+	ReleaseCasterLods();
 
 	SAFE_RELEASE(m_pDepthStencilStateLess);
+	SAFE_RELEASE(m_pDepthStencilStateAlways);
 
 	SAFE_RELEASE(m_pRasterizerStateScene);
 	SAFE_RELEASE(m_pRasterizerStateShadow);
 	SAFE_RELEASE(m_pRasterizerStateShadowPancake);
+	SAFE_RELEASE(m_pRasterizerStateShadowScissor);
+	SAFE_RELEASE(m_pRasterizerStateShadowPancakeScissor);
 
 	SAFE_RELEASE(m_pSamLinear);
 	SAFE_RELEASE(m_pSamShadowPoint);
@@ -339,311 +663,973 @@ HRESULT CascadedShadowsManager::InitPerFrame(ID3D11Device * pD3dDevice, CDXUTSDK
 {
 
 	ReleaseOldAndAllocateNewShadowResources(pD3dDevice);
+	RefitDynamicCasterBounds(mesh);
 
 	// Copy D3DX matrices into XNA Math Math matrices
-	DirectX::XMMATRIX ViewerCameraProjection = m_pViewerCamera->GetProjMatrix();
-	DirectX::XMMATRIX ViewerCameraView = m_pViewerCamera->GetViewMatrix();
-	DirectX::XMMATRIX LightCameraView = m_pLightCamera->GetViewMatrix();
-
-	XMVECTOR det;
-	XMMATRIX InverseViewCamera = XMMatrixInverse(&det, ViewerCameraView);
-
-
-	// Convert from min max representation to center extents representation
-	// This will make it easier to pull the points out of the transformation.
-	XMVECTOR vSceneCenter = m_vSceneAABBMin + m_vSceneAABBMax;
-	vSceneCenter *= g_vHalfVector;
-	XMVECTOR vSceneExtends = m_vSceneAABBMax - m_vSceneAABBMin;
-	vSceneExtends *= g_vHalfVector;
+	CascadeFitParams& fitParams = m_FitParams;
+	fitParams.m_matViewerCameraProj = m_pViewerCamera->GetProjMatrix();
+	fitParams.m_matViewerCameraView = m_pViewerCamera->GetViewMatrix();
+	fitParams.m_matLightCameraView = m_pLightCamera->GetViewMatrix();
+	fitParams.m_vSceneAABBMin = m_vSceneAABBMin;
+	fitParams.m_vSceneAABBMax = m_vSceneAABBMax;
+	fitParams.m_fViewerCameraNearClip = m_pViewerCamera->GetNearClip();
+	fitParams.m_fViewerCameraFarClip = m_pViewerCamera->GetFarClip();
+
+	fitParams.m_nUsingCascadeLevelsCount = m_CopyOfCascadeConfig.m_nUsingCascadeLevelsCount;
+	memcpy(fitParams.m_iCascadePartitionsZeroToOne, m_iCascadePartitionsZeroToOne, sizeof(m_iCascadePartitionsZeroToOne));
+	fitParams.m_iCascadePartitionMax = m_iCascadePartitionMax;
+	fitParams.m_eSplitMode = m_eCascadeSplitMode;
+	fitParams.m_fSplitLambda = m_fCascadeSplitLambda;
+	fitParams.m_bUseDepthBounds = m_bFitToDepthBounds && m_bDepthBoundsValid;
+	fitParams.m_fDepthBoundsMin = m_fDepthBoundsMin;
+	fitParams.m_fDepthBoundsMax = m_fDepthBoundsMax;
+	fitParams.m_iLengthOfShadowBufferSquare = m_CopyOfCascadeConfig.m_iLengthOfShadowBufferSquare;
+	memcpy(fitParams.m_iCascadeLengthOfShadowBuffer, m_iCascadeLengthOfShadowBuffer, sizeof(m_iCascadeLengthOfShadowBuffer));
+	fitParams.m_iPCFBlurSize = m_iPCFBlurSize;
+	// Deferred far cascades need slack around their interval to stay valid for a few frames.
+	fitParams.m_iFarCascadeGuardTexels = m_bCacheCascades && m_eCascadeUpdateSchedule != CASCADE_UPDATE_EVERY_FRAME ? CASCADE_FAR_GUARD_TEXELS : 0;
+	fitParams.m_bMoveLightTexelSize = m_bMoveLightTexelSize ? true : false;
+	fitParams.m_bAnalyticNearFar = m_bAnalyticNearFar;
+	fitParams.m_pSceneBounds = m_bNearFarFromMeshBounds ? &m_SceneBounds : nullptr;
+	fitParams.m_eLightViewFrustumFitMode = m_eLightViewFrustumFitMode;
+	fitParams.m_eSelectedNearFarFit = m_eSelectedNearFarFit;
+
+	if (!m_bCacheCascades)
+	{
+		CascadeFitting::InvalidateCascadeCache(&m_CascadeCache);
+	}
+	else if (m_bSinglePassShadows)
+	{
+		// The single pass draws every cascade at the corner of its tile,so scrolled tiles are rendered again.
+		for (INT iCascadeIndex = 0;iCascadeIndex < MAX_CASCADES;++iCascadeIndex)
+		{
+			if (m_CascadeCache.m_iTileOriginX[iCascadeIndex] != 0 || m_CascadeCache.m_iTileOriginY[iCascadeIndex] != 0)
+			{
+				CascadeFitting::InvalidateCascadeTiles(&m_CascadeCache);
+				break;
+			}
+		}
+	}
 
-	XMVECTOR vSceneAABBPointsInLightView[8];
-	//This function simply converts the center and extends of an AABB into 8 points
-	CreateAABBPoints(vSceneAABBPointsInLightView, vSceneCenter, vSceneExtends);
-	//Transform the scene AABB to Light space.
-	for (int index = 0;index<8;++index)
+	// The tiles rendered with other caster levels are rendered again.
+	if (m_bCasterLods != m_bTileCasterLods || (m_bCasterLods && m_fCasterLodTexels != m_fTileCasterLodTexels))
+	{
+		CascadeFitting::InvalidateCascadeTiles(&m_CascadeCache);
+		m_bTileCasterLods = m_bCasterLods;
+		m_fTileCasterLodTexels = m_fCasterLodTexels;
+	}
+	if (m_fMinCasterTexels != m_fTileMinCasterTexels)
 	{
-		vSceneAABBPointsInLightView[index] = XMVector4Transform(vSceneAABBPointsInLightView[index], LightCameraView);
+		CascadeFitting::InvalidateCascadeTiles(&m_CascadeCache);
+		m_fTileMinCasterTexels = m_fMinCasterTexels;
 	}
 
-	FLOAT fFrustumPartitionBeginDepth, fFrustumPartitionEndDepth;
-	XMVECTOR vOrthographicMinInLightView; //light space frustum aabb
-	XMVECTOR vOrthographicMaxInLightView;
-	FLOAT fCameraNearFarRange = m_pViewerCamera->GetFarClip() - m_pViewerCamera->GetNearClip();
+	// All of the cascade math lives in CascadeFitting so that it can be run without a device.
+	// When nothing moved the previous fit is still valid.
+	CascadeFitting::FitCascadesCached(fitParams, &m_CascadeCache);
+	m_uDirtyCascadeMask = CascadeFitting::ScheduleCascadeUpdates(fitParams, m_eCascadeUpdateSchedule, m_iFarCascadeUpdatesPerFrame, &m_CascadeCache);
 
-	XMVECTOR vViewSpaceUnitsPerTexel = g_vZero;
+	// A cascade that moved by whole texels keeps the texels it still covers and only renders the strips that scrolled in.
+	m_uScrollCascadeMask = 0;
+	if (m_bScrollCascades && !m_bSinglePassShadows)
+	{
+		m_uScrollCascadeMask = CascadeFitting::ScheduleCascadeScrolls(fitParams, m_uDirtyCascadeMask, &m_CascadeCache, m_CascadeScrolls);
+	}
 
-	// we loop over the cascade to calculate the orthographic projection for each cascade.
+	// A cascade that is not rendered this frame keeps the projection its tile was rendered with,so the shadow
+	// pass and the scale/offset in RenderScene always agree.The scheduler only defers cascades with the same shadow view.
+	const CascadeFitResult& fitResult = m_CascadeCache.m_LastResult;
 	for (INT iCascadeIndex = 0;iCascadeIndex<m_CopyOfCascadeConfig.m_nUsingCascadeLevelsCount;++iCascadeIndex)
 	{
-		// Calculate the interval to the View Frustum that this cascade covers.We measure the interval
-		// the cascade covers as a Min and Max Distance along the Z Axis
-		if (m_eLightViewFrustumFitMode == FIT_LIGHT_VIEW_FRUSTRUM_TO_CASCADE_INTERVALS)
+		if (m_uScrollCascadeMask & (1u << iCascadeIndex))
 		{
-			// Because we want to fit the orthograpic projection tightly around the Cascade,we set the Minimum cascade
-			// value to the previous Frustum and Interval
-			if (iCascadeIndex == 0)
-			{
-				fFrustumPartitionBeginDepth = 0.0f;
-			}
-			else
-			{
-				fFrustumPartitionBeginDepth = (FLOAT)m_iCascadePartitionsZeroToOne[iCascadeIndex - 1];
-			}
+			m_matOrthoProjForCascades[iCascadeIndex] = fitResult.m_matOrthoProjForCascades[iCascadeIndex];
+			m_iTileOriginX[iCascadeIndex] = m_CascadeScrolls[iCascadeIndex].m_iOriginX;
+			m_iTileOriginY[iCascadeIndex] = m_CascadeScrolls[iCascadeIndex].m_iOriginY;
+		}
+		else if (m_uDirtyCascadeMask & (1u << iCascadeIndex))
+		{
+			m_matOrthoProjForCascades[iCascadeIndex] = fitResult.m_matOrthoProjForCascades[iCascadeIndex];
+			m_iTileOriginX[iCascadeIndex] = 0;
+			m_iTileOriginY[iCascadeIndex] = 0;
 		}
 		else
 		{
-			// In the FIT_TO_SCENE technique the Cascade overlap each other.
-			//In other words,interval 1 is covered by cascades 1 to 8,interval 2 is covered by cascade 2 to 8 and so forth.
-			fFrustumPartitionBeginDepth = 0.0f;
+			m_matOrthoProjForCascades[iCascadeIndex] = m_CascadeCache.m_matRenderedOrthoProj[iCascadeIndex];
+			m_iTileOriginX[iCascadeIndex] = m_CascadeCache.m_iTileOriginX[iCascadeIndex];
+			m_iTileOriginY[iCascadeIndex] = m_CascadeCache.m_iTileOriginY[iCascadeIndex];
 		}
+		m_fCascadePartitionDepthsInEyeSpace[iCascadeIndex] = fitResult.m_fCascadePartitionDepthsInEyeSpace[iCascadeIndex];
+	}
 
+	m_matShadowView = fitResult.m_matShadowView;
+	m_FrustumSlices = fitResult.m_FrustumSlices;
 
-		// Scale the intervals between 0 and 1,They are now percentages that we can scale with.
-		fFrustumPartitionBeginDepth = fFrustumPartitionBeginDepth/(FLOAT)m_iCascadePartitionMax*fCameraNearFarRange;
-		fFrustumPartitionEndDepth = (FLOAT)m_iCascadePartitionsZeroToOne[iCascadeIndex] /(FLOAT)m_iCascadePartitionMax*fCameraNearFarRange;
-
-		XMVECTOR vFrustumPointsInCameraView[8];
-		XMVECTOR vFrustumPointsInWorld[8];
-		XMVECTOR vTempTranslatedCornerPointInLightView;
-
-		//This function takes the begin and end intervals along with the projection matrix and returns the 8 points
-		// That represented the cascade Interval
-		CreateFrustumPointsFromCascadeInterval(fFrustumPartitionBeginDepth, fFrustumPartitionEndDepth, ViewerCameraProjection, vFrustumPointsInCameraView);
+	return S_OK;
+}
 
-		vOrthographicMinInLightView = g_vFLTMAX;
-		vOrthographicMaxInLightView = g_vFLTMIN;
 
-		
+void CascadedShadowsManager::SetDynamicCaster(UINT iMesh, bool bDynamic)
+{
+	if (m_bMeshDynamicCaster[iMesh] == bDynamic)
+	{
+		return;
+	}
 
-		//ӽİ˸ռ任տռ䣬ڹտռAABB
-		//This next section of code calculates the min and max values for the orthographic projection.
-		for (int i = 0;i < 8;++i)
-		{
-			//Transform the frustum from camera view space to world space.
-			vFrustumPointsInWorld[i] = XMVector4Transform(vFrustumPointsInCameraView[i], InverseViewCamera);
-			//Transform the point from world space to LightCamera Space.
-			vTempTranslatedCornerPointInLightView = XMVector4Transform(vFrustumPointsInWorld[i], LightCameraView);
-			// Find the closest point.
-			vOrthographicMinInLightView = XMVectorMin(vTempTranslatedCornerPointInLightView, vOrthographicMinInLightView);
-			vOrthographicMaxInLightView = XMVectorMax(vTempTranslatedCornerPointInLightView, vOrthographicMaxInLightView);
+	m_bMeshDynamicCaster[iMesh] = bDynamic;
+	m_nDynamicCasterMeshes += bDynamic ? 1 : -1;
 
-		}
+	// The mesh moved between the static layer and the dynamic casters,the static layer has to be drawn again.
+	CascadeFitting::InvalidateCascadeTiles(&m_CascadeCache);
+}
 
-		//This code removes the shimmering effect along the edges of shadow due to
-		// the light changing to fit the camera.
-		if (m_eLightViewFrustumFitMode == FIT_LIGHT_VIEW_FRUSTRUM_TO_SCENE)
-		{
-			// Fit the ortho projection to the cascades far plane and a near plane of zero.
-			// Pad the projection to be the size of the diagonal of the Frustum partition.
-			
-			// To do this, we pad the ortho transform so that it is always big enough to cover
-			// the entire camera view frustum.
-			XMVECTOR vDiagonal = vFrustumPointsInWorld[0] - vFrustumPointsInWorld[6];//бԽǵ
-			vDiagonal = XMVector3Length(vDiagonal);
+// Render the cascades into a texture atlas.
+HRESULT CascadedShadowsManager::RenderShadowForAllCascades(ID3D11Device * pD3dDevice, ID3D11DeviceContext * pD3dDeviceContext, CDXUTSDKMesh * pMesh)
+{
+	HRESULT hr = S_OK;
 
-			// The bound is the length of the diagonal of the frustum interval.
-			FLOAT fCascadeBound = XMVectorGetX(vDiagonal);
+	for (INT index = 0;index < MAX_CASCADES;++index)
+	{
+		m_nCastersDrawn[index] = 0;
+		m_nCastersCulled[index] = 0;
+		m_nSmallCastersCulled[index] = 0;
+		m_uShadowVertexBytes[index] = 0;
+		m_nCascadeTriangles[index] = 0;
+	}
+	m_nShadowDrawCalls = 0;
+	m_fShadowRecordMilliseconds = 0.0f;
 
-			//The offset calculated will pad the ortho projection so that it is always the same size
-			// and big enough to cover the entire cascade interval
-			XMVECTOR vBoarderoffset = (vDiagonal - (vOrthographicMaxInLightView - vOrthographicMinInLightView))* g_vHalfVector;
+	// The textures of an earlier config were last read by the frames before this one.
+	m_ShadowTexturePool.BeginFrame(SHADOW_TEXTURE_POOL_IDLE_FRAMES);
 
-			//Set the Z and W component to zero
-			vBoarderoffset *= g_vMultiplySetzwZero;
+	// The dynamic casters are drawn every frame,over a copy of the cached static casters.
+	UINT uAllCascadesMask = (1u << m_CopyOfCascadeConfig.m_nUsingCascadeLevelsCount) - 1;
+	UINT uDynamicCascadeMask = m_pStaticShadowMapTexture != nullptr ? uAllCascadesMask : 0;
 
-			//Add the offsets to the projection.
-			vOrthographicMaxInLightView += vBoarderoffset;
-			vOrthographicMinInLightView -= vBoarderoffset;
+	// Every tile still holds the depth of its current projection.
+	if ((m_uDirtyCascadeMask | uDynamicCascadeMask) == 0)
+	{
+		return hr;
+	}
 
-			//The world units per texel are used to snap the shadow the orthographic projection
-			// to texel sized increments.This keeps the edges of the shadows from shimmering.
-			FLOAT fViewSpaceUnitsPerTexel = fCascadeBound / (float)m_CopyOfCascadeConfig.m_iLengthOfShadowBufferSquare;
-			vViewSpaceUnitsPerTexel = XMVectorSet(fViewSpaceUnitsPerTexel, fViewSpaceUnitsPerTexel, 0.0f, 0.0f);
+	std::chrono::steady_clock::time_point recordStart = std::chrono::steady_clock::now();
 
+	if (m_bCullShadowCasters)
+	{
+		CascadeFitting::CullCasters(m_SceneBounds, m_matShadowView, m_CopyOfCascadeConfig.m_nUsingCascadeLevelsCount,
+			m_matOrthoProjForCascades, m_uCasterCascadeMasks.data());
+	}
+	else
+	{
+		std::fill(m_uCasterCascadeMasks.begin(), m_uCasterCascadeMasks.end(), ~0u);
+	}
+	if (uDynamicCascadeMask != 0)
+	{
+		// A tile is only copied and drawn over when the dynamic casters reach it,left it since the last frame or
+		// its static casters were drawn again.
+		UINT uReachedCascadeMask = GetDynamicCasterCascades(pMesh) & uAllCascadesMask;
+		uDynamicCascadeMask = m_uDirtyCascadeMask | uReachedCascadeMask | m_uDynamicCasterCascadeMask;
+		m_uDynamicCasterCascadeMask = uReachedCascadeMask;
+		if (uDynamicCascadeMask == 0)
+		{
+			return hr;
 		}
-		else if (m_eLightViewFrustumFitMode == FIT_LIGHT_VIEW_FRUSTRUM_TO_CASCADE_INTERVALS)
+	}
+	if (m_fMinCasterTexels > 0.0f)
+	{
+		// A caster below the footprint covers a few texel centers at most,which a wide PCF kernel averages away.
+		CascadeFitting::CullSmallCasters(m_SceneBounds, m_matShadowView, m_CopyOfCascadeConfig.m_nUsingCascadeLevelsCount,
+			m_matOrthoProjForCascades, m_iCascadeLengthOfShadowBuffer, m_fMinCasterTexels,
+			m_uCasterCascadeMasks.data(), m_nSmallCastersCulled);
+
+		// Like the caster counts,a cascade that keeps its tile shows 0.
+		for (INT index = 0;index < MAX_CASCADES;++index)
 		{
-			// We calculate a looser bound based on the size of the PCF blur. This ensures us that we're
-			// Sampling within the correct map.
-			float fScaleDuetoBluredAMT = ((float)(m_iPCFBlurSize * 2 + 1) / (float)m_CopyOfCascadeConfig.m_iLengthOfShadowBufferSquare);
-			XMVECTORF32 vScaleDueToBluredAMT = { fScaleDuetoBluredAMT, fScaleDuetoBluredAMT, 0.0f, 0.0f };
+			if (((m_uDirtyCascadeMask | uDynamicCascadeMask) & (1u << index)) == 0)
+			{
+				m_nSmallCastersCulled[index] = 0;
+			}
+		}
+	}
+	if (m_uScrollCascadeMask != 0)
+	{
+		CullCastersToScrollStrips(pMesh);
+	}
 
-			float fTexelStepeByBufferSize = ((1.0f) / (float)m_CopyOfCascadeConfig.m_iLengthOfShadowBufferSquare);
-			XMVECTOR vTexelStepByBufferSize = XMVectorSet(fTexelStepeByBufferSize, fTexelStepeByBufferSize, 0.0f, 0.0f);
+	// The single pass has all of its matrices in CB_SHADOW_CASCADES.
+	if (!m_bSinglePassShadows)
+	{
+		V(WriteCascadeConstants(pD3dDeviceContext, m_uDirtyCascadeMask | uDynamicCascadeMask));
+	}
 
-			//We calculate the offsets as a percentage of the bound.
-			XMVECTOR vBoarderOffset = vOrthographicMaxInLightView - vOrthographicMinInLightView;
-			vBoarderOffset *= g_vHalfVector;
-			vBoarderOffset *= vScaleDueToBluredAMT;
-			vOrthographicMaxInLightView += vBoarderOffset;
-			vOrthographicMinInLightView -= vBoarderOffset;
+	// Without dynamic casters the static casters are drawn straight into the atlas.A scrolled tile keeps most of its texels.
+	if (m_uDirtyCascadeMask != 0)
+	{
+		ID3D11DepthStencilView* pStaticDSV = uDynamicCascadeMask != 0 ? m_pStaticShadowMapDSV : m_pCascadedShadowMapDSV;
+		bool bClearTiles = m_uDirtyCascadeMask != uAllCascadesMask || m_uScrollCascadeMask != 0;
+		if (!bClearTiles)
+		{
+			pD3dDeviceContext->ClearDepthStencilView(pStaticDSV, D3D11_CLEAR_DEPTH, 1.0, 0);
+		}
+		RenderCasterLayer(pD3dDevice, pD3dDeviceContext, pMesh, pStaticDSV, m_uDirtyCascadeMask, bClearTiles, false);
+	}
 
+	if (uDynamicCascadeMask != 0)
+	{
+		CopyStaticTiles(pD3dDeviceContext, uDynamicCascadeMask);
+		RenderCasterLayer(pD3dDevice, pD3dDeviceContext, pMesh, m_pCascadedShadowMapDSV, uDynamicCascadeMask, false, true);
+	}
 
-			// The world units per texel are used to snap the orthographic projection
-			// to texel sized increments
-			// Because we're fitting tightly to the cascade,the shimmering shadow edges will still be present when
-			// the camera rotates.However when zooming in or strafing the shadow edge will not shimmer.
-			vViewSpaceUnitsPerTexel = vOrthographicMaxInLightView - vOrthographicMinInLightView;
-			vViewSpaceUnitsPerTexel *= vTexelStepByBufferSize;
+	ID3D11RenderTargetView* pNullView = nullptr;
+	pD3dDeviceContext->RSSetState(nullptr);
 
-		}
+	pD3dDeviceContext->OMSetRenderTargets(1, &pNullView, nullptr);
 
-		float fOrthographicMinZInLightView = XMVectorGetZ(vOrthographicMinInLightView);
+	m_fShadowRecordMilliseconds = std::chrono::duration<FLOAT, std::milli>(std::chrono::steady_clock::now() - recordStart).count();
 
-		if (m_bMoveLightTexelSize)
-		{
-			//TexelӦViewSpaceֵӳ䣬ƶCameraӽǱͬضӦӳУ򱣳ͶӰ󲻱䣬ܱ΢仯Ӱֶ
-			// we snape the camera to 1 pixel increments so that moving the camera does not cause the shadow to jitter()
-			// This is a matter of integer dividing by the world space size of texel
-			vOrthographicMinInLightView /= vViewSpaceUnitsPerTexel;
-			vOrthographicMinInLightView = XMVectorFloor(vOrthographicMinInLightView);
-			vOrthographicMinInLightView *= vViewSpaceUnitsPerTexel;
+	CascadeFitting::MarkCascadesRendered(m_FitParams, m_uDirtyCascadeMask & ~m_uScrollCascadeMask, &m_CascadeCache);
+	CascadeFitting::MarkCascadesScrolled(m_FitParams, m_uScrollCascadeMask, m_CascadeScrolls, &m_CascadeCache);
 
+	return hr;
+}
 
-			vOrthographicMaxInLightView /= vViewSpaceUnitsPerTexel;
-			vOrthographicMaxInLightView = XMVectorFloor(vOrthographicMaxInLightView);
-			vOrthographicMaxInLightView *= vViewSpaceUnitsPerTexel;
 
-		}
+void CascadedShadowsManager::ComputeSubsetBounds(CDXUTSDKMesh* pMesh, UINT iMesh)
+{
+	// The sdkmesh only stores mesh bounds,the subset bounds come from the positions each subset draws.
+	// A subset without a vertex range falls back to the bounds of its mesh.
+	SDKMESH_MESH* mesh = pMesh->GetMesh(iMesh);
+	const BYTE* pVertices = pMesh->GetRawVerticesAt(mesh->VertexBuffers[0]);
+	UINT uStride = pMesh->GetVertexStride(iMesh, 0);
 
-		// These are the unconfigured near and far plane values. They are purposely awful to show
-		// how important calculating accurate near and far plane is.
-		FLOAT fNearPlaneInLightView = 0.0f;
-		FLOAT fFarPlaneInLightView = 10000.0f;
+	for (UINT iSubset = 0;iSubset<pMesh->GetNumSubsets(iMesh);++iSubset)
+	{
+		SDKMESH_SUBSET* pSubset = pMesh->GetSubset(iMesh, iSubset);
+		XMVECTOR vSubsetMin = XMVectorSet(mesh->BoundingBoxCenter.x - mesh->BoundingBoxExtents.x,
+			mesh->BoundingBoxCenter.y - mesh->BoundingBoxExtents.y,
+			mesh->BoundingBoxCenter.z - mesh->BoundingBoxExtents.z, 1.0f);
+		XMVECTOR vSubsetMax = XMVectorSet(mesh->BoundingBoxCenter.x + mesh->BoundingBoxExtents.x,
+			mesh->BoundingBoxCenter.y + mesh->BoundingBoxExtents.y,
+			mesh->BoundingBoxCenter.z + mesh->BoundingBoxExtents.z, 1.0f);
 
-		if (m_eSelectedNearFarFit == FIT_NEAR_FAR_ONLY_SCENE_AABB)
+		if (pVertices != nullptr && pSubset->VertexCount > 0)
 		{
-			XMVECTOR vLightSpaceSceneAABBminValue = g_vFLTMAX; //World space scene aabb
-			XMVECTOR vLightSpaceSceneAABBmaxValue = g_vFLTMIN;
-
-			// We calculate the min and max vectors of the scene in the light space.The min and max "Z" values of the light space AABB
-			// can be used for the near and far plane.This is easier than intersecting the scene with the AABB
-			// and in some cases provides similar results
-			for (int index = 0;index<8;++index)
+			vSubsetMin = g_vFLTMAX;
+			vSubsetMax = g_vFLTMIN;
+			for (UINT64 iVertex = pSubset->VertexStart;iVertex<pSubset->VertexStart + pSubset->VertexCount;++iVertex)
 			{
-				vLightSpaceSceneAABBminValue = XMVectorMin(vSceneAABBPointsInLightView[index], vLightSpaceSceneAABBminValue); 
-				vLightSpaceSceneAABBmaxValue = XMVectorMax(vSceneAABBPointsInLightView[index], vLightSpaceSceneAABBmaxValue);
+				// The position is the first element of the sample's vertex layout.
+				XMVECTOR vPosition = XMLoadFloat3((const XMFLOAT3*)(pVertices + iVertex * uStride));
+				vSubsetMin = XMVectorMin(vSubsetMin, vPosition);
+				vSubsetMax = XMVectorMax(vSubsetMax, vPosition);
 			}
+		}
 
-			//The min and max z values are the near and far planes.
-			fNearPlaneInLightView = XMVectorGetZ(vLightSpaceSceneAABBminValue);
-			fFarPlaneInLightView = XMVectorGetZ(vLightSpaceSceneAABBmaxValue);
+		UINT iBox = m_uMeshFirstSubsetBox[iMesh] + iSubset;
+		XMStoreFloat3(&m_vSubsetBoxMin[iBox], vSubsetMin);
+		XMStoreFloat3(&m_vSubsetBoxMax[iBox], vSubsetMax);
+	}
+}
+
+void CascadedShadowsManager::RefitDynamicCasterBounds(CDXUTSDKMesh* pMesh)
+{
+	if (m_nDynamicCasterMeshes == 0)
+	{
+		return;
+	}
 
+	for (UINT iMesh = 0;iMesh < pMesh->GetNumMeshes();++iMesh)
+	{
+		if (m_bMeshDynamicCaster[iMesh])
+		{
+			ComputeSubsetBounds(pMesh, iMesh);
+		}
+	}
+	CascadeFitting::RefitSceneBoundsHierarchy(m_vSubsetBoxMin.data(), m_vSubsetBoxMax.data(), &m_SceneBounds);
+}
 
+UINT CascadedShadowsManager::GetDynamicCasterCascades(CDXUTSDKMesh* pMesh) const
+{
+	UINT uCascadeMask = 0;
+	for (UINT iMesh = 0;iMesh < pMesh->GetNumMeshes();++iMesh)
+	{
+		if (!m_bMeshDynamicCaster[iMesh])
+		{
+			continue;
 		}
-		else if(m_eSelectedNearFarFit == FIT_NEAR_FAR_SCENE_AABB_AND_ORTHO_BOUND || m_eSelectedNearFarFit == FIT_NEAR_FAR_PANCAKING)
+
+		UINT uFirstBox = m_uMeshFirstSubsetBox[iMesh];
+		for (UINT iBox = uFirstBox;iBox < uFirstBox + pMesh->GetNumSubsets(iMesh);++iBox)
 		{
-			//By intersecting the light frustum with the scene AABB we can get a tighter bound on the near and far plane.
-			//ӳAABBͶӰΧһխNearFarPlane
-			ComputeNearAndFarInViewSpace(fNearPlaneInLightView, fFarPlaneInLightView, vOrthographicMinInLightView, vOrthographicMaxInLightView, vSceneAABBPointsInLightView);
+			uCascadeMask |= m_uCasterCascadeMasks[iBox];
+		}
+	}
+	return uCascadeMask;
+}
 
-			if (m_eSelectedNearFarFit == FIT_NEAR_FAR_PANCAKING)
+void CascadedShadowsManager::CopyStaticTiles(ID3D11DeviceContext* pD3dDeviceContext, UINT uCascadeMask)
+{
+	// Each slice of a texture array is a subresource of its own and can be copied whole.
+	if (m_bCascadeTextureArray)
+	{
+		ID3D11RenderTargetView* pNullView = nullptr;
+		pD3dDeviceContext->OMSetRenderTargets(1, &pNullView, nullptr);
+		for (INT iCascade = 0;iCascade < m_CopyOfCascadeConfig.m_nUsingCascadeLevelsCount;++iCascade)
+		{
+			if (uCascadeMask & (1u << iCascade))
 			{
-				if (fOrthographicMinZInLightView > fNearPlaneInLightView)
-				{
-					fNearPlaneInLightView = fOrthographicMinZInLightView;
-				}
+				UINT uSubresource = D3D11CalcSubresource(0, (UINT)iCascade, 1);
+				pD3dDeviceContext->CopySubresourceRegion(m_pCascadedShadowMapTexture, uSubresource, 0, 0, 0,
+					m_pStaticShadowMapTexture, uSubresource, nullptr);
 			}
 		}
-		else
+		return;
+	}
+
+	// A depth stencil resource can't be copied a rectangle at a time,so the tiles of the atlas are drawn over
+	// with the depth of the same texels of the static layer.
+	BindShadowTarget(pD3dDeviceContext, m_pCascadedShadowMapDSV);
+	pD3dDeviceContext->OMSetDepthStencilState(m_pDepthStencilStateAlways, 1);
+	pD3dDeviceContext->IASetInputLayout(nullptr);
+	pD3dDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	pD3dDeviceContext->VSSetShader(m_pClearTileVertexShader, nullptr, 0);
+	pD3dDeviceContext->GSSetShader(nullptr, nullptr, 0);
+	pD3dDeviceContext->PSSetShader(m_pCopyStaticTilePixelShader, nullptr, 0);
+	pD3dDeviceContext->PSSetShaderResources(0, 1, &m_pStaticShadowMapSRV);
+	for (INT iCascade = 0;iCascade < m_CopyOfCascadeConfig.m_nUsingCascadeLevelsCount;++iCascade)
+	{
+		if (uCascadeMask & (1u << iCascade))
 		{
-			//todo
+			pD3dDeviceContext->RSSetViewports(1, &m_RenderViewPort[iCascade]);
+			pD3dDeviceContext->Draw(3, 0);
 		}
-
-		//Create the orthographic projection for this cacscade.
-		m_matOrthoProjForCascades[iCascadeIndex] = DirectX::XMMatrixOrthographicOffCenterLH(
-			XMVectorGetX(vOrthographicMinInLightView), XMVectorGetX(vOrthographicMaxInLightView),
-			XMVectorGetY(vOrthographicMinInLightView), XMVectorGetY(vOrthographicMaxInLightView),
-			fNearPlaneInLightView, fFarPlaneInLightView);
-
-		m_fCascadePartitionDepthsInEyeSpace[iCascadeIndex] = fFrustumPartitionEndDepth;
-
 	}
 
-	m_matShadowView = m_pLightCamera->GetViewMatrix();
-
-	return S_OK;
+	ID3D11ShaderResourceView* pNullSRV = nullptr;
+	pD3dDeviceContext->PSSetShaderResources(0, 1, &pNullSRV);
+	pD3dDeviceContext->PSSetShader(nullptr, nullptr, 0);
+	pD3dDeviceContext->OMSetDepthStencilState(m_pDepthStencilStateLess, 1);
 }
 
-
-// Render the cascades into a texture atlas.
-HRESULT CascadedShadowsManager::RenderShadowForAllCascades(ID3D11Device * pD3dDevice, ID3D11DeviceContext * pD3dDeviceContext, CDXUTSDKMesh * pMesh)
+void CascadedShadowsManager::CullCastersToScrollStrips(CDXUTSDKMesh* pMesh)
 {
-	HRESULT hr = S_OK;
+	if (!m_bCullShadowCasters)
+	{
+		return;
+	}
 
-	XMMATRIX ViewProjection;
+	// The strips of every scrolled cascade are culled in two passes,a cascade with one strip culls it twice and
+	// the other cascades keep their whole projection.
+	DirectX::XMMATRIX matStripProj[2][MAX_CASCADES];
+	for (INT iCascade = 0;iCascade < m_CopyOfCascadeConfig.m_nUsingCascadeLevelsCount;++iCascade)
+	{
+		INT iTileSize = m_iCascadeLengthOfShadowBuffer[iCascade];
+		CascadeTexelRect strips[2];
+		INT nStripCount = 0;
+		if (m_uScrollCascadeMask & (1u << iCascade))
+		{
+			nStripCount = CascadeFitting::GetScrollStrips(m_CascadeScrolls[iCascade], iTileSize, strips);
+		}
+		for (INT iStrip = 0;iStrip < 2;++iStrip)
+		{
+			matStripProj[iStrip][iCascade] = nStripCount > 0
+				? CascadeFitting::GetTexelRectOrthoProj(m_matOrthoProjForCascades[iCascade], strips[std::min(iStrip, nStripCount - 1)], iTileSize)
+				: m_matOrthoProjForCascades[iCascade];
+		}
+	}
+
+	UINT nBoxCount = (UINT)m_uCasterCascadeMasks.size();
+	for (INT iStrip = 0;iStrip < 2;++iStrip)
+	{
+		CascadeFitting::CullCasters(m_SceneBounds, m_matShadowView, m_CopyOfCascadeConfig.m_nUsingCascadeLevelsCount,
+			matStripProj[iStrip], m_uStripCasterMasks.data() + iStrip * nBoxCount);
+	}
 
+	// The dynamic casters are drawn into the whole tile.
+	for (UINT iMesh = 0;iMesh < pMesh->GetNumMeshes();++iMesh)
+	{
+		if (m_bMeshDynamicCaster[iMesh])
+		{
+			continue;
+		}
 
-	pD3dDeviceContext->ClearDepthStencilView(m_pCascadedShadowMapDSV, D3D11_CLEAR_DEPTH, 1.0, 0);
-	ID3D11RenderTargetView* pNullView = nullptr;
+		UINT uFirstBox = m_uMeshFirstSubsetBox[iMesh];
+		for (UINT iBox = uFirstBox;iBox < uFirstBox + pMesh->GetNumSubsets(iMesh);++iBox)
+		{
+			UINT uStripMask = m_uStripCasterMasks[iBox] | m_uStripCasterMasks[nBoxCount + iBox];
+			m_uCasterCascadeMasks[iBox] &= uStripMask | ~m_uScrollCascadeMask;
+		}
+	}
+}
 
-	//Set a null render target so as not to render color.
-	pD3dDeviceContext->OMSetRenderTargets(1, &pNullView, m_pCascadedShadowMapDSV);
+void CascadedShadowsManager::RenderCasterLayer(ID3D11Device* pD3dDevice, ID3D11DeviceContext* pD3dDeviceContext, CDXUTSDKMesh* pMesh,
+	ID3D11DepthStencilView* pDSV, UINT uCascadeMask, bool bClearTiles, bool bDynamic)
+{
+	HRESULT hr;
 
-	if (m_eSelectedNearFarFit == FIT_NEAR_FAR_PANCAKING)
+	// Without deferred contexts the cascades are recorded on the immediate context below.
+	if (m_bMultithreadedShadows && !m_bSinglePassShadows && m_pJobPool != nullptr
+		&& SUCCEEDED(RenderCascadesOnJobPool(pD3dDevice, pD3dDeviceContext, pMesh, pDSV, uCascadeMask, bClearTiles, bDynamic)))
 	{
-		pD3dDeviceContext->RSSetState(m_pRasterizerStateShadowPancake);
+		return;
 	}
-	else
+
+	// A texture array is drawn one slice at a time,except by the single pass:it routes the instances to the slices
+	// with SV_RenderTargetArrayIndex,and as a draw without the geometry shader only reaches the first slice the
+	// slices are cleared whole.
+	bool bBindPerCascade = m_bCascadeTextureArray && !m_bSinglePassShadows;
+	if (!bBindPerCascade)
 	{
-		pD3dDeviceContext->RSSetState(m_pRasterizerStateShadow);
+		BindShadowTarget(pD3dDeviceContext, pDSV);
 	}
 
-	pD3dDeviceContext->OMSetDepthStencilState(m_pDepthStencilStateLess, 1);
-
 	//Iterate over cascades and render shadows;
 	for (INT currentCascade = 0;currentCascade<m_CopyOfCascadeConfig.m_nUsingCascadeLevelsCount;++currentCascade)
 	{
-		// Each cascade has its own viewport because we're storing all the cascades in on large texture
-		pD3dDeviceContext->RSSetViewports(1, &m_RenderViewPort[currentCascade]);
+		if ((uCascadeMask & (1u << currentCascade)) == 0)
+		{
+			continue;
+		}
 
-		//ԭģ;ϵ
-		// We calculate the matrices in th Init function.
-		ViewProjection = m_matShadowView* m_matOrthoProjForCascades[currentCascade];
+		if (m_bCascadeTextureArray && m_bSinglePassShadows)
+		{
+			if (bClearTiles)
+			{
+				pD3dDeviceContext->ClearDepthStencilView(GetCascadeDSV(pDSV, currentCascade), D3D11_CLEAR_DEPTH, 1.0, 0);
+			}
+			continue;
+		}
 
+		if (bBindPerCascade)
+		{
+			BindShadowTarget(pD3dDeviceContext, GetCascadeDSV(pDSV, currentCascade));
+		}
+		m_nShadowDrawCalls += RenderCascade(pD3dDeviceContext, pMesh, currentCascade, bClearTiles, bDynamic);
+	}
 
+	if (m_bSinglePassShadows)
+	{
+		// One instance per cascade of the mask,the geometry shader sends each instance to its cascade's viewport.
 		D3D11_MAPPED_SUBRESOURCE MappedResource;
-		V(pD3dDeviceContext->Map(m_pGlobalConstantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &MappedResource));
-		CB_ALL_SHADOW_DATA* pcbAllShadowConstants = (CB_ALL_SHADOW_DATA*)MappedResource.pData;
+		V(pD3dDeviceContext->Map(m_pShadowCascadesConstantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &MappedResource));
+		CB_SHADOW_CASCADES* pcbShadowCascades = (CB_SHADOW_CASCADES*)MappedResource.pData;
 
-		pcbAllShadowConstants->m_WorldViewProj = DirectX::XMMatrixTranspose(ViewProjection);//ConstantBuffer
-
-		//XMMATRIX Identity = XMMatrixIdentity();
-		
-		//The model was exported in world space ,so we can pass the identity up as the world transform.
-		pcbAllShadowConstants->m_World = DirectX::XMMatrixIdentity();
+		UINT nInstanceCount = 0;
+		for (INT currentCascade = 0;currentCascade<m_CopyOfCascadeConfig.m_nUsingCascadeLevelsCount;++currentCascade)
+		{
+			if (uCascadeMask & (1u << currentCascade))
+			{
+				pcbShadowCascades->m_CascadeViewProj[currentCascade] = DirectX::XMMatrixTranspose(m_matShadowView * m_matOrthoProjForCascades[currentCascade]);
+				pcbShadowCascades->m_uCascadeOfInstance[nInstanceCount++] = currentCascade;
+			}
+		}
+		pD3dDeviceContext->Unmap(m_pShadowCascadesConstantBuffer, 0);
 
-		pD3dDeviceContext->Unmap(m_pGlobalConstantBuffer, 0);
-		pD3dDeviceContext->IASetInputLayout(m_pMeshVertexLayout);
+		pD3dDeviceContext->RSSetViewports(m_CopyOfCascadeConfig.m_nUsingCascadeLevelsCount, m_RenderViewPort);
+		pD3dDeviceContext->IASetInputLayout(m_pShadowVertexLayout);
+		pD3dDeviceContext->VSSetShader(m_pRenderShadowInstancedVertexShader, nullptr, 0);
+		pD3dDeviceContext->GSSetShader(m_pRouteToCascadeGeometryShader, nullptr, 0);
+		pD3dDeviceContext->PSSetShader(nullptr, nullptr, 0);
+		pD3dDeviceContext->VSSetConstantBuffers(1, 1, &m_pShadowCascadesConstantBuffer);
 
+		m_nShadowDrawCalls += RenderCasters(pD3dDeviceContext, pMesh, uCascadeMask, nInstanceCount, bDynamic);
 
-		//No pixel shader is bound as we're only writing out depth.
-		pD3dDeviceContext->VSSetShader(m_pRenderOrthoShadowVertexShader, nullptr, 0);
-		pD3dDeviceContext->PSSetShader(nullptr, nullptr, 0);
 		pD3dDeviceContext->GSSetShader(nullptr, nullptr, 0);
+	}
+}
 
-		pD3dDeviceContext->VSSetConstantBuffers(0, 1, &m_pGlobalConstantBuffer);
+void CascadedShadowsManager::BindShadowTarget(ID3D11DeviceContext* pD3dDeviceContext, ID3D11DepthStencilView* pDSV)
+{
+	ID3D11RenderTargetView* pNullView = nullptr;
 
-		pMesh->Render(pD3dDeviceContext, 0, 1);
-	}
+	//Set a null render target so as not to render color.
+	pD3dDeviceContext->OMSetRenderTargets(1, &pNullView, pDSV);
 
-	pD3dDeviceContext->RSSetState(nullptr);
+	SetShadowRasterizerState(pD3dDeviceContext, false);
 
-	pD3dDeviceContext->OMSetRenderTargets(1, &pNullView, nullptr);
+	pD3dDeviceContext->OMSetDepthStencilState(m_pDepthStencilStateLess, 1);
+}
 
-	return hr;
+void CascadedShadowsManager::SetShadowRasterizerState(ID3D11DeviceContext* pD3dDeviceContext, bool bScissor)
+{
+	if (m_eSelectedNearFarFit == FIT_NEAR_FAR_PANCAKING)
+	{
+		pD3dDeviceContext->RSSetState(bScissor ? m_pRasterizerStateShadowPancakeScissor : m_pRasterizerStateShadowPancake);
+	}
+	else
+	{
+		pD3dDeviceContext->RSSetState(bScissor ? m_pRasterizerStateShadowScissor : m_pRasterizerStateShadow);
+	}
 }
-HRESULT CascadedShadowsManager::RenderScene(ID3D11DeviceContext * pD3dDeviceContext, ID3D11RenderTargetView * pRenderTargetView, ID3D11DepthStencilView * pDepthStencilView,
-	CDXUTSDKMesh * pMesh, CFirstPersonCamera * pActiveCamera, D3D11_VIEWPORT * pViewPort, BOOL bVisualize)
+
+INT CascadedShadowsManager::RenderCascade(ID3D11DeviceContext* pD3dDeviceContext, CDXUTSDKMesh* pMesh, INT iCascade, bool bClearTile, bool bDynamic)
 {
-	HRESULT hr = S_OK;
+	if ((!bDynamic && (m_uScrollCascadeMask & (1u << iCascade)) != 0) || m_iTileOriginX[iCascade] != 0 || m_iTileOriginY[iCascade] != 0)
+	{
+		return RenderWrappedCascade(pD3dDeviceContext, pMesh, iCascade, bClearTile, bDynamic);
+	}
 
-	D3D11_MAPPED_SUBRESOURCE MappedResource;
+	// Each cascade has its own viewport because we're storing all the cascades in on large texture
+	pD3dDeviceContext->RSSetViewports(1, &m_RenderViewPort[iCascade]);
 
-	//we have a separate render state for the actual rasterization because of different depth biases and Cull modes.
-	pD3dDeviceContext->RSSetState(m_pRasterizerStateScene);
+	if (bClearTile)
+	{
+		ClearTile(pD3dDeviceContext);
+	}
 
-	pD3dDeviceContext->OMSetRenderTargets(1, &pRenderTargetView, pDepthStencilView);
+	// The casters of all cascades are drawn at once by the caller.
+	if (m_bSinglePassShadows)
+	{
+		return 0;
+	}
+
+	return DrawCascadeCasters(pD3dDeviceContext, pMesh, iCascade, bDynamic);
+}
+
+INT CascadedShadowsManager::RenderWrappedCascade(ID3D11DeviceContext* pD3dDeviceContext, CDXUTSDKMesh* pMesh, INT iCascade, bool bClearTile, bool bDynamic)
+{
+	INT iTileSize = m_iCascadeLengthOfShadowBuffer[iCascade];
+
+	// The static casters of a scrolled tile only go into the strips that scrolled in,and those still hold the
+	// texels that scrolled out.Everything else covers the whole tile.
+	CascadeTexelRect rects[2];
+	INT nRectCount = 1;
+	if (!bDynamic && (m_uScrollCascadeMask & (1u << iCascade)) != 0)
+	{
+		nRectCount = CascadeFitting::GetScrollStrips(m_CascadeScrolls[iCascade], iTileSize, rects);
+		bClearTile = true;
+	}
+	else
+	{
+		rects[0].m_iLeft = 0;
+		rects[0].m_iTop = 0;
+		rects[0].m_iRight = iTileSize;
+		rects[0].m_iBottom = iTileSize;
+	}
+
+	SetShadowRasterizerState(pD3dDeviceContext, true);
+
+	INT nDrawCalls = 0;
+	for (INT iRect = 0;iRect < nRectCount;++iRect)
+	{
+		// Texel x of the projection is stored at x + origin,or x + origin - size once that runs past the tile.
+		for (INT iWrapY = 0;iWrapY < 2;++iWrapY)
+		{
+			for (INT iWrapX = 0;iWrapX < 2;++iWrapX)
+			{
+				INT iOffsetX = m_iTileOriginX[iCascade] - iWrapX * iTileSize;
+				INT iOffsetY = m_iTileOriginY[iCascade] - iWrapY * iTileSize;
+
+				D3D11_RECT scissorRect;
+				scissorRect.left = std::max(rects[iRect].m_iLeft + iOffsetX, 0);
+				scissorRect.top = std::max(rects[iRect].m_iTop + iOffsetY, 0);
+				scissorRect.right = std::min(rects[iRect].m_iRight + iOffsetX, iTileSize);
+				scissorRect.bottom = std::min(rects[iRect].m_iBottom + iOffsetY, iTileSize);
+				if (scissorRect.left >= scissorRect.right || scissorRect.top >= scissorRect.bottom)
+				{
+					continue;
+				}
+
+				D3D11_VIEWPORT viewPort = m_RenderViewPort[iCascade];
+				scissorRect.left += (LONG)viewPort.TopLeftX;
+				scissorRect.right += (LONG)viewPort.TopLeftX;
+				scissorRect.top += (LONG)viewPort.TopLeftY;
+				scissorRect.bottom += (LONG)viewPort.TopLeftY;
+				viewPort.TopLeftX += (FLOAT)iOffsetX;
+				viewPort.TopLeftY += (FLOAT)iOffsetY;
+				pD3dDeviceContext->RSSetViewports(1, &viewPort);
+				pD3dDeviceContext->RSSetScissorRects(1, &scissorRect);
+
+				if (bClearTile)
+				{
+					ClearTile(pD3dDeviceContext);
+				}
+				nDrawCalls += DrawCascadeCasters(pD3dDeviceContext, pMesh, iCascade, bDynamic);
+			}
+		}
+	}
+
+	SetShadowRasterizerState(pD3dDeviceContext, false);
+	return nDrawCalls;
+}
+
+void CascadedShadowsManager::ClearTile(ID3D11DeviceContext* pD3dDeviceContext)
+{
+	pD3dDeviceContext->OMSetDepthStencilState(m_pDepthStencilStateAlways, 1);
+	pD3dDeviceContext->IASetInputLayout(nullptr);
+	pD3dDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	pD3dDeviceContext->VSSetShader(m_pClearTileVertexShader, nullptr, 0);
+	pD3dDeviceContext->PSSetShader(nullptr, nullptr, 0);
+	pD3dDeviceContext->GSSetShader(nullptr, nullptr, 0);
+	pD3dDeviceContext->Draw(3, 0);
+	pD3dDeviceContext->OMSetDepthStencilState(m_pDepthStencilStateLess, 1);
+}
+
+ID3D11DepthStencilView* CascadedShadowsManager::GetCascadeDSV(ID3D11DepthStencilView* pDSV, INT iCascade) const
+{
+	if (!m_bCascadeTextureArray)
+	{
+		return pDSV;
+	}
+	return pDSV == m_pStaticShadowMapDSV ? m_pStaticShadowMapSliceDSVs[iCascade] : m_pCascadedShadowMapSliceDSVs[iCascade];
+}
+
+INT CascadedShadowsManager::DrawCascadeCasters(ID3D11DeviceContext* pD3dDeviceContext, CDXUTSDKMesh* pMesh, INT iCascade, bool bDynamic)
+{
+	pD3dDeviceContext->IASetInputLayout(m_pShadowVertexLayout);
+
+
+	//No pixel shader is bound as we're only writing out depth.
+	pD3dDeviceContext->VSSetShader(m_pRenderOrthoShadowVertexShader, nullptr, 0);
+	pD3dDeviceContext->PSSetShader(nullptr, nullptr, 0);
+	pD3dDeviceContext->GSSetShader(nullptr, nullptr, 0);
+
+	BindCascadeConstants(pD3dDeviceContext, iCascade);
+
+	return RenderCasters(pD3dDeviceContext, pMesh, 1u << iCascade, 1, bDynamic);
+}
+
+HRESULT CascadedShadowsManager::WriteCascadeConstants(ID3D11DeviceContext* pD3dDeviceContext, UINT uCascadeMask)
+{
+	HRESULT hr = S_OK;
+	D3D11_MAPPED_SUBRESOURCE MappedResource;
+
+	if (m_pCascadeConstantRing != nullptr)
+	{
+		// The GPU may still read the slots of earlier frames,so the ring is only discarded when it wraps.
+		bool bDiscard = CascadeFitting::AllocateCascadeRingSlots(uCascadeMask, m_CopyOfCascadeConfig.m_nUsingCascadeLevelsCount,
+			CASCADE_CONSTANT_RING_SLOTS, &m_uCascadeRingNextSlot, m_uCascadeRingSlot);
+		D3D11_MAP eMapType = bDiscard ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+
+		V_RETURN(pD3dDeviceContext->Map(m_pCascadeConstantRing, 0, eMapType, 0, &MappedResource));
+		for (INT iCascade = 0;iCascade < m_CopyOfCascadeConfig.m_nUsingCascadeLevelsCount;++iCascade)
+		{
+			if (uCascadeMask & (1u << iCascade))
+			{
+				CB_PER_CASCADE* pcbPerCascade = (CB_PER_CASCADE*)((BYTE*)MappedResource.pData + m_uCascadeRingSlot[iCascade] * CB_PER_CASCADE_SLOT_SIZE);
+				pcbPerCascade->m_ViewProj = DirectX::XMMatrixTranspose(m_matShadowView * m_matOrthoProjForCascades[iCascade]);
+			}
+		}
+		pD3dDeviceContext->Unmap(m_pCascadeConstantRing, 0);
+
+		return hr;
+	}
+
+	for (INT iCascade = 0;iCascade < m_CopyOfCascadeConfig.m_nUsingCascadeLevelsCount;++iCascade)
+	{
+		if (uCascadeMask & (1u << iCascade))
+		{
+			V_RETURN(pD3dDeviceContext->Map(m_pCascadeConstantBuffers[iCascade], 0, D3D11_MAP_WRITE_DISCARD, 0, &MappedResource));
+			CB_PER_CASCADE* pcbPerCascade = (CB_PER_CASCADE*)MappedResource.pData;
+			pcbPerCascade->m_ViewProj = DirectX::XMMatrixTranspose(m_matShadowView * m_matOrthoProjForCascades[iCascade]);
+			pD3dDeviceContext->Unmap(m_pCascadeConstantBuffers[iCascade], 0);
+		}
+	}
+
+	return hr;
+}
+
+void CascadedShadowsManager::BindCascadeConstants(ID3D11DeviceContext* pD3dDeviceContext, INT iCascade)
+{
+#ifdef USE_DIRECT3D11_1
+	if (m_pCascadeConstantRing != nullptr)
+	{
+		// Deferred contexts of a D3D 11.1 device are ID3D11DeviceContext1 as well.
+		ID3D11DeviceContext1* pD3dDeviceContext1 = nullptr;
+		if (SUCCEEDED(pD3dDeviceContext->QueryInterface(__uuidof(ID3D11DeviceContext1), (void**)&pD3dDeviceContext1)))
+		{
+			UINT uFirstConstant = m_uCascadeRingSlot[iCascade] * CB_PER_CASCADE_SLOT_CONSTANTS;
+			UINT uNumConstants = CB_PER_CASCADE_SLOT_CONSTANTS;
+			pD3dDeviceContext1->VSSetConstantBuffers1(0, 1, &m_pCascadeConstantRing, &uFirstConstant, &uNumConstants);
+			SAFE_RELEASE(pD3dDeviceContext1);
+		}
+		return;
+	}
+#endif
+
+	pD3dDeviceContext->VSSetConstantBuffers(0, 1, &m_pCascadeConstantBuffers[iCascade]);
+}
+
+HRESULT CascadedShadowsManager::RenderCascadesOnJobPool(ID3D11Device* pD3dDevice, ID3D11DeviceContext* pD3dDeviceContext, CDXUTSDKMesh* pMesh,
+	ID3D11DepthStencilView* pDSV, UINT uCascadeMask, bool bClearTiles, bool bDynamic)
+{
+	HRESULT hr = S_OK;
+
+	for (INT iCascade = 0;iCascade < m_CopyOfCascadeConfig.m_nUsingCascadeLevelsCount;++iCascade)
+	{
+		if (m_pCascadeDeferredContexts[iCascade] == nullptr)
+		{
+			hr = pD3dDevice->CreateDeferredContext(0, &m_pCascadeDeferredContexts[iCascade]);
+			if (FAILED(hr))
+			{
+				return hr;
+			}
+		}
+	}
+
+	// Each job only touches its own cascade:the deferred context,the command list and the counters.
+	for (INT iCascade = 0;iCascade < m_CopyOfCascadeConfig.m_nUsingCascadeLevelsCount;++iCascade)
+	{
+		if ((uCascadeMask & (1u << iCascade)) == 0)
+		{
+			continue;
+		}
+
+		m_pJobPool->Submit([this, pMesh, pDSV, iCascade, bClearTiles, bDynamic]()
+		{
+			ID3D11DeviceContext* pDeferredContext = m_pCascadeDeferredContexts[iCascade];
+			BindShadowTarget(pDeferredContext, GetCascadeDSV(pDSV, iCascade));
+			m_nCascadeDrawCalls[iCascade] = RenderCascade(pDeferredContext, pMesh, iCascade, bClearTiles, bDynamic);
+			pDeferredContext->FinishCommandList(FALSE, &m_pCascadeCommandLists[iCascade]);
+		});
+	}
+	m_pJobPool->WaitForAll();
+
+	// Executing a list leaves the immediate context in its default state,the next list binds everything it uses.
+	for (INT iCascade = 0;iCascade < m_CopyOfCascadeConfig.m_nUsingCascadeLevelsCount;++iCascade)
+	{
+		if (m_pCascadeCommandLists[iCascade] != nullptr)
+		{
+			pD3dDeviceContext->ExecuteCommandList(m_pCascadeCommandLists[iCascade], FALSE);
+			SAFE_RELEASE(m_pCascadeCommandLists[iCascade]);
+			m_nShadowDrawCalls += m_nCascadeDrawCalls[iCascade];
+		}
+	}
+
+	return hr;
+}
+
+//The scene is exported in world space with one frame per mesh,so the meshes are drawn directly instead of
+//walking the frame hierarchy like CDXUTSDKMesh::Render.
+INT CascadedShadowsManager::RenderCasters(ID3D11DeviceContext* pD3dDeviceContext, CDXUTSDKMesh* pMesh, UINT uCascadeMask, UINT nInstanceCount, bool bDynamic)
+{
+	// A level may move the surface by m_fCasterLodTexels texels of the finest cascade it is drawn into,
+	// the cascade scale is 2 / (units per texel * the tile length).
+	FLOAT fMaxLodError = -1.0f;
+	if (m_bCasterLods)
+	{
+		fMaxLodError = FLT_MAX;
+		for (INT iCascade = 0;iCascade < MAX_CASCADES;++iCascade)
+		{
+			if (uCascadeMask & (1u << iCascade))
+			{
+				FLOAT fBufferSize = (FLOAT)m_iCascadeLengthOfShadowBuffer[iCascade];
+				FLOAT fScale = std::max(XMVectorGetX(m_matOrthoProjForCascades[iCascade].r[0]), XMVectorGetY(m_matOrthoProjForCascades[iCascade].r[1]));
+				fMaxLodError = std::min(fMaxLodError, m_fCasterLodTexels * 2.0f / (fScale * fBufferSize));
+			}
+		}
+	}
+
+	INT nDrawCalls = 0;
+	for (UINT iMesh = 0;iMesh < pMesh->GetNumMeshes();++iMesh)
+	{
+		if (m_bMeshDynamicCaster[iMesh] != bDynamic)
+		{
+			continue;
+		}
+
+		UINT uFirstBox = m_uMeshFirstSubsetBox[iMesh];
+		UINT nSubsetCount = pMesh->GetNumSubsets(iMesh);
+
+		INT nDrawnCount = 0;
+		UINT64 nDrawnVertexCount = 0;
+		for (UINT iSubset = 0;iSubset < nSubsetCount;++iSubset)
+		{
+			if (m_uCasterCascadeMasks[uFirstBox + iSubset] & uCascadeMask)
+			{
+				++nDrawnCount;
+				nDrawnVertexCount += pMesh->GetSubset(iMesh, iSubset)->VertexCount;
+			}
+		}
+
+		// In a single pass every subset that is drawn reaches all instances.
+		for (INT iCascade = 0;iCascade < MAX_CASCADES;++iCascade)
+		{
+			if (uCascadeMask & (1u << iCascade))
+			{
+				m_nCastersDrawn[iCascade] += nDrawnCount;
+				m_nCastersCulled[iCascade] += (INT)nSubsetCount - nDrawnCount;
+			}
+		}
+		nDrawCalls += nDrawnCount;
+		if (nDrawnCount == 0)
+		{
+			continue;
+		}
+
+		//Only the position is read by the shadow vertex shader,from the position stream it is all that is fetched.
+		ID3D11Buffer* pVB = m_bPositionOnlyCasters ? pMesh->GetPositionVB11(iMesh) : nullptr;
+		UINT uStride = CDXUTSDKMesh::GetPositionStride();
+		if (pVB == nullptr)
+		{
+			pVB = pMesh->GetVB11(iMesh, 0);
+			uStride = pMesh->GetVertexStride(iMesh, 0);
+		}
+		UINT uOffset = 0;
+		for (INT iCascade = 0;iCascade < MAX_CASCADES;++iCascade)
+		{
+			if (uCascadeMask & (1u << iCascade))
+			{
+				m_uShadowVertexBytes[iCascade] += nDrawnVertexCount * uStride;
+			}
+		}
+		pD3dDeviceContext->IASetVertexBuffers(0, 1, &pVB, &uStride, &uOffset);
+
+		// The levels index the vertices of the full subset,only the index buffer changes with the level.
+		ID3D11Buffer* pBoundIB = nullptr;
+		UINT64 nDrawnTriangleCount = 0;
+		for (UINT iSubset = 0;iSubset < nSubsetCount;++iSubset)
+		{
+			if ((m_uCasterCascadeMasks[uFirstBox + iSubset] & uCascadeMask) == 0)
+			{
+				continue;
+			}
+
+			SDKMESH_SUBSET* pSubset = pMesh->GetSubset(iMesh, iSubset);
+			UINT uIndexCount = (UINT)pSubset->IndexCount;
+			UINT uIndexStart = (UINT)pSubset->IndexStart;
+			ID3D11Buffer* pIB = pMesh->GetIB11(iMesh);
+			UINT uFirstLod = m_uSubsetFirstLod[uFirstBox + iSubset];
+			INT iLod = MeshSimplification::SelectLod(m_CasterLods.data() + uFirstLod,
+				(INT)(m_uSubsetFirstLod[uFirstBox + iSubset + 1] - uFirstLod), fMaxLodError);
+			if (iLod > 0)
+			{
+				const MeshLod& lod = m_CasterLods[uFirstLod + iLod - 1];
+				uIndexCount = (UINT)lod.m_nIndexCount;
+				uIndexStart = (UINT)lod.m_iFirstIndex;
+				pIB = m_pCasterLodIndexBuffers[iMesh];
+			}
+			if (pIB != pBoundIB)
+			{
+				pD3dDeviceContext->IASetIndexBuffer(pIB, pMesh->GetIBFormat11(iMesh), 0);
+				pBoundIB = pIB;
+			}
+			nDrawnTriangleCount += uIndexCount / 3;
+
+			pD3dDeviceContext->IASetPrimitiveTopology(CDXUTSDKMesh::GetPrimitiveType11((SDKMESH_PRIMITIVE_TYPE)pSubset->PrimitiveType));
+			if (nInstanceCount == 1)
+			{
+				pD3dDeviceContext->DrawIndexed(uIndexCount, uIndexStart, (INT)pSubset->VertexStart);
+			}
+			else
+			{
+				pD3dDeviceContext->DrawIndexedInstanced(uIndexCount, nInstanceCount, uIndexStart, (INT)pSubset->VertexStart, 0);
+			}
+		}
+
+		for (INT iCascade = 0;iCascade < MAX_CASCADES;++iCascade)
+		{
+			if (uCascadeMask & (1u << iCascade))
+			{
+				m_nCascadeTriangles[iCascade] += nDrawnTriangleCount;
+			}
+		}
+	}
+
+	return nDrawCalls;
+}
+//The far cascades cover many world units with a texel,the detail they can't resolve is simplified away once at load.
+//Each level is stored after the ones before in an index buffer per mesh,with index values relative to the subset's
+//VertexStart like the mesh's own.
+HRESULT CascadedShadowsManager::BuildCasterLods(ID3D11Device* pD3DDevice, CDXUTSDKMesh* pMesh)
+{
+	HRESULT hr = S_OK;
+
+	ReleaseCasterLods();
+	m_pCasterLodIndexBuffers.assign(pMesh->GetNumMeshes(), nullptr);
+	m_uSubsetFirstLod.assign(1, 0);
+
+	for (UINT i = 0;i<pMesh->GetNumMeshes();++i)
+	{
+		SDKMESH_MESH* mesh = pMesh->GetMesh(i);
+		const BYTE* pVertices = pMesh->GetRawVerticesAt(mesh->VertexBuffers[0]);
+		const BYTE* pIndexData = pMesh->GetRawIndicesAt(mesh->IndexBuffer);
+		bool b32BitIndices = pMesh->GetIndexType(i) == IT_32BIT;
+		UINT uStride = pMesh->GetVertexStride(i, 0);
+
+		std::vector<UINT> meshLodIndices;
+		std::vector<UINT> subsetIndices;
+		for (UINT iSubset = 0;iSubset<pMesh->GetNumSubsets(i);++iSubset)
+		{
+			SDKMESH_SUBSET* pSubset = pMesh->GetSubset(i, iSubset);
+			if (pVertices != nullptr && pIndexData != nullptr && pSubset->PrimitiveType == PT_TRIANGLE_LIST && pSubset->IndexCount >= 3)
+			{
+				subsetIndices.resize((size_t)pSubset->IndexCount);
+				for (UINT64 iIndex = 0;iIndex<pSubset->IndexCount;++iIndex)
+				{
+					subsetIndices[(size_t)iIndex] = b32BitIndices ? ((const UINT*)pIndexData)[pSubset->IndexStart + iIndex] :
+						((const USHORT*)pIndexData)[pSubset->IndexStart + iIndex];
+				}
+
+				// The position is the first element of the sample's vertex layout.
+				MeshLodChain chain;
+				MeshSimplification::BuildLodChain(pVertices + pSubset->VertexStart * uStride, (INT)uStride, subsetIndices.data(),
+					(INT)subsetIndices.size(), CASTER_LOD_COUNT, 0.5f, CASTER_LOD_MAX_ERROR, &chain);
+				for (const MeshLod& lod : chain.m_Lods)
+				{
+					MeshLod meshLod = lod;
+					meshLod.m_iFirstIndex += (INT)meshLodIndices.size();
+					m_CasterLods.push_back(meshLod);
+				}
+				meshLodIndices.insert(meshLodIndices.end(), chain.m_Indices.begin(), chain.m_Indices.end());
+			}
+			m_uSubsetFirstLod.push_back((UINT)m_CasterLods.size());
+		}
+
+		if (meshLodIndices.empty())
+		{
+			continue;
+		}
+
+		std::vector<USHORT> meshLodIndices16;
+		if (!b32BitIndices)
+		{
+			meshLodIndices16.assign(meshLodIndices.begin(), meshLodIndices.end());
+		}
+
+		D3D11_BUFFER_DESC bufferDesc;
+		ZeroMemory(&bufferDesc, sizeof(bufferDesc));
+		bufferDesc.ByteWidth = (UINT)(meshLodIndices.size() * (b32BitIndices ? sizeof(UINT) : sizeof(USHORT)));
+		bufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+		bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+		D3D11_SUBRESOURCE_DATA initData;
+		ZeroMemory(&initData, sizeof(initData));
+		initData.pSysMem = b32BitIndices ? (const void*)meshLodIndices.data() : (const void*)meshLodIndices16.data();
+		V_RETURN(pD3DDevice->CreateBuffer(&bufferDesc, &initData, &m_pCasterLodIndexBuffers[i]));
+		DXUT_SetDebugName(m_pCasterLodIndexBuffers[i], "CasterLodIndices");
+		m_uCasterLodBytes += bufferDesc.ByteWidth;
+	}
+
+	return hr;
+}
+
+void CascadedShadowsManager::ReleaseCasterLods()
+{
+	for (size_t i = 0;i < m_pCasterLodIndexBuffers.size();++i)
+	{
+		if (m_pMemoryTracker != nullptr)
+		{
+			m_pMemoryTracker->Untrack(m_pCasterLodIndexBuffers[i]);
+		}
+		SAFE_RELEASE(m_pCasterLodIndexBuffers[i]);
+	}
+	m_pCasterLodIndexBuffers.clear();
+	m_CasterLods.clear();
+	m_uSubsetFirstLod.clear();
+	m_uCasterLodBytes = 0;
+}
+
+HRESULT CascadedShadowsManager::RenderScene(ID3D11DeviceContext * pD3dDeviceContext, ID3D11RenderTargetView * pRenderTargetView, ID3D11DepthStencilView * pDepthStencilView,
+	CDXUTSDKMesh * pMesh, CFirstPersonCamera * pActiveCamera, D3D11_VIEWPORT * pViewPort, BOOL bVisualize)
+{
+	HRESULT hr = S_OK;
+
+	D3D11_MAPPED_SUBRESOURCE MappedResource;
+
+	//we have a separate render state for the actual rasterization because of different depth biases and Cull modes.
+	pD3dDeviceContext->RSSetState(m_pRasterizerStateScene);
+
+	pD3dDeviceContext->OMSetRenderTargets(1, &pRenderTargetView, pDepthStencilView);
 	pD3dDeviceContext->RSSetViewports(1, pViewPort);
 	pD3dDeviceContext->IASetInputLayout(m_pMeshVertexLayout);
 
@@ -663,12 +1649,18 @@ HRESULT CascadedShadowsManager::RenderScene(ID3D11DeviceContext * pD3dDeviceCont
 
 	XMMATRIX WorldViewProjection = CameraView*CameraProj;//jingzԭģѾʹϵ
 
-	V(pD3dDeviceContext->Map(m_pGlobalConstantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &MappedResource));
+	V(pD3dDeviceContext->Map(m_pPerObjectConstantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &MappedResource));
+
+	CB_PER_OBJECT* pcbPerObject = (CB_PER_OBJECT*)MappedResource.pData;
 
-	CB_ALL_SHADOW_DATA* pcbAllShadowConstants = (CB_ALL_SHADOW_DATA*)MappedResource.pData;
+	pcbPerObject->m_WorldViewProj = XMMatrixTranspose(WorldViewProjection);
+	pcbPerObject->m_WorldView = XMMatrixTranspose(CameraView);
+	pcbPerObject->m_World = XMMatrixIdentity();
+	pD3dDeviceContext->Unmap(m_pPerObjectConstantBuffer, 0);
 
-	pcbAllShadowConstants->m_WorldViewProj = XMMatrixTranspose(WorldViewProjection);
-	pcbAllShadowConstants->m_WorldView = XMMatrixTranspose(CameraView);
+	V(pD3dDeviceContext->Map(m_pShadowFrameConstantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &MappedResource));
+
+	CB_SHADOW_FRAME* pcbAllShadowConstants = (CB_SHADOW_FRAME*)MappedResource.pData;
 
 	//There are the for loop begin end values.
 	pcbAllShadowConstants->m_iPCFBlurForLoopEnd = m_iPCFBlurSize / 2 + 1;
@@ -676,20 +1668,26 @@ HRESULT CascadedShadowsManager::RenderScene(ID3D11DeviceContext * pD3dDeviceCont
 
 	//This is a floating point number that is used as percentage to blur between maps
 	pcbAllShadowConstants->m_fMaxBlendRatioBetweenCascadeLevel = m_fMaxBlendRatioBetweenCascadeLevel;
-	pcbAllShadowConstants->m_fLogicStepPerTexel = 1.0f / (float)m_CopyOfCascadeConfig.m_iLengthOfShadowBufferSquare;
-	pcbAllShadowConstants->m_fNativeCascadedShadowMapTexelStepInX = pcbAllShadowConstants->m_fLogicStepPerTexel / m_CopyOfCascadeConfig.m_nUsingCascadeLevelsCount;
-	pcbAllShadowConstants->m_World = XMMatrixIdentity();
 
 	XMMATRIX TextureScale = XMMatrixScaling(0.5f, -0.5f, 1.0f);
 	XMMATRIX TextureTranslation = XMMatrixTranslation(0.5f,0.5f,0.0f);
 
 	pcbAllShadowConstants->m_fPCFShadowDepthBiaFromGUI = m_fPCFShadowDepthBia;
-	pcbAllShadowConstants->m_fWidthPerShadowTextureLevel_InU = 1.0f / (float)m_CopyOfCascadeConfig.m_nUsingCascadeLevelsCount;
+	pcbAllShadowConstants->m_iIsCascadeTextureArray = m_bCascadeTextureArray ? 1 : 0;
 
 	pcbAllShadowConstants->m_ShadowView = XMMatrixTranspose(m_matShadowView);
 
+	// The tiles can have different lengths,each one is addressed through its packed rect.
+	FLOAT fAtlasWidth = (FLOAT)m_iShadowAtlasWidth;
+	FLOAT fAtlasHeight = (FLOAT)m_iShadowAtlasHeight;
 	for (int index = 0;index<m_CopyOfCascadeConfig.m_nUsingCascadeLevelsCount;++index)
 	{
+		const AtlasRect& rect = m_CascadeAtlasRects[index];
+		pcbAllShadowConstants->m_vTileRectInUV[index] = XMVectorSet((FLOAT)rect.m_iX / fAtlasWidth, (FLOAT)rect.m_iY / fAtlasHeight,
+			(FLOAT)rect.m_iWidth / fAtlasWidth, (FLOAT)rect.m_iHeight / fAtlasHeight);
+		pcbAllShadowConstants->m_vTileTexelSizeInUV[index] = XMVectorSet(1.0f / (FLOAT)rect.m_iWidth, 1.0f / (FLOAT)rect.m_iHeight,
+			1.0f / fAtlasWidth, 1.0f / fAtlasHeight);
+
 		//jingz TextureScale/TextureTranslation ΪNDCؿռתyȡxy/2+0.5
 		XMMATRIX mShadowProjToTextureCoord = m_matOrthoProjForCascades[index] * TextureScale*TextureTranslation;
 		XMFLOAT4X4 ShadowProjToTextureCoord;
@@ -710,17 +1708,25 @@ HRESULT CascadedShadowsManager::RenderScene(ID3D11DeviceContext * pD3dDeviceCont
 		pcbAllShadowConstants->m_fCascadePartitionDepthsInEyeSpace_OnlyX[index+1].x = m_fCascadePartitionDepthsInEyeSpace[index];
 	}
 
-	//The border padding values keep the pixel shader from reading the borders during PCF filtering.
-	pcbAllShadowConstants->m_fMaxBorderPaddingInShadowUV = (float)(m_pCascadeConfig->m_iLengthOfShadowBufferSquare - 1.0f) / (float)m_pCascadeConfig->m_iLengthOfShadowBufferSquare;
-	pcbAllShadowConstants->m_fMinBorderPaddingInShadowUV = (float)(1.0f) / (float)m_pCascadeConfig->m_iLengthOfShadowBufferSquare;
-
 	XMFLOAT3 ep;
 	XMStoreFloat3(&ep, XMVector3Normalize(m_pLightCamera->GetEyePt() - m_pLightCamera->GetLookAtPt()));
 	
 	pcbAllShadowConstants->m_vLightDir = XMVectorSet(ep.x, ep.y, ep.z, 1.0f);
 	pcbAllShadowConstants->m_nCascadeLeves = m_CopyOfCascadeConfig.m_nUsingCascadeLevelsCount;
 	pcbAllShadowConstants->m_iIsVisualizeCascade = bVisualize?1:0;//jingz todo
-	pD3dDeviceContext->Unmap(m_pGlobalConstantBuffer, 0);
+
+	// Tiles that were never scrolled skip the wrapping in the pixel shader.
+	pcbAllShadowConstants->m_iIsToroidalTiles = 0;
+	for (int index = 0;index < m_CopyOfCascadeConfig.m_nUsingCascadeLevelsCount;++index)
+	{
+		FLOAT fTileSize = (FLOAT)m_iCascadeLengthOfShadowBuffer[index];
+		pcbAllShadowConstants->m_vTileOriginInUV[index] = XMVectorSet((FLOAT)m_iTileOriginX[index] / fTileSize, (FLOAT)m_iTileOriginY[index] / fTileSize, 0.0f, 0.0f);
+		if (m_iTileOriginX[index] != 0 || m_iTileOriginY[index] != 0)
+		{
+			pcbAllShadowConstants->m_iIsToroidalTiles = 1;
+		}
+	}
+	pD3dDeviceContext->Unmap(m_pShadowFrameConstantBuffer, 0);
 
 	pD3dDeviceContext->PSSetSamplers(0, 1, &m_pSamLinear);
 	pD3dDeviceContext->PSSetSamplers(1, 1, &m_pSamLinear);
@@ -741,8 +1747,9 @@ HRESULT CascadedShadowsManager::RenderScene(ID3D11DeviceContext * pD3dDeviceCont
 
 	pD3dDeviceContext->PSSetShaderResources(5, 1, &m_pCascadedShadowMapSRV);
 
-	pD3dDeviceContext->VSSetConstantBuffers(0, 1, &m_pGlobalConstantBuffer);
-	pD3dDeviceContext->PSSetConstantBuffers(0, 1, &m_pGlobalConstantBuffer);
+	pD3dDeviceContext->VSSetConstantBuffers(0, 1, &m_pPerObjectConstantBuffer);
+	pD3dDeviceContext->VSSetConstantBuffers(1, 1, &m_pShadowFrameConstantBuffer);
+	pD3dDeviceContext->PSSetConstantBuffers(1, 1, &m_pShadowFrameConstantBuffer);
 
 	pMesh->Render(pD3dDeviceContext, 0, 1);
 
@@ -752,373 +1759,66 @@ HRESULT CascadedShadowsManager::RenderScene(ID3D11DeviceContext * pD3dDeviceCont
 	return hr;
 }
 
-struct Triangle
+HRESULT CascadedShadowsManager::ReduceDepthBounds(ID3D11DeviceContext * pD3dDeviceContext, ID3D11ShaderResourceView * pSceneDepthSRV, UINT uWidth, UINT uHeight)
 {
-	XMVECTOR points[3];
-	BOOL culled;
-};
-
-enum FRUSTUM_PLANE_FLAG
-{
-	FRUSTUM_PLANE_LEFT = 0,
-	FRUSTUM_PLANE_RIGHT,
-	FRUSTUM_PLANE_BOTTOM,
-	FRUSTUM_PLANE_UP,
-	FRUSTUM_PLANE_COUNT,
-};
-
-
-// Computing an accurate near and far plane will decrease surface ance and Peter-panning
-// Surface acne is the term for erroneous self shadowing.Peter-panning is the effect where
-// shadows disappear near the base of an object.
-// As offsets are generally used with PCF filtering due self shadowing issues,computing the
-// This concept is not complicated,but the intersection code is
-void CascadedShadowsManager::ComputeNearAndFarInViewSpace(FLOAT & fNearPlane, FLOAT & fFarPlane, DirectX::FXMVECTOR vOrthographicMin, DirectX::FXMVECTOR vOrthographicMax, DirectX::XMVECTOR * pPointInView)
-{
-	// Initialize the near and far plane
-	fNearPlane = FLT_MAX;
-	fFarPlane = -FLT_MAX;
-
-	Triangle triangleList[16];//jingz ÿfrustum߲üɶٸΣ
-	INT iTriangleCount = 1;
-
-	triangleList[0].points[0] = pPointInView[0];
-	triangleList[0].points[1] = pPointInView[1];
-	triangleList[0].points[2] = pPointInView[2];
-	triangleList[0].culled = false;
-
-	// These are the indices uesed to tesselate an AABB into a list of triangles.
-	static const INT iPointIndices[] =
-	{
-		0,1,2,1,2,3,
-		4,5,6,5,6,7,
-		0,2,4,2,4,6,
-		1,3,5,3,5,7,
-		0,1,4,1,4,5,
-		2,3,6,3,6,7
-	};
-
-	bool bPointPassesCollision[3];
-
-	// At a high level
-	// 1. Iterate over all 6*2 triangles of the AABB
-	// 2. Clip the triangles against each plane,Create new triangle as needed
-	// 3. Find the min and max z values as the near and far plane.
-	
-	//This is easier because the triangles are in camera spacing making the collisions tests sample comparisions.
-
-	float fLightCameraOrthographicMinX = XMVectorGetX(vOrthographicMin);
-	float fLightCameraOrthographicMaxX = XMVectorGetX(vOrthographicMax);
-	float fLightCameraOrthographicMinY = XMVectorGetY(vOrthographicMin);
-	float fLightCameraOrthographicMaxY = XMVectorGetY(vOrthographicMax);
-
-	for (INT iTriangleIndex = 0;iTriangleIndex<12;++iTriangleIndex)
+	if (!m_bFitToDepthBounds || pSceneDepthSRV == nullptr)
 	{
-		triangleList[0].points[0] = pPointInView[iPointIndices[iTriangleIndex * 3 + 0]];
-		triangleList[0].points[1] = pPointInView[iPointIndices[iTriangleIndex * 3 + 1]];
-		triangleList[0].points[2] = pPointInView[iPointIndices[iTriangleIndex * 3 + 2]];
-
-		iTriangleCount = 1;
-		triangleList[0].culled = FALSE;
-
-		//Clip each individual triangle against the 4 frustums.When ever a triangle is clipped into new triangles,
-		// add them to the list.
-		for (INT frustumPlaneFlag = FRUSTUM_PLANE_LEFT;frustumPlaneFlag<FRUSTUM_PLANE_COUNT;++frustumPlaneFlag)
-		{
-			FLOAT fEdge;
-			INT iComponent;
-			if (frustumPlaneFlag == FRUSTUM_PLANE_LEFT)
-			{
-				fEdge = fLightCameraOrthographicMinX;//Left
-				iComponent = 0;
-			}
-			else if (frustumPlaneFlag == FRUSTUM_PLANE_RIGHT)
-			{
-				fEdge = fLightCameraOrthographicMaxX;//Right
-				iComponent = 0;
-			}
-			else if (frustumPlaneFlag == FRUSTUM_PLANE_BOTTOM)
-			{
-				fEdge = fLightCameraOrthographicMinY;//Bottom
-				iComponent = 1;
-			}
-			else//FRUSTUM_PLANE_UP
-			{
-				fEdge = fLightCameraOrthographicMaxY;//Top
-				iComponent = 1;
-			}
-
-			for (INT triIter = 0;triIter < iTriangleCount;++triIter)
-			{
-				//pass ˼insided
-				// we don't delete triangles,so we skip those that have been culled.
-				if (!triangleList[triIter].culled)
-				{
-					INT iInsideVertCount = 0;
-					XMVECTOR tempPoint;
-
-					//Test against the correct frustum plane.
-					// This could be written more compactly,but it would be harder to understand
-
-					//jingz 1ڶfrusturm
-
-					if (frustumPlaneFlag == FRUSTUM_PLANE_LEFT)//ƽ
-					{
-						for (INT i = 0;i<3;++i)
-						{
-							//todo jingz 10 ֱʲô壿
-
-							if (XMVectorGetX(triangleList[triIter].points[i]) > XMVectorGetX(vOrthographicMin))
-							{
-								bPointPassesCollision[i] = true;
-							}
-							else
-							{
-								bPointPassesCollision[i] = false;
-							}
-							
-							iInsideVertCount += bPointPassesCollision[i] ? 1 : 0;
-						}
-					}
-					else if (frustumPlaneFlag == FRUSTUM_PLANE_RIGHT)//ƽ
-					{
-						for (INT i = 0;i<3;++i)
-						{
-							if (XMVectorGetX(triangleList[triIter].points[i]) < XMVectorGetX(vOrthographicMax))
-							{
-								bPointPassesCollision[i] = true;
-							}
-							else
-							{
-								bPointPassesCollision[i] = false;
-							}
-
-							iInsideVertCount += bPointPassesCollision[i]?1:0;
-						}
-					}
-					else if (frustumPlaneFlag == FRUSTUM_PLANE_BOTTOM)//jingz ƽ
-					{
-						for (INT i = 0; i < 3; ++i)
-						{
-							if (XMVectorGetY(triangleList[triIter].points[i]) > XMVectorGetY(vOrthographicMin))
-							{
-								bPointPassesCollision[i] = true;
-							}
-							else
-							{
-								bPointPassesCollision[i] = false;
-							}
-
-							iInsideVertCount += bPointPassesCollision[i] ? 1 : 0;
-						}
-					}
-					else // FRUSTUM_PLANE_UP ƽ
-					{
-						for (INT i = 0; i < 3; ++i)
-						{
-							if (XMVectorGetY(triangleList[triIter].points[i]) < XMVectorGetY(vOrthographicMax))
-							{
-								bPointPassesCollision[i] = true;
-							}
-							else
-							{
-								bPointPassesCollision[i] = false;
-							}
-
-							iInsideVertCount += bPointPassesCollision[i] ? 1 : 0;
-						}
-					}
-
-					//jingz ȷǷfrustumض,ΪʲôҪлλ
-					//move the points that pass the frustum test to the beginning of the array.
-					if (bPointPassesCollision[1]&& !bPointPassesCollision[0])
-					{
-						tempPoint = triangleList[triIter].points[0];
-						triangleList[triIter].points[0] = triangleList[triIter].points[1];
-						triangleList[triIter].points[1] = tempPoint;
-
-						bPointPassesCollision[0] = true;
-						bPointPassesCollision[1] = false;
-
-					}
-					if (bPointPassesCollision[2] && !bPointPassesCollision[1])
-					{
-						tempPoint = triangleList[triIter].points[1];
-						triangleList[triIter].points[1] = triangleList[triIter].points[2];
-						triangleList[triIter].points[2] = tempPoint;
-						bPointPassesCollision[1] = true;
-						bPointPassesCollision[2] = false;
-					}
-					if (bPointPassesCollision[1]&&!bPointPassesCollision[0])//1ڣ2ڣһֽԺҪ²10Ĺϵеð
-					{
-						tempPoint = triangleList[triIter].points[0];
-						triangleList[triIter].points[0] = triangleList[triIter].points[1];
-						triangleList[triIter].points[1] = tempPoint;
-
-						bPointPassesCollision[0] = true;
-						bPointPassesCollision[1] = false;
-					}
-
-					if (iInsideVertCount == 0)
-					{
-						//All points failed.We're done
-						triangleList[triIter].culled = true;
-					}
-					else if(iInsideVertCount == 1)//jingz ڽͷ
-					{//One point passed.Clip the triangle against the frustum plane
-						triangleList[triIter].culled = false;
+		m_uDepthBoundsFrame = 0;
+		m_bDepthBoundsValid = false;
+		return S_OK;
+	}
 
-						//
-						XMVECTOR vVert0ToVert1 = triangleList[triIter].points[1] - triangleList[triIter].points[0];
-						XMVECTOR vVert0ToVert2 = triangleList[triIter].points[2] - triangleList[triIter].points[0];
+	DXUT_BeginPerfEvent(DXUT_PERFEVENTCOLOR, L"Depth Bounds");
 
-						// Find the collision ratio
-						FLOAT fHitPointDiff = fEdge - XMVectorGetByIndex(triangleList[triIter].points[0],iComponent);
+	// The depth buffer can not stay bound for output while the compute shader reads it.
+	pD3dDeviceContext->OMSetRenderTargets(0, nullptr, nullptr);
 
-						//Calculate the distance along the vector as ratio of the hit ratio to the component
-						FLOAT fRatioAlongVert01 = fHitPointDiff / XMVectorGetByIndex(vVert0ToVert1, iComponent);// t1
-						FLOAT fRatioAlongVert02 = fHitPointDiff / XMVectorGetByIndex(vVert0ToVert2, iComponent);// t2
+	UINT uEmptyBounds[4] = { 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF };
+	pD3dDeviceContext->ClearUnorderedAccessViewUint(m_pDepthBoundsUAV, uEmptyBounds);
 
-						//jingz todo ΪʲôҪα֤Ʒȷ
-						//Add the point plus a percentage of the vector
-						triangleList[triIter].points[1] = triangleList[triIter].points[0] + vVert0ToVert2 * fRatioAlongVert02;
-						triangleList[triIter].points[2] = triangleList[triIter].points[0] + vVert0ToVert1 * fRatioAlongVert01;
-					}
-					else if(iInsideVertCount == 2)//jingz һȡ㣬ıΣ
-					{
-						// 2 in 
-						// tessellate into 2 triangles
-
-						//Copy the triangle(if is exists) after the current triangle out of
-						// the way so we can override it with the new triangle we're inserting.
-						triangleList[iTriangleCount] = triangleList[triIter + 1];//jingz ԭȵһչƶ棬ڿλøɵĵ
-
-						triangleList[triIter].culled = false;
-						triangleList[triIter + 1].culled = false;
-
-						// Get the vector from the outside point into 2 inside points
-						XMVECTOR vVert2ToVert0 = triangleList[triIter].points[0] - triangleList[triIter].points[2];
-						XMVECTOR vVert2ToVert1 = triangleList[triIter].points[1] - triangleList[triIter].points[2];
-
-						// Get the hit point ratio
-						FLOAT fHitPointDiff = fEdge - XMVectorGetByIndex(triangleList[triIter].points[2], iComponent);
-						FLOAT fRatioAlongVector_2_0 = fHitPointDiff / XMVectorGetByIndex(vVert2ToVert0, iComponent);
-						//Calculate the new vertex by adding the percentage of the vector plus point 2
-						vVert2ToVert0 *= fRatioAlongVector_2_0;
-						vVert2ToVert0 += triangleList[triIter].points[2];
-						
-						// Add new triangle.
-						triangleList[triIter + 1].points[0] = triangleList[triIter].points[0];
-						triangleList[triIter + 1].points[1] = triangleList[triIter].points[1];
-						triangleList[triIter + 1].points[2] = vVert2ToVert0;
-
-
-						// Get the hit point ratio
-						FLOAT fRatioAlongVector_2_1 = fHitPointDiff / XMVectorGetByIndex(vVert2ToVert1, iComponent);
-						//Calculate the new vertex by adding the percentage of the vector plus point 2
-						vVert2ToVert1 *= fRatioAlongVector_2_1;
-						vVert2ToVert1 += triangleList[triIter].points[2];
-
-						triangleList[triIter].points[0] = triangleList[triIter+1].points[1];
-						triangleList[triIter].points[1] = triangleList[triIter+1].points[2];
-						triangleList[triIter].points[2] = vVert2ToVert1;
-
-						//increase triangle count and skip the triangle we just inserted.
-
-						++iTriangleCount;
-						++triIter;
-					}
-					else
-					{
-						//all in
-						triangleList[triIter].culled = false;
-					}
+	pD3dDeviceContext->CSSetShader(m_pDepthReductionComputeShader, nullptr, 0);
+	pD3dDeviceContext->CSSetShaderResources(0, 1, &pSceneDepthSRV);
+	pD3dDeviceContext->CSSetUnorderedAccessViews(0, 1, &m_pDepthBoundsUAV, nullptr);
+	pD3dDeviceContext->Dispatch((uWidth + 15) / 16, (uHeight + 15) / 16, 1);
 
+	ID3D11ShaderResourceView* pNullSRV = nullptr;
+	ID3D11UnorderedAccessView* pNullUAV = nullptr;
+	pD3dDeviceContext->CSSetShaderResources(0, 1, &pNullSRV);
+	pD3dDeviceContext->CSSetUnorderedAccessViews(0, 1, &pNullUAV, nullptr);
+	pD3dDeviceContext->CSSetShader(nullptr, nullptr, 0);
 
-				}//if triangle not culled
-			}//for_triangle
-		}//for_frustumPlane
+	pD3dDeviceContext->CopyResource(m_pDepthBoundsStagingBuffer[m_uDepthBoundsFrame % DEPTH_BOUNDS_READBACK_LATENCY], m_pDepthBoundsBuffer);
+	++m_uDepthBoundsFrame;
 
-		for (INT i = 0;i<iTriangleCount;++i)
+	// The oldest copy has most likely arrived,if it has not the bounds we have are kept for another frame.
+	if (m_uDepthBoundsFrame >= DEPTH_BOUNDS_READBACK_LATENCY)
+	{
+		D3D11_MAPPED_SUBRESOURCE mappedBounds;
+		if (SUCCEEDED(pD3dDeviceContext->Map(m_pDepthBoundsStagingBuffer[m_uDepthBoundsFrame % DEPTH_BOUNDS_READBACK_LATENCY], 0,
+			D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mappedBounds)))
 		{
-			if (!triangleList[i].culled)
-			{
-				//Set the near and far plane and the min and max z values respectively
-				for (INT j = 0;j<3;++j)
-				{
-					float fTriangleCoordZ = XMVectorGetZ(triangleList[i].points[j]);
-
-					if (fNearPlane > fTriangleCoordZ)
-					{
-						fNearPlane = fTriangleCoordZ;
-					}
-
-					if (fFarPlane < fTriangleCoordZ)
-					{
-						fFarPlane = fTriangleCoordZ;
-					}
+			UINT uMinDepth = ((const UINT*)mappedBounds.pData)[0];
+			UINT uMaxDepth = ~((const UINT*)mappedBounds.pData)[1];
+			pD3dDeviceContext->Unmap(m_pDepthBoundsStagingBuffer[m_uDepthBoundsFrame % DEPTH_BOUNDS_READBACK_LATENCY], 0);
 
-				}
+			// Nothing but sky leaves the cleared value.
+			m_bDepthBoundsValid = uMinDepth != 0xFFFFFFFF;
+			if (m_bDepthBoundsValid)
+			{
+				FLOAT fMinDepth, fMaxDepth;
+				memcpy(&fMinDepth, &uMinDepth, sizeof(FLOAT));
+				memcpy(&fMaxDepth, &uMaxDepth, sizeof(FLOAT));
+				m_fDepthBoundsMin = CascadeFitting::DepthBufferToViewDepth(m_FitParams.m_matViewerCameraProj, fMinDepth);
+				m_fDepthBoundsMax = CascadeFitting::DepthBufferToViewDepth(m_FitParams.m_matViewerCameraProj, fMaxDepth);
 			}
 		}
+	}
 
-	}//for_AABB
-
-}
-void CascadedShadowsManager::CreateFrustumPointsFromCascadeInterval(FLOAT fCascadeIntervalBegin, FLOAT fCascadeIntervalEnd, DirectX::XMMATRIX & vProjection, DirectX::XMVECTOR * pCornerPointsInView)
-{
-	XNA::Frustum vViewFrustum;
-	XNA::ComputeFrustumFromProjection(&vViewFrustum, &vProjection);
-
-	vViewFrustum.Near = fCascadeIntervalBegin;
-	vViewFrustum.Far = fCascadeIntervalEnd;
-
-
-	static const XMVECTORU32 vGrabY = { 0x00000000,0xFFFFFFFF,0x00000000,0x00000000 };
-	static const XMVECTORU32 vGrabX = { 0xFFFFFFFF,0x00000000,0x00000000,0x00000000 };
-
-	XMVECTORF32 vRightTopSlope = { vViewFrustum.RightSlope,vViewFrustum.TopSlope,1.0f,1.0f };
-	XMVECTORF32 vLeftBottomSlope = { vViewFrustum.LeftSlope,vViewFrustum.BottomSlope,1.0f,1.0f };
-	XMVECTORF32 vNearFactor = { vViewFrustum.Near,vViewFrustum.Near,vViewFrustum.Near,1.0f };
-	XMVECTORF32 vFarFactor = { vViewFrustum.Far,vViewFrustum.Far,vViewFrustum.Far,1.0f };
-	XMVECTOR vRightTopNear = DirectX::XMVectorMultiply(vRightTopSlope, vNearFactor);
-	XMVECTOR vRightTopFar = DirectX::XMVectorMultiply(vRightTopSlope, vFarFactor);
-	XMVECTOR vLeftBottomNear = DirectX::XMVectorMultiply(vLeftBottomSlope, vNearFactor);
-	XMVECTOR vLeftBottomFar = DirectX::XMVectorMultiply(vLeftBottomSlope, vFarFactor);
-
-	pCornerPointsInView[0] = vRightTopNear;
-	pCornerPointsInView[1] = DirectX::XMVectorSelect(vRightTopNear, vLeftBottomNear, vGrabX);//RightBottomNear
-	pCornerPointsInView[2] = vLeftBottomNear;
-	pCornerPointsInView[3] = DirectX::XMVectorSelect(vRightTopNear, vLeftBottomNear, vGrabY);//LeftTopNear
-
-	pCornerPointsInView[4] = vRightTopFar;
-	pCornerPointsInView[5] = XMVectorSelect(vRightTopFar, vLeftBottomFar, vGrabX);//RightBottomFar
-	pCornerPointsInView[6] = vLeftBottomFar;
-	pCornerPointsInView[7] = XMVectorSelect(vRightTopFar, vLeftBottomFar, vGrabY);//LeftTopFar
+	DXUT_EndPerfEvent();
 
+	return S_OK;
 }
 
-void CascadedShadowsManager::CreateAABBPoints(DirectX::XMVECTOR * vAABBPoints, DirectX::XMVECTOR vCenter, DirectX::FXMVECTOR vExtends)
-{
-	//This map enables us to use a for loop and do vector math.
-	static const XMVECTORF32 vExtentsMap[]=
-	{
-		{ 1.0f,1.0f,-1.0f,1.0f },//ǰ
-		{ -1.0f,1.0f,-1.0f,1.0f },//ǰ
-		{ 1.0f,-1.0f,-1.0f,1.0f },//ǰ
-		{ -1.0f,-1.0f,-1.0f,1.0f },//ǰ
-		{ 1.0f,1.0f,1.0f,1.0f },//Ϻ
-		{ -1.0f,1.0f,1.0f,1.0f },//Ϻ
-		{ 1.0f,-1.0f,1.0f,1.0f },//º
-		{ -1.0f,-1.0f,1.0f,1.0f }//º
-	};
-
-	for (INT i = 0;i <8;++i)
-	{
-		vAABBPoints[i] = XMVectorMultiplyAdd(vExtentsMap[i], vExtends, vCenter);
-	}
-
-}
 HRESULT CascadedShadowsManager::ReleaseOldAndAllocateNewShadowResources(ID3D11Device * pD3dDevice)
 {
 	HRESULT hr = S_OK;
@@ -1126,72 +1826,72 @@ HRESULT CascadedShadowsManager::ReleaseOldAndAllocateNewShadowResources(ID3D11De
 	//if any of the these 3 parameters was changed ,we must reallocate the D3D resources.
 	if (m_CopyOfCascadeConfig.m_nUsingCascadeLevelsCount != m_pCascadeConfig->m_nUsingCascadeLevelsCount
 		|| m_CopyOfCascadeConfig.m_ShadowBufferFormat != m_pCascadeConfig->m_ShadowBufferFormat
-		|| m_CopyOfCascadeConfig.m_iLengthOfShadowBufferSquare != m_pCascadeConfig->m_iLengthOfShadowBufferSquare)
+		|| m_CopyOfCascadeConfig.m_iLengthOfShadowBufferSquare != m_pCascadeConfig->m_iLengthOfShadowBufferSquare
+		|| m_CopyOfCascadeConfig.m_bCascadeTextureArray != m_pCascadeConfig->m_bCascadeTextureArray
+		|| memcmp(m_CopyOfCascadeConfig.m_iCascadeLengthOfShadowBuffer, m_pCascadeConfig->m_iCascadeLengthOfShadowBuffer,
+			sizeof(m_CopyOfCascadeConfig.m_iCascadeLengthOfShadowBuffer)) != 0
+		|| (m_nDynamicCasterMeshes > 0) != (m_pStaticShadowMapTexture != nullptr))
 	{
 		m_CopyOfCascadeConfig = *m_pCascadeConfig;
+		UINT nCascadeCount = (UINT)m_CopyOfCascadeConfig.m_nUsingCascadeLevelsCount;
 
-		SAFE_RELEASE(m_pSamLinear);
-		SAFE_RELEASE(m_pSamShadowPCF);
-		SAFE_RELEASE(m_pSamShadowPoint);
-
-		D3D11_SAMPLER_DESC SamDesc;
-		SamDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
-		SamDesc.AddressU = SamDesc.AddressV  = SamDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
-		SamDesc.MipLODBias = 0.0f;
-		SamDesc.MaxAnisotropy = 1;
-		SamDesc.ComparisonFunc = D3D11_COMPARISON_ALWAYS;
-		SamDesc.BorderColor[0] = SamDesc.BorderColor[1] = SamDesc.BorderColor[2] = SamDesc.BorderColor[3] = 0;
-		SamDesc.MinLOD = 0;
-		SamDesc.MaxLOD = D3D11_FLOAT32_MAX;
-		V_RETURN(pD3dDevice->CreateSamplerState(&SamDesc, &m_pSamLinear));
-		DXUT_SetDebugName(m_pSamLinear, "CSM Linear");
-
-		D3D11_SAMPLER_DESC SamDescShadow;
-		SamDescShadow.Filter = D3D11_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT;
-		SamDescShadow.AddressU = SamDescShadow.AddressV = SamDescShadow.AddressW = D3D11_TEXTURE_ADDRESS_BORDER;
-		SamDescShadow.MipLODBias = 0.0f;
-		SamDescShadow.MaxAnisotropy = 0;
-		SamDescShadow.ComparisonFunc = D3D11_COMPARISON_LESS;
-		SamDescShadow.BorderColor[0] = SamDescShadow.BorderColor[1] = SamDescShadow.BorderColor[2] = SamDescShadow.BorderColor[3] = 0.0f;
-		SamDescShadow.MinLOD = 0;
-		SamDescShadow.MaxLOD = 0;
-		
-		V_RETURN(pD3dDevice->CreateSamplerState(&SamDescShadow, &m_pSamShadowPCF));
-		DXUT_SetDebugName(m_pSamShadowPCF, "CSM Shader PCF");
+		// The atlas is as tall as the longest tile,the tiles are packed into it from the left.
+		INT iLongestLength = 0;
+		for (UINT i = 0;i < nCascadeCount;++i)
+		{
+			INT iLength = m_CopyOfCascadeConfig.m_iCascadeLengthOfShadowBuffer[i];
+			m_iCascadeLengthOfShadowBuffer[i] = iLength > 0 ? iLength : m_CopyOfCascadeConfig.m_iLengthOfShadowBufferSquare;
+			iLongestLength = std::max(iLongestLength, m_iCascadeLengthOfShadowBuffer[i]);
+		}
+		m_iShadowAtlasHeight = iLongestLength;
+		m_iShadowAtlasWidth = AtlasPacking::PackSquaresSkyline(m_iCascadeLengthOfShadowBuffer, nCascadeCount, iLongestLength, m_CascadeAtlasRects);
 
-		SamDescShadow.MaxAnisotropy = 15;
-		SamDescShadow.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
-		SamDescShadow.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
-		SamDescShadow.Filter = D3D11_FILTER_ANISOTROPIC;
-		SamDescShadow.ComparisonFunc = D3D11_COMPARISON_NEVER;
-		V_RETURN(pD3dDevice->CreateSamplerState(&SamDescShadow, &m_pSamShadowPoint));
-		DXUT_SetDebugName(m_pSamShadowPoint, "CSM Shadow Point");
+		// Side by side the cascades can't be wider than a texture,a texture array has room for every one of them.
+		m_bCascadeTextureArray = m_CopyOfCascadeConfig.m_bCascadeTextureArray || m_iShadowAtlasWidth > D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION;
+		if (m_bCascadeTextureArray)
+		{
+			// Every slice is as large as the longest tile,a shorter tile takes the top left of its slice.
+			for (UINT i = 0;i < nCascadeCount;++i)
+			{
+				m_CascadeAtlasRects[i].m_iX = 0;
+				m_CascadeAtlasRects[i].m_iY = 0;
+			}
+			m_iShadowAtlasWidth = iLongestLength;
+		}
 
 		for (INT i = 0;i<m_CopyOfCascadeConfig.m_nUsingCascadeLevelsCount;++i)
 		{
-			m_RenderViewPort[i].Height = (FLOAT)m_CopyOfCascadeConfig.m_iLengthOfShadowBufferSquare;
-			m_RenderViewPort[i].Width = (FLOAT)m_CopyOfCascadeConfig.m_iLengthOfShadowBufferSquare;
+			m_RenderViewPort[i].Height = (FLOAT)m_CascadeAtlasRects[i].m_iHeight;
+			m_RenderViewPort[i].Width = (FLOAT)m_CascadeAtlasRects[i].m_iWidth;
 			m_RenderViewPort[i].MaxDepth = 1.0f;
 			m_RenderViewPort[i].MinDepth = 0.0f;
-			m_RenderViewPort[i].TopLeftX = (FLOAT)(m_CopyOfCascadeConfig.m_iLengthOfShadowBufferSquare*i);
-			m_RenderViewPort[i].TopLeftY = 0;
+			m_RenderViewPort[i].TopLeftX = (FLOAT)m_CascadeAtlasRects[i].m_iX;
+			m_RenderViewPort[i].TopLeftY = (FLOAT)m_CascadeAtlasRects[i].m_iY;
 
 		}
 
-		m_RenderOneTileVP.Height = (FLOAT)m_CopyOfCascadeConfig.m_iLengthOfShadowBufferSquare;
-		m_RenderOneTileVP.Width = (FLOAT)m_CopyOfCascadeConfig.m_iLengthOfShadowBufferSquare;
+		m_RenderOneTileVP.Height = (FLOAT)m_CascadeAtlasRects[0].m_iHeight;
+		m_RenderOneTileVP.Width = (FLOAT)m_CascadeAtlasRects[0].m_iWidth;
 		m_RenderOneTileVP.MaxDepth = 1.0f;
 		m_RenderOneTileVP.MinDepth = 0.0f;
 		m_RenderOneTileVP.TopLeftX = 0.0f;
 		m_RenderOneTileVP.TopLeftY = 0.0f;
 
-		SAFE_RELEASE(m_pCascadedShadowMapSRV);
-		SAFE_RELEASE(m_pCascadedShadowMapTexture);
-		SAFE_RELEASE(m_pCascadedShadowMapDSV);
+		// The old textures stay alive in the pool while the frames in flight still read them,and toggling back
+		// to their config takes them again instead of creating them.
+		m_ShadowTexturePool.GiveBack(m_pShadowMapPoolTexture);
+		m_ShadowTexturePool.GiveBack(m_pStaticShadowMapPoolTexture);
+		m_pShadowMapPoolTexture = nullptr;
+		m_pStaticShadowMapPoolTexture = nullptr;
+		UsePooledShadowTextures();
+
+		// The new texture holds no depth yet.
+		CascadeFitting::InvalidateCascadeTiles(&m_CascadeCache);
 
 		DXGI_FORMAT textureFormat = DXGI_FORMAT_R32_TYPELESS;
 		DXGI_FORMAT SrvFormat = DXGI_FORMAT_R32_FLOAT;
 		DXGI_FORMAT DsvFormat = DXGI_FORMAT_D32_FLOAT;
+		UINT uBytesPerTexel = 4;
 
 		switch (m_CopyOfCascadeConfig.m_ShadowBufferFormat)
 		{
@@ -1211,21 +1911,23 @@ HRESULT CascadedShadowsManager::ReleaseOldAndAllocateNewShadowResources(ID3D11De
 			textureFormat = DXGI_FORMAT_R16_TYPELESS;
 			SrvFormat = DXGI_FORMAT_R16_UNORM;
 			DsvFormat = DXGI_FORMAT_D16_UNORM;
+			uBytesPerTexel = 2;
 			break;
 
 		case CASCADE_DXGI_FORMAT_R8_TYPELESS:
 			textureFormat = DXGI_FORMAT_R8_TYPELESS;
 			SrvFormat = DXGI_FORMAT_R8_UNORM;
 			DsvFormat = DXGI_FORMAT_R8_UNORM;
+			uBytesPerTexel = 1;
 			break;
 		}
 
 
 		D3D11_TEXTURE2D_DESC ShadowMapTextureDesc;
-		ShadowMapTextureDesc.Width = m_CopyOfCascadeConfig.m_iLengthOfShadowBufferSquare*m_CopyOfCascadeConfig.m_nUsingCascadeLevelsCount;
-		ShadowMapTextureDesc.Height = m_CopyOfCascadeConfig.m_iLengthOfShadowBufferSquare;
+		ShadowMapTextureDesc.Width = m_iShadowAtlasWidth;
+		ShadowMapTextureDesc.Height = m_iShadowAtlasHeight;
 		ShadowMapTextureDesc.MipLevels = 1;
-		ShadowMapTextureDesc.ArraySize = 1;
+		ShadowMapTextureDesc.ArraySize = m_bCascadeTextureArray ? nCascadeCount : 1;
 		ShadowMapTextureDesc.Format = textureFormat;
 		ShadowMapTextureDesc.SampleDesc.Count = 1;
 		ShadowMapTextureDesc.SampleDesc.Quality = 0;
@@ -1234,35 +1936,148 @@ HRESULT CascadedShadowsManager::ReleaseOldAndAllocateNewShadowResources(ID3D11De
 		ShadowMapTextureDesc.CPUAccessFlags = 0;
 		ShadowMapTextureDesc.MiscFlags = 0;
 
-		V_RETURN(pD3dDevice->CreateTexture2D(&ShadowMapTextureDesc, NULL, &m_pCascadedShadowMapTexture));
-		DXUT_SetDebugName(m_pCascadedShadowMapTexture, "CSM Texture2D");
-
+		// The view of the whole array clears every cascade at once and is what the single pass draws into,
+		// the other passes draw each cascade through the view of its slice.
+		V_RETURN(m_ShadowTexturePool.Acquire(pD3dDevice, ShadowMapTextureDesc, m_bCascadeTextureArray, DsvFormat, SrvFormat, uBytesPerTexel,
+			"CSM Texture2D", &m_pShadowMapPoolTexture));
 
+		if (m_nDynamicCasterMeshes > 0)
+		{
+			// Copied into the atlas every frame,so it has the atlas' size and format.The tiles of an atlas are
+			// copied by reading it in a pixel shader.
+			ShadowMapTextureDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
+			V_RETURN(m_ShadowTexturePool.Acquire(pD3dDevice, ShadowMapTextureDesc, m_bCascadeTextureArray, DsvFormat, SrvFormat, uBytesPerTexel,
+				"CSM Static Casters Texture2D", &m_pStaticShadowMapPoolTexture));
+		}
+		UsePooledShadowTextures();
 
-		D3D11_DEPTH_STENCIL_VIEW_DESC depthStencilViewDesc;
-		depthStencilViewDesc.Format = DsvFormat;
-		depthStencilViewDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
-		depthStencilViewDesc.Flags = 0;
-		depthStencilViewDesc.Texture2D.MipSlice = 0;
+		// The tiles leave the rest of the size class unused,the texture's sides are what its UVs are relative to.
+		m_iShadowAtlasWidth = (INT)m_pShadowMapPoolTexture->m_Desc.Width;
+		m_iShadowAtlasHeight = (INT)m_pShadowMapPoolTexture->m_Desc.Height;
+		m_uShadowMapBytes = m_pShadowMapPoolTexture->m_uBytes;
+	}
 
-		V_RETURN(pD3dDevice->CreateDepthStencilView(m_pCascadedShadowMapTexture, &depthStencilViewDesc, &m_pCascadedShadowMapDSV));
-		DXUT_SetDebugName(m_pCascadedShadowMapDSV,"CSM Texture2D DSV");
 
-		D3D11_SHADER_RESOURCE_VIEW_DESC depthStencilSrvDesc;
-		depthStencilSrvDesc.Format = SrvFormat;
-		depthStencilSrvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-		depthStencilSrvDesc.Texture2D.MostDetailedMip = 0;
-		depthStencilSrvDesc.Texture2D.MipLevels = 1;
+	return hr;
+}
+;
 
-		V_RETURN(pD3dDevice->CreateShaderResourceView(m_pCascadedShadowMapTexture, &depthStencilSrvDesc, &m_pCascadedShadowMapSRV));
+void CascadedShadowsManager::UsePooledShadowTextures()
+{
+	PooledShadowTexture* pShadowMap = m_pShadowMapPoolTexture;
+	PooledShadowTexture* pStatic = m_pStaticShadowMapPoolTexture;
+
+	m_pCascadedShadowMapTexture = pShadowMap != nullptr ? pShadowMap->m_pTexture : nullptr;
+	m_pCascadedShadowMapDSV = pShadowMap != nullptr ? pShadowMap->m_pDSV : nullptr;
+	m_pCascadedShadowMapSRV = pShadowMap != nullptr ? pShadowMap->m_pSRV : nullptr;
+	m_pStaticShadowMapTexture = pStatic != nullptr ? pStatic->m_pTexture : nullptr;
+	m_pStaticShadowMapDSV = pStatic != nullptr ? pStatic->m_pDSV : nullptr;
+	m_pStaticShadowMapSRV = pStatic != nullptr ? pStatic->m_pSRV : nullptr;
+	for (INT i = 0;i < MAX_CASCADES;++i)
+	{
+		m_pCascadedShadowMapSliceDSVs[i] = pShadowMap != nullptr ? pShadowMap->m_pSliceDSVs[i] : nullptr;
+		m_pStaticShadowMapSliceDSVs[i] = pStatic != nullptr ? pStatic->m_pSliceDSVs[i] : nullptr;
+	}
+}
 
-		DXUT_SetDebugName(m_pCascadedShadowMapSRV, "CSM Texture2D SRV");
+void CascadedShadowsManager::TrackDeviceBuffers(bool bTrack)
+{
+	if (m_pMemoryTracker == nullptr)
+	{
+		return;
+	}
 
+	ID3D11Buffer* pBuffers[] =
+	{
+		m_pDepthBoundsBuffer,
+		m_pPerObjectConstantBuffer,
+		m_pShadowFrameConstantBuffer,
+		m_pShadowCascadesConstantBuffer,
+		m_pCascadeConstantRing,
+	};
+	static const char* szBufferNames[] =
+	{
+		"DepthBounds",
+		"CB_PER_OBJECT",
+		"CB_SHADOW_FRAME",
+		"CB_SHADOW_CASCADES",
+		"CB_PER_CASCADE Ring",
+	};
+	for (INT i = 0;i < (INT)(sizeof(pBuffers) / sizeof(pBuffers[0]));++i)
+	{
+		if (bTrack)
+		{
+			m_pMemoryTracker->TrackResource(GPU_MEMORY_SHADOW_BUFFERS, pBuffers[i], szBufferNames[i]);
+		}
+		else
+		{
+			m_pMemoryTracker->Untrack(pBuffers[i]);
+		}
+	}
+	for (INT index = 0;index < DEPTH_BOUNDS_READBACK_LATENCY;++index)
+	{
+		if (bTrack)
+		{
+			m_pMemoryTracker->TrackResource(GPU_MEMORY_SHADOW_BUFFERS, m_pDepthBoundsStagingBuffer[index], "DepthBounds Staging");
+		}
+		else
+		{
+			m_pMemoryTracker->Untrack(m_pDepthBoundsStagingBuffer[index]);
+		}
+	}
+	for (INT index = 0;index < MAX_CASCADES;++index)
+	{
+		if (bTrack)
+		{
+			m_pMemoryTracker->TrackResource(GPU_MEMORY_SHADOW_BUFFERS, m_pCascadeConstantBuffers[index], "CB_PER_CASCADE");
+		}
+		else
+		{
+			m_pMemoryTracker->Untrack(m_pCascadeConstantBuffers[index]);
+		}
 	}
+	for (size_t i = 0;i < m_pCasterLodIndexBuffers.size();++i)
+	{
+		if (bTrack)
+		{
+			m_pMemoryTracker->TrackResource(GPU_MEMORY_SHADOW_BUFFERS, m_pCasterLodIndexBuffers[i], "CasterLodIndices");
+		}
+		else
+		{
+			m_pMemoryTracker->Untrack(m_pCasterLodIndexBuffers[i]);
+		}
+	}
+}
 
+void CascadedShadowsManager::TrackShaderBlobs(bool bTrack)
+{
+	if (m_pMemoryTracker == nullptr)
+	{
+		return;
+	}
 
-	return hr;
-}
-;
+	std::vector<ID3DBlob*> blobs;
+	blobs.push_back(m_pRenderOrthoShadowVertexShaderBlob);
+	blobs.push_back(m_pClearTileVertexShaderBlob);
+	blobs.push_back(m_pCopyStaticTilePixelShaderBlob);
+	blobs.push_back(m_pRenderShadowInstancedVertexShaderBlob);
+	blobs.push_back(m_pRouteToCascadeGeometryShaderBlob);
+	blobs.push_back(m_pDepthReductionComputeShaderBlob);
+	blobs.insert(blobs.end(), m_pRenderSceneVertexShaderBlob, m_pRenderSceneVertexShaderBlob + MAX_CASCADES);
 
+	// Every variant of the scene pixel shader,one after the other.
+	ID3DBlob** ppPixelShaderBlobs = &m_pRenderSceneAllPixelShaderBlobs[0][0][0][0];
+	blobs.insert(blobs.end(), ppPixelShaderBlobs, ppPixelShaderBlobs + sizeof(m_pRenderSceneAllPixelShaderBlobs) / sizeof(ID3DBlob*));
 
+	for (size_t i = 0;i < blobs.size();++i)
+	{
+		if (bTrack)
+		{
+			m_pMemoryTracker->TrackBlob(GPU_MEMORY_SHADER_BLOBS, blobs[i], "Shader Blob");
+		}
+		else
+		{
+			m_pMemoryTracker->Untrack(blobs[i]);
+		}
+	}
+}
@@ -1,14 +1,30 @@
 #pragma once
 
 #include "ShadowSampleMisc.h"
+#include "MeshSimplification.h"
+#include "AtlasPacking.h"
+#include "ShadowTexturePool.h"
 #include <d3d11.h>
 
 class CFirstPersonCamera;
 class CDXUTSDKMesh;
+class JobPool;
+class GpuMemoryTracker;
 
 #pragma warning(push)
 #pragma warning(disable:4324)
 
+// Frames between the depth bounds reduction and its read back,so that reading it never stalls.
+#define DEPTH_BOUNDS_READBACK_LATENCY 3
+
+// Simplified levels built for every caster subset,each with at most half the triangles of the one before.
+#define CASTER_LOD_COUNT 6
+// The largest error in world units a caster level is built with,a few texels of the far cascade of the sample scenes.
+#define CASTER_LOD_MAX_ERROR 4.0f
+
+// Frames a shadow map of an earlier config stays in the pool,long enough to toggle back to it without creating it.
+#define SHADOW_TEXTURE_POOL_IDLE_FRAMES 120
+
 __declspec(align(16)) class CascadedShadowsManager
 {
 public:
@@ -21,9 +37,12 @@ public:
 	
 	HRESULT DestroyAndDeallocateShadowResources();
 
-	//This runs per frame.This data could be cached when the cameras do not move.
+	//This runs per frame.The fit is cached while the cameras,the scene and the settings do not change.
 	HRESULT InitPerFrame(ID3D11Device* pD3dDevice, CDXUTSDKMesh* mesh);
 
+	// Only the cascades whose projection changed since their tile was rendered are drawn.With dynamic casters
+	// the static casters are cached in a layer of their own,which is copied into the atlas every frame before the
+	// dynamic casters are drawn into every cascade.
 	HRESULT RenderShadowForAllCascades(ID3D11Device* pD3dDevice, ID3D11DeviceContext* pD3dDeviceContext, CDXUTSDKMesh* pMesh);
 
 	HRESULT RenderScene(ID3D11DeviceContext* pD3dDeviceContext,
@@ -34,6 +53,10 @@ public:
 		D3D11_VIEWPORT* pViewPort,
 		BOOL bVisualize);
 
+	// Reduces the scene depth to the depth range of the visible pixels.pSceneDepthSRV is the depth buffer
+	// RenderScene wrote,it is unbound from the output merger.Later frames fit the cascades to the result.
+	HRESULT ReduceDepthBounds(ID3D11DeviceContext* pD3dDeviceContext, ID3D11ShaderResourceView* pSceneDepthSRV, UINT uWidth, UINT uHeight);
+
 	DirectX::XMVECTOR GetScenAABBMin()
 	{
 		return m_vSceneAABBMin;
@@ -44,16 +67,205 @@ public:
 		return m_vSceneAABBMax;
 	}
 
+	// Number of cascades RenderShadowForAllCascades draws this frame.
+	INT GetCascadeUpdateCount() const
+	{
+		INT nCount = 0;
+		for (UINT uMask = m_uDirtyCascadeMask;uMask != 0;uMask &= uMask - 1)
+		{
+			++nCount;
+		}
+		return nCount;
+	}
+
+	// Texel density of the cascades as they are sampled this frame.
+	void GetTexelDensity(INT iScreenHeight, CascadeTexelDensity* pDensity) const
+	{
+		CascadeFitting::ComputeTexelDensity(m_FitParams, m_matOrthoProjForCascades, m_FrustumSlices, iScreenHeight, pDensity);
+	}
+
+	// Picks the shadow map for a memory budget from the cameras the cascades were last fitted with,
+	// see CascadeFitting::SelectShadowBudgetConfig.Only valid after InitPerFrame.
+	void SelectShadowBudgetConfig(const ShadowBudgetParams& budget, ShadowBudgetChoice* pChoice) const
+	{
+		CascadeFitting::SelectShadowBudgetConfig(m_FitParams, budget, pChoice);
+	}
+
+	// Number of cascades that scroll their tile this frame instead of rendering all of it,see m_bScrollCascades.
+	INT GetScrollCascadeCount() const
+	{
+		INT nCount = 0;
+		for (UINT uMask = m_uScrollCascadeMask;uMask != 0;uMask &= uMask - 1)
+		{
+			++nCount;
+		}
+		return nCount;
+	}
+
+	// Mesh subsets RenderShadowForAllCascades drew into and culled from a cascade this frame.A wrapped tile is
+	// drawn in up to 4 pieces,each piece counts its subsets.
+	void GetCasterCounts(INT iCascade, INT* pnDrawn, INT* pnCulled) const
+	{
+		*pnDrawn = m_nCastersDrawn[iCascade];
+		*pnCulled = m_nCastersCulled[iCascade];
+	}
+
+	// Mesh subsets RenderShadowForAllCascades left out of a cascade this frame for covering less than
+	// m_fMinCasterTexels of its texels,they are part of the culled count of GetCasterCounts.
+	INT GetSmallCasterCount(INT iCascade) const
+	{
+		return m_nSmallCastersCulled[iCascade];
+	}
+
+	// The largest part of a m_iPCFBlurSize x m_iPCFBlurSize kernel a caster left out by m_fMinCasterTexels could
+	// have covered,how much darker one filtered sample could have been.
+	FLOAT GetSmallCasterPCFWeight() const
+	{
+		FLOAT fTexels = ceilf(m_fMinCasterTexels);
+		FLOAT fWeight = fTexels * fTexels / (FLOAT)(m_iPCFBlurSize * m_iPCFBlurSize);
+		return fWeight < 1.0f ? fWeight : 1.0f;
+	}
+
+	// Draw calls RenderShadowForAllCascades submitted for the casters this frame.
+	INT GetShadowDrawCallCount() const
+	{
+		return m_nShadowDrawCalls;
+	}
+
+	// Vertex bytes the casters drawn this frame fetch,each cascade a single pass instance draws into counts once.
+	UINT64 GetShadowVertexBytes() const
+	{
+		UINT64 uBytes = 0;
+		for (INT index = 0;index < MAX_CASCADES;++index)
+		{
+			uBytes += m_uShadowVertexBytes[index];
+		}
+		return uBytes;
+	}
+
+	// Triangles RenderShadowForAllCascades drew into a cascade this frame,at the caster levels it picked.
+	UINT64 GetCascadeTriangleCount(INT iCascade) const
+	{
+		return m_nCascadeTriangles[iCascade];
+	}
+
+	// Index bytes of the simplified caster levels built in Init.
+	UINT64 GetCasterLodBytes() const
+	{
+		return m_uCasterLodBytes;
+	}
+
+	// Whether the cascades are stored in the slices of a texture array,see CascadeConfig::m_bCascadeTextureArray.
+	// Cascades side by side wider than a texture can be are stored in an array as well.
+	bool IsCascadeTextureArray() const
+	{
+		return m_bCascadeTextureArray;
+	}
+
+	// Where the tile of a cascade was packed,in the atlas or in the top left of its slice of a texture array.
+	const AtlasRect& GetCascadeAtlasRect(INT iCascade) const
+	{
+		return m_CascadeAtlasRects[iCascade];
+	}
+
+	// Size of the shadow map,or of one slice of a texture array.
+	INT GetShadowAtlasWidth() const
+	{
+		return m_iShadowAtlasWidth;
+	}
+
+	INT GetShadowAtlasHeight() const
+	{
+		return m_iShadowAtlasHeight;
+	}
+
+	// Bytes of the shadow map,the same for both ways to store the cascades when they all have the same length.
+	UINT64 GetShadowMapBytes() const
+	{
+		return m_uShadowMapBytes;
+	}
+
+	// Bytes of the static casters' copy of the shadow map,only allocated while there are dynamic casters.
+	UINT64 GetStaticLayerBytes() const
+	{
+		return m_pStaticShadowMapTexture != nullptr ? m_uShadowMapBytes : 0;
+	}
+
+	// The textures of the shadow map and the static layer,with the ones of earlier configs that were not released yet.
+	const ShadowTexturePool& GetShadowTexturePool() const
+	{
+		return m_ShadowTexturePool;
+	}
+
+	// CPU time RenderShadowForAllCascades took to cull and submit this frame.
+	FLOAT GetShadowRecordMilliseconds() const
+	{
+		return m_fShadowRecordMilliseconds;
+	}
+
+	// A dynamic mesh is drawn into the shadow every frame,the static ones only when their cascade changes.
+	// Tagging the first dynamic mesh or untagging the last reallocates the shadow resources in InitPerFrame.
+	void SetDynamicCaster(UINT iMesh, bool bDynamic);
+
+	bool IsDynamicCaster(UINT iMesh) const
+	{
+		return m_bMeshDynamicCaster[iMesh];
+	}
+
+	// The pool m_bMultithreadedShadows records the cascades on,the application shares it.
+	void SetJobPool(JobPool* pJobPool)
+	{
+		m_pJobPool = pJobPool;
+	}
+
+	// Where the shadow maps,buffers and shader blobs the manager creates are recorded,the application shares it.
+	// Set before Init,nullptr records nothing.
+	void SetMemoryTracker(GpuMemoryTracker* pMemoryTracker)
+	{
+		m_pMemoryTracker = pMemoryTracker;
+		m_ShadowTexturePool.SetMemoryTracker(pMemoryTracker);
+	}
+
+	// The view space depth range the cascades are fitted to,FALSE while the camera range is used.
+	BOOL GetDepthBounds(FLOAT* pfMinDepth, FLOAT* pfMaxDepth) const
+	{
+		*pfMinDepth = m_fDepthBoundsMin;
+		*pfMaxDepth = m_fDepthBoundsMax;
+		return m_FitParams.m_bUseDepthBounds ? TRUE : FALSE;
+	}
+
+	// The cascade partition planes of the last InitPerFrame,for culling and debug drawing.
+	const CascadeFrustumSlices& GetFrustumSlices() const
+	{
+		return m_FrustumSlices;
+	}
+
 	INT m_iCascadePartitionMax;
 	FLOAT m_fCascadePartitionDepthsInEyeSpace[MAX_CASCADES]; // Values are between near and far
 	INT m_iCascadePartitionsZeroToOne[MAX_CASCADES]; // Values are 0 to 100 and represent of the frstum
+	CASCADE_SPLIT_MODE m_eCascadeSplitMode;
+	FLOAT m_fCascadeSplitLambda; // Practical splits:0 is uniform,1 is logarithmic
+	bool m_bFitToDepthBounds; // Split the depth range of last frame's pixels instead of the camera range
 	INT m_iPCFBlurSize;
 	FLOAT m_fPCFShadowDepthBia;
+	FLOAT m_fMinCasterTexels; // Casters narrower than this many texels of a cascade are not drawn into it,0 draws all of them
 	bool m_bIsDerivativeBaseOffset;
 	bool m_bIsBlurBetweenCascades;
 	FLOAT m_fMaxBlendRatioBetweenCascadeLevel;
 
 	BOOL m_bMoveLightTexelSize;
+	bool m_bAnalyticNearFar; // Solve near/far analytically instead of clipping the scene AABB triangles
+	bool m_bNearFarFromMeshBounds; // Fit near/far to the mesh subsets under each cascade instead of the scene AABB
+	bool m_bCullShadowCasters; // Only draw the mesh subsets that can cast into a cascade's tile
+	bool m_bSinglePassShadows; // Draw all cascades with one instanced submission routed by SV_ViewportArrayIndex
+	bool m_bMultithreadedShadows; // Record each cascade into a deferred context on the job pool,per cascade rendering only
+	bool m_bCacheCascades; // Reuse the fit and the atlas tiles of cascades that did not change
+	bool m_bScrollCascades; // Scroll the tiles of texel snapped cascades and only render the strips that scrolled in,per cascade rendering only
+	bool m_bPositionOnlyCasters; // Draw the casters from the mesh's position stream when it has one,see CDXUTSDKMesh::SetCreatePositionStreams
+	bool m_bCasterLods; // Draw each caster at the coarsest level within m_fCasterLodTexels of the finest cascade it is drawn into
+	FLOAT m_fCasterLodTexels;
+	CASCADE_UPDATE_SCHEDULE m_eCascadeUpdateSchedule;
+	INT m_iFarCascadeUpdatesPerFrame; // How many of the deferrable far cascades are rendered per frame
 	CAMERA_SELECTION m_eSelectedCamera;
 	FIT_LIGHT_VIEW_FRUSTRUM m_eLightViewFrustumFitMode;
 	FIT_NEAR_FAR m_eSelectedNearFarFit;
@@ -61,51 +273,197 @@ public:
 
 
 private:
-	//Compute the near far plane by interesting an Ortho Projection with the Scenes AABB
-	void ComputeNearAndFarInViewSpace(FLOAT& fNearPlane, FLOAT& fFarPlane, DirectX::FXMVECTOR vLightCameraOrthographicMin, DirectX::FXMVECTOR vLightCameraOrthographicMax, DirectX::XMVECTOR* pvPointInCameraView);
+	HRESULT ReleaseOldAndAllocateNewShadowResources(ID3D11Device* pD3dDevice); // This is called when cascade config changes
 
-	void CreateFrustumPointsFromCascadeInterval(FLOAT fCascadeIntervalBegin, FLOAT fCascadeIntervalEnd, DirectX::XMMATRIX& vProjection, DirectX::XMVECTOR* pCornerPointsInView);
+	// Points the shadow map and static layer members at the views of the pooled textures in use.
+	void UsePooledShadowTextures();
 
-	void CreateAABBPoints(DirectX::XMVECTOR* vAABBPoints, DirectX::XMVECTOR vCenter, DirectX::FXMVECTOR vExtends);
+	// Records the buffers or the shader blobs in m_pMemoryTracker,or forgets them before they are released.
+	// The blobs outlive DestroyAndDeallocateShadowResources.
+	void TrackDeviceBuffers(bool bTrack);
+	void TrackShaderBlobs(bool bTrack);
 
-	HRESULT ReleaseOldAndAllocateNewShadowResources(ID3D11Device* pD3dDevice); // This is called when cascade config changes
+	// Draws the static or the dynamic casters into the cascades of uCascadeMask in pDSV,serially,on the job pool or
+	// in a single pass.bClearTiles resets each tile first.
+	void RenderCasterLayer(ID3D11Device* pD3dDevice, ID3D11DeviceContext* pD3dDeviceContext, CDXUTSDKMesh* pMesh,
+		ID3D11DepthStencilView* pDSV, UINT uCascadeMask, bool bClearTiles, bool bDynamic);
+
+	// Binds pDSV and the shadow states,a deferred context starts every cascade with this.
+	void BindShadowTarget(ID3D11DeviceContext* pD3dDeviceContext, ID3D11DepthStencilView* pDSV);
+
+	// Sets the shadow rasterizer state of the near/far fit,with or without the scissor test.
+	void SetShadowRasterizerState(ID3D11DeviceContext* pD3dDeviceContext, bool bScissor);
+
+	// Sets the cascade's viewport,resets its tile if bClearTile and draws its static or dynamic casters unless the
+	// casters of all cascades are drawn in a single pass.Returns the draw calls submitted for the casters.
+	INT RenderCascade(ID3D11DeviceContext* pD3dDeviceContext, CDXUTSDKMesh* pMesh, INT iCascade, bool bClearTile, bool bDynamic);
+
+	// RenderCascade for a tile that is stored around its origin:the viewport is moved by the origin and the casters
+	// are drawn once for every place the wrapped projection overlaps the tile,scissored to it.A scrolled cascade
+	// only resets and draws the strips that scrolled in.
+	INT RenderWrappedCascade(ID3D11DeviceContext* pD3dDeviceContext, CDXUTSDKMesh* pMesh, INT iCascade, bool bClearTile, bool bDynamic);
+
+	// Draws the far plane over the current viewport,ClearDepthStencilView can't clear a rectangle.
+	void ClearTile(ID3D11DeviceContext* pD3dDeviceContext);
+
+	// The view of the atlas or the static layer pDSV a cascade is drawn through:the cascade's slice of a texture
+	// array,or pDSV itself when the cascades share one texture.
+	ID3D11DepthStencilView* GetCascadeDSV(ID3D11DepthStencilView* pDSV, INT iCascade) const;
+
+	// Binds the cascade's constants and draws its static or dynamic casters into the current viewport.
+	INT DrawCascadeCasters(ID3D11DeviceContext* pD3dDeviceContext, CDXUTSDKMesh* pMesh, INT iCascade, bool bDynamic);
+
+	// Writes the world bounds of the subsets of iMesh to m_vSubsetBoxMin and m_vSubsetBoxMax,from the positions it
+	// holds now.
+	void ComputeSubsetBounds(CDXUTSDKMesh* pMesh, UINT iMesh);
+
+	// Moves the boxes of the dynamic meshes in m_SceneBounds to where the meshes are this frame.
+	void RefitDynamicCasterBounds(CDXUTSDKMesh* pMesh);
+
+	// The cascades any subset of a dynamic mesh casts into this frame,after culling.
+	UINT GetDynamicCasterCascades(CDXUTSDKMesh* pMesh) const;
+
+	// Resets the tiles of uCascadeMask in the atlas to the static casters,before the dynamic casters are drawn over them.
+	void CopyStaticTiles(ID3D11DeviceContext* pD3dDeviceContext, UINT uCascadeMask);
+
+	// Narrows the cascade masks of the static casters of every scrolled cascade to the casters of its strips.
+	void CullCastersToScrollStrips(CDXUTSDKMesh* pMesh);
+
+	// Writes the view projection of the cascades of uCascadeMask on the immediate context,before any cascade is recorded.
+	HRESULT WriteCascadeConstants(ID3D11DeviceContext* pD3dDeviceContext, UINT uCascadeMask);
+
+	// Binds what WriteCascadeConstants wrote for iCascade to VS slot 0.
+	void BindCascadeConstants(ID3D11DeviceContext* pD3dDeviceContext, INT iCascade);
+
+	// Records the dirty cascades into command lists on the job pool and executes them in cascade order.
+	// Fails before anything is recorded when the deferred contexts can't be created.
+	HRESULT RenderCascadesOnJobPool(ID3D11Device* pD3dDevice, ID3D11DeviceContext* pD3dDeviceContext, CDXUTSDKMesh* pMesh,
+		ID3D11DepthStencilView* pDSV, UINT uCascadeMask, bool bClearTiles, bool bDynamic);
+
+	// Draws the subsets of the static or the dynamic meshes of pMesh that cast into any cascade of uCascadeMask,
+	// nInstanceCount times each.Returns the draw calls submitted.
+	INT RenderCasters(ID3D11DeviceContext* pD3dDeviceContext, CDXUTSDKMesh* pMesh, UINT uCascadeMask, UINT nInstanceCount, bool bDynamic);
+
+	// Simplifies the triangle list subsets of pMesh into m_CasterLods and one index buffer per mesh.
+	HRESULT BuildCasterLods(ID3D11Device* pD3DDevice, CDXUTSDKMesh* pMesh);
+	void ReleaseCasterLods();
 
 	DirectX::XMVECTOR m_vSceneAABBMin;
 	DirectX::XMVECTOR m_vSceneAABBMax;
-
+	SceneBoundsHierarchy m_SceneBounds; // Over the bounds of every mesh subset
+	std::vector<UINT> m_uMeshFirstSubsetBox; // Index of each mesh's first subset in the boxes m_SceneBounds was built from
+	std::vector<DirectX::XMFLOAT3> m_vSubsetBoxMin; // The boxes m_SceneBounds was built from,or refitted to
+	std::vector<DirectX::XMFLOAT3> m_vSubsetBoxMax;
+	std::vector<UINT> m_uCasterCascadeMasks; // Per subset box,the cascades it casts into this frame
+	std::vector<bool> m_bMeshDynamicCaster;
+	INT m_nDynamicCasterMeshes;
+	INT m_nCastersDrawn[MAX_CASCADES];
+	INT m_nCastersCulled[MAX_CASCADES];
+	INT m_nSmallCastersCulled[MAX_CASCADES];
+	FLOAT m_fTileMinCasterTexels; // What the cached tiles were rendered with
+	INT m_nShadowDrawCalls;
+	UINT64 m_uShadowVertexBytes[MAX_CASCADES];
+	UINT64 m_nCascadeTriangles[MAX_CASCADES];
+	std::vector<MeshLod> m_CasterLods; // Indices into the index buffer of the subset's mesh in m_pCasterLodIndexBuffers
+	std::vector<UINT> m_uSubsetFirstLod; // Per subset box and one past the last,the first of its levels in m_CasterLods
+	std::vector<ID3D11Buffer*> m_pCasterLodIndexBuffers; // Per mesh,in the index format of the mesh,nullptr without levels
+	UINT64 m_uCasterLodBytes;
+	bool m_bTileCasterLods; // What the cached tiles were rendered with
+	FLOAT m_fTileCasterLodTexels;
+	FLOAT m_fShadowRecordMilliseconds;
 	// For example:when the shadow buffer size changes.
 	char m_cVertexShaderMode[32];
 	char m_cPixelShaderMode[32];
 	char m_cGeometryShaderMode[32];
+	char m_cComputeShaderMode[32];
 	DirectX::XMMATRIX m_matOrthoProjForCascades[MAX_CASCADES];
 	DirectX::XMMATRIX m_matShadowView;
+	CascadeFrustumSlices m_FrustumSlices;
+	CascadeFitParams m_FitParams; // What the current fit was made with
+	CascadeCache m_CascadeCache;
+	UINT m_uDirtyCascadeMask; // Cascades RenderShadowForAllCascades has to draw this frame
+	UINT m_uScrollCascadeMask; // The dirty cascades that scroll their tile instead
+	UINT m_uDynamicCasterCascadeMask; // Cascades the dynamic casters were drawn into last frame
+	CascadeScroll m_CascadeScrolls[MAX_CASCADES];
+	INT m_iTileOriginX[MAX_CASCADES]; // Where texel (0,0) of each cascade is stored in its tile this frame
+	INT m_iTileOriginY[MAX_CASCADES];
+	std::vector<UINT> m_uStripCasterMasks; // Per subset box,the cascades whose strips it casts into,twice for 2 strips
 	CascadeConfig m_CopyOfCascadeConfig; // this copy is used to determine when setting change.
 										// Some of these settings require new buffer allocations
 	CascadeConfig* m_pCascadeConfig;	//Pointer to the most recent setting.
 
 	// D3D11 variables
 	ID3D11InputLayout* m_pMeshVertexLayout;
+	ID3D11InputLayout* m_pShadowVertexLayout; // The position alone,reads interleaved vertices and the position stream alike
 	ID3D11VertexShader* m_pRenderOrthoShadowVertexShader;
 	ID3DBlob* m_pRenderOrthoShadowVertexShaderBlob;
+	ID3D11VertexShader* m_pClearTileVertexShader;
+	ID3DBlob* m_pClearTileVertexShaderBlob;
+	ID3D11PixelShader* m_pCopyStaticTilePixelShader;
+	ID3DBlob* m_pCopyStaticTilePixelShaderBlob;
+	ID3D11VertexShader* m_pRenderShadowInstancedVertexShader;
+	ID3DBlob* m_pRenderShadowInstancedVertexShaderBlob;
+	ID3D11GeometryShader* m_pRouteToCascadeGeometryShader;
+	ID3DBlob* m_pRouteToCascadeGeometryShaderBlob;
+	ID3D11ComputeShader* m_pDepthReductionComputeShader;
+	ID3DBlob* m_pDepthReductionComputeShaderBlob;
 	ID3D11VertexShader* m_pRenderSceneVertexShader[MAX_CASCADES];
 	ID3DBlob* m_pRenderSceneVertexShaderBlob[MAX_CASCADES];
 	ID3D11PixelShader* m_pRenderSceneAllPixelShaders[MAX_CASCADES][2][2][2];
 	ID3DBlob* m_pRenderSceneAllPixelShaderBlobs[MAX_CASCADES][2][2][2];
 
+	// The shadow map and static layer views are owned by m_ShadowTexturePool,see UsePooledShadowTextures.
+	ShadowTexturePool m_ShadowTexturePool;
+	PooledShadowTexture* m_pShadowMapPoolTexture;
+	PooledShadowTexture* m_pStaticShadowMapPoolTexture;
 	ID3D11Texture2D* m_pCascadedShadowMapTexture;
 	ID3D11DepthStencilView* m_pCascadedShadowMapDSV;
 	ID3D11ShaderResourceView* m_pCascadedShadowMapSRV;
+	ID3D11Texture2D* m_pStaticShadowMapTexture; // Depth of the static casters,only allocated while there are dynamic casters
+	ID3D11DepthStencilView* m_pStaticShadowMapDSV;
+	ID3D11ShaderResourceView* m_pStaticShadowMapSRV;
+	bool m_bCascadeTextureArray; // What the shadow map was allocated as
+	ID3D11DepthStencilView* m_pCascadedShadowMapSliceDSVs[MAX_CASCADES]; // One per cascade of a texture array
+	ID3D11DepthStencilView* m_pStaticShadowMapSliceDSVs[MAX_CASCADES];
+	UINT64 m_uShadowMapBytes;
+	INT m_iCascadeLengthOfShadowBuffer[MAX_CASCADES]; // See CascadeConfig::m_iCascadeLengthOfShadowBuffer,with the 0s resolved
+	AtlasRect m_CascadeAtlasRects[MAX_CASCADES]; // The viewports and the scene's tile constants are made from these
+	INT m_iShadowAtlasWidth; // Rounded up to the size class of the pooled texture
+	INT m_iShadowAtlasHeight;
+
+	ID3D11Buffer* m_pDepthBoundsBuffer; // Min depth and inverted max depth bits,see DepthReduction.hlsl
+	ID3D11UnorderedAccessView* m_pDepthBoundsUAV;
+	ID3D11Buffer* m_pDepthBoundsStagingBuffer[DEPTH_BOUNDS_READBACK_LATENCY];
+	UINT m_uDepthBoundsFrame; // Reductions since the bounds were last reset
+	bool m_bDepthBoundsValid;
+	FLOAT m_fDepthBoundsMin;
+	FLOAT m_fDepthBoundsMax;
+
+	ID3D11Buffer* m_pPerObjectConstantBuffer; // CB_PER_OBJECT
+	ID3D11Buffer* m_pShadowFrameConstantBuffer; // CB_SHADOW_FRAME
+	ID3D11Buffer* m_pShadowCascadesConstantBuffer; // CB_SHADOW_CASCADES for single pass rendering
+
+	// CB_PER_CASCADE.When the device can bind constant buffers at an offset the cascades of a frame are appended
+	// to one ring with a single Map,otherwise every cascade has a buffer of its own.
+	ID3D11Buffer* m_pCascadeConstantRing;
+	UINT m_uCascadeRingNextSlot;
+	UINT m_uCascadeRingSlot[MAX_CASCADES]; // Where each cascade's constants were written this frame
+	ID3D11Buffer* m_pCascadeConstantBuffers[MAX_CASCADES];
 
-	//jingz todo shader ˣ߼ֿ
-	ID3D11Buffer* m_pGlobalConstantBuffer;// All VS and PS Contants are in the same buffer.
-											// An actual title would break this up into multiple
-											// buffers updated based on frequency of variable changes
+	JobPool* m_pJobPool;
+	GpuMemoryTracker* m_pMemoryTracker;
+	ID3D11DeviceContext* m_pCascadeDeferredContexts[MAX_CASCADES]; // Created the first time a cascade is recorded on the pool
+	ID3D11CommandList* m_pCascadeCommandLists[MAX_CASCADES];
+	INT m_nCascadeDrawCalls[MAX_CASCADES]; // Written by the job that records the cascade
 
 	ID3D11DepthStencilState* m_pDepthStencilStateLess;
+	ID3D11DepthStencilState* m_pDepthStencilStateAlways; // Used to reset a single atlas tile
 
 	ID3D11RasterizerState* m_pRasterizerStateScene;
 	ID3D11RasterizerState* m_pRasterizerStateShadow;
 	ID3D11RasterizerState* m_pRasterizerStateShadowPancake;
+	ID3D11RasterizerState* m_pRasterizerStateShadowScissor; // For the pieces of wrapped tiles
+	ID3D11RasterizerState* m_pRasterizerStateShadowPancakeScissor;
 
 	D3D11_VIEWPORT m_RenderViewPort[MAX_CASCADES];//CascadedShadowһRenderTargetͨViewPortƫƵȣʵֽͬ㼶ӰƵͬһRTĲͬλ
 	D3D11_VIEWPORT m_RenderOneTileVP;
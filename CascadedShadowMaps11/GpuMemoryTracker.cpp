@@ -0,0 +1,411 @@
+#include "GpuMemoryTracker.h"
+
+#include <cstdio>
+
+namespace
+{
+
+UINT GetBitsPerTexel(DXGI_FORMAT Format)
+{
+	switch (Format)
+	{
+	case DXGI_FORMAT_R32G32B32A32_TYPELESS:
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:
+	case DXGI_FORMAT_R32G32B32A32_UINT:
+	case DXGI_FORMAT_R32G32B32A32_SINT:
+		return 128;
+	case DXGI_FORMAT_R32G32B32_TYPELESS:
+	case DXGI_FORMAT_R32G32B32_FLOAT:
+	case DXGI_FORMAT_R32G32B32_UINT:
+	case DXGI_FORMAT_R32G32B32_SINT:
+		return 96;
+	case DXGI_FORMAT_R16G16B16A16_TYPELESS:
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:
+	case DXGI_FORMAT_R16G16B16A16_UNORM:
+	case DXGI_FORMAT_R16G16B16A16_UINT:
+	case DXGI_FORMAT_R16G16B16A16_SNORM:
+	case DXGI_FORMAT_R16G16B16A16_SINT:
+	case DXGI_FORMAT_R32G32_TYPELESS:
+	case DXGI_FORMAT_R32G32_FLOAT:
+	case DXGI_FORMAT_R32G32_UINT:
+	case DXGI_FORMAT_R32G32_SINT:
+	case DXGI_FORMAT_R32G8X24_TYPELESS:
+	case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+	case DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS:
+	case DXGI_FORMAT_X32_TYPELESS_G8X24_UINT:
+		return 64;
+	case DXGI_FORMAT_R8G8_TYPELESS:
+	case DXGI_FORMAT_R8G8_UNORM:
+	case DXGI_FORMAT_R8G8_UINT:
+	case DXGI_FORMAT_R8G8_SNORM:
+	case DXGI_FORMAT_R8G8_SINT:
+	case DXGI_FORMAT_R16_TYPELESS:
+	case DXGI_FORMAT_R16_FLOAT:
+	case DXGI_FORMAT_D16_UNORM:
+	case DXGI_FORMAT_R16_UNORM:
+	case DXGI_FORMAT_R16_UINT:
+	case DXGI_FORMAT_R16_SNORM:
+	case DXGI_FORMAT_R16_SINT:
+	case DXGI_FORMAT_B5G6R5_UNORM:
+	case DXGI_FORMAT_B5G5R5A1_UNORM:
+		return 16;
+	case DXGI_FORMAT_R8_TYPELESS:
+	case DXGI_FORMAT_R8_UNORM:
+	case DXGI_FORMAT_R8_UINT:
+	case DXGI_FORMAT_R8_SNORM:
+	case DXGI_FORMAT_R8_SINT:
+	case DXGI_FORMAT_A8_UNORM:
+	case DXGI_FORMAT_BC2_TYPELESS:
+	case DXGI_FORMAT_BC2_UNORM:
+	case DXGI_FORMAT_BC2_UNORM_SRGB:
+	case DXGI_FORMAT_BC3_TYPELESS:
+	case DXGI_FORMAT_BC3_UNORM:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+	case DXGI_FORMAT_BC5_TYPELESS:
+	case DXGI_FORMAT_BC5_UNORM:
+	case DXGI_FORMAT_BC5_SNORM:
+	case DXGI_FORMAT_BC6H_TYPELESS:
+	case DXGI_FORMAT_BC6H_UF16:
+	case DXGI_FORMAT_BC6H_SF16:
+	case DXGI_FORMAT_BC7_TYPELESS:
+	case DXGI_FORMAT_BC7_UNORM:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		return 8;
+	case DXGI_FORMAT_BC1_TYPELESS:
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+	case DXGI_FORMAT_BC4_TYPELESS:
+	case DXGI_FORMAT_BC4_UNORM:
+	case DXGI_FORMAT_BC4_SNORM:
+		return 4;
+	default:
+		return 32; // The 32 bit colour and depth formats,and a guess for the rest
+	}
+}
+
+bool IsBlockCompressed(DXGI_FORMAT Format)
+{
+	return (Format >= DXGI_FORMAT_BC1_TYPELESS && Format <= DXGI_FORMAT_BC5_SNORM)
+		|| (Format >= DXGI_FORMAT_BC6H_TYPELESS && Format <= DXGI_FORMAT_BC7_UNORM_SRGB);
+}
+
+UINT MipSide(UINT uSide, UINT iMip)
+{
+	UINT uMipSide = uSide >> iMip;
+	return uMipSide > 0 ? uMipSide : 1;
+}
+
+// Bytes of every mip of one array slice.A mip count of 0 is the whole chain.
+UINT64 GetMipChainBytes(DXGI_FORMAT Format, UINT uWidth, UINT uHeight, UINT uDepth, UINT* pMipLevels)
+{
+	UINT nMips = *pMipLevels;
+	if (nMips == 0)
+	{
+		UINT uLargestSide = uWidth > uHeight ? uWidth : uHeight;
+		uLargestSide = uLargestSide > uDepth ? uLargestSide : uDepth;
+		nMips = 1;
+		while (uLargestSide > 1)
+		{
+			uLargestSide >>= 1;
+			++nMips;
+		}
+		*pMipLevels = nMips;
+	}
+
+	UINT uBits = GetBitsPerTexel(Format);
+	UINT64 uBytes = 0;
+	for (UINT iMip = 0;iMip < nMips;++iMip)
+	{
+		UINT uMipWidth = MipSide(uWidth, iMip);
+		UINT uMipHeight = MipSide(uHeight, iMip);
+		UINT64 uSliceBytes;
+		if (IsBlockCompressed(Format))
+		{
+			// 16 texels per block
+			uSliceBytes = (UINT64)((uMipWidth + 3) / 4) * uBits * 2 * ((uMipHeight + 3) / 4);
+		}
+		else
+		{
+			uSliceBytes = (UINT64)((uMipWidth * uBits + 7) / 8) * uMipHeight;
+		}
+		uBytes += uSliceBytes * MipSide(uDepth, iMip);
+	}
+	return uBytes;
+}
+
+// Fills everything but the tag and the name.
+void DescribeResource(ID3D11Resource* pResource, GpuMemoryRecord* pRecord)
+{
+	pRecord->m_pObject = pResource;
+	pRecord->m_uBytes = 0;
+	pRecord->m_Format = DXGI_FORMAT_UNKNOWN;
+	pRecord->m_uWidth = 0;
+	pRecord->m_uHeight = 1;
+	pRecord->m_uDepthOrArraySize = 1;
+	pRecord->m_nMipLevels = 1;
+
+	D3D11_RESOURCE_DIMENSION eDimension = D3D11_RESOURCE_DIMENSION_UNKNOWN;
+	pResource->GetType(&eDimension);
+	switch (eDimension)
+	{
+	case D3D11_RESOURCE_DIMENSION_BUFFER:
+	{
+		D3D11_BUFFER_DESC desc;
+		static_cast<ID3D11Buffer*>(pResource)->GetDesc(&desc);
+		pRecord->m_uWidth = desc.ByteWidth;
+		pRecord->m_uBytes = desc.ByteWidth;
+		break;
+	}
+	case D3D11_RESOURCE_DIMENSION_TEXTURE1D:
+	{
+		D3D11_TEXTURE1D_DESC desc;
+		static_cast<ID3D11Texture1D*>(pResource)->GetDesc(&desc);
+		pRecord->m_Format = desc.Format;
+		pRecord->m_uWidth = desc.Width;
+		pRecord->m_uDepthOrArraySize = desc.ArraySize;
+		pRecord->m_nMipLevels = desc.MipLevels;
+		pRecord->m_uBytes = GetMipChainBytes(desc.Format, desc.Width, 1, 1, &pRecord->m_nMipLevels) * desc.ArraySize;
+		break;
+	}
+	case D3D11_RESOURCE_DIMENSION_TEXTURE2D:
+	{
+		D3D11_TEXTURE2D_DESC desc;
+		static_cast<ID3D11Texture2D*>(pResource)->GetDesc(&desc);
+		pRecord->m_Format = desc.Format;
+		pRecord->m_uWidth = desc.Width;
+		pRecord->m_uHeight = desc.Height;
+		pRecord->m_uDepthOrArraySize = desc.ArraySize;
+		pRecord->m_nMipLevels = desc.MipLevels;
+		pRecord->m_uBytes = GetMipChainBytes(desc.Format, desc.Width, desc.Height, 1, &pRecord->m_nMipLevels) * desc.ArraySize * desc.SampleDesc.Count;
+		break;
+	}
+	case D3D11_RESOURCE_DIMENSION_TEXTURE3D:
+	{
+		D3D11_TEXTURE3D_DESC desc;
+		static_cast<ID3D11Texture3D*>(pResource)->GetDesc(&desc);
+		pRecord->m_Format = desc.Format;
+		pRecord->m_uWidth = desc.Width;
+		pRecord->m_uHeight = desc.Height;
+		pRecord->m_uDepthOrArraySize = desc.Depth;
+		pRecord->m_nMipLevels = desc.MipLevels;
+		pRecord->m_uBytes = GetMipChainBytes(desc.Format, desc.Width, desc.Height, desc.Depth, &pRecord->m_nMipLevels);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+}
+
+GpuMemoryTracker::GpuMemoryTracker() :
+	m_uTotalLiveBytes(0),
+	m_uTotalHighWaterBytes(0),
+	m_nTracked(0),
+	m_nUntracked(0)
+{
+	for (INT i = 0;i < GPU_MEMORY_TAG_COUNT;++i)
+	{
+		m_uLiveBytes[i] = 0;
+		m_uHighWaterBytes[i] = 0;
+		m_nLiveCount[i] = 0;
+	}
+}
+
+const char* GpuMemoryTracker::GetTagName(GPU_MEMORY_TAG eTag)
+{
+	static const char* szNames[GPU_MEMORY_TAG_COUNT] =
+	{
+		"shadow map",
+		"shadow buffers",
+		"shader blobs",
+		"mesh",
+		"materials",
+		"gui",
+		"scene targets",
+	};
+	return eTag < GPU_MEMORY_TAG_COUNT ? szNames[eTag] : "unknown";
+}
+
+UINT64 GpuMemoryTracker::GetResourceBytes(ID3D11Resource* pResource)
+{
+	GpuMemoryRecord record;
+	DescribeResource(pResource, &record);
+	return record.m_uBytes;
+}
+
+void GpuMemoryTracker::TrackResource(GPU_MEMORY_TAG eTag, ID3D11Resource* pResource, const char* szName)
+{
+	if (pResource == nullptr)
+	{
+		return;
+	}
+
+	GpuMemoryRecord record;
+	DescribeResource(pResource, &record);
+	record.m_eTag = eTag;
+	record.m_Name = szName != nullptr ? szName : "";
+	AddRecord(record);
+}
+
+void GpuMemoryTracker::TrackView(GPU_MEMORY_TAG eTag, ID3D11View* pView, const char* szName)
+{
+	if (pView == nullptr)
+	{
+		return;
+	}
+
+	ID3D11Resource* pResource = nullptr;
+	pView->GetResource(&pResource);
+	TrackResource(eTag, pResource, szName);
+	if (pResource != nullptr)
+	{
+		pResource->Release();
+	}
+}
+
+void GpuMemoryTracker::TrackBlob(GPU_MEMORY_TAG eTag, ID3DBlob* pBlob, const char* szName)
+{
+	if (pBlob == nullptr)
+	{
+		return;
+	}
+
+	GpuMemoryRecord record;
+	record.m_pObject = pBlob;
+	record.m_eTag = eTag;
+	record.m_uBytes = pBlob->GetBufferSize();
+	record.m_Format = DXGI_FORMAT_UNKNOWN;
+	record.m_uWidth = (UINT)pBlob->GetBufferSize();
+	record.m_uHeight = 1;
+	record.m_uDepthOrArraySize = 1;
+	record.m_nMipLevels = 1;
+	record.m_Name = szName != nullptr ? szName : "";
+	AddRecord(record);
+}
+
+void GpuMemoryTracker::AddRecord(const GpuMemoryRecord& record)
+{
+	for (size_t i = 0;i < m_Records.size();++i)
+	{
+		if (m_Records[i].m_pObject == record.m_pObject)
+		{
+			return;
+		}
+	}
+
+	m_Records.push_back(record);
+	++m_nTracked;
+	++m_nLiveCount[record.m_eTag];
+	m_uLiveBytes[record.m_eTag] += record.m_uBytes;
+	m_uTotalLiveBytes += record.m_uBytes;
+	if (m_uLiveBytes[record.m_eTag] > m_uHighWaterBytes[record.m_eTag])
+	{
+		m_uHighWaterBytes[record.m_eTag] = m_uLiveBytes[record.m_eTag];
+	}
+	if (m_uTotalLiveBytes > m_uTotalHighWaterBytes)
+	{
+		m_uTotalHighWaterBytes = m_uTotalLiveBytes;
+	}
+}
+
+void GpuMemoryTracker::Untrack(const void* pObject)
+{
+	if (pObject == nullptr)
+	{
+		return;
+	}
+
+	for (size_t i = 0;i < m_Records.size();++i)
+	{
+		if (m_Records[i].m_pObject == pObject)
+		{
+			const GpuMemoryRecord& record = m_Records[i];
+			++m_nUntracked;
+			--m_nLiveCount[record.m_eTag];
+			m_uLiveBytes[record.m_eTag] -= record.m_uBytes;
+			m_uTotalLiveBytes -= record.m_uBytes;
+			m_Records.erase(m_Records.begin() + i);
+			return;
+		}
+	}
+}
+
+void GpuMemoryTracker::UntrackView(ID3D11View* pView)
+{
+	if (pView == nullptr)
+	{
+		return;
+	}
+
+	// Only the address is compared,the reference is given back right away.
+	ID3D11Resource* pResource = nullptr;
+	pView->GetResource(&pResource);
+	if (pResource != nullptr)
+	{
+		pResource->Release();
+		Untrack(pResource);
+	}
+}
+
+void GpuMemoryTracker::UntrackTag(GPU_MEMORY_TAG eTag)
+{
+	for (size_t i = m_Records.size();i > 0;--i)
+	{
+		if (m_Records[i - 1].m_eTag == eTag)
+		{
+			Untrack(m_Records[i - 1].m_pObject);
+		}
+	}
+}
+
+void GpuMemoryTracker::ResetHighWater()
+{
+	for (INT i = 0;i < GPU_MEMORY_TAG_COUNT;++i)
+	{
+		m_uHighWaterBytes[i] = m_uLiveBytes[i];
+	}
+	m_uTotalHighWaterBytes = m_uTotalLiveBytes;
+}
+
+std::string GpuMemoryTracker::GetReport(bool bObjects) const
+{
+	std::string report;
+	char szLine[256];
+
+	snprintf(szLine, sizeof(szLine), "%-16s %14s %14s %8s\n", "gpu memory", "live bytes", "high water", "objects");
+	report += szLine;
+	for (INT i = 0;i < GPU_MEMORY_TAG_COUNT;++i)
+	{
+		snprintf(szLine, sizeof(szLine), "%-16s %14llu %14llu %8u\n", GetTagName((GPU_MEMORY_TAG)i),
+			(unsigned long long)m_uLiveBytes[i], (unsigned long long)m_uHighWaterBytes[i], m_nLiveCount[i]);
+		report += szLine;
+	}
+	snprintf(szLine, sizeof(szLine), "%-16s %14llu %14llu %8u\n", "total", (unsigned long long)m_uTotalLiveBytes,
+		(unsigned long long)m_uTotalHighWaterBytes, (UINT)m_Records.size());
+	report += szLine;
+
+	if (bObjects)
+	{
+		// Grouped by tag in the order they were recorded.
+		snprintf(szLine, sizeof(szLine), "\n%-16s %14s %6s %18s %5s  %s\n", "tag", "bytes", "format", "size", "mips", "name");
+		report += szLine;
+		for (INT iTag = 0;iTag < GPU_MEMORY_TAG_COUNT;++iTag)
+		{
+			for (size_t i = 0;i < m_Records.size();++i)
+			{
+				const GpuMemoryRecord& record = m_Records[i];
+				if (record.m_eTag != iTag)
+				{
+					continue;
+				}
+				char szSize[32];
+				snprintf(szSize, sizeof(szSize), "%ux%ux%u", record.m_uWidth, record.m_uHeight, record.m_uDepthOrArraySize);
+				snprintf(szLine, sizeof(szLine), "%-16s %14llu %6d %18s %5u  %s\n", GetTagName(record.m_eTag), (unsigned long long)record.m_uBytes,
+					(INT)record.m_Format, szSize, record.m_nMipLevels, record.m_Name.c_str());
+				report += szLine;
+			}
+		}
+	}
+	return report;
+}
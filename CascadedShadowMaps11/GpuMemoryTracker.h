@@ -0,0 +1,122 @@
+//--------------------------------------------------------------------------------------
+// File: GpuMemoryTracker.h
+//
+// Bytes of the device memory the sample holds,by the subsystem that holds it. Whoever creates
+// a buffer,texture or shader blob records it with a tag and forgets it before releasing it.
+// The tracker keeps the live bytes and the high water mark of every tag and of all of them,and
+// writes a report of every object alive. The application owns one tracker and hands it to the
+// CascadedShadowsManager;it is only used from the thread that creates the device objects.
+//--------------------------------------------------------------------------------------
+#pragma once
+
+#include <d3d11.h>
+#include <d3dcommon.h>
+#include <string>
+#include <vector>
+
+enum GPU_MEMORY_TAG
+{
+	GPU_MEMORY_SHADOW_MAP, // The shadow map,its static layer and the pooled ones of earlier configs
+	GPU_MEMORY_SHADOW_BUFFERS, // Constant buffers,depth bounds and caster level index buffers of the manager
+	GPU_MEMORY_SHADER_BLOBS, // Compiled shaders the manager keeps to create them again
+	GPU_MEMORY_MESH, // SDKmesh vertex,index and position stream buffers
+	GPU_MEMORY_MATERIALS, // Textures loaded for the SDKmesh materials
+	GPU_MEMORY_GUI, // Sprite,font and screen quad buffers and the textures of the DXUT GUI
+	GPU_MEMORY_SCENE_TARGETS, // Render targets and depth buffers of the application
+	GPU_MEMORY_TAG_COUNT
+};
+
+struct GpuMemoryRecord
+{
+	const void* m_pObject; // The resource or the blob
+	GPU_MEMORY_TAG m_eTag;
+	UINT64 m_uBytes;
+	DXGI_FORMAT m_Format; // DXGI_FORMAT_UNKNOWN for buffers and blobs
+	UINT m_uWidth; // Bytes of a buffer or a blob
+	UINT m_uHeight;
+	UINT m_uDepthOrArraySize;
+	UINT m_nMipLevels;
+	std::string m_Name;
+};
+
+class GpuMemoryTracker
+{
+public:
+	GpuMemoryTracker();
+
+	static const char* GetTagName(GPU_MEMORY_TAG eTag);
+
+	// Bytes of a resource with all of its mips,array slices and samples.
+	static UINT64 GetResourceBytes(ID3D11Resource* pResource);
+
+	// Recording an object that is already recorded,or nullptr,does nothing.The resource of a view is recorded.
+	void TrackResource(GPU_MEMORY_TAG eTag, ID3D11Resource* pResource, const char* szName);
+	void TrackView(GPU_MEMORY_TAG eTag, ID3D11View* pView, const char* szName);
+	void TrackBlob(GPU_MEMORY_TAG eTag, ID3DBlob* pBlob, const char* szName);
+
+	// Forgets an object before it is released,nullptr and unrecorded objects are ignored.
+	void Untrack(const void* pObject);
+	void UntrackView(ID3D11View* pView);
+
+	// Forgets every object of a tag,for the subsystems whose objects are only looked at from outside.
+	void UntrackTag(GPU_MEMORY_TAG eTag);
+
+	UINT64 GetLiveBytes(GPU_MEMORY_TAG eTag) const
+	{
+		return m_uLiveBytes[eTag];
+	}
+
+	UINT64 GetHighWaterBytes(GPU_MEMORY_TAG eTag) const
+	{
+		return m_uHighWaterBytes[eTag];
+	}
+
+	UINT64 GetLiveBytes() const
+	{
+		return m_uTotalLiveBytes;
+	}
+
+	UINT64 GetHighWaterBytes() const
+	{
+		return m_uTotalHighWaterBytes;
+	}
+
+	UINT GetLiveCount(GPU_MEMORY_TAG eTag) const
+	{
+		return m_nLiveCount[eTag];
+	}
+
+	// Objects recorded and forgotten since the tracker was made.
+	UINT GetTrackedCount() const
+	{
+		return m_nTracked;
+	}
+
+	UINT GetUntrackedCount() const
+	{
+		return m_nUntracked;
+	}
+
+	const std::vector<GpuMemoryRecord>& GetRecords() const
+	{
+		return m_Records;
+	}
+
+	// The high water marks start again from the live bytes.
+	void ResetHighWater();
+
+	// One line per tag with its live bytes,high water mark and objects,then one line per live object when bObjects.
+	std::string GetReport(bool bObjects) const;
+
+private:
+	void AddRecord(const GpuMemoryRecord& record);
+
+	std::vector<GpuMemoryRecord> m_Records;
+	UINT64 m_uLiveBytes[GPU_MEMORY_TAG_COUNT];
+	UINT64 m_uHighWaterBytes[GPU_MEMORY_TAG_COUNT];
+	UINT m_nLiveCount[GPU_MEMORY_TAG_COUNT];
+	UINT64 m_uTotalLiveBytes;
+	UINT64 m_uTotalHighWaterBytes;
+	UINT m_nTracked;
+	UINT m_nUntracked;
+};
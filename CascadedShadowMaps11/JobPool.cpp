@@ -0,0 +1,97 @@
+#include "JobPool.h"
+
+JobPool::JobPool() :
+	m_nUnfinishedJobs(0),
+	m_bStopping(false)
+{
+}
+
+JobPool::~JobPool()
+{
+	Stop();
+}
+
+void JobPool::Start(unsigned int nThreadCount)
+{
+	Stop();
+
+	if (nThreadCount == 0)
+	{
+		unsigned int nHardwareThreads = std::thread::hardware_concurrency();
+		nThreadCount = nHardwareThreads > 1 ? nHardwareThreads - 1 : 0;
+	}
+
+	m_bStopping = false;
+	for (unsigned int i = 0;i < nThreadCount;++i)
+	{
+		m_Threads.push_back(std::thread(&JobPool::WorkerMain, this));
+	}
+}
+
+void JobPool::Stop()
+{
+	WaitForAll();
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_bStopping = true;
+	}
+	m_JobQueued.notify_all();
+
+	for (size_t i = 0;i < m_Threads.size();++i)
+	{
+		m_Threads[i].join();
+	}
+	m_Threads.clear();
+}
+
+void JobPool::Submit(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Jobs.push_back(std::move(job));
+		++m_nUnfinishedJobs;
+	}
+	m_JobQueued.notify_one();
+}
+
+void JobPool::WaitForAll()
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	while (!m_Jobs.empty())
+	{
+		RunFrontJob(lock);
+	}
+
+	// The last jobs may still run on the workers.
+	m_AllFinished.wait(lock, [this] { return m_nUnfinishedJobs == 0; });
+}
+
+void JobPool::WorkerMain()
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	for (;;)
+	{
+		m_JobQueued.wait(lock, [this] { return m_bStopping || !m_Jobs.empty(); });
+		if (m_Jobs.empty())
+		{
+			return;
+		}
+		RunFrontJob(lock);
+	}
+}
+
+void JobPool::RunFrontJob(std::unique_lock<std::mutex>& lock)
+{
+	std::function<void()> job = std::move(m_Jobs.front());
+	m_Jobs.pop_front();
+
+	lock.unlock();
+	job();
+	lock.lock();
+
+	if (--m_nUnfinishedJobs == 0)
+	{
+		m_AllFinished.notify_all();
+	}
+}
@@ -0,0 +1,53 @@
+//--------------------------------------------------------------------------------------
+// File: JobPool.h
+//
+// A fixed set of worker threads that run submitted jobs in any order. The application owns
+// one pool and hands it to whoever records work in parallel,the CascadedShadowsManager
+// records the cascades on it. The thread that waits runs queued jobs too,so a pool without
+// workers still finishes everything.
+//--------------------------------------------------------------------------------------
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobPool
+{
+public:
+	JobPool();
+	~JobPool();
+
+	// Starts nThreadCount workers,or one less than the hardware threads when it is 0.
+	void Start(unsigned int nThreadCount);
+
+	// Finishes the queued jobs and joins the workers.
+	void Stop();
+
+	unsigned int GetThreadCount() const
+	{
+		return (unsigned int)m_Threads.size();
+	}
+
+	void Submit(std::function<void()> job);
+
+	// Runs queued jobs on the calling thread until every submitted job has finished.
+	void WaitForAll();
+
+private:
+	void WorkerMain();
+
+	// Runs the front job with the lock released,the lock is held again when it returns.
+	void RunFrontJob(std::unique_lock<std::mutex>& lock);
+
+	std::vector<std::thread> m_Threads;
+	std::deque<std::function<void()>> m_Jobs;
+	std::mutex m_Mutex;
+	std::condition_variable m_JobQueued;
+	std::condition_variable m_AllFinished;
+	unsigned int m_nUnfinishedJobs; // Queued or running
+	bool m_bStopping;
+};
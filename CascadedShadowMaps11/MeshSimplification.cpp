@@ -0,0 +1,474 @@
+#include "MeshSimplification.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <queue>
+
+using namespace DirectX;
+
+// Border edges are kept in place by a plane through the edge,perpendicular to its triangle,weighted this much
+// more than the planes of the triangles.
+#define BORDER_PLANE_WEIGHT 10.0
+
+// A collapse that turns a triangle's normal further than this (cosine) is rejected as a fold.
+#define MIN_NORMAL_COSINE 0.2
+
+// The last level is only kept if it has at most this part of the triangles of the level before.
+#define MIN_LAST_LOD_REDUCTION 0.75f
+
+namespace
+{
+
+// Symmetric 4x4 matrix of the summed squared distances to a set of planes:
+// a00 a01 a02 a03 a11 a12 a13 a22 a23 a33.
+struct Quadric
+{
+	double m_a[10];
+};
+
+struct CollapseCandidate
+{
+	double m_fCost;
+	int m_iFrom; // Moves onto m_iTo
+	int m_iTo;
+	unsigned int m_uFromStamp; // Of both vertices when the cost was computed
+	unsigned int m_uToStamp;
+
+	bool operator>(const CollapseCandidate& other) const
+	{
+		return m_fCost > other.m_fCost;
+	}
+};
+
+typedef std::priority_queue<CollapseCandidate, std::vector<CollapseCandidate>, std::greater<CollapseCandidate>> CollapseQueue;
+
+struct SimplifyMesh
+{
+	std::vector<XMFLOAT3> m_vPositions; // Per welded vertex
+	std::vector<unsigned int> m_uIndexValue; // Per welded vertex,the index value it is written back as
+	std::vector<Quadric> m_Quadrics;
+	std::vector<unsigned int> m_uStamps; // Bumped whenever a vertex's quadric grows
+	std::vector<bool> m_bRemoved;
+	std::vector<int> m_iTriangles; // 3 welded vertices per triangle
+	std::vector<bool> m_bTriangleRemoved;
+	std::vector<std::vector<int>> m_VertexTriangles; // Triangles around each vertex,removed ones are skipped
+	int m_nTriangleCount; // Not removed
+};
+
+}
+
+static void AddPlane(Quadric& q, double a, double b, double c, double d, double fWeight)
+{
+	q.m_a[0] += fWeight * a * a; q.m_a[1] += fWeight * a * b; q.m_a[2] += fWeight * a * c; q.m_a[3] += fWeight * a * d;
+	q.m_a[4] += fWeight * b * b; q.m_a[5] += fWeight * b * c; q.m_a[6] += fWeight * b * d;
+	q.m_a[7] += fWeight * c * c; q.m_a[8] += fWeight * c * d;
+	q.m_a[9] += fWeight * d * d;
+}
+
+static double EvaluateQuadric(const Quadric& q, const XMFLOAT3& p)
+{
+	double x = p.x, y = p.y, z = p.z;
+	double fCost = q.m_a[0] * x * x + 2.0 * q.m_a[1] * x * y + 2.0 * q.m_a[2] * x * z + 2.0 * q.m_a[3] * x
+		+ q.m_a[4] * y * y + 2.0 * q.m_a[5] * y * z + 2.0 * q.m_a[6] * y
+		+ q.m_a[7] * z * z + 2.0 * q.m_a[8] * z
+		+ q.m_a[9];
+	return std::max(fCost, 0.0);
+}
+
+static XMVECTOR TriangleNormal(const XMFLOAT3& p0, const XMFLOAT3& p1, const XMFLOAT3& p2)
+{
+	XMVECTOR v0 = XMLoadFloat3(&p0);
+	return XMVector3Cross(XMLoadFloat3(&p1) - v0, XMLoadFloat3(&p2) - v0);
+}
+
+// Vertices at the same position become one,degenerate triangles are dropped.
+static void WeldVertices(const void* pPositions, int iPositionStride, const unsigned int* pIndices, int nIndexCount, SimplifyMesh* pMesh)
+{
+	std::vector<unsigned int> uValues(pIndices, pIndices + nIndexCount);
+	std::sort(uValues.begin(), uValues.end());
+	uValues.erase(std::unique(uValues.begin(), uValues.end()), uValues.end());
+
+	const unsigned char* pBytes = (const unsigned char*)pPositions;
+	std::vector<XMFLOAT3> vValuePositions(uValues.size());
+	std::vector<int> iOrder(uValues.size());
+	for (size_t i = 0;i < uValues.size();++i)
+	{
+		memcpy(&vValuePositions[i], pBytes + (size_t)uValues[i] * iPositionStride, sizeof(XMFLOAT3));
+		iOrder[i] = (int)i;
+	}
+	std::sort(iOrder.begin(), iOrder.end(), [&vValuePositions](int a, int b)
+	{
+		const XMFLOAT3& pa = vValuePositions[a];
+		const XMFLOAT3& pb = vValuePositions[b];
+		return pa.x < pb.x || (pa.x == pb.x && (pa.y < pb.y || (pa.y == pb.y && pa.z < pb.z)));
+	});
+
+	std::vector<int> iWelded(uValues.size());
+	for (size_t i = 0;i < iOrder.size();++i)
+	{
+		const XMFLOAT3& p = vValuePositions[iOrder[i]];
+		if (i == 0 || memcmp(&p, &pMesh->m_vPositions.back(), sizeof(XMFLOAT3)) != 0)
+		{
+			pMesh->m_vPositions.push_back(p);
+			pMesh->m_uIndexValue.push_back(uValues[iOrder[i]]);
+		}
+		iWelded[iOrder[i]] = (int)pMesh->m_vPositions.size() - 1;
+	}
+
+	for (int i = 0;i + 2 < nIndexCount;i += 3)
+	{
+		int iVertex[3];
+		for (int k = 0;k < 3;++k)
+		{
+			iVertex[k] = iWelded[std::lower_bound(uValues.begin(), uValues.end(), pIndices[i + k]) - uValues.begin()];
+		}
+		if (iVertex[0] != iVertex[1] && iVertex[1] != iVertex[2] && iVertex[2] != iVertex[0])
+		{
+			pMesh->m_iTriangles.insert(pMesh->m_iTriangles.end(), iVertex, iVertex + 3);
+		}
+	}
+}
+
+// The quadric of a vertex starts as the planes of its triangles,plus the border planes of its border edges.
+static void InitQuadrics(SimplifyMesh* pMesh)
+{
+	size_t nVertexCount = pMesh->m_vPositions.size();
+	int nTriangleCount = (int)pMesh->m_iTriangles.size() / 3;
+	Quadric zero;
+	memset(&zero, 0, sizeof(zero));
+	pMesh->m_Quadrics.assign(nVertexCount, zero);
+	pMesh->m_uStamps.assign(nVertexCount, 0);
+	pMesh->m_bRemoved.assign(nVertexCount, false);
+	pMesh->m_bTriangleRemoved.assign(nTriangleCount, false);
+	pMesh->m_VertexTriangles.assign(nVertexCount, std::vector<int>());
+	pMesh->m_nTriangleCount = nTriangleCount;
+
+	// Undirected edges as (low vertex,high vertex,triangle),an edge that appears once is a border.
+	struct Edge
+	{
+		int m_iLow;
+		int m_iHigh;
+		int m_iTriangle;
+	};
+	std::vector<Edge> edges;
+	edges.reserve(pMesh->m_iTriangles.size());
+
+	for (int t = 0;t < nTriangleCount;++t)
+	{
+		const int* pTriangle = &pMesh->m_iTriangles[t * 3];
+		XMVECTOR vNormal = TriangleNormal(pMesh->m_vPositions[pTriangle[0]], pMesh->m_vPositions[pTriangle[1]], pMesh->m_vPositions[pTriangle[2]]);
+		float fLength = XMVectorGetX(XMVector3Length(vNormal));
+		if (fLength > 0.0f)
+		{
+			XMFLOAT3 n;
+			XMStoreFloat3(&n, vNormal / fLength);
+			const XMFLOAT3& p = pMesh->m_vPositions[pTriangle[0]];
+			double d = -((double)n.x * p.x + (double)n.y * p.y + (double)n.z * p.z);
+			for (int k = 0;k < 3;++k)
+			{
+				AddPlane(pMesh->m_Quadrics[pTriangle[k]], n.x, n.y, n.z, d, 1.0);
+			}
+		}
+
+		for (int k = 0;k < 3;++k)
+		{
+			pMesh->m_VertexTriangles[pTriangle[k]].push_back(t);
+			Edge edge = { std::min(pTriangle[k], pTriangle[(k + 1) % 3]), std::max(pTriangle[k], pTriangle[(k + 1) % 3]), t };
+			edges.push_back(edge);
+		}
+	}
+
+	std::sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b)
+	{
+		return a.m_iLow < b.m_iLow || (a.m_iLow == b.m_iLow && a.m_iHigh < b.m_iHigh);
+	});
+	for (size_t i = 0;i < edges.size();++i)
+	{
+		bool bShared = (i > 0 && edges[i - 1].m_iLow == edges[i].m_iLow && edges[i - 1].m_iHigh == edges[i].m_iHigh)
+			|| (i + 1 < edges.size() && edges[i + 1].m_iLow == edges[i].m_iLow && edges[i + 1].m_iHigh == edges[i].m_iHigh);
+		if (bShared)
+		{
+			continue;
+		}
+
+		const int* pTriangle = &pMesh->m_iTriangles[edges[i].m_iTriangle * 3];
+		XMVECTOR vNormal = TriangleNormal(pMesh->m_vPositions[pTriangle[0]], pMesh->m_vPositions[pTriangle[1]], pMesh->m_vPositions[pTriangle[2]]);
+		XMVECTOR vLow = XMLoadFloat3(&pMesh->m_vPositions[edges[i].m_iLow]);
+		XMVECTOR vBorderNormal = XMVector3Cross(XMLoadFloat3(&pMesh->m_vPositions[edges[i].m_iHigh]) - vLow, vNormal);
+		float fLength = XMVectorGetX(XMVector3Length(vBorderNormal));
+		if (fLength <= 0.0f)
+		{
+			continue;
+		}
+		XMFLOAT3 n;
+		XMStoreFloat3(&n, vBorderNormal / fLength);
+		const XMFLOAT3& p = pMesh->m_vPositions[edges[i].m_iLow];
+		double d = -((double)n.x * p.x + (double)n.y * p.y + (double)n.z * p.z);
+		AddPlane(pMesh->m_Quadrics[edges[i].m_iLow], n.x, n.y, n.z, d, BORDER_PLANE_WEIGHT);
+		AddPlane(pMesh->m_Quadrics[edges[i].m_iHigh], n.x, n.y, n.z, d, BORDER_PLANE_WEIGHT);
+	}
+}
+
+// The vertices that share a triangle with iVertex,sorted.
+static void GetNeighbours(const SimplifyMesh& mesh, int iVertex, std::vector<int>* pNeighbours)
+{
+	pNeighbours->clear();
+	const std::vector<int>& triangles = mesh.m_VertexTriangles[iVertex];
+	for (size_t i = 0;i < triangles.size();++i)
+	{
+		if (mesh.m_bTriangleRemoved[triangles[i]])
+		{
+			continue;
+		}
+		for (int k = 0;k < 3;++k)
+		{
+			int iOther = mesh.m_iTriangles[triangles[i] * 3 + k];
+			if (iOther != iVertex)
+			{
+				pNeighbours->push_back(iOther);
+			}
+		}
+	}
+	std::sort(pNeighbours->begin(), pNeighbours->end());
+	pNeighbours->erase(std::unique(pNeighbours->begin(), pNeighbours->end()), pNeighbours->end());
+}
+
+// Pushes the cheaper direction of collapsing the edge between a and b.
+static void PushCandidate(const SimplifyMesh& mesh, int a, int b, CollapseQueue* pQueue)
+{
+	Quadric q = mesh.m_Quadrics[a];
+	for (int i = 0;i < 10;++i)
+	{
+		q.m_a[i] += mesh.m_Quadrics[b].m_a[i];
+	}
+	double fCostToB = EvaluateQuadric(q, mesh.m_vPositions[b]);
+	double fCostToA = EvaluateQuadric(q, mesh.m_vPositions[a]);
+
+	CollapseCandidate candidate;
+	candidate.m_fCost = std::min(fCostToA, fCostToB);
+	candidate.m_iFrom = fCostToB <= fCostToA ? a : b;
+	candidate.m_iTo = fCostToB <= fCostToA ? b : a;
+	candidate.m_uFromStamp = mesh.m_uStamps[candidate.m_iFrom];
+	candidate.m_uToStamp = mesh.m_uStamps[candidate.m_iTo];
+	pQueue->push(candidate);
+}
+
+// A collapse must keep the surface manifold (the edge's end points share no neighbour but the opposite
+// vertices of its triangles) and must not fold a triangle over.
+static bool IsCollapseValid(const SimplifyMesh& mesh, int iFrom, int iTo, std::vector<int>* pFromNeighbours, std::vector<int>* pToNeighbours)
+{
+	GetNeighbours(mesh, iFrom, pFromNeighbours);
+	GetNeighbours(mesh, iTo, pToNeighbours);
+	if (!std::binary_search(pFromNeighbours->begin(), pFromNeighbours->end(), iTo))
+	{
+		return false;
+	}
+
+	int nSharedTriangles = 0;
+	const std::vector<int>& triangles = mesh.m_VertexTriangles[iFrom];
+	for (size_t i = 0;i < triangles.size();++i)
+	{
+		if (mesh.m_bTriangleRemoved[triangles[i]])
+		{
+			continue;
+		}
+
+		const int* pTriangle = &mesh.m_iTriangles[triangles[i] * 3];
+		if (pTriangle[0] == iTo || pTriangle[1] == iTo || pTriangle[2] == iTo)
+		{
+			++nSharedTriangles;
+			continue;
+		}
+
+		XMFLOAT3 p[3];
+		for (int k = 0;k < 3;++k)
+		{
+			p[k] = mesh.m_vPositions[pTriangle[k]];
+		}
+		XMVECTOR vBefore = TriangleNormal(p[0], p[1], p[2]);
+		for (int k = 0;k < 3;++k)
+		{
+			if (pTriangle[k] == iFrom)
+			{
+				p[k] = mesh.m_vPositions[iTo];
+			}
+		}
+		XMVECTOR vAfter = TriangleNormal(p[0], p[1], p[2]);
+		float fBeforeAfter = XMVectorGetX(XMVector3Length(vBefore) * XMVector3Length(vAfter));
+		if (fBeforeAfter <= 0.0f || XMVectorGetX(XMVector3Dot(vBefore, vAfter)) < MIN_NORMAL_COSINE * fBeforeAfter)
+		{
+			return false;
+		}
+	}
+
+	std::vector<int> shared;
+	std::set_intersection(pFromNeighbours->begin(), pFromNeighbours->end(), pToNeighbours->begin(), pToNeighbours->end(), std::back_inserter(shared));
+	return (int)shared.size() <= nSharedTriangles;
+}
+
+static void Collapse(SimplifyMesh* pMesh, int iFrom, int iTo)
+{
+	std::vector<int>& fromTriangles = pMesh->m_VertexTriangles[iFrom];
+	for (size_t i = 0;i < fromTriangles.size();++i)
+	{
+		int t = fromTriangles[i];
+		if (pMesh->m_bTriangleRemoved[t])
+		{
+			continue;
+		}
+
+		int* pTriangle = &pMesh->m_iTriangles[t * 3];
+		if (pTriangle[0] == iTo || pTriangle[1] == iTo || pTriangle[2] == iTo)
+		{
+			pMesh->m_bTriangleRemoved[t] = true;
+			--pMesh->m_nTriangleCount;
+			continue;
+		}
+		for (int k = 0;k < 3;++k)
+		{
+			if (pTriangle[k] == iFrom)
+			{
+				pTriangle[k] = iTo;
+			}
+		}
+		pMesh->m_VertexTriangles[iTo].push_back(t);
+	}
+	fromTriangles.clear();
+
+	for (int i = 0;i < 10;++i)
+	{
+		pMesh->m_Quadrics[iTo].m_a[i] += pMesh->m_Quadrics[iFrom].m_a[i];
+	}
+	pMesh->m_bRemoved[iFrom] = true;
+	++pMesh->m_uStamps[iTo];
+
+	// Drop the removed triangles now and then,a vertex can collect many of them.
+	std::vector<int>& toTriangles = pMesh->m_VertexTriangles[iTo];
+	if (toTriangles.size() > 32)
+	{
+		const std::vector<bool>& bRemoved = pMesh->m_bTriangleRemoved;
+		toTriangles.erase(std::remove_if(toTriangles.begin(), toTriangles.end(), [&bRemoved](int t) { return bRemoved[t]; }), toTriangles.end());
+	}
+}
+
+static void AppendLod(const SimplifyMesh& mesh, float fError, MeshLodChain* pChain)
+{
+	MeshLod lod;
+	lod.m_iFirstIndex = (int)pChain->m_Indices.size();
+	lod.m_nIndexCount = mesh.m_nTriangleCount * 3;
+	lod.m_fError = fError;
+	for (size_t t = 0;t < mesh.m_bTriangleRemoved.size();++t)
+	{
+		if (!mesh.m_bTriangleRemoved[t])
+		{
+			for (int k = 0;k < 3;++k)
+			{
+				pChain->m_Indices.push_back(mesh.m_uIndexValue[mesh.m_iTriangles[t * 3 + k]]);
+			}
+		}
+	}
+	pChain->m_Lods.push_back(lod);
+}
+
+namespace MeshSimplification
+{
+
+void BuildLodChain(const void* pPositions, int iPositionStride, const unsigned int* pIndices, int nIndexCount,
+	int nMaxLodCount, float fReduction, float fMaxError, MeshLodChain* pChain)
+{
+	pChain->m_Indices.clear();
+	pChain->m_Lods.clear();
+	if (nIndexCount < 3 || nMaxLodCount <= 0)
+	{
+		return;
+	}
+
+	SimplifyMesh mesh;
+	WeldVertices(pPositions, iPositionStride, pIndices, nIndexCount, &mesh);
+	InitQuadrics(&mesh);
+
+	CollapseQueue queue;
+	std::vector<int> neighbours;
+	for (int iVertex = 0;iVertex < (int)mesh.m_vPositions.size();++iVertex)
+	{
+		GetNeighbours(mesh, iVertex, &neighbours);
+		for (size_t i = 0;i < neighbours.size();++i)
+		{
+			if (neighbours[i] > iVertex)
+			{
+				PushCandidate(mesh, iVertex, neighbours[i], &queue);
+			}
+		}
+	}
+
+	// Quadrics only grow,so a stale candidate costs at most what it costs now and the first up to date
+	// candidate above the error ends the simplification.
+	double fMaxCost = (double)fMaxError * (double)fMaxError;
+	int nLastLodTriangles = mesh.m_nTriangleCount;
+	int nTargetTriangles = (int)((float)nLastLodTriangles * fReduction);
+	double fLargestCost = 0.0;
+	std::vector<int> fromNeighbours;
+	std::vector<int> toNeighbours;
+	while (!queue.empty() && (int)pChain->m_Lods.size() < nMaxLodCount)
+	{
+		CollapseCandidate candidate = queue.top();
+		queue.pop();
+		if (mesh.m_bRemoved[candidate.m_iFrom] || mesh.m_bRemoved[candidate.m_iTo])
+		{
+			continue;
+		}
+		if (candidate.m_uFromStamp != mesh.m_uStamps[candidate.m_iFrom] || candidate.m_uToStamp != mesh.m_uStamps[candidate.m_iTo])
+		{
+			GetNeighbours(mesh, candidate.m_iFrom, &neighbours);
+			if (std::binary_search(neighbours.begin(), neighbours.end(), candidate.m_iTo))
+			{
+				PushCandidate(mesh, candidate.m_iFrom, candidate.m_iTo, &queue);
+			}
+			continue;
+		}
+		if (candidate.m_fCost > fMaxCost)
+		{
+			break;
+		}
+		if (!IsCollapseValid(mesh, candidate.m_iFrom, candidate.m_iTo, &fromNeighbours, &toNeighbours))
+		{
+			continue;
+		}
+
+		Collapse(&mesh, candidate.m_iFrom, candidate.m_iTo);
+		fLargestCost = std::max(fLargestCost, candidate.m_fCost);
+
+		// The edges of the vertex that stayed cost more with its new quadric.
+		GetNeighbours(mesh, candidate.m_iTo, &neighbours);
+		for (size_t i = 0;i < neighbours.size();++i)
+		{
+			PushCandidate(mesh, candidate.m_iTo, neighbours[i], &queue);
+		}
+
+		if (mesh.m_nTriangleCount <= nTargetTriangles)
+		{
+			AppendLod(mesh, (float)sqrt(fLargestCost), pChain);
+			nLastLodTriangles = mesh.m_nTriangleCount;
+			nTargetTriangles = (int)((float)nLastLodTriangles * fReduction);
+		}
+	}
+
+	if ((int)pChain->m_Lods.size() < nMaxLodCount && mesh.m_nTriangleCount <= (int)((float)nLastLodTriangles * MIN_LAST_LOD_REDUCTION))
+	{
+		AppendLod(mesh, (float)sqrt(fLargestCost), pChain);
+	}
+}
+
+int SelectLod(const MeshLod* pLods, int nLodCount, float fMaxError)
+{
+	int iLod = 0;
+	while (iLod < nLodCount && pLods[iLod].m_fError <= fMaxError)
+	{
+		++iLod;
+	}
+	return iLod;
+}
+
+}
@@ -0,0 +1,40 @@
+//--------------------------------------------------------------------------------------
+// File: MeshSimplification.h
+//
+// Quadric error edge collapse simplification of indexed triangle lists,run once at load time
+// to give every mesh subset a chain of coarser index lists for the far cascades. A collapse
+// moves a vertex onto one of its neighbours,so the levels only need new indices and draw from
+// the vertex buffers of the mesh. Like CascadeFitting it only depends on DirectXMath.
+//--------------------------------------------------------------------------------------
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+// One simplified level of a MeshLodChain.
+struct MeshLod
+{
+	int m_iFirstIndex; // Into MeshLodChain::m_Indices
+	int m_nIndexCount;
+	float m_fError; // Estimated distance of the level from the full mesh,in the units of the positions
+};
+
+// The simplified levels of a triangle list,coarser with every level.The full list is level 0 and is not stored.
+struct MeshLodChain
+{
+	std::vector<unsigned int> m_Indices; // Index values of the list the chain was built from
+	std::vector<MeshLod> m_Lods; // Level i + 1
+};
+
+namespace MeshSimplification
+{
+	// Simplifies the triangle list pIndices,whose index values address float3 positions iPositionStride bytes apart
+	// at pPositions. Vertices at the same position are welded first,so seams of normals or texture coordinates do
+	// not crack.Each level has at most fReduction of the triangles of the one before,levels stop when the next
+	// collapse would move the surface further than fMaxError or after nMaxLodCount levels.
+	void BuildLodChain(const void* pPositions, int iPositionStride, const unsigned int* pIndices, int nIndexCount,
+		int nMaxLodCount, float fReduction, float fMaxError, MeshLodChain* pChain);
+
+	// Returns the coarsest of the levels pLods whose error is within fMaxError,as 1 + its index,or 0 for the full list.
+	int SelectLod(const MeshLod* pLods, int nLodCount, float fMaxError);
+}
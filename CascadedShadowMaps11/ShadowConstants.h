@@ -0,0 +1,100 @@
+#pragma once
+
+// The constant buffers the shaders read,with the same layout as their cbuffers.Nothing here needs D3D,
+// so CascadeFittingBench checks the layout and the constant ring outside of Windows as well.
+
+#include <DirectXMath.h>
+#include <cstddef>
+#include "CascadeFitting.h"
+
+#define MAX_CASCADE_COUNT_IN_4 ((MAX_CASCADES+1) / 4)
+#define MAX_CASCADE_COUNT_MORE  ((MAX_CASCADES / 4+1)*4)
+
+// cbShadowCascades in RenderCascadeShadow.hlsl,the view projection of every cascade for single pass rendering.
+struct CB_SHADOW_CASCADES
+{
+	DirectX::XMMATRIX m_CascadeViewProj[MAX_CASCADES];
+	unsigned int m_uCascadeOfInstance[MAX_CASCADES]; // Packed in uint4s on the shader side
+};
+
+// The constants are split by how often they change:cbPerObject and cbShadowFrame in RenderCascadeScene.hlsl
+// are written once per frame by RenderScene,cbPerCascade in RenderCascadeShadow.hlsl once per rendered cascade.
+
+// cbPerObject in RenderCascadeScene.hlsl
+struct CB_PER_OBJECT
+{
+	DirectX::XMMATRIX m_WorldViewProj;
+	DirectX::XMMATRIX m_World;
+	DirectX::XMMATRIX m_WorldView;
+};
+
+// cbPerCascade in RenderCascadeShadow.hlsl,the view projection the casters of one cascade are drawn with.
+struct CB_PER_CASCADE
+{
+	DirectX::XMMATRIX m_ViewProj;
+};
+
+// A constant buffer bound with an offset starts on a multiple of 16 constants.
+#define CB_PER_CASCADE_SLOT_CONSTANTS 16
+#define CB_PER_CASCADE_SLOT_SIZE (CB_PER_CASCADE_SLOT_CONSTANTS * 16)
+
+// Slots of the per cascade constant ring,a few frames of cascades before it is discarded.
+#define CASCADE_CONSTANT_RING_SLOTS (MAX_CASCADES * 4)
+
+// cbShadowFrame in RenderCascadeScene.hlsl,how the scene samples the cascades.
+struct CB_SHADOW_FRAME
+{
+	DirectX::XMMATRIX m_ShadowView;
+	DirectX::XMVECTOR m_vOffsetFactorFromOrthoProjToTexureCoord[8];
+	DirectX::XMVECTOR m_vScaleFactorFromOrthoProjToTexureCoord[8];
+
+	int m_nCascadeLeves; // number of Cascades
+	int m_iIsVisualizeCascade; // 1 is to visualize the cascades in different 
+	int m_iPCFBlurForLoopStart; // For loop begin value.For a 5x5 kernel this would be -2.
+	int m_iPCFBlurForLoopEnd;// For loop end value,For a 5x5 kernel this would be 3.
+
+
+	// Unused since the tiles have their own sizes,the pixel shader reads m_vTileTexelSizeInUV instead.
+	float m_fMinBorderPaddingInShadowUV;
+	float m_fMaxBorderPaddingInShadowUV;
+	float m_fPCFShadowDepthBiaFromGUI; // A shadow map offset to deal with self shadow artifacts.
+								// There artifacts are aggrabated by PCF.
+
+	int m_iIsCascadeTextureArray; // 1 when the cascades are stored in the slices of a texture array instead of an atlas
+	float m_fMaxBlendRatioBetweenCascadeLevel;// Amount to overlap when blending between cascades.
+	float m_fLogicStepPerTexel;// Unused.Shadow map texel size.߼ÿTexelӦShadow(UVλƶ1Ϊܳ)
+	float m_fNativeCascadedShadowMapTexelStepInX;// Unused.Texel size in native map(texture are packed)//ʵϱһ䵽UVλ
+	int m_iIsToroidalTiles; // 1 while a cascade tile is scrolled,see m_vTileOriginInUV
+
+	DirectX::XMVECTOR m_vLightDir;
+
+	DirectX::XMFLOAT4 m_fCascadePartitionDepthsInEyeSpace_InFloat4[MAX_CASCADE_COUNT_IN_4];//The values along Z that separate the cascade.
+
+	//index = 0 0.0fΪռ
+	DirectX::XMFLOAT4 m_fCascadePartitionDepthsInEyeSpace_OnlyX[MAX_CASCADE_COUNT_MORE]; // the values along Z that separate the cascade.
+																// Wastefully stored in float4 so they are array indexable
+
+	DirectX::XMVECTOR m_vTileOriginInUV[8]; // Where texel (0,0) of each cascade is stored in its tile,in x and y
+	DirectX::XMVECTOR m_vTileRectInUV[8]; // Where the tile of each cascade was packed,xy the top left and zw the size
+	DirectX::XMVECTOR m_vTileTexelSizeInUV[8]; // A texel of each cascade,xy in the uv of its tile and zw in the uv of the texture
+};
+
+// The packoffsets of the cbuffers,in constants of 16 bytes.
+static_assert(sizeof(CB_PER_OBJECT) == 12 * 16, "CB_PER_OBJECT does not match cbPerObject");
+static_assert(offsetof(CB_SHADOW_CASCADES, m_uCascadeOfInstance) == MAX_CASCADES * 4 * 16 && sizeof(CB_SHADOW_CASCADES) % 16 == 0,
+	"CB_SHADOW_CASCADES does not match cbShadowCascades");
+static_assert(sizeof(CB_PER_CASCADE) <= CB_PER_CASCADE_SLOT_SIZE, "CB_PER_CASCADE does not fit its ring slot");
+// A buffer bound with VSSetConstantBuffers1 is at most 4096 constants,D3D11_REQ_CONSTANT_BUFFER_ELEMENT_COUNT.
+static_assert(CASCADE_CONSTANT_RING_SLOTS * CB_PER_CASCADE_SLOT_CONSTANTS <= 4096, "The constant ring is larger than a constant buffer");
+static_assert(offsetof(CB_SHADOW_FRAME, m_vOffsetFactorFromOrthoProjToTexureCoord) == 4 * 16
+	&& offsetof(CB_SHADOW_FRAME, m_vScaleFactorFromOrthoProjToTexureCoord) == 12 * 16
+	&& offsetof(CB_SHADOW_FRAME, m_nCascadeLeves) == 20 * 16
+	&& offsetof(CB_SHADOW_FRAME, m_fMinBorderPaddingInShadowUV) == 21 * 16
+	&& offsetof(CB_SHADOW_FRAME, m_fMaxBlendRatioBetweenCascadeLevel) == 22 * 16
+	&& offsetof(CB_SHADOW_FRAME, m_vLightDir) == 23 * 16
+	&& offsetof(CB_SHADOW_FRAME, m_fCascadePartitionDepthsInEyeSpace_InFloat4) == 24 * 16
+	&& offsetof(CB_SHADOW_FRAME, m_fCascadePartitionDepthsInEyeSpace_OnlyX) == 26 * 16
+	&& offsetof(CB_SHADOW_FRAME, m_vTileOriginInUV) == 38 * 16
+	&& offsetof(CB_SHADOW_FRAME, m_vTileRectInUV) == 46 * 16
+	&& offsetof(CB_SHADOW_FRAME, m_vTileTexelSizeInUV) == 54 * 16
+	&& sizeof(CB_SHADOW_FRAME) == 62 * 16, "CB_SHADOW_FRAME does not match cbShadowFrame");
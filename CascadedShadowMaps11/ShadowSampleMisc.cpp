@@ -1,6 +1,8 @@
 #include "../DXUT/Core/DXUT.h"
 #include "ShadowSampleMisc.h"
 #include "../DXUT/Optional/SDKmisc.h"
+#include "../DXUT/Optional/SDKmesh.h"
+#include "GpuMemoryTracker.h"
 #include <d3d10misc.h>
 #include <d3d11.h>
 
@@ -42,3 +44,56 @@ HRESULT CompileShaderFromFile(WCHAR* szFileName, D3D_SHADER_MACRO * macros, LPCS
 
 	return S_OK;
 }
+
+void TrackMeshMemory(GpuMemoryTracker* pMemoryTracker, CDXUTSDKMesh* pMesh, bool bTrack)
+{
+	if (pMemoryTracker == nullptr || pMesh == nullptr)
+	{
+		return;
+	}
+
+	std::vector<ID3D11Buffer*> buffers;
+	for (UINT i = 0;i < pMesh->GetNumVBs();++i)
+	{
+		buffers.push_back(pMesh->GetVB11At(i));
+		buffers.push_back(pMesh->GetPositionVB11At(i));
+	}
+	for (UINT i = 0;i < pMesh->GetNumIBs();++i)
+	{
+		buffers.push_back(pMesh->GetIB11At(i));
+	}
+	for (size_t i = 0;i < buffers.size();++i)
+	{
+		if (bTrack)
+		{
+			pMemoryTracker->TrackResource(GPU_MEMORY_MESH, buffers[i], "SDKMesh Buffer");
+		}
+		else
+		{
+			pMemoryTracker->Untrack(buffers[i]);
+		}
+	}
+
+	// Materials that share a texture record it once,a texture that failed to load is ERROR_RESOURCE_VALUE.
+	for (UINT i = 0;i < pMesh->GetNumMaterials();++i)
+	{
+		SDKMESH_MATERIAL* pMaterial = pMesh->GetMaterial(i);
+		ID3D11ShaderResourceView* pViews[] = { pMaterial->pDiffuseRV11, pMaterial->pNormalRV11, pMaterial->pSpecularRV11 };
+		for (INT iView = 0;iView < 3;++iView)
+		{
+			if (pViews[iView] == nullptr || IsErrorResource(pViews[iView]))
+			{
+				continue;
+			}
+
+			if (bTrack)
+			{
+				pMemoryTracker->TrackView(GPU_MEMORY_MATERIALS, pViews[iView], pMaterial->Name);
+			}
+			else
+			{
+				pMemoryTracker->UntrackView(pViews[iView]);
+			}
+		}
+	}
+}
@@ -2,14 +2,18 @@
 
 #include <d3dcommon.h>
 #include <DirectXMath.h>
-
-#define MAX_CASCADES 8
-#define MAX_CASCADE_COUNT_IN_4 ((MAX_CASCADES+1) / 4)
-#define MAX_CASCADE_COUNT_MORE  ((MAX_CASCADES / 4+1)*4)
+#include "ShadowConstants.h"
 
 HRESULT CompileShaderFromFile(WCHAR* szFileName, D3D_SHADER_MACRO * macros, LPCSTR szEntryPoint,
 	LPCSTR szShaderModel, ID3DBlob** ppBlobOut);
 
+class GpuMemoryTracker;
+class CDXUTSDKMesh;
+
+// Records the vertex,index and position buffers of a mesh as GPU_MEMORY_MESH and the textures of its materials
+// as GPU_MEMORY_MATERIALS,or forgets them when bTrack is false.Call it after Create and before Destroy.
+void TrackMeshMemory(GpuMemoryTracker* pMemoryTracker, CDXUTSDKMesh* pMesh, bool bTrack);
+
 // Used to do selection of the shadow buffer format
 enum SHADOW_TEXTURE_FORMAT
 {
@@ -25,20 +29,6 @@ enum SCENE_SELECTION
 	TEST_SCENE,
 };
 
-enum FIT_LIGHT_VIEW_FRUSTRUM
-{
-	FIT_LIGHT_VIEW_FRUSTRUM_TO_CASCADE_INTERVALS,
-	FIT_LIGHT_VIEW_FRUSTRUM_TO_SCENE
-};
-
-enum FIT_NEAR_FAR
-{
-	FIT_NEAR_FAR_DEFAULT_ZERO_ONE,
-	FIT_NEAR_FAR_ONLY_SCENE_AABB,
-	FIT_NEAR_FAR_SCENE_AABB_AND_ORTHO_BOUND,
-	FIT_NEAR_FAR_PANCAKING,
-};
-
 enum CASCADE_SELECTION_MODE
 {
 	CASCADE_SELECTION_MAP,//jingz 3D仯ͬ㼶Ӧռ䣬ԱȵǰغshadowMapTextureĲ㼶Χڵ¼ΪǰshadowMapTextureĲ㼶
@@ -65,41 +55,6 @@ struct CascadeConfig
 	INT m_nUsingCascadeLevelsCount;
 	SHADOW_TEXTURE_FORMAT m_ShadowBufferFormat;
 	INT m_iLengthOfShadowBufferSquare;
+	bool m_bCascadeTextureArray; // One texture array slice per cascade instead of the cascades side by side in one texture
+	INT m_iCascadeLengthOfShadowBuffer[MAX_CASCADES]; // Tile length of each cascade,0 uses m_iLengthOfShadowBufferSquare
 };
-
-struct CB_ALL_SHADOW_DATA
-{
-	DirectX::XMMATRIX m_WorldViewProj;
-	DirectX::XMMATRIX m_World;
-	DirectX::XMMATRIX m_WorldView;
-	DirectX::XMMATRIX m_ShadowView;
-	DirectX::XMVECTOR m_vOffsetFactorFromOrthoProjToTexureCoord[8];
-	DirectX::XMVECTOR m_vScaleFactorFromOrthoProjToTexureCoord[8];
-
-	INT m_nCascadeLeves; // number of Cascades
-	INT m_iIsVisualizeCascade; // 1 is to visualize the cascades in different 
-	INT m_iPCFBlurForLoopStart; // For loop begin value.For a 5x5 kernel this would be -2.
-	INT m_iPCFBlurForLoopEnd;// For loop end value,For a 5x5 kernel this would be 3.
-
-
-	// For Map based selection scheme, this keeps the pixels inside of the valid range.
-	// When there is no boarder, these values are 0 and 1 respectively
-	FLOAT m_fMinBorderPaddingInShadowUV;
-	FLOAT m_fMaxBorderPaddingInShadowUV;
-	FLOAT m_fPCFShadowDepthBiaFromGUI; // A shadow map offset to deal with self shadow artifacts.
-								// There artifacts are aggrabated by PCF.
-
-	FLOAT m_fWidthPerShadowTextureLevel_InU;
-	FLOAT m_fMaxBlendRatioBetweenCascadeLevel;// Amount to overlap when blending between cascades.
-	FLOAT m_fLogicStepPerTexel;// Shadow map texel size.߼ÿTexelӦShadow(UVλƶ1Ϊܳ)
-	FLOAT m_fNativeCascadedShadowMapTexelStepInX;// Texel size in native map(texture are packed)//ʵϱһ䵽UVλ
-	FLOAT m_fPaddingForCB3;//Padding variables CBs must be a multiple of 16 bytes.
-
-	DirectX::XMVECTOR m_vLightDir;
-
-	DirectX::XMFLOAT4 m_fCascadePartitionDepthsInEyeSpace_InFloat4[MAX_CASCADE_COUNT_IN_4];//The values along Z that separate the cascade.
-
-	//index = 0 0.0fΪռ
-	DirectX::XMFLOAT4 m_fCascadePartitionDepthsInEyeSpace_OnlyX[MAX_CASCADE_COUNT_MORE]; // the values along Z that separate the cascade.
-																// Wastefully stored in float4 so they are array indexable
-};
\ No newline at end of file
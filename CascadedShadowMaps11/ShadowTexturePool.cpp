@@ -0,0 +1,206 @@
+#include "DXUT.h"
+
+#include "ShadowTexturePool.h"
+#include "GpuMemoryTracker.h"
+
+ShadowTexturePool::ShadowTexturePool() :
+	m_pMemoryTracker(nullptr),
+	m_nCreated(0),
+	m_nReused(0)
+{
+}
+
+ShadowTexturePool::~ShadowTexturePool()
+{
+	ReleaseAll();
+}
+
+UINT ShadowTexturePool::GetSizeClassLength(UINT uLength)
+{
+	UINT uClassLength = (uLength + SHADOW_TEXTURE_SIZE_CLASS - 1) / SHADOW_TEXTURE_SIZE_CLASS * SHADOW_TEXTURE_SIZE_CLASS;
+
+	// Rounding up must not make a texture that fits too large to be created.
+	if (uLength <= D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION && uClassLength > D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION)
+	{
+		uClassLength = D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION;
+	}
+	return uClassLength;
+}
+
+HRESULT ShadowTexturePool::Acquire(ID3D11Device* pD3dDevice, const D3D11_TEXTURE2D_DESC& desc, bool bArray, DXGI_FORMAT DsvFormat, DXGI_FORMAT SrvFormat,
+	UINT uBytesPerTexel, const char* szName, PooledShadowTexture** ppTexture)
+{
+	HRESULT hr = S_OK;
+
+	D3D11_TEXTURE2D_DESC classDesc = desc;
+	classDesc.Width = GetSizeClassLength(desc.Width);
+	classDesc.Height = GetSizeClassLength(desc.Height);
+
+	for (size_t i = 0;i < m_Textures.size();++i)
+	{
+		PooledShadowTexture* pTexture = m_Textures[i];
+		if (!pTexture->m_bInUse && memcmp(&pTexture->m_Desc, &classDesc, sizeof(classDesc)) == 0
+			&& pTexture->m_bArray == bArray && pTexture->m_DsvFormat == DsvFormat && pTexture->m_SrvFormat == SrvFormat)
+		{
+			pTexture->m_bInUse = true;
+			pTexture->m_nIdleFrames = 0;
+			++m_nReused;
+			*ppTexture = pTexture;
+			return hr;
+		}
+	}
+
+	PooledShadowTexture* pTexture = new PooledShadowTexture;
+	ZeroMemory(pTexture, sizeof(PooledShadowTexture));
+	pTexture->m_Desc = classDesc;
+	pTexture->m_DsvFormat = DsvFormat;
+	pTexture->m_SrvFormat = SrvFormat;
+	pTexture->m_bArray = bArray;
+	pTexture->m_uBytes = (UINT64)classDesc.Width * classDesc.Height * classDesc.ArraySize * uBytesPerTexel;
+	pTexture->m_bInUse = true;
+
+	// Nothing is kept of a texture that could not be created whole.
+	hr = pD3dDevice->CreateTexture2D(&classDesc, NULL, &pTexture->m_pTexture);
+	if (SUCCEEDED(hr))
+	{
+		DXUT_SetDebugName(pTexture->m_pTexture, szName);
+
+		// The view of the whole array clears every slice at once,the view of a slice draws one cascade.
+		D3D11_DEPTH_STENCIL_VIEW_DESC depthStencilViewDesc;
+		depthStencilViewDesc.Format = DsvFormat;
+		depthStencilViewDesc.Flags = 0;
+		if (bArray)
+		{
+			depthStencilViewDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2DARRAY;
+			depthStencilViewDesc.Texture2DArray.MipSlice = 0;
+			depthStencilViewDesc.Texture2DArray.FirstArraySlice = 0;
+			depthStencilViewDesc.Texture2DArray.ArraySize = classDesc.ArraySize;
+		}
+		else
+		{
+			depthStencilViewDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+			depthStencilViewDesc.Texture2D.MipSlice = 0;
+		}
+		hr = pD3dDevice->CreateDepthStencilView(pTexture->m_pTexture, &depthStencilViewDesc, &pTexture->m_pDSV);
+		if (SUCCEEDED(hr))
+		{
+			DXUT_SetDebugName(pTexture->m_pDSV, szName);
+		}
+
+		D3D11_DEPTH_STENCIL_VIEW_DESC sliceViewDesc = depthStencilViewDesc;
+		sliceViewDesc.Texture2DArray.ArraySize = 1;
+		for (UINT i = 0;SUCCEEDED(hr) && bArray && i < classDesc.ArraySize && i < MAX_CASCADES;++i)
+		{
+			sliceViewDesc.Texture2DArray.FirstArraySlice = i;
+			hr = pD3dDevice->CreateDepthStencilView(pTexture->m_pTexture, &sliceViewDesc, &pTexture->m_pSliceDSVs[i]);
+			if (SUCCEEDED(hr))
+			{
+				DXUT_SetDebugName(pTexture->m_pSliceDSVs[i], szName);
+			}
+		}
+	}
+
+	if (SUCCEEDED(hr) && (classDesc.BindFlags & D3D11_BIND_SHADER_RESOURCE) != 0)
+	{
+		// The scene shader samples a Texture2DArray,the atlas is the single slice of one.
+		D3D11_SHADER_RESOURCE_VIEW_DESC depthStencilSrvDesc;
+		depthStencilSrvDesc.Format = SrvFormat;
+		depthStencilSrvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+		depthStencilSrvDesc.Texture2DArray.MostDetailedMip = 0;
+		depthStencilSrvDesc.Texture2DArray.MipLevels = 1;
+		depthStencilSrvDesc.Texture2DArray.FirstArraySlice = 0;
+		depthStencilSrvDesc.Texture2DArray.ArraySize = classDesc.ArraySize;
+		hr = pD3dDevice->CreateShaderResourceView(pTexture->m_pTexture, &depthStencilSrvDesc, &pTexture->m_pSRV);
+		if (SUCCEEDED(hr))
+		{
+			DXUT_SetDebugName(pTexture->m_pSRV, szName);
+		}
+	}
+
+	if (FAILED(hr))
+	{
+		ReleaseTexture(pTexture);
+		*ppTexture = nullptr;
+		return hr;
+	}
+
+	if (m_pMemoryTracker != nullptr)
+	{
+		m_pMemoryTracker->TrackResource(GPU_MEMORY_SHADOW_MAP, pTexture->m_pTexture, szName);
+	}
+
+	m_Textures.push_back(pTexture);
+	++m_nCreated;
+	*ppTexture = pTexture;
+	return hr;
+}
+
+void ShadowTexturePool::GiveBack(PooledShadowTexture* pTexture)
+{
+	if (pTexture != nullptr)
+	{
+		pTexture->m_bInUse = false;
+		pTexture->m_nIdleFrames = 0;
+	}
+}
+
+void ShadowTexturePool::BeginFrame(UINT nMaxIdleFrames)
+{
+	size_t nKept = 0;
+	for (size_t i = 0;i < m_Textures.size();++i)
+	{
+		PooledShadowTexture* pTexture = m_Textures[i];
+		if (!pTexture->m_bInUse && ++pTexture->m_nIdleFrames > nMaxIdleFrames)
+		{
+			ReleaseTexture(pTexture);
+			continue;
+		}
+		m_Textures[nKept++] = pTexture;
+	}
+	m_Textures.resize(nKept);
+}
+
+void ShadowTexturePool::ReleaseAll()
+{
+	for (size_t i = 0;i < m_Textures.size();++i)
+	{
+		ReleaseTexture(m_Textures[i]);
+	}
+	m_Textures.clear();
+}
+
+UINT64 ShadowTexturePool::GetPooledBytes() const
+{
+	UINT64 uBytes = 0;
+	for (size_t i = 0;i < m_Textures.size();++i)
+	{
+		uBytes += m_Textures[i]->m_uBytes;
+	}
+	return uBytes;
+}
+
+UINT64 ShadowTexturePool::GetIdleBytes() const
+{
+	UINT64 uBytes = 0;
+	for (size_t i = 0;i < m_Textures.size();++i)
+	{
+		uBytes += m_Textures[i]->m_bInUse ? 0 : m_Textures[i]->m_uBytes;
+	}
+	return uBytes;
+}
+
+void ShadowTexturePool::ReleaseTexture(PooledShadowTexture* pTexture)
+{
+	if (m_pMemoryTracker != nullptr)
+	{
+		m_pMemoryTracker->Untrack(pTexture->m_pTexture);
+	}
+	SAFE_RELEASE(pTexture->m_pSRV);
+	SAFE_RELEASE(pTexture->m_pDSV);
+	for (INT i = 0;i < MAX_CASCADES;++i)
+	{
+		SAFE_RELEASE(pTexture->m_pSliceDSVs[i]);
+	}
+	SAFE_RELEASE(pTexture->m_pTexture);
+	delete pTexture;
+}
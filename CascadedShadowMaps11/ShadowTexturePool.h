@@ -0,0 +1,85 @@
+//--------------------------------------------------------------------------------------
+// File: ShadowTexturePool.h
+//
+// Depth textures a shadow map is stored in,kept with their views after the shadow map
+// that used them is reconfigured. A texture of the same size class,format,array size and
+// bind flags is handed out again instead of being created,and a texture nobody took for a
+// while is released. Textures given back stay alive for at least a frame,so the frames
+// still reading the old shadow map never wait on its release.
+//--------------------------------------------------------------------------------------
+#pragma once
+
+#include "CascadeFitting.h"
+#include <d3d11.h>
+#include <vector>
+
+// The sides of a pooled texture are rounded up to a multiple of this,so that close sizes share a texture.
+#define SHADOW_TEXTURE_SIZE_CLASS 128
+
+class GpuMemoryTracker;
+
+struct PooledShadowTexture
+{
+	D3D11_TEXTURE2D_DESC m_Desc; // With the sides of its size class
+	ID3D11Texture2D* m_pTexture;
+	ID3D11DepthStencilView* m_pDSV; // Every slice of an array
+	ID3D11DepthStencilView* m_pSliceDSVs[MAX_CASCADES]; // One per slice of an array
+	ID3D11ShaderResourceView* m_pSRV; // Only with D3D11_BIND_SHADER_RESOURCE,always a texture array view
+	DXGI_FORMAT m_DsvFormat;
+	DXGI_FORMAT m_SrvFormat;
+	bool m_bArray; // Drawn into as a texture array,even with a single slice
+	UINT64 m_uBytes;
+	UINT m_nIdleFrames; // Frames since it was given back
+	bool m_bInUse;
+};
+
+class ShadowTexturePool
+{
+public:
+	ShadowTexturePool();
+	~ShadowTexturePool();
+
+	static UINT GetSizeClassLength(UINT uLength);
+
+	// Textures created from now on are recorded as GPU_MEMORY_SHADOW_MAP until they are released.
+	void SetMemoryTracker(GpuMemoryTracker* pMemoryTracker)
+	{
+		m_pMemoryTracker = pMemoryTracker;
+	}
+
+	// Hands out an unused texture that matches desc once its sides are rounded to their size class,
+	// or creates one with views of DsvFormat and SrvFormat.
+	HRESULT Acquire(ID3D11Device* pD3dDevice, const D3D11_TEXTURE2D_DESC& desc, bool bArray, DXGI_FORMAT DsvFormat, DXGI_FORMAT SrvFormat,
+		UINT uBytesPerTexel, const char* szName, PooledShadowTexture** ppTexture);
+
+	// The texture can be handed out again right away,it is only released after it was idle for a while.
+	void GiveBack(PooledShadowTexture* pTexture);
+
+	// Called once a frame before the shadow is rendered,releases what was idle for more than nMaxIdleFrames.
+	void BeginFrame(UINT nMaxIdleFrames);
+
+	void ReleaseAll();
+
+	// Bytes of every texture alive,in use or not.
+	UINT64 GetPooledBytes() const;
+	UINT64 GetIdleBytes() const;
+
+	// Textures created and handed out again since the pool was made.
+	UINT GetCreatedCount() const
+	{
+		return m_nCreated;
+	}
+
+	UINT GetReusedCount() const
+	{
+		return m_nReused;
+	}
+
+private:
+	void ReleaseTexture(PooledShadowTexture* pTexture);
+
+	std::vector<PooledShadowTexture*> m_Textures;
+	GpuMemoryTracker* m_pMemoryTracker;
+	UINT m_nCreated;
+	UINT m_nReused;
+};
@@ -202,6 +202,42 @@ inline int RectHeight( RECT& rc )
 }
 
 
+//======================================================================================
+// GUI resource callback
+//======================================================================================
+
+LPDXUTCALLBACKGUIRESOURCE g_pGUIResourceCallback = nullptr;
+void* g_pGUIResourceUserContext = nullptr;
+
+//--------------------------------------------------------------------------------------
+void DXUTSetCallbackGUIResource( LPDXUTCALLBACKGUIRESOURCE pCallback, void* pUserContext )
+{
+    g_pGUIResourceCallback = pCallback;
+    g_pGUIResourceUserContext = pUserContext;
+}
+
+
+//--------------------------------------------------------------------------------------
+static void NotifyGUIResource( _In_opt_ ID3D11Resource* pResource, _In_ bool bCreated, _In_z_ const char* szName )
+{
+    if( pResource && g_pGUIResourceCallback )
+        g_pGUIResourceCallback( pResource, bCreated, szName, g_pGUIResourceUserContext );
+}
+
+
+//--------------------------------------------------------------------------------------
+static void NotifyGUIResource( _In_opt_ ID3D11ShaderResourceView* pSRV, _In_ bool bCreated, _In_z_ const char* szName )
+{
+    if( !pSRV || !g_pGUIResourceCallback )
+        return;
+
+    ID3D11Resource* pResource = nullptr;
+    pSRV->GetResource( &pResource );
+    NotifyGUIResource( pResource, bCreated, szName );
+    SAFE_RELEASE( pResource );
+}
+
+
 //======================================================================================
 // Font11
 //======================================================================================
@@ -220,6 +256,7 @@ HRESULT InitFont11( _In_ ID3D11Device* pd3d11Device, _In_ ID3D11InputLayout* pIn
     V_RETURN( DXUTFindDXSDKMediaFileCch( str, MAX_PATH, L"UI\\Font.dds" ) );
     
     V_RETURN( CreateDDSTextureFromFile( pd3d11Device, str, nullptr, &g_pFont11 ) );
+    NotifyGUIResource( g_pFont11, true, "DXUT Font" );
 
     g_pInputLayout11 = pInputLayout;
     return hr;
@@ -229,8 +266,10 @@ HRESULT InitFont11( _In_ ID3D11Device* pd3d11Device, _In_ ID3D11InputLayout* pIn
 //--------------------------------------------------------------------------------------
 void EndFont11()
 {
+    NotifyGUIResource( g_pFontBuffer11, false, "DXUT Font Buffer" );
     SAFE_RELEASE( g_pFontBuffer11 );
     g_FontBufferBytes11 = 0;
+    NotifyGUIResource( g_pFont11, false, "DXUT Font" );
     SAFE_RELEASE( g_pFont11 );
 }
 
@@ -348,6 +387,7 @@ void EndText11( ID3D11Device* pd3dDevice, ID3D11DeviceContext* pd3d11DeviceConte
     UINT FontDataBytes = static_cast<UINT>( g_FontVertices.size() * sizeof( DXUTSpriteVertex ) );
     if( g_FontBufferBytes11 < FontDataBytes )
     {
+        NotifyGUIResource( g_pFontBuffer11, false, "DXUT Font Buffer" );
         SAFE_RELEASE( g_pFontBuffer11 );
         g_FontBufferBytes11 = FontDataBytes;
 
@@ -365,6 +405,7 @@ void EndText11( ID3D11Device* pd3dDevice, ID3D11DeviceContext* pd3d11DeviceConte
             return;
         }
         DXUT_SetDebugName( g_pFontBuffer11, "DXUT Text11" );
+        NotifyGUIResource( g_pFontBuffer11, true, "DXUT Font Buffer" );
     }
 
     // Copy the sprites over
@@ -2410,6 +2451,7 @@ HRESULT CDXUTDialogResourceManager::OnD3D11CreateDevice( ID3D11Device* pd3dDevic
     BufDesc.MiscFlags = 0;
     V_RETURN( pd3dDevice->CreateBuffer( &BufDesc, nullptr, &m_pVBScreenQuad11 ) );
     DXUT_SetDebugName( m_pVBScreenQuad11, "CDXUTDialogResourceManager" );
+    NotifyGUIResource( m_pVBScreenQuad11, true, "DXUT Screen Quad" );
 
     // Init the D3D11 font
     InitFont11( pd3dDevice, m_pInputLayout11 );
@@ -2449,11 +2491,14 @@ void CDXUTDialogResourceManager::OnD3D11DestroyDevice()
     for( auto it = m_TextureCache.begin(); it != m_TextureCache.end(); ++it )
     {
         SAFE_RELEASE( (*it)->pTexResView11 );
+        NotifyGUIResource( (*it)->pTexture11, false, "DXUT GUI Texture" );
         SAFE_RELEASE( (*it)->pTexture11 );
     }
 
     // D3D11
+    NotifyGUIResource( m_pVBScreenQuad11, false, "DXUT Screen Quad" );
     SAFE_RELEASE( m_pVBScreenQuad11 );
+    NotifyGUIResource( m_pSpriteBuffer11, false, "DXUT Sprite Buffer" );
     SAFE_RELEASE( m_pSpriteBuffer11 );
     m_SpriteBufferBytes11 = 0;
     SAFE_RELEASE( m_pInputLayout11 );
@@ -2559,6 +2604,7 @@ void CDXUTDialogResourceManager::EndSprites11( ID3D11Device* pd3dDevice, ID3D11D
     {
         if( m_SpriteBufferBytes11 < SpriteDataBytes )
         {
+            NotifyGUIResource( m_pSpriteBuffer11, false, "DXUT Sprite Buffer" );
             SAFE_RELEASE( m_pSpriteBuffer11 );
             m_SpriteBufferBytes11 = SpriteDataBytes;
 
@@ -2576,6 +2622,7 @@ void CDXUTDialogResourceManager::EndSprites11( ID3D11Device* pd3dDevice, ID3D11D
                 return;
             }
             DXUT_SetDebugName( m_pSpriteBuffer11, "CDXUTDialogResourceManager" );
+            NotifyGUIResource( m_pSpriteBuffer11, true, "DXUT Sprite Buffer" );
         }
 
         // Copy the sprites over
@@ -2809,6 +2856,7 @@ HRESULT CDXUTDialogResourceManager::CreateTexture11( _In_ UINT iTexture )
             if( FAILED( hr ) )
                 return DXTRACE_ERR( L"DXUTCreateGUITextureFromInternalArray", hr );
             DXUT_SetDebugName( pTextureNode->pTexture11, "DXUT GUI Texture" );
+            NotifyGUIResource( pTextureNode->pTexture11, true, "DXUT GUI Texture" );
         }
     }
 
@@ -1126,3 +1126,9 @@ void DrawText11DXUT( _In_ ID3D11Device* pd3dDevice, _In_ ID3D11DeviceContext* pd
                      _In_z_ LPCWSTR strText, _In_ const RECT& rcScreen, _In_ DirectX::XMFLOAT4 vFontColor,
                      _In_ float fBBWidth, _In_ float fBBHeight, _In_ bool bCenter );
 void EndText11( _In_ ID3D11Device* pd3dDevice, _In_ ID3D11DeviceContext* pd3d11DeviceContext );
+
+// Called right after the GUI creates one of its buffers or textures and right before it releases one,
+// including when a sprite or font buffer is grown, so the application can account the GUI's device memory
+typedef void ( CALLBACK*LPDXUTCALLBACKGUIRESOURCE )( _In_ ID3D11Resource* pResource, _In_ bool bCreated, _In_z_ const char* szName,
+                                                    _In_opt_ void* pUserContext );
+void DXUTSetCallbackGUIResource( _In_opt_ LPDXUTCALLBACKGUIRESOURCE pCallback, _In_opt_ void* pUserContext = nullptr );
@@ -136,6 +136,75 @@ HRESULT CDXUTSDKMesh::CreateVertexBuffer( ID3D11Device* pd3dDevice, SDKMESH_VERT
 }
 
 
+//--------------------------------------------------------------------------------------
+// Depth only passes read nothing but the position, from an interleaved buffer they would still fetch
+// the whole vertex. The position is copied out into a buffer of its own.
+//--------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT CDXUTSDKMesh::CreatePositionStream( ID3D11Device* pd3dDevice, UINT iVB, SDKMESH_VERTEX_BUFFER_HEADER* pHeader,
+                                            const BYTE* pVertices, SDKMESH_CALLBACKS11* pLoaderCallbacks )
+{
+    m_PositionVBs[iVB] = nullptr;
+
+    const D3DVERTEXELEMENT9* pPosition = nullptr;
+    for( UINT i = 0; i < MAX_VERTEX_ELEMENTS && pHeader->Decl[i].Stream != 0xFF; i++ )
+    {
+        if( pHeader->Decl[i].Usage == D3DDECLUSAGE_POSITION && pHeader->Decl[i].UsageIndex == 0 )
+        {
+            pPosition = &pHeader->Decl[i];
+            break;
+        }
+    }
+    if( !pPosition || pPosition->Type != D3DDECLTYPE_FLOAT3 || !pHeader->pVB11 )
+        return S_OK;
+
+    UINT Stride = GetPositionStride();
+    if( pHeader->StrideBytes == Stride )
+    {
+        // Nothing to strip
+        m_PositionVBs[iVB] = pHeader->pVB11;
+        m_PositionVBs[iVB]->AddRef();
+        return S_OK;
+    }
+
+    std::vector<XMFLOAT3> Positions( ( size_t )pHeader->NumVertices );
+    for( UINT64 v = 0; v < pHeader->NumVertices; v++ )
+    {
+        memcpy( &Positions[( size_t )v], pVertices + v * pHeader->StrideBytes + pPosition->Offset, Stride );
+    }
+
+    D3D11_BUFFER_DESC bufferDesc;
+    bufferDesc.ByteWidth = ( UINT )( pHeader->NumVertices * Stride );
+    bufferDesc.Usage = D3D11_USAGE_DEFAULT;
+    bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    bufferDesc.CPUAccessFlags = 0;
+    bufferDesc.MiscFlags = 0;
+
+    HRESULT hr = S_OK;
+    if( pLoaderCallbacks && pLoaderCallbacks->pCreateVertexBuffer )
+    {
+        pLoaderCallbacks->pCreateVertexBuffer( pd3dDevice, &m_PositionVBs[iVB], bufferDesc, Positions.data(),
+                                               pLoaderCallbacks->pContext );
+    }
+    else
+    {
+        D3D11_SUBRESOURCE_DATA InitData;
+        InitData.pSysMem = Positions.data();
+        InitData.SysMemPitch = 0;
+        InitData.SysMemSlicePitch = 0;
+        hr = pd3dDevice->CreateBuffer( &bufferDesc, &InitData, &m_PositionVBs[iVB] );
+        if (SUCCEEDED(hr))
+        {
+            DXUT_SetDebugName(m_PositionVBs[iVB], "CDXUTSDKMesh Positions");
+        }
+    }
+
+    if( m_PositionVBs[iVB] )
+        m_PositionStreamBytes += bufferDesc.ByteWidth;
+
+    return hr;
+}
+
 //--------------------------------------------------------------------------------------
 _Use_decl_annotations_
 HRESULT CDXUTSDKMesh::CreateIndexBuffer( ID3D11Device* pd3dDevice, SDKMESH_INDEX_BUFFER_HEADER* pHeader,
@@ -322,6 +391,18 @@ HRESULT CDXUTSDKMesh::CreateFromMemory( ID3D11Device* pDev11,
         m_ppVertices[i] = pVertices;
     }
 
+    // Create position streams
+    m_PositionStreamBytes = 0;
+    if( pDev11 && m_bCreatePositionStreams )
+    {
+        m_PositionVBs.resize( m_pMeshHeader->NumVertexBuffers );
+        for( UINT i = 0; i < m_pMeshHeader->NumVertexBuffers; i++ )
+        {
+            if( FAILED( hr = CreatePositionStream( pDev11, i, &m_pVertexBufferArray[i], m_ppVertices[i], pLoaderCallbacks11 ) ) )
+                goto Error;
+        }
+    }
+
     // Create IBs
     m_ppIndices = new (std::nothrow) BYTE*[m_pMeshHeader->NumIndexBuffers];
     if ( !m_ppIndices )
@@ -723,6 +804,8 @@ CDXUTSDKMesh::CDXUTSDKMesh() : m_NumOutstandingResources( 0 ),
                                m_pStaticMeshData( nullptr ),
                                m_pHeapData( nullptr ),
                                m_pAdjacencyIndexBufferArray( nullptr ),
+                               m_bCreatePositionStreams( false ),
+                               m_PositionStreamBytes( 0 ),
                                m_pAnimationData( nullptr ),
                                m_pAnimationHeader( nullptr ),
                                m_ppVertices( nullptr ),
@@ -867,6 +950,13 @@ void CDXUTSDKMesh::Destroy()
         }
     }
 
+    for( size_t i = 0; i < m_PositionVBs.size(); i++ )
+    {
+        SAFE_RELEASE( m_PositionVBs[i] );
+    }
+    m_PositionVBs.clear();
+    m_PositionStreamBytes = 0;
+
     if( m_pAdjacencyIndexBufferArray )
     {
         for( UINT64 i = 0; i < m_pMeshHeader->NumIndexBuffers; i++ )
@@ -1008,6 +1098,32 @@ ID3D11Buffer* CDXUTSDKMesh::GetVB11( _In_ UINT iMesh, _In_ UINT iVB ) const
     return m_pVertexBufferArray[ m_pMeshArray[ iMesh ].VertexBuffers[iVB] ].pVB11;
 }
 
+//--------------------------------------------------------------------------------------
+ID3D11Buffer* CDXUTSDKMesh::GetPositionVB11( _In_ UINT iMesh ) const
+{
+    UINT iVB = m_pMeshArray[ iMesh ].VertexBuffers[0];
+    if( iVB >= m_PositionVBs.size() )
+        return nullptr;
+    return m_PositionVBs[ iVB ];
+}
+
+//--------------------------------------------------------------------------------------
+ID3D11Buffer* CDXUTSDKMesh::GetPositionVB11At( _In_ UINT iVB ) const
+{
+    return iVB < m_PositionVBs.size() ? m_PositionVBs[ iVB ] : nullptr;
+}
+
+//--------------------------------------------------------------------------------------
+UINT64 CDXUTSDKMesh::GetVertexBufferBytes() const
+{
+    UINT64 Bytes = 0;
+    for( UINT i = 0; i < GetNumVBs(); i++ )
+    {
+        Bytes += m_pVertexBufferArray[i].SizeBytes;
+    }
+    return Bytes;
+}
+
 //--------------------------------------------------------------------------------------
 ID3D11Buffer* CDXUTSDKMesh::GetIB11( _In_ UINT iMesh ) const
 {
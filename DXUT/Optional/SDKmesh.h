@@ -332,6 +332,12 @@ protected:
     // Adjacency information (not part of the m_pStaticMeshData, so it must be created and destroyed separately )
     SDKMESH_INDEX_BUFFER_HEADER* m_pAdjacencyIndexBufferArray;
 
+    // Position only copies of the vertex buffers for depth only passes, one per vertex buffer.
+    // A buffer without a float3 position has none, a buffer that only holds the position is shared.
+    bool m_bCreatePositionStreams;
+    std::vector<ID3D11Buffer*> m_PositionVBs;
+    UINT64 m_PositionStreamBytes;
+
     //Animation
     SDKANIMATION_FILE_HEADER* m_pAnimationHeader;
     SDKANIMATION_FRAME_DATA* m_pAnimationFrameData;
@@ -351,6 +357,10 @@ protected:
                                _In_ SDKMESH_INDEX_BUFFER_HEADER* pHeader, _In_reads_(pHeader->SizeBytes) void* pIndices,
                                _In_opt_ SDKMESH_CALLBACKS11* pLoaderCallbacks = nullptr );
 
+    HRESULT CreatePositionStream( _In_ ID3D11Device* pd3dDevice, _In_ UINT iVB,
+                                  _In_ SDKMESH_VERTEX_BUFFER_HEADER* pHeader, _In_reads_(pHeader->SizeBytes) const BYTE* pVertices,
+                                  _In_opt_ SDKMESH_CALLBACKS11* pLoaderCallbacks = nullptr );
+
     virtual HRESULT CreateFromFile( _In_opt_ ID3D11Device* pDev11,
                                     _In_z_ LPCWSTR szFileName,
                                     _In_opt_ SDKMESH_CALLBACKS11* pLoaderCallbacks11 = nullptr );
@@ -388,6 +398,9 @@ public:
     virtual HRESULT Create( _In_ ID3D11Device* pDev11, BYTE* pData, size_t DataBytes, _In_ bool bCopyStatic=false,
                             _In_opt_ SDKMESH_CALLBACKS11* pLoaderCallbacks = nullptr );
     virtual HRESULT LoadAnimation( _In_z_ const WCHAR* szFileName );
+
+    // Set before Create to also build a position only vertex stream for depth only passes.
+    void SetCreatePositionStreams( _In_ bool bCreate ) { m_bCreatePositionStreams = bCreate; }
     virtual void Destroy();
 
     //Frame manipulation
@@ -413,6 +426,13 @@ public:
 
     ID3D11Buffer* GetAdjIB11( _In_ UINT iMesh ) const;
 
+    // Float3 positions with GetPositionStride, nullptr when the mesh has no position stream.
+    ID3D11Buffer* GetPositionVB11( _In_ UINT iMesh ) const;
+    ID3D11Buffer* GetPositionVB11At( _In_ UINT iVB ) const;
+    static UINT GetPositionStride() { return 3 * sizeof( float ); }
+    UINT64 GetPositionStreamBytes() const { return m_PositionStreamBytes; }
+    UINT64 GetVertexBufferBytes() const;
+
     //Helpers (general)
     const char* GetMeshPathA() const;
     const WCHAR* GetMeshPathW() const;
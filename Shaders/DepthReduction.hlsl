@@ -0,0 +1,66 @@
+//-----------------------------------
+// File: DepthReduction.hlsl
+//
+// Reduces the scene depth buffer to the smallest and largest depth of the pixels that were written.
+// The cascades of the next frames are fitted to that range instead of the whole camera range.
+//--------------------------------------
+
+//--------------
+// Globals
+//-------------
+Texture2D<float> g_txSceneDepth:register(t0);
+
+// [0] holds the smallest depth and [1] the inverted bits of the largest one,so both are reduced with
+// InterlockedMin and one clear to 0xffffffff resets them.Positive floats are ordered like their bits.
+RWByteAddressBuffer g_rwDepthBounds:register(u0);
+
+#define REDUCTION_GROUP_SIZE 16
+#define REDUCTION_GROUP_THREADS (REDUCTION_GROUP_SIZE * REDUCTION_GROUP_SIZE)
+
+groupshared float2 g_vGroupBounds[REDUCTION_GROUP_THREADS];
+
+//--------------------------------
+// Compute Shader
+//----------------------------
+// One thread per pixel,the group reduces its tile in shared memory and only its first thread touches the buffer.
+[numthreads(REDUCTION_GROUP_SIZE, REDUCTION_GROUP_SIZE, 1)]
+void CSReduceDepthBounds(uint3 vDispatchThreadID:SV_DispatchThreadID, uint iGroupIndex:SV_GroupIndex)
+{
+	uint2 vDepthSize;
+	g_txSceneDepth.GetDimensions(vDepthSize.x, vDepthSize.y);
+
+	// Cleared pixels and threads outside of the texture leave an empty range.
+	float2 vBounds = float2(1.0f, 0.0f);
+	if (all(vDispatchThreadID.xy < vDepthSize))
+	{
+		float fDepth = g_txSceneDepth[vDispatchThreadID.xy];
+		if (fDepth < 1.0f)
+		{
+			vBounds = float2(fDepth, fDepth);
+		}
+	}
+	g_vGroupBounds[iGroupIndex] = vBounds;
+	GroupMemoryBarrierWithGroupSync();
+
+	[unroll]
+	for (uint iStride = REDUCTION_GROUP_THREADS / 2; iStride > 0; iStride >>= 1)
+	{
+		if (iGroupIndex < iStride)
+		{
+			float2 vOther = g_vGroupBounds[iGroupIndex + iStride];
+			g_vGroupBounds[iGroupIndex] = float2(min(g_vGroupBounds[iGroupIndex].x, vOther.x), max(g_vGroupBounds[iGroupIndex].y, vOther.y));
+		}
+		GroupMemoryBarrierWithGroupSync();
+	}
+
+	if (iGroupIndex == 0)
+	{
+		vBounds = g_vGroupBounds[0];
+		if (vBounds.x <= vBounds.y)
+		{
+			uint uOriginal;
+			g_rwDepthBounds.InterlockedMin(0, asuint(vBounds.x), uOriginal);
+			g_rwDepthBounds.InterlockedMin(4, ~asuint(vBounds.y), uOriginal);
+		}
+	}
+}
@@ -55,36 +55,45 @@
 // In some cases such as when large PCF kernels are used,derivate based depth offsets could be used
 // with larger PCF blur kernels on high end PCs for the ground plane.
 
-cbuffer cbAllShadowData:register(b0)
+// See CB_PER_OBJECT
+cbuffer cbPerObject:register(b0)
 {
 	matrix m_mWorldViewProjection:packoffset(c0);
 	matrix m_mWorld:packoffset(c4);
 	matrix m_mWorldView:packoffset(c8);
-	matrix m_mShadowView:packoffset(c12);
-	float4 m_vOffsetFactorFromShadowViewToTexure[CASCADE_COUNT_FLAG]:packoffset(c16);
-	float4 m_vScaleFactorFromOrthoProjToTexureCoord[CASCADE_COUNT_FLAG]:packoffset(c24);
-	int m_nCascadeLevels_Unused : packoffset(c32.x);//Number of Cascades
-	int m_iIsVisualizeCascades : packoffset(c32.y);//1 is to visualize the cascades in different colors. 0 is to just draw the scene
-	int m_iPCFBlurForLoopStart : packoffset(c32.z);// For loop begin value.For a 5x5 kernel this would be -2.
-	int m_iPCFBlurForLoopEnd : packoffset(c32.w);// For loop end value.For a 5x5 kernel this would be 3
+};
+
+// See CB_SHADOW_FRAME
+cbuffer cbShadowFrame:register(b1)
+{
+	matrix m_mShadowView:packoffset(c0);
+	float4 m_vOffsetFactorFromShadowViewToTexure[CASCADE_COUNT_FLAG]:packoffset(c4);
+	float4 m_vScaleFactorFromOrthoProjToTexureCoord[CASCADE_COUNT_FLAG]:packoffset(c12);
+	int m_nCascadeLevels_Unused : packoffset(c20.x);//Number of Cascades
+	int m_iIsVisualizeCascades : packoffset(c20.y);//1 is to visualize the cascades in different colors. 0 is to just draw the scene
+	int m_iPCFBlurForLoopStart : packoffset(c20.z);// For loop begin value.For a 5x5 kernel this would be -2.
+	int m_iPCFBlurForLoopEnd : packoffset(c20.w);// For loop end value.For a 5x5 kernel this would be 3
 	
-	//For Map based selection scheme,this keeps the pixels inside of the valid range.
-	// When there is no boarder,these values are 0 and 1 respectively.
-	float m_fMinBorderPaddingInShadowUV : packoffset(c33.x);
-	float m_fMaxBorderPaddingInShadowUV : packoffset(c33.y);
-	float m_fPCFShadowDepthBiaFromGUI : packoffset(c33.z); // A shadow map offset to deal with self shadow artifacts.// These artifacts are aggravated by PCF.
-	float m_fWidthPerShadowTextureLevel_InU : packoffset(c33.w);
-
-	float m_fMaxBlendRatioBetweenCascadeLevel : packoffset(c34.x);// Amount to overlap when blending between cascades.
-	float m_fLogicTexelSizeInX : packoffset(c34.y);
-	float m_fCascadedShadowMapTexelSizeInX : packoffset(c34.z);
-//	float m_fPaddingForCB3 : packoffset(c34.w);//Padding variables exist because ConstBuffers must be a multiple of 16 bytes.
+	// The border padding and texel sizes are per tile since the tiles have their own sizes,see m_vTileTexelSizeInUV.
+	float m_fMinBorderPaddingInShadowUV_Unused : packoffset(c21.x);
+	float m_fMaxBorderPaddingInShadowUV_Unused : packoffset(c21.y);
+	float m_fPCFShadowDepthBiaFromGUI : packoffset(c21.z); // A shadow map offset to deal with self shadow artifacts.// These artifacts are aggravated by PCF.
+	int m_iIsCascadeTextureArray : packoffset(c21.w);// 1 when the cascades are stored in the slices of a texture array,0 for the atlas
+
+	float m_fMaxBlendRatioBetweenCascadeLevel : packoffset(c22.x);// Amount to overlap when blending between cascades.
+	float m_fLogicTexelSizeInX_Unused : packoffset(c22.y);
+	float m_fCascadedShadowMapTexelSizeInX_Unused : packoffset(c22.z);
+	int m_iIsToroidalTiles : packoffset(c22.w);// 1 while a cascade tile is scrolled
 	
-	float3 m_vLightDir : packoffset(c35);
+	float3 m_vLightDir : packoffset(c23);
+
+	float4 m_fCascadePartitionDepthsInView_InFloat4[MAX_CASCADE_COUNT_IN_4]: packoffset(c24);//The values along Z that separate the cascades.
 
-	float4 m_fCascadePartitionDepthsInView_InFloat4[MAX_CASCADE_COUNT_IN_4]: packoffset(c36);//The values along Z that separate the cascades.
+	float4 m_fCascadePartitionDepthsInView_OnlyX[MAX_CASCADE_COUNT_MORE]: packoffset(c26);//The values along Z that separate the cascades.//init from pixel shader
 
-	float4 m_fCascadePartitionDepthsInView_OnlyX[MAX_CASCADE_COUNT_MORE]: packoffset(c38);//The values along Z that separate the cascades.//init from pixel shader
+	float4 m_vTileOriginInUV[CASCADE_COUNT_FLAG] : packoffset(c38);// Where uv (0,0) of each cascade is stored in its tile
+	float4 m_vTileRectInUV[CASCADE_COUNT_FLAG] : packoffset(c46);// Where the tile of each cascade was packed,xy the top left and zw the size
+	float4 m_vTileTexelSizeInUV[CASCADE_COUNT_FLAG] : packoffset(c54);// A texel of each cascade,xy in the uv of its tile and zw in the uv of the texture
 };
 
 
@@ -93,7 +102,9 @@ cbuffer cbAllShadowData:register(b0)
 // Textures and Samplers
 //--------------------------------------------------------------------------------------
 Texture2D g_txDiffuse:register(t0);
-Texture2D<float> g_txShadow:register(t5);
+// The atlas is bound through a texture array view of its single slice,so one shader samples either storage.
+// A texture is at most 16384 texels wide,an array has room for 8 cascades of any size.
+Texture2DArray<float> g_txShadow:register(t5);
 
 SamplerState g_SamLinear:register(s0);
 SamplerComparisonState g_SamplerComparisonState:register(s5);
@@ -161,22 +172,49 @@ void TranformShadowToTexture3D(in float4 vPosInShadowView, in int iCascadeIndex,
 Ҳ˵ShadowMapķֱ1024X1024xΪƽ̷ϳShadowMapֱΪ(N*1024)X1024
 ˿ԿShadowMapĴ
 */
-void TransformLogicU_ToNativeU(in int iCascadeIndex, in out float4 vShadowTexCoord)
+// Moves a uv of a cascade's tile to where the tile was packed.The tiles can have different sizes,a tile of a
+// texture array starts at the top left of its slice.
+void TransformLogicUV_ToNativeUV(in int iCascadeIndex, in out float4 vShadowTexCoord)
+{
+	//ǰCascadeӦʵShadowTexure UV
+	vShadowTexCoord.xy = vShadowTexCoord.xy*m_vTileRectInUV[iCascadeIndex].zw + m_vTileRectInUV[iCascadeIndex].xy;
+}
+
+// Compares against the cascade's tile,or its slice when the cascades are stored in a texture array.
+float SampleCascadeShadow(in int iCascadeIndex, in float2 uv, in float fDepthCompare)
 {
-	//ǰCascadeӦʵShadowTexure X
-	// x*i+x/length
-	//Ϊܰѹʽд
+	float fSlice = m_iIsCascadeTextureArray ? (float)iCascadeIndex : 0.0f;
+	return g_txShadow.SampleCmpLevelZero(g_SamplerComparisonState, float3(uv, fSlice), fDepthCompare);
+}
 
-	vShadowTexCoord.x *= m_fWidthPerShadowTextureLevel_InU;// precomputed (float) iCascadeIndex/(float)CASCADE_COUNT_FLAG
-													   //ۼiCascadeIndex ڵƫƻַm_fWidthPerShadowTextureLevel_InU*(float)iCascadeIndex
-	vShadowTexCoord.x += (m_fWidthPerShadowTextureLevel_InU*(float)iCascadeIndex);
+// Compares a uv of a scrolled tile,which wraps around its origin.The four texels around the tap are wrapped one
+// by one and blended as the comparison sampler blends them,so the filter crosses the seam into the texels of
+// the other edge instead of blending the seam's neighbours or reaching into the next tile.
+float SampleToroidalCascadeShadow(in int iCascadeIndex, in float2 vTileUV, in float fDepthCompare)
+{
+	int2 iTileSize = (int2)round(1.0f / m_vTileTexelSizeInUV[iCascadeIndex].xy);
+	int2 iTileCorner = (int2)round(m_vTileRectInUV[iCascadeIndex].xy / m_vTileTexelSizeInUV[iCascadeIndex].zw);
+	int iSlice = m_iIsCascadeTextureArray ? iCascadeIndex : 0;
+
+	float2 vTexel = frac(vTileUV + m_vTileOriginInUV[iCascadeIndex].xy)*(float2)iTileSize - 0.5f;
+	float2 vWeight = frac(vTexel);
+	int2 iTexel0 = ((int2)floor(vTexel) + iTileSize) % iTileSize;
+	int2 iTexel1 = (iTexel0 + 1) % iTileSize;
+
+	// A texel is lit as g_SamplerComparisonState compares it,with LESS.
+	float4 vLit;
+	vLit.x = fDepthCompare < g_txShadow.Load(int4(iTileCorner + int2(iTexel0.x, iTexel0.y), iSlice, 0)) ? 1.0f : 0.0f;
+	vLit.y = fDepthCompare < g_txShadow.Load(int4(iTileCorner + int2(iTexel1.x, iTexel0.y), iSlice, 0)) ? 1.0f : 0.0f;
+	vLit.z = fDepthCompare < g_txShadow.Load(int4(iTileCorner + int2(iTexel0.x, iTexel1.y), iSlice, 0)) ? 1.0f : 0.0f;
+	vLit.w = fDepthCompare < g_txShadow.Load(int4(iTileCorner + int2(iTexel1.x, iTexel1.y), iSlice, 0)) ? 1.0f : 0.0f;
+	return lerp(lerp(vLit.x, vLit.y, vWeight.x), lerp(vLit.z, vLit.w, vWeight.x), vWeight.y);
 }
 
 
 //--------------------------------------------------------------------------------------
 // This function calculates the screen space depth for shadow space texels
 //--------------------------------------------------------------------------------------
-void CalculateRightAndUpTexelDepthDeltas(in float3 vOrthoTexDDX, in float3 vOrthoTexDDY,
+void CalculateRightAndUpTexelDepthDeltas(in int iCascadeIndex, in float3 vOrthoTexDDX, in float3 vOrthoTexDDY,
 										out float fUpTexDepthWeight,out float fRightTexDepthWeight)
 {
 	//vOrthoTexDDX ƫǻPos3InShadowViewı仯ʣShadowView꾭m_vScaleFactorFromOrthoProjToTexureCoord仯proj͵Textureռı仯ͶӰı仯
@@ -199,8 +237,8 @@ void CalculateRightAndUpTexelDepthDeltas(in float3 vOrthoTexDDX, in float3 vOrth
 		matScreenToShadowOrtho._22 * fInvDeterminant,matScreenToShadowOrtho._12*-fInvDeterminant,
 		matScreenToShadowOrtho._21 * -fInvDeterminant,matScreenToShadowOrtho._11*fInvDeterminant); 
 	
-	float2 vRightShadowTexelLocation = float2(m_fLogicTexelSizeInX,0.0f);
-	float2 vUpShadowTexelLocation = float2(0.0f,m_fLogicTexelSizeInX);
+	float2 vRightShadowTexelLocation = float2(m_vTileTexelSizeInUV[iCascadeIndex].x,0.0f);
+	float2 vUpShadowTexelLocation = float2(0.0f,m_vTileTexelSizeInUV[iCascadeIndex].y);
 	
 	//Transform the right pixel by the shadow space to screen matrix
 	float2 vRightTexelDepthRatio = mul(vRightShadowTexelLocation,matShadowOrthoToScreen);
@@ -219,7 +257,7 @@ void CalculateRightAndUpTexelDepthDeltas(in float3 vOrthoTexDDX, in float3 vOrth
 //--------------------------------------------------------------------------------------
 // Use PCF to sample the depth map and return a percent lit value.
 //--------------------------------------------------------------------------------------
-void CalculatePCFPercentLit(in float4 vShadowTexCoord,
+void CalculatePCFPercentLit(in int iCascadeIndex,in float4 vShadowTexCoord,
 in float fRightTexelDepthDelta,
 in float fUpTexelDepthDelta,
 						in float fBlurRowSize,out float fPercentLit)
@@ -245,9 +283,17 @@ in float fUpTexelDepthDelta,
             }
 
             // Compare the transformed pixel depth to the depth read from the map.
-            float2 uv = float2(vShadowTexCoord.x + ((float)x)*m_fCascadedShadowMapTexelSizeInX,vShadowTexCoord.y + ((float)y)*m_fLogicTexelSizeInX);
-            
-            fPercentLit += g_txShadow.SampleCmpLevelZero( g_SamplerComparisonState, uv, depthCompare );
+            float2 uv = vShadowTexCoord.xy + float2((float)x,(float)y)*m_vTileTexelSizeInUV[iCascadeIndex].zw;
+
+            if (m_iIsToroidalTiles != 0)
+            {
+                float2 vTileUV = (uv - m_vTileRectInUV[iCascadeIndex].xy) / m_vTileRectInUV[iCascadeIndex].zw;
+                fPercentLit += SampleToroidalCascadeShadow( iCascadeIndex, vTileUV, depthCompare );
+            }
+            else
+            {
+                fPercentLit += SampleCascadeShadow( iCascadeIndex, uv, depthCompare );
+            }
         }
     }
     fPercentLit /= (float)fBlurRowSize;
@@ -369,8 +415,10 @@ float4 PSMain( VS_OUTPUT Input ) : SV_TARGET
 		{
 			TranformShadowToTexture3D(Input.vPosInShadowView, iCascadeIndex, vShadowMap_InTargetTextureCoord3D);
 				
-			if( min(vShadowMap_InTargetTextureCoord3D.x,vShadowMap_InTargetTextureCoord3D.y) > m_fMinBorderPaddingInShadowUV
-				&& max(vShadowMap_InTargetTextureCoord3D.x,vShadowMap_InTargetTextureCoord3D.y) < m_fMaxBorderPaddingInShadowUV)
+			// The border padding is a texel of the cascade's own tile.
+			float fBorderPadding = m_vTileTexelSizeInUV[iCascadeIndex].x;
+			if( min(vShadowMap_InTargetTextureCoord3D.x,vShadowMap_InTargetTextureCoord3D.y) > fBorderPadding
+				&& max(vShadowMap_InTargetTextureCoord3D.x,vShadowMap_InTargetTextureCoord3D.y) < 1.0f - fBorderPadding)
 			{
 				iCurrentCascadeIndex = iCascadeIndex;//jingz ҵڲ㼶xyü±
 				bCascadeFound = 1;
@@ -414,7 +462,7 @@ float4 PSMain( VS_OUTPUT Input ) : SV_TARGET
 		vOrthoUV_InTexCoordDDX = tempOrtho3D_DDX * m_vScaleFactorFromOrthoProjToTexureCoord[iCurrentCascadeIndex];
 		vOrthoUV_InTexCoordDDY = tempOrtho3D_DDY * m_vScaleFactorFromOrthoProjToTexureCoord[iCurrentCascadeIndex];
 
-		CalculateRightAndUpTexelDepthDeltas(vOrthoUV_InTexCoordDDX, vOrthoUV_InTexCoordDDY, fUpTexDepthWeight, fRightTexDepthWeight);
+		CalculateRightAndUpTexelDepthDeltas(iCurrentCascadeIndex, vOrthoUV_InTexCoordDDX, vOrthoUV_InTexCoordDDY, fUpTexDepthWeight, fRightTexDepthWeight);
 	}
 
 	//     Now that we know the correct map, we can transform the world space position of the current fragment                
@@ -423,11 +471,11 @@ float4 PSMain( VS_OUTPUT Input ) : SV_TARGET
 		TranformShadowToTexture3D(Input.vPosInShadowView, iCurrentCascadeIndex, vShadowMap_InTargetTextureCoord3D);
 	}
 
-	TransformLogicU_ToNativeU(iCurrentCascadeIndex, vShadowMap_InTargetTextureCoord3D);
+	TransformLogicUV_ToNativeUV(iCurrentCascadeIndex, vShadowMap_InTargetTextureCoord3D);
 
 	
 	//jingz õbufferϳɵshadowMapUVW꣬ԱwȣAOڵ
-	CalculatePCFPercentLit(vShadowMap_InTargetTextureCoord3D,fRightTexDepthWeight,fUpTexDepthWeight,fBlurRowSize,fPercentLit_CurLevel);
+	CalculatePCFPercentLit(iCurrentCascadeIndex,vShadowMap_InTargetTextureCoord3D,fRightTexDepthWeight,fUpTexDepthWeight,fBlurRowSize,fPercentLit_CurLevel);
 	
 	if(BLEND_BETWEEN_CASCADE_LAYERS_FLAG && CASCADE_COUNT_FLAG > 1)
 	{
@@ -435,8 +483,8 @@ float4 PSMain( VS_OUTPUT Input ) : SV_TARGET
 		{
 			//Next
 			TranformShadowToTexture3D(Input.vPosInShadowView, iNextCascadeIndex, vShadowMap_InTargetTextureCoord3D_NextLevel);
-			TransformLogicU_ToNativeU(iNextCascadeIndex, vShadowMap_InTargetTextureCoord3D_NextLevel);
-			CalculatePCFPercentLit(saturate(vShadowMap_InTargetTextureCoord3D_NextLevel), fRightTexDepthWeight, fUpTexDepthWeight, fBlurRowSize, fPercentLit_NextLevel);
+			TransformLogicUV_ToNativeUV(iNextCascadeIndex, vShadowMap_InTargetTextureCoord3D_NextLevel);
+			CalculatePCFPercentLit(iNextCascadeIndex,saturate(vShadowMap_InTargetTextureCoord3D_NextLevel), fRightTexDepthWeight, fUpTexDepthWeight, fBlurRowSize, fPercentLit_NextLevel);
 					
 			fPercentLit_CurLevel = lerp(fPercentLit_NextLevel, fPercentLit_CurLevel, fBlendRatioBetweenCascadeLevel);
 		}
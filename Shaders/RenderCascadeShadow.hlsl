@@ -7,11 +7,19 @@
 //--------------
 // Globals
 //-------------
-cbuffer cbPerObject:register(b0)
+// See CB_PER_CASCADE,bound at an offset into a ring when the device can do that.
+cbuffer cbPerCascade:register(b0)
 {
 	matrix g_mViewProjection:packoffset(c0);
 };
 
+// Single pass rendering of all cascades,see CB_SHADOW_CASCADES.
+cbuffer cbShadowCascades:register(b1)
+{
+	matrix g_mCascadeViewProjection[8];
+	uint4 g_vCascadeOfInstance[2]; // Instance i draws into cascade g_vCascadeOfInstance[i / 4][i % 4]
+};
+
 //----------------
 // Input / Output structure
 // ----------------
@@ -25,6 +33,25 @@ struct VS_OUTPUT
 	float4 vPosition:SV_POSITION;
 };
 
+struct VS_INPUT_INSTANCED
+{
+	float4 vPositionW:POSITION;
+	uint iInstanceID:SV_InstanceID;
+};
+
+struct VS_OUTPUT_CASCADE
+{
+	float4 vPosition:SV_POSITION;
+	uint iCascade:CASCADE;
+};
+
+struct GS_OUTPUT_CASCADE
+{
+	float4 vPosition:SV_POSITION;
+	uint iViewport:SV_ViewportArrayIndex;
+	uint iSlice:SV_RenderTargetArrayIndex; // Ignored unless the cascades are stored in a texture array
+};
+
 //--------------------------------
 // Vertex Shader
 //----------------------------
@@ -46,4 +73,53 @@ VS_OUTPUT VSMainPancake(VS_INPUT Input)
 	Output.vPosition = mul(Input.vPositionW,g_mViewProjection);
 	//Output.vPosition.z = max(Output.vPosition.z,0.0f);
 	return Output;
-}
\ No newline at end of file
+}
+
+// Resets one atlas tile to the far plane when only some cascades are re-rendered.
+// Draw 3 vertices without a vertex buffer,the triangle covers the whole viewport.
+VS_OUTPUT VSClearTile(uint iVertexID:SV_VertexID)
+{
+	VS_OUTPUT Output;
+
+	float2 vUV = float2((iVertexID << 1) & 2, iVertexID & 2);
+	Output.vPosition = float4(vUV * float2(2.0f, -2.0f) + float2(-1.0f, 1.0f), 1.0f, 1.0f);
+	return Output;
+}
+
+// The static casters of the atlas,see PSCopyStaticTile.
+Texture2DArray<float> g_txStaticCasters:register(t0);
+
+// Copies the static casters of a tile into the atlas before the dynamic casters are drawn over them.A depth
+// stencil resource can only be copied whole,so the tile is drawn with VSClearTile and this writes the depth.
+float PSCopyStaticTile(float4 vPosition:SV_POSITION):SV_Depth
+{
+	return g_txStaticCasters.Load(int4((int2)vPosition.xy, 0, 0));
+}
+
+//--------------------------------
+// Single pass:every instance of the mesh is one cascade,the geometry shader routes its triangles to the
+// cascade's viewport and texture array slice.
+//----------------------------
+VS_OUTPUT_CASCADE VSMainInstanced(VS_INPUT_INSTANCED Input)
+{
+	VS_OUTPUT_CASCADE Output;
+
+	Output.iCascade = g_vCascadeOfInstance[Input.iInstanceID / 4][Input.iInstanceID % 4];
+	Output.vPosition = mul(Input.vPositionW, g_mCascadeViewProjection[Output.iCascade]);
+	return Output;
+}
+
+[maxvertexcount(3)]
+void GSRouteToCascade(triangle VS_OUTPUT_CASCADE Input[3], inout TriangleStream<GS_OUTPUT_CASCADE> OutputStream)
+{
+	GS_OUTPUT_CASCADE Output;
+	Output.iViewport = Input[0].iCascade;
+	Output.iSlice = Input[0].iCascade;
+
+	[unroll]
+	for (int index = 0;index < 3;++index)
+	{
+		Output.vPosition = Input[index].vPosition;
+		OutputStream.Append(Output);
+	}
+}
@@ -0,0 +1,2106 @@
+#include "RecordingDevice.h"
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+namespace
+{
+
+#define RECORDED_UNWRITTEN_BYTE 0xCD // Fills the copy a NO_OVERWRITE map hands out
+
+UINT GetBitsPerPixel(DXGI_FORMAT Format)
+{
+	switch (Format)
+	{
+	case DXGI_FORMAT_R32G32B32A32_TYPELESS:
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:
+	case DXGI_FORMAT_R32G32B32A32_UINT:
+	case DXGI_FORMAT_R32G32B32A32_SINT:
+		return 128;
+	case DXGI_FORMAT_R32G32B32_TYPELESS:
+	case DXGI_FORMAT_R32G32B32_FLOAT:
+	case DXGI_FORMAT_R32G32B32_UINT:
+	case DXGI_FORMAT_R32G32B32_SINT:
+		return 96;
+	case DXGI_FORMAT_R16G16B16A16_TYPELESS:
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:
+	case DXGI_FORMAT_R16G16B16A16_UNORM:
+	case DXGI_FORMAT_R16G16B16A16_UINT:
+	case DXGI_FORMAT_R16G16B16A16_SNORM:
+	case DXGI_FORMAT_R16G16B16A16_SINT:
+	case DXGI_FORMAT_R32G32_TYPELESS:
+	case DXGI_FORMAT_R32G32_FLOAT:
+	case DXGI_FORMAT_R32G32_UINT:
+	case DXGI_FORMAT_R32G32_SINT:
+	case DXGI_FORMAT_R32G8X24_TYPELESS:
+	case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+	case DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS:
+	case DXGI_FORMAT_X32_TYPELESS_G8X24_UINT:
+		return 64;
+	case DXGI_FORMAT_R8G8_TYPELESS:
+	case DXGI_FORMAT_R8G8_UNORM:
+	case DXGI_FORMAT_R8G8_UINT:
+	case DXGI_FORMAT_R8G8_SNORM:
+	case DXGI_FORMAT_R8G8_SINT:
+	case DXGI_FORMAT_R16_TYPELESS:
+	case DXGI_FORMAT_R16_FLOAT:
+	case DXGI_FORMAT_D16_UNORM:
+	case DXGI_FORMAT_R16_UNORM:
+	case DXGI_FORMAT_R16_UINT:
+	case DXGI_FORMAT_R16_SNORM:
+	case DXGI_FORMAT_R16_SINT:
+	case DXGI_FORMAT_B5G6R5_UNORM:
+	case DXGI_FORMAT_B5G5R5A1_UNORM:
+		return 16;
+	case DXGI_FORMAT_R8_TYPELESS:
+	case DXGI_FORMAT_R8_UNORM:
+	case DXGI_FORMAT_R8_UINT:
+	case DXGI_FORMAT_R8_SNORM:
+	case DXGI_FORMAT_R8_SINT:
+	case DXGI_FORMAT_A8_UNORM:
+	case DXGI_FORMAT_BC2_TYPELESS:
+	case DXGI_FORMAT_BC2_UNORM:
+	case DXGI_FORMAT_BC2_UNORM_SRGB:
+	case DXGI_FORMAT_BC3_TYPELESS:
+	case DXGI_FORMAT_BC3_UNORM:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+	case DXGI_FORMAT_BC5_TYPELESS:
+	case DXGI_FORMAT_BC5_UNORM:
+	case DXGI_FORMAT_BC5_SNORM:
+	case DXGI_FORMAT_BC6H_TYPELESS:
+	case DXGI_FORMAT_BC6H_UF16:
+	case DXGI_FORMAT_BC6H_SF16:
+	case DXGI_FORMAT_BC7_TYPELESS:
+	case DXGI_FORMAT_BC7_UNORM:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		return 8;
+	case DXGI_FORMAT_BC1_TYPELESS:
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+	case DXGI_FORMAT_BC4_TYPELESS:
+	case DXGI_FORMAT_BC4_UNORM:
+	case DXGI_FORMAT_BC4_SNORM:
+		return 4;
+	default:
+		return 32; // The 32 bit colour and depth formats,and a guess for the rest
+	}
+}
+
+bool IsBlockCompressed(DXGI_FORMAT Format)
+{
+	return (Format >= DXGI_FORMAT_BC1_TYPELESS && Format <= DXGI_FORMAT_BC5_SNORM)
+		|| (Format >= DXGI_FORMAT_BC6H_TYPELESS && Format <= DXGI_FORMAT_BC7_UNORM_SRGB);
+}
+
+// Bytes of one 2D slice of a mip.Block compressed rows are rows of 4x4 blocks.
+UINT64 GetSliceBytes(DXGI_FORMAT Format, UINT uWidth, UINT uHeight, UINT* pRowPitch)
+{
+	UINT uBits = GetBitsPerPixel(Format);
+	UINT uRowPitch, uRowCount;
+	if (IsBlockCompressed(Format))
+	{
+		uRowPitch = ((uWidth + 3) / 4) * uBits * 2; // 16 pixels per block
+		uRowCount = (uHeight + 3) / 4;
+	}
+	else
+	{
+		uRowPitch = (uWidth * uBits + 7) / 8;
+		uRowCount = uHeight;
+	}
+	*pRowPitch = uRowPitch;
+	return (UINT64)uRowPitch * uRowCount;
+}
+
+UINT CountMips(UINT uMipLevels, UINT uLargestSide)
+{
+	if (uMipLevels != 0)
+	{
+		return uMipLevels;
+	}
+
+	UINT nMips = 1;
+	while (uLargestSide > 1)
+	{
+		uLargestSide >>= 1;
+		++nMips;
+	}
+	return nMips;
+}
+
+UINT MipSide(UINT uSide, UINT uMip)
+{
+	uSide >>= uMip;
+	return uSide > 0 ? uSide : 1;
+}
+
+struct TextureExtent
+{
+	UINT m_uWidth;
+	UINT m_uHeight;
+	UINT m_uDepth;
+	UINT m_nArraySlices;
+	UINT m_nSamples;
+};
+
+TextureExtent GetExtent(const D3D11_TEXTURE1D_DESC& Desc)
+{
+	TextureExtent Extent = { Desc.Width,1,1,Desc.ArraySize,1 };
+	return Extent;
+}
+
+TextureExtent GetExtent(const D3D11_TEXTURE2D_DESC& Desc)
+{
+	TextureExtent Extent = { Desc.Width,Desc.Height,1,Desc.ArraySize,Desc.SampleDesc.Count };
+	return Extent;
+}
+
+TextureExtent GetExtent(const D3D11_TEXTURE3D_DESC& Desc)
+{
+	TextureExtent Extent = { Desc.Width,Desc.Height,Desc.Depth,1,1 };
+	return Extent;
+}
+
+UINT GetLargestSide(const TextureExtent& Extent)
+{
+	UINT uSide = Extent.m_uWidth > Extent.m_uHeight ? Extent.m_uWidth : Extent.m_uHeight;
+	return uSide > Extent.m_uDepth ? uSide : Extent.m_uDepth;
+}
+
+// Implemented by the fake buffers and textures,so the context can find their size and memory.
+class RecordedResource
+{
+public:
+	virtual ~RecordedResource() {}
+
+	virtual UINT GetSubresourceCount() const = 0;
+	virtual UINT64 GetSubresourceBytes(UINT uSubresource) const = 0;
+
+	// System memory of a subresource the CPU can map,nullptr for the others.
+	virtual BYTE* GetSubresourceMemory(UINT uSubresource, UINT* pRowPitch, UINT* pDepthPitch) = 0;
+};
+
+template<class TInterface>
+class RecordingDeviceChild : public TInterface
+{
+public:
+	RecordingDeviceChild(RecordingDevice* pDevice, UINT64 uResourceBytes) :
+		m_pDevice(pDevice),
+		m_uRefCount(1),
+		m_uResourceBytes(uResourceBytes)
+	{
+		m_pDevice->OnObjectCreated(m_uResourceBytes);
+	}
+
+	virtual ~RecordingDeviceChild()
+	{
+		m_pDevice->OnObjectDestroyed(m_uResourceBytes);
+	}
+
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObject) override
+	{
+		if (!ppvObject)
+		{
+			return E_POINTER;
+		}
+
+		if (riid == __uuidof(TInterface) || riid == __uuidof(IUnknown) || riid == __uuidof(ID3D11DeviceChild)
+			|| (std::is_base_of<ID3D11Resource, TInterface>::value && riid == __uuidof(ID3D11Resource))
+			|| (std::is_base_of<ID3D11View, TInterface>::value && riid == __uuidof(ID3D11View)))
+		{
+			*ppvObject = static_cast<TInterface*>(this);
+			AddRef();
+			return S_OK;
+		}
+
+		*ppvObject = nullptr;
+		return E_NOINTERFACE;
+	}
+
+	ULONG STDMETHODCALLTYPE AddRef() override
+	{
+		return ++m_uRefCount;
+	}
+
+	ULONG STDMETHODCALLTYPE Release() override
+	{
+		ULONG uRefCount = --m_uRefCount;
+		if (uRefCount == 0)
+		{
+			delete this;
+		}
+		return uRefCount;
+	}
+
+	void STDMETHODCALLTYPE GetDevice(ID3D11Device** ppDevice) override
+	{
+		m_pDevice->AddRef();
+		*ppDevice = m_pDevice;
+	}
+
+	HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID guid, UINT* pDataSize, void* pData) override
+	{
+		UNREFERENCED_PARAMETER(guid);
+		UNREFERENCED_PARAMETER(pData);
+		if (pDataSize)
+		{
+			*pDataSize = 0;
+		}
+		return DXGI_ERROR_NOT_FOUND;
+	}
+
+	// Debug names are dropped.
+	HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID guid, UINT DataSize, const void* pData) override
+	{
+		UNREFERENCED_PARAMETER(guid);
+		UNREFERENCED_PARAMETER(DataSize);
+		UNREFERENCED_PARAMETER(pData);
+		return S_OK;
+	}
+
+	HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID guid, const IUnknown* pData) override
+	{
+		UNREFERENCED_PARAMETER(guid);
+		UNREFERENCED_PARAMETER(pData);
+		return S_OK;
+	}
+
+protected:
+	RecordingDevice* m_pDevice;
+	std::atomic<ULONG> m_uRefCount;
+	UINT64 m_uResourceBytes;
+};
+
+// Buffers the CPU writes or reads keep their contents in system memory.
+class RecordingBuffer : public RecordingDeviceChild<ID3D11Buffer>, public RecordedResource
+{
+public:
+	RecordingBuffer(RecordingDevice* pDevice, const D3D11_BUFFER_DESC& Desc, const D3D11_SUBRESOURCE_DATA* pInitialData) :
+		RecordingDeviceChild<ID3D11Buffer>(pDevice, Desc.ByteWidth),
+		m_Desc(Desc),
+		m_uEvictionPriority(0)
+	{
+		if (Desc.Usage == D3D11_USAGE_DYNAMIC || Desc.Usage == D3D11_USAGE_STAGING)
+		{
+			m_Memory.resize(Desc.ByteWidth);
+			if (pInitialData && pInitialData->pSysMem)
+			{
+				memcpy(&m_Memory[0], pInitialData->pSysMem, Desc.ByteWidth);
+			}
+		}
+	}
+
+	void STDMETHODCALLTYPE GetType(D3D11_RESOURCE_DIMENSION* pResourceDimension) override
+	{
+		*pResourceDimension = D3D11_RESOURCE_DIMENSION_BUFFER;
+	}
+
+	void STDMETHODCALLTYPE SetEvictionPriority(UINT EvictionPriority) override
+	{
+		m_uEvictionPriority = EvictionPriority;
+	}
+
+	UINT STDMETHODCALLTYPE GetEvictionPriority() override
+	{
+		return m_uEvictionPriority;
+	}
+
+	void STDMETHODCALLTYPE GetDesc(D3D11_BUFFER_DESC* pDesc) override
+	{
+		*pDesc = m_Desc;
+	}
+
+	UINT GetSubresourceCount() const override
+	{
+		return 1;
+	}
+
+	UINT64 GetSubresourceBytes(UINT uSubresource) const override
+	{
+		UNREFERENCED_PARAMETER(uSubresource);
+		return m_Desc.ByteWidth;
+	}
+
+	BYTE* GetSubresourceMemory(UINT uSubresource, UINT* pRowPitch, UINT* pDepthPitch) override
+	{
+		if (uSubresource != 0 || m_Memory.empty())
+		{
+			return nullptr;
+		}
+		*pRowPitch = m_Desc.ByteWidth;
+		*pDepthPitch = m_Desc.ByteWidth;
+		return &m_Memory[0];
+	}
+
+private:
+	D3D11_BUFFER_DESC m_Desc;
+	UINT m_uEvictionPriority;
+	std::vector<BYTE> m_Memory;
+};
+
+// Textures with CPU access keep all their subresources in system memory,one after the other.
+template<class TInterface, class TDesc, D3D11_RESOURCE_DIMENSION eDimension>
+class RecordingTexture : public RecordingDeviceChild<TInterface>, public RecordedResource
+{
+public:
+	RecordingTexture(RecordingDevice* pDevice, const TDesc& Desc, const D3D11_SUBRESOURCE_DATA* pInitialData) :
+		RecordingDeviceChild<TInterface>(pDevice, GetTextureBytes(Desc)),
+		m_Desc(Desc),
+		m_uEvictionPriority(0)
+	{
+		TextureExtent Extent = GetExtent(Desc);
+		UINT nMips = CountMips(Desc.MipLevels, GetLargestSide(Extent));
+		m_Desc.MipLevels = nMips;
+
+		UINT64 uOffset = 0;
+		for (UINT iSlice = 0;iSlice < Extent.m_nArraySlices;++iSlice)
+		{
+			for (UINT iMip = 0;iMip < nMips;++iMip)
+			{
+				Subresource Layout;
+				UINT64 uSliceBytes = GetSliceBytes(Desc.Format, MipSide(Extent.m_uWidth, iMip), MipSide(Extent.m_uHeight, iMip), &Layout.m_uRowPitch);
+				Layout.m_uDepthPitch = (UINT)uSliceBytes;
+				Layout.m_uOffset = uOffset;
+				Layout.m_uBytes = uSliceBytes * MipSide(Extent.m_uDepth, iMip) * Extent.m_nSamples;
+				m_Subresources.push_back(Layout);
+				uOffset += Layout.m_uBytes;
+			}
+		}
+
+		if (Desc.CPUAccessFlags != 0)
+		{
+			m_Memory.resize((size_t)uOffset);
+			for (UINT i = 0;pInitialData && i < (UINT)m_Subresources.size();++i)
+			{
+				if (pInitialData[i].pSysMem)
+				{
+					memcpy(&m_Memory[(size_t)m_Subresources[i].m_uOffset], pInitialData[i].pSysMem, (size_t)m_Subresources[i].m_uBytes);
+				}
+			}
+		}
+	}
+
+	static UINT64 GetTextureBytes(const TDesc& Desc)
+	{
+		TextureExtent Extent = GetExtent(Desc);
+		UINT nMips = CountMips(Desc.MipLevels, GetLargestSide(Extent));
+		UINT64 uBytes = 0;
+		for (UINT iMip = 0;iMip < nMips;++iMip)
+		{
+			UINT uRowPitch;
+			uBytes += GetSliceBytes(Desc.Format, MipSide(Extent.m_uWidth, iMip), MipSide(Extent.m_uHeight, iMip), &uRowPitch) * MipSide(Extent.m_uDepth, iMip);
+		}
+		return uBytes * Extent.m_nArraySlices * Extent.m_nSamples;
+	}
+
+	void STDMETHODCALLTYPE GetType(D3D11_RESOURCE_DIMENSION* pResourceDimension) override
+	{
+		*pResourceDimension = eDimension;
+	}
+
+	void STDMETHODCALLTYPE SetEvictionPriority(UINT EvictionPriority) override
+	{
+		m_uEvictionPriority = EvictionPriority;
+	}
+
+	UINT STDMETHODCALLTYPE GetEvictionPriority() override
+	{
+		return m_uEvictionPriority;
+	}
+
+	void STDMETHODCALLTYPE GetDesc(TDesc* pDesc) override
+	{
+		*pDesc = m_Desc;
+	}
+
+	UINT GetSubresourceCount() const override
+	{
+		return (UINT)m_Subresources.size();
+	}
+
+	UINT64 GetSubresourceBytes(UINT uSubresource) const override
+	{
+		return uSubresource < m_Subresources.size() ? m_Subresources[uSubresource].m_uBytes : 0;
+	}
+
+	BYTE* GetSubresourceMemory(UINT uSubresource, UINT* pRowPitch, UINT* pDepthPitch) override
+	{
+		if (uSubresource >= m_Subresources.size() || m_Memory.empty())
+		{
+			return nullptr;
+		}
+		*pRowPitch = m_Subresources[uSubresource].m_uRowPitch;
+		*pDepthPitch = m_Subresources[uSubresource].m_uDepthPitch;
+		return &m_Memory[(size_t)m_Subresources[uSubresource].m_uOffset];
+	}
+
+private:
+	struct Subresource
+	{
+		UINT64 m_uOffset;
+		UINT64 m_uBytes;
+		UINT m_uRowPitch;
+		UINT m_uDepthPitch;
+	};
+
+	TDesc m_Desc;
+	UINT m_uEvictionPriority;
+	std::vector<Subresource> m_Subresources;
+	std::vector<BYTE> m_Memory;
+};
+
+typedef RecordingTexture<ID3D11Texture1D, D3D11_TEXTURE1D_DESC, D3D11_RESOURCE_DIMENSION_TEXTURE1D> RecordingTexture1D;
+typedef RecordingTexture<ID3D11Texture2D, D3D11_TEXTURE2D_DESC, D3D11_RESOURCE_DIMENSION_TEXTURE2D> RecordingTexture2D;
+typedef RecordingTexture<ID3D11Texture3D, D3D11_TEXTURE3D_DESC, D3D11_RESOURCE_DIMENSION_TEXTURE3D> RecordingTexture3D;
+
+// A view holds a reference to its resource.A view created without a description returns a zeroed one.
+template<class TInterface, class TDesc>
+class RecordingView : public RecordingDeviceChild<TInterface>
+{
+public:
+	RecordingView(RecordingDevice* pDevice, ID3D11Resource* pResource, const TDesc* pDesc) :
+		RecordingDeviceChild<TInterface>(pDevice, 0),
+		m_pResource(pResource)
+	{
+		m_pResource->AddRef();
+		if (pDesc)
+		{
+			m_Desc = *pDesc;
+		}
+		else
+		{
+			memset(&m_Desc, 0, sizeof(m_Desc));
+		}
+	}
+
+	~RecordingView()
+	{
+		m_pResource->Release();
+	}
+
+	void STDMETHODCALLTYPE GetResource(ID3D11Resource** ppResource) override
+	{
+		m_pResource->AddRef();
+		*ppResource = m_pResource;
+	}
+
+	void STDMETHODCALLTYPE GetDesc(TDesc* pDesc) override
+	{
+		*pDesc = m_Desc;
+	}
+
+private:
+	ID3D11Resource* m_pResource;
+	TDesc m_Desc;
+};
+
+template<class TInterface, class TDesc>
+class RecordingState : public RecordingDeviceChild<TInterface>
+{
+public:
+	RecordingState(RecordingDevice* pDevice, const TDesc& Desc) :
+		RecordingDeviceChild<TInterface>(pDevice, 0),
+		m_Desc(Desc)
+	{
+	}
+
+	void STDMETHODCALLTYPE GetDesc(TDesc* pDesc) override
+	{
+		*pDesc = m_Desc;
+	}
+
+private:
+	TDesc m_Desc;
+};
+
+// What a deferred context recorded between two FinishCommandList calls.
+class RecordingCommandList : public RecordingDeviceChild<ID3D11CommandList>
+{
+public:
+	RecordingCommandList(RecordingDevice* pDevice, std::vector<RecordedCommand>& Commands, const RecordedFrameStats& Stats) :
+		RecordingDeviceChild<ID3D11CommandList>(pDevice, 0),
+		m_Stats(Stats)
+	{
+		m_Commands.swap(Commands);
+	}
+
+	UINT STDMETHODCALLTYPE GetContextFlags() override
+	{
+		return 0;
+	}
+
+	const std::vector<RecordedCommand>& GetCommands() const
+	{
+		return m_Commands;
+	}
+
+	const RecordedFrameStats& GetStats() const
+	{
+		return m_Stats;
+	}
+
+private:
+	std::vector<RecordedCommand> m_Commands;
+	RecordedFrameStats m_Stats;
+};
+
+template<class T>
+void ZeroPointers(T** ppObjects, UINT nObjects)
+{
+	for (UINT i = 0;ppObjects && i < nObjects;++i)
+	{
+		ppObjects[i] = nullptr;
+	}
+}
+
+template<class T>
+void ZeroShader(T** ppShader, ID3D11ClassInstance** ppClassInstances, UINT* pNumClassInstances)
+{
+	if (ppShader)
+	{
+		*ppShader = nullptr;
+	}
+	if (pNumClassInstances)
+	{
+		ZeroPointers(ppClassInstances, *pNumClassInstances);
+		*pNumClassInstances = 0;
+	}
+}
+
+}
+
+
+//--------------------------------------------------------------------------------------
+// RecordingDeviceContext
+//--------------------------------------------------------------------------------------
+RecordingDeviceContext::RecordingDeviceContext(RecordingDevice* pDevice, D3D11_DEVICE_CONTEXT_TYPE eType) :
+	m_pDevice(pDevice),
+	m_eType(eType),
+	m_uRefCount(1)
+{
+	ResetBoundState();
+	ResetRecording();
+
+	// The immediate context is built before the counters of its device.
+	if (m_eType == D3D11_DEVICE_CONTEXT_DEFERRED)
+	{
+		m_pDevice->OnObjectCreated(0);
+	}
+}
+
+RecordingDeviceContext::~RecordingDeviceContext()
+{
+	if (m_eType == D3D11_DEVICE_CONTEXT_DEFERRED)
+	{
+		m_pDevice->OnObjectDestroyed(0);
+	}
+}
+
+void RecordingDeviceContext::ResetRecording()
+{
+	m_Commands.clear();
+	memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+void RecordingDeviceContext::ResetBoundState()
+{
+	m_pInputLayout = nullptr;
+	m_eTopology = D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED;
+	memset(m_pVertexBuffers, 0, sizeof(m_pVertexBuffers));
+	memset(m_uVertexStrides, 0, sizeof(m_uVertexStrides));
+	memset(m_uVertexOffsets, 0, sizeof(m_uVertexOffsets));
+	m_pIndexBuffer = nullptr;
+	m_eIndexFormat = DXGI_FORMAT_UNKNOWN;
+	m_uIndexOffset = 0;
+	memset(m_pShaders, 0, sizeof(m_pShaders));
+	memset(m_pConstantBuffers, 0, sizeof(m_pConstantBuffers));
+	memset(m_uFirstConstants, 0, sizeof(m_uFirstConstants));
+	memset(m_uNumConstants, 0, sizeof(m_uNumConstants));
+	memset(m_pShaderResources, 0, sizeof(m_pShaderResources));
+	memset(m_pSamplers, 0, sizeof(m_pSamplers));
+	memset(m_pUnorderedAccessViews, 0, sizeof(m_pUnorderedAccessViews));
+	m_pRasterizerState = nullptr;
+	m_nViewports = 0;
+	memset(m_Viewports, 0, sizeof(m_Viewports));
+	memset(m_pRenderTargets, 0, sizeof(m_pRenderTargets));
+	m_pDepthStencilView = nullptr;
+	m_pDepthStencilState = nullptr;
+	m_uStencilRef = 0;
+	m_pBlendState = nullptr;
+	for (INT i = 0;i < 4;++i)
+	{
+		m_fBlendFactor[i] = 1.0f;
+	}
+	m_uSampleMask = 0xffffffff;
+}
+
+UINT RecordingDeviceContext::GetDrawCountInViewport(FLOAT fTopLeftX, FLOAT fTopLeftY, bool bCountViewportArrays) const
+{
+	UINT nDraws = 0;
+	for (size_t i = 0;i < m_Commands.size();++i)
+	{
+		const RecordedCommand& Command = m_Commands[i];
+		if (Command.m_eType != RECORDED_DRAW || Command.m_nViewports == 0 || (Command.m_nViewports > 1 && !bCountViewportArrays))
+		{
+			continue;
+		}
+		if (Command.m_fViewportX == fTopLeftX && Command.m_fViewportY == fTopLeftY)
+		{
+			++nDraws;
+		}
+	}
+	return nDraws;
+}
+
+UINT RecordingDeviceContext::GetDrawCountInArraySlice(UINT uSlice, bool bCountViewportArrays) const
+{
+	UINT nDraws = 0;
+	for (size_t i = 0;i < m_Commands.size();++i)
+	{
+		const RecordedCommand& Command = m_Commands[i];
+		if (Command.m_eType != RECORDED_DRAW || Command.m_nViewports == 0 || (Command.m_nViewports > 1 && !bCountViewportArrays))
+		{
+			continue;
+		}
+		if (Command.m_uArraySlice == uSlice)
+		{
+			++nDraws;
+		}
+	}
+	return nDraws;
+}
+
+RecordedCommand& RecordingDeviceContext::Record(RECORDED_COMMAND_TYPE eType, const char* szName)
+{
+	RecordedCommand Command;
+	memset(&Command, 0, sizeof(Command));
+	Command.m_eType = eType;
+	Command.m_szName = szName;
+	m_Commands.push_back(Command);
+	++m_Stats.m_nCommands;
+	return m_Commands.back();
+}
+
+void RecordingDeviceContext::RecordSetter(const char* szName, bool bRedundant)
+{
+	Record(RECORDED_SET_STATE, szName).m_bRedundant = bRedundant;
+	++m_Stats.m_nStateChanges;
+	if (bRedundant)
+	{
+		++m_Stats.m_nRedundantStateChanges;
+	}
+}
+
+void RecordingDeviceContext::RecordDraw(const char* szName, UINT uCount, UINT nInstances)
+{
+	RecordedCommand& Command = Record(RECORDED_DRAW, szName);
+	Command.m_uCount = uCount;
+	Command.m_nInstances = nInstances;
+	Command.m_nViewports = m_nViewports;
+	Command.m_uVertexStride = m_uVertexStrides[0];
+	if (m_nViewports > 0)
+	{
+		Command.m_fViewportX = m_Viewports[0].TopLeftX;
+		Command.m_fViewportY = m_Viewports[0].TopLeftY;
+	}
+	if (m_pDepthStencilView)
+	{
+		D3D11_DEPTH_STENCIL_VIEW_DESC ViewDesc;
+		m_pDepthStencilView->GetDesc(&ViewDesc);
+		if (ViewDesc.ViewDimension == D3D11_DSV_DIMENSION_TEXTURE2DARRAY)
+		{
+			Command.m_uArraySlice = ViewDesc.Texture2DArray.FirstArraySlice;
+		}
+	}
+
+	++m_Stats.m_nDraws;
+	m_Stats.m_nInstances += nInstances;
+	m_Stats.m_uVerticesSubmitted += (UINT64)uCount * nInstances;
+}
+
+void RecordingDeviceContext::SetSlots(const char* szName, void** ppBound, UINT uBoundCount, UINT StartSlot, UINT NumSlots, void* const* ppNew)
+{
+	bool bRedundant = true;
+	for (UINT i = 0;i < NumSlots;++i)
+	{
+		void* pNew = ppNew ? ppNew[i] : nullptr;
+		if (StartSlot + i >= uBoundCount)
+		{
+			bRedundant = false; // Not tracked
+		}
+		else if (ppBound[StartSlot + i] != pNew)
+		{
+			ppBound[StartSlot + i] = pNew;
+			bRedundant = false;
+		}
+	}
+	RecordSetter(szName, bRedundant);
+}
+
+void RecordingDeviceContext::SetShader(const char* szName, UINT uStage, void* pShader)
+{
+	bool bRedundant = m_pShaders[uStage] == pShader;
+	m_pShaders[uStage] = pShader;
+	RecordSetter(szName, bRedundant);
+}
+
+// Another range of a bound buffer is a state change of its own.The offsets of the first slot are recorded.
+void RecordingDeviceContext::SetConstantBuffers(const char* szName, UINT uStage, UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers,
+	const UINT* pFirstConstant, const UINT* pNumConstants)
+{
+	bool bRedundant = true;
+	for (UINT i = 0;i < NumBuffers;++i)
+	{
+		void* pNew = ppConstantBuffers ? ppConstantBuffers[i] : nullptr;
+		UINT uFirstConstant = pFirstConstant ? pFirstConstant[i] : 0;
+		UINT uNumConstants = pNumConstants ? pNumConstants[i] : 0;
+		UINT uSlot = StartSlot + i;
+		if (uSlot >= RECORDED_SLOT_COUNT)
+		{
+			bRedundant = false; // Not tracked
+		}
+		else if (m_pConstantBuffers[uStage][uSlot] != pNew || m_uFirstConstants[uStage][uSlot] != uFirstConstant || m_uNumConstants[uStage][uSlot] != uNumConstants)
+		{
+			m_pConstantBuffers[uStage][uSlot] = pNew;
+			m_uFirstConstants[uStage][uSlot] = uFirstConstant;
+			m_uNumConstants[uStage][uSlot] = uNumConstants;
+			bRedundant = false;
+		}
+	}
+	RecordSetter(szName, bRedundant);
+
+	if (NumBuffers > 0 && pFirstConstant && pNumConstants)
+	{
+		m_Commands.back().m_uFirstConstant = pFirstConstant[0];
+		m_Commands.back().m_uNumConstants = pNumConstants[0];
+	}
+}
+
+void RecordingDeviceContext::AddStats(const RecordedFrameStats& Stats)
+{
+	m_Stats.m_nCommands += Stats.m_nCommands;
+	m_Stats.m_nStateChanges += Stats.m_nStateChanges;
+	m_Stats.m_nRedundantStateChanges += Stats.m_nRedundantStateChanges;
+	m_Stats.m_nMaps += Stats.m_nMaps;
+	m_Stats.m_uBytesUploaded += Stats.m_uBytesUploaded;
+	m_Stats.m_uBytesCopied += Stats.m_uBytesCopied;
+	m_Stats.m_nDraws += Stats.m_nDraws;
+	m_Stats.m_nInstances += Stats.m_nInstances;
+	m_Stats.m_uVerticesSubmitted += Stats.m_uVerticesSubmitted;
+	m_Stats.m_nClears += Stats.m_nClears;
+	m_Stats.m_nDispatches += Stats.m_nDispatches;
+}
+
+HRESULT STDMETHODCALLTYPE RecordingDeviceContext::QueryInterface(REFIID riid, void** ppvObject)
+{
+	if (!ppvObject)
+	{
+		return E_POINTER;
+	}
+
+	// Whether callers take their D3D 11.1 path is up to CheckFeatureSupport.
+	if (riid == __uuidof(ID3D11DeviceContext1) || riid == __uuidof(ID3D11DeviceContext) || riid == __uuidof(ID3D11DeviceChild) || riid == __uuidof(IUnknown))
+	{
+		*ppvObject = static_cast<ID3D11DeviceContext1*>(this);
+		AddRef();
+		return S_OK;
+	}
+
+	*ppvObject = nullptr;
+	return E_NOINTERFACE;
+}
+
+// The immediate context lives and dies with its device,deferred contexts are deleted by their last Release.
+ULONG STDMETHODCALLTYPE RecordingDeviceContext::AddRef()
+{
+	if (m_eType == D3D11_DEVICE_CONTEXT_IMMEDIATE)
+	{
+		return m_pDevice->AddRef();
+	}
+	return ++m_uRefCount;
+}
+
+ULONG STDMETHODCALLTYPE RecordingDeviceContext::Release()
+{
+	if (m_eType == D3D11_DEVICE_CONTEXT_IMMEDIATE)
+	{
+		return m_pDevice->Release();
+	}
+
+	ULONG uRefCount = --m_uRefCount;
+	if (uRefCount == 0)
+	{
+		delete this;
+	}
+	return uRefCount;
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::GetDevice(ID3D11Device** ppDevice)
+{
+	m_pDevice->AddRef();
+	*ppDevice = m_pDevice;
+}
+
+HRESULT STDMETHODCALLTYPE RecordingDeviceContext::GetPrivateData(REFGUID guid, UINT* pDataSize, void* pData)
+{
+	UNREFERENCED_PARAMETER(guid);
+	UNREFERENCED_PARAMETER(pData);
+	if (pDataSize)
+	{
+		*pDataSize = 0;
+	}
+	return DXGI_ERROR_NOT_FOUND;
+}
+
+HRESULT STDMETHODCALLTYPE RecordingDeviceContext::SetPrivateData(REFGUID guid, UINT DataSize, const void* pData)
+{
+	UNREFERENCED_PARAMETER(guid);
+	UNREFERENCED_PARAMETER(DataSize);
+	UNREFERENCED_PARAMETER(pData);
+	return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE RecordingDeviceContext::SetPrivateDataInterface(REFGUID guid, const IUnknown* pData)
+{
+	UNREFERENCED_PARAMETER(guid);
+	UNREFERENCED_PARAMETER(pData);
+	return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+// Input assembler
+//--------------------------------------------------------------------------------------
+void STDMETHODCALLTYPE RecordingDeviceContext::IASetInputLayout(ID3D11InputLayout* pInputLayout)
+{
+	bool bRedundant = m_pInputLayout == pInputLayout;
+	m_pInputLayout = pInputLayout;
+	RecordSetter("IASetInputLayout", bRedundant);
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::IASetVertexBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppVertexBuffers, const UINT* pStrides, const UINT* pOffsets)
+{
+	bool bRedundant = true;
+	for (UINT i = 0;i < NumBuffers && StartSlot + i < D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT;++i)
+	{
+		UINT iSlot = StartSlot + i;
+		void* pBuffer = ppVertexBuffers ? ppVertexBuffers[i] : nullptr;
+		UINT uStride = pStrides ? pStrides[i] : 0;
+		UINT uOffset = pOffsets ? pOffsets[i] : 0;
+		if (m_pVertexBuffers[iSlot] != pBuffer || m_uVertexStrides[iSlot] != uStride || m_uVertexOffsets[iSlot] != uOffset)
+		{
+			m_pVertexBuffers[iSlot] = pBuffer;
+			m_uVertexStrides[iSlot] = uStride;
+			m_uVertexOffsets[iSlot] = uOffset;
+			bRedundant = false;
+		}
+	}
+	RecordSetter("IASetVertexBuffers", bRedundant);
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::IASetIndexBuffer(ID3D11Buffer* pIndexBuffer, DXGI_FORMAT Format, UINT Offset)
+{
+	bool bRedundant = m_pIndexBuffer == pIndexBuffer && m_eIndexFormat == Format && m_uIndexOffset == Offset;
+	m_pIndexBuffer = pIndexBuffer;
+	m_eIndexFormat = Format;
+	m_uIndexOffset = Offset;
+	RecordSetter("IASetIndexBuffer", bRedundant);
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY Topology)
+{
+	bool bRedundant = m_eTopology == Topology;
+	m_eTopology = Topology;
+	RecordSetter("IASetPrimitiveTopology", bRedundant);
+}
+
+//--------------------------------------------------------------------------------------
+// Shader stages
+//--------------------------------------------------------------------------------------
+#define RECORDING_STAGE_SETTERS(Stage, ShaderInterface) \
+void STDMETHODCALLTYPE RecordingDeviceContext::Stage##SetShader(ShaderInterface* pShader, ID3D11ClassInstance* const* ppClassInstances, UINT NumClassInstances) \
+{ \
+	UNREFERENCED_PARAMETER(ppClassInstances); \
+	UNREFERENCED_PARAMETER(NumClassInstances); \
+	SetShader(#Stage "SetShader", STAGE_##Stage, pShader); \
+} \
+void STDMETHODCALLTYPE RecordingDeviceContext::Stage##SetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers) \
+{ \
+	SetConstantBuffers(#Stage "SetConstantBuffers", STAGE_##Stage, StartSlot, NumBuffers, ppConstantBuffers, nullptr, nullptr); \
+} \
+void STDMETHODCALLTYPE RecordingDeviceContext::Stage##SetConstantBuffers1(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers, \
+	const UINT* pFirstConstant, const UINT* pNumConstants) \
+{ \
+	SetConstantBuffers(#Stage "SetConstantBuffers1", STAGE_##Stage, StartSlot, NumBuffers, ppConstantBuffers, pFirstConstant, pNumConstants); \
+} \
+void STDMETHODCALLTYPE RecordingDeviceContext::Stage##SetShaderResources(UINT StartSlot, UINT NumViews, ID3D11ShaderResourceView* const* ppShaderResourceViews) \
+{ \
+	SetSlots(#Stage "SetShaderResources", m_pShaderResources[STAGE_##Stage], RECORDED_SLOT_COUNT, StartSlot, NumViews, reinterpret_cast<void* const*>(ppShaderResourceViews)); \
+} \
+void STDMETHODCALLTYPE RecordingDeviceContext::Stage##SetSamplers(UINT StartSlot, UINT NumSamplers, ID3D11SamplerState* const* ppSamplers) \
+{ \
+	SetSlots(#Stage "SetSamplers", m_pSamplers[STAGE_##Stage], RECORDED_SLOT_COUNT, StartSlot, NumSamplers, reinterpret_cast<void* const*>(ppSamplers)); \
+} \
+void STDMETHODCALLTYPE RecordingDeviceContext::Stage##GetShader(ShaderInterface** ppShader, ID3D11ClassInstance** ppClassInstances, UINT* pNumClassInstances) \
+{ \
+	ZeroShader(ppShader, ppClassInstances, pNumClassInstances); \
+} \
+void STDMETHODCALLTYPE RecordingDeviceContext::Stage##GetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer** ppConstantBuffers) \
+{ \
+	UNREFERENCED_PARAMETER(StartSlot); \
+	ZeroPointers(ppConstantBuffers, NumBuffers); \
+} \
+void STDMETHODCALLTYPE RecordingDeviceContext::Stage##GetConstantBuffers1(UINT StartSlot, UINT NumBuffers, ID3D11Buffer** ppConstantBuffers, \
+	UINT* pFirstConstant, UINT* pNumConstants) \
+{ \
+	UNREFERENCED_PARAMETER(StartSlot); \
+	ZeroPointers(ppConstantBuffers, NumBuffers); \
+	for (UINT i = 0;i < NumBuffers;++i) \
+	{ \
+		if (pFirstConstant) \
+		{ \
+			pFirstConstant[i] = 0; \
+		} \
+		if (pNumConstants) \
+		{ \
+			pNumConstants[i] = 0; \
+		} \
+	} \
+} \
+void STDMETHODCALLTYPE RecordingDeviceContext::Stage##GetShaderResources(UINT StartSlot, UINT NumViews, ID3D11ShaderResourceView** ppShaderResourceViews) \
+{ \
+	UNREFERENCED_PARAMETER(StartSlot); \
+	ZeroPointers(ppShaderResourceViews, NumViews); \
+} \
+void STDMETHODCALLTYPE RecordingDeviceContext::Stage##GetSamplers(UINT StartSlot, UINT NumSamplers, ID3D11SamplerState** ppSamplers) \
+{ \
+	UNREFERENCED_PARAMETER(StartSlot); \
+	ZeroPointers(ppSamplers, NumSamplers); \
+}
+
+RECORDING_STAGE_SETTERS(VS, ID3D11VertexShader)
+RECORDING_STAGE_SETTERS(HS, ID3D11HullShader)
+RECORDING_STAGE_SETTERS(DS, ID3D11DomainShader)
+RECORDING_STAGE_SETTERS(GS, ID3D11GeometryShader)
+RECORDING_STAGE_SETTERS(PS, ID3D11PixelShader)
+RECORDING_STAGE_SETTERS(CS, ID3D11ComputeShader)
+
+#undef RECORDING_STAGE_SETTERS
+
+void STDMETHODCALLTYPE RecordingDeviceContext::CSSetUnorderedAccessViews(UINT StartSlot, UINT NumUAVs, ID3D11UnorderedAccessView* const* ppUnorderedAccessViews, const UINT* pUAVInitialCounts)
+{
+	UNREFERENCED_PARAMETER(pUAVInitialCounts);
+	SetSlots("CSSetUnorderedAccessViews", m_pUnorderedAccessViews, D3D11_PS_CS_UAV_REGISTER_COUNT, StartSlot, NumUAVs, reinterpret_cast<void* const*>(ppUnorderedAccessViews));
+}
+
+//--------------------------------------------------------------------------------------
+// Rasterizer and output merger
+//--------------------------------------------------------------------------------------
+void STDMETHODCALLTYPE RecordingDeviceContext::RSSetState(ID3D11RasterizerState* pRasterizerState)
+{
+	bool bRedundant = m_pRasterizerState == pRasterizerState;
+	m_pRasterizerState = pRasterizerState;
+	RecordSetter("RSSetState", bRedundant);
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::RSSetViewports(UINT NumViewports, const D3D11_VIEWPORT* pViewports)
+{
+	if (NumViewports > D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE)
+	{
+		NumViewports = D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE;
+	}
+
+	bool bRedundant = m_nViewports == NumViewports && (NumViewports == 0 || memcmp(m_Viewports, pViewports, NumViewports * sizeof(D3D11_VIEWPORT)) == 0);
+	m_nViewports = NumViewports;
+	if (NumViewports > 0)
+	{
+		memcpy(m_Viewports, pViewports, NumViewports * sizeof(D3D11_VIEWPORT));
+	}
+	RecordSetter("RSSetViewports", bRedundant);
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::RSSetScissorRects(UINT NumRects, const D3D11_RECT* pRects)
+{
+	UNREFERENCED_PARAMETER(NumRects);
+	UNREFERENCED_PARAMETER(pRects);
+	RecordSetter("RSSetScissorRects", false);
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::OMSetRenderTargets(UINT NumViews, ID3D11RenderTargetView* const* ppRenderTargetViews, ID3D11DepthStencilView* pDepthStencilView)
+{
+	bool bRedundant = m_pDepthStencilView == pDepthStencilView;
+	m_pDepthStencilView = pDepthStencilView;
+	for (UINT i = 0;i < D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT;++i)
+	{
+		void* pView = (ppRenderTargetViews && i < NumViews) ? ppRenderTargetViews[i] : nullptr;
+		if (m_pRenderTargets[i] != pView)
+		{
+			m_pRenderTargets[i] = pView;
+			bRedundant = false;
+		}
+	}
+	RecordSetter("OMSetRenderTargets", bRedundant);
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::OMSetRenderTargetsAndUnorderedAccessViews(UINT NumRTVs, ID3D11RenderTargetView* const* ppRenderTargetViews, ID3D11DepthStencilView* pDepthStencilView,
+	UINT UAVStartSlot, UINT NumUAVs, ID3D11UnorderedAccessView* const* ppUnorderedAccessViews, const UINT* pUAVInitialCounts)
+{
+	UNREFERENCED_PARAMETER(UAVStartSlot);
+	UNREFERENCED_PARAMETER(NumUAVs);
+	UNREFERENCED_PARAMETER(ppUnorderedAccessViews);
+	UNREFERENCED_PARAMETER(pUAVInitialCounts);
+	if (NumRTVs != D3D11_KEEP_RENDER_TARGETS_AND_DEPTH_STENCIL)
+	{
+		for (UINT i = 0;i < D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT;++i)
+		{
+			m_pRenderTargets[i] = (ppRenderTargetViews && i < NumRTVs) ? ppRenderTargetViews[i] : nullptr;
+		}
+		m_pDepthStencilView = pDepthStencilView;
+	}
+	RecordSetter("OMSetRenderTargetsAndUnorderedAccessViews", false);
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::OMSetBlendState(ID3D11BlendState* pBlendState, const FLOAT BlendFactor[4], UINT SampleMask)
+{
+	static const FLOAT fDefaultBlendFactor[4] = { 1.0f,1.0f,1.0f,1.0f };
+	const FLOAT* pfBlendFactor = BlendFactor ? BlendFactor : fDefaultBlendFactor;
+
+	bool bRedundant = m_pBlendState == pBlendState && m_uSampleMask == SampleMask && memcmp(m_fBlendFactor, pfBlendFactor, sizeof(m_fBlendFactor)) == 0;
+	m_pBlendState = pBlendState;
+	m_uSampleMask = SampleMask;
+	memcpy(m_fBlendFactor, pfBlendFactor, sizeof(m_fBlendFactor));
+	RecordSetter("OMSetBlendState", bRedundant);
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::OMSetDepthStencilState(ID3D11DepthStencilState* pDepthStencilState, UINT StencilRef)
+{
+	bool bRedundant = m_pDepthStencilState == pDepthStencilState && m_uStencilRef == StencilRef;
+	m_pDepthStencilState = pDepthStencilState;
+	m_uStencilRef = StencilRef;
+	RecordSetter("OMSetDepthStencilState", bRedundant);
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::SOSetTargets(UINT NumBuffers, ID3D11Buffer* const* ppSOTargets, const UINT* pOffsets)
+{
+	UNREFERENCED_PARAMETER(NumBuffers);
+	UNREFERENCED_PARAMETER(ppSOTargets);
+	UNREFERENCED_PARAMETER(pOffsets);
+	RecordSetter("SOSetTargets", false);
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::SetPredication(ID3D11Predicate* pPredicate, BOOL PredicateValue)
+{
+	UNREFERENCED_PARAMETER(pPredicate);
+	UNREFERENCED_PARAMETER(PredicateValue);
+	RecordSetter("SetPredication", false);
+}
+
+//--------------------------------------------------------------------------------------
+// Draws and dispatches
+//--------------------------------------------------------------------------------------
+void STDMETHODCALLTYPE RecordingDeviceContext::DrawIndexed(UINT IndexCount, UINT StartIndexLocation, INT BaseVertexLocation)
+{
+	UNREFERENCED_PARAMETER(StartIndexLocation);
+	UNREFERENCED_PARAMETER(BaseVertexLocation);
+	RecordDraw("DrawIndexed", IndexCount, 1);
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::Draw(UINT VertexCount, UINT StartVertexLocation)
+{
+	UNREFERENCED_PARAMETER(StartVertexLocation);
+	RecordDraw("Draw", VertexCount, 1);
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::DrawIndexedInstanced(UINT IndexCountPerInstance, UINT InstanceCount, UINT StartIndexLocation, INT BaseVertexLocation, UINT StartInstanceLocation)
+{
+	UNREFERENCED_PARAMETER(StartIndexLocation);
+	UNREFERENCED_PARAMETER(BaseVertexLocation);
+	UNREFERENCED_PARAMETER(StartInstanceLocation);
+	RecordDraw("DrawIndexedInstanced", IndexCountPerInstance, InstanceCount);
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::DrawInstanced(UINT VertexCountPerInstance, UINT InstanceCount, UINT StartVertexLocation, UINT StartInstanceLocation)
+{
+	UNREFERENCED_PARAMETER(StartVertexLocation);
+	UNREFERENCED_PARAMETER(StartInstanceLocation);
+	RecordDraw("DrawInstanced", VertexCountPerInstance, InstanceCount);
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::DrawAuto()
+{
+	RecordDraw("DrawAuto", 0, 1);
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::DrawIndexedInstancedIndirect(ID3D11Buffer* pBufferForArgs, UINT AlignedByteOffsetForArgs)
+{
+	UNREFERENCED_PARAMETER(pBufferForArgs);
+	UNREFERENCED_PARAMETER(AlignedByteOffsetForArgs);
+	RecordDraw("DrawIndexedInstancedIndirect", 0, 1);
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::DrawInstancedIndirect(ID3D11Buffer* pBufferForArgs, UINT AlignedByteOffsetForArgs)
+{
+	UNREFERENCED_PARAMETER(pBufferForArgs);
+	UNREFERENCED_PARAMETER(AlignedByteOffsetForArgs);
+	RecordDraw("DrawInstancedIndirect", 0, 1);
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::Dispatch(UINT ThreadGroupCountX, UINT ThreadGroupCountY, UINT ThreadGroupCountZ)
+{
+	Record(RECORDED_DISPATCH, "Dispatch").m_uCount = ThreadGroupCountX * ThreadGroupCountY * ThreadGroupCountZ;
+	++m_Stats.m_nDispatches;
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::DispatchIndirect(ID3D11Buffer* pBufferForArgs, UINT AlignedByteOffsetForArgs)
+{
+	UNREFERENCED_PARAMETER(pBufferForArgs);
+	UNREFERENCED_PARAMETER(AlignedByteOffsetForArgs);
+	Record(RECORDED_DISPATCH, "DispatchIndirect");
+	++m_Stats.m_nDispatches;
+}
+
+//--------------------------------------------------------------------------------------
+// Resource access
+//--------------------------------------------------------------------------------------
+HRESULT STDMETHODCALLTYPE RecordingDeviceContext::Map(ID3D11Resource* pResource, UINT Subresource, D3D11_MAP MapType, UINT MapFlags, D3D11_MAPPED_SUBRESOURCE* pMappedResource)
+{
+	UNREFERENCED_PARAMETER(MapFlags);
+
+	RecordedResource* pRecorded = dynamic_cast<RecordedResource*>(pResource);
+	UINT uRowPitch = 0;
+	UINT uDepthPitch = 0;
+	BYTE* pData = pRecorded ? pRecorded->GetSubresourceMemory(Subresource, &uRowPitch, &uDepthPitch) : nullptr;
+	if (!pData || !pMappedResource)
+	{
+		return E_INVALIDARG;
+	}
+
+	// Deferred contexts can only write dynamic resources.
+	if (m_eType == D3D11_DEVICE_CONTEXT_DEFERRED)
+	{
+		if (MapType != D3D11_MAP_WRITE_DISCARD && MapType != D3D11_MAP_WRITE_NO_OVERWRITE)
+		{
+			return E_INVALIDARG;
+		}
+		if (MapType == D3D11_MAP_WRITE_DISCARD)
+		{
+			m_DeferredMapMemory.push_back(std::vector<BYTE>((size_t)pRecorded->GetSubresourceBytes(Subresource)));
+			pData = m_DeferredMapMemory.back().data();
+		}
+	}
+
+	RecordedCommand& Command = Record(RECORDED_MAP, "Map");
+	Command.m_eMapType = MapType;
+	++m_Stats.m_nMaps;
+
+	// A NO_OVERWRITE map uploads what the caller writes,which Unmap finds in a marked copy.
+	if (MapType == D3D11_MAP_WRITE_NO_OVERWRITE)
+	{
+		NoOverwriteMap NoOverwrite;
+		NoOverwrite.m_pResource = pResource;
+		NoOverwrite.m_uSubresource = Subresource;
+		NoOverwrite.m_pData = m_eType == D3D11_DEVICE_CONTEXT_DEFERRED ? nullptr : pData;
+		NoOverwrite.m_uCommand = m_Commands.size() - 1;
+		NoOverwrite.m_Written.assign((size_t)pRecorded->GetSubresourceBytes(Subresource), (BYTE)RECORDED_UNWRITTEN_BYTE);
+		m_NoOverwriteMaps.push_back(std::move(NoOverwrite));
+		pData = m_NoOverwriteMaps.back().m_Written.data();
+	}
+	// Any other written map uploads the whole subresource,whatever the caller writes of it.
+	else if (MapType != D3D11_MAP_READ)
+	{
+		Command.m_uCount = (UINT)pRecorded->GetSubresourceBytes(Subresource);
+		m_Stats.m_uBytesUploaded += Command.m_uCount;
+	}
+
+	pMappedResource->pData = pData;
+	pMappedResource->RowPitch = uRowPitch;
+	pMappedResource->DepthPitch = uDepthPitch;
+	return S_OK;
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::Unmap(ID3D11Resource* pResource, UINT Subresource)
+{
+	Record(RECORDED_OTHER, "Unmap");
+
+	for (size_t iMap = 0; iMap < m_NoOverwriteMaps.size(); ++iMap)
+	{
+		NoOverwriteMap& NoOverwrite = m_NoOverwriteMaps[iMap];
+		if (NoOverwrite.m_pResource != pResource || NoOverwrite.m_uSubresource != Subresource)
+		{
+			continue;
+		}
+
+		// Charge each 16 byte constant the caller wrote any byte of,and write back only the bytes it wrote.
+		UINT uBytes = 0;
+		for (size_t uConstant = 0; uConstant < NoOverwrite.m_Written.size(); uConstant += 16)
+		{
+			size_t uEnd = (std::min)(uConstant + 16, NoOverwrite.m_Written.size());
+			bool bWritten = false;
+			for (size_t uByte = uConstant; uByte < uEnd; ++uByte)
+			{
+				if (NoOverwrite.m_Written[uByte] != (BYTE)RECORDED_UNWRITTEN_BYTE)
+				{
+					bWritten = true;
+					if (NoOverwrite.m_pData)
+					{
+						NoOverwrite.m_pData[uByte] = NoOverwrite.m_Written[uByte];
+					}
+				}
+			}
+			uBytes += bWritten ? (UINT)(uEnd - uConstant) : 0;
+		}
+
+		// The recording may have been reset while the resource was mapped.
+		if (NoOverwrite.m_uCommand < m_Commands.size() && m_Commands[NoOverwrite.m_uCommand].m_eType == RECORDED_MAP)
+		{
+			m_Commands[NoOverwrite.m_uCommand].m_uCount = uBytes;
+		}
+		m_Stats.m_uBytesUploaded += uBytes;
+		m_NoOverwriteMaps.erase(m_NoOverwriteMaps.begin() + iMap);
+		break;
+	}
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::UpdateSubresource(ID3D11Resource* pDstResource, UINT DstSubresource, const D3D11_BOX* pDstBox,
+	const void* pSrcData, UINT SrcRowPitch, UINT SrcDepthPitch)
+{
+	RecordedResource* pRecorded = dynamic_cast<RecordedResource*>(pDstResource);
+	D3D11_RESOURCE_DIMENSION eDimension;
+	pDstResource->GetType(&eDimension);
+
+	UINT64 uBytes = 0;
+	if (!pDstBox)
+	{
+		uBytes = pRecorded ? pRecorded->GetSubresourceBytes(DstSubresource) : 0;
+	}
+	else if (eDimension == D3D11_RESOURCE_DIMENSION_BUFFER)
+	{
+		uBytes = pDstBox->right - pDstBox->left;
+	}
+	else if (pDstBox->back - pDstBox->front > 1)
+	{
+		uBytes = (UINT64)SrcDepthPitch * (pDstBox->back - pDstBox->front);
+	}
+	else
+	{
+		uBytes = (UINT64)SrcRowPitch * (pDstBox->bottom - pDstBox->top);
+	}
+
+	// Buffers the CPU can also map keep what was written.
+	UINT uRowPitch, uDepthPitch;
+	BYTE* pData = pRecorded ? pRecorded->GetSubresourceMemory(DstSubresource, &uRowPitch, &uDepthPitch) : nullptr;
+	if (pData && pSrcData && eDimension == D3D11_RESOURCE_DIMENSION_BUFFER)
+	{
+		memcpy(pData + (pDstBox ? pDstBox->left : 0), pSrcData, (size_t)uBytes);
+	}
+
+	Record(RECORDED_UPDATE_SUBRESOURCE, "UpdateSubresource").m_uCount = (UINT)uBytes;
+	m_Stats.m_uBytesUploaded += uBytes;
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::CopySubresourceRegion(ID3D11Resource* pDstResource, UINT DstSubresource, UINT DstX, UINT DstY, UINT DstZ,
+	ID3D11Resource* pSrcResource, UINT SrcSubresource, const D3D11_BOX* pSrcBox)
+{
+	UNREFERENCED_PARAMETER(pDstResource);
+	UNREFERENCED_PARAMETER(DstSubresource);
+	UNREFERENCED_PARAMETER(DstX);
+	UNREFERENCED_PARAMETER(DstY);
+	UNREFERENCED_PARAMETER(DstZ);
+
+	RecordedResource* pRecorded = dynamic_cast<RecordedResource*>(pSrcResource);
+	D3D11_RESOURCE_DIMENSION eDimension;
+	pSrcResource->GetType(&eDimension);
+	UINT64 uBytes = pRecorded ? pRecorded->GetSubresourceBytes(SrcSubresource) : 0;
+	if (pSrcBox && eDimension == D3D11_RESOURCE_DIMENSION_BUFFER)
+	{
+		uBytes = pSrcBox->right - pSrcBox->left;
+	}
+
+	Record(RECORDED_COPY, "CopySubresourceRegion").m_uCount = (UINT)uBytes;
+	m_Stats.m_uBytesCopied += uBytes;
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::CopyResource(ID3D11Resource* pDstResource, ID3D11Resource* pSrcResource)
+{
+	RecordedResource* pDst = dynamic_cast<RecordedResource*>(pDstResource);
+	RecordedResource* pSrc = dynamic_cast<RecordedResource*>(pSrcResource);
+
+	UINT64 uBytes = 0;
+	for (UINT i = 0;pDst && pSrc && i < pSrc->GetSubresourceCount();++i)
+	{
+		uBytes += pSrc->GetSubresourceBytes(i);
+
+		// Contents only move between resources that both have system memory.
+		UINT uRowPitch, uDepthPitch;
+		BYTE* pDstData = pDst->GetSubresourceMemory(i, &uRowPitch, &uDepthPitch);
+		BYTE* pSrcData = pSrc->GetSubresourceMemory(i, &uRowPitch, &uDepthPitch);
+		if (pDstData && pSrcData && pDst->GetSubresourceBytes(i) == pSrc->GetSubresourceBytes(i))
+		{
+			memcpy(pDstData, pSrcData, (size_t)pSrc->GetSubresourceBytes(i));
+		}
+	}
+
+	Record(RECORDED_COPY, "CopyResource").m_uCount = (UINT)uBytes;
+	m_Stats.m_uBytesCopied += uBytes;
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::CopyStructureCount(ID3D11Buffer* pDstBuffer, UINT DstAlignedByteOffset, ID3D11UnorderedAccessView* pSrcView)
+{
+	UNREFERENCED_PARAMETER(pDstBuffer);
+	UNREFERENCED_PARAMETER(DstAlignedByteOffset);
+	UNREFERENCED_PARAMETER(pSrcView);
+	Record(RECORDED_COPY, "CopyStructureCount").m_uCount = sizeof(UINT);
+	m_Stats.m_uBytesCopied += sizeof(UINT);
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::ResolveSubresource(ID3D11Resource* pDstResource, UINT DstSubresource, ID3D11Resource* pSrcResource, UINT SrcSubresource, DXGI_FORMAT Format)
+{
+	UNREFERENCED_PARAMETER(pDstResource);
+	UNREFERENCED_PARAMETER(pSrcResource);
+	UNREFERENCED_PARAMETER(SrcSubresource);
+	UNREFERENCED_PARAMETER(Format);
+	RecordedResource* pRecorded = dynamic_cast<RecordedResource*>(pDstResource);
+	UINT64 uBytes = pRecorded ? pRecorded->GetSubresourceBytes(DstSubresource) : 0;
+	Record(RECORDED_COPY, "ResolveSubresource").m_uCount = (UINT)uBytes;
+	m_Stats.m_uBytesCopied += uBytes;
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::ClearRenderTargetView(ID3D11RenderTargetView* pRenderTargetView, const FLOAT ColorRGBA[4])
+{
+	UNREFERENCED_PARAMETER(pRenderTargetView);
+	UNREFERENCED_PARAMETER(ColorRGBA);
+	Record(RECORDED_CLEAR, "ClearRenderTargetView");
+	++m_Stats.m_nClears;
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::ClearUnorderedAccessViewUint(ID3D11UnorderedAccessView* pUnorderedAccessView, const UINT Values[4])
+{
+	UNREFERENCED_PARAMETER(pUnorderedAccessView);
+	UNREFERENCED_PARAMETER(Values);
+	Record(RECORDED_CLEAR, "ClearUnorderedAccessViewUint");
+	++m_Stats.m_nClears;
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::ClearUnorderedAccessViewFloat(ID3D11UnorderedAccessView* pUnorderedAccessView, const FLOAT Values[4])
+{
+	UNREFERENCED_PARAMETER(pUnorderedAccessView);
+	UNREFERENCED_PARAMETER(Values);
+	Record(RECORDED_CLEAR, "ClearUnorderedAccessViewFloat");
+	++m_Stats.m_nClears;
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::ClearDepthStencilView(ID3D11DepthStencilView* pDepthStencilView, UINT ClearFlags, FLOAT Depth, UINT8 Stencil)
+{
+	UNREFERENCED_PARAMETER(pDepthStencilView);
+	UNREFERENCED_PARAMETER(ClearFlags);
+	UNREFERENCED_PARAMETER(Depth);
+	UNREFERENCED_PARAMETER(Stencil);
+	Record(RECORDED_CLEAR, "ClearDepthStencilView");
+	++m_Stats.m_nClears;
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::GenerateMips(ID3D11ShaderResourceView* pShaderResourceView)
+{
+	UNREFERENCED_PARAMETER(pShaderResourceView);
+	Record(RECORDED_OTHER, "GenerateMips");
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::SetResourceMinLOD(ID3D11Resource* pResource, FLOAT MinLOD)
+{
+	UNREFERENCED_PARAMETER(pResource);
+	UNREFERENCED_PARAMETER(MinLOD);
+	Record(RECORDED_OTHER, "SetResourceMinLOD");
+}
+
+FLOAT STDMETHODCALLTYPE RecordingDeviceContext::GetResourceMinLOD(ID3D11Resource* pResource)
+{
+	UNREFERENCED_PARAMETER(pResource);
+	return 0.0f;
+}
+
+//--------------------------------------------------------------------------------------
+// Queries,command lists and the rest
+//--------------------------------------------------------------------------------------
+void STDMETHODCALLTYPE RecordingDeviceContext::Begin(ID3D11Asynchronous* pAsync)
+{
+	UNREFERENCED_PARAMETER(pAsync);
+	Record(RECORDED_OTHER, "Begin");
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::End(ID3D11Asynchronous* pAsync)
+{
+	UNREFERENCED_PARAMETER(pAsync);
+	Record(RECORDED_OTHER, "End");
+}
+
+HRESULT STDMETHODCALLTYPE RecordingDeviceContext::GetData(ID3D11Asynchronous* pAsync, void* pData, UINT DataSize, UINT GetDataFlags)
+{
+	UNREFERENCED_PARAMETER(pAsync);
+	UNREFERENCED_PARAMETER(pData);
+	UNREFERENCED_PARAMETER(DataSize);
+	UNREFERENCED_PARAMETER(GetDataFlags);
+	return DXGI_ERROR_INVALID_CALL; // The device creates no queries
+}
+
+// The commands of the list follow in the stream,as they would run on the GPU.
+void STDMETHODCALLTYPE RecordingDeviceContext::ExecuteCommandList(ID3D11CommandList* pCommandList, BOOL RestoreContextState)
+{
+	Record(RECORDED_OTHER, "ExecuteCommandList");
+
+	RecordingCommandList* pRecorded = dynamic_cast<RecordingCommandList*>(pCommandList);
+	if (pRecorded)
+	{
+		m_Commands.insert(m_Commands.end(), pRecorded->GetCommands().begin(), pRecorded->GetCommands().end());
+		AddStats(pRecorded->GetStats());
+	}
+
+	// Without RestoreContextState the context is left as ClearState leaves it.
+	if (!RestoreContextState)
+	{
+		ResetBoundState();
+	}
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::ClearState()
+{
+	ResetBoundState();
+	Record(RECORDED_OTHER, "ClearState");
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::Flush()
+{
+	Record(RECORDED_OTHER, "Flush");
+}
+
+D3D11_DEVICE_CONTEXT_TYPE STDMETHODCALLTYPE RecordingDeviceContext::GetType()
+{
+	return m_eType;
+}
+
+UINT STDMETHODCALLTYPE RecordingDeviceContext::GetContextFlags()
+{
+	return 0;
+}
+
+HRESULT STDMETHODCALLTYPE RecordingDeviceContext::FinishCommandList(BOOL RestoreDeferredContextState, ID3D11CommandList** ppCommandList)
+{
+	if (!ppCommandList)
+	{
+		return E_INVALIDARG;
+	}
+	*ppCommandList = nullptr;
+
+	if (m_eType != D3D11_DEVICE_CONTEXT_DEFERRED)
+	{
+		return DXGI_ERROR_INVALID_CALL;
+	}
+
+	*ppCommandList = new RecordingCommandList(m_pDevice, m_Commands, m_Stats);
+	ResetRecording();
+	m_DeferredMapMemory.clear();
+	if (!RestoreDeferredContextState)
+	{
+		ResetBoundState();
+	}
+	return S_OK;
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::IAGetInputLayout(ID3D11InputLayout** ppInputLayout)
+{
+	ZeroPointers(ppInputLayout, 1);
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::IAGetVertexBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer** ppVertexBuffers, UINT* pStrides, UINT* pOffsets)
+{
+	UNREFERENCED_PARAMETER(StartSlot);
+	ZeroPointers(ppVertexBuffers, NumBuffers);
+	for (UINT i = 0;i < NumBuffers;++i)
+	{
+		if (pStrides)
+		{
+			pStrides[i] = 0;
+		}
+		if (pOffsets)
+		{
+			pOffsets[i] = 0;
+		}
+	}
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::IAGetIndexBuffer(ID3D11Buffer** pIndexBuffer, DXGI_FORMAT* Format, UINT* Offset)
+{
+	ZeroPointers(pIndexBuffer, 1);
+	if (Format)
+	{
+		*Format = DXGI_FORMAT_UNKNOWN;
+	}
+	if (Offset)
+	{
+		*Offset = 0;
+	}
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::IAGetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY* pTopology)
+{
+	*pTopology = D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED;
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::GetPredication(ID3D11Predicate** ppPredicate, BOOL* pPredicateValue)
+{
+	ZeroPointers(ppPredicate, 1);
+	if (pPredicateValue)
+	{
+		*pPredicateValue = FALSE;
+	}
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::OMGetRenderTargets(UINT NumViews, ID3D11RenderTargetView** ppRenderTargetViews, ID3D11DepthStencilView** ppDepthStencilView)
+{
+	ZeroPointers(ppRenderTargetViews, NumViews);
+	ZeroPointers(ppDepthStencilView, 1);
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::OMGetRenderTargetsAndUnorderedAccessViews(UINT NumRTVs, ID3D11RenderTargetView** ppRenderTargetViews, ID3D11DepthStencilView** ppDepthStencilView,
+	UINT UAVStartSlot, UINT NumUAVs, ID3D11UnorderedAccessView** ppUnorderedAccessViews)
+{
+	UNREFERENCED_PARAMETER(UAVStartSlot);
+	ZeroPointers(ppRenderTargetViews, NumRTVs);
+	ZeroPointers(ppDepthStencilView, 1);
+	ZeroPointers(ppUnorderedAccessViews, NumUAVs);
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::OMGetBlendState(ID3D11BlendState** ppBlendState, FLOAT BlendFactor[4], UINT* pSampleMask)
+{
+	ZeroPointers(ppBlendState, 1);
+	for (INT i = 0;BlendFactor && i < 4;++i)
+	{
+		BlendFactor[i] = 1.0f;
+	}
+	if (pSampleMask)
+	{
+		*pSampleMask = 0xffffffff;
+	}
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::OMGetDepthStencilState(ID3D11DepthStencilState** ppDepthStencilState, UINT* pStencilRef)
+{
+	ZeroPointers(ppDepthStencilState, 1);
+	if (pStencilRef)
+	{
+		*pStencilRef = 0;
+	}
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::SOGetTargets(UINT NumBuffers, ID3D11Buffer** ppSOTargets)
+{
+	ZeroPointers(ppSOTargets, NumBuffers);
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::RSGetState(ID3D11RasterizerState** ppRasterizerState)
+{
+	ZeroPointers(ppRasterizerState, 1);
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::RSGetViewports(UINT* pNumViewports, D3D11_VIEWPORT* pViewports)
+{
+	UNREFERENCED_PARAMETER(pViewports);
+	*pNumViewports = 0;
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::RSGetScissorRects(UINT* pNumRects, D3D11_RECT* pRects)
+{
+	UNREFERENCED_PARAMETER(pRects);
+	*pNumRects = 0;
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::CSGetUnorderedAccessViews(UINT StartSlot, UINT NumUAVs, ID3D11UnorderedAccessView** ppUnorderedAccessViews)
+{
+	UNREFERENCED_PARAMETER(StartSlot);
+	ZeroPointers(ppUnorderedAccessViews, NumUAVs);
+}
+
+//--------------------------------------------------------------------------------------
+// ID3D11DeviceContext1,the constant buffer setters are with the shader stages
+//--------------------------------------------------------------------------------------
+void STDMETHODCALLTYPE RecordingDeviceContext::CopySubresourceRegion1(ID3D11Resource* pDstResource, UINT DstSubresource, UINT DstX, UINT DstY, UINT DstZ,
+	ID3D11Resource* pSrcResource, UINT SrcSubresource, const D3D11_BOX* pSrcBox, UINT CopyFlags)
+{
+	UNREFERENCED_PARAMETER(CopyFlags);
+	CopySubresourceRegion(pDstResource, DstSubresource, DstX, DstY, DstZ, pSrcResource, SrcSubresource, pSrcBox);
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::UpdateSubresource1(ID3D11Resource* pDstResource, UINT DstSubresource, const D3D11_BOX* pDstBox,
+	const void* pSrcData, UINT SrcRowPitch, UINT SrcDepthPitch, UINT CopyFlags)
+{
+	UNREFERENCED_PARAMETER(CopyFlags);
+	UpdateSubresource(pDstResource, DstSubresource, pDstBox, pSrcData, SrcRowPitch, SrcDepthPitch);
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::DiscardResource(ID3D11Resource* pResource)
+{
+	UNREFERENCED_PARAMETER(pResource);
+	Record(RECORDED_OTHER, "DiscardResource");
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::DiscardView(ID3D11View* pResourceView)
+{
+	UNREFERENCED_PARAMETER(pResourceView);
+	Record(RECORDED_OTHER, "DiscardView");
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::DiscardView1(ID3D11View* pResourceView, const D3D11_RECT* pRects, UINT NumRects)
+{
+	UNREFERENCED_PARAMETER(pResourceView);
+	UNREFERENCED_PARAMETER(pRects);
+	UNREFERENCED_PARAMETER(NumRects);
+	Record(RECORDED_OTHER, "DiscardView1");
+}
+
+void STDMETHODCALLTYPE RecordingDeviceContext::ClearView(ID3D11View* pView, const FLOAT Color[4], const D3D11_RECT* pRect, UINT NumRects)
+{
+	UNREFERENCED_PARAMETER(pView);
+	UNREFERENCED_PARAMETER(Color);
+	UNREFERENCED_PARAMETER(pRect);
+	UNREFERENCED_PARAMETER(NumRects);
+	Record(RECORDED_CLEAR, "ClearView");
+	++m_Stats.m_nClears;
+}
+
+// The device creates no context state objects,so there is none to swap in.
+void STDMETHODCALLTYPE RecordingDeviceContext::SwapDeviceContextState(ID3DDeviceContextState* pState, ID3DDeviceContextState** ppPreviousState)
+{
+	UNREFERENCED_PARAMETER(pState);
+	ZeroPointers(ppPreviousState, 1);
+}
+
+
+//--------------------------------------------------------------------------------------
+// RecordingDevice
+//--------------------------------------------------------------------------------------
+#pragma warning(push)
+#pragma warning(disable:4355) // The context only keeps the pointer
+RecordingDevice::RecordingDevice() :
+	m_ImmediateContext(this, D3D11_DEVICE_CONTEXT_IMMEDIATE),
+	m_uRefCount(1),
+	m_bConstantBufferOffsetting(false),
+	m_nLiveObjects(0),
+	m_nCreatedObjects(0),
+	m_uLiveResourceBytes(0)
+{
+}
+#pragma warning(pop)
+
+void RecordingDevice::OnObjectCreated(UINT64 uResourceBytes)
+{
+	++m_nLiveObjects;
+	++m_nCreatedObjects;
+	m_uLiveResourceBytes += uResourceBytes;
+}
+
+void RecordingDevice::OnObjectDestroyed(UINT64 uResourceBytes)
+{
+	--m_nLiveObjects;
+	m_uLiveResourceBytes -= uResourceBytes;
+}
+
+HRESULT STDMETHODCALLTYPE RecordingDevice::QueryInterface(REFIID riid, void** ppvObject)
+{
+	if (!ppvObject)
+	{
+		return E_POINTER;
+	}
+
+	if (riid == __uuidof(ID3D11Device) || riid == __uuidof(IUnknown))
+	{
+		*ppvObject = static_cast<ID3D11Device*>(this);
+		AddRef();
+		return S_OK;
+	}
+
+	*ppvObject = nullptr;
+	return E_NOINTERFACE;
+}
+
+ULONG STDMETHODCALLTYPE RecordingDevice::AddRef()
+{
+	return ++m_uRefCount;
+}
+
+ULONG STDMETHODCALLTYPE RecordingDevice::Release()
+{
+	return --m_uRefCount;
+}
+
+HRESULT STDMETHODCALLTYPE RecordingDevice::CreateBuffer(const D3D11_BUFFER_DESC* pDesc, const D3D11_SUBRESOURCE_DATA* pInitialData, ID3D11Buffer** ppBuffer)
+{
+	if (!pDesc || pDesc->ByteWidth == 0)
+	{
+		return E_INVALIDARG;
+	}
+	if (!ppBuffer)
+	{
+		return S_FALSE;
+	}
+	*ppBuffer = new RecordingBuffer(this, *pDesc, pInitialData);
+	return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE RecordingDevice::CreateTexture1D(const D3D11_TEXTURE1D_DESC* pDesc, const D3D11_SUBRESOURCE_DATA* pInitialData, ID3D11Texture1D** ppTexture1D)
+{
+	if (!pDesc)
+	{
+		return E_INVALIDARG;
+	}
+	if (!ppTexture1D)
+	{
+		return S_FALSE;
+	}
+	*ppTexture1D = new RecordingTexture1D(this, *pDesc, pInitialData);
+	return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE RecordingDevice::CreateTexture2D(const D3D11_TEXTURE2D_DESC* pDesc, const D3D11_SUBRESOURCE_DATA* pInitialData, ID3D11Texture2D** ppTexture2D)
+{
+	if (!pDesc)
+	{
+		return E_INVALIDARG;
+	}
+	if (!ppTexture2D)
+	{
+		return S_FALSE;
+	}
+	*ppTexture2D = new RecordingTexture2D(this, *pDesc, pInitialData);
+	return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE RecordingDevice::CreateTexture3D(const D3D11_TEXTURE3D_DESC* pDesc, const D3D11_SUBRESOURCE_DATA* pInitialData, ID3D11Texture3D** ppTexture3D)
+{
+	if (!pDesc)
+	{
+		return E_INVALIDARG;
+	}
+	if (!ppTexture3D)
+	{
+		return S_FALSE;
+	}
+	*ppTexture3D = new RecordingTexture3D(this, *pDesc, pInitialData);
+	return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE RecordingDevice::CreateShaderResourceView(ID3D11Resource* pResource, const D3D11_SHADER_RESOURCE_VIEW_DESC* pDesc, ID3D11ShaderResourceView** ppSRView)
+{
+	if (!pResource)
+	{
+		return E_INVALIDARG;
+	}
+	if (!ppSRView)
+	{
+		return S_FALSE;
+	}
+	*ppSRView = new RecordingView<ID3D11ShaderResourceView, D3D11_SHADER_RESOURCE_VIEW_DESC>(this, pResource, pDesc);
+	return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE RecordingDevice::CreateUnorderedAccessView(ID3D11Resource* pResource, const D3D11_UNORDERED_ACCESS_VIEW_DESC* pDesc, ID3D11UnorderedAccessView** ppUAView)
+{
+	if (!pResource)
+	{
+		return E_INVALIDARG;
+	}
+	if (!ppUAView)
+	{
+		return S_FALSE;
+	}
+	*ppUAView = new RecordingView<ID3D11UnorderedAccessView, D3D11_UNORDERED_ACCESS_VIEW_DESC>(this, pResource, pDesc);
+	return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE RecordingDevice::CreateRenderTargetView(ID3D11Resource* pResource, const D3D11_RENDER_TARGET_VIEW_DESC* pDesc, ID3D11RenderTargetView** ppRTView)
+{
+	if (!pResource)
+	{
+		return E_INVALIDARG;
+	}
+	if (!ppRTView)
+	{
+		return S_FALSE;
+	}
+	*ppRTView = new RecordingView<ID3D11RenderTargetView, D3D11_RENDER_TARGET_VIEW_DESC>(this, pResource, pDesc);
+	return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE RecordingDevice::CreateDepthStencilView(ID3D11Resource* pResource, const D3D11_DEPTH_STENCIL_VIEW_DESC* pDesc, ID3D11DepthStencilView** ppDepthStencilView)
+{
+	if (!pResource)
+	{
+		return E_INVALIDARG;
+	}
+	if (!ppDepthStencilView)
+	{
+		return S_FALSE;
+	}
+	*ppDepthStencilView = new RecordingView<ID3D11DepthStencilView, D3D11_DEPTH_STENCIL_VIEW_DESC>(this, pResource, pDesc);
+	return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE RecordingDevice::CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* pInputElementDescs, UINT NumElements, const void* pShaderBytecodeWithInputSignature,
+	SIZE_T BytecodeLength, ID3D11InputLayout** ppInputLayout)
+{
+	UNREFERENCED_PARAMETER(pShaderBytecodeWithInputSignature);
+	UNREFERENCED_PARAMETER(BytecodeLength);
+	if (!pInputElementDescs || NumElements == 0)
+	{
+		return E_INVALIDARG;
+	}
+	if (!ppInputLayout)
+	{
+		return S_FALSE;
+	}
+	*ppInputLayout = new RecordingDeviceChild<ID3D11InputLayout>(this, 0);
+	return S_OK;
+}
+
+// Shaders are compiled for real by the caller,the device only hands out objects to bind.
+#define RECORDING_CREATE_SHADER(Stage, ShaderInterface) \
+HRESULT STDMETHODCALLTYPE RecordingDevice::Create##Stage##Shader(const void* pShaderBytecode, SIZE_T BytecodeLength, ID3D11ClassLinkage* pClassLinkage, ShaderInterface** ppShader) \
+{ \
+	UNREFERENCED_PARAMETER(pClassLinkage); \
+	if (!pShaderBytecode || BytecodeLength == 0) \
+	{ \
+		return E_INVALIDARG; \
+	} \
+	if (!ppShader) \
+	{ \
+		return S_FALSE; \
+	} \
+	*ppShader = new RecordingDeviceChild<ShaderInterface>(this, 0); \
+	return S_OK; \
+}
+
+RECORDING_CREATE_SHADER(Vertex, ID3D11VertexShader)
+RECORDING_CREATE_SHADER(Hull, ID3D11HullShader)
+RECORDING_CREATE_SHADER(Domain, ID3D11DomainShader)
+RECORDING_CREATE_SHADER(Geometry, ID3D11GeometryShader)
+RECORDING_CREATE_SHADER(Pixel, ID3D11PixelShader)
+RECORDING_CREATE_SHADER(Compute, ID3D11ComputeShader)
+
+#undef RECORDING_CREATE_SHADER
+
+HRESULT STDMETHODCALLTYPE RecordingDevice::CreateGeometryShaderWithStreamOutput(const void* pShaderBytecode, SIZE_T BytecodeLength, const D3D11_SO_DECLARATION_ENTRY* pSODeclaration,
+	UINT NumEntries, const UINT* pBufferStrides, UINT NumStrides, UINT RasterizedStream, ID3D11ClassLinkage* pClassLinkage, ID3D11GeometryShader** ppGeometryShader)
+{
+	UNREFERENCED_PARAMETER(pSODeclaration);
+	UNREFERENCED_PARAMETER(NumEntries);
+	UNREFERENCED_PARAMETER(pBufferStrides);
+	UNREFERENCED_PARAMETER(NumStrides);
+	UNREFERENCED_PARAMETER(RasterizedStream);
+	return CreateGeometryShader(pShaderBytecode, BytecodeLength, pClassLinkage, ppGeometryShader);
+}
+
+HRESULT STDMETHODCALLTYPE RecordingDevice::CreateClassLinkage(ID3D11ClassLinkage** ppLinkage)
+{
+	UNREFERENCED_PARAMETER(ppLinkage);
+	return E_NOTIMPL;
+}
+
+HRESULT STDMETHODCALLTYPE RecordingDevice::CreateBlendState(const D3D11_BLEND_DESC* pBlendStateDesc, ID3D11BlendState** ppBlendState)
+{
+	if (!pBlendStateDesc)
+	{
+		return E_INVALIDARG;
+	}
+	if (!ppBlendState)
+	{
+		return S_FALSE;
+	}
+	*ppBlendState = new RecordingState<ID3D11BlendState, D3D11_BLEND_DESC>(this, *pBlendStateDesc);
+	return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE RecordingDevice::CreateDepthStencilState(const D3D11_DEPTH_STENCIL_DESC* pDepthStencilDesc, ID3D11DepthStencilState** ppDepthStencilState)
+{
+	if (!pDepthStencilDesc)
+	{
+		return E_INVALIDARG;
+	}
+	if (!ppDepthStencilState)
+	{
+		return S_FALSE;
+	}
+	*ppDepthStencilState = new RecordingState<ID3D11DepthStencilState, D3D11_DEPTH_STENCIL_DESC>(this, *pDepthStencilDesc);
+	return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE RecordingDevice::CreateRasterizerState(const D3D11_RASTERIZER_DESC* pRasterizerDesc, ID3D11RasterizerState** ppRasterizerState)
+{
+	if (!pRasterizerDesc)
+	{
+		return E_INVALIDARG;
+	}
+	if (!ppRasterizerState)
+	{
+		return S_FALSE;
+	}
+	*ppRasterizerState = new RecordingState<ID3D11RasterizerState, D3D11_RASTERIZER_DESC>(this, *pRasterizerDesc);
+	return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE RecordingDevice::CreateSamplerState(const D3D11_SAMPLER_DESC* pSamplerDesc, ID3D11SamplerState** ppSamplerState)
+{
+	if (!pSamplerDesc)
+	{
+		return E_INVALIDARG;
+	}
+	if (!ppSamplerState)
+	{
+		return S_FALSE;
+	}
+	*ppSamplerState = new RecordingState<ID3D11SamplerState, D3D11_SAMPLER_DESC>(this, *pSamplerDesc);
+	return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE RecordingDevice::CreateQuery(const D3D11_QUERY_DESC* pQueryDesc, ID3D11Query** ppQuery)
+{
+	UNREFERENCED_PARAMETER(pQueryDesc);
+	UNREFERENCED_PARAMETER(ppQuery);
+	return E_NOTIMPL;
+}
+
+HRESULT STDMETHODCALLTYPE RecordingDevice::CreatePredicate(const D3D11_QUERY_DESC* pPredicateDesc, ID3D11Predicate** ppPredicate)
+{
+	UNREFERENCED_PARAMETER(pPredicateDesc);
+	UNREFERENCED_PARAMETER(ppPredicate);
+	return E_NOTIMPL;
+}
+
+HRESULT STDMETHODCALLTYPE RecordingDevice::CreateCounter(const D3D11_COUNTER_DESC* pCounterDesc, ID3D11Counter** ppCounter)
+{
+	UNREFERENCED_PARAMETER(pCounterDesc);
+	UNREFERENCED_PARAMETER(ppCounter);
+	return E_NOTIMPL;
+}
+
+HRESULT STDMETHODCALLTYPE RecordingDevice::CreateDeferredContext(UINT ContextFlags, ID3D11DeviceContext** ppDeferredContext)
+{
+	UNREFERENCED_PARAMETER(ContextFlags);
+	if (!ppDeferredContext)
+	{
+		return S_FALSE;
+	}
+	*ppDeferredContext = new RecordingDeviceContext(this, D3D11_DEVICE_CONTEXT_DEFERRED);
+	return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE RecordingDevice::OpenSharedResource(HANDLE hResource, REFIID ReturnedInterface, void** ppResource)
+{
+	UNREFERENCED_PARAMETER(hResource);
+	UNREFERENCED_PARAMETER(ReturnedInterface);
+	UNREFERENCED_PARAMETER(ppResource);
+	return E_NOTIMPL;
+}
+
+// Every format is reported as supported,the device never renders with them.
+HRESULT STDMETHODCALLTYPE RecordingDevice::CheckFormatSupport(DXGI_FORMAT Format, UINT* pFormatSupport)
+{
+	UNREFERENCED_PARAMETER(Format);
+	*pFormatSupport = 0xffffffff;
+	return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE RecordingDevice::CheckMultisampleQualityLevels(DXGI_FORMAT Format, UINT SampleCount, UINT* pNumQualityLevels)
+{
+	UNREFERENCED_PARAMETER(Format);
+	*pNumQualityLevels = SampleCount == 1 ? 1 : 0;
+	return S_OK;
+}
+
+void STDMETHODCALLTYPE RecordingDevice::CheckCounterInfo(D3D11_COUNTER_INFO* pCounterInfo)
+{
+	memset(pCounterInfo, 0, sizeof(D3D11_COUNTER_INFO));
+}
+
+HRESULT STDMETHODCALLTYPE RecordingDevice::CheckCounter(const D3D11_COUNTER_DESC* pDesc, D3D11_COUNTER_TYPE* pType, UINT* pActiveCounters, LPSTR szName, UINT* pNameLength,
+	LPSTR szUnits, UINT* pUnitsLength, LPSTR szDescription, UINT* pDescriptionLength)
+{
+	UNREFERENCED_PARAMETER(pDesc);
+	UNREFERENCED_PARAMETER(pType);
+	UNREFERENCED_PARAMETER(pActiveCounters);
+	UNREFERENCED_PARAMETER(szName);
+	UNREFERENCED_PARAMETER(pNameLength);
+	UNREFERENCED_PARAMETER(szUnits);
+	UNREFERENCED_PARAMETER(pUnitsLength);
+	UNREFERENCED_PARAMETER(szDescription);
+	UNREFERENCED_PARAMETER(pDescriptionLength);
+	return E_NOTIMPL;
+}
+
+// Optional features are all reported as missing,but for the constant buffer offsetting when it was asked for.
+HRESULT STDMETHODCALLTYPE RecordingDevice::CheckFeatureSupport(D3D11_FEATURE Feature, void* pFeatureSupportData, UINT FeatureSupportDataSize)
+{
+	memset(pFeatureSupportData, 0, FeatureSupportDataSize);
+	if (Feature == D3D11_FEATURE_D3D11_OPTIONS && FeatureSupportDataSize == sizeof(D3D11_FEATURE_DATA_D3D11_OPTIONS))
+	{
+		D3D11_FEATURE_DATA_D3D11_OPTIONS* pOptions = (D3D11_FEATURE_DATA_D3D11_OPTIONS*)pFeatureSupportData;
+		pOptions->ConstantBufferOffsetting = m_bConstantBufferOffsetting;
+		pOptions->ConstantBufferPartialUpdate = m_bConstantBufferOffsetting;
+		pOptions->MapNoOverwriteOnDynamicConstantBuffer = m_bConstantBufferOffsetting;
+	}
+	return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE RecordingDevice::GetPrivateData(REFGUID guid, UINT* pDataSize, void* pData)
+{
+	UNREFERENCED_PARAMETER(guid);
+	UNREFERENCED_PARAMETER(pData);
+	if (pDataSize)
+	{
+		*pDataSize = 0;
+	}
+	return DXGI_ERROR_NOT_FOUND;
+}
+
+HRESULT STDMETHODCALLTYPE RecordingDevice::SetPrivateData(REFGUID guid, UINT DataSize, const void* pData)
+{
+	UNREFERENCED_PARAMETER(guid);
+	UNREFERENCED_PARAMETER(DataSize);
+	UNREFERENCED_PARAMETER(pData);
+	return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE RecordingDevice::SetPrivateDataInterface(REFGUID guid, const IUnknown* pData)
+{
+	UNREFERENCED_PARAMETER(guid);
+	UNREFERENCED_PARAMETER(pData);
+	return S_OK;
+}
+
+D3D_FEATURE_LEVEL STDMETHODCALLTYPE RecordingDevice::GetFeatureLevel()
+{
+	return D3D_FEATURE_LEVEL_11_0;
+}
+
+UINT STDMETHODCALLTYPE RecordingDevice::GetCreationFlags()
+{
+	return 0;
+}
+
+HRESULT STDMETHODCALLTYPE RecordingDevice::GetDeviceRemovedReason()
+{
+	return S_OK;
+}
+
+void STDMETHODCALLTYPE RecordingDevice::GetImmediateContext(ID3D11DeviceContext** ppImmediateContext)
+{
+	AddRef();
+	*ppImmediateContext = &m_ImmediateContext;
+}
+
+HRESULT STDMETHODCALLTYPE RecordingDevice::SetExceptionMode(UINT RaiseFlags)
+{
+	UNREFERENCED_PARAMETER(RaiseFlags);
+	return S_OK;
+}
+
+UINT STDMETHODCALLTYPE RecordingDevice::GetExceptionMode()
+{
+	return 0;
+}
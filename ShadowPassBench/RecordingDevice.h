@@ -0,0 +1,421 @@
+//--------------------------------------------------------------------------------------
+// File: RecordingDevice.h
+//
+// A stand-in for ID3D11Device and its immediate context that creates no GPU objects and
+// draws nothing. Resources keep their description and, when the CPU can map them, a system
+// memory copy. The context records every call into a command stream and counts what building
+// a frame costs: state changes, redundant ones, bytes uploaded, draws per viewport. Deferred
+// contexts record the same way and ExecuteCommandList appends their stream to the immediate
+// one. Both are ID3D11DeviceContext1, the device only reports the D3D 11.1 constant buffer
+// offsetting after SetConstantBufferOffsetting(true). With it the CascadedShadowsManager
+// passes run without a GPU (see ShadowPassBench). Only <d3d11_1.h> and the standard library
+// are included, neither windows.h nor DXUT, so it compiles wherever the D3D11 headers do.
+//--------------------------------------------------------------------------------------
+#pragma once
+
+#include <d3d11_1.h>
+#include <atomic>
+#include <vector>
+
+class RecordingDevice;
+
+enum RECORDED_COMMAND_TYPE
+{
+	RECORDED_SET_STATE, // Any IA/VS/HS/DS/GS/PS/CS/RS/OM/SO setter
+	RECORDED_MAP,
+	RECORDED_UPDATE_SUBRESOURCE,
+	RECORDED_COPY,
+	RECORDED_CLEAR,
+	RECORDED_DRAW,
+	RECORDED_DISPATCH,
+	RECORDED_OTHER,
+};
+
+struct RecordedCommand
+{
+	RECORDED_COMMAND_TYPE m_eType;
+	const char* m_szName; // The ID3D11DeviceContext method
+	bool m_bRedundant; // A setter that bound exactly what was bound already
+	UINT m_uCount; // Vertices or indices per instance of a draw,bytes of a map,update or copy
+	UINT m_nInstances;
+	UINT m_nViewports; // Viewports bound when a draw was recorded
+	FLOAT m_fViewportX; // Top left corner of the first of them
+	FLOAT m_fViewportY;
+	UINT m_uVertexStride; // Of the vertex buffer in slot 0 when a draw was recorded
+	UINT m_uArraySlice; // First array slice of the depth stencil view bound when a draw was recorded
+	D3D11_MAP m_eMapType; // Of a map
+	UINT m_uFirstConstant; // Bound to the first slot of a *SetConstantBuffers1,in 16 byte constants
+	UINT m_uNumConstants;
+};
+
+// Totals since RecordingDeviceContext::ResetRecording.
+struct RecordedFrameStats
+{
+	UINT m_nCommands;
+	UINT m_nStateChanges;
+	UINT m_nRedundantStateChanges;
+	UINT m_nMaps;
+	UINT64 m_uBytesUploaded; // Whole subresource per discarding map,the 16 byte constants written by a NO_OVERWRITE one,plus UpdateSubresource
+	UINT64 m_uBytesCopied;
+	UINT m_nDraws;
+	UINT m_nInstances; // Over all draws,1 for a draw that is not instanced
+	UINT64 m_uVerticesSubmitted; // Vertices or indices times instances
+	UINT m_nClears;
+	UINT m_nDispatches;
+};
+
+#define RECORDED_SLOT_COUNT 16 // Shader slots whose bindings are tracked for redundancy,per stage
+#define RECORDED_STAGE_COUNT 6 // VS,HS,DS,GS,PS,CS
+
+class RecordingDeviceContext : public ID3D11DeviceContext1
+{
+public:
+	RecordingDeviceContext(RecordingDevice* pDevice, D3D11_DEVICE_CONTEXT_TYPE eType);
+	virtual ~RecordingDeviceContext();
+
+	// Starts a new command stream and zeroes the stats.What is bound stays bound,like on a real context.
+	void ResetRecording();
+
+	// Unbinds everything,as ClearState does on a real context.
+	void ResetBoundState();
+
+	const RecordedFrameStats& GetStats() const
+	{
+		return m_Stats;
+	}
+
+	const std::vector<RecordedCommand>& GetCommands() const
+	{
+		return m_Commands;
+	}
+
+	// Draws recorded while the first bound viewport started at (fTopLeftX,fTopLeftY).Draws with a viewport
+	// array only count when bCountViewportArrays is true.
+	UINT GetDrawCountInViewport(FLOAT fTopLeftX, FLOAT fTopLeftY, bool bCountViewportArrays) const;
+
+	// Draws recorded while a view of a texture array starting at uSlice was bound,0 for a view of a texture.
+	// Draws with a viewport array only count when bCountViewportArrays is true.
+	UINT GetDrawCountInArraySlice(UINT uSlice, bool bCountViewportArrays) const;
+
+	// IUnknown
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObject) override;
+	ULONG STDMETHODCALLTYPE AddRef() override;
+	ULONG STDMETHODCALLTYPE Release() override;
+
+	// ID3D11DeviceChild
+	void STDMETHODCALLTYPE GetDevice(ID3D11Device** ppDevice) override;
+	HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID guid, UINT* pDataSize, void* pData) override;
+	HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID guid, UINT DataSize, const void* pData) override;
+	HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID guid, const IUnknown* pData) override;
+
+	// ID3D11DeviceContext,the calls the sample makes are recorded
+	void STDMETHODCALLTYPE VSSetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers) override;
+	void STDMETHODCALLTYPE PSSetShaderResources(UINT StartSlot, UINT NumViews, ID3D11ShaderResourceView* const* ppShaderResourceViews) override;
+	void STDMETHODCALLTYPE PSSetShader(ID3D11PixelShader* pPixelShader, ID3D11ClassInstance* const* ppClassInstances, UINT NumClassInstances) override;
+	void STDMETHODCALLTYPE PSSetSamplers(UINT StartSlot, UINT NumSamplers, ID3D11SamplerState* const* ppSamplers) override;
+	void STDMETHODCALLTYPE VSSetShader(ID3D11VertexShader* pVertexShader, ID3D11ClassInstance* const* ppClassInstances, UINT NumClassInstances) override;
+	void STDMETHODCALLTYPE DrawIndexed(UINT IndexCount, UINT StartIndexLocation, INT BaseVertexLocation) override;
+	void STDMETHODCALLTYPE Draw(UINT VertexCount, UINT StartVertexLocation) override;
+	HRESULT STDMETHODCALLTYPE Map(ID3D11Resource* pResource, UINT Subresource, D3D11_MAP MapType, UINT MapFlags, D3D11_MAPPED_SUBRESOURCE* pMappedResource) override;
+	void STDMETHODCALLTYPE Unmap(ID3D11Resource* pResource, UINT Subresource) override;
+	void STDMETHODCALLTYPE PSSetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers) override;
+	void STDMETHODCALLTYPE IASetInputLayout(ID3D11InputLayout* pInputLayout) override;
+	void STDMETHODCALLTYPE IASetVertexBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppVertexBuffers, const UINT* pStrides, const UINT* pOffsets) override;
+	void STDMETHODCALLTYPE IASetIndexBuffer(ID3D11Buffer* pIndexBuffer, DXGI_FORMAT Format, UINT Offset) override;
+	void STDMETHODCALLTYPE DrawIndexedInstanced(UINT IndexCountPerInstance, UINT InstanceCount, UINT StartIndexLocation, INT BaseVertexLocation, UINT StartInstanceLocation) override;
+	void STDMETHODCALLTYPE DrawInstanced(UINT VertexCountPerInstance, UINT InstanceCount, UINT StartVertexLocation, UINT StartInstanceLocation) override;
+	void STDMETHODCALLTYPE GSSetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers) override;
+	void STDMETHODCALLTYPE GSSetShader(ID3D11GeometryShader* pShader, ID3D11ClassInstance* const* ppClassInstances, UINT NumClassInstances) override;
+	void STDMETHODCALLTYPE IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY Topology) override;
+	void STDMETHODCALLTYPE VSSetShaderResources(UINT StartSlot, UINT NumViews, ID3D11ShaderResourceView* const* ppShaderResourceViews) override;
+	void STDMETHODCALLTYPE VSSetSamplers(UINT StartSlot, UINT NumSamplers, ID3D11SamplerState* const* ppSamplers) override;
+	void STDMETHODCALLTYPE Begin(ID3D11Asynchronous* pAsync) override;
+	void STDMETHODCALLTYPE End(ID3D11Asynchronous* pAsync) override;
+	HRESULT STDMETHODCALLTYPE GetData(ID3D11Asynchronous* pAsync, void* pData, UINT DataSize, UINT GetDataFlags) override;
+	void STDMETHODCALLTYPE SetPredication(ID3D11Predicate* pPredicate, BOOL PredicateValue) override;
+	void STDMETHODCALLTYPE GSSetShaderResources(UINT StartSlot, UINT NumViews, ID3D11ShaderResourceView* const* ppShaderResourceViews) override;
+	void STDMETHODCALLTYPE GSSetSamplers(UINT StartSlot, UINT NumSamplers, ID3D11SamplerState* const* ppSamplers) override;
+	void STDMETHODCALLTYPE OMSetRenderTargets(UINT NumViews, ID3D11RenderTargetView* const* ppRenderTargetViews, ID3D11DepthStencilView* pDepthStencilView) override;
+	void STDMETHODCALLTYPE OMSetRenderTargetsAndUnorderedAccessViews(UINT NumRTVs, ID3D11RenderTargetView* const* ppRenderTargetViews, ID3D11DepthStencilView* pDepthStencilView,
+		UINT UAVStartSlot, UINT NumUAVs, ID3D11UnorderedAccessView* const* ppUnorderedAccessViews, const UINT* pUAVInitialCounts) override;
+	void STDMETHODCALLTYPE OMSetBlendState(ID3D11BlendState* pBlendState, const FLOAT BlendFactor[4], UINT SampleMask) override;
+	void STDMETHODCALLTYPE OMSetDepthStencilState(ID3D11DepthStencilState* pDepthStencilState, UINT StencilRef) override;
+	void STDMETHODCALLTYPE SOSetTargets(UINT NumBuffers, ID3D11Buffer* const* ppSOTargets, const UINT* pOffsets) override;
+	void STDMETHODCALLTYPE DrawAuto() override;
+	void STDMETHODCALLTYPE DrawIndexedInstancedIndirect(ID3D11Buffer* pBufferForArgs, UINT AlignedByteOffsetForArgs) override;
+	void STDMETHODCALLTYPE DrawInstancedIndirect(ID3D11Buffer* pBufferForArgs, UINT AlignedByteOffsetForArgs) override;
+	void STDMETHODCALLTYPE Dispatch(UINT ThreadGroupCountX, UINT ThreadGroupCountY, UINT ThreadGroupCountZ) override;
+	void STDMETHODCALLTYPE DispatchIndirect(ID3D11Buffer* pBufferForArgs, UINT AlignedByteOffsetForArgs) override;
+	void STDMETHODCALLTYPE RSSetState(ID3D11RasterizerState* pRasterizerState) override;
+	void STDMETHODCALLTYPE RSSetViewports(UINT NumViewports, const D3D11_VIEWPORT* pViewports) override;
+	void STDMETHODCALLTYPE RSSetScissorRects(UINT NumRects, const D3D11_RECT* pRects) override;
+	void STDMETHODCALLTYPE CopySubresourceRegion(ID3D11Resource* pDstResource, UINT DstSubresource, UINT DstX, UINT DstY, UINT DstZ,
+		ID3D11Resource* pSrcResource, UINT SrcSubresource, const D3D11_BOX* pSrcBox) override;
+	void STDMETHODCALLTYPE CopyResource(ID3D11Resource* pDstResource, ID3D11Resource* pSrcResource) override;
+	void STDMETHODCALLTYPE UpdateSubresource(ID3D11Resource* pDstResource, UINT DstSubresource, const D3D11_BOX* pDstBox,
+		const void* pSrcData, UINT SrcRowPitch, UINT SrcDepthPitch) override;
+	void STDMETHODCALLTYPE CopyStructureCount(ID3D11Buffer* pDstBuffer, UINT DstAlignedByteOffset, ID3D11UnorderedAccessView* pSrcView) override;
+	void STDMETHODCALLTYPE ClearRenderTargetView(ID3D11RenderTargetView* pRenderTargetView, const FLOAT ColorRGBA[4]) override;
+	void STDMETHODCALLTYPE ClearUnorderedAccessViewUint(ID3D11UnorderedAccessView* pUnorderedAccessView, const UINT Values[4]) override;
+	void STDMETHODCALLTYPE ClearUnorderedAccessViewFloat(ID3D11UnorderedAccessView* pUnorderedAccessView, const FLOAT Values[4]) override;
+	void STDMETHODCALLTYPE ClearDepthStencilView(ID3D11DepthStencilView* pDepthStencilView, UINT ClearFlags, FLOAT Depth, UINT8 Stencil) override;
+	void STDMETHODCALLTYPE GenerateMips(ID3D11ShaderResourceView* pShaderResourceView) override;
+	void STDMETHODCALLTYPE SetResourceMinLOD(ID3D11Resource* pResource, FLOAT MinLOD) override;
+	FLOAT STDMETHODCALLTYPE GetResourceMinLOD(ID3D11Resource* pResource) override;
+	void STDMETHODCALLTYPE ResolveSubresource(ID3D11Resource* pDstResource, UINT DstSubresource, ID3D11Resource* pSrcResource, UINT SrcSubresource, DXGI_FORMAT Format) override;
+	void STDMETHODCALLTYPE ExecuteCommandList(ID3D11CommandList* pCommandList, BOOL RestoreContextState) override;
+	void STDMETHODCALLTYPE HSSetShaderResources(UINT StartSlot, UINT NumViews, ID3D11ShaderResourceView* const* ppShaderResourceViews) override;
+	void STDMETHODCALLTYPE HSSetShader(ID3D11HullShader* pHullShader, ID3D11ClassInstance* const* ppClassInstances, UINT NumClassInstances) override;
+	void STDMETHODCALLTYPE HSSetSamplers(UINT StartSlot, UINT NumSamplers, ID3D11SamplerState* const* ppSamplers) override;
+	void STDMETHODCALLTYPE HSSetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers) override;
+	void STDMETHODCALLTYPE DSSetShaderResources(UINT StartSlot, UINT NumViews, ID3D11ShaderResourceView* const* ppShaderResourceViews) override;
+	void STDMETHODCALLTYPE DSSetShader(ID3D11DomainShader* pDomainShader, ID3D11ClassInstance* const* ppClassInstances, UINT NumClassInstances) override;
+	void STDMETHODCALLTYPE DSSetSamplers(UINT StartSlot, UINT NumSamplers, ID3D11SamplerState* const* ppSamplers) override;
+	void STDMETHODCALLTYPE DSSetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers) override;
+	void STDMETHODCALLTYPE CSSetShaderResources(UINT StartSlot, UINT NumViews, ID3D11ShaderResourceView* const* ppShaderResourceViews) override;
+	void STDMETHODCALLTYPE CSSetUnorderedAccessViews(UINT StartSlot, UINT NumUAVs, ID3D11UnorderedAccessView* const* ppUnorderedAccessViews, const UINT* pUAVInitialCounts) override;
+	void STDMETHODCALLTYPE CSSetShader(ID3D11ComputeShader* pComputeShader, ID3D11ClassInstance* const* ppClassInstances, UINT NumClassInstances) override;
+	void STDMETHODCALLTYPE CSSetSamplers(UINT StartSlot, UINT NumSamplers, ID3D11SamplerState* const* ppSamplers) override;
+	void STDMETHODCALLTYPE CSSetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers) override;
+
+	// The getters return empty bindings,nothing in the sample reads state back.
+	void STDMETHODCALLTYPE VSGetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer** ppConstantBuffers) override;
+	void STDMETHODCALLTYPE PSGetShaderResources(UINT StartSlot, UINT NumViews, ID3D11ShaderResourceView** ppShaderResourceViews) override;
+	void STDMETHODCALLTYPE PSGetShader(ID3D11PixelShader** ppPixelShader, ID3D11ClassInstance** ppClassInstances, UINT* pNumClassInstances) override;
+	void STDMETHODCALLTYPE PSGetSamplers(UINT StartSlot, UINT NumSamplers, ID3D11SamplerState** ppSamplers) override;
+	void STDMETHODCALLTYPE VSGetShader(ID3D11VertexShader** ppVertexShader, ID3D11ClassInstance** ppClassInstances, UINT* pNumClassInstances) override;
+	void STDMETHODCALLTYPE PSGetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer** ppConstantBuffers) override;
+	void STDMETHODCALLTYPE IAGetInputLayout(ID3D11InputLayout** ppInputLayout) override;
+	void STDMETHODCALLTYPE IAGetVertexBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer** ppVertexBuffers, UINT* pStrides, UINT* pOffsets) override;
+	void STDMETHODCALLTYPE IAGetIndexBuffer(ID3D11Buffer** pIndexBuffer, DXGI_FORMAT* Format, UINT* Offset) override;
+	void STDMETHODCALLTYPE GSGetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer** ppConstantBuffers) override;
+	void STDMETHODCALLTYPE GSGetShader(ID3D11GeometryShader** ppGeometryShader, ID3D11ClassInstance** ppClassInstances, UINT* pNumClassInstances) override;
+	void STDMETHODCALLTYPE IAGetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY* pTopology) override;
+	void STDMETHODCALLTYPE VSGetShaderResources(UINT StartSlot, UINT NumViews, ID3D11ShaderResourceView** ppShaderResourceViews) override;
+	void STDMETHODCALLTYPE VSGetSamplers(UINT StartSlot, UINT NumSamplers, ID3D11SamplerState** ppSamplers) override;
+	void STDMETHODCALLTYPE GetPredication(ID3D11Predicate** ppPredicate, BOOL* pPredicateValue) override;
+	void STDMETHODCALLTYPE GSGetShaderResources(UINT StartSlot, UINT NumViews, ID3D11ShaderResourceView** ppShaderResourceViews) override;
+	void STDMETHODCALLTYPE GSGetSamplers(UINT StartSlot, UINT NumSamplers, ID3D11SamplerState** ppSamplers) override;
+	void STDMETHODCALLTYPE OMGetRenderTargets(UINT NumViews, ID3D11RenderTargetView** ppRenderTargetViews, ID3D11DepthStencilView** ppDepthStencilView) override;
+	void STDMETHODCALLTYPE OMGetRenderTargetsAndUnorderedAccessViews(UINT NumRTVs, ID3D11RenderTargetView** ppRenderTargetViews, ID3D11DepthStencilView** ppDepthStencilView,
+		UINT UAVStartSlot, UINT NumUAVs, ID3D11UnorderedAccessView** ppUnorderedAccessViews) override;
+	void STDMETHODCALLTYPE OMGetBlendState(ID3D11BlendState** ppBlendState, FLOAT BlendFactor[4], UINT* pSampleMask) override;
+	void STDMETHODCALLTYPE OMGetDepthStencilState(ID3D11DepthStencilState** ppDepthStencilState, UINT* pStencilRef) override;
+	void STDMETHODCALLTYPE SOGetTargets(UINT NumBuffers, ID3D11Buffer** ppSOTargets) override;
+	void STDMETHODCALLTYPE RSGetState(ID3D11RasterizerState** ppRasterizerState) override;
+	void STDMETHODCALLTYPE RSGetViewports(UINT* pNumViewports, D3D11_VIEWPORT* pViewports) override;
+	void STDMETHODCALLTYPE RSGetScissorRects(UINT* pNumRects, D3D11_RECT* pRects) override;
+	void STDMETHODCALLTYPE HSGetShaderResources(UINT StartSlot, UINT NumViews, ID3D11ShaderResourceView** ppShaderResourceViews) override;
+	void STDMETHODCALLTYPE HSGetShader(ID3D11HullShader** ppHullShader, ID3D11ClassInstance** ppClassInstances, UINT* pNumClassInstances) override;
+	void STDMETHODCALLTYPE HSGetSamplers(UINT StartSlot, UINT NumSamplers, ID3D11SamplerState** ppSamplers) override;
+	void STDMETHODCALLTYPE HSGetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer** ppConstantBuffers) override;
+	void STDMETHODCALLTYPE DSGetShaderResources(UINT StartSlot, UINT NumViews, ID3D11ShaderResourceView** ppShaderResourceViews) override;
+	void STDMETHODCALLTYPE DSGetShader(ID3D11DomainShader** ppDomainShader, ID3D11ClassInstance** ppClassInstances, UINT* pNumClassInstances) override;
+	void STDMETHODCALLTYPE DSGetSamplers(UINT StartSlot, UINT NumSamplers, ID3D11SamplerState** ppSamplers) override;
+	void STDMETHODCALLTYPE DSGetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer** ppConstantBuffers) override;
+	void STDMETHODCALLTYPE CSGetShaderResources(UINT StartSlot, UINT NumViews, ID3D11ShaderResourceView** ppShaderResourceViews) override;
+	void STDMETHODCALLTYPE CSGetUnorderedAccessViews(UINT StartSlot, UINT NumUAVs, ID3D11UnorderedAccessView** ppUnorderedAccessViews) override;
+	void STDMETHODCALLTYPE CSGetShader(ID3D11ComputeShader** ppComputeShader, ID3D11ClassInstance** ppClassInstances, UINT* pNumClassInstances) override;
+	void STDMETHODCALLTYPE CSGetSamplers(UINT StartSlot, UINT NumSamplers, ID3D11SamplerState** ppSamplers) override;
+	void STDMETHODCALLTYPE CSGetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer** ppConstantBuffers) override;
+
+	void STDMETHODCALLTYPE ClearState() override;
+	void STDMETHODCALLTYPE Flush() override;
+	D3D11_DEVICE_CONTEXT_TYPE STDMETHODCALLTYPE GetType() override;
+	UINT STDMETHODCALLTYPE GetContextFlags() override;
+	HRESULT STDMETHODCALLTYPE FinishCommandList(BOOL RestoreDeferredContextState, ID3D11CommandList** ppCommandList) override;
+
+	// ID3D11DeviceContext1,the constant buffer offsets are recorded,the rest like the D3D 11.0 calls
+	void STDMETHODCALLTYPE CopySubresourceRegion1(ID3D11Resource* pDstResource, UINT DstSubresource, UINT DstX, UINT DstY, UINT DstZ,
+		ID3D11Resource* pSrcResource, UINT SrcSubresource, const D3D11_BOX* pSrcBox, UINT CopyFlags) override;
+	void STDMETHODCALLTYPE UpdateSubresource1(ID3D11Resource* pDstResource, UINT DstSubresource, const D3D11_BOX* pDstBox,
+		const void* pSrcData, UINT SrcRowPitch, UINT SrcDepthPitch, UINT CopyFlags) override;
+	void STDMETHODCALLTYPE DiscardResource(ID3D11Resource* pResource) override;
+	void STDMETHODCALLTYPE DiscardView(ID3D11View* pResourceView) override;
+	void STDMETHODCALLTYPE VSSetConstantBuffers1(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers, const UINT* pFirstConstant, const UINT* pNumConstants) override;
+	void STDMETHODCALLTYPE HSSetConstantBuffers1(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers, const UINT* pFirstConstant, const UINT* pNumConstants) override;
+	void STDMETHODCALLTYPE DSSetConstantBuffers1(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers, const UINT* pFirstConstant, const UINT* pNumConstants) override;
+	void STDMETHODCALLTYPE GSSetConstantBuffers1(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers, const UINT* pFirstConstant, const UINT* pNumConstants) override;
+	void STDMETHODCALLTYPE PSSetConstantBuffers1(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers, const UINT* pFirstConstant, const UINT* pNumConstants) override;
+	void STDMETHODCALLTYPE CSSetConstantBuffers1(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers, const UINT* pFirstConstant, const UINT* pNumConstants) override;
+	void STDMETHODCALLTYPE VSGetConstantBuffers1(UINT StartSlot, UINT NumBuffers, ID3D11Buffer** ppConstantBuffers, UINT* pFirstConstant, UINT* pNumConstants) override;
+	void STDMETHODCALLTYPE HSGetConstantBuffers1(UINT StartSlot, UINT NumBuffers, ID3D11Buffer** ppConstantBuffers, UINT* pFirstConstant, UINT* pNumConstants) override;
+	void STDMETHODCALLTYPE DSGetConstantBuffers1(UINT StartSlot, UINT NumBuffers, ID3D11Buffer** ppConstantBuffers, UINT* pFirstConstant, UINT* pNumConstants) override;
+	void STDMETHODCALLTYPE GSGetConstantBuffers1(UINT StartSlot, UINT NumBuffers, ID3D11Buffer** ppConstantBuffers, UINT* pFirstConstant, UINT* pNumConstants) override;
+	void STDMETHODCALLTYPE PSGetConstantBuffers1(UINT StartSlot, UINT NumBuffers, ID3D11Buffer** ppConstantBuffers, UINT* pFirstConstant, UINT* pNumConstants) override;
+	void STDMETHODCALLTYPE CSGetConstantBuffers1(UINT StartSlot, UINT NumBuffers, ID3D11Buffer** ppConstantBuffers, UINT* pFirstConstant, UINT* pNumConstants) override;
+	void STDMETHODCALLTYPE SwapDeviceContextState(ID3DDeviceContextState* pState, ID3DDeviceContextState** ppPreviousState) override;
+	void STDMETHODCALLTYPE ClearView(ID3D11View* pView, const FLOAT Color[4], const D3D11_RECT* pRect, UINT NumRects) override;
+	void STDMETHODCALLTYPE DiscardView1(ID3D11View* pResourceView, const D3D11_RECT* pRects, UINT NumRects) override;
+
+private:
+	RecordedCommand& Record(RECORDED_COMMAND_TYPE eType, const char* szName);
+	void RecordSetter(const char* szName, bool bRedundant);
+	void RecordDraw(const char* szName, UINT uCount, UINT nInstances);
+	void SetSlots(const char* szName, void** ppBound, UINT uBoundCount, UINT StartSlot, UINT NumSlots, void* const* ppNew);
+	void SetShader(const char* szName, UINT uStage, void* pShader);
+	void SetConstantBuffers(const char* szName, UINT uStage, UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers,
+		const UINT* pFirstConstant, const UINT* pNumConstants);
+	void AddStats(const RecordedFrameStats& Stats);
+
+	enum
+	{
+		STAGE_VS,
+		STAGE_HS,
+		STAGE_DS,
+		STAGE_GS,
+		STAGE_PS,
+		STAGE_CS,
+	};
+
+	RecordingDevice* m_pDevice;
+	D3D11_DEVICE_CONTEXT_TYPE m_eType;
+	std::atomic<ULONG> m_uRefCount; // Deferred contexts only,the immediate one counts on its device
+	std::vector<RecordedCommand> m_Commands;
+	RecordedFrameStats m_Stats;
+
+	// A map on a deferred context gets fresh memory,as the runtime renames the buffer for it.
+	// The contents are not written to the resource when the command list executes.
+	std::vector<std::vector<BYTE>> m_DeferredMapMemory;
+
+	// A NO_OVERWRITE map writes into a copy filled with a marker byte,so that Unmap can charge the constants the
+	// caller wrote and leave the rest of the resource as it was.
+	struct NoOverwriteMap
+	{
+		ID3D11Resource* m_pResource;
+		UINT m_uSubresource;
+		BYTE* m_pData; // Of the resource,nullptr on a deferred context
+		size_t m_uCommand; // The map in m_Commands
+		std::vector<BYTE> m_Written;
+	};
+	std::vector<NoOverwriteMap> m_NoOverwriteMaps;
+
+	// What is bound,to tell redundant setters apart.The pointers are not referenced.
+	ID3D11InputLayout* m_pInputLayout;
+	D3D11_PRIMITIVE_TOPOLOGY m_eTopology;
+	void* m_pVertexBuffers[D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT];
+	UINT m_uVertexStrides[D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT];
+	UINT m_uVertexOffsets[D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT];
+	ID3D11Buffer* m_pIndexBuffer;
+	DXGI_FORMAT m_eIndexFormat;
+	UINT m_uIndexOffset;
+	void* m_pShaders[RECORDED_STAGE_COUNT];
+	void* m_pConstantBuffers[RECORDED_STAGE_COUNT][RECORDED_SLOT_COUNT];
+	UINT m_uFirstConstants[RECORDED_STAGE_COUNT][RECORDED_SLOT_COUNT]; // Both 0 for a buffer bound whole
+	UINT m_uNumConstants[RECORDED_STAGE_COUNT][RECORDED_SLOT_COUNT];
+	void* m_pShaderResources[RECORDED_STAGE_COUNT][RECORDED_SLOT_COUNT];
+	void* m_pSamplers[RECORDED_STAGE_COUNT][RECORDED_SLOT_COUNT];
+	void* m_pUnorderedAccessViews[D3D11_PS_CS_UAV_REGISTER_COUNT];
+	ID3D11RasterizerState* m_pRasterizerState;
+	UINT m_nViewports;
+	D3D11_VIEWPORT m_Viewports[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE];
+	void* m_pRenderTargets[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT];
+	ID3D11DepthStencilView* m_pDepthStencilView;
+	ID3D11DepthStencilState* m_pDepthStencilState;
+	UINT m_uStencilRef;
+	ID3D11BlendState* m_pBlendState;
+	FLOAT m_fBlendFactor[4];
+	UINT m_uSampleMask;
+
+};
+
+class RecordingDevice : public ID3D11Device
+{
+public:
+	RecordingDevice();
+	virtual ~RecordingDevice() {}
+
+	RecordingDeviceContext* GetRecordingContext()
+	{
+		return &m_ImmediateContext;
+	}
+
+	// Reports D3D11_FEATURE_D3D11_OPTIONS with the constant buffer offsetting of D3D 11.1,which makes the manager
+	// append the cascade constants to a ring.Off at first,as on a D3D 11.0 runtime.
+	void SetConstantBufferOffsetting(bool bEnable)
+	{
+		m_bConstantBufferOffsetting = bEnable;
+	}
+
+	// Objects created by this device and not released yet.
+	INT GetLiveObjectCount() const
+	{
+		return m_nLiveObjects;
+	}
+
+	// Bytes of all buffers and textures that are alive.
+	UINT64 GetLiveResourceBytes() const
+	{
+		return m_uLiveResourceBytes;
+	}
+
+	// Objects created by this device since it was made,released or not.
+	UINT GetCreatedObjectCount() const
+	{
+		return m_nCreatedObjects;
+	}
+
+	// Called by the objects the device creates.
+	void OnObjectCreated(UINT64 uResourceBytes);
+	void OnObjectDestroyed(UINT64 uResourceBytes);
+
+	// IUnknown,the device lives as long as its owner and is not deleted by Release.
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObject) override;
+	ULONG STDMETHODCALLTYPE AddRef() override;
+	ULONG STDMETHODCALLTYPE Release() override;
+
+	// ID3D11Device
+	HRESULT STDMETHODCALLTYPE CreateBuffer(const D3D11_BUFFER_DESC* pDesc, const D3D11_SUBRESOURCE_DATA* pInitialData, ID3D11Buffer** ppBuffer) override;
+	HRESULT STDMETHODCALLTYPE CreateTexture1D(const D3D11_TEXTURE1D_DESC* pDesc, const D3D11_SUBRESOURCE_DATA* pInitialData, ID3D11Texture1D** ppTexture1D) override;
+	HRESULT STDMETHODCALLTYPE CreateTexture2D(const D3D11_TEXTURE2D_DESC* pDesc, const D3D11_SUBRESOURCE_DATA* pInitialData, ID3D11Texture2D** ppTexture2D) override;
+	HRESULT STDMETHODCALLTYPE CreateTexture3D(const D3D11_TEXTURE3D_DESC* pDesc, const D3D11_SUBRESOURCE_DATA* pInitialData, ID3D11Texture3D** ppTexture3D) override;
+	HRESULT STDMETHODCALLTYPE CreateShaderResourceView(ID3D11Resource* pResource, const D3D11_SHADER_RESOURCE_VIEW_DESC* pDesc, ID3D11ShaderResourceView** ppSRView) override;
+	HRESULT STDMETHODCALLTYPE CreateUnorderedAccessView(ID3D11Resource* pResource, const D3D11_UNORDERED_ACCESS_VIEW_DESC* pDesc, ID3D11UnorderedAccessView** ppUAView) override;
+	HRESULT STDMETHODCALLTYPE CreateRenderTargetView(ID3D11Resource* pResource, const D3D11_RENDER_TARGET_VIEW_DESC* pDesc, ID3D11RenderTargetView** ppRTView) override;
+	HRESULT STDMETHODCALLTYPE CreateDepthStencilView(ID3D11Resource* pResource, const D3D11_DEPTH_STENCIL_VIEW_DESC* pDesc, ID3D11DepthStencilView** ppDepthStencilView) override;
+	HRESULT STDMETHODCALLTYPE CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* pInputElementDescs, UINT NumElements, const void* pShaderBytecodeWithInputSignature,
+		SIZE_T BytecodeLength, ID3D11InputLayout** ppInputLayout) override;
+	HRESULT STDMETHODCALLTYPE CreateVertexShader(const void* pShaderBytecode, SIZE_T BytecodeLength, ID3D11ClassLinkage* pClassLinkage, ID3D11VertexShader** ppVertexShader) override;
+	HRESULT STDMETHODCALLTYPE CreateGeometryShader(const void* pShaderBytecode, SIZE_T BytecodeLength, ID3D11ClassLinkage* pClassLinkage, ID3D11GeometryShader** ppGeometryShader) override;
+	HRESULT STDMETHODCALLTYPE CreateGeometryShaderWithStreamOutput(const void* pShaderBytecode, SIZE_T BytecodeLength, const D3D11_SO_DECLARATION_ENTRY* pSODeclaration,
+		UINT NumEntries, const UINT* pBufferStrides, UINT NumStrides, UINT RasterizedStream, ID3D11ClassLinkage* pClassLinkage, ID3D11GeometryShader** ppGeometryShader) override;
+	HRESULT STDMETHODCALLTYPE CreatePixelShader(const void* pShaderBytecode, SIZE_T BytecodeLength, ID3D11ClassLinkage* pClassLinkage, ID3D11PixelShader** ppPixelShader) override;
+	HRESULT STDMETHODCALLTYPE CreateHullShader(const void* pShaderBytecode, SIZE_T BytecodeLength, ID3D11ClassLinkage* pClassLinkage, ID3D11HullShader** ppHullShader) override;
+	HRESULT STDMETHODCALLTYPE CreateDomainShader(const void* pShaderBytecode, SIZE_T BytecodeLength, ID3D11ClassLinkage* pClassLinkage, ID3D11DomainShader** ppDomainShader) override;
+	HRESULT STDMETHODCALLTYPE CreateComputeShader(const void* pShaderBytecode, SIZE_T BytecodeLength, ID3D11ClassLinkage* pClassLinkage, ID3D11ComputeShader** ppComputeShader) override;
+	HRESULT STDMETHODCALLTYPE CreateClassLinkage(ID3D11ClassLinkage** ppLinkage) override;
+	HRESULT STDMETHODCALLTYPE CreateBlendState(const D3D11_BLEND_DESC* pBlendStateDesc, ID3D11BlendState** ppBlendState) override;
+	HRESULT STDMETHODCALLTYPE CreateDepthStencilState(const D3D11_DEPTH_STENCIL_DESC* pDepthStencilDesc, ID3D11DepthStencilState** ppDepthStencilState) override;
+	HRESULT STDMETHODCALLTYPE CreateRasterizerState(const D3D11_RASTERIZER_DESC* pRasterizerDesc, ID3D11RasterizerState** ppRasterizerState) override;
+	HRESULT STDMETHODCALLTYPE CreateSamplerState(const D3D11_SAMPLER_DESC* pSamplerDesc, ID3D11SamplerState** ppSamplerState) override;
+	HRESULT STDMETHODCALLTYPE CreateQuery(const D3D11_QUERY_DESC* pQueryDesc, ID3D11Query** ppQuery) override;
+	HRESULT STDMETHODCALLTYPE CreatePredicate(const D3D11_QUERY_DESC* pPredicateDesc, ID3D11Predicate** ppPredicate) override;
+	HRESULT STDMETHODCALLTYPE CreateCounter(const D3D11_COUNTER_DESC* pCounterDesc, ID3D11Counter** ppCounter) override;
+	HRESULT STDMETHODCALLTYPE CreateDeferredContext(UINT ContextFlags, ID3D11DeviceContext** ppDeferredContext) override;
+	HRESULT STDMETHODCALLTYPE OpenSharedResource(HANDLE hResource, REFIID ReturnedInterface, void** ppResource) override;
+	HRESULT STDMETHODCALLTYPE CheckFormatSupport(DXGI_FORMAT Format, UINT* pFormatSupport) override;
+	HRESULT STDMETHODCALLTYPE CheckMultisampleQualityLevels(DXGI_FORMAT Format, UINT SampleCount, UINT* pNumQualityLevels) override;
+	void STDMETHODCALLTYPE CheckCounterInfo(D3D11_COUNTER_INFO* pCounterInfo) override;
+	HRESULT STDMETHODCALLTYPE CheckCounter(const D3D11_COUNTER_DESC* pDesc, D3D11_COUNTER_TYPE* pType, UINT* pActiveCounters, LPSTR szName, UINT* pNameLength,
+		LPSTR szUnits, UINT* pUnitsLength, LPSTR szDescription, UINT* pDescriptionLength) override;
+	HRESULT STDMETHODCALLTYPE CheckFeatureSupport(D3D11_FEATURE Feature, void* pFeatureSupportData, UINT FeatureSupportDataSize) override;
+	HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID guid, UINT* pDataSize, void* pData) override;
+	HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID guid, UINT DataSize, const void* pData) override;
+	HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID guid, const IUnknown* pData) override;
+	D3D_FEATURE_LEVEL STDMETHODCALLTYPE GetFeatureLevel() override;
+	UINT STDMETHODCALLTYPE GetCreationFlags() override;
+	HRESULT STDMETHODCALLTYPE GetDeviceRemovedReason() override;
+	void STDMETHODCALLTYPE GetImmediateContext(ID3D11DeviceContext** ppImmediateContext) override;
+	HRESULT STDMETHODCALLTYPE SetExceptionMode(UINT RaiseFlags) override;
+	UINT STDMETHODCALLTYPE GetExceptionMode() override;
+
+private:
+	RecordingDeviceContext m_ImmediateContext;
+	std::atomic<ULONG> m_uRefCount;
+	bool m_bConstantBufferOffsetting;
+
+	// Deferred contexts create their command lists on the threads that record them.
+	std::atomic<INT> m_nLiveObjects;
+	std::atomic<UINT> m_nCreatedObjects;
+	std::atomic<UINT64> m_uLiveResourceBytes;
+};
@@ -0,0 +1,1385 @@
+//--------------------------------------------------------------------------------------
+// File: ShadowPassBench.cpp
+//
+// Runs CascadedShadowsManager on a RecordingDevice over the power plant,so that
+// InitPerFrame,RenderShadowForAllCascades and RenderScene run without a GPU. For every
+// shadow pass mode it reports what building a frame costs:the CPU time,the draws into each
+// cascade,the state changes and the constant buffer uploads. Each report and check says in
+// its own comment what it compares.
+//
+// Only the device is replaced,the manager still includes DXUT and compiles its shaders with
+// D3DCompile,so this builds on Windows only. The D3D-free decisions the passes make,the fit,
+// the schedules,the caster culling,the constant layouts and the constant ring slots,are
+// checked by CascadeFittingBench,which builds on Linux as well.
+//
+// Usage: ShadowPassBench [--frames count] [--passes count] [--cascades count] [--threads count] [--verify]
+//
+// --cascades other than the sample's 4 use the practical split scheme.
+// --threads sets the workers of the job pool,0 is one less than the hardware threads.
+// --verify checks the recorded command stream against what the manager reports and
+// returns non-zero if anything disagrees.
+//--------------------------------------------------------------------------------------
+#include "DXUT.h"
+#include "DXUTcamera.h"
+#include "SDKmesh.h"
+#include "CascadedShadowsManager.h"
+#include "JobPool.h"
+#include "GpuMemoryTracker.h"
+#include "RecordingDevice.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace DirectX;
+
+#define BENCH_BACK_BUFFER_WIDTH 1280
+#define BENCH_BACK_BUFFER_HEIGHT 720
+
+RecordingDevice g_Device;
+CDXUTSDKMesh g_MeshPowerPlant;
+CFirstPersonCamera g_ViewerCamera;
+CFirstPersonCamera g_LightCamera;
+CascadeConfig g_CascadeConfig;
+GpuMemoryTracker g_GpuMemoryTracker; // Outlives the manager,which forgets its shader blobs on destruction
+CascadedShadowsManager g_CascadedShadow;
+JobPool g_JobPool;
+
+ID3D11Texture2D* g_pBackBuffer = nullptr;
+ID3D11RenderTargetView* g_pBackBufferRTV = nullptr;
+ID3D11Texture2D* g_pSceneDepthTexture = nullptr;
+ID3D11DepthStencilView* g_pSceneDepthDSV = nullptr;
+
+// What one pass of a frame recorded.
+struct PassRecording
+{
+	RecordedFrameStats m_Stats;
+	UINT m_nViewportDraws[MAX_CASCADES]; // Draws recorded in the viewport or the texture array slice of each cascade
+	INT m_nCastersDrawn[MAX_CASCADES]; // As the manager counted them
+	INT m_nCastersCulled[MAX_CASCADES];
+	INT m_nShadowDrawCalls;
+	UINT64 m_uShadowVertexBytes;
+	UINT64 m_nTriangles; // Over all cascades,as the manager counted them
+	UINT64 m_nRecordedTriangles;
+	UINT m_nMaxInstances;
+	UINT m_nMinInstances;
+	UINT m_nMinViewports;
+	std::vector<RecordedCommand> m_Draws;
+	std::vector<RecordedCommand> m_ConstantBufferCommands; // Maps and VS constant buffer bindings,in stream order
+};
+
+// The textures are not needed,the scene pass binds null views in their place.
+static void CALLBACK CreateNoTexture(ID3D11Device* pDevice, char* szFileName, ID3D11ShaderResourceView** ppRV, void* pContext)
+{
+	UNREFERENCED_PARAMETER(pDevice);
+	UNREFERENCED_PARAMETER(szFileName);
+	UNREFERENCED_PARAMETER(pContext);
+	*ppRV = nullptr;
+}
+
+static HRESULT CreateTarget(UINT uWidth, UINT uHeight, DXGI_FORMAT format, UINT uBindFlags, ID3D11Texture2D** ppTexture)
+{
+	D3D11_TEXTURE2D_DESC desc;
+	ZeroMemory(&desc, sizeof(desc));
+	desc.Width = uWidth;
+	desc.Height = uHeight;
+	desc.MipLevels = 1;
+	desc.ArraySize = 1;
+	desc.Format = format;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = uBindFlags;
+	return g_Device.CreateTexture2D(&desc, nullptr, ppTexture);
+}
+
+//--------------------------------------------------------------------------------------
+// Same scene,cameras and cascade setup as the sample starts with.
+//--------------------------------------------------------------------------------------
+static HRESULT CreateScene(int iCascadeCount)
+{
+	HRESULT hr;
+
+	SDKMESH_CALLBACKS11 callbacks;
+	ZeroMemory(&callbacks, sizeof(callbacks));
+	callbacks.pCreateTextureFromFile = CreateNoTexture;
+	g_MeshPowerPlant.SetCreatePositionStreams(true);
+	if (FAILED(hr = g_MeshPowerPlant.Create(&g_Device, L"powerplant\\powerplant.sdkmesh", &callbacks)))
+	{
+		printf("Could not load powerplant\\powerplant.sdkmesh\n");
+		return hr;
+	}
+	TrackMeshMemory(&g_GpuMemoryTracker, &g_MeshPowerPlant, true);
+
+	g_CascadeConfig.m_nUsingCascadeLevelsCount = iCascadeCount;
+	g_CascadeConfig.m_iLengthOfShadowBufferSquare = 1024;
+	g_CascadeConfig.m_ShadowBufferFormat = CASCADE_DXGI_FORMAT_R32_TYPELESS;
+
+	static const INT iPartitions[MAX_CASCADES] = { 5,15,60,100,100,100,100,100 };
+	memcpy(g_CascadedShadow.m_iCascadePartitionsZeroToOne, iPartitions, sizeof(iPartitions));
+	g_CascadedShadow.m_iCascadePartitionMax = 100;
+	if (iCascadeCount != 4)
+	{
+		// The manual partitions are tuned for 4 cascades.
+		g_CascadedShadow.m_eCascadeSplitMode = CASCADE_SPLIT_PRACTICAL;
+	}
+	g_CascadedShadow.SetJobPool(&g_JobPool);
+	g_CascadedShadow.SetMemoryTracker(&g_GpuMemoryTracker);
+
+	// Nothing renders depth here,so there are no visible depth bounds to fit to.
+	g_CascadedShadow.m_bFitToDepthBounds = false;
+
+	g_ViewerCamera.SetViewParams(XMVectorSet(100.0f, 5.0f, 5.0f, 0.0f), XMVectorSet(-600.0f, 0.0f, -600.0f, 0.0f));
+	g_LightCamera.SetViewParams(XMVectorSet(-320.0f, 300.0f, -220.3f, 0.0f), XMVectorSet(0.0f, 0.0f, 0.0f, 0.0f));
+	g_LightCamera.SetProjParams(XM_PI / 4, 1.0f, 0.1f, 1000.0f);
+
+	if (FAILED(hr = g_CascadedShadow.Init(&g_Device, g_Device.GetRecordingContext(), &g_MeshPowerPlant, &g_ViewerCamera, &g_LightCamera, &g_CascadeConfig)))
+	{
+		printf("CascadedShadowsManager::Init failed with 0x%08x,are the shaders found?\n", (UINT)hr);
+		return hr;
+	}
+
+	XMVECTOR vMeshLength = XMVector3Length(g_CascadedShadow.GetSceneAABBMax() - g_CascadedShadow.GetScenAABBMin());
+	g_ViewerCamera.SetProjParams(XM_PI / 4, (FLOAT)BENCH_BACK_BUFFER_WIDTH / (FLOAT)BENCH_BACK_BUFFER_HEIGHT, 0.05f, XMVectorGetX(vMeshLength));
+
+	if (FAILED(hr = CreateTarget(BENCH_BACK_BUFFER_WIDTH, BENCH_BACK_BUFFER_HEIGHT, DXGI_FORMAT_R8G8B8A8_UNORM, D3D11_BIND_RENDER_TARGET, &g_pBackBuffer))
+		|| FAILED(hr = g_Device.CreateRenderTargetView(g_pBackBuffer, nullptr, &g_pBackBufferRTV))
+		|| FAILED(hr = CreateTarget(BENCH_BACK_BUFFER_WIDTH, BENCH_BACK_BUFFER_HEIGHT, DXGI_FORMAT_D24_UNORM_S8_UINT, D3D11_BIND_DEPTH_STENCIL, &g_pSceneDepthTexture))
+		|| FAILED(hr = g_Device.CreateDepthStencilView(g_pSceneDepthTexture, nullptr, &g_pSceneDepthDSV)))
+	{
+		return hr;
+	}
+	g_GpuMemoryTracker.TrackResource(GPU_MEMORY_SCENE_TARGETS, g_pBackBuffer, "Back Buffer");
+	g_GpuMemoryTracker.TrackResource(GPU_MEMORY_SCENE_TARGETS, g_pSceneDepthTexture, "Scene Depth");
+
+	return S_OK;
+}
+
+static void DestroyScene()
+{
+	g_GpuMemoryTracker.Untrack(g_pBackBuffer);
+	g_GpuMemoryTracker.Untrack(g_pSceneDepthTexture);
+	SAFE_RELEASE(g_pBackBufferRTV);
+	SAFE_RELEASE(g_pBackBuffer);
+	SAFE_RELEASE(g_pSceneDepthDSV);
+	SAFE_RELEASE(g_pSceneDepthTexture);
+	g_CascadedShadow.DestroyAndDeallocateShadowResources();
+	TrackMeshMemory(&g_GpuMemoryTracker, &g_MeshPowerPlant, false);
+	g_MeshPowerPlant.Destroy();
+}
+
+//--------------------------------------------------------------------------------------
+// A walk around the plant at head height,looking around.Consecutive frames are close to each other.
+//--------------------------------------------------------------------------------------
+static void MoveViewer(int iFrame, int iFrameCount)
+{
+	float t = (float)iFrame / (float)iFrameCount;
+	float fPathAngle = t * XM_2PI;
+	float fYaw = fPathAngle * 3.0f + 0.7f * sinf(fPathAngle * 11.0f);
+	float fPitch = -0.15f + 0.25f * sinf(fPathAngle * 5.0f);
+
+	XMVECTOR vEye = XMVectorSet(180.0f * cosf(fPathAngle), 5.0f + 30.0f * (0.5f + 0.5f * sinf(fPathAngle * 2.0f)), 180.0f * sinf(fPathAngle), 0.0f);
+	XMVECTOR vDirection = XMVectorSet(cosf(fYaw) * cosf(fPitch), sinf(fPitch), sinf(fYaw) * cosf(fPitch), 0.0f);
+	g_ViewerCamera.SetViewParams(vEye, vEye + vDirection);
+}
+
+static void CapturePass(PassRecording* pPass)
+{
+	RecordingDeviceContext* pContext = g_Device.GetRecordingContext();
+	pPass->m_Stats = pContext->GetStats();
+	for (INT i = 0;i < MAX_CASCADES;++i)
+	{
+		pPass->m_nViewportDraws[i] = g_CascadedShadow.IsCascadeTextureArray() ? pContext->GetDrawCountInArraySlice(i, false)
+			: pContext->GetDrawCountInViewport((FLOAT)g_CascadedShadow.GetCascadeAtlasRect(i).m_iX, (FLOAT)g_CascadedShadow.GetCascadeAtlasRect(i).m_iY, false);
+		g_CascadedShadow.GetCasterCounts(i, &pPass->m_nCastersDrawn[i], &pPass->m_nCastersCulled[i]);
+	}
+	pPass->m_nShadowDrawCalls = g_CascadedShadow.GetShadowDrawCallCount();
+	pPass->m_uShadowVertexBytes = g_CascadedShadow.GetShadowVertexBytes();
+	pPass->m_nTriangles = 0;
+	for (INT i = 0;i < MAX_CASCADES;++i)
+	{
+		pPass->m_nTriangles += g_CascadedShadow.GetCascadeTriangleCount(i);
+	}
+
+	pPass->m_nMaxInstances = 0;
+	pPass->m_nMinInstances = UINT_MAX;
+	pPass->m_nMinViewports = UINT_MAX;
+	pPass->m_nRecordedTriangles = 0;
+	pPass->m_Draws.clear();
+	pPass->m_ConstantBufferCommands.clear();
+	const std::vector<RecordedCommand>& commands = pContext->GetCommands();
+	for (size_t i = 0;i < commands.size();++i)
+	{
+		if (commands[i].m_eType == RECORDED_DRAW)
+		{
+			pPass->m_Draws.push_back(commands[i]);
+			pPass->m_nRecordedTriangles += (UINT64)(commands[i].m_uCount / 3) * commands[i].m_nInstances;
+			pPass->m_nMaxInstances = std::max(pPass->m_nMaxInstances, commands[i].m_nInstances);
+			pPass->m_nMinInstances = std::min(pPass->m_nMinInstances, commands[i].m_nInstances);
+			pPass->m_nMinViewports = std::min(pPass->m_nMinViewports, commands[i].m_nViewports);
+		}
+		else if (commands[i].m_eType == RECORDED_MAP || strncmp(commands[i].m_szName, "VSSetConstantBuffers", 20) == 0)
+		{
+			pPass->m_ConstantBufferCommands.push_back(commands[i]);
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// The frame of OnD3D11FrameRender without the HUD and the depth bounds reduction.
+//--------------------------------------------------------------------------------------
+static void RenderFrame(PassRecording* pShadowPass, PassRecording* pScenePass)
+{
+	RecordingDeviceContext* pContext = g_Device.GetRecordingContext();
+
+	pContext->ResetRecording();
+	g_CascadedShadow.InitPerFrame(&g_Device, &g_MeshPowerPlant);
+	g_CascadedShadow.RenderShadowForAllCascades(&g_Device, pContext, &g_MeshPowerPlant);
+	if (pShadowPass)
+	{
+		CapturePass(pShadowPass);
+	}
+
+	D3D11_VIEWPORT vp;
+	vp.Width = (FLOAT)BENCH_BACK_BUFFER_WIDTH;
+	vp.Height = (FLOAT)BENCH_BACK_BUFFER_HEIGHT;
+	vp.MinDepth = 0;
+	vp.MaxDepth = 1;
+	vp.TopLeftX = 0;
+	vp.TopLeftY = 0;
+
+	pContext->ResetRecording();
+	FLOAT ClearColor[4] = { 0.0f,0.25f,0.25f,0.55f };
+	pContext->ClearRenderTargetView(g_pBackBufferRTV, ClearColor);
+	pContext->ClearDepthStencilView(g_pSceneDepthDSV, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+	g_CascadedShadow.RenderScene(pContext, g_pBackBufferRTV, g_pSceneDepthDSV, &g_MeshPowerPlant, &g_ViewerCamera, &vp, FALSE);
+	if (pScenePass)
+	{
+		CapturePass(pScenePass);
+	}
+}
+
+static int CountSubsets()
+{
+	int nSubsetCount = 0;
+	for (UINT iMesh = 0;iMesh < g_MeshPowerPlant.GetNumMeshes();++iMesh)
+	{
+		nSubsetCount += (int)g_MeshPowerPlant.GetNumSubsets(iMesh);
+	}
+	return nSubsetCount;
+}
+
+static int Check(bool bCondition, const char* szWhat)
+{
+	if (!bCondition)
+	{
+		printf("FAILED:%s\n", szWhat);
+		return 1;
+	}
+	return 0;
+}
+
+//--------------------------------------------------------------------------------------
+// Creates the manager again,with or without the cascade ring of constant buffer offsetting.
+//--------------------------------------------------------------------------------------
+static HRESULT RecreateShadowManager(bool bConstantBufferOffsetting)
+{
+	g_CascadedShadow.DestroyAndDeallocateShadowResources();
+	g_Device.SetConstantBufferOffsetting(bConstantBufferOffsetting);
+	return g_CascadedShadow.Init(&g_Device, g_Device.GetRecordingContext(), &g_MeshPowerPlant, &g_ViewerCamera, &g_LightCamera, &g_CascadeConfig);
+}
+
+// Bytes the tracker holds of device objects,the shader blobs are not created by the device.
+static UINT64 GetTrackedDeviceBytes()
+{
+	return g_GpuMemoryTracker.GetLiveBytes() - g_GpuMemoryTracker.GetLiveBytes(GPU_MEMORY_SHADER_BLOBS);
+}
+
+static bool SameDraws(const std::vector<RecordedCommand>& a, const std::vector<RecordedCommand>& b)
+{
+	if (a.size() != b.size())
+	{
+		return false;
+	}
+	for (size_t i = 0;i < a.size();++i)
+	{
+		if (a[i].m_uCount != b[i].m_uCount || a[i].m_nInstances != b[i].m_nInstances || a[i].m_nViewports != b[i].m_nViewports
+			|| a[i].m_fViewportX != b[i].m_fViewportX || a[i].m_fViewportY != b[i].m_fViewportY)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static int VerifyCommandStream()
+{
+	int iResult = 0;
+	int nSubsetCount = CountSubsets();
+	int nCascadeCount = g_CascadeConfig.m_nUsingCascadeLevelsCount;
+	PassRecording shadowPass;
+	PassRecording scenePass;
+
+	// Every cascade is rendered every frame,so each one is fully cleared and no tile is reset with a draw.
+	g_CascadedShadow.m_bCacheCascades = false;
+	MoveViewer(0, 1);
+	iResult |= Check(GetTrackedDeviceBytes() == g_Device.GetLiveResourceBytes(), "the memory tracker holds every byte the device holds");
+	iResult |= Check(g_GpuMemoryTracker.GetLiveCount(GPU_MEMORY_SHADER_BLOBS) > 0, "the manager's shader blobs are tracked");
+
+	for (int iSinglePass = 0;iSinglePass < 2;++iSinglePass)
+	{
+		for (int iCull = 0;iCull < 2;++iCull)
+		{
+			g_CascadedShadow.m_bSinglePassShadows = iSinglePass != 0;
+			g_CascadedShadow.m_bCullShadowCasters = iCull != 0;
+			RenderFrame(&shadowPass, &scenePass);
+
+			int nDrawnSum = 0;
+			for (int i = 0;i < nCascadeCount;++i)
+			{
+				iResult |= Check(shadowPass.m_nCastersDrawn[i] + shadowPass.m_nCastersCulled[i] == nSubsetCount, "every subset is drawn or culled in every cascade");
+				iResult |= Check(iCull != 0 || shadowPass.m_nCastersDrawn[i] == nSubsetCount, "nothing is culled without culling");
+				iResult |= Check(iSinglePass != 0 || (int)shadowPass.m_nViewportDraws[i] == shadowPass.m_nCastersDrawn[i], "the draws in a cascade's viewport are its drawn casters");
+				nDrawnSum += shadowPass.m_nCastersDrawn[i];
+			}
+			iResult |= Check((int)shadowPass.m_Stats.m_nDraws == shadowPass.m_nShadowDrawCalls, "the recorded draws are the draw calls the manager counted");
+
+			if (iSinglePass)
+			{
+				iResult |= Check(shadowPass.m_Stats.m_nDraws <= (UINT)nSubsetCount, "a single pass draws every subset at most once");
+				iResult |= Check(iCull != 0 || shadowPass.m_Stats.m_nDraws == (UINT)nSubsetCount, "a single pass without culling draws every subset once");
+				iResult |= Check(shadowPass.m_nMinInstances == (UINT)nCascadeCount && shadowPass.m_nMaxInstances == (UINT)nCascadeCount,
+					"a single pass draws one instance per cascade");
+				iResult |= Check(shadowPass.m_nMinViewports == (UINT)nCascadeCount, "a single pass binds the viewports of all cascades");
+				iResult |= Check(shadowPass.m_Stats.m_uBytesUploaded == sizeof(CB_SHADOW_CASCADES), "a single pass uploads the cascade matrices once");
+			}
+			else
+			{
+				iResult |= Check((int)shadowPass.m_Stats.m_nDraws == nDrawnSum, "per cascade draws add up");
+				iResult |= Check(shadowPass.m_nMaxInstances == 1, "per cascade draws are not instanced");
+				// The device does not report constant buffer offsetting yet,so every cascade maps a buffer of its own.
+				iResult |= Check(shadowPass.m_Stats.m_uBytesUploaded == sizeof(CB_PER_CASCADE) * nCascadeCount, "one view projection upload per cascade");
+			}
+
+			iResult |= Check(scenePass.m_Stats.m_nDraws > 0, "the scene pass draws");
+			iResult |= Check(scenePass.m_Stats.m_uBytesUploaded == sizeof(CB_PER_OBJECT) + sizeof(CB_SHADOW_FRAME), "the scene pass uploads its constants once");
+			printf("%s / %s:%u shadow draws,%u instances,%u of %u state changes redundant\n", iSinglePass ? "single pass" : "per cascade",
+				iCull ? "culling" : "no culling", shadowPass.m_Stats.m_nDraws, shadowPass.m_Stats.m_nInstances,
+				shadowPass.m_Stats.m_nRedundantStateChanges, shadowPass.m_Stats.m_nStateChanges);
+		}
+	}
+
+	// Executed in cascade order,the command lists recorded on the job pool draw and upload what the immediate
+	// context does,only the state every list binds again differs.
+	g_CascadedShadow.m_bSinglePassShadows = false;
+	for (int iCull = 0;iCull < 2;++iCull)
+	{
+		PassRecording multithreadedPass;
+		g_CascadedShadow.m_bCullShadowCasters = iCull != 0;
+		g_CascadedShadow.m_bMultithreadedShadows = false;
+		RenderFrame(&shadowPass, nullptr);
+		g_CascadedShadow.m_bMultithreadedShadows = true;
+		RenderFrame(&multithreadedPass, nullptr);
+		g_CascadedShadow.m_bMultithreadedShadows = false;
+
+		iResult |= Check(SameDraws(shadowPass.m_Draws, multithreadedPass.m_Draws), "the job pool records the draws of the immediate context");
+		iResult |= Check(multithreadedPass.m_Stats.m_uBytesUploaded == shadowPass.m_Stats.m_uBytesUploaded, "the job pool uploads what the immediate context does");
+		iResult |= Check(multithreadedPass.m_nShadowDrawCalls == shadowPass.m_nShadowDrawCalls, "the job pool counts the same draw calls");
+		for (int i = 0;i < nCascadeCount;++i)
+		{
+			iResult |= Check(multithreadedPass.m_nViewportDraws[i] == shadowPass.m_nViewportDraws[i], "the job pool draws into the same viewports");
+		}
+		printf("job pool / %s:%u shadow draws,%u of %u state changes redundant\n", iCull ? "culling" : "no culling",
+			multithreadedPass.m_Stats.m_nDraws, multithreadedPass.m_Stats.m_nRedundantStateChanges, multithreadedPass.m_Stats.m_nStateChanges);
+	}
+
+	// The casters are drawn from the position stream,the same draws fetch a fraction of the interleaved bytes.
+	UINT uInterleavedStride = g_MeshPowerPlant.GetVertexStride(0, 0);
+	bool bPositionStreams = true;
+	bool bSameStride = true;
+	for (UINT iMesh = 0;iMesh < g_MeshPowerPlant.GetNumMeshes();++iMesh)
+	{
+		bPositionStreams &= g_MeshPowerPlant.GetPositionVB11(iMesh) != nullptr;
+		bSameStride &= g_MeshPowerPlant.GetVertexStride(iMesh, 0) == uInterleavedStride;
+	}
+	iResult |= Check(bPositionStreams, "every mesh has a position stream");
+	for (int iSinglePass = 0;iSinglePass < 2;++iSinglePass)
+	{
+		PassRecording interleavedPass;
+		g_CascadedShadow.m_bSinglePassShadows = iSinglePass != 0;
+		g_CascadedShadow.m_bCullShadowCasters = true;
+		g_CascadedShadow.m_bPositionOnlyCasters = false;
+		RenderFrame(&interleavedPass, nullptr);
+		g_CascadedShadow.m_bPositionOnlyCasters = true;
+		RenderFrame(&shadowPass, nullptr);
+
+		bool bPositionStrides = true;
+		for (size_t i = 0;i < shadowPass.m_Draws.size();++i)
+		{
+			bPositionStrides &= shadowPass.m_Draws[i].m_uVertexStride == CDXUTSDKMesh::GetPositionStride();
+		}
+		iResult |= Check(SameDraws(shadowPass.m_Draws, interleavedPass.m_Draws), "the position stream draws what the interleaved vertices draw");
+		iResult |= Check(bPositionStrides, "every shadow draw reads the position stream");
+		iResult |= Check(!bSameStride || shadowPass.m_uShadowVertexBytes * uInterleavedStride == interleavedPass.m_uShadowVertexBytes * CDXUTSDKMesh::GetPositionStride(),
+			"the position stream fetches the position alone");
+		printf("position stream / %s:%llu of %llu vertex bytes fetched\n", iSinglePass ? "single pass" : "per cascade",
+			(unsigned long long)shadowPass.m_uShadowVertexBytes, (unsigned long long)interleavedPass.m_uShadowVertexBytes);
+	}
+
+	// The caster levels only change the indices a draw reads,the subsets drawn and their vertices stay the same.
+	for (int iSinglePass = 0;iSinglePass < 2;++iSinglePass)
+	{
+		PassRecording lodPass;
+		g_CascadedShadow.m_bSinglePassShadows = iSinglePass != 0;
+		g_CascadedShadow.m_bCasterLods = false;
+		RenderFrame(&shadowPass, nullptr);
+		g_CascadedShadow.m_bCasterLods = true;
+		g_CascadedShadow.m_fCasterLodTexels = 2.0f;
+		RenderFrame(&lodPass, nullptr);
+		g_CascadedShadow.m_bCasterLods = false;
+		g_CascadedShadow.m_fCasterLodTexels = 1.0f;
+
+		iResult |= Check(lodPass.m_Stats.m_nDraws == shadowPass.m_Stats.m_nDraws && lodPass.m_nShadowDrawCalls == shadowPass.m_nShadowDrawCalls,
+			"the caster levels draw the same subsets");
+		iResult |= Check(lodPass.m_uShadowVertexBytes == shadowPass.m_uShadowVertexBytes, "the caster levels draw from the same vertices");
+		iResult |= Check(shadowPass.m_nRecordedTriangles == shadowPass.m_nTriangles && lodPass.m_nRecordedTriangles == lodPass.m_nTriangles,
+			"the recorded triangles are the ones the manager counted");
+		iResult |= Check(lodPass.m_nTriangles <= shadowPass.m_nTriangles, "the caster levels draw at most the full triangles");
+		printf("caster lods / %s:%llu -> %llu shadow triangles,%llu bytes of level indices\n", iSinglePass ? "single pass" : "per cascade",
+			(unsigned long long)shadowPass.m_nTriangles, (unsigned long long)lodPass.m_nTriangles, (unsigned long long)g_CascadedShadow.GetCasterLodBytes());
+	}
+
+	// The sub-texel culling only takes casters out of the cascades,every one it counted is a draw less.
+	{
+		PassRecording smallPass;
+		g_CascadedShadow.m_bSinglePassShadows = false;
+		RenderFrame(&shadowPass, nullptr);
+		g_CascadedShadow.m_fMinCasterTexels = 2.0f;
+		RenderFrame(&smallPass, nullptr);
+		int nSmallCount = 0;
+		for (int i = 0;i < nCascadeCount;++i)
+		{
+			int nCascadeSmallCount = g_CascadedShadow.GetSmallCasterCount(i);
+			iResult |= Check(smallPass.m_nCastersDrawn[i] + nCascadeSmallCount == shadowPass.m_nCastersDrawn[i],
+				"the sub-texel casters are the only ones left out");
+			iResult |= Check((int)smallPass.m_nViewportDraws[i] == smallPass.m_nCastersDrawn[i], "the draws in a cascade's viewport are its drawn casters");
+			nSmallCount += nCascadeSmallCount;
+		}
+		g_CascadedShadow.m_fMinCasterTexels = 0.0f;
+		RenderFrame(&shadowPass, nullptr);
+		for (int i = 0;i < nCascadeCount;++i)
+		{
+			iResult |= Check(g_CascadedShadow.GetSmallCasterCount(i) == 0, "no caster is left out without a footprint");
+		}
+		printf("sub-texel casters / 2 texels:%d of %u draws left out\n", nSmallCount, shadowPass.m_Stats.m_nDraws);
+	}
+
+	// In a texture array every cascade is drawn into its own slice with the draws of its atlas tile,through the
+	// slice's view or routed by the single pass,and the shadow map takes the same memory.
+	{
+		static const ShadowMode modes[] =
+		{
+			{ "per cascade", false, true, false },
+			{ "job pool", false, true, true },
+			{ "single pass", true, true, false },
+		};
+		PassRecording atlasPass;
+		PassRecording atlasScenePass;
+		for (int iMode = 0;iMode < (int)(sizeof(modes) / sizeof(modes[0]));++iMode)
+		{
+			g_CascadedShadow.m_bSinglePassShadows = modes[iMode].m_bSinglePass;
+			g_CascadedShadow.m_bCullShadowCasters = modes[iMode].m_bCull;
+			g_CascadedShadow.m_bMultithreadedShadows = modes[iMode].m_bMultithreaded;
+
+			g_CascadeConfig.m_bCascadeTextureArray = false;
+			RenderFrame(&atlasPass, &atlasScenePass);
+			UINT64 uAtlasMapBytes = g_CascadedShadow.GetShadowMapBytes();
+			g_CascadeConfig.m_bCascadeTextureArray = true;
+			RenderFrame(&shadowPass, &scenePass);
+
+			iResult |= Check(g_CascadedShadow.IsCascadeTextureArray(), "the cascades are stored in a texture array when asked to");
+			iResult |= Check(!modes[iMode].m_bSinglePass || SameDraws(shadowPass.m_Draws, atlasPass.m_Draws),
+				"a single pass into a texture array submits the draws of the atlas");
+			iResult |= Check(shadowPass.m_Stats.m_nDraws == atlasPass.m_Stats.m_nDraws && shadowPass.m_nTriangles == atlasPass.m_nTriangles,
+				"a texture array draws what the atlas draws");
+			for (int i = 0;i < nCascadeCount;++i)
+			{
+				iResult |= Check(modes[iMode].m_bSinglePass || shadowPass.m_nViewportDraws[i] == atlasPass.m_nViewportDraws[i],
+					"each slice gets the draws of its atlas tile");
+			}
+			iResult |= Check(g_CascadedShadow.GetShadowMapBytes() == uAtlasMapBytes, "a texture array takes the memory of the atlas");
+			iResult |= Check(scenePass.m_Stats.m_nDraws == atlasScenePass.m_Stats.m_nDraws && scenePass.m_Stats.m_uBytesUploaded == atlasScenePass.m_Stats.m_uBytesUploaded,
+				"the scene pass reads a texture array with the draws and constants of the atlas");
+		}
+		g_CascadedShadow.m_bSinglePassShadows = false;
+		g_CascadedShadow.m_bMultithreadedShadows = false;
+		g_CascadeConfig.m_bCascadeTextureArray = false;
+
+		// Side by side wider than a texture can be,the cascades go into a texture array anyway.
+		if (nCascadeCount > 1)
+		{
+			int iSize = g_CascadeConfig.m_iLengthOfShadowBufferSquare;
+			g_CascadeConfig.m_iLengthOfShadowBufferSquare = D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION / nCascadeCount + 32;
+			RenderFrame(nullptr, nullptr);
+			iResult |= Check(g_CascadedShadow.IsCascadeTextureArray(), "cascades wider than a texture are stored in a texture array");
+			g_CascadeConfig.m_iLengthOfShadowBufferSquare = iSize;
+		}
+		RenderFrame(nullptr, nullptr);
+		iResult |= Check(!g_CascadedShadow.IsCascadeTextureArray(), "the atlas is allocated again");
+		printf("texture array / %d cascades:%u shadow draws,%llu bytes either way\n", nCascadeCount, shadowPass.m_Stats.m_nDraws,
+			(unsigned long long)g_CascadedShadow.GetShadowMapBytes());
+	}
+
+	// Tiles of halving length are packed into a smaller atlas and every cascade draws into the viewport of its
+	// rect.In a texture array every slice is as large as the longest tile.
+	if (nCascadeCount > 1)
+	{
+		UINT64 uEqualMapBytes = g_CascadedShadow.GetShadowMapBytes();
+		AtlasPacking::GetHalvingCascadeLengths(g_CascadeConfig.m_iLengthOfShadowBufferSquare, nCascadeCount, 128,
+			g_CascadeConfig.m_iCascadeLengthOfShadowBuffer);
+		RenderFrame(&shadowPass, nullptr);
+
+		INT iAtlasWidth = g_CascadedShadow.GetShadowAtlasWidth();
+		INT iAtlasHeight = g_CascadedShadow.GetShadowAtlasHeight();
+		AtlasRect rects[MAX_CASCADES];
+		for (int i = 0;i < nCascadeCount;++i)
+		{
+			rects[i] = g_CascadedShadow.GetCascadeAtlasRect(i);
+			iResult |= Check(rects[i].m_iWidth == g_CascadeConfig.m_iCascadeLengthOfShadowBuffer[i] && rects[i].m_iHeight == rects[i].m_iWidth,
+				"every cascade gets a tile of its length");
+			iResult |= Check((int)shadowPass.m_nViewportDraws[i] == shadowPass.m_nCastersDrawn[i], "each cascade draws into the viewport of its packed tile");
+		}
+		iResult |= Check(AtlasPacking::AreRectsDisjointInAtlas(rects, nCascadeCount, iAtlasWidth, iAtlasHeight), "the packed tiles do not overlap");
+		UINT64 uPackedMapBytes = g_CascadedShadow.GetShadowMapBytes();
+		iResult |= Check(uPackedMapBytes == (UINT64)iAtlasWidth * iAtlasHeight * sizeof(FLOAT) && uPackedMapBytes < uEqualMapBytes,
+			"the packed atlas is smaller than the atlas of equal tiles");
+
+		g_CascadeConfig.m_bCascadeTextureArray = true;
+		RenderFrame(&shadowPass, nullptr);
+		for (int i = 0;i < nCascadeCount;++i)
+		{
+			iResult |= Check(g_CascadedShadow.GetCascadeAtlasRect(i).m_iX == 0 && g_CascadedShadow.GetCascadeAtlasRect(i).m_iY == 0,
+				"a tile takes the top left of its slice");
+			iResult |= Check((int)shadowPass.m_nViewportDraws[i] == shadowPass.m_nCastersDrawn[i], "each slice gets the casters of its cascade");
+		}
+		iResult |= Check(g_CascadedShadow.GetShadowMapBytes() == (UINT64)iAtlasHeight * iAtlasHeight * nCascadeCount * sizeof(FLOAT),
+			"the slices are as large as the longest tile");
+
+		g_CascadeConfig.m_bCascadeTextureArray = false;
+		memset(g_CascadeConfig.m_iCascadeLengthOfShadowBuffer, 0, sizeof(g_CascadeConfig.m_iCascadeLengthOfShadowBuffer));
+		RenderFrame(nullptr, nullptr);
+		iResult |= Check(g_CascadedShadow.GetShadowMapBytes() == uEqualMapBytes, "the atlas of equal tiles is allocated again");
+		printf("halving tiles / %d cascades:%dx%d atlas,%llu of %llu bytes\n", nCascadeCount, iAtlasWidth, iAtlasHeight,
+			(unsigned long long)uPackedMapBytes, (unsigned long long)uEqualMapBytes);
+	}
+
+	// The shadow map picked for a budget has to allocate the bytes it was picked for.
+	{
+		ShadowBudgetParams budget;
+		budget.m_iBudgetBytes = 16LL * 1024 * 1024;
+		budget.m_fTargetTexelsPerPixel = 0.03f;
+		budget.m_iScreenHeight = 1080;
+		budget.m_nMaxCascadeCount = MAX_CASCADES;
+		budget.m_iMinLength = 128;
+		budget.m_iMaxLength = 4096;
+		budget.m_iMaxTextureLength = D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION;
+		budget.m_bHalvingLengths = nCascadeCount > 2;
+		budget.m_bStaticLayer = false;
+		ShadowBudgetChoice choice;
+		g_CascadedShadow.SelectShadowBudgetConfig(budget, &choice);
+
+		CascadeConfig savedConfig = g_CascadeConfig;
+		CASCADE_SPLIT_MODE eSavedSplitMode = g_CascadedShadow.m_eCascadeSplitMode;
+		g_CascadedShadow.m_eCascadeSplitMode = CASCADE_SPLIT_PRACTICAL;
+		g_CascadeConfig.m_nUsingCascadeLevelsCount = choice.m_nCascadeCount;
+		g_CascadeConfig.m_iLengthOfShadowBufferSquare = choice.m_iLengthOfShadowBufferSquare;
+		memcpy(g_CascadeConfig.m_iCascadeLengthOfShadowBuffer, choice.m_iCascadeLengthOfShadowBuffer, sizeof(g_CascadeConfig.m_iCascadeLengthOfShadowBuffer));
+		g_CascadeConfig.m_ShadowBufferFormat = choice.m_iBytesPerTexel == 4 ? CASCADE_DXGI_FORMAT_R32_TYPELESS : CASCADE_DXGI_FORMAT_R16_TYPELESS;
+		RenderFrame(&shadowPass, nullptr);
+
+		UINT64 uSliceTexels = (UINT64)g_CascadedShadow.GetShadowAtlasWidth() * g_CascadedShadow.GetShadowAtlasHeight();
+		UINT64 uTexels = uSliceTexels * (g_CascadedShadow.IsCascadeTextureArray() ? choice.m_nCascadeCount : 1);
+		iResult |= Check(choice.m_bFitsBudget && (long long)g_CascadedShadow.GetShadowMapBytes() == choice.m_iBytes,
+			"the budget's shadow map allocates the bytes it was picked for");
+		iResult |= Check(g_CascadedShadow.GetShadowMapBytes() == uTexels * choice.m_iBytesPerTexel, "the budget's depth format is allocated");
+		for (int i = 0;i < choice.m_nCascadeCount;++i)
+		{
+			iResult |= Check((int)shadowPass.m_nViewportDraws[i] == shadowPass.m_nCastersDrawn[i], "each cascade of the budget draws into its tile");
+		}
+		printf("budget / 16 MB:%d cascades of %d,%d bit,%llu bytes,%0.3f texels/pixel\n", choice.m_nCascadeCount,
+			choice.m_iLengthOfShadowBufferSquare, choice.m_iBytesPerTexel * 8, (unsigned long long)g_CascadedShadow.GetShadowMapBytes(),
+			choice.m_fMinTexelsPerPixel);
+
+		g_CascadeConfig = savedConfig;
+		g_CascadedShadow.m_eCascadeSplitMode = eSavedSplitMode;
+		RenderFrame(nullptr, nullptr);
+	}
+
+	// A reconfig gives the shadow map back to the pool,so once two configs were allocated toggling between them
+	// creates no object at all,the samplers included.The texture given back outlives the frame that replaced it
+	// and is released after it was idle for SHADOW_TEXTURE_POOL_IDLE_FRAMES.
+	{
+		const ShadowTexturePool& pool = g_CascadedShadow.GetShadowTexturePool();
+		int iSize = g_CascadeConfig.m_iLengthOfShadowBufferSquare;
+		g_CascadeConfig.m_iLengthOfShadowBufferSquare = iSize / 2;
+		RenderFrame(nullptr, nullptr);
+		g_CascadeConfig.m_iLengthOfShadowBufferSquare = iSize;
+		RenderFrame(nullptr, nullptr);
+
+		UINT nCreatedTextures = pool.GetCreatedCount();
+		UINT nReusedTextures = pool.GetReusedCount();
+		UINT nCreatedObjects = g_Device.GetCreatedObjectCount();
+		for (int iToggle = 0;iToggle < 4;++iToggle)
+		{
+			g_CascadeConfig.m_iLengthOfShadowBufferSquare = (iToggle & 1) == 0 ? iSize / 2 : iSize;
+			RenderFrame(&shadowPass, nullptr);
+			iResult |= Check(pool.GetIdleBytes() > 0, "the replaced shadow map outlives the frame that replaced it");
+			iResult |= Check(g_GpuMemoryTracker.GetLiveBytes(GPU_MEMORY_SHADOW_MAP) == pool.GetPooledBytes(), "the tracker holds the pooled shadow maps");
+			for (int i = 0;i < nCascadeCount;++i)
+			{
+				iResult |= Check((int)shadowPass.m_nViewportDraws[i] == shadowPass.m_nCastersDrawn[i], "a pooled shadow map draws each cascade into its tile");
+			}
+		}
+		iResult |= Check(pool.GetCreatedCount() == nCreatedTextures && pool.GetReusedCount() == nReusedTextures + 4,
+			"toggling between two configs takes their shadow maps from the pool");
+		iResult |= Check(g_Device.GetCreatedObjectCount() == nCreatedObjects, "a reconfig from the pool creates no device object");
+
+		UINT64 uIdleBytes = pool.GetIdleBytes();
+		for (int iFrame = 0;iFrame <= SHADOW_TEXTURE_POOL_IDLE_FRAMES;++iFrame)
+		{
+			RenderFrame(nullptr, nullptr);
+		}
+		iResult |= Check(pool.GetIdleBytes() == 0 && pool.GetPooledBytes() == g_CascadedShadow.GetShadowMapBytes(),
+			"an idle shadow map is released after SHADOW_TEXTURE_POOL_IDLE_FRAMES");
+		iResult |= Check(g_GpuMemoryTracker.GetLiveBytes(GPU_MEMORY_SHADOW_MAP) == pool.GetPooledBytes()
+			&& g_GpuMemoryTracker.GetHighWaterBytes(GPU_MEMORY_SHADOW_MAP) >= pool.GetPooledBytes() + uIdleBytes,
+			"the tracker forgets the released shadow map and keeps its high water mark");
+		printf("texture pool / %d and %d:%u shadow maps created,%u taken again,%llu idle bytes released after %d frames\n", iSize / 2, iSize,
+			pool.GetCreatedCount(), pool.GetReusedCount(), (unsigned long long)uIdleBytes, SHADOW_TEXTURE_POOL_IDLE_FRAMES);
+	}
+
+	// With the cache a frame that changes nothing renders no cascade.
+	g_CascadedShadow.m_bCacheCascades = true;
+	g_CascadedShadow.m_bSinglePassShadows = false;
+	g_CascadedShadow.m_bCullShadowCasters = true;
+	RenderFrame(nullptr, nullptr);
+	RenderFrame(&shadowPass, nullptr);
+	iResult |= Check(shadowPass.m_Stats.m_nDraws == 0 && shadowPass.m_Stats.m_uBytesUploaded == 0, "an unchanged frame draws and uploads nothing");
+
+	// With the last mesh dynamic an unchanged frame copies the static casters into the tiles and draws only that mesh.
+	// The slices of a texture array are copied,the tiles of an atlas are drawn over with the static layer's depth.
+	UINT iDynamicMesh = g_MeshPowerPlant.GetNumMeshes() - 1;
+	int nDynamicSubsetCount = (int)g_MeshPowerPlant.GetNumSubsets(iDynamicMesh);
+	bool bCopySlices = g_CascadedShadow.IsCascadeTextureArray();
+	UINT64 uTileBytes = bCopySlices ? (UINT64)g_CascadeConfig.m_iLengthOfShadowBufferSquare * g_CascadeConfig.m_iLengthOfShadowBufferSquare * nCascadeCount * sizeof(FLOAT) : 0;
+	UINT nCopyDraws = bCopySlices ? 0 : (UINT)nCascadeCount;
+	g_CascadedShadow.m_bCullShadowCasters = false;
+	g_CascadedShadow.SetDynamicCaster(iDynamicMesh, true);
+	RenderFrame(&shadowPass, nullptr);
+	for (int i = 0;i < nCascadeCount;++i)
+	{
+		iResult |= Check(shadowPass.m_nCastersDrawn[i] == nSubsetCount, "the first frame with a dynamic mesh draws the static and the dynamic casters");
+	}
+	RenderFrame(&shadowPass, nullptr);
+	iResult |= Check(shadowPass.m_Stats.m_nDraws == (UINT)(nDynamicSubsetCount * nCascadeCount) + nCopyDraws, "an unchanged frame only draws the dynamic casters");
+	iResult |= Check(shadowPass.m_Stats.m_uBytesCopied == uTileBytes, "the static layer is copied into each tile once");
+	iResult |= Check(shadowPass.m_Stats.m_uBytesUploaded == sizeof(CB_PER_CASCADE) * nCascadeCount, "the dynamic casters upload every view projection");
+	printf("static layer / %d dynamic subsets:%u shadow draws,%llu bytes copied\n", nDynamicSubsetCount, shadowPass.m_Stats.m_nDraws,
+		(unsigned long long)shadowPass.m_Stats.m_uBytesCopied);
+
+	// With culling only the tiles the dynamic mesh casts into are copied and drawn over,once the tiles it was drawn
+	// into without culling were reset on the frame before.
+	g_CascadedShadow.m_bCullShadowCasters = true;
+	RenderFrame(nullptr, nullptr);
+	RenderFrame(&shadowPass, nullptr);
+	UINT nReachedCount = 0;
+	for (int i = 0;i < nCascadeCount;++i)
+	{
+		UINT nCopied = shadowPass.m_nCastersDrawn[i] > 0 ? 1 : 0;
+		nReachedCount += nCopied;
+		iResult |= Check(bCopySlices || shadowPass.m_nViewportDraws[i] == (UINT)shadowPass.m_nCastersDrawn[i] + nCopied,
+			"an atlas tile is only drawn over when the dynamic casters reach it");
+	}
+	iResult |= Check(shadowPass.m_Stats.m_uBytesCopied == uTileBytes / nCascadeCount * nReachedCount, "a slice is only copied when the dynamic casters reach it");
+	g_CascadedShadow.m_bCullShadowCasters = false;
+
+	g_CascadedShadow.SetDynamicCaster(iDynamicMesh, false);
+	RenderFrame(nullptr, nullptr);
+	RenderFrame(&shadowPass, nullptr);
+	iResult |= Check(shadowPass.m_Stats.m_nDraws == 0 && shadowPass.m_Stats.m_uBytesCopied == 0, "without dynamic casters an unchanged frame draws nothing again");
+
+	// Scrolled tiles are drawn in scissored pieces,which have to be counted like any other draw.Whether a cascade
+	// scrolls depends on its near/far,so only the counts are checked.
+	g_CascadedShadow.m_bCullShadowCasters = true;
+	g_CascadedShadow.m_bScrollCascades = true;
+	int nScrolledCount = 0;
+	UINT nScrollDraws = 0;
+	for (int iFrame = 0;iFrame < 64;++iFrame)
+	{
+		MoveViewer(iFrame, 4096);
+		RenderFrame(&shadowPass, &scenePass);
+		nScrolledCount += g_CascadedShadow.GetScrollCascadeCount();
+		nScrollDraws += shadowPass.m_Stats.m_nDraws;
+		iResult |= Check((int)shadowPass.m_Stats.m_nDraws == shadowPass.m_nShadowDrawCalls, "scrolled frames draw what the manager counted");
+		iResult |= Check(scenePass.m_Stats.m_uBytesUploaded == sizeof(CB_PER_OBJECT) + sizeof(CB_SHADOW_FRAME), "scrolled frames upload the scene constants once");
+	}
+	RenderFrame(&shadowPass, nullptr);
+	iResult |= Check(shadowPass.m_Stats.m_nDraws == 0 && g_CascadedShadow.GetScrollCascadeCount() == 0, "an unchanged frame after scrolling draws nothing");
+
+	// The single pass can't draw wrapped tiles,so it renders them again instead of scrolling.
+	g_CascadedShadow.m_bSinglePassShadows = true;
+	RenderFrame(&shadowPass, nullptr);
+	iResult |= Check((int)shadowPass.m_Stats.m_nDraws == shadowPass.m_nShadowDrawCalls, "a single pass frame after scrolling draws what the manager counted");
+	iResult |= Check(g_CascadedShadow.GetScrollCascadeCount() == 0, "a single pass frame does not scroll");
+	g_CascadedShadow.m_bSinglePassShadows = false;
+	g_CascadedShadow.m_bScrollCascades = false;
+	printf("scrolling / 64 frames:%d cascades scrolled,%u shadow draws\n", nScrolledCount, nScrollDraws);
+
+#ifdef USE_DIRECT3D11_1
+	// With constant buffer offsetting the manager is created again with the cascade ring.Every frame maps the ring
+	// once and each cascade binds the 16 constants of the next slot,the ring is only discarded when the slots of a
+	// frame no longer fit behind the last frame's.A frame that does not discard uploads only the view projections it
+	// writes.The job pool binds the slots on its deferred contexts.
+	{
+		iResult |= Check(SUCCEEDED(RecreateShadowManager(true)), "the manager is created on a device with constant buffer offsetting");
+
+		g_CascadedShadow.m_bCacheCascades = false;
+		g_CascadedShadow.m_bSinglePassShadows = false;
+		const UINT uRingBytes = CB_PER_CASCADE_SLOT_SIZE * CASCADE_CONSTANT_RING_SLOTS;
+		UINT uNextSlot = CASCADE_CONSTANT_RING_SLOTS;
+		int nDiscards = 0;
+		int nFrameCount = 2 * CASCADE_CONSTANT_RING_SLOTS / nCascadeCount + 1;
+		for (int iFrame = 0;iFrame < nFrameCount;++iFrame)
+		{
+			g_CascadedShadow.m_bMultithreadedShadows = (iFrame & 1) != 0;
+			RenderFrame(&shadowPass, nullptr);
+
+			bool bWraps = uNextSlot + (UINT)nCascadeCount > CASCADE_CONSTANT_RING_SLOTS;
+			if (bWraps)
+			{
+				uNextSlot = 0;
+			}
+
+			UINT nRingMaps = 0;
+			UINT nSlotBinds = 0;
+			bool bDiscarded = false;
+			bool bNextSlots = true;
+			for (size_t i = 0;i < shadowPass.m_ConstantBufferCommands.size();++i)
+			{
+				const RecordedCommand& command = shadowPass.m_ConstantBufferCommands[i];
+				if (command.m_eType == RECORDED_MAP)
+				{
+					++nRingMaps;
+					bDiscarded = command.m_eMapType == D3D11_MAP_WRITE_DISCARD;
+					bNextSlots &= command.m_eMapType == D3D11_MAP_WRITE_DISCARD || command.m_eMapType == D3D11_MAP_WRITE_NO_OVERWRITE;
+				}
+				else if (strcmp(command.m_szName, "VSSetConstantBuffers1") == 0)
+				{
+					bNextSlots &= command.m_uFirstConstant == (uNextSlot + nSlotBinds) * CB_PER_CASCADE_SLOT_CONSTANTS
+						&& command.m_uNumConstants == CB_PER_CASCADE_SLOT_CONSTANTS;
+					++nSlotBinds;
+				}
+			}
+			iResult |= Check(nRingMaps == 1, "a frame maps the cascade ring once");
+			iResult |= Check(bDiscarded == bWraps, "the ring is discarded when it wraps and only then");
+			iResult |= Check(shadowPass.m_Stats.m_uBytesUploaded == (bWraps ? uRingBytes : sizeof(CB_PER_CASCADE) * nCascadeCount),
+				"the ring uploads the view projections it writes,and all of it when it is discarded");
+			iResult |= Check(nSlotBinds == (UINT)nCascadeCount && bNextSlots, "each cascade binds the constants of the next slot of the ring");
+			for (int i = 0;i < nCascadeCount;++i)
+			{
+				iResult |= Check((int)shadowPass.m_nViewportDraws[i] == shadowPass.m_nCastersDrawn[i], "the draws in a cascade's viewport are its drawn casters");
+			}
+			uNextSlot += (UINT)nCascadeCount;
+			nDiscards += bDiscarded ? 1 : 0;
+		}
+		g_CascadedShadow.m_bMultithreadedShadows = false;
+		printf("constant ring / %d slots:%d frames,%d discards\n", CASCADE_CONSTANT_RING_SLOTS, nFrameCount, nDiscards);
+	}
+#endif
+
+	iResult |= Check(GetTrackedDeviceBytes() == g_Device.GetLiveResourceBytes(), "the memory tracker still holds every byte the device holds");
+	printf("memory / %llu device bytes in %d objects,%llu tracked\n", (unsigned long long)g_Device.GetLiveResourceBytes(),
+		g_Device.GetLiveObjectCount(), (unsigned long long)GetTrackedDeviceBytes());
+
+	printf("%d subsets,%d cascades,%s\n", nSubsetCount, nCascadeCount, iResult ? "FAILED" : "command streams match");
+	return iResult;
+}
+
+struct ShadowMode
+{
+	const char* m_szName;
+	bool m_bSinglePass;
+	bool m_bCull;
+	bool m_bMultithreaded;
+};
+
+//--------------------------------------------------------------------------------------
+// A still viewer with the last mesh dynamic:the static casters stay cached and only the dynamic mesh is drawn,
+// next to a frame that draws everything.
+//--------------------------------------------------------------------------------------
+static void ReportStaticLayer(int iFrameCount, int iPassCount)
+{
+	UINT iDynamicMesh = g_MeshPowerPlant.GetNumMeshes() - 1;
+	g_CascadedShadow.m_bSinglePassShadows = false;
+	g_CascadedShadow.m_bMultithreadedShadows = false;
+	g_CascadedShadow.m_bCullShadowCasters = true;
+	MoveViewer(0, 1);
+
+	printf("\n%-26s %9s %7s %12s\n", "still viewer", "shadow us", "draws", "bytes copied");
+	for (int iMode = 0;iMode < 3;++iMode)
+	{
+		static const char* szModes[] = { "no cache", "cache / all static", "cache / last mesh dynamic" };
+		g_CascadedShadow.m_bCacheCascades = iMode != 0;
+		g_CascadedShadow.SetDynamicCaster(iDynamicMesh, iMode == 2);
+		RenderFrame(nullptr, nullptr);
+
+		double fBestMilliseconds = 1e30;
+		PassRecording shadowPass;
+		for (int iPass = 0;iPass < iPassCount;++iPass)
+		{
+			double fMilliseconds = 0.0;
+			for (int iFrame = 0;iFrame < iFrameCount;++iFrame)
+			{
+				RenderFrame(&shadowPass, nullptr);
+				fMilliseconds += g_CascadedShadow.GetShadowRecordMilliseconds();
+			}
+			fBestMilliseconds = std::min(fBestMilliseconds, fMilliseconds);
+		}
+
+		printf("%-26s %9.1f %7u %12llu\n", szModes[iMode], fBestMilliseconds * 1e3 / (double)iFrameCount, shadowPass.m_Stats.m_nDraws,
+			(unsigned long long)shadowPass.m_Stats.m_uBytesCopied);
+	}
+
+	g_CascadedShadow.SetDynamicCaster(iDynamicMesh, false);
+	g_CascadedShadow.m_bCacheCascades = false;
+}
+
+//--------------------------------------------------------------------------------------
+// What the position stream costs in memory against the vertex bytes the shadow pass stops fetching,with every
+// cascade rendered every frame.
+//--------------------------------------------------------------------------------------
+static void ReportPositionStream(int iFrameCount)
+{
+	g_CascadedShadow.m_bSinglePassShadows = false;
+	g_CascadedShadow.m_bMultithreadedShadows = false;
+	g_CascadedShadow.m_bCullShadowCasters = true;
+	g_CascadedShadow.m_bCacheCascades = false;
+
+	double fBytes[2] = { 0.0,0.0 };
+	for (int iMode = 0;iMode < 2;++iMode)
+	{
+		g_CascadedShadow.m_bPositionOnlyCasters = iMode != 0;
+		for (int iFrame = 0;iFrame < iFrameCount;++iFrame)
+		{
+			MoveViewer(iFrame, iFrameCount);
+			RenderFrame(nullptr, nullptr);
+			fBytes[iMode] += (double)g_CascadedShadow.GetShadowVertexBytes();
+		}
+		fBytes[iMode] /= (double)iFrameCount;
+	}
+	g_CascadedShadow.m_bPositionOnlyCasters = false;
+
+	double fStreamBytes = (double)g_MeshPowerPlant.GetPositionStreamBytes();
+	printf("\nposition stream:%.0f KB on top of %.0f KB of vertices,shadow vertex fetch %.0f KB -> %.0f KB per frame,"
+		"the extra memory is fetched less in %.1f frames\n", fStreamBytes / 1024.0, (double)g_MeshPowerPlant.GetVertexBufferBytes() / 1024.0,
+		fBytes[0] / 1024.0, fBytes[1] / 1024.0, fStreamBytes / std::max(fBytes[0] - fBytes[1], 1.0));
+}
+
+//--------------------------------------------------------------------------------------
+// The triangles drawn into each cascade over the walk without the caster levels and at a few thresholds,with every
+// cascade rendered every frame.
+//--------------------------------------------------------------------------------------
+static void ReportCasterLods(int iFrameCount)
+{
+	g_CascadedShadow.m_bSinglePassShadows = false;
+	g_CascadedShadow.m_bMultithreadedShadows = false;
+	g_CascadedShadow.m_bCullShadowCasters = true;
+	g_CascadedShadow.m_bCacheCascades = false;
+
+	printf("\n%-26s %9s", "caster lods", "shadow us");
+	for (int i = 0;i < g_CascadeConfig.m_nUsingCascadeLevelsCount;++i)
+	{
+		printf(" %9s%d", "triangles", i);
+	}
+	printf("\n");
+
+	static const float fThresholds[] = { 0.0f,0.5f,1.0f,2.0f,4.0f };
+	for (int iMode = 0;iMode < (int)(sizeof(fThresholds) / sizeof(fThresholds[0]));++iMode)
+	{
+		g_CascadedShadow.m_bCasterLods = iMode != 0;
+		g_CascadedShadow.m_fCasterLodTexels = fThresholds[iMode];
+
+		double fMilliseconds = 0.0;
+		double fTriangles[MAX_CASCADES] = {};
+		for (int iFrame = 0;iFrame < iFrameCount;++iFrame)
+		{
+			MoveViewer(iFrame, iFrameCount);
+			RenderFrame(nullptr, nullptr);
+			fMilliseconds += g_CascadedShadow.GetShadowRecordMilliseconds();
+			for (int i = 0;i < MAX_CASCADES;++i)
+			{
+				fTriangles[i] += (double)g_CascadedShadow.GetCascadeTriangleCount(i);
+			}
+		}
+
+		char szMode[32];
+		if (iMode == 0)
+		{
+			sprintf_s(szMode, "full meshes");
+		}
+		else
+		{
+			sprintf_s(szMode, "%.1f texels", fThresholds[iMode]);
+		}
+		printf("%-26s %9.1f", szMode, fMilliseconds * 1e3 / (double)iFrameCount);
+		for (int i = 0;i < g_CascadeConfig.m_nUsingCascadeLevelsCount;++i)
+		{
+			printf(" %10.0f", fTriangles[i] / (double)iFrameCount);
+		}
+		printf("\n");
+	}
+	printf("%llu bytes of level indices\n", (unsigned long long)g_CascadedShadow.GetCasterLodBytes());
+
+	g_CascadedShadow.m_bCasterLods = false;
+	g_CascadedShadow.m_fCasterLodTexels = 1.0f;
+}
+
+//--------------------------------------------------------------------------------------
+// The casters left out of each cascade over the walk at a few footprints,with every cascade rendered every frame.
+//--------------------------------------------------------------------------------------
+static void ReportSmallCasters(int iFrameCount)
+{
+	g_CascadedShadow.m_bSinglePassShadows = false;
+	g_CascadedShadow.m_bMultithreadedShadows = false;
+	g_CascadedShadow.m_bCullShadowCasters = true;
+	g_CascadedShadow.m_bCacheCascades = false;
+
+	printf("\n%-26s %9s %7s %9s", "sub-texel casters", "shadow us", "draws", "PCF tap");
+	for (int i = 0;i < g_CascadeConfig.m_nUsingCascadeLevelsCount;++i)
+	{
+		printf(" %7s%d", "culled", i);
+	}
+	printf("\n");
+
+	static const float fFootprints[] = { 0.0f,0.5f,1.0f,2.0f,4.0f };
+	for (int iMode = 0;iMode < (int)(sizeof(fFootprints) / sizeof(fFootprints[0]));++iMode)
+	{
+		g_CascadedShadow.m_fMinCasterTexels = fFootprints[iMode];
+
+		double fMilliseconds = 0.0;
+		double fDraws = 0.0;
+		double fCulled[MAX_CASCADES] = {};
+		PassRecording shadowPass;
+		for (int iFrame = 0;iFrame < iFrameCount;++iFrame)
+		{
+			MoveViewer(iFrame, iFrameCount);
+			RenderFrame(&shadowPass, nullptr);
+			fMilliseconds += g_CascadedShadow.GetShadowRecordMilliseconds();
+			fDraws += shadowPass.m_Stats.m_nDraws;
+			for (int i = 0;i < MAX_CASCADES;++i)
+			{
+				fCulled[i] += g_CascadedShadow.GetSmallCasterCount(i);
+			}
+		}
+
+		char szMode[32];
+		sprintf_s(szMode, "%.1f texels", fFootprints[iMode]);
+		printf("%-26s %9.1f %7.1f %8.0f%%", szMode, fMilliseconds * 1e3 / (double)iFrameCount, fDraws / (double)iFrameCount,
+			g_CascadedShadow.GetSmallCasterPCFWeight() * 100.0f);
+		for (int i = 0;i < g_CascadeConfig.m_nUsingCascadeLevelsCount;++i)
+		{
+			printf(" %8.1f", fCulled[i] / (double)iFrameCount);
+		}
+		printf("\n");
+	}
+	printf("PCF tap is the most a left out caster could darken a %dx%d filtered sample\n", g_CascadedShadow.m_iPCFBlurSize, g_CascadedShadow.m_iPCFBlurSize);
+
+	g_CascadedShadow.m_fMinCasterTexels = 0.0f;
+}
+
+//--------------------------------------------------------------------------------------
+// The shadow map the manager allocates at a few sizes and formats,with the cascades side by side and in a
+// texture array.Side by side is limited to the width of one texture,the manager stores wider atlases as arrays.
+// The 32 bit maps are also allocated with tiles of halving length,packed into the atlas.
+//--------------------------------------------------------------------------------------
+static void ReportShadowStorage()
+{
+	static const INT iSizes[] = { 1024,2048,4096,8192 };
+	static const SHADOW_TEXTURE_FORMAT eFormats[] = { CASCADE_DXGI_FORMAT_R32_TYPELESS,CASCADE_DXGI_FORMAT_R24G8_TYPELESS,CASCADE_DXGI_FORMAT_R16_TYPELESS };
+	static const char* szFormats[] = { "32 bit","24 bit","16 bit" };
+	CascadeConfig savedConfig = g_CascadeConfig;
+
+	printf("\n%-26s %11s %11s %11s\n", "shadow map storage", "atlas MB", "array MB", "atlas width");
+	for (int iFormat = 0;iFormat < (int)(sizeof(eFormats) / sizeof(eFormats[0]));++iFormat)
+	{
+		for (int iSize = 0;iSize < (int)(sizeof(iSizes) / sizeof(iSizes[0])) * (iFormat == 0 ? 2 : 1);++iSize)
+		{
+			int nSizeCount = (int)(sizeof(iSizes) / sizeof(iSizes[0]));
+			bool bHalving = iSize >= nSizeCount;
+			g_CascadeConfig.m_ShadowBufferFormat = eFormats[iFormat];
+			g_CascadeConfig.m_iLengthOfShadowBufferSquare = iSizes[iSize % nSizeCount];
+			memset(g_CascadeConfig.m_iCascadeLengthOfShadowBuffer, 0, sizeof(g_CascadeConfig.m_iCascadeLengthOfShadowBuffer));
+			if (bHalving)
+			{
+				AtlasPacking::GetHalvingCascadeLengths(g_CascadeConfig.m_iLengthOfShadowBufferSquare, g_CascadeConfig.m_nUsingCascadeLevelsCount, 128,
+					g_CascadeConfig.m_iCascadeLengthOfShadowBuffer);
+			}
+
+			double fBytes[2];
+			bool bAtlasFits = true;
+			for (int iArray = 0;iArray < 2;++iArray)
+			{
+				g_CascadeConfig.m_bCascadeTextureArray = iArray != 0;
+				g_CascadedShadow.InitPerFrame(&g_Device, &g_MeshPowerPlant);
+				fBytes[iArray] = (double)g_CascadedShadow.GetShadowMapBytes();
+				if (iArray == 0)
+				{
+					bAtlasFits = !g_CascadedShadow.IsCascadeTextureArray();
+				}
+			}
+
+			// An atlas that is too wide was allocated as an array.
+			char szConfig[48];
+			char szAtlas[16];
+			sprintf_s(szConfig, "%d x %d %s%s", g_CascadeConfig.m_nUsingCascadeLevelsCount, g_CascadeConfig.m_iLengthOfShadowBufferSquare,
+				szFormats[iFormat], bHalving ? " halving" : "");
+			if (bAtlasFits)
+			{
+				sprintf_s(szAtlas, "%.1f", fBytes[0] / (1024.0 * 1024.0));
+			}
+			else
+			{
+				sprintf_s(szAtlas, "too wide");
+			}
+			int iLengths[MAX_CASCADES];
+			for (int i = 0;i < g_CascadeConfig.m_nUsingCascadeLevelsCount;++i)
+			{
+				iLengths[i] = bHalving ? g_CascadeConfig.m_iCascadeLengthOfShadowBuffer[i] : g_CascadeConfig.m_iLengthOfShadowBufferSquare;
+			}
+			AtlasRect rects[MAX_CASCADES];
+			int iAtlasWidth = AtlasPacking::PackSquaresSkyline(iLengths, g_CascadeConfig.m_nUsingCascadeLevelsCount, g_CascadeConfig.m_iLengthOfShadowBufferSquare, rects);
+			printf("%-26s %11s %11.1f %11d\n", szConfig, szAtlas, fBytes[1] / (1024.0 * 1024.0), iAtlasWidth);
+		}
+	}
+
+	g_CascadeConfig = savedConfig;
+	g_CascadedShadow.InitPerFrame(&g_Device, &g_MeshPowerPlant);
+}
+
+//--------------------------------------------------------------------------------------
+// A slow walk with the cache on,rendering every changed tile whole and scrolling the tiles that moved by whole texels.
+//--------------------------------------------------------------------------------------
+static void ReportScrolling(int iFrameCount, int iPassCount)
+{
+	g_CascadedShadow.m_bSinglePassShadows = false;
+	g_CascadedShadow.m_bMultithreadedShadows = false;
+	g_CascadedShadow.m_bCullShadowCasters = true;
+	g_CascadedShadow.m_bCacheCascades = true;
+
+	printf("\n%-26s %9s %7s %9s\n", "slow walk", "shadow us", "draws", "scrolled");
+	for (int iMode = 0;iMode < 2;++iMode)
+	{
+		static const char* szModes[] = { "cache / render tiles", "cache / scroll tiles" };
+		g_CascadedShadow.m_bScrollCascades = iMode != 0;
+
+		double fBestMilliseconds = 1e30;
+		UINT64 nDraws = 0;
+		int nScrolledCount = 0;
+		for (int iPass = 0;iPass < iPassCount;++iPass)
+		{
+			MoveViewer(0, iFrameCount * 16);
+			RenderFrame(nullptr, nullptr);
+
+			PassRecording shadowPass;
+			double fMilliseconds = 0.0;
+			nDraws = 0;
+			nScrolledCount = 0;
+			for (int iFrame = 1;iFrame <= iFrameCount;++iFrame)
+			{
+				MoveViewer(iFrame, iFrameCount * 16);
+				RenderFrame(&shadowPass, nullptr);
+				fMilliseconds += g_CascadedShadow.GetShadowRecordMilliseconds();
+				nDraws += shadowPass.m_Stats.m_nDraws;
+				nScrolledCount += g_CascadedShadow.GetScrollCascadeCount();
+			}
+			fBestMilliseconds = std::min(fBestMilliseconds, fMilliseconds);
+		}
+
+		printf("%-26s %9.1f %7.1f %9.2f\n", szModes[iMode], fBestMilliseconds * 1e3 / (double)iFrameCount, (double)nDraws / (double)iFrameCount,
+			(double)nScrolledCount / (double)iFrameCount);
+	}
+
+	g_CascadedShadow.m_bScrollCascades = false;
+	g_CascadedShadow.m_bCacheCascades = false;
+}
+
+//--------------------------------------------------------------------------------------
+// The constant bytes a fully dirty frame uploads with one buffer holding every constant,as the sample had before
+// the split,with a buffer per cascade and with the cascade ring.The one buffer is not in the manager any more,so
+// it is replayed on the device:a discarding map of it for each cascade the manager rendered and one for the scene.
+//--------------------------------------------------------------------------------------
+static void ReportConstantUploads(int iFrameCount)
+{
+	bool bSinglePass = g_CascadedShadow.m_bSinglePassShadows;
+	bool bMultithreaded = g_CascadedShadow.m_bMultithreadedShadows;
+	g_CascadedShadow.m_bCacheCascades = false;
+	g_CascadedShadow.m_bSinglePassShadows = false;
+	g_CascadedShadow.m_bMultithreadedShadows = false;
+
+	D3D11_BUFFER_DESC Desc;
+	ZeroMemory(&Desc, sizeof(Desc));
+	Desc.ByteWidth = sizeof(CB_PER_OBJECT) + sizeof(CB_SHADOW_FRAME);
+	Desc.Usage = D3D11_USAGE_DYNAMIC;
+	Desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	Desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	ID3D11Buffer* pAllConstantsBuffer = nullptr;
+	if (FAILED(g_Device.CreateBuffer(&Desc, nullptr, &pAllConstantsBuffer)))
+	{
+		return;
+	}
+
+	RecordingDeviceContext* pContext = g_Device.GetRecordingContext();
+	double fOneBufferBytes = 0.0;
+	double fPerCascadeBytes = 0.0;
+	PassRecording shadowPass;
+	PassRecording scenePass;
+	for (int iFrame = 0;iFrame < iFrameCount;++iFrame)
+	{
+		MoveViewer(iFrame, iFrameCount);
+		RenderFrame(&shadowPass, &scenePass);
+		fPerCascadeBytes += (double)(shadowPass.m_Stats.m_uBytesUploaded + scenePass.m_Stats.m_uBytesUploaded);
+
+		pContext->ResetRecording();
+		for (UINT i = 0;i <= shadowPass.m_Stats.m_nMaps;++i)
+		{
+			D3D11_MAPPED_SUBRESOURCE MappedResource;
+			if (SUCCEEDED(pContext->Map(pAllConstantsBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &MappedResource)))
+			{
+				pContext->Unmap(pAllConstantsBuffer, 0);
+			}
+		}
+		fOneBufferBytes += (double)pContext->GetStats().m_uBytesUploaded;
+	}
+	SAFE_RELEASE(pAllConstantsBuffer);
+
+	double fFrames = (double)iFrameCount;
+	printf("\nconstant bytes uploaded per frame,every cascade rendered:one buffer %.0f,a buffer per cascade %.0f",
+		fOneBufferBytes / fFrames, fPerCascadeBytes / fFrames);
+
+#ifdef USE_DIRECT3D11_1
+	// The ring is discarded whole when it wraps,which the average includes.
+	double fRingBytes = 0.0;
+	if (SUCCEEDED(RecreateShadowManager(true)))
+	{
+		for (int iFrame = 0;iFrame < iFrameCount;++iFrame)
+		{
+			MoveViewer(iFrame, iFrameCount);
+			RenderFrame(&shadowPass, &scenePass);
+			fRingBytes += (double)(shadowPass.m_Stats.m_uBytesUploaded + scenePass.m_Stats.m_uBytesUploaded);
+		}
+		printf(",cascade ring %.0f", fRingBytes / fFrames);
+	}
+	RecreateShadowManager(false);
+#endif
+	printf("\n");
+
+	g_CascadedShadow.m_bSinglePassShadows = bSinglePass;
+	g_CascadedShadow.m_bMultithreadedShadows = bMultithreaded;
+}
+
+//--------------------------------------------------------------------------------------
+// What the tracker holds after the runs above,next to what the device holds.
+//--------------------------------------------------------------------------------------
+static void ReportGpuMemory()
+{
+	printf("\nGPU memory by subsystem,the shader blobs are not device memory:\n%s", g_GpuMemoryTracker.GetReport(false).c_str());
+	printf("device:%llu bytes alive,tracker:%llu bytes of device objects\n", (unsigned long long)g_Device.GetLiveResourceBytes(),
+		(unsigned long long)GetTrackedDeviceBytes());
+}
+
+static void ReportFrameCost(int iFrameCount, int iPassCount)
+{
+	static const ShadowMode modes[] =
+	{
+		{ "per cascade / no culling", false, false, false },
+		{ "per cascade / culling", false, true, false },
+		{ "job pool / no culling", false, false, true },
+		{ "job pool / culling", false, true, true },
+		{ "single pass / no culling", true, false, false },
+		{ "single pass / culling", true, true, false },
+	};
+	const int nModeCount = (int)(sizeof(modes) / sizeof(modes[0]));
+
+	// Every frame renders every cascade,what the CPU pays for a fully dirty frame.
+	g_CascadedShadow.m_bCacheCascades = false;
+
+	printf("%d frames,%d cascades,%u job pool workers,best of %d passes,per frame averages\n\n", iFrameCount,
+		g_CascadeConfig.m_nUsingCascadeLevelsCount, g_JobPool.GetThreadCount(), iPassCount);
+	printf("%-26s %9s %9s %7s %7s", "shadow pass", "us/frame", "shadow us", "draws", "inst");
+	for (int i = 0;i < g_CascadeConfig.m_nUsingCascadeLevelsCount;++i)
+	{
+		printf(" %7s%d", "casters", i);
+	}
+	printf(" %7s %7s %9s\n", "states", "redund", "bytes up");
+
+	double fSceneSum[4] = { 0.0,0.0,0.0,0.0 };
+	for (int iMode = 0;iMode < nModeCount;++iMode)
+	{
+		g_CascadedShadow.m_bSinglePassShadows = modes[iMode].m_bSinglePass;
+		g_CascadedShadow.m_bCullShadowCasters = modes[iMode].m_bCull;
+		g_CascadedShadow.m_bMultithreadedShadows = modes[iMode].m_bMultithreaded;
+
+		// The shadow time is RenderShadowForAllCascades as the manager measures it,in the fastest pass.
+		double fBestSeconds = 1e30;
+		double fBestShadowMilliseconds = 0.0;
+		for (int iPass = 0;iPass < iPassCount;++iPass)
+		{
+			double fShadowMilliseconds = 0.0;
+			auto begin = std::chrono::steady_clock::now();
+			for (int iFrame = 0;iFrame < iFrameCount;++iFrame)
+			{
+				MoveViewer(iFrame, iFrameCount);
+				RenderFrame(nullptr, nullptr);
+				fShadowMilliseconds += g_CascadedShadow.GetShadowRecordMilliseconds();
+			}
+			auto end = std::chrono::steady_clock::now();
+			double fSeconds = std::chrono::duration<double>(end - begin).count();
+			if (fSeconds < fBestSeconds)
+			{
+				fBestSeconds = fSeconds;
+				fBestShadowMilliseconds = fShadowMilliseconds;
+			}
+		}
+
+		// The counts are the same on every pass,they are taken on one more untimed pass.
+		double fSum[7 + MAX_CASCADES];
+		memset(fSum, 0, sizeof(fSum));
+		PassRecording shadowPass;
+		PassRecording scenePass;
+		for (int iFrame = 0;iFrame < iFrameCount;++iFrame)
+		{
+			MoveViewer(iFrame, iFrameCount);
+			RenderFrame(&shadowPass, &scenePass);
+			fSum[0] += shadowPass.m_Stats.m_nDraws;
+			fSum[1] += shadowPass.m_Stats.m_nInstances;
+			fSum[2] += shadowPass.m_Stats.m_nStateChanges;
+			fSum[3] += shadowPass.m_Stats.m_nRedundantStateChanges;
+			fSum[4] += (double)shadowPass.m_Stats.m_uBytesUploaded;
+			fSum[5] += scenePass.m_Stats.m_nDraws;
+			fSum[6] += scenePass.m_Stats.m_nRedundantStateChanges;
+			for (int i = 0;i < MAX_CASCADES;++i)
+			{
+				fSum[7 + i] += shadowPass.m_nCastersDrawn[i];
+			}
+			fSceneSum[0] += scenePass.m_Stats.m_nDraws;
+			fSceneSum[1] += scenePass.m_Stats.m_nStateChanges;
+			fSceneSum[2] += scenePass.m_Stats.m_nRedundantStateChanges;
+			fSceneSum[3] += (double)scenePass.m_Stats.m_uBytesUploaded;
+		}
+
+		double fFrames = (double)iFrameCount;
+		printf("%-26s %9.1f %9.1f %7.1f %7.1f", modes[iMode].m_szName, fBestSeconds * 1e6 / fFrames, fBestShadowMilliseconds * 1e3 / fFrames,
+			fSum[0] / fFrames, fSum[1] / fFrames);
+		for (int i = 0;i < g_CascadeConfig.m_nUsingCascadeLevelsCount;++i)
+		{
+			printf(" %8.1f", fSum[7 + i] / fFrames);
+		}
+		printf(" %7.1f %7.1f %9.0f\n", fSum[2] / fFrames, fSum[3] / fFrames, fSum[4] / fFrames);
+	}
+
+	// The scene pass does not depend on the shadow mode.
+	double fSceneFrames = (double)nModeCount * iFrameCount;
+	printf("\nscene pass:%.1f draws,%.1f state changes,%.1f redundant,%.0f bytes uploaded per frame\n",
+		fSceneSum[0] / fSceneFrames, fSceneSum[1] / fSceneFrames, fSceneSum[2] / fSceneFrames, fSceneSum[3] / fSceneFrames);
+
+	ReportConstantUploads(iFrameCount);
+	ReportStaticLayer(iFrameCount, iPassCount);
+	ReportScrolling(iFrameCount, iPassCount);
+	ReportPositionStream(iFrameCount);
+	ReportCasterLods(iFrameCount);
+	ReportSmallCasters(iFrameCount);
+	ReportShadowStorage();
+	ReportGpuMemory();
+	printf("us/frame is InitPerFrame,RenderShadowForAllCascades and RenderScene including the recording\n");
+	printf("shadow us is RenderShadowForAllCascades from culling to the last submitted command\n");
+}
+
+int main(int argc, char* argv[])
+{
+	int iFrameCount = 512;
+	int iPassCount = 5;
+	int iCascadeCount = 4;
+	int iThreadCount = 0;
+	bool bVerify = false;
+
+	for (int i = 1;i < argc;++i)
+	{
+		if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+		{
+			iFrameCount = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--passes") == 0 && i + 1 < argc)
+		{
+			iPassCount = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--cascades") == 0 && i + 1 < argc)
+		{
+			iCascadeCount = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+		{
+			iThreadCount = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--verify") == 0)
+		{
+			bVerify = true;
+		}
+		else
+		{
+			printf("Usage: %s [--frames count] [--passes count] [--cascades count] [--threads count] [--verify]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (iFrameCount < 1)
+	{
+		iFrameCount = 1;
+	}
+	if (iPassCount < 1)
+	{
+		iPassCount = 1;
+	}
+	iCascadeCount = std::min(std::max(iCascadeCount, 1), MAX_CASCADES);
+	g_JobPool.Start((unsigned int)std::max(iThreadCount, 0));
+
+	if (FAILED(CreateScene(iCascadeCount)))
+	{
+		DestroyScene();
+		return 1;
+	}
+
+	int iResult = 0;
+	if (bVerify)
+	{
+		iResult = VerifyCommandStream();
+	}
+	else
+	{
+		ReportFrameCost(iFrameCount, iPassCount);
+	}
+
+	DestroyScene();
+	g_JobPool.Stop();
+	if (g_Device.GetLiveObjectCount() != 0)
+	{
+		printf("%d objects are still alive after Destroy\n", g_Device.GetLiveObjectCount());
+		iResult = 1;
+	}
+	if (GetTrackedDeviceBytes() != 0)
+	{
+		printf("%llu bytes are still tracked after Destroy\n", (unsigned long long)GetTrackedDeviceBytes());
+		iResult = 1;
+	}
+	return iResult;
+}